@@ -192,6 +192,13 @@ module.exports = async function () {
         // 复制文件
         fs.copyFileSync(sourcePath, targetPath);
         console.log(`Successfully copied window-addon.node to ${targetPath}`);
+
+        // 代理中继模块只在 Linux 上构建，缺失时运行时回退到 JS 实现
+        const relaySourcePath = path.join(path.dirname(sourcePath), 'proxy-relay.node');
+        if (fs.existsSync(relaySourcePath)) {
+          fs.copyFileSync(relaySourcePath, path.join(targetDir, 'proxy-relay.node'));
+          console.log(`Successfully copied proxy-relay.node to ${targetDir}`);
+        }
       } catch (error) {
         console.error('Failed to copy window-addon:', error);
         throw error;
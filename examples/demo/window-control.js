@@ -0,0 +1,220 @@
+import net from 'node:net';
+import os from 'node:os';
+import path from 'node:path';
+
+// Client for the window-daemon control socket (Linux).
+// Start the daemon with: packages/main/src/native-addon/build/Release/window-daemon [--socket <path>]
+// The wire format is documented in packages/main/src/native-addon/control-protocol.h.
+
+const Opcode = {
+  ping: 0,
+  listWindows: 1,
+  getMonitors: 2,
+  arrange: 3,
+  pointerEvent: 4,
+  wheelEvent: 5,
+  windowOp: 6,
+  keyEvent: 7,
+};
+const PointerEvent = {mousemove: 0, mousedown: 1, mouseup: 2, rightdown: 3, rightup: 4};
+const KeyEvent = {keydown: 0, keyup: 1};
+const WindowOp = {minimize: 0, restore: 1, hide: 2, show: 3, close: 4, bringToFront: 5, setAlwaysOnTop: 6};
+const StatusMessage = ['ok', 'unknown opcode', 'malformed request', 'failed'];
+
+export function defaultSocketPath() {
+  const runtimeDir = process.env.XDG_RUNTIME_DIR;
+  if (runtimeDir) {
+    return path.join(runtimeDir, 'chrome-power-window.sock');
+  }
+  return `/tmp/chrome-power-window-${os.userInfo().uid}.sock`;
+}
+
+class Writer {
+  constructor() {
+    this.bytes = [];
+  }
+  u8(value) {
+    this.bytes.push(value & 0xff);
+    return this;
+  }
+  u16(value) {
+    return this.u8(value).u8(value >> 8);
+  }
+  i32(value) {
+    return this.u8(value).u8(value >> 8).u8(value >> 16).u8(value >> 24);
+  }
+}
+
+class Reader {
+  constructor(buffer) {
+    this.buffer = buffer;
+    this.offset = 0;
+  }
+  u8() {
+    return this.buffer.readUInt8(this.offset++);
+  }
+  u16() {
+    const value = this.buffer.readUInt16LE(this.offset);
+    this.offset += 2;
+    return value;
+  }
+  u32() {
+    const value = this.buffer.readUInt32LE(this.offset);
+    this.offset += 4;
+    return value;
+  }
+  i32() {
+    const value = this.buffer.readInt32LE(this.offset);
+    this.offset += 4;
+    return value;
+  }
+}
+
+/**
+ * Connect to the daemon. Every method returns a promise and may be called
+ * without awaiting the previous one; requests are pipelined on the socket.
+ */
+export async function connectWindowControl(socketPath = defaultSocketPath()) {
+  const socket = net.createConnection(socketPath);
+  socket.setNoDelay?.(true);
+  await new Promise((resolve, reject) => {
+    socket.once('connect', resolve);
+    socket.once('error', reject);
+  });
+
+  const pending = new Map();
+  let nextId = 1;
+  let buffer = Buffer.alloc(0);
+
+  socket.on('data', chunk => {
+    buffer = buffer.length ? Buffer.concat([buffer, chunk]) : chunk;
+    while (buffer.length >= 4) {
+      const length = buffer.readUInt32LE(0);
+      if (buffer.length < 4 + length) {
+        break;
+      }
+      const payload = buffer.subarray(4, 4 + length);
+      buffer = buffer.subarray(4 + length);
+
+      const id = payload.readUInt32LE(0);
+      const status = payload.readUInt8(4);
+      const request = pending.get(id);
+      pending.delete(id);
+      if (!request) {
+        continue;
+      }
+      if (status !== 0) {
+        request.reject(new Error(`window-daemon: ${StatusMessage[status] || `status ${status}`}`));
+      } else {
+        request.resolve(request.decode(new Reader(payload.subarray(5))));
+      }
+    }
+  });
+
+  socket.on('close', () => {
+    for (const request of pending.values()) {
+      request.reject(new Error('window-daemon connection closed'));
+    }
+    pending.clear();
+  });
+
+  function call(opcode, body, decode) {
+    const id = nextId++ >>> 0;
+    const payload = new Writer().i32(id).u8(opcode);
+    payload.bytes.push(...body.bytes);
+    const frame = Buffer.alloc(4 + payload.bytes.length);
+    frame.writeUInt32LE(payload.bytes.length, 0);
+    Buffer.from(payload.bytes).copy(frame, 4);
+    return new Promise((resolve, reject) => {
+      pending.set(id, {resolve, reject, decode});
+      socket.write(frame);
+    });
+  }
+
+  return {
+    ping() {
+      return call(Opcode.ping, new Writer(), () => true);
+    },
+
+    // Main and extension windows of each pid, in the order given
+    listWindows(pids) {
+      const body = new Writer().u16(pids.length);
+      pids.forEach(pid => body.i32(pid));
+      return call(Opcode.listWindows, body, reader =>
+        pids.map(() =>
+          Array.from({length: reader.u16()}, () => ({
+            window: reader.u32(),
+            isExtension: reader.u8() === 1,
+            x: reader.i32(),
+            y: reader.i32(),
+            width: reader.i32(),
+            height: reader.i32(),
+          })),
+        ),
+      );
+    },
+
+    getMonitors() {
+      return call(Opcode.getMonitors, new Writer(), reader =>
+        Array.from({length: reader.u8()}, (_, index) => ({
+          x: reader.i32(),
+          y: reader.i32(),
+          width: reader.i32(),
+          height: reader.i32(),
+          isPrimary: reader.u8() === 1,
+          index,
+        })),
+      );
+    },
+
+    // Same grid as WindowManager.arrangeWindows
+    arrangeWindows({mainPid, childPids, columns, size = {width: 0, height: 0}, spacing = 0, monitorIndex = 0, force = false}) {
+      const body = new Writer().i32(mainPid).u16(childPids.length);
+      childPids.forEach(pid => body.i32(pid));
+      body.u16(columns).i32(size.width).i32(size.height).i32(spacing).u8(monitorIndex).u8(force ? 1 : 0);
+      return call(Opcode.arrange, body, reader => ({
+        moved: reader.u32(),
+        skipped: reader.u32(),
+        missing: reader.u32(),
+      }));
+    },
+
+    // type: mousemove, mousedown, mouseup, rightdown or rightup
+    sendMouseEvent(pid, x, y, type) {
+      if (!(type in PointerEvent)) {
+        return Promise.reject(new Error(`Unknown mouse event type: ${type}`));
+      }
+      const body = new Writer().i32(pid).i32(x).i32(y).u8(PointerEvent[type]);
+      return call(Opcode.pointerEvent, body, reader => reader.u8() === 1);
+    },
+
+    sendWheelEvent(pid, deltaX, deltaY, x, y) {
+      const body = new Writer().i32(pid).i32(deltaX).i32(deltaY).i32(x).i32(y);
+      return call(Opcode.wheelEvent, body, reader => reader.u8() === 1);
+    },
+
+    // type: keydown or keyup; keyCode is an X keycode. At x, y the key goes
+    // to the extension window there, without them to the main window.
+    sendKeyEvent(pid, keyCode, type, {x = -1, y = -1} = {}) {
+      if (!(type in KeyEvent)) {
+        return Promise.reject(new Error(`Unknown key event type: ${type}`));
+      }
+      const body = new Writer().i32(pid).u8(keyCode).u8(KeyEvent[type]).i32(x).i32(y);
+      return call(Opcode.keyEvent, body, reader => reader.u8() === 1);
+    },
+
+    // Same operations as WindowManager.bulkWindowOp, applied in one request
+    bulkWindowOp(pids, op, {value = true} = {}) {
+      if (!(op in WindowOp)) {
+        return Promise.reject(new Error(`Unknown window operation: ${op}`));
+      }
+      const body = new Writer().u8(WindowOp[op]).u8(value ? 1 : 0).u16(pids.length);
+      pids.forEach(pid => body.i32(pid));
+      return call(Opcode.windowOp, body, reader => pids.map(pid => ({pid, windows: reader.u16()})));
+    },
+
+    close() {
+      socket.end();
+    },
+  };
+}
@@ -19,6 +19,7 @@ export const WINDOW_LOGGER_LABEL = 'Window';
 export const PROXY_LOGGER_LABEL = 'Proxy';
 export const API_LOGGER_LABEL = 'Api';
 export const MAIN_LOGGER_LABEL = 'Main';
+export const NATIVE_LOGGER_LABEL = 'Native';
 
 export const CONFIG_FILE_PATH = join(app.getPath('userData'), 'chrome-power-config.json');
 export const LOGS_PATH = join(app.getPath('userData'), 'logs');
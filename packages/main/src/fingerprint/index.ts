@@ -8,6 +8,7 @@ import {execSync, spawn} from 'child_process';
 import * as portscanner from 'portscanner';
 import {sleep} from '../utils/sleep';
 import SocksServer from '../proxy-server/socks-server';
+import {createNativeRelayRoute, type NativeRelayRoute} from '../proxy-server/native-relay';
 import type {DB} from '../../../shared/types/db';
 import {type IncomingMessage, type Server, type ServerResponse} from 'http';
 import {createLogger} from '../../../shared/utils/logger';
@@ -24,6 +25,7 @@ import {existsSync, mkdirSync} from 'fs';
 import api from '../../../shared/api/api';
 import {ExtensionDB} from '../db/extension';
 import { getPort } from '../server';
+import {canWaitForWindow, waitForWindow} from '../services/sync-service';
 
 const mutex = new Mutex();
 
@@ -235,7 +237,10 @@ export async function openFingerprintWindow(id: number, headless = false) {
     if (driverPath) {
       const chromePort = await getAvailablePort();
       let finalProxy;
-      let proxyServer: Server<typeof IncomingMessage, typeof ServerResponse> | ProxyChain.Server;
+      let proxyServer:
+        | Server<typeof IncomingMessage, typeof ServerResponse>
+        | ProxyChain.Server
+        | NativeRelayRoute;
       if (proxyData && proxyType === 'socks5' && proxyData.proxy) {
         const proxyInstance = await createSocksProxy(proxyData);
         finalProxy = proxyInstance.proxyUrl;
@@ -327,8 +332,6 @@ export async function openFingerprintWindow(id: number, headless = false) {
       if (!chromeInstance) {
         return;
       }
-      await sleep(1);
-      win.webContents.send('window-opened', id);
       chromeInstance.stdout.on('data', _chunk => {
         // const str = _chunk.toString();
         // console.error('stderr: ', str);
@@ -342,7 +345,7 @@ export async function openFingerprintWindow(id: number, headless = false) {
       chromeInstance.on('close', async () => {
         logger.info(`Chrome process exited at port ${chromePort}, closed time: ${new Date()}`);
         if (proxyType === 'socks5') {
-          (proxyServer as Server<typeof IncomingMessage, typeof ServerResponse>)?.close(() => {
+          (proxyServer as Server<typeof IncomingMessage, typeof ServerResponse> | NativeRelayRoute)?.close(() => {
             logger.info('Socks5 Proxy server was closed.');
           });
         } else if (proxyType === 'http') {
@@ -353,6 +356,16 @@ export async function openFingerprintWindow(id: number, headless = false) {
         await closeFingerprintWindow(id, false);
       });
 
+      // 窗口一出现就继续，进程提前退出或等待超时也不再多等；无法监听窗口创建时（如 macOS）退回固定等待
+      if (!headless) {
+        if (canWaitForWindow()) {
+          await waitForWindow(chromeInstance);
+        } else {
+          await sleep(1);
+        }
+      }
+      win.webContents.send('window-opened', id);
+
       await waitForChromeReady(chromePort, id, 30);
 
       try {
@@ -452,6 +465,21 @@ async function createSocksProxy(proxyData: DB.Proxy) {
   const listenPort = await portscanner.findAPortNotInUse(30000, 40000);
   const [socksHost, socksPort, socksUsername, socksPassword] = proxyData.proxy!.split(':');
 
+  // 优先使用原生中继（splice 零拷贝），不可用时回退到 JS 实现
+  const nativeRoute = createNativeRelayRoute({
+    type: 'socks5',
+    host: socksHost,
+    port: +socksPort,
+    username: socksUsername,
+    password: socksPassword,
+  });
+  if (nativeRoute) {
+    return {
+      proxyServer: nativeRoute,
+      proxyUrl: nativeRoute.proxyUrl,
+    };
+  }
+
   const proxyServer = SocksServer({
     listenHost,
     listenPort,
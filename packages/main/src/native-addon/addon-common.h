@@ -0,0 +1,25 @@
+#pragma once
+
+#include "native-log.h"
+
+// Logging macros, see native-log.h. msg is streamed, e.g.
+// LOG_ERROR("bind " << path << " failed: " << strerror(errno));
+#if CP_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(msg) CP_LOG(LogLevel::Debug, msg)
+#else
+#define LOG_DEBUG(msg) do { } while (0)
+#endif
+
+#if CP_LOG_MIN_LEVEL <= 1
+#define LOG_INFO(msg) CP_LOG(LogLevel::Info, msg)
+#else
+#define LOG_INFO(msg) do { } while (0)
+#endif
+
+#if CP_LOG_MIN_LEVEL <= 2
+#define LOG_WARN(msg) CP_LOG(LogLevel::Warn, msg)
+#else
+#define LOG_WARN(msg) do { } while (0)
+#endif
+
+#define LOG_ERROR(msg) CP_LOG(LogLevel::Error, msg)
@@ -0,0 +1,171 @@
+#include "addon-core.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <xcb/randr.h>
+#include "x11-connection.h"
+#endif
+
+namespace {
+
+#ifdef _WIN32
+std::vector<MonitorInfo> QueryMonitors() {
+    std::vector<MonitorInfo> monitors;
+    EnumDisplayMonitors(NULL, NULL, [](HMONITOR hMonitor, HDC, LPRECT, LPARAM lParam) -> BOOL {
+        auto& monitors = *reinterpret_cast<std::vector<MonitorInfo>*>(lParam);
+        MONITORINFOEX monitorInfo;
+        monitorInfo.cbSize = sizeof(MONITORINFOEX);
+
+        if (GetMonitorInfo(hMonitor, &monitorInfo)) {
+            MonitorInfo info;
+            info.handle = hMonitor;
+            info.rect = monitorInfo.rcWork;
+            info.isPrimary = (monitorInfo.dwFlags & MONITORINFOF_PRIMARY) != 0;
+            monitors.push_back(info);
+        }
+        return TRUE;
+    }, reinterpret_cast<LPARAM>(&monitors));
+
+    // Sort monitors so that non-primary monitors come first
+    std::sort(monitors.begin(), monitors.end(),
+        [](const MonitorInfo& a, const MonitorInfo& b) {
+            return a.isPrimary < b.isPrimary;
+        });
+
+    return monitors;
+}
+#elif __APPLE__
+std::vector<MonitorInfo> QueryMonitors() {
+    std::vector<MonitorInfo> monitors;
+    uint32_t displayCount;
+    CGDirectDisplayID displays[32];
+
+    if (CGGetActiveDisplayList(32, displays, &displayCount) == kCGErrorSuccess) {
+        CGDirectDisplayID mainDisplay = CGMainDisplayID();
+
+        for (uint32_t i = 0; i < displayCount; i++) {
+            MonitorInfo info;
+            info.id = displays[i];
+            info.bounds = CGDisplayBounds(displays[i]);
+            info.isPrimary = (displays[i] == mainDisplay);
+            monitors.push_back(info);
+        }
+
+        // Sort monitors so that non-primary monitors come first
+        std::sort(monitors.begin(), monitors.end(),
+            [](const MonitorInfo& a, const MonitorInfo& b) {
+                return a.isPrimary < b.isPrimary;
+            });
+    }
+
+    return monitors;
+}
+#elif __linux__
+// RandR monitors clipped to the EWMH work area, falling back to the whole screen
+std::vector<MonitorInfo> QueryMonitors() {
+    std::vector<MonitorInfo> monitors;
+    X11Connection x11;
+    if (!x11.IsOpen()) {
+        return monitors;
+    }
+
+    xcb_randr_get_monitors_reply_t* reply = xcb_randr_get_monitors_reply(
+        x11.Get(), xcb_randr_get_monitors(x11.Get(), x11.Root(), 1), nullptr);
+    if (reply) {
+        xcb_randr_monitor_info_iterator_t it = xcb_randr_get_monitors_monitors_iterator(reply);
+        for (; it.rem; xcb_randr_monitor_info_next(&it)) {
+            MonitorInfo info;
+            info.id = it.index;
+            info.isPrimary = it.data->primary != 0;
+            info.x = it.data->x;
+            info.y = it.data->y;
+            info.width = it.data->width;
+            info.height = it.data->height;
+            monitors.push_back(info);
+        }
+        free(reply);
+    }
+
+    if (monitors.empty()) {
+        MonitorInfo info;
+        info.id = 0;
+        info.isPrimary = true;
+        info.x = 0;
+        info.y = 0;
+        info.width = x11.Screen()->width_in_pixels;
+        info.height = x11.Screen()->height_in_pixels;
+        monitors.push_back(info);
+    }
+
+    int areaX, areaY, areaWidth, areaHeight;
+    if (x11.WorkArea(areaX, areaY, areaWidth, areaHeight)) {
+        for (auto& monitor : monitors) {
+            int left = std::max(monitor.x, areaX);
+            int top = std::max(monitor.y, areaY);
+            int right = std::min(monitor.x + monitor.width, areaX + areaWidth);
+            int bottom = std::min(monitor.y + monitor.height, areaY + areaHeight);
+            if (right > left && bottom > top) {
+                monitor.x = left;
+                monitor.y = top;
+                monitor.width = right - left;
+                monitor.height = bottom - top;
+            }
+        }
+    }
+
+    // Sort monitors so that non-primary monitors come first
+    std::sort(monitors.begin(), monitors.end(),
+        [](const MonitorInfo& a, const MonitorInfo& b) {
+            return a.isPrimary < b.isPrimary;
+        });
+
+    return monitors;
+}
+#else
+std::vector<MonitorInfo> QueryMonitors() {
+    return std::vector<MonitorInfo>();
+}
+#endif
+
+}  // namespace
+
+std::shared_ptr<AddonCore> AddonCore::Acquire() {
+    static std::mutex mutex;
+    static std::weak_ptr<AddonCore> current;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<AddonCore> core = current.lock();
+    if (!core) {
+        core = std::shared_ptr<AddonCore>(new AddonCore());
+        current = core;
+    }
+    return core;
+}
+
+std::vector<MonitorInfo> AddonCore::Monitors() {
+    std::lock_guard<std::mutex> lock(monitorMutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (!monitorsValid_ || now - monitorsQueried_ >= kMonitorCacheTtl) {
+        monitors_ = QueryMonitors();
+        monitorsQueried_ = now;
+        monitorsValid_ = true;
+    }
+    return monitors_;
+}
+
+void AddonCore::InvalidateMonitors() {
+    std::lock_guard<std::mutex> lock(monitorMutex_);
+    monitorsValid_ = false;
+}
+
+ForegroundTracker* AddonCore::Foreground() {
+    std::call_once(foregroundOnce_, [this] {
+        auto tracker = std::make_unique<ForegroundTracker>();
+        if (tracker->Start()) {
+            foreground_ = std::move(tracker);
+        }
+    });
+    return foreground_.get();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "foreground-tracker.h"
+#include "window-classifier.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif __APPLE__
+#include <CoreGraphics/CoreGraphics.h>
+#endif
+
+// Monitor info structure (for multi-monitor support)
+#ifdef _WIN32
+struct MonitorInfo {
+    HMONITOR handle;
+    RECT rect;
+    bool isPrimary;
+};
+#elif __APPLE__
+struct MonitorInfo {
+    CGDirectDisplayID id;
+    CGRect bounds;
+    bool isPrimary;
+};
+#else
+// X11 monitor (RandR), in root window coordinates
+struct MonitorInfo {
+    int id;
+    bool isPrimary;
+    int x, y, width, height;
+};
+#endif
+
+// Process-wide state shared by every JS environment that loads the addon
+// (the main thread and any worker_threads).
+//
+// Each environment holds a reference through its instance data and every
+// WindowManager holds another, so the core lives until the last environment
+// is torn down. All methods are safe to call from any thread.
+class AddonCore {
+public:
+    // Monitors are re-queried after this long, or after InvalidateMonitors()
+    static constexpr std::chrono::milliseconds kMonitorCacheTtl{2000};
+
+    static std::shared_ptr<AddonCore> Acquire();
+
+    AddonCore(const AddonCore&) = delete;
+    AddonCore& operator=(const AddonCore&) = delete;
+
+    // Monitors with non-primary monitors first
+    std::vector<MonitorInfo> Monitors();
+    void InvalidateMonitors();
+
+    // Window registry: kind of a window handle, classified once for all environments
+    template <typename ReadTraits, typename ReadTitle>
+    WindowKind ClassifyWindow(uint64_t handle, uint64_t identity, ReadTraits&& readTraits, ReadTitle&& readTitle) {
+        std::lock_guard<std::mutex> lock(windowMutex_);
+        return windowKinds_.Lookup(handle, identity, readTraits, readTitle);
+    }
+
+    // Synthetic input is one global stream: hold this while injecting an event
+    // sequence so sequences from different workers do not interleave
+    std::unique_lock<std::mutex> LockInput() { return std::unique_lock<std::mutex>(inputMutex_); }
+
+    // Process-wide foreground tracker, started on first use. nullptr when
+    // focus changes cannot be followed on this system.
+    ForegroundTracker* Foreground();
+
+    // Number of environments currently attached
+    int Environments() const { return environments_.load(); }
+    void AttachEnvironment() { environments_++; }
+    void DetachEnvironment() { environments_--; }
+
+private:
+    AddonCore() = default;
+
+    std::mutex monitorMutex_;
+    std::vector<MonitorInfo> monitors_;
+    std::chrono::steady_clock::time_point monitorsQueried_;
+    bool monitorsValid_ = false;
+
+    std::mutex windowMutex_;
+    WindowClassCache windowKinds_;
+
+    std::mutex inputMutex_;
+    std::atomic<int> environments_{0};
+
+    std::once_flag foregroundOnce_;
+    std::unique_ptr<ForegroundTracker> foreground_;
+};
@@ -0,0 +1,70 @@
+// Heap allocation counter for tests, loaded with LD_PRELOAD. It interposes
+// the glibc allocation entry points, counts calls per thread and forwards
+// to the glibc implementations. The addon reports the calling thread's
+// count through getCoreStats().threadAllocations when this is preloaded.
+//
+// Linux/glibc only, never shipped with the app.
+
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+// initial-exec keeps the TLS access itself from allocating
+__attribute__((tls_model("initial-exec"))) thread_local uint64_t allocations = 0;
+
+}  // namespace
+
+extern "C" {
+
+__attribute__((visibility("default"))) uint64_t cp_thread_allocations() {
+    return allocations;
+}
+
+__attribute__((visibility("default"))) void* malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+__attribute__((visibility("default"))) void* calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+__attribute__((visibility("default"))) void* realloc(void* ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+__attribute__((visibility("default"))) void* memalign(size_t alignment, size_t size) {
+    allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+__attribute__((visibility("default"))) void* aligned_alloc(size_t alignment, size_t size) {
+    allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+__attribute__((visibility("default"))) int posix_memalign(void** result, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    allocations++;
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *result = ptr;
+    return 0;
+}
+
+}  // extern "C"
@@ -2,7 +2,33 @@
   "targets": [
     {
       "target_name": "window-addon",
-      "sources": [ "window-addon.cpp" ],
+      "sources": [
+        "window-addon.cpp",
+        "addon-core.cpp",
+        "cdp-sync.cpp",
+        "control-protocol.cpp",
+        "divergence-detector.cpp",
+        "drag-synthesis.cpp",
+        "foreground-tracker.cpp",
+        "image-ops.cpp",
+        "layout-snapshot.cpp",
+        "memory-reclaim.cpp",
+        "native-log.cpp",
+        "process-scheduler.cpp",
+        "process-stats.cpp",
+        "process-tree.cpp",
+        "profile-sampler.cpp",
+        "sync-relay.cpp",
+        "sync-sessions.cpp",
+        "templated-text.cpp",
+        "thumbnail-capture.cpp",
+        "window-classifier.cpp",
+        "websocket-codec.cpp",
+        "window-control.cpp",
+        "window-parking.cpp",
+        "window-watcher.cpp",
+        "x11-connection.cpp"
+      ],
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")"
       ],
@@ -41,7 +67,18 @@
             "/System/Library/Frameworks/AppKit.framework/Headers"
           ]
         }],
+        ['OS=="linux"', {
+          "libraries": [
+            "-lxcb",
+            "-lxcb-composite",
+            "-lxcb-damage",
+            "-lxcb-randr",
+            "-lxcb-shm",
+            "-ldl"
+          ]
+        }],
         ['OS=="win"', {
+          "libraries": [ "-lws2_32" ],
           "msvs_settings": {
             "VCCLCompilerTool": {
               "ExceptionHandling": 1
@@ -49,6 +86,94 @@
           }
         }]
       ]
+    },
+    {
+      "target_name": "proxy-relay",
+      "sources": [
+        "proxy-relay-addon.cpp",
+        "native-log.cpp",
+        "socks-relay.cpp"
+      ],
+      "include_dirs": [
+        "<!@(node -p \"require('node-addon-api').include\")"
+      ],
+      "dependencies": ["<!(node -p \"require('node-addon-api').gyp\")"],
+      "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS" ],
+      "conditions": [
+        ['OS=="mac"', {
+          "xcode_settings": {
+            "OTHER_CPLUSPLUSFLAGS": [ "-std=c++17", "-stdlib=libc++" ],
+            "MACOSX_DEPLOYMENT_TARGET": "10.13",
+            "CLANG_CXX_LIBRARY": "libc++",
+            "CLANG_CXX_LANGUAGE_STANDARD": "c++17"
+          }
+        }],
+        ['OS=="linux"', {
+          "libraries": [ "-lpthread" ]
+        }]
+      ]
+    },
+    {
+      "target_name": "window-daemon",
+      "type": "none",
+      "conditions": [
+        ['OS=="linux"', {
+          "type": "executable",
+          "sources": [
+            "window-daemon.cpp",
+            "addon-core.cpp",
+            "control-protocol.cpp",
+            "foreground-tracker.cpp",
+            "native-log.cpp",
+            "process-tree.cpp",
+            "window-classifier.cpp",
+            "window-control.cpp",
+            "x11-connection.cpp"
+          ],
+          "cflags_cc": [ "-std=c++17" ],
+          "libraries": [
+            "-lxcb",
+            "-lxcb-randr",
+            "-lpthread"
+          ]
+        }]
+      ]
+    },
+    {
+      "target_name": "native-tests",
+      "type": "none",
+      "conditions": [
+        ['OS=="linux"', {
+          "type": "executable",
+          "sources": [
+            "image-ops-test.cpp",
+            "image-ops.cpp",
+            "layout-snapshot-test.cpp",
+            "layout-snapshot.cpp",
+            "native-log.cpp",
+            "native-tests.cpp",
+            "process-tree-test.cpp",
+            "process-tree.cpp",
+            "window-classifier-test.cpp",
+            "window-classifier.cpp"
+          ],
+          "cflags_cc": [ "-std=c++17" ],
+          "libraries": [ "-lpthread" ]
+        }]
+      ]
+    },
+    {
+      "target_name": "alloc-counter",
+      "type": "none",
+      "conditions": [
+        ['OS=="linux"', {
+          "type": "loadable_module",
+          "product_prefix": "",
+          "product_extension": "so",
+          "sources": [ "alloc-counter.cpp" ],
+          "cflags_cc": [ "-std=c++17" ]
+        }]
+      ]
     }
   ]
 }
\ No newline at end of file
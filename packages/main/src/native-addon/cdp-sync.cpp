@@ -0,0 +1,737 @@
+#include "cdp-sync.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+
+#include "addon-common.h"
+#include "websocket-codec.h"
+
+namespace {
+
+// DevTools messages are small; this only guards against a runaway peer
+constexpr size_t kMaxMessage = 16 << 20;
+// Scroll commands carry absolute positions, so a slave this far behind
+// simply misses some until it drains
+constexpr size_t kMaxPendingOutput = 1 << 20;
+constexpr int kRetryDelayMs = 1000;
+
+const char kBindingName[] = "__cpScroll";
+
+// Reports window scroll at most once per frame. Kept free of double quotes
+// and backslashes so it can be embedded in JSON as is.
+const char kScrollHook[] =
+    "(()=>{if(window.__cpScrollHooked)return;window.__cpScrollHooked=true;let queued=false;"
+    "addEventListener('scroll',()=>{if(queued)return;queued=true;requestAnimationFrame(()=>{queued=false;"
+    "if(typeof __cpScroll==='function')__cpScroll(Math.round(scrollX)+','+Math.round(scrollY));});},"
+    "{capture:true,passive:true});})()";
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// The few socket calls that differ between Winsock and POSIX
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle kNoSocket = INVALID_SOCKET;
+constexpr int kSendFlags = 0;
+
+int PollSockets(std::vector<pollfd>& fds, int timeoutMs) {
+    return WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeoutMs);
+}
+
+void CloseSocket(SocketHandle handle) {
+    closesocket(handle);
+}
+
+int SocketError() {
+    return WSAGetLastError();
+}
+
+bool WouldBlock(int error) {
+    return error == WSAEWOULDBLOCK;
+}
+
+// A non-blocking connect() that is still under way
+bool ConnectPending(int error) {
+    return error == WSAEWOULDBLOCK;
+}
+
+bool Interrupted(int error) {
+    return error == WSAEINTR;
+}
+
+// Non-blocking, and not inherited by child processes
+SocketHandle OpenSocket(int family, int type) {
+    SocketHandle handle = WSASocketW(family, type, 0, nullptr, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_NO_HANDLE_INHERIT);
+    u_long one = 1;
+    if (handle != kNoSocket && ioctlsocket(handle, FIONBIO, &one) != 0) {
+        closesocket(handle);
+        return kNoSocket;
+    }
+    return handle;
+}
+#else
+using SocketHandle = int;
+constexpr SocketHandle kNoSocket = -1;
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+// macOS has no MSG_NOSIGNAL; OpenSocket sets SO_NOSIGPIPE instead
+constexpr int kSendFlags = 0;
+#endif
+
+int PollSockets(std::vector<pollfd>& fds, int timeoutMs) {
+    return poll(fds.data(), static_cast<nfds_t>(fds.size()), timeoutMs);
+}
+
+void CloseSocket(SocketHandle handle) {
+    close(handle);
+}
+
+int SocketError() {
+    return errno;
+}
+
+bool WouldBlock(int error) {
+    return error == EAGAIN || error == EWOULDBLOCK;
+}
+
+// A non-blocking connect() that is still under way
+bool ConnectPending(int error) {
+    return error == EINPROGRESS;
+}
+
+bool Interrupted(int error) {
+    return error == EINTR;
+}
+
+// Non-blocking, and not inherited by child processes
+SocketHandle OpenSocket(int family, int type) {
+    SocketHandle handle = socket(family, type, 0);
+    if (handle == kNoSocket) {
+        return kNoSocket;
+    }
+    int flags = fcntl(handle, F_GETFL, 0);
+    if (flags < 0 || fcntl(handle, F_SETFL, flags | O_NONBLOCK) != 0 || fcntl(handle, F_SETFD, FD_CLOEXEC) != 0) {
+        close(handle);
+        return kNoSocket;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return handle;
+}
+#endif
+
+enum class ConnectionState {
+    Idle,
+    Connecting,
+    Handshaking,
+    Open,
+};
+
+struct Connection {
+    WebSocketUrl url;
+    bool master = false;
+    SocketHandle fd = kNoSocket;
+    ConnectionState state = ConnectionState::Idle;
+    bool everOpened = false;
+    int64_t retryAt = 0;
+    std::string key;
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    size_t outOffset = 0;
+    // Fragmented message being assembled
+    std::string message;
+    uint32_t nextId = 1;
+};
+
+struct Command {
+    bool wheel = false;
+    int x = 0;
+    int y = 0;
+    int deltaX = 0;
+    int deltaY = 0;
+};
+
+}  // namespace
+
+class CdpSync::Loop {
+public:
+    Loop(const std::string& masterUrl, const std::vector<std::string>& slaveUrls)
+        : masterUrl_(masterUrl), slaveUrls_(slaveUrls) {}
+
+    ~Loop() {
+        for (auto& conn : connections_) {
+            if (conn.fd != kNoSocket) {
+                CloseSocket(conn.fd);
+            }
+        }
+        if (wakeSocket_ != kNoSocket) {
+            CloseSocket(wakeSocket_);
+        }
+#ifdef _WIN32
+        if (winsockStarted_) {
+            WSACleanup();
+        }
+#endif
+    }
+
+    bool Init() {
+        connections_.resize(1 + slaveUrls_.size());
+        if (!ParseWebSocketUrl(masterUrl_, connections_[0].url)) {
+            LOG_ERROR("Invalid DevTools URL: " << masterUrl_);
+            return false;
+        }
+        connections_[0].master = true;
+        for (size_t i = 0; i < slaveUrls_.size(); i++) {
+            if (!ParseWebSocketUrl(slaveUrls_[i], connections_[i + 1].url)) {
+                LOG_ERROR("Invalid DevTools URL: " << slaveUrls_[i]);
+                return false;
+            }
+        }
+
+#ifdef _WIN32
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            LOG_ERROR("Failed to start Winsock for the CDP event loop");
+            return false;
+        }
+        winsockStarted_ = true;
+#endif
+        if (!OpenWakeSocket()) {
+            LOG_ERROR("Failed to create the CDP event loop (error " << SocketError() << ")");
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.endpoints = static_cast<int>(connections_.size());
+        return true;
+    }
+
+    void Run() {
+        std::vector<pollfd> fds;
+        // Connection of each entry in fds after the wake socket
+        std::vector<size_t> polled;
+        while (running_.load()) {
+            int64_t now = NowMs();
+            int timeout = -1;
+            for (size_t i = 0; i < connections_.size(); i++) {
+                Connection& conn = connections_[i];
+                if (conn.state != ConnectionState::Idle) {
+                    continue;
+                }
+                if (conn.retryAt <= now) {
+                    Connect(i);
+                }
+                if (conn.state == ConnectionState::Idle) {
+                    int wait = static_cast<int>(std::max<int64_t>(conn.retryAt - now, 0));
+                    timeout = timeout < 0 ? wait : std::min(timeout, wait);
+                }
+            }
+            FlushAll();
+
+            fds.clear();
+            polled.clear();
+            fds.push_back({wakeSocket_, POLLIN, 0});
+            for (size_t i = 0; i < connections_.size(); i++) {
+                const Connection& conn = connections_[i];
+                if (conn.fd == kNoSocket) {
+                    continue;
+                }
+                // Writable once a connect completes, or once a blocked write can go on
+                short events = conn.state == ConnectionState::Connecting ? POLLOUT
+                               : conn.out.empty()                       ? POLLIN
+                                                                        : POLLIN | POLLOUT;
+                fds.push_back({conn.fd, events, 0});
+                polled.push_back(i);
+            }
+
+            int count = PollSockets(fds, timeout);
+            if (count < 0) {
+                int error = SocketError();
+                if (Interrupted(error)) {
+                    continue;
+                }
+                LOG_ERROR("CDP event loop poll failed (error " << error << ")");
+                break;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                char drain[64];
+                while (recv(wakeSocket_, drain, sizeof(drain), 0) > 0) {
+                }
+            }
+            for (size_t i = 1; i < fds.size(); i++) {
+                short flags = fds[i].revents;
+                size_t index = polled[i - 1];
+                if (flags == 0 || connections_[index].fd == kNoSocket) {
+                    continue;
+                }
+                if (connections_[index].state == ConnectionState::Connecting &&
+                    (flags & (POLLOUT | POLLERR | POLLHUP))) {
+                    FinishConnect(index);
+                    continue;
+                }
+                if (flags & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) {
+                    ReadFrom(index);
+                }
+            }
+
+            // One batch of commands per iteration, then one write per socket
+            ForwardScroll();
+            DrainCommands();
+        }
+    }
+
+    void Wake() {
+        char one = 1;
+        send(wakeSocket_, &one, 1, 0);
+    }
+
+    void Stop() {
+        running_.store(false);
+        Wake();
+    }
+
+    void Enqueue(const Command& command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            commands_.push_back(command);
+        }
+        Wake();
+    }
+
+    CdpSyncStats Stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    // Wake() sends a byte to this UDP socket, which is connected to itself,
+    // so one poll() (or WSAPoll()) call waits for commands and connections
+    bool OpenWakeSocket() {
+        wakeSocket_ = OpenSocket(AF_INET, SOCK_DGRAM);
+        if (wakeSocket_ == kNoSocket) {
+            return false;
+        }
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        auto* raw = reinterpret_cast<sockaddr*>(&address);
+        return bind(wakeSocket_, raw, sizeof(address)) == 0 && getsockname(wakeSocket_, raw, &length) == 0 &&
+               connect(wakeSocket_, raw, length) == 0;
+    }
+
+    void Connect(size_t index) {
+        Connection& conn = connections_[index];
+        conn.retryAt = NowMs() + kRetryDelayMs;
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICSERV;
+        addrinfo* addresses = nullptr;
+        std::string port = std::to_string(conn.url.port);
+        if (getaddrinfo(conn.url.host.c_str(), port.c_str(), &hints, &addresses) != 0 || !addresses) {
+            return;
+        }
+
+        SocketHandle fd = OpenSocket(addresses->ai_family, SOCK_STREAM);
+        if (fd == kNoSocket) {
+            freeaddrinfo(addresses);
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+        int result = connect(fd, addresses->ai_addr, static_cast<socklen_t>(addresses->ai_addrlen));
+        freeaddrinfo(addresses);
+        if (result < 0 && !ConnectPending(SocketError())) {
+            CloseSocket(fd);
+            return;
+        }
+
+        if (conn.everOpened) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.reconnects++;
+        }
+        conn.fd = fd;
+        conn.state = ConnectionState::Connecting;
+    }
+
+    void FinishConnect(size_t index) {
+        Connection& conn = connections_[index];
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) < 0 || error != 0) {
+            CloseConnection(index);
+            return;
+        }
+        conn.state = ConnectionState::Handshaking;
+        conn.key = MakeWebSocketKey();
+        std::string request = BuildWebSocketHandshake(conn.url, conn.key);
+        conn.out.insert(conn.out.end(), request.begin(), request.end());
+    }
+
+    void CloseConnection(size_t index) {
+        Connection& conn = connections_[index];
+        if (conn.fd != kNoSocket) {
+            CloseSocket(conn.fd);
+        }
+        if (conn.state == ConnectionState::Open) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.connected--;
+        }
+        conn.fd = kNoSocket;
+        conn.state = ConnectionState::Idle;
+        conn.in.clear();
+        conn.out.clear();
+        conn.outOffset = 0;
+        conn.message.clear();
+    }
+
+    void ReadFrom(size_t index) {
+        Connection& conn = connections_[index];
+        char chunk[16384];
+        while (true) {
+            auto received = recv(conn.fd, chunk, sizeof(chunk), 0);
+            if (received > 0) {
+                conn.in.insert(conn.in.end(), chunk, chunk + received);
+                continue;
+            }
+            int error = received < 0 ? SocketError() : 0;
+            if (received < 0 && WouldBlock(error)) {
+                break;
+            }
+            if (received < 0 && Interrupted(error)) {
+                continue;
+            }
+            ProcessInput(index);
+            CloseConnection(index);
+            return;
+        }
+        if (!ProcessInput(index)) {
+            CloseConnection(index);
+        }
+    }
+
+    bool ProcessInput(size_t index) {
+        Connection& conn = connections_[index];
+        size_t offset = 0;
+
+        if (conn.state == ConnectionState::Handshaking) {
+            size_t headerLength = 0;
+            HandshakeState state = ParseWebSocketHandshake(conn.in.data(), conn.in.size(), conn.key, headerLength);
+            if (state == HandshakeState::Incomplete) {
+                return true;
+            }
+            if (state == HandshakeState::Rejected) {
+                LOG_ERROR("DevTools endpoint rejected the WebSocket handshake: " << conn.url.path);
+                return false;
+            }
+            offset = headerLength;
+            conn.state = ConnectionState::Open;
+            conn.everOpened = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.connected++;
+            }
+            OnOpen(conn);
+        }
+
+        bool keep = true;
+        while (keep && offset < conn.in.size()) {
+            WebSocketFrame frame;
+            FrameResult result =
+                ReadWebSocketFrame(conn.in.data() + offset, conn.in.size() - offset, kMaxMessage, frame);
+            if (result == FrameResult::Incomplete) {
+                break;
+            }
+            if (result == FrameResult::Error) {
+                return false;
+            }
+            offset += frame.frameLength;
+
+            switch (frame.opcode) {
+                case WebSocketOpcode::Text:
+                case WebSocketOpcode::Binary:
+                case WebSocketOpcode::Continuation:
+                    if (conn.message.size() + frame.length > kMaxMessage) {
+                        return false;
+                    }
+                    conn.message.append(reinterpret_cast<const char*>(frame.payload), frame.length);
+                    if (frame.final) {
+                        OnMessage(conn, conn.message);
+                        conn.message.clear();
+                    }
+                    break;
+                case WebSocketOpcode::Ping:
+                    AppendWebSocketFrame(conn.out, WebSocketOpcode::Pong, frame.payload, frame.length, NextMask());
+                    break;
+                case WebSocketOpcode::Pong:
+                    break;
+                case WebSocketOpcode::Close:
+                    keep = false;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        conn.in.erase(conn.in.begin(), conn.in.begin() + static_cast<std::ptrdiff_t>(offset));
+        return keep;
+    }
+
+    void OnOpen(Connection& conn) {
+        if (conn.master) {
+            Send(conn, "Runtime.enable", "{}");
+            Send(conn, "Runtime.addBinding", std::string("{\"name\":\"") + kBindingName + "\"}");
+            Send(conn, "Page.addScriptToEvaluateOnNewDocument", std::string("{\"source\":\"") + kScrollHook + "\"}");
+            Send(conn, "Runtime.evaluate", std::string("{\"expression\":\"") + kScrollHook + "\"}");
+        } else if (hasForwarded_) {
+            // Bring a (re)connected slave to the current position
+            SendScroll(conn, forwardedX_, forwardedY_);
+        }
+    }
+
+    void OnMessage(Connection& conn, const std::string& message) {
+        if (message.compare(0, 6, "{\"id\":") == 0) {
+            if (message.find("\"error\":") != std::string::npos) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.commandErrors++;
+            }
+            return;
+        }
+        if (!conn.master || message.find("\"method\":\"Runtime.bindingCalled\"") == std::string::npos ||
+            message.find(std::string("\"name\":\"") + kBindingName + "\"") == std::string::npos) {
+            return;
+        }
+
+        size_t payload = message.find("\"payload\":\"");
+        if (payload == std::string::npos) {
+            return;
+        }
+        const char* text = message.c_str() + payload + 11;
+        char* end = nullptr;
+        long x = strtol(text, &end, 10);
+        if (end == text || *end != ',') {
+            return;
+        }
+        const char* next = end + 1;
+        long y = strtol(next, &end, 10);
+        if (end == next) {
+            return;
+        }
+
+        pendingX_ = static_cast<int>(x);
+        pendingY_ = static_cast<int>(y);
+        hasPending_ = true;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.scrollEvents++;
+    }
+
+    void ForwardScroll() {
+        if (!hasPending_) {
+            return;
+        }
+        hasPending_ = false;
+        if (hasForwarded_ && pendingX_ == forwardedX_ && pendingY_ == forwardedY_) {
+            return;
+        }
+        forwardedX_ = pendingX_;
+        forwardedY_ = pendingY_;
+        hasForwarded_ = true;
+        for (auto& conn : connections_) {
+            if (!conn.master && conn.state == ConnectionState::Open) {
+                SendScroll(conn, forwardedX_, forwardedY_);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.scrollsForwarded++;
+    }
+
+    void DrainCommands() {
+        std::vector<Command> commands;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            commands.swap(commands_);
+        }
+        for (const Command& command : commands) {
+            for (auto& conn : connections_) {
+                if (conn.master || conn.state != ConnectionState::Open) {
+                    continue;
+                }
+                if (command.wheel) {
+                    std::string params = "{\"type\":\"mouseWheel\",\"x\":" + std::to_string(command.x) +
+                                         ",\"y\":" + std::to_string(command.y) +
+                                         ",\"deltaX\":" + std::to_string(command.deltaX) +
+                                         ",\"deltaY\":" + std::to_string(command.deltaY) + "}";
+                    Send(conn, "Input.dispatchMouseEvent", params);
+                } else {
+                    SendScroll(conn, command.x, command.y);
+                }
+            }
+            if (!command.wheel) {
+                forwardedX_ = command.x;
+                forwardedY_ = command.y;
+                hasForwarded_ = true;
+            }
+        }
+    }
+
+    void SendScroll(Connection& conn, int x, int y) {
+        Send(conn, "Runtime.evaluate",
+             "{\"expression\":\"window.scrollTo(" + std::to_string(x) + "," + std::to_string(y) + ")\"}");
+    }
+
+    void Send(Connection& conn, const char* method, const std::string& params) {
+        if (conn.out.size() - conn.outOffset > kMaxPendingOutput) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.commandsDropped++;
+            return;
+        }
+        std::string message = "{\"id\":" + std::to_string(conn.nextId++) + ",\"method\":\"" + method +
+                              "\",\"params\":" + params + "}";
+        AppendWebSocketFrame(conn.out, WebSocketOpcode::Text, reinterpret_cast<const uint8_t*>(message.data()),
+                             message.size(), NextMask());
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.commandsSent++;
+    }
+
+    void FlushAll() {
+        for (size_t i = 0; i < connections_.size(); i++) {
+            Connection& conn = connections_[i];
+            if (conn.fd == kNoSocket || conn.state == ConnectionState::Connecting) {
+                continue;
+            }
+            bool failed = false;
+            while (conn.outOffset < conn.out.size()) {
+                auto sent = send(conn.fd, reinterpret_cast<const char*>(conn.out.data()) + conn.outOffset,
+                                 static_cast<int>(conn.out.size() - conn.outOffset), kSendFlags);
+                if (sent > 0) {
+                    conn.outOffset += static_cast<size_t>(sent);
+                    continue;
+                }
+                int error = sent < 0 ? SocketError() : 0;
+                if (sent < 0 && Interrupted(error)) {
+                    continue;
+                }
+                failed = sent == 0 || !WouldBlock(error);
+                break;
+            }
+            if (failed) {
+                CloseConnection(i);
+                continue;
+            }
+            if (conn.outOffset == conn.out.size()) {
+                conn.out.clear();
+                conn.outOffset = 0;
+            }
+        }
+    }
+
+    uint32_t NextMask() {
+        return static_cast<uint32_t>(random_());
+    }
+
+    std::string masterUrl_;
+    std::vector<std::string> slaveUrls_;
+    std::vector<Connection> connections_;
+    SocketHandle wakeSocket_ = kNoSocket;
+#ifdef _WIN32
+    bool winsockStarted_ = false;
+#endif
+    std::atomic<bool> running_{true};
+    std::minstd_rand random_{std::random_device{}()};
+
+    // Loop thread only
+    bool hasPending_ = false;
+    int pendingX_ = 0;
+    int pendingY_ = 0;
+    bool hasForwarded_ = false;
+    int forwardedX_ = 0;
+    int forwardedY_ = 0;
+
+    mutable std::mutex mutex_;
+    std::vector<Command> commands_;
+    CdpSyncStats stats_;
+};
+
+CdpSync::CdpSync(const std::string& masterUrl, const std::vector<std::string>& slaveUrls)
+    : masterUrl_(masterUrl), slaveUrls_(slaveUrls) {}
+
+CdpSync::~CdpSync() {
+    Stop();
+}
+
+bool CdpSync::Start() {
+    Stop();
+    auto loop = std::make_unique<Loop>(masterUrl_, slaveUrls_);
+    if (!loop->Init()) {
+        return false;
+    }
+    loop_ = std::move(loop);
+    Loop* running = loop_.get();
+    thread_ = std::thread([running] { running->Run(); });
+    return true;
+}
+
+void CdpSync::Stop() {
+    if (loop_) {
+        loop_->Stop();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    loop_.reset();
+}
+
+void CdpSync::ScrollTo(int x, int y) {
+    if (loop_) {
+        Command command;
+        command.x = x;
+        command.y = y;
+        loop_->Enqueue(command);
+    }
+}
+
+void CdpSync::DispatchWheel(int x, int y, int deltaX, int deltaY) {
+    if (loop_) {
+        Command command;
+        command.wheel = true;
+        command.x = x;
+        command.y = y;
+        command.deltaX = deltaX;
+        command.deltaY = deltaY;
+        loop_->Enqueue(command);
+    }
+}
+
+CdpSyncStats CdpSync::Stats() const {
+    if (loop_) {
+        return loop_->Stats();
+    }
+    return CdpSyncStats();
+}
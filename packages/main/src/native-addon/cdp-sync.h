@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scroll synchronization over the Chrome DevTools Protocol.
+//
+// One background thread holds a raw WebSocket to the page target of the
+// master and of every slave, all on a single poll() loop (WSAPoll() on
+// Windows); callers keep their own fallback for when Start() fails. The
+// master page gets a Runtime binding that reports scroll changes, at most once
+// per animation frame, so its position is never queried. Every loop iteration
+// coalesces the reports to the latest position and writes one Runtime.evaluate
+// scrollTo to each slave without waiting for earlier replies. Closed
+// connections are retried.
+struct CdpSyncStats {
+    int endpoints = 0;
+    int connected = 0;
+    uint64_t scrollEvents = 0;      // scroll reports received from the master
+    uint64_t scrollsForwarded = 0;  // positions fanned out after coalescing
+    uint64_t commandsSent = 0;
+    uint64_t commandErrors = 0;     // replies carrying an error
+    uint64_t commandsDropped = 0;   // skipped because a slave stopped reading
+    uint64_t reconnects = 0;
+};
+
+class CdpSync {
+public:
+    // URLs are page level DevTools endpoints (webSocketDebuggerUrl of /json/list)
+    CdpSync(const std::string& masterUrl, const std::vector<std::string>& slaveUrls);
+    ~CdpSync();
+
+    CdpSync(const CdpSync&) = delete;
+    CdpSync& operator=(const CdpSync&) = delete;
+
+    // False when the platform has no backend or a URL cannot be used
+    bool Start();
+    void Stop();
+
+    // Queue commands for every slave; they go out on the next loop iteration
+    void ScrollTo(int x, int y);
+    void DispatchWheel(int x, int y, int deltaX, int deltaY);
+
+    CdpSyncStats Stats() const;
+
+    // Event loop, defined in cdp-sync.cpp
+    class Loop;
+
+private:
+    std::string masterUrl_;
+    std::vector<std::string> slaveUrls_;
+    std::unique_ptr<Loop> loop_;
+    std::thread thread_;
+};
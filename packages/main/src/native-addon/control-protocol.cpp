@@ -0,0 +1,114 @@
+#include "control-protocol.h"
+
+FrameState PeekControlFrame(const uint8_t* data, size_t length, const uint8_t*& payload,
+                            size_t& payloadLength, size_t& frameLength) {
+    if (length < kControlFrameHeader) {
+        return FrameState::Incomplete;
+    }
+    ProtocolReader header(data, kControlFrameHeader);
+    uint32_t size = header.U32();
+    if (size > kMaxControlFrame) {
+        return FrameState::Oversized;
+    }
+    if (length - kControlFrameHeader < size) {
+        return FrameState::Incomplete;
+    }
+    payload = data + kControlFrameHeader;
+    payloadLength = size;
+    frameLength = kControlFrameHeader + size;
+    return FrameState::Complete;
+}
+
+void ProtocolWriter::BeginFrame() {
+    frameStart_ = out_.size();
+    U32(0);
+}
+
+void ProtocolWriter::EndFrame() {
+    uint32_t size = static_cast<uint32_t>(out_.size() - frameStart_ - kControlFrameHeader);
+    for (int i = 0; i < 4; i++) {
+        out_[frameStart_ + i] = static_cast<uint8_t>(size >> (i * 8));
+    }
+}
+
+void ProtocolWriter::U16(uint16_t value) {
+    out_.push_back(static_cast<uint8_t>(value));
+    out_.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void ProtocolWriter::U32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out_.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+void ProtocolWriter::U64(uint64_t value) {
+    U32(static_cast<uint32_t>(value));
+    U32(static_cast<uint32_t>(value >> 32));
+}
+
+void ProtocolWriter::Varint(uint64_t value) {
+    while (value >= 0x80) {
+        out_.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out_.push_back(static_cast<uint8_t>(value));
+}
+
+bool ProtocolReader::Take(size_t count) {
+    if (!ok_ || static_cast<size_t>(end_ - data_) < count) {
+        ok_ = false;
+        return false;
+    }
+    return true;
+}
+
+uint8_t ProtocolReader::U8() {
+    if (!Take(1)) {
+        return 0;
+    }
+    return *data_++;
+}
+
+uint16_t ProtocolReader::U16() {
+    if (!Take(2)) {
+        return 0;
+    }
+    uint16_t value = static_cast<uint16_t>(data_[0] | (data_[1] << 8));
+    data_ += 2;
+    return value;
+}
+
+uint32_t ProtocolReader::U32() {
+    if (!Take(4)) {
+        return 0;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(data_[i]) << (i * 8);
+    }
+    data_ += 4;
+    return value;
+}
+
+uint64_t ProtocolReader::U64() {
+    uint64_t low = U32();
+    uint64_t high = U32();
+    return low | (high << 32);
+}
+
+uint64_t ProtocolReader::Varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (!Take(1)) {
+            return 0;
+        }
+        uint8_t byte = *data_++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    ok_ = false;
+    return 0;
+}
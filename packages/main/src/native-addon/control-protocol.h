@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Wire format of the window-daemon control socket.
+//
+// Every message is a frame: a u32 payload length followed by the payload.
+// A request payload is {u32 id, u8 opcode, body} and its response is
+// {u32 id, u8 status, body}. Clients may pipeline any number of requests;
+// responses come back in request order with the id echoed. All integers
+// are little-endian, i32 is signed.
+//
+//   Ping          -> (empty)
+//   ListWindows   u16 n, i32 pid[n]
+//                 -> per pid: u16 m, m x {u32 window, u8 isExtension, i32 x, i32 y, i32 width, i32 height}
+//   GetMonitors   -> u8 n, n x {i32 x, i32 y, i32 width, i32 height, u8 isPrimary}
+//   Arrange       i32 mainPid, u16 n, i32 childPid[n], u16 columns, i32 width, i32 height,
+//                 i32 spacing, u8 monitorIndex, u8 force
+//                 -> u32 moved, u32 skipped, u32 missing
+//   PointerEvent  i32 pid, i32 x, i32 y, u8 event (see PointerEventCode) -> u8 delivered
+//   WheelEvent    i32 pid, i32 deltaX, i32 deltaY, i32 x, i32 y -> u8 delivered
+//   WindowOp      u8 op (see WindowOpCode), u8 value, u16 n, i32 pid[n]
+//                 -> per pid: u16 windows changed
+//   KeyEvent      i32 pid, u8 keycode (X keycode), u8 event (see KeyEventCode),
+//                 i32 x, i32 y (-1, -1 for the main window) -> u8 delivered
+
+enum class ControlOpcode : uint8_t {
+    Ping = 0,
+    ListWindows = 1,
+    GetMonitors = 2,
+    Arrange = 3,
+    PointerEvent = 4,
+    WheelEvent = 5,
+    WindowOp = 6,
+    KeyEvent = 7,
+};
+
+enum class ControlStatus : uint8_t {
+    Ok = 0,
+    UnknownOpcode = 1,
+    Malformed = 2,
+    Failed = 3,
+};
+
+enum class PointerEventCode : uint8_t {
+    Move = 0,
+    LeftDown = 1,
+    LeftUp = 2,
+    RightDown = 3,
+    RightUp = 4,
+};
+
+enum class KeyEventCode : uint8_t {
+    Down = 0,
+    Up = 1,
+};
+
+enum class WindowOpCode : uint8_t {
+    Minimize = 0,
+    Restore = 1,
+    Hide = 2,
+    Show = 3,
+    Close = 4,
+    BringToFront = 5,
+    SetAlwaysOnTop = 6,
+};
+
+// Frames larger than this are a protocol error and close the connection
+constexpr uint32_t kMaxControlFrame = 1 << 20;
+constexpr size_t kControlFrameHeader = 4;
+
+enum class FrameState {
+    Incomplete,
+    Complete,
+    Oversized,
+};
+
+// Looks for a frame at the start of data. On Complete, payload and
+// payloadLength describe it and frameLength is the number of bytes it used.
+FrameState PeekControlFrame(const uint8_t* data, size_t length, const uint8_t*& payload,
+                            size_t& payloadLength, size_t& frameLength);
+
+class ProtocolWriter {
+public:
+    explicit ProtocolWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    // Reserve the length prefix; EndFrame fills it in
+    void BeginFrame();
+    void EndFrame();
+
+    void U8(uint8_t value) { out_.push_back(value); }
+    void U16(uint16_t value);
+    void U32(uint32_t value);
+    void U64(uint64_t value);
+    void I32(int32_t value) { U32(static_cast<uint32_t>(value)); }
+    // LEB128, and zigzag LEB128 for signed values: small numbers take a byte
+    void Varint(uint64_t value);
+    void Signed(int64_t value) { Varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); }
+
+private:
+    std::vector<uint8_t>& out_;
+    size_t frameStart_ = 0;
+};
+
+// Reads stop at the end of the payload: a short read sets ok() to false and
+// returns 0, so decoders check ok() once after reading all fields.
+class ProtocolReader {
+public:
+    ProtocolReader(const uint8_t* data, size_t length) : data_(data), end_(data + length) {}
+
+    uint8_t U8();
+    uint16_t U16();
+    uint32_t U32();
+    uint64_t U64();
+    int32_t I32() { return static_cast<int32_t>(U32()); }
+    uint64_t Varint();
+    int64_t Signed() {
+        uint64_t value = Varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    bool ok() const { return ok_; }
+    bool AtEnd() const { return data_ == end_; }
+
+private:
+    bool Take(size_t count);
+
+    const uint8_t* data_;
+    const uint8_t* end_;
+    bool ok_ = true;
+};
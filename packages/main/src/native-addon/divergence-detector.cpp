@@ -0,0 +1,124 @@
+#include "divergence-detector.h"
+
+#include <algorithm>
+
+#include "image-ops.h"
+
+DivergenceDetector::DivergenceDetector(const DivergenceOptions& options, int masterPid,
+                                       const std::vector<int>& slavePids, ReportCallback callback)
+    : options_(options),
+      callback_(std::move(callback)),
+      cellCount_(static_cast<size_t>(options.columns) * options.rows) {
+    ThumbnailOptions captureOptions;
+    captureOptions.width = options_.columns * kHashCellWidth;
+    captureOptions.height = options_.rows * kHashCellHeight;
+    captureOptions.intervalMs = options_.intervalMs;
+
+    size_t slotCount = slavePids.size() + 1;
+    poolData_.resize(slotCount * ThumbnailPool::SlotSizeFor(captureOptions.width, captureOptions.height));
+    capture_ = std::make_unique<ThumbnailCapture>(captureOptions, poolData_.data(), slotCount);
+
+    std::vector<int> targets;
+    targets.reserve(slotCount);
+    targets.push_back(masterPid);
+    targets.insert(targets.end(), slavePids.begin(), slavePids.end());
+    capture_->SetTargets(targets);
+    capture_->SetCycleCallback([this](ThumbnailPool& pool, const std::vector<size_t>& updated) {
+        OnCycle(pool, updated);
+    });
+
+    hashes_.assign(slotCount * cellCount_, 0);
+    hashed_.assign(slotCount, false);
+    wasDiverged_.assign(slavePids.size(), false);
+
+    reports_.resize(slavePids.size());
+    for (size_t i = 0; i < slavePids.size(); i++) {
+        reports_[i].pid = slavePids[i];
+        reports_[i].missing = true;
+    }
+}
+
+DivergenceDetector::~DivergenceDetector() {
+    Stop();
+}
+
+void DivergenceDetector::Start() {
+    capture_->Start();
+}
+
+void DivergenceDetector::Stop() {
+    capture_->Stop();
+}
+
+std::vector<DivergenceReport> DivergenceDetector::Reports() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reports_;
+}
+
+void DivergenceDetector::OnCycle(ThumbnailPool& pool, const std::vector<size_t>& updated) {
+    for (size_t slot = 0; slot < pool.SlotCount(); slot++) {
+        // A window that disappeared leaves its last frame behind, drop its hashes
+        if (pool.Header(slot)->flags & kThumbnailMissing) {
+            hashed_[slot] = false;
+        }
+    }
+    if (updated.empty() && hashed_[0]) {
+        return;
+    }
+
+    bool masterChanged = false;
+    for (size_t slot : updated) {
+        const ThumbnailSlotHeader* header = pool.Header(slot);
+        ComputeGridHashes(pool.Pixels(slot), static_cast<int>(header->stride),
+                          options_.columns, options_.rows, &hashes_[slot * cellCount_]);
+        hashed_[slot] = true;
+        masterChanged = masterChanged || slot == 0;
+    }
+
+    std::vector<DivergenceReport> reports;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < reports_.size(); i++) {
+            size_t slot = i + 1;
+            // Slaves are only re-scored when their own frame or the master's changed
+            if (masterChanged || std::find(updated.begin(), updated.end(), slot) != updated.end() ||
+                !hashed_[slot] || !hashed_[0]) {
+                Compare(pool, slot, reports_[i]);
+            }
+        }
+        reports = reports_;
+    }
+
+    bool notify = false;
+    for (size_t i = 0; i < reports.size(); i++) {
+        notify = notify || reports[i].diverged || reports[i].diverged != wasDiverged_[i];
+        wasDiverged_[i] = reports[i].diverged;
+    }
+    if (notify && callback_) {
+        callback_(std::move(reports));
+    }
+}
+
+void DivergenceDetector::Compare(ThumbnailPool& pool, size_t slot, DivergenceReport& report) {
+    report.cells.clear();
+    report.score = 0;
+    report.diverged = false;
+    report.missing = !hashed_[0] || !hashed_[slot] || !(pool.Header(slot)->flags & kThumbnailValid);
+    if (report.missing) {
+        return;
+    }
+
+    const uint64_t* master = &hashes_[0];
+    const uint64_t* slave = &hashes_[slot * cellCount_];
+    int totalBits = 0;
+    for (size_t cell = 0; cell < cellCount_; cell++) {
+        int distance = HammingDistance(master[cell], slave[cell]);
+        totalBits += distance;
+        if (distance > options_.cellThreshold) {
+            report.cells.push_back(static_cast<int>(cell));
+        }
+    }
+
+    report.score = static_cast<double>(totalBits) / static_cast<double>(cellCount_ * 64);
+    report.diverged = report.score >= options_.scoreThreshold;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thumbnail-capture.h"
+
+// Visual desync detection between the master window and its slaves.
+//
+// Every window is captured at (columns * 9) x (rows * 8) pixels through a
+// private ThumbnailCapture, and each 9x8 cell is reduced to a 64-bit dHash.
+// A slave's score is the fraction of hash bits that differ from the master
+// (0 = identical, ~0.5 = unrelated content); cells whose Hamming distance
+// exceeds cellThreshold are reported individually so the UI can highlight
+// where the pages drifted apart.
+struct DivergenceOptions {
+    int columns = 8;
+    int rows = 6;
+    int intervalMs = 500;
+    // Bits out of 64 a cell may differ before it counts as divergent
+    int cellThreshold = 12;
+    // Score at or above which a slave is reported as diverged
+    double scoreThreshold = 0.08;
+};
+
+struct DivergenceReport {
+    int pid = 0;
+    double score = 0;
+    bool diverged = false;
+    // No window found, or nothing captured yet
+    bool missing = false;
+    // Row-major indices (row * columns + column) of the cells that differ
+    std::vector<int> cells;
+};
+
+class DivergenceDetector {
+public:
+    // Called on the capture thread with one report per slave whenever a slave
+    // is diverged or has just changed state
+    using ReportCallback = std::function<void(std::vector<DivergenceReport> reports)>;
+
+    DivergenceDetector(const DivergenceOptions& options, int masterPid,
+                       const std::vector<int>& slavePids, ReportCallback callback);
+    ~DivergenceDetector();
+
+    DivergenceDetector(const DivergenceDetector&) = delete;
+    DivergenceDetector& operator=(const DivergenceDetector&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Latest report for every slave, in slavePids order
+    std::vector<DivergenceReport> Reports() const;
+
+    ThumbnailStats Stats() const { return capture_->Stats(); }
+
+private:
+    void OnCycle(ThumbnailPool& pool, const std::vector<size_t>& updated);
+    void Compare(ThumbnailPool& pool, size_t slot, DivergenceReport& report);
+
+    DivergenceOptions options_;
+    ReportCallback callback_;
+    size_t cellCount_;
+
+    // Pixel pool for the private capture; slot 0 is the master
+    std::vector<uint8_t> poolData_;
+    std::unique_ptr<ThumbnailCapture> capture_;
+
+    // Only touched on the capture thread
+    std::vector<uint64_t> hashes_;
+    std::vector<bool> hashed_;
+    std::vector<bool> wasDiverged_;
+
+    mutable std::mutex mutex_;
+    std::vector<DivergenceReport> reports_;
+};
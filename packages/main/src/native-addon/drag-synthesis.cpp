@@ -0,0 +1,353 @@
+#include "drag-synthesis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include "addon-core.h"
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#include <time.h>
+
+#include <cerrno>
+#endif
+
+namespace {
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+#ifdef __linux__
+// steady_clock is CLOCK_MONOTONIC, so NowUs() deadlines carry over
+void SleepUntilUs(int64_t deadlineUs) {
+    timespec deadline{static_cast<time_t>(deadlineUs / 1000000), static_cast<long>(deadlineUs % 1000000) * 1000};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+}
+#endif
+
+// The deadline after this one, skipping those already missed rather than
+// catching up with a burst
+int64_t NextDeadline(int64_t deadlineUs, int64_t intervalUs, int64_t nowUs) {
+    deadlineUs += intervalUs;
+    return deadlineUs > nowUs ? deadlineUs : nowUs + intervalUs;
+}
+
+}  // namespace
+
+struct DragSynthesizer::Drag {
+    struct Bounds {
+        bool valid = false;
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Sample {
+        int64_t us;
+        int x;
+        int y;
+    };
+
+    int masterPid = 0;
+    std::vector<int> slavePids;
+    int x = 0;
+    int y = 0;
+    DragOptions options;
+    int64_t startUs = 0;
+
+    Bounds master;
+    std::vector<Bounds> slaves;
+    // Master positions from the replay position on, oldest first
+    std::deque<Sample> path;
+    // Last position sent, in master coordinates
+    int sentX = 0;
+    int sentY = 0;
+    // Counted since the last stats update
+    uint64_t injected = 0;
+    uint64_t missed = 0;
+
+    // Position on the path at time us: interpolated between the samples
+    // around it, or the last sample once us is past it. Drops the samples
+    // that lie behind.
+    void Position(int64_t us, int& outX, int& outY) {
+        while (path.size() >= 2 && path[1].us <= us) {
+            path.pop_front();
+        }
+        const Sample& from = path.front();
+        if (path.size() == 1 || us <= from.us) {
+            outX = from.x;
+            outY = from.y;
+            return;
+        }
+        const Sample& to = path[1];
+        double t = static_cast<double>(us - from.us) / static_cast<double>(to.us - from.us);
+        outX = from.x + static_cast<int>(std::lround((to.x - from.x) * t));
+        outY = from.y + static_cast<int>(std::lround((to.y - from.y) * t));
+    }
+};
+
+DragSynthesizer::DragSynthesizer(std::shared_ptr<AddonCore> core)
+#ifdef __linux__
+    : control_(std::move(core))
+#endif
+{
+#ifndef __linux__
+    (void)core;
+#endif
+}
+
+DragSynthesizer::~DragSynthesizer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool DragSynthesizer::Begin(int masterPid, const std::vector<int>& slavePids, int x, int y,
+                            const DragOptions& options) {
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) {
+        return false;
+    }
+    if (!thread_.joinable()) {
+        if (!control_.IsOpen()) {
+            return false;
+        }
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    auto drag = std::make_unique<Drag>();
+    drag->masterPid = masterPid;
+    drag->slavePids = slavePids;
+    drag->x = x;
+    drag->y = y;
+    drag->options = options;
+    drag->startUs = NowUs();
+    pending_ = std::move(drag);
+    active_ = true;
+    ending_ = false;
+    wake_.notify_one();
+    return true;
+#else
+    (void)masterPid;
+    (void)slavePids;
+    (void)x;
+    (void)y;
+    (void)options;
+    return false;
+#endif
+}
+
+bool DragSynthesizer::End(int x, int y) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_ || ending_) {
+        return false;
+    }
+    ending_ = true;
+    endX_ = x;
+    endY_ = y;
+    endUs_ = NowUs();
+    return true;
+}
+
+DragStats DragSynthesizer::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void DragSynthesizer::Run() {
+#ifdef __linux__
+    // Wake on the deadline rather than up to the default 50us after it
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopping_ || pending_; });
+        if (stopping_) {
+            return;
+        }
+        std::unique_ptr<Drag> drag = std::move(pending_);
+        lock.unlock();
+        bool pressed = Press(*drag);
+        lock.lock();
+
+        if (!pressed) {
+            active_ = false;
+            stats_.dropped++;
+            continue;
+        }
+        stats_.drags++;
+        stats_.active = true;
+
+        lock.unlock();
+        Replay(*drag);
+        lock.lock();
+        active_ = false;
+        stats_.active = false;
+    }
+#endif
+}
+
+#ifdef __linux__
+
+bool DragSynthesizer::Press(Drag& drag) {
+    std::vector<int> pids;
+    pids.reserve(drag.slavePids.size() + 1);
+    pids.push_back(drag.masterPid);
+    pids.insert(pids.end(), drag.slavePids.begin(), drag.slavePids.end());
+    // Windows may have moved since the last drag
+    control_.InvalidateEventWindows();
+    auto windowsByPid = control_.FindWindowsForPids(pids);
+
+    auto mainBounds = [](const std::vector<X11WindowInfo>& windows) {
+        Drag::Bounds bounds;
+        for (const auto& win : windows) {
+            if (!win.isExtension && win.width > 0 && win.height > 0) {
+                bounds = {true, win.x, win.y, win.width, win.height};
+                break;
+            }
+        }
+        return bounds;
+    };
+    drag.master = mainBounds(windowsByPid[0]);
+    if (!drag.master.valid) {
+        return false;
+    }
+    for (size_t i = 0; i < drag.slavePids.size(); i++) {
+        drag.slaves.push_back(mainBounds(windowsByPid[i + 1]));
+    }
+
+    if (!drag.options.pressed) {
+        Inject(drag, drag.x, drag.y, PointerEvent::Move, 0);
+        Inject(drag, drag.x, drag.y, drag.options.button, 0);
+        control_.Flush();
+    }
+    drag.path.push_back({drag.startUs, drag.x, drag.y});
+    drag.sentX = drag.x;
+    drag.sentY = drag.y;
+    return true;
+}
+
+void DragSynthesizer::Replay(Drag& drag) {
+    const DragOptions& options = drag.options;
+    int64_t sampleIntervalUs = 1000000 / std::max(1, options.sampleHz);
+    int64_t tickIntervalUs = 1000000 / std::max(1, options.rateHz);
+    int64_t delayUs = options.delay.count() > 0 ? options.delay.count() : 2 * sampleIntervalUs;
+    int64_t nextSampleUs = drag.startUs + sampleIntervalUs;
+    int64_t nextTickUs = drag.startUs + tickIntervalUs;
+    int64_t maxDurationUs = std::chrono::duration_cast<std::chrono::microseconds>(options.maxDuration).count();
+    int64_t timeoutUs = drag.startUs + maxDurationUs;
+    PointerEvent release = PointerEvent::LeftUp;
+    uint16_t held = XCB_BUTTON_MASK_1;
+    if (options.button == PointerEvent::RightDown) {
+        release = PointerEvent::RightUp;
+        held = XCB_BUTTON_MASK_3;
+    }
+
+    bool ending = false;
+    int64_t endUs = 0;
+    while (true) {
+        int64_t now = NowUs();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bool timedOut = !ending_ && now >= timeoutUs;
+            if (stopping_ || timedOut) {
+                // Release where the slaves are rather than leave the button held
+                Inject(drag, drag.sentX, drag.sentY, release, 0);
+                control_.Flush();
+                stats_.timedOut += timedOut ? 1 : 0;
+                stats_.injected += drag.injected;
+                stats_.missed += drag.missed;
+                return;
+            }
+            if (ending_ && !ending) {
+                // Samples stop here; the path ends where the button came up
+                ending = true;
+                endUs = std::max(endUs_, drag.path.back().us);
+                drag.path.push_back({endUs, endX_, endY_});
+            }
+        }
+
+        if (!ending && now >= nextSampleUs) {
+            int x = 0;
+            int y = 0;
+            if (control_.Connection().PointerPosition(x, y)) {
+                drag.path.push_back({now, x, y});
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.samples++;
+            }
+            nextSampleUs = NextDeadline(nextSampleUs, sampleIntervalUs, now);
+        }
+
+        if (now >= nextTickUs) {
+            double jitterUs = static_cast<double>(now - nextTickUs);
+            int64_t replayUs = now - delayUs;
+            bool done = ending && replayUs >= endUs;
+            int x = 0;
+            int y = 0;
+            drag.Position(replayUs, x, y);
+            bool moved = x != drag.sentX || y != drag.sentY;
+            if (moved) {
+                Inject(drag, x, y, PointerEvent::Move, held);
+                drag.sentX = x;
+                drag.sentY = y;
+            }
+            if (done) {
+                Inject(drag, x, y, release, 0);
+            }
+            if (moved || done) {
+                control_.Flush();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.ticks++;
+                stats_.moves += moved ? 1 : 0;
+                stats_.injected += drag.injected;
+                stats_.missed += drag.missed;
+                jitterTotalUs_ += jitterUs;
+                stats_.avgJitterUs = jitterTotalUs_ / static_cast<double>(stats_.ticks);
+                stats_.maxJitterUs = std::max(stats_.maxJitterUs, jitterUs);
+            }
+            drag.injected = 0;
+            drag.missed = 0;
+            if (done) {
+                return;
+            }
+            nextTickUs = NextDeadline(nextTickUs, tickIntervalUs, now);
+        }
+
+        SleepUntilUs(ending ? nextTickUs : std::min({nextSampleUs, nextTickUs, timeoutUs}));
+    }
+}
+
+// Same relative position in every slave, whatever its size
+void DragSynthesizer::Inject(Drag& drag, int x, int y, PointerEvent event, uint16_t heldButtons) {
+    const Drag::Bounds& master = drag.master;
+    double relativeX = static_cast<double>(x - master.x) / master.width;
+    double relativeY = static_cast<double>(y - master.y) / master.height;
+    for (size_t i = 0; i < drag.slavePids.size(); i++) {
+        const Drag::Bounds& slave = drag.slaves[i];
+        if (!slave.valid) {
+            drag.missed++;
+            continue;
+        }
+        int slaveX = slave.x + static_cast<int>(std::lround(relativeX * slave.width));
+        int slaveY = slave.y + static_cast<int>(std::lround(relativeY * slave.height));
+        bool sent = control_.SendPointerEvent(drag.slavePids[i], slaveX, slaveY, event, heldButtons);
+        sent ? drag.injected++ : drag.missed++;
+    }
+}
+
+#endif
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "window-control.h"
+
+class AddonCore;
+
+// Drags mirrored from the master window onto its slaves.
+//
+// Pointer moves reach JS throttled, so slaves that only get the master's
+// press and release, or its sparse moves, see the pointer jump and sliders,
+// canvases and drag-and-drop go wrong. While a button is held, a dedicated
+// thread samples the real pointer itself at sampleHz and replays the path to
+// every slave as moves at a steady rateHz, placing each move on the path by
+// linear interpolation between the samples around it. Replay runs `delay`
+// behind the samples, so there is always a later sample to interpolate
+// towards. The thread sleeps on absolute deadlines of the monotonic clock
+// with a minimal timer slack, which keeps moves evenly spaced.
+//
+// Positions map onto each slave's main window as in sync sessions; window
+// bounds are read once per drag, on the drag thread, so starting a drag costs
+// the caller no X round trips. Only one drag runs at a time, and one whose
+// button-up never arrives is released after maxDuration.
+//
+// The X11 backend is the only one: Begin() returns false elsewhere and
+// callers keep forwarding moves themselves.
+struct DragOptions {
+    // LeftDown or RightDown
+    PointerEvent button = PointerEvent::LeftDown;
+    // Moves per second sent to the slaves
+    int rateHz = 240;
+    // Pointer samples per second
+    int sampleHz = 500;
+    // How far replay lags behind the samples; 0 picks two sample intervals
+    std::chrono::microseconds delay{0};
+    // The caller already pressed the button on the slaves at x, y: only
+    // replay the path from there and release
+    bool pressed = false;
+    // Released after this long even without End(), as when the mouseup is lost
+    std::chrono::milliseconds maxDuration{30000};
+};
+
+struct DragStats {
+    bool active = false;
+    uint64_t drags = 0;
+    uint64_t dropped = 0;           // drags whose master had no window
+    uint64_t timedOut = 0;          // drags released by maxDuration
+    uint64_t samples = 0;           // pointer positions read
+    uint64_t ticks = 0;             // replay deadlines reached
+    uint64_t moves = 0;             // ticks that moved the slaves
+    uint64_t injected = 0;          // events delivered to a slave window
+    uint64_t missed = 0;            // events for a slave without a window
+    double avgJitterUs = 0;         // how late ticks woke up
+    double maxJitterUs = 0;
+};
+
+class DragSynthesizer {
+public:
+    explicit DragSynthesizer(std::shared_ptr<AddonCore> core);
+    // Releases the button of a drag still running
+    ~DragSynthesizer();
+
+    DragSynthesizer(const DragSynthesizer&) = delete;
+    DragSynthesizer& operator=(const DragSynthesizer&) = delete;
+
+    // Press the button at screen position x, y (inside the master window) on
+    // every slave and start replaying the pointer's path. Returns at once;
+    // the drag thread finds the windows and presses. False when there is no
+    // backend or display, or a drag is already running. A drag whose master
+    // has no window is dropped by the thread and counted in DragStats.
+    bool Begin(int masterPid, const std::vector<int>& slavePids, int x, int y, const DragOptions& options);
+    // The button came up at x, y: replay the rest of the path up to there,
+    // then release. Also ends a drag the thread has not pressed yet. False
+    // when no drag is running.
+    bool End(int x, int y);
+
+    DragStats Stats();
+
+    // Drag thread state, defined in drag-synthesis.cpp
+    struct Drag;
+
+private:
+    void Run();
+#ifdef __linux__
+    bool Press(Drag& drag);
+    void Replay(Drag& drag);
+    void Inject(Drag& drag, int x, int y, PointerEvent event, uint16_t heldButtons);
+#endif
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::unique_ptr<Drag> pending_;
+    // From Begin() until the drag is released or dropped
+    bool active_ = false;
+    bool ending_ = false;
+    int endX_ = 0;
+    int endY_ = 0;
+    int64_t endUs_ = 0;
+    DragStats stats_;
+    double jitterTotalUs_ = 0;
+
+#ifdef __linux__
+    // Drag thread only
+    X11WindowControl control_;
+#endif
+    std::thread thread_;
+};
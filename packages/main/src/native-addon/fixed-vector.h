@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Vector with inline storage for at most N elements, for the per-event
+// scratch data of the input paths, which must not touch the heap. Elements
+// past the capacity are dropped: push_back returns false.
+template <typename T, size_t N>
+class FixedVector {
+public:
+    bool push_back(const T& value) {
+        if (size_ == N) {
+            return false;
+        }
+        items_[size_++] = value;
+        return true;
+    }
+
+    void clear() { size_ = 0; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    T& operator[](size_t index) { return items_[index]; }
+    const T& operator[](size_t index) const { return items_[index]; }
+
+    T* begin() { return items_.data(); }
+    T* end() { return items_.data() + size_; }
+    const T* begin() const { return items_.data(); }
+    const T* end() const { return items_.data() + size_; }
+
+private:
+    std::array<T, N> items_{};
+    size_t size_ = 0;
+};
@@ -0,0 +1,204 @@
+#include "foreground-tracker.h"
+
+#include <future>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include "x11-connection.h"
+#endif
+
+#include "addon-common.h"
+
+ForegroundTracker::~ForegroundTracker() {
+    Stop();
+}
+
+uint64_t ForegroundTracker::AddListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    uint64_t id = nextListenerId_++;
+    listeners_.emplace(id, std::move(listener));
+    return id;
+}
+
+void ForegroundTracker::RemoveListener(uint64_t id) {
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    listeners_.erase(id);
+}
+
+void ForegroundTracker::Publish(int pid) {
+    int previous = activePid_.exchange(pid, std::memory_order_acq_rel);
+    if (previous == pid) {
+        return;
+    }
+    generation_.fetch_add(1, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    for (auto& entry : listeners_) {
+        entry.second(pid, previous);
+    }
+}
+
+#ifdef _WIN32
+
+namespace {
+// The hook has no user data; it only fires on the thread that installed it
+thread_local ForegroundTracker* hookOwner = nullptr;
+}  // namespace
+
+void CALLBACK ForegroundTracker::OnForegroundChanged(HWINEVENTHOOK, DWORD, HWND hwnd, LONG, LONG, DWORD,
+                                                     DWORD) {
+    if (!hookOwner) {
+        return;
+    }
+    DWORD pid = 0;
+    if (hwnd) {
+        GetWindowThreadProcessId(hwnd, &pid);
+    }
+    hookOwner->Publish(static_cast<int>(pid));
+}
+
+bool ForegroundTracker::Start() {
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    std::promise<bool> started;
+    std::future<bool> ready = started.get_future();
+    thread_ = std::thread([this, &started] {
+        MSG msg;
+        // Create the message queue before Stop() can post to it
+        PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+        threadId_ = GetCurrentThreadId();
+        hookOwner = this;
+
+        HWINEVENTHOOK hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL,
+                                             &ForegroundTracker::OnForegroundChanged, 0, 0,
+                                             WINEVENT_OUTOFCONTEXT);
+        if (!hook) {
+            LOG_ERROR("SetWinEventHook failed (LastError: " << GetLastError() << ")");
+            started.set_value(false);
+            return;
+        }
+
+        DWORD pid = 0;
+        HWND foreground = GetForegroundWindow();
+        if (foreground) {
+            GetWindowThreadProcessId(foreground, &pid);
+        }
+        Publish(static_cast<int>(pid));
+        started.set_value(true);
+
+        while (GetMessage(&msg, NULL, 0, 0) > 0) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        UnhookWinEvent(hook);
+        hookOwner = nullptr;
+    });
+
+    if (!ready.get()) {
+        thread_.join();
+        return false;
+    }
+    return true;
+}
+
+void ForegroundTracker::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    PostThreadMessage(threadId_, WM_QUIT, 0, 0);
+    thread_.join();
+}
+
+#elif __linux__
+
+bool ForegroundTracker::Start() {
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    // The watcher owns its connection: the atom cache is not thread-safe
+    x11_ = std::make_unique<X11Connection>();
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!x11_->IsOpen() || wakeFd_ < 0) {
+        x11_.reset();
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+            wakeFd_ = -1;
+        }
+        return false;
+    }
+
+    x11_->SelectRootEvents(XCB_EVENT_MASK_PROPERTY_CHANGE);
+    xcb_window_t active = x11_->ActiveWindow();
+    Publish(active == XCB_NONE ? 0 : x11_->WindowPid(active));
+
+    thread_ = std::thread([this] { Run(); });
+    return true;
+}
+
+void ForegroundTracker::Run() {
+    xcb_connection_t* connection = x11_->Get();
+    xcb_atom_t activeAtom = x11_->Atom("_NET_ACTIVE_WINDOW");
+
+    pollfd fds[2] = {{xcb_get_file_descriptor(connection), POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    while (true) {
+        bool changed = false;
+        while (xcb_generic_event_t* event = xcb_poll_for_event(connection)) {
+            if ((event->response_type & 0x7f) == XCB_PROPERTY_NOTIFY &&
+                reinterpret_cast<xcb_property_notify_event_t*>(event)->atom == activeAtom) {
+                changed = true;
+            }
+            free(event);
+        }
+        if (xcb_connection_has_error(connection)) {
+            LOG_ERROR("Lost the X11 connection, foreground tracking stopped");
+            Publish(0);
+            return;
+        }
+        if (changed) {
+            // Only the latest value matters when several changes queued up.
+            // Events that arrive during the round trips stay queued inside
+            // xcb, so drain again before polling the socket.
+            xcb_window_t active = x11_->ActiveWindow();
+            Publish(active == XCB_NONE ? 0 : x11_->WindowPid(active));
+            continue;
+        }
+
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+    }
+}
+
+void ForegroundTracker::Stop() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd_, &one, sizeof(one));
+        (void)written;
+        thread_.join();
+    }
+    x11_.reset();
+    if (wakeFd_ >= 0) {
+        close(wakeFd_);
+        wakeFd_ = -1;
+    }
+}
+
+#else
+
+bool ForegroundTracker::Start() {
+    return false;
+}
+
+void ForegroundTracker::Stop() {}
+
+#endif
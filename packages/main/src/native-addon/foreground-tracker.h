@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+class X11Connection;
+#endif
+
+// Follows which process owns the foreground window, on a background thread
+// driven by the window system's focus notifications (SetWinEventHook with
+// EVENT_SYSTEM_FOREGROUND on Windows, PropertyNotify for _NET_ACTIVE_WINDOW
+// on X11). Reading the active pid is a single atomic load, so the input paths
+// can check focus per event without asking the window system.
+//
+// macOS has no notification that works off the main run loop, so Start()
+// fails there and callers query the frontmost application themselves.
+class ForegroundTracker {
+public:
+    // pid is the new foreground process, 0 when unknown
+    using Listener = std::function<void(int pid, int previousPid)>;
+
+    ForegroundTracker() = default;
+    ~ForegroundTracker();
+
+    ForegroundTracker(const ForegroundTracker&) = delete;
+    ForegroundTracker& operator=(const ForegroundTracker&) = delete;
+
+    // Start the watcher thread. False when focus changes cannot be followed
+    // (no X display, or macOS).
+    bool Start();
+    void Stop();
+
+    // Owner of the foreground window, 0 when unknown
+    int ActivePid() const { return activePid_.load(std::memory_order_acquire); }
+    // Bumped after every change of ActivePid, for callers caching answers
+    // derived from it. Read this before ActivePid.
+    uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+    // Listeners run on the watcher thread. Once RemoveListener returns the
+    // listener is not called again.
+    uint64_t AddListener(Listener listener);
+    void RemoveListener(uint64_t id);
+
+private:
+    void Publish(int pid);
+
+    std::atomic<int> activePid_{0};
+    std::atomic<uint64_t> generation_{0};
+
+    std::mutex listenerMutex_;
+    std::unordered_map<uint64_t, Listener> listeners_;
+    uint64_t nextListenerId_ = 1;
+
+    std::thread thread_;
+#ifdef _WIN32
+    static void CALLBACK OnForegroundChanged(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG objectId,
+                                             LONG childId, DWORD threadId, DWORD time);
+    DWORD threadId_ = 0;
+#elif __linux__
+    void Run();
+
+    std::unique_ptr<X11Connection> x11_;
+    int wakeFd_ = -1;
+#endif
+};
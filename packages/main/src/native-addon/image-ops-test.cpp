@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include "image-ops.h"
+#include "native-tests.h"
+
+namespace {
+
+// BGRA image with stride padding filled with a marker byte
+struct Image {
+    int width;
+    int height;
+    int stride;
+    std::vector<uint8_t> pixels;
+
+    Image(int w, int h, int padding = 0, uint8_t fill = 0)
+        : width(w), height(h), stride(w * 4 + padding), pixels(static_cast<size_t>(stride) * h, fill) {}
+
+    uint8_t* At(int x, int y) { return pixels.data() + static_cast<size_t>(y) * stride + x * 4; }
+    const uint8_t* At(int x, int y) const { return pixels.data() + static_cast<size_t>(y) * stride + x * 4; }
+
+    void Set(int x, int y, uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+        uint8_t* p = At(x, y);
+        p[0] = b;
+        p[1] = g;
+        p[2] = r;
+        p[3] = a;
+    }
+};
+
+Image Downscale(const Image& src, int width, int height, bool forceOpaque = true, int padding = 0) {
+    Image dst(width, height, padding, 0xAB);
+    DownscaleBGRA(src.pixels.data(), src.width, src.height, src.stride, dst.pixels.data(), width, height, dst.stride,
+                  forceOpaque);
+    return dst;
+}
+
+Image Noise(int width, int height, int padding, unsigned seed) {
+    Image image(width, height, padding, 0xAB);
+    std::srand(seed);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            image.Set(x, y, std::rand() & 0xFF, std::rand() & 0xFF, std::rand() & 0xFF, std::rand() & 0xFF);
+        }
+    }
+    return image;
+}
+
+// Whether every pixel of dst is within 1 of the plain average of the source
+// pixels it covers, spans chosen as DownscaleBGRA documents them
+bool MatchesBoxFilter(const Image& src, const Image& dst, bool forceOpaque) {
+    for (int dy = 0; dy < dst.height; dy++) {
+        int y0 = static_cast<int>(static_cast<int64_t>(dy) * src.height / dst.height);
+        int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(dy + 1) * src.height / dst.height));
+        for (int dx = 0; dx < dst.width; dx++) {
+            int x0 = static_cast<int>(static_cast<int64_t>(dx) * src.width / dst.width);
+            int x1 = std::max(x0 + 1, static_cast<int>(static_cast<int64_t>(dx + 1) * src.width / dst.width));
+            for (int c = 0; c < 4; c++) {
+                double sum = 0;
+                for (int y = y0; y < y1; y++) {
+                    for (int x = x0; x < x1; x++) {
+                        sum += src.At(x, y)[c];
+                    }
+                }
+                int expected = c == 3 && forceOpaque ? 255 : static_cast<int>(sum / ((x1 - x0) * (y1 - y0)) + 0.5);
+                if (std::abs(dst.At(dx, dy)[c] - expected) > 1) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool Uniform(const Image& image, uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            const uint8_t* p = image.At(x, y);
+            if (p[0] != b || p[1] != g || p[2] != r || p[3] != a) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+NATIVE_TEST(DownscaleBGRA, KeepsUniformColour) {
+    // Odd sizes leave vector tails on every row and span
+    for (int width : {1, 3, 17, 37, 333}) {
+        Image src(width, 23);
+        for (int y = 0; y < src.height; y++) {
+            for (int x = 0; x < src.width; x++) {
+                src.Set(x, y, 10, 120, 250, 255);
+            }
+        }
+        NATIVE_CHECK(Uniform(Downscale(src, std::max(1, width / 3), 5), 10, 120, 250, 255));
+    }
+}
+
+NATIVE_TEST(DownscaleBGRA, AveragesEachBox) {
+    Image src(4, 2);
+    src.Set(0, 0, 0, 0, 0, 255);
+    src.Set(1, 0, 40, 80, 200, 255);
+    src.Set(0, 1, 80, 160, 0, 255);
+    src.Set(1, 1, 120, 0, 200, 255);
+    src.Set(2, 0, 255, 255, 255, 255);
+    src.Set(3, 0, 255, 255, 255, 255);
+    src.Set(2, 1, 255, 255, 255, 255);
+    src.Set(3, 1, 255, 255, 255, 255);
+    Image dst = Downscale(src, 2, 1);
+    const uint8_t* left = dst.At(0, 0);
+    const uint8_t* right = dst.At(1, 0);
+    NATIVE_CHECK(left[0] == 60 && left[1] == 60 && left[2] == 100 && left[3] == 255);
+    NATIVE_CHECK(right[0] == 255 && right[1] == 255 && right[2] == 255 && right[3] == 255);
+}
+
+NATIVE_TEST(DownscaleBGRA, MatchesBoxFilterAtUnevenRatios) {
+    struct Size {
+        int srcWidth, srcHeight, dstWidth, dstHeight;
+    } sizes[] = {{1280, 720, 320, 200}, {1366, 768, 160, 90}, {101, 67, 37, 29}, {64, 64, 64, 64}, {7, 5, 2, 3}};
+    unsigned seed = 1;
+    for (const Size& size : sizes) {
+        Image src = Noise(size.srcWidth, size.srcHeight, 12, seed++);
+        NATIVE_CHECK(MatchesBoxFilter(src, Downscale(src, size.dstWidth, size.dstHeight, false), false));
+        NATIVE_CHECK(MatchesBoxFilter(src, Downscale(src, size.dstWidth, size.dstHeight, true), true));
+    }
+}
+
+NATIVE_TEST(DownscaleBGRA, IgnoresStridePadding) {
+    Image src = Noise(50, 30, 0, 7);
+    Image padded(50, 30, 24, 0xFF);
+    for (int y = 0; y < src.height; y++) {
+        std::copy(src.At(0, y), src.At(0, y) + src.width * 4, padded.At(0, y));
+    }
+    Image dst = Downscale(src, 13, 7);
+    Image paddedDst = Downscale(padded, 13, 7, true, 8);
+    bool same = true;
+    for (int y = 0; y < dst.height; y++) {
+        same = same && std::equal(dst.At(0, y), dst.At(0, y) + dst.width * 4, paddedDst.At(0, y));
+        // Destination padding is left alone
+        same = same && paddedDst.At(0, y)[dst.width * 4] == 0xAB;
+    }
+    NATIVE_CHECK(same);
+}
+
+NATIVE_TEST(DownscaleBGRA, KeepsAlphaUnlessForcedOpaque) {
+    Image src(8, 8);
+    for (int y = 0; y < src.height; y++) {
+        for (int x = 0; x < src.width; x++) {
+            src.Set(x, y, 100, 100, 100, 64);
+        }
+    }
+    NATIVE_CHECK(Uniform(Downscale(src, 2, 2, false), 100, 100, 100, 64));
+    NATIVE_CHECK(Uniform(Downscale(src, 2, 2, true), 100, 100, 100, 255));
+}
+
+// Spans taller than the 16-bit accumulator can hold are sampled, not wrapped
+NATIVE_TEST(DownscaleBGRA, TallSpansDoNotOverflow) {
+    Image src(3, 2000, 0, 0xFF);
+    NATIVE_CHECK(Uniform(Downscale(src, 1, 1), 255, 255, 255, 255));
+    NATIVE_CHECK(Uniform(Downscale(src, 2, 3), 255, 255, 255, 255));
+}
+
+NATIVE_TEST(DownscaleBGRA, UpscalesByRepeatingPixels) {
+    Image src = Noise(3, 2, 0, 11);
+    Image dst = Downscale(src, 9, 4, false);
+    bool repeated = true;
+    for (int y = 0; y < dst.height; y++) {
+        for (int x = 0; x < dst.width; x++) {
+            repeated = repeated && std::equal(dst.At(x, y), dst.At(x, y) + 4, src.At(x / 3, y / 2));
+        }
+    }
+    NATIVE_CHECK(repeated);
+}
+
+NATIVE_TEST(DownscaleBGRA, IgnoresEmptyImages) {
+    Image dst(4, 4, 0, 0xAB);
+    DownscaleBGRA(nullptr, 10, 10, 40, dst.pixels.data(), 4, 4, 16);
+    Image src(10, 10, 0, 0);
+    DownscaleBGRA(src.pixels.data(), 0, 10, 40, dst.pixels.data(), 4, 4, 16);
+    DownscaleBGRA(src.pixels.data(), 10, 10, 40, dst.pixels.data(), 0, 4, 16);
+    NATIVE_CHECK(Uniform(dst, 0xAB, 0xAB, 0xAB, 0xAB));
+}
+
+namespace {
+
+// Brightness rising to the right across every 9 pixel cell, or falling
+Image Ramp(int columns, int rows, bool rising, int padding = 0) {
+    Image image(columns * kHashCellWidth, rows * kHashCellHeight, padding, 0xAB);
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            int step = x % kHashCellWidth;
+            uint8_t value = static_cast<uint8_t>(20 + 20 * (rising ? step : kHashCellWidth - 1 - step));
+            image.Set(x, y, value, value, value, 255);
+        }
+    }
+    return image;
+}
+
+std::vector<uint64_t> Hashes(const Image& image, int columns, int rows) {
+    std::vector<uint64_t> hashes(static_cast<size_t>(columns) * rows, 0x5555);
+    ComputeGridHashes(image.pixels.data(), image.stride, columns, rows, hashes.data());
+    return hashes;
+}
+
+// dHash of one cell computed pixel by pixel with the documented weights
+uint64_t CellHash(const Image& image, int column, int row) {
+    uint64_t hash = 0;
+    for (int y = 0; y < kHashCellHeight; y++) {
+        for (int x = 0; x < 8; x++) {
+            const uint8_t* left = image.At(column * kHashCellWidth + x, row * kHashCellHeight + y);
+            const uint8_t* right = left + 4;
+            int leftLuma = (left[0] * 29 + left[1] * 150 + left[2] * 77) >> 8;
+            int rightLuma = (right[0] * 29 + right[1] * 150 + right[2] * 77) >> 8;
+            if (rightLuma > leftLuma) {
+                hash |= uint64_t{1} << (y * 8 + x);
+            }
+        }
+    }
+    return hash;
+}
+
+}  // namespace
+
+NATIVE_TEST(ComputeGridHashes, SetsBitsWhereBrightnessRises) {
+    for (int columns : {1, 3, 8}) {
+        std::vector<uint64_t> rising = Hashes(Ramp(columns, 2, true), columns, 2);
+        std::vector<uint64_t> falling = Hashes(Ramp(columns, 2, false), columns, 2);
+        NATIVE_CHECK(std::all_of(rising.begin(), rising.end(), [](uint64_t h) { return h == ~uint64_t{0}; }));
+        NATIVE_CHECK(std::all_of(falling.begin(), falling.end(), [](uint64_t h) { return h == 0; }));
+    }
+    Image flat(2 * kHashCellWidth, kHashCellHeight, 0, 0x80);
+    std::vector<uint64_t> hashes = Hashes(flat, 2, 1);
+    NATIVE_CHECK(hashes[0] == 0 && hashes[1] == 0);
+}
+
+// The last pixel of a cell is only ever compared with its left neighbour
+NATIVE_TEST(ComputeGridHashes, KeepsCellsApart) {
+    Image image = Ramp(3, 2, false);
+    // Rising only inside cell (column 1, row 1)
+    for (int y = kHashCellHeight; y < 2 * kHashCellHeight; y++) {
+        for (int x = 0; x < kHashCellWidth; x++) {
+            uint8_t value = static_cast<uint8_t>(20 + 20 * x);
+            image.Set(kHashCellWidth + x, y, value, value, value, 255);
+        }
+    }
+    std::vector<uint64_t> hashes = Hashes(image, 3, 2);
+    for (size_t cell = 0; cell < hashes.size(); cell++) {
+        NATIVE_CHECK(hashes[cell] == (cell == 4 ? ~uint64_t{0} : 0));
+    }
+}
+
+NATIVE_TEST(ComputeGridHashes, MatchesPerPixelLuma) {
+    unsigned seed = 21;
+    for (int columns : {1, 2, 5, 8, 13}) {
+        const int rows = 3;
+        Image image = Noise(columns * kHashCellWidth, rows * kHashCellHeight, 16, seed++);
+        std::vector<uint64_t> hashes = Hashes(image, columns, rows);
+        bool same = true;
+        for (int row = 0; row < rows; row++) {
+            for (int column = 0; column < columns; column++) {
+                same = same && hashes[row * columns + column] == CellHash(image, column, row);
+            }
+        }
+        NATIVE_CHECK(same);
+    }
+}
+
+NATIVE_TEST(ComputeGridHashes, SeesOnlyLumaNotAlpha) {
+    Image image = Noise(2 * kHashCellWidth, kHashCellHeight, 0, 5);
+    std::vector<uint64_t> before = Hashes(image, 2, 1);
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            image.At(x, y)[3] = static_cast<uint8_t>(x * 13);
+        }
+    }
+    NATIVE_CHECK(Hashes(image, 2, 1) == before);
+}
+
+NATIVE_TEST(HammingDistance, CountsDifferingBits) {
+    NATIVE_CHECK(HammingDistance(0, 0) == 0);
+    NATIVE_CHECK(HammingDistance(0, ~uint64_t{0}) == 64);
+    NATIVE_CHECK(HammingDistance(0xF0, 0x0F) == 8);
+    NATIVE_CHECK(HammingDistance(uint64_t{1} << 63, 1) == 2);
+}
+
+// The divergence detector's budget: master and 100 slaves hashed and compared
+// on the default 8x6 grid every 500 ms cycle. Best of five rounds, so a busy
+// machine does not fail it.
+NATIVE_TEST(ComputeGridHashes, HundredWindowsFitTheCycleBudget) {
+    const int columns = 8;
+    const int rows = 6;
+    const int windows = 101;
+    std::vector<Image> frames;
+    for (int i = 0; i < windows; i++) {
+        frames.push_back(Noise(columns * kHashCellWidth, rows * kHashCellHeight, 0, 100 + i));
+    }
+    std::vector<uint64_t> hashes(static_cast<size_t>(windows) * columns * rows);
+
+    double best = 1e9;
+    int bits = 0;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < windows; i++) {
+            ComputeGridHashes(frames[i].pixels.data(), frames[i].stride, columns, rows,
+                              &hashes[static_cast<size_t>(i) * columns * rows]);
+        }
+        for (int i = 1; i < windows; i++) {
+            for (int cell = 0; cell < columns * rows; cell++) {
+                bits += HammingDistance(hashes[cell], hashes[static_cast<size_t>(i) * columns * rows + cell]);
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+    }
+    NATIVE_CHECK(bits > 0);
+    // 5% of the 500 ms interval
+    NATIVE_CHECK(best < 25.0);
+}
@@ -0,0 +1,220 @@
+#include "image-ops.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_OPS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define IMAGE_OPS_NEON 1
+#endif
+
+namespace {
+
+// Add one row of 8-bit samples into the 16-bit column accumulator
+void AccumulateRow(const uint8_t* row, uint16_t* acc, int count) {
+    int i = 0;
+#if defined(IMAGE_OPS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i* lo = reinterpret_cast<__m128i*>(acc + i);
+        __m128i* hi = reinterpret_cast<__m128i*>(acc + i + 8);
+        _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(pixels, zero)));
+        _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(pixels, zero)));
+    }
+#elif defined(IMAGE_OPS_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t pixels = vld1q_u8(row + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(pixels)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(pixels)));
+    }
+#endif
+    for (; i < count; i++) {
+        acc[i] = static_cast<uint16_t>(acc[i] + row[i]);
+    }
+}
+
+// Average accumulator pixels [x0, x1) into one BGRA output pixel
+void ReduceSpan(const uint16_t* acc, int x0, int x1, float scale, uint8_t* out, bool forceOpaque) {
+    uint32_t pixel = 0;
+#if defined(IMAGE_OPS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    int x = x0;
+    for (; x + 2 <= x1; x += 2) {
+        __m128i two = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + x * 4));
+        sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(two, zero));
+        sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(two, zero));
+    }
+    if (x < x1) {
+        __m128i one = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(acc + x * 4));
+        sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(one, zero));
+    }
+    __m128i avg = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(scale)));
+    avg = _mm_packs_epi32(avg, avg);
+    avg = _mm_packus_epi16(avg, avg);
+    pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(avg));
+#elif defined(IMAGE_OPS_NEON)
+    uint32x4_t sum = vdupq_n_u32(0);
+    for (int x = x0; x < x1; x++) {
+        sum = vaddw_u16(sum, vld1_u16(acc + x * 4));
+    }
+    float32x4_t scaled = vmlaq_n_f32(vdupq_n_f32(0.5f), vcvtq_f32_u32(sum), scale);
+    uint16x4_t narrow = vqmovn_u32(vcvtq_u32_f32(scaled));
+    uint8x8_t bytes = vqmovn_u16(vcombine_u16(narrow, narrow));
+    pixel = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+#else
+    uint32_t sum[4] = {0, 0, 0, 0};
+    for (int x = x0; x < x1; x++) {
+        for (int c = 0; c < 4; c++) {
+            sum[c] += acc[x * 4 + c];
+        }
+    }
+    for (int c = 0; c < 4; c++) {
+        uint32_t value = static_cast<uint32_t>(sum[c] * scale + 0.5f);
+        pixel |= std::min<uint32_t>(value, 255) << (c * 8);
+    }
+#endif
+    if (forceOpaque) {
+        pixel |= 0xFF000000u;
+    }
+    memcpy(out, &pixel, sizeof(pixel));
+}
+
+// BT.601 luma in 8.8 fixed point for a row of BGRA pixels
+void LumaRow(const uint8_t* row, int width, uint16_t* luma) {
+    int x = 0;
+#if defined(IMAGE_OPS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+        // [b*29 + g*150, r*77] for each pixel
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+        __m128 loF = _mm_castsi128_ps(lo);
+        __m128 hiF = _mm_castsi128_ps(hi);
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(loF, hiF, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(loF, hiF, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i y = _mm_srli_epi32(_mm_add_epi32(even, odd), 8);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(luma + x), _mm_packs_epi32(y, y));
+    }
+#elif defined(IMAGE_OPS_NEON)
+    for (; x + 8 <= width; x += 8) {
+        uint8x8x4_t pixels = vld4_u8(row + x * 4);
+        uint16x8_t y = vmull_u8(pixels.val[0], vdup_n_u8(29));
+        y = vmlal_u8(y, pixels.val[1], vdup_n_u8(150));
+        y = vmlal_u8(y, pixels.val[2], vdup_n_u8(77));
+        vst1q_u16(luma + x, vshrq_n_u16(y, 8));
+    }
+#endif
+    for (; x < width; x++) {
+        const uint8_t* p = row + x * 4;
+        luma[x] = static_cast<uint16_t>((p[0] * 29 + p[1] * 150 + p[2] * 77) >> 8);
+    }
+}
+
+// brighter[x] = luma[x + 1] > luma[x] ? 0xFF : 0 for x in [0, count)
+void CompareNeighbours(const uint16_t* luma, int count, uint8_t* brighter) {
+    int x = 0;
+#if defined(IMAGE_OPS_SSE2)
+    for (; x + 8 <= count; x += 8) {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + x));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + x + 1));
+        __m128i mask = _mm_cmpgt_epi16(next, current);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(brighter + x), _mm_packs_epi16(mask, mask));
+    }
+#elif defined(IMAGE_OPS_NEON)
+    for (; x + 8 <= count; x += 8) {
+        uint16x8_t mask = vcgtq_u16(vld1q_u16(luma + x + 1), vld1q_u16(luma + x));
+        vst1_u8(brighter + x, vmovn_u16(mask));
+    }
+#endif
+    for (; x < count; x++) {
+        brighter[x] = luma[x + 1] > luma[x] ? 0xFF : 0;
+    }
+}
+
+}  // namespace
+
+void DownscaleBGRA(const uint8_t* src, int srcWidth, int srcHeight, int srcStride,
+                   uint8_t* dst, int dstWidth, int dstHeight, int dstStride,
+                   bool forceOpaque) {
+    if (!src || !dst || srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+        return;
+    }
+
+    // Scratch storage is reused across calls so steady-state capture does not allocate
+    static thread_local std::vector<uint16_t> acc;
+    static thread_local std::vector<int> columnStart;
+
+    const int rowSamples = srcWidth * 4;
+    acc.resize(rowSamples);
+    columnStart.resize(dstWidth + 1);
+    for (int dx = 0; dx <= dstWidth; dx++) {
+        columnStart[dx] = static_cast<int>(static_cast<int64_t>(dx) * srcWidth / dstWidth);
+    }
+
+    for (int dy = 0; dy < dstHeight; dy++) {
+        int y0 = static_cast<int>(static_cast<int64_t>(dy) * srcHeight / dstHeight);
+        int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(dy + 1) * srcHeight / dstHeight));
+        y1 = std::min(y1, srcHeight);
+
+        // The 16-bit accumulator holds up to 257 full-intensity rows, taller spans are sampled
+        int step = std::max(1, (y1 - y0 + 255) / 256);
+        std::fill(acc.begin(), acc.end(), static_cast<uint16_t>(0));
+        int rows = 0;
+        for (int y = y0; y < y1; y += step) {
+            AccumulateRow(src + static_cast<size_t>(y) * srcStride, acc.data(), rowSamples);
+            rows++;
+        }
+
+        uint8_t* outRow = dst + static_cast<size_t>(dy) * dstStride;
+        for (int dx = 0; dx < dstWidth; dx++) {
+            int x0 = std::min(columnStart[dx], srcWidth - 1);
+            int x1 = std::min(std::max(x0 + 1, columnStart[dx + 1]), srcWidth);
+            float scale = 1.0f / static_cast<float>((x1 - x0) * rows);
+            ReduceSpan(acc.data(), x0, x1, scale, outRow + dx * 4, forceOpaque);
+        }
+    }
+}
+
+void ComputeGridHashes(const uint8_t* bgra, int stride, int columns, int rows, uint64_t* hashes) {
+    if (!bgra || !hashes || columns <= 0 || rows <= 0) {
+        return;
+    }
+
+    const int width = columns * kHashCellWidth;
+    // One spare element so the vector loads of luma[x + 1] stay in bounds
+    static thread_local std::vector<uint16_t> luma;
+    static thread_local std::vector<uint8_t> brighter;
+    luma.assign(width + 8, 0);
+    brighter.resize(width);
+
+    std::fill(hashes, hashes + static_cast<size_t>(columns) * rows, 0);
+
+    for (int y = 0; y < rows * kHashCellHeight; y++) {
+        LumaRow(bgra + static_cast<size_t>(y) * stride, width, luma.data());
+        CompareNeighbours(luma.data(), width - 1, brighter.data());
+
+        const int cellRow = y / kHashCellHeight;
+        const int bitRow = y % kHashCellHeight;
+        for (int column = 0; column < columns; column++) {
+            const uint8_t* bits = brighter.data() + column * kHashCellWidth;
+            uint64_t rowBits = 0;
+            for (int i = 0; i < 8; i++) {
+                rowBits |= static_cast<uint64_t>(bits[i] & 1) << i;
+            }
+            hashes[cellRow * columns + column] |= rowBits << (bitRow * 8);
+        }
+    }
+}
+
+int HammingDistance(uint64_t a, uint64_t b) {
+    return static_cast<int>(std::bitset<64>(a ^ b).count());
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Pixel helpers shared by the capture code. All buffers are 32-bit BGRA
+// (the native layout of X11 ZPixmaps, Windows DIB sections and
+// CoreGraphics little-endian bitmaps).
+
+// Box-filter downscale from src to dst. Each destination pixel is the
+// average of the source pixels it covers. Vectorised with SSE2 on x86 and
+// NEON on arm64; other targets use the scalar path.
+// When forceOpaque is set the alpha channel is written as 255, which is
+// needed for depth-24 X11 visuals whose padding byte is undefined.
+void DownscaleBGRA(const uint8_t* src, int srcWidth, int srcHeight, int srcStride,
+                   uint8_t* dst, int dstWidth, int dstHeight, int dstStride,
+                   bool forceOpaque = true);
+
+// Perceptual difference hash (dHash) of every cell in a grid.
+// The image must be exactly columns * kHashCellWidth pixels wide and
+// rows * kHashCellHeight pixels tall, so each cell is 9x8 pixels (capture
+// straight to that size and the box filter does the averaging). Bit
+// (y * 8 + x) of a cell's hash is set when pixel x + 1 of row y is brighter
+// than pixel x. Luma conversion and the comparisons are vectorised.
+constexpr int kHashCellWidth = 9;
+constexpr int kHashCellHeight = 8;
+
+void ComputeGridHashes(const uint8_t* bgra, int stride, int columns, int rows, uint64_t* hashes);
+
+int HammingDistance(uint64_t a, uint64_t b);
@@ -0,0 +1,159 @@
+#include <climits>
+#include <string>
+#include <vector>
+
+#include "layout-snapshot.h"
+#include "native-tests.h"
+
+namespace {
+
+bool Same(const LayoutSnapshot& a, const LayoutSnapshot& b) {
+    if (a.monitors.size() != b.monitors.size() || a.entries.size() != b.entries.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.monitors.size(); i++) {
+        const LayoutMonitor& m = a.monitors[i];
+        const LayoutMonitor& n = b.monitors[i];
+        if (m.x != n.x || m.y != n.y || m.width != n.width || m.height != n.height || m.isPrimary != n.isPrimary) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.entries.size(); i++) {
+        const LayoutEntry& e = a.entries[i];
+        const LayoutEntry& f = b.entries[i];
+        if (e.profileId != f.profileId || e.monitor != f.monitor || e.x != f.x || e.y != f.y ||
+            e.width != f.width || e.height != f.height || e.zOrder != f.zOrder) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A primary 1920 x 1080 monitor with a 2560 x 1440 one to its left
+LayoutSnapshot TwoMonitors() {
+    LayoutSnapshot snapshot;
+    snapshot.monitors = {{0, 0, 1920, 1080, true}, {-2560, -200, 2560, 1440, false}};
+    snapshot.entries = {
+        {"default", 0, 10, 20, 800, 600, 0},
+        {"Profile 1", 1, -30, 1500, 1200, 900, 1},
+        {"\xE5\xB7\xA5\xE4\xBD\x9C", 0, 0, 0, 1920, 1080, 2},
+        {"", 1, INT_MIN, INT_MAX, 0, -1, 3},
+    };
+    return snapshot;
+}
+
+bool Decode(const std::vector<uint8_t>& data, LayoutSnapshot& snapshot) {
+    return DecodeLayout(data.data(), data.size(), snapshot);
+}
+
+}  // namespace
+
+NATIVE_TEST(LayoutSnapshot, RoundTripsEveryField) {
+    LayoutSnapshot saved = TwoMonitors();
+    std::vector<uint8_t> data = EncodeLayout(saved);
+    LayoutSnapshot restored;
+    NATIVE_CHECK(Decode(data, restored));
+    NATIVE_CHECK(Same(saved, restored));
+
+    LayoutSnapshot empty;
+    NATIVE_CHECK(Decode(EncodeLayout(empty), restored));
+    NATIVE_CHECK(restored.monitors.empty() && restored.entries.empty());
+}
+
+// The size the header comment promises for a typical window
+NATIVE_TEST(LayoutSnapshot, StaysCompact) {
+    LayoutSnapshot snapshot;
+    snapshot.monitors = {{0, 0, 1920, 1080, true}};
+    for (int i = 0; i < 100; i++) {
+        snapshot.entries.push_back({"Profile " + std::to_string(i), 0, i * 19, i * 10, 1024, 640, i});
+    }
+    size_t ids = 0;
+    for (const auto& entry : snapshot.entries) {
+        ids += entry.profileId.size();
+    }
+    NATIVE_CHECK(EncodeLayout(snapshot).size() <= 32 + ids + 12 * snapshot.entries.size());
+}
+
+NATIVE_TEST(LayoutSnapshot, RejectsEveryTruncation) {
+    std::vector<uint8_t> data = EncodeLayout(TwoMonitors());
+    for (size_t length = 0; length < data.size(); length++) {
+        LayoutSnapshot snapshot;
+        NATIVE_CHECK(!DecodeLayout(data.data(), length, snapshot));
+    }
+    LayoutSnapshot snapshot;
+    NATIVE_CHECK(!DecodeLayout(nullptr, 0, snapshot));
+}
+
+NATIVE_TEST(LayoutSnapshot, RejectsForeignOrCorruptData) {
+    std::vector<uint8_t> data = EncodeLayout(TwoMonitors());
+    LayoutSnapshot snapshot;
+
+    std::vector<uint8_t> magic = data;
+    magic[0] = 'X';
+    NATIVE_CHECK(!Decode(magic, snapshot));
+
+    std::vector<uint8_t> version = data;
+    version[3]++;
+    NATIVE_CHECK(!Decode(version, snapshot));
+
+    // An entry on a monitor that is not in the list
+    LayoutSnapshot stray = TwoMonitors();
+    stray.entries[1].monitor = 2;
+    NATIVE_CHECK(!Decode(EncodeLayout(stray), snapshot));
+
+    // Counts far beyond the data are refused before anything is allocated
+    std::vector<uint8_t> huge = {'C', 'P', 'L', 1, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+    NATIVE_CHECK(!Decode(huge, snapshot));
+    std::vector<uint8_t> endless = {'C', 'P', 'L', 1, 0};
+    endless.insert(endless.end(), 11, 0xFF);
+    NATIVE_CHECK(!Decode(endless, snapshot));
+}
+
+NATIVE_TEST(LayoutSnapshot, FindsTheMonitorOfTheCentre) {
+    std::vector<LayoutMonitor> monitors = TwoMonitors().monitors;
+    NATIVE_CHECK(FindLayoutMonitor(monitors, 100, 100, 800, 600) == 0);
+    NATIVE_CHECK(FindLayoutMonitor(monitors, -1000, 0, 800, 600) == 1);
+    // Straddling both, by where its centre is
+    NATIVE_CHECK(FindLayoutMonitor(monitors, -300, 0, 800, 600) == 0);
+    NATIVE_CHECK(FindLayoutMonitor(monitors, -500, 0, 800, 600) == 1);
+    // Off-screen windows go to the nearest monitor
+    NATIVE_CHECK(FindLayoutMonitor(monitors, 2500, 500, 400, 300) == 0);
+    NATIVE_CHECK(FindLayoutMonitor(monitors, -4000, 1100, 400, 300) == 1);
+}
+
+NATIVE_TEST(LayoutSnapshot, MatchesMonitorsByGeometryThenSize) {
+    std::vector<LayoutMonitor> saved = TwoMonitors().monitors;
+
+    // Same monitors, listed the other way round
+    std::vector<LayoutMonitor> swapped = {saved[1], saved[0]};
+    NATIVE_CHECK(MatchLayoutMonitors(saved, swapped) == std::vector<int>({1, 0}));
+
+    // The large monitor moved to the right
+    std::vector<LayoutMonitor> moved = {{0, 0, 1920, 1080, true}, {1920, 0, 2560, 1440, false}};
+    NATIVE_CHECK(MatchLayoutMonitors(saved, moved) == std::vector<int>({0, 1}));
+
+    // The large monitor unplugged and a different one in its place
+    std::vector<LayoutMonitor> replaced = {{0, 0, 1280, 1024, false}, {1280, 0, 1920, 1080, true}};
+    NATIVE_CHECK(MatchLayoutMonitors(saved, replaced) == std::vector<int>({1, 1}));
+}
+
+NATIVE_TEST(LayoutSnapshot, PlacesEntriesOnTheCurrentMonitor) {
+    LayoutMonitor saved = {0, 0, 1920, 1080, true};
+    int x, y, width, height;
+
+    // Same monitor, moved to the right
+    PlaceLayoutEntry({"p", 0, 10, 20, 800, 600, 0}, saved, {1920, 0, 1920, 1080, true}, x, y, width, height);
+    NATIVE_CHECK(x == 1930 && y == 20 && width == 800 && height == 600);
+
+    // Half the resolution
+    PlaceLayoutEntry({"p", 0, 100, 200, 800, 600, 0}, saved, {0, 0, 960, 540, true}, x, y, width, height);
+    NATIVE_CHECK(x == 50 && y == 100 && width == 400 && height == 300);
+
+    // Kept on screen: too large, and hanging off the bottom right
+    PlaceLayoutEntry({"p", 0, -50, -50, 4000, 3000, 0}, saved, saved, x, y, width, height);
+    NATIVE_CHECK(x == 0 && y == 0 && width == 1920 && height == 1080);
+    PlaceLayoutEntry({"p", 0, 1800, 1000, 400, 300, 0}, saved, saved, x, y, width, height);
+    NATIVE_CHECK(x == 1520 && y == 780 && width == 400 && height == 300);
+    PlaceLayoutEntry({"p", 0, 0, 0, 0, -5, 0}, saved, saved, x, y, width, height);
+    NATIVE_CHECK(width == 1 && height == 1);
+}
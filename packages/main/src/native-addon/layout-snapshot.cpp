@@ -0,0 +1,220 @@
+#include "layout-snapshot.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+constexpr uint8_t kMagic[3] = {'C', 'P', 'L'};
+constexpr uint8_t kVersion = 1;
+// Upper bounds that keep a corrupt blob from allocating gigabytes
+constexpr uint64_t kMaxMonitors = 64;
+constexpr uint64_t kMaxEntries = 65536;
+constexpr uint64_t kMaxProfileIdLength = 1024;
+
+void WriteVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void WriteSigned(std::vector<uint8_t>& out, int value) {
+    uint64_t wide = static_cast<uint64_t>(static_cast<int64_t>(value));
+    WriteVarint(out, (wide << 1) ^ (value < 0 ? ~uint64_t(0) : 0));
+}
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t length) : data_(data), end_(data + length) {}
+
+    bool Varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (data_ == end_) {
+                return false;
+            }
+            uint8_t byte = *data_++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Signed(int& value) {
+        uint64_t raw;
+        if (!Varint(raw)) {
+            return false;
+        }
+        int64_t decoded = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        if (decoded < INT_MIN || decoded > INT_MAX) {
+            return false;
+        }
+        value = static_cast<int>(decoded);
+        return true;
+    }
+
+    bool Bytes(size_t count, const uint8_t*& bytes) {
+        if (static_cast<size_t>(end_ - data_) < count) {
+            return false;
+        }
+        bytes = data_;
+        data_ += count;
+        return true;
+    }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+};
+
+int64_t DistanceSquared(const LayoutMonitor& monitor, int x, int y) {
+    int64_t dx = x < monitor.x ? monitor.x - x : (x >= monitor.x + monitor.width ? x - monitor.x - monitor.width + 1 : 0);
+    int64_t dy = y < monitor.y ? monitor.y - y : (y >= monitor.y + monitor.height ? y - monitor.y - monitor.height + 1 : 0);
+    return dx * dx + dy * dy;
+}
+
+int Scale(int value, int from, int to) {
+    if (from <= 0 || from == to) {
+        return value;
+    }
+    return static_cast<int>(static_cast<int64_t>(value) * to / from);
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodeLayout(const LayoutSnapshot& snapshot) {
+    std::vector<uint8_t> out(kMagic, kMagic + sizeof(kMagic));
+    out.push_back(kVersion);
+
+    WriteVarint(out, snapshot.monitors.size());
+    for (const auto& monitor : snapshot.monitors) {
+        WriteSigned(out, monitor.x);
+        WriteSigned(out, monitor.y);
+        WriteSigned(out, monitor.width);
+        WriteSigned(out, monitor.height);
+        out.push_back(monitor.isPrimary ? 1 : 0);
+    }
+
+    WriteVarint(out, snapshot.entries.size());
+    for (const auto& entry : snapshot.entries) {
+        WriteVarint(out, entry.profileId.size());
+        out.insert(out.end(), entry.profileId.begin(), entry.profileId.end());
+        WriteVarint(out, static_cast<uint64_t>(entry.monitor));
+        WriteSigned(out, entry.x);
+        WriteSigned(out, entry.y);
+        WriteSigned(out, entry.width);
+        WriteSigned(out, entry.height);
+        WriteVarint(out, static_cast<uint64_t>(entry.zOrder));
+    }
+    return out;
+}
+
+bool DecodeLayout(const uint8_t* data, size_t length, LayoutSnapshot& snapshot) {
+    snapshot = LayoutSnapshot();
+    Reader reader(data, length);
+
+    const uint8_t* header;
+    if (!data || !reader.Bytes(sizeof(kMagic) + 1, header) ||
+        !std::equal(kMagic, kMagic + sizeof(kMagic), header) || header[sizeof(kMagic)] != kVersion) {
+        return false;
+    }
+
+    uint64_t monitorCount;
+    if (!reader.Varint(monitorCount) || monitorCount > kMaxMonitors) {
+        return false;
+    }
+    snapshot.monitors.resize(monitorCount);
+    for (auto& monitor : snapshot.monitors) {
+        const uint8_t* primary;
+        if (!reader.Signed(monitor.x) || !reader.Signed(monitor.y) || !reader.Signed(monitor.width) ||
+            !reader.Signed(monitor.height) || !reader.Bytes(1, primary)) {
+            return false;
+        }
+        monitor.isPrimary = *primary != 0;
+    }
+
+    uint64_t entryCount;
+    if (!reader.Varint(entryCount) || entryCount > kMaxEntries) {
+        return false;
+    }
+    snapshot.entries.resize(entryCount);
+    for (auto& entry : snapshot.entries) {
+        uint64_t idLength, monitor, zOrder;
+        const uint8_t* id;
+        if (!reader.Varint(idLength) || idLength > kMaxProfileIdLength || !reader.Bytes(idLength, id)) {
+            return false;
+        }
+        entry.profileId.assign(reinterpret_cast<const char*>(id), idLength);
+        if (!reader.Varint(monitor) || monitor >= monitorCount || !reader.Signed(entry.x) ||
+            !reader.Signed(entry.y) || !reader.Signed(entry.width) || !reader.Signed(entry.height) ||
+            !reader.Varint(zOrder) || zOrder > INT_MAX) {
+            return false;
+        }
+        entry.monitor = static_cast<int>(monitor);
+        entry.zOrder = static_cast<int>(zOrder);
+    }
+    return true;
+}
+
+int FindLayoutMonitor(const std::vector<LayoutMonitor>& monitors, int x, int y, int width, int height) {
+    int centreX = x + width / 2;
+    int centreY = y + height / 2;
+    int best = 0;
+    int64_t bestDistance = -1;
+    for (size_t i = 0; i < monitors.size(); i++) {
+        int64_t distance = DistanceSquared(monitors[i], centreX, centreY);
+        if (bestDistance < 0 || distance < bestDistance) {
+            best = static_cast<int>(i);
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+std::vector<int> MatchLayoutMonitors(const std::vector<LayoutMonitor>& saved,
+                                     const std::vector<LayoutMonitor>& current) {
+    int primary = 0;
+    for (size_t i = 0; i < current.size(); i++) {
+        if (current[i].isPrimary) {
+            primary = static_cast<int>(i);
+            break;
+        }
+    }
+
+    std::vector<int> mapping(saved.size(), primary);
+    for (size_t i = 0; i < saved.size(); i++) {
+        const LayoutMonitor& monitor = saved[i];
+        int sameSize = -1;
+        for (size_t j = 0; j < current.size(); j++) {
+            const LayoutMonitor& candidate = current[j];
+            if (candidate.width != monitor.width || candidate.height != monitor.height) {
+                continue;
+            }
+            if (candidate.x == monitor.x && candidate.y == monitor.y) {
+                sameSize = static_cast<int>(j);
+                break;
+            }
+            if (sameSize < 0) {
+                sameSize = static_cast<int>(j);
+            }
+        }
+        if (sameSize >= 0) {
+            mapping[i] = sameSize;
+        }
+    }
+    return mapping;
+}
+
+void PlaceLayoutEntry(const LayoutEntry& entry, const LayoutMonitor& savedMonitor, const LayoutMonitor& monitor,
+                      int& x, int& y, int& width, int& height) {
+    width = std::max(1, std::min(Scale(entry.width, savedMonitor.width, monitor.width), monitor.width));
+    height = std::max(1, std::min(Scale(entry.height, savedMonitor.height, monitor.height), monitor.height));
+    int relativeX = std::max(0, std::min(Scale(entry.x, savedMonitor.width, monitor.width), monitor.width - width));
+    int relativeY = std::max(0, std::min(Scale(entry.y, savedMonitor.height, monitor.height), monitor.height - height));
+    x = monitor.x + relativeX;
+    y = monitor.y + relativeY;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Window layout saved by saveLayout and applied by restoreLayout.
+//
+// Windows are keyed by profile ID because pids change on every launch, and
+// positions are stored relative to the monitor they were on so the layout
+// survives monitors being re-ordered or moved.
+
+struct LayoutMonitor {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    bool isPrimary = false;
+};
+
+struct LayoutEntry {
+    std::string profileId;
+    // Index into LayoutSnapshot::monitors
+    int monitor = 0;
+    // Relative to the monitor origin
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    // 0 is the topmost window
+    int zOrder = 0;
+};
+
+struct LayoutSnapshot {
+    std::vector<LayoutMonitor> monitors;
+    std::vector<LayoutEntry> entries;
+};
+
+// Compact binary encoding: a "CPL" magic and version byte followed by
+// zigzag varints, about 12 bytes per window plus its profile ID.
+std::vector<uint8_t> EncodeLayout(const LayoutSnapshot& snapshot);
+// False when data is not a layout this version can read
+bool DecodeLayout(const uint8_t* data, size_t length, LayoutSnapshot& snapshot);
+
+// Index of the monitor in monitors that contains the centre of the rectangle,
+// or the nearest one when it is off-screen. Rectangles are absolute.
+int FindLayoutMonitor(const std::vector<LayoutMonitor>& monitors, int x, int y, int width, int height);
+
+// For every saved monitor, the index of the current monitor it maps to:
+// the one with the same geometry, else the same size, else the primary.
+std::vector<int> MatchLayoutMonitors(const std::vector<LayoutMonitor>& saved,
+                                     const std::vector<LayoutMonitor>& current);
+
+// Absolute rectangle of entry on the current monitor. Positions and sizes are
+// scaled when the monitor resolution differs and kept on screen.
+void PlaceLayoutEntry(const LayoutEntry& entry, const LayoutMonitor& savedMonitor, const LayoutMonitor& monitor,
+                      int& x, int& y, int& width, int& height);
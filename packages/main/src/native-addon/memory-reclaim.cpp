@@ -0,0 +1,278 @@
+#include "memory-reclaim.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "addon-common.h"
+#include "addon-core.h"
+#include "process-stats.h"
+#include "process-tree.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_process_madvise
+#define SYS_process_madvise 440
+#endif
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Drops the pids of processes that are gone when alive is set
+uint64_t TotalRss(std::vector<int>& pids, bool alive) {
+    std::vector<ProcessUsage> usage;
+    ReadProcessUsage(pids, usage, false);
+    uint64_t total = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < pids.size(); i++) {
+        total += usage[i].rssBytes;
+        if (!alive || usage[i].ok) {
+            pids[kept++] = pids[i];
+        }
+    }
+    pids.resize(kept);
+    return total;
+}
+
+#ifdef __linux__
+
+// Ranges advised per call (UIO_MAXIOV)
+constexpr size_t kMaxRanges = 1024;
+
+// Mappings of pid that can be paged out: special mappings such as [vvar]
+// and [vsyscall] are left out, since one of them fails a whole call
+void ReadMappings(int pid, std::vector<iovec>& ranges) {
+    ranges.clear();
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    FILE* maps = fopen(path, "re");
+    if (!maps) {
+        return;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long start = 0;
+        unsigned long end = 0;
+        char perms[5] = {};
+        int pathStart = 0;
+        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %n", &start, &end, perms, &pathStart) < 3) {
+            continue;
+        }
+        // Inaccessible guard regions hold no pages
+        if (perms[0] == '-' && perms[1] == '-' && perms[2] == '-') {
+            continue;
+        }
+        const char* name = line + pathStart;
+        if (name[0] == '[' && strncmp(name, "[heap]", 6) != 0 && strncmp(name, "[stack]", 7) != 0 &&
+            strncmp(name, "[anon:", 6) != 0) {
+            continue;
+        }
+        ranges.push_back({reinterpret_cast<void*>(start), end - start});
+    }
+    fclose(maps);
+}
+
+// False when the process refused the advice altogether
+bool AdviseProcess(int pid, int advice, std::vector<iovec>& ranges) {
+    int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pidfd < 0) {
+        return false;
+    }
+    ReadMappings(pid, ranges);
+
+    bool advised = false;
+    for (size_t first = 0; first < ranges.size(); first += kMaxRanges) {
+        size_t count = std::min(kMaxRanges, ranges.size() - first);
+        if (syscall(SYS_process_madvise, pidfd, &ranges[first], count, advice, 0) >= 0) {
+            advised = true;
+            continue;
+        }
+        if (errno == EPERM || errno == ESRCH || errno == ENOSYS) {
+            break;
+        }
+        // A mapping that cannot be advised (locked, or gone since it was
+        // read) stops the call at that range: go one range at a time
+        for (size_t i = first; i < first + count; i++) {
+            advised |= syscall(SYS_process_madvise, pidfd, &ranges[i], 1, advice, 0) >= 0;
+        }
+    }
+    if (!advised && !ranges.empty()) {
+        LOG_DEBUG("process_madvise refused for pid " << pid << " (errno " << errno << ")");
+    }
+    close(pidfd);
+    return advised;
+}
+
+#endif
+
+}  // namespace
+
+ReclaimResult ReclaimProcessTree(int root, ReclaimMode mode) {
+    auto started = Clock::now();
+    auto tree = ProcessTree::Shared().Descendants(root);
+    std::vector<int> pids(tree->begin(), tree->end());
+
+    ReclaimResult result;
+    result.rssBefore = TotalRss(pids, true);
+    result.processes = static_cast<int>(pids.size());
+
+#ifdef __linux__
+    int advice = mode == ReclaimMode::Cold ? MADV_COLD : MADV_PAGEOUT;
+    std::vector<iovec> ranges;
+    for (int pid : pids) {
+        if (!AdviseProcess(pid, advice, ranges)) {
+            result.failed++;
+        }
+    }
+#elif _WIN32
+    (void)mode;
+    for (int pid : pids) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_SET_QUOTA, FALSE, static_cast<DWORD>(pid));
+        if (!process || !EmptyWorkingSet(process)) {
+            result.failed++;
+        }
+        if (process) {
+            CloseHandle(process);
+        }
+    }
+#else
+    (void)mode;
+    result.failed = result.processes;
+#endif
+
+    result.rssAfter = TotalRss(pids, false);
+    result.elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    return result;
+}
+
+MemoryReclaimer::MemoryReclaimer(std::shared_ptr<AddonCore> core) : core_(std::move(core)) {
+    if (ForegroundTracker* tracker = core_->Foreground()) {
+        focusListener_ = tracker->AddListener([this](int pid, int) { OnFocus(pid); });
+        focusPid_ = tracker->ActivePid();
+        focusChanged_ = true;
+    }
+    running_ = true;
+    thread_ = std::thread(&MemoryReclaimer::Run, this);
+}
+
+MemoryReclaimer::~MemoryReclaimer() {
+    if (focusListener_) {
+        core_->Foreground()->RemoveListener(focusListener_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        wake_.notify_one();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void MemoryReclaimer::SetProfiles(const std::vector<int>& roots, std::chrono::milliseconds idle, ReclaimMode mode) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    std::unordered_map<int, Profile> profiles;
+    for (int root : roots) {
+        auto it = profiles_.find(root);
+        profiles[root] = it != profiles_.end() ? it->second : Profile{now, false};
+    }
+    profiles_.swap(profiles);
+    idle_ = idle;
+    mode_ = mode;
+    wake_.notify_one();
+}
+
+ReclaimStats MemoryReclaimer::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ReclaimStats stats = stats_;
+    stats.profiles = static_cast<int>(profiles_.size());
+    return stats;
+}
+
+void MemoryReclaimer::OnFocus(int pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    focusPid_ = pid;
+    focusChanged_ = true;
+    wake_.notify_one();
+}
+
+void MemoryReclaimer::Run() {
+    int focused = 0;
+    std::vector<int> due;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (running_) {
+        auto now = Clock::now();
+        if (focusChanged_) {
+            focusChanged_ = false;
+            // Idle time of the profile losing focus starts now
+            auto previous = profiles_.find(focused);
+            if (previous != profiles_.end()) {
+                previous->second.lastFocus = now;
+            }
+            focused = 0;
+            for (auto& [root, profile] : profiles_) {
+                if (focusPid_ > 0 && ProcessTree::Shared().Contains(root, focusPid_)) {
+                    focused = root;
+                    profile.lastFocus = now;
+                    profile.reclaimed = false;
+                    break;
+                }
+            }
+        }
+
+        due.clear();
+        auto next = now + std::chrono::hours(1);
+        for (auto& [root, profile] : profiles_) {
+            if (root == focused || profile.reclaimed) {
+                continue;
+            }
+            auto deadline = profile.lastFocus + idle_;
+            if (deadline <= now) {
+                due.push_back(root);
+                profile.reclaimed = true;
+            } else {
+                next = std::min(next, deadline);
+            }
+        }
+
+        ReclaimMode mode = mode_;
+        for (int root : due) {
+            lock.unlock();
+            ReclaimResult result = ReclaimProcessTree(root, mode);
+            lock.lock();
+            stats_.reclaims++;
+            stats_.reclaimedBytes += result.Reclaimed();
+            stats_.failed += static_cast<uint64_t>(result.failed);
+            stats_.lastReclaimMs = result.elapsedMs;
+            LOG_INFO("Reclaimed " << (result.Reclaimed() >> 20) << " MiB from idle profile " << root << " in "
+                                  << result.elapsedMs << " ms");
+        }
+        if (!due.empty()) {
+            // Profiles may have changed while the lock was released
+            continue;
+        }
+
+        wake_.wait_until(lock, next);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class AddonCore;
+
+enum class ReclaimMode {
+    // Write cold pages out now: clean file pages are dropped, anonymous pages
+    // go to swap (or zram) when there is any
+    Pageout,
+    // Only move pages to the inactive list, so they go first under pressure
+    Cold,
+};
+
+struct ReclaimResult {
+    int processes = 0;
+    int failed = 0;           // processes that refused the advice
+    uint64_t rssBefore = 0;
+    uint64_t rssAfter = 0;
+    double elapsedMs = 0;
+
+    uint64_t Reclaimed() const { return rssBefore > rssAfter ? rssBefore - rssAfter : 0; }
+};
+
+// Ask the kernel to page out the memory of root and every process it
+// started (see ProcessTree): process_madvise() with MADV_PAGEOUT or
+// MADV_COLD over every mapping, through a pidfd (Linux 5.10+, and the caller
+// needs CAP_SYS_NICE), or EmptyWorkingSet on Windows, where the mode makes
+// no difference. Not available on macOS: every process fails.
+ReclaimResult ReclaimProcessTree(int root, ReclaimMode mode);
+
+struct ReclaimStats {
+    int profiles = 0;          // under the automatic policy
+    uint64_t reclaims = 0;     // automatic reclaims so far
+    uint64_t reclaimedBytes = 0;
+    uint64_t failed = 0;
+    double lastReclaimMs = 0;
+};
+
+// Automatic reclaim: a profile that has not had the focused window for
+// idle is reclaimed once, and again only after it had focus in between.
+// Focus comes from the shared foreground tracker; without one, profiles
+// count as idle from the moment they were added.
+class MemoryReclaimer {
+public:
+    explicit MemoryReclaimer(std::shared_ptr<AddonCore> core);
+    ~MemoryReclaimer();
+
+    MemoryReclaimer(const MemoryReclaimer&) = delete;
+    MemoryReclaimer& operator=(const MemoryReclaimer&) = delete;
+
+    // Replace the profiles under the policy. Profiles already there keep
+    // their idle time.
+    void SetProfiles(const std::vector<int>& roots, std::chrono::milliseconds idle, ReclaimMode mode);
+
+    ReclaimStats Stats();
+
+private:
+    struct Profile {
+        std::chrono::steady_clock::time_point lastFocus;
+        bool reclaimed = false;
+    };
+
+    void OnFocus(int pid);
+    void Run();
+
+    std::shared_ptr<AddonCore> core_;
+    uint64_t focusListener_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::unordered_map<int, Profile> profiles_;
+    std::chrono::milliseconds idle_{0};
+    ReclaimMode mode_ = ReclaimMode::Pageout;
+    int focusPid_ = 0;
+    bool focusChanged_ = false;
+    ReclaimStats stats_;
+    bool running_ = false;
+    std::thread thread_;
+};
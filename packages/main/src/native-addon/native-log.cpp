@@ -0,0 +1,356 @@
+#include "native-log.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+const char* LogLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug:
+            return "debug";
+        case LogLevel::Info:
+            return "info";
+        case LogLevel::Warn:
+            return "warn";
+        case LogLevel::Error:
+            return "error";
+    }
+    return "info";
+}
+
+bool ParseLogLevel(const std::string& name, LogLevel& level) {
+    for (LogLevel candidate : {LogLevel::Debug, LogLevel::Info, LogLevel::Warn, LogLevel::Error}) {
+        if (name == LogLevelName(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LogSite::Admit(uint32_t& suppressed) {
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+    int64_t current = second_.load(std::memory_order_relaxed);
+    if (second != current && second_.compare_exchange_strong(current, second, std::memory_order_relaxed)) {
+        count_.store(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < kBurst) {
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+namespace NativeLog {
+namespace {
+
+std::atomic<int> minLevel{static_cast<int>(LogLevel::Info)};
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Formats into a fixed array; anything past it is cut off
+class LineBuffer : public std::streambuf {
+public:
+    LineBuffer() { Reset(); }
+    void Reset() { setp(data_, data_ + sizeof(data_)); }
+    const char* Data() const { return data_; }
+    size_t Length() const { return static_cast<size_t>(pptr() - pbase()); }
+
+private:
+    char data_[kMaxLineLength];
+};
+
+struct Slot {
+    LogLevel level;
+    uint32_t suppressed;
+    int64_t timeMs;
+    const LogSite* site;
+    size_t length;
+    char text[kMaxLineLength];
+};
+
+// Lines queued by one thread. That thread is the only producer, the flush
+// thread the only consumer.
+struct Ring {
+    static constexpr size_t kSlots = 64;
+
+    std::array<Slot, kSlots> slots;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    // The owning thread has exited, remove once drained
+    std::atomic<bool> closed{false};
+
+    // Used by the owning thread only
+    LineBuffer buffer;
+    std::ostream stream{&buffer};
+};
+
+class Logger {
+public:
+    // Never destroyed: threads may still log while the process exits
+    static Logger& Instance() {
+        static Logger* instance = [] {
+            auto* logger = new Logger();
+            std::atexit([] { Instance().Shutdown(); });
+            return logger;
+        }();
+        return *instance;
+    }
+
+    void Register(std::shared_ptr<Ring> ring) {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings_.push_back(std::move(ring));
+    }
+
+    void Wake() {
+        urgent_.store(true, std::memory_order_relaxed);
+        wake_.notify_one();
+    }
+
+    void Drain() { Drain(true); }
+
+    uint64_t SetSink(Sink sink) {
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        sink_ = std::move(sink);
+        return ++sinkId_;
+    }
+
+    void ClearSink(uint64_t id) {
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        if (id == sinkId_) {
+            sink_ = nullptr;
+        }
+    }
+
+private:
+    Logger() : thread_([this] { Run(); }) {}
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        while (!stopping_) {
+            wake_.wait_for(lock, kFlushInterval, [this] {
+                return stopping_ || urgent_.load(std::memory_order_relaxed);
+            });
+            if (stopping_) {
+                break;
+            }
+            urgent_.store(false, std::memory_order_relaxed);
+            lock.unlock();
+            Drain(true);
+            lock.lock();
+        }
+    }
+
+    // Final flush at exit. On Windows other threads are already gone by
+    // then, so do not wait on locks they may have held.
+    void Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        Drain(false);
+        thread_.detach();
+    }
+
+    void Drain(bool wait) {
+        std::unique_lock<std::mutex> drainLock(drainMutex_, std::defer_lock);
+        if (wait) {
+            drainLock.lock();
+        } else if (!drainLock.try_lock()) {
+            return;
+        }
+
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            rings = rings_;
+        }
+
+        std::vector<LogRecord> records;
+        uint64_t dropped = 0;
+        for (const auto& ring : rings) {
+            bool closed = ring->closed.load(std::memory_order_acquire);
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; tail++) {
+                const Slot& slot = ring->slots[tail % Ring::kSlots];
+                LogRecord record;
+                record.level = slot.level;
+                record.timeMs = slot.timeMs;
+                record.file = BaseName(slot.site->File());
+                record.line = slot.site->Line();
+                record.suppressed = slot.suppressed;
+                record.message.assign(slot.text, slot.length);
+                records.push_back(std::move(record));
+            }
+            ring->tail.store(tail, std::memory_order_release);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+            if (closed) {
+                std::lock_guard<std::mutex> lock(ringsMutex_);
+                rings_.erase(std::remove(rings_.begin(), rings_.end(), ring), rings_.end());
+            }
+        }
+
+        if (dropped > 0) {
+            LogRecord record;
+            record.level = LogLevel::Warn;
+            record.timeMs = NowMs();
+            record.file = "native-log.cpp";
+            record.line = __LINE__;
+            record.message = std::to_string(dropped) + " log lines dropped, queue full";
+            records.push_back(std::move(record));
+        }
+        if (records.empty()) {
+            return;
+        }
+
+        // The sink's JS environment is gone by the final flush
+        if (wait) {
+            std::lock_guard<std::mutex> lock(sinkMutex_);
+            if (sink_) {
+                sink_(std::move(records));
+                return;
+            }
+        }
+        Write(records);
+    }
+
+    static void Write(const std::vector<LogRecord>& records) {
+        char line[kMaxLineLength + 128];
+        for (const auto& record : records) {
+            int length = std::snprintf(line, sizeof(line), "[native] %s %s:%d %s", LogLevelName(record.level),
+                                       record.file, record.line, record.message.c_str());
+            if (record.suppressed > 0 && length >= 0 && static_cast<size_t>(length) < sizeof(line)) {
+                std::snprintf(line + length, sizeof(line) - length, " (%u similar suppressed)", record.suppressed);
+            }
+            std::fprintf(stderr, "%s\n", line);
+#ifdef _WIN32
+            OutputDebugStringA(line);
+#endif
+        }
+        std::fflush(stderr);
+    }
+
+    static const char* BaseName(const char* path) {
+        const char* name = path;
+        for (const char* p = path; *p; p++) {
+            if (*p == '/' || *p == '\\') {
+                name = p + 1;
+            }
+        }
+        return name;
+    }
+
+    std::mutex ringsMutex_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> urgent_{false};
+    bool stopping_ = false;
+
+    std::mutex drainMutex_;
+
+    std::mutex sinkMutex_;
+    Sink sink_;
+    uint64_t sinkId_ = 0;
+
+    std::thread thread_;
+};
+
+// Marks the thread's ring closed when the thread exits
+struct RingHolder {
+    std::shared_ptr<Ring> ring;
+    ~RingHolder() {
+        if (ring) {
+            ring->closed.store(true, std::memory_order_release);
+        }
+    }
+};
+
+Ring& ThreadRing() {
+    thread_local RingHolder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<Ring>();
+        Logger::Instance().Register(holder.ring);
+    }
+    return *holder.ring;
+}
+
+}  // namespace
+
+void SetLevel(LogLevel level) {
+    minLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool Enabled(LogLevel level) {
+    return static_cast<int>(level) >= CP_LOG_MIN_LEVEL &&
+           static_cast<int>(level) >= minLevel.load(std::memory_order_relaxed);
+}
+
+uint64_t SetSink(Sink sink) {
+    return Logger::Instance().SetSink(std::move(sink));
+}
+
+void ClearSink(uint64_t id) {
+    Logger::Instance().ClearSink(id);
+}
+
+void Flush() {
+    Logger::Instance().Drain();
+}
+
+Line::Line(LogLevel level, const LogSite& site, uint32_t suppressed)
+    : level_(level), site_(site), suppressed_(suppressed) {
+    Ring& ring = ThreadRing();
+    ring.buffer.Reset();
+    ring.stream.clear();
+}
+
+Line::~Line() {
+    Ring& ring = ThreadRing();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == Ring::kSlots) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Slot& slot = ring.slots[head % Ring::kSlots];
+    slot.level = level_;
+    slot.suppressed = suppressed_;
+    slot.timeMs = NowMs();
+    slot.site = &site_;
+    slot.length = ring.buffer.Length();
+    std::memcpy(slot.text, ring.buffer.Data(), slot.length);
+    ring.head.store(head + 1, std::memory_order_release);
+
+    if (level_ >= LogLevel::Error) {
+        Logger::Instance().Wake();
+    }
+}
+
+std::ostream& Line::Stream() {
+    return ThreadRing().stream;
+}
+
+}  // namespace NativeLog
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+};
+
+// Levels below this are compiled out entirely, formatting included.
+// Build with -DCP_LOG_MIN_LEVEL=0 to keep LOG_DEBUG.
+#ifndef CP_LOG_MIN_LEVEL
+#define CP_LOG_MIN_LEVEL 1
+#endif
+
+const char* LogLevelName(LogLevel level);
+// "debug", "info", "warn" or "error"
+bool ParseLogLevel(const std::string& name, LogLevel& level);
+
+// A line as handed to the sink
+struct LogRecord {
+    LogLevel level = LogLevel::Info;
+    // Milliseconds since the Unix epoch
+    int64_t timeMs = 0;
+    const char* file = "";
+    int line = 0;
+    // Lines dropped at the same call site since the previous one got through
+    uint32_t suppressed = 0;
+    std::string message;
+};
+
+// Rate limit of one LOG_* call site: kBurst lines per second, the rest are
+// counted and reported with the next line that gets through.
+class LogSite {
+public:
+    static constexpr uint32_t kBurst = 10;
+
+    constexpr LogSite(const char* file, int line) : file_(file), line_(line) {}
+
+    // True if a line may be written now. suppressed receives the number of
+    // lines dropped since the last admitted one.
+    bool Admit(uint32_t& suppressed);
+
+    const char* File() const { return file_; }
+    int Line() const { return line_; }
+
+private:
+    const char* file_;
+    int line_;
+    std::atomic<int64_t> second_{0};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+// Asynchronous logger. Each thread formats into its own fixed buffer and
+// queues the line in its own single-producer ring, so logging takes no
+// lock and does not touch the heap after a thread's first line. A
+// background thread drains the rings every kFlushInterval (immediately for
+// errors) and writes to stderr and OutputDebugString, or to the sink when
+// one is set. A thread whose ring is full drops the line and the drop is
+// reported on the next flush.
+namespace NativeLog {
+
+constexpr std::chrono::milliseconds kFlushInterval{100};
+constexpr size_t kMaxLineLength = 240;
+
+// Runtime filter on top of CP_LOG_MIN_LEVEL
+void SetLevel(LogLevel level);
+bool Enabled(LogLevel level);
+
+// Replace the output with sink, called on the flush thread with every batch.
+// Returns an id for ClearSink. While a sink is set nothing goes to stderr.
+using Sink = std::function<void(std::vector<LogRecord>)>;
+uint64_t SetSink(Sink sink);
+// Remove the sink if it is still the one set under id. Once this returns the
+// sink is not called again.
+void ClearSink(uint64_t id);
+
+// Write everything queued so far on the calling thread
+void Flush();
+
+// Formats one line into the calling thread's buffer and queues it when
+// destroyed
+class Line {
+public:
+    Line(LogLevel level, const LogSite& site, uint32_t suppressed);
+    ~Line();
+
+    Line(const Line&) = delete;
+    Line& operator=(const Line&) = delete;
+
+    std::ostream& Stream();
+
+private:
+    LogLevel level_;
+    const LogSite& site_;
+    uint32_t suppressed_;
+};
+
+}  // namespace NativeLog
+
+#define CP_LOG(level, msg) \
+    do { \
+        static LogSite cpLogSite_(__FILE__, __LINE__); \
+        uint32_t cpLogSuppressed_ = 0; \
+        if (NativeLog::Enabled(level) && cpLogSite_.Admit(cpLogSuppressed_)) { \
+            NativeLog::Line cpLogLine_(level, cpLogSite_, cpLogSuppressed_); \
+            cpLogLine_.Stream() << msg; \
+        } \
+    } while (0)
@@ -0,0 +1,29 @@
+// Runs the native unit tests. Prints one line per case, "ok <name>" or
+// "fail <name>: <file>:<line>: <condition>", and exits non-zero when any
+// case failed. An argument runs only the cases whose name starts with it.
+
+#include <cstdio>
+#include <cstring>
+
+#include "native-tests.h"
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    int failed = 0;
+    for (const auto& test : native_tests::Cases()) {
+        if (std::strncmp(test.name.c_str(), filter, std::strlen(filter)) != 0) {
+            continue;
+        }
+        native_tests::Failures().clear();
+        test.run();
+        if (native_tests::Failures().empty()) {
+            std::printf("ok %s\n", test.name.c_str());
+            continue;
+        }
+        failed++;
+        for (const auto& failure : native_tests::Failures()) {
+            std::printf("fail %s: %s\n", test.name.c_str(), failure.c_str());
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal harness for the native unit tests in *-test.cpp, built into the
+// native-tests executable and run by tests/native-unit.spec.ts. Never
+// shipped with the app.
+//
+// NATIVE_TEST(group, name) registers a case; NATIVE_CHECK records a failed
+// condition and carries on with the case.
+
+namespace native_tests {
+
+struct Case {
+    std::string name;
+    std::function<void()> run;
+};
+
+inline std::vector<Case>& Cases() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+// Failures of the running case
+inline std::vector<std::string>& Failures() {
+    static std::vector<std::string> failures;
+    return failures;
+}
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> run) { Cases().push_back({name, std::move(run)}); }
+};
+
+inline void Fail(const char* file, int line, const char* expression) {
+    char message[512];
+    std::snprintf(message, sizeof(message), "%s:%d: %s", file, line, expression);
+    Failures().push_back(message);
+}
+
+}  // namespace native_tests
+
+#define NATIVE_TEST(group, name)                                                                   \
+    static void group##_##name();                                                                  \
+    static native_tests::Registrar group##_##name##_registrar(#group "." #name, &group##_##name); \
+    static void group##_##name()
+
+#define NATIVE_CHECK(condition)                                       \
+    do {                                                              \
+        if (!(condition)) {                                           \
+            native_tests::Fail(__FILE__, __LINE__, #condition);       \
+        }                                                             \
+    } while (0)
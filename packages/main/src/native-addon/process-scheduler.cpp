@@ -0,0 +1,553 @@
+#include "process-scheduler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include "addon-common.h"
+#include "addon-core.h"
+#include "process-tree.h"
+
+#if defined(__APPLE__) || defined(__linux__)
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr int kUnset = SchedulingPolicy::kUnset;
+
+// Fields set in source replace those of target
+void Overlay(SchedulingPolicy& target, const SchedulingPolicy& source) {
+    if (source.nice != kUnset) {
+        target.nice = source.nice;
+    }
+    if (source.ioClass != kUnset) {
+        target.ioClass = source.ioClass;
+        target.ioLevel = source.ioLevel;
+    }
+    if (!source.cpus.empty()) {
+        target.cpus = source.cpus;
+    }
+    if (source.cpuWeight != kUnset) {
+        target.cpuWeight = source.cpuWeight;
+    }
+    if (source.cpuMaxPercent != kUnset) {
+        target.cpuMaxPercent = source.cpuMaxPercent;
+    }
+}
+
+// The defaults of the fields set in fields
+SchedulingPolicy DefaultsFor(const SchedulingPolicy& fields) {
+    SchedulingPolicy defaults = ProcessScheduler::Defaults();
+    SchedulingPolicy result;
+    if (fields.nice != kUnset) {
+        result.nice = defaults.nice;
+    }
+    if (fields.ioClass != kUnset) {
+        result.ioClass = defaults.ioClass;
+        result.ioLevel = defaults.ioLevel;
+    }
+    if (!fields.cpus.empty()) {
+        result.cpus = defaults.cpus;
+    }
+    if (fields.cpuWeight != kUnset) {
+        result.cpuWeight = defaults.cpuWeight;
+    }
+    if (fields.cpuMaxPercent != kUnset) {
+        result.cpuMaxPercent = defaults.cpuMaxPercent;
+    }
+    return result;
+}
+
+bool UsesGroup(const SchedulingPolicy& policy) {
+    return policy.cpuWeight != kUnset || policy.cpuMaxPercent != kUnset;
+}
+
+#ifdef __linux__
+
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassShift = 13;
+
+bool WriteFile(const std::string& path, const std::string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size());
+    close(fd);
+    return ok;
+}
+
+// Calls fn for every thread of pid; none once the process is gone
+template <typename Fn>
+void ForEachThread(int pid, Fn&& fn) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR* dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    while (dirent* entry = readdir(dir)) {
+        int tid = atoi(entry->d_name);
+        if (tid > 0) {
+            fn(tid);
+        }
+    }
+    closedir(dir);
+}
+
+#elif _WIN32
+
+DWORD PriorityClassFor(int nice) {
+    if (nice <= -15) {
+        return HIGH_PRIORITY_CLASS;
+    }
+    if (nice <= -5) {
+        return ABOVE_NORMAL_PRIORITY_CLASS;
+    }
+    if (nice < 5) {
+        return NORMAL_PRIORITY_CLASS;
+    }
+    if (nice < 15) {
+        return BELOW_NORMAL_PRIORITY_CLASS;
+    }
+    return IDLE_PRIORITY_CLASS;
+}
+
+// cgroup weights (1-10000, 100 by default) onto job weights (1-9, 5 by default)
+DWORD JobWeightFor(int weight) {
+    if (weight <= 100) {
+        return static_cast<DWORD>(1 + std::max(weight, 1) * 4 / 100);
+    }
+    return static_cast<DWORD>(5 + std::min(4, (weight - 100) * 4 / 900));
+}
+
+#endif
+
+}  // namespace
+
+ProcessScheduler::ProcessScheduler(std::shared_ptr<AddonCore> core) : core_(std::move(core)) {
+    running_ = true;
+    thread_ = std::thread(&ProcessScheduler::Run, this);
+}
+
+ProcessScheduler::~ProcessScheduler() {
+    if (focusListener_) {
+        core_->Foreground()->RemoveListener(focusListener_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        wake_.notify_one();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto& [root, profile] : profiles_) {
+        ReleaseGroupLocked(profile);
+    }
+}
+
+SchedulingPolicy ProcessScheduler::Defaults() {
+    SchedulingPolicy defaults;
+    defaults.nice = 0;
+    defaults.ioClass = 0;
+    defaults.ioLevel = 0;
+    int cpus = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    for (int cpu = 0; cpu < cpus; cpu++) {
+        defaults.cpus.push_back(cpu);
+    }
+    defaults.cpuWeight = 100;
+    defaults.cpuMaxPercent = 0;
+    return defaults;
+}
+
+bool ProcessScheduler::SetCgroupRoot(const std::string& path) {
+#ifdef __linux__
+    // Profile cgroups need the cpu controller, and the root must not hold
+    // processes itself for it to be enabled
+    if (access((path + "/cgroup.procs").c_str(), W_OK) != 0 ||
+        !WriteFile(path + "/cgroup.subtree_control", "+cpu")) {
+        LOG_WARN("Cannot use " << path << " as the profile cgroup root (errno " << errno << ")");
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cgroupRoot_ = path;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+int ProcessScheduler::SetPolicy(int root, const SchedulingPolicy& policy, int& failed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Profile& profile = profiles_[root];
+    // Settings the previous policy changed and this one leaves alone go back
+    // to their defaults
+    SchedulingPolicy next = DefaultsFor(profile.policy);
+    Overlay(next, policy);
+    profile.policy = next;
+    failed = 0;
+    int processes = ApplyLocked(root, profile, true, failed);
+    // Defaults of dropped settings only need applying once
+    profile.policy = policy;
+    if (!boost_.Empty() && boosted_ == 0) {
+        UpdateBoostLocked();
+    }
+    return processes;
+}
+
+bool ProcessScheduler::ClearPolicy(int root) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = profiles_.find(root);
+    if (it == profiles_.end()) {
+        return false;
+    }
+    Profile& profile = it->second;
+    SchedulingPolicy fields = profile.policy;
+    if (boosted_ == root) {
+        Overlay(fields, boost_);
+        boosted_ = 0;
+    }
+    profile.policy = DefaultsFor(fields);
+    if (!profile.grouped) {
+        // There is no cgroup or job to reset
+        profile.policy.cpuWeight = kUnset;
+        profile.policy.cpuMaxPercent = kUnset;
+    }
+    int failed = 0;
+    ApplyLocked(root, profile, true, failed);
+    ReleaseGroupLocked(profile);
+    profiles_.erase(it);
+    return true;
+}
+
+bool ProcessScheduler::SetForegroundBoost(const SchedulingPolicy& boost) {
+    ForegroundTracker* tracker = core_->Foreground();
+    // Listeners are called with the tracker's lock held, so it is never
+    // taken under ours
+    uint64_t listener = 0;
+    bool subscribe = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribe = tracker && !boost.Empty() && focusListener_ == 0;
+    }
+    if (subscribe) {
+        listener = tracker->AddListener([this](int pid, int) { OnFocus(pid); });
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (listener) {
+        focusListener_ = listener;
+    }
+    if (tracker) {
+        focusPid_ = tracker->ActivePid();
+    }
+    // Every profile resets what the boost changes, so all are re-applied;
+    // fields only the old boost set go back to their defaults
+    SchedulingPolicy previous = boost_;
+    boost_ = boost;
+    boosted_ = 0;
+    for (auto& [root, profile] : profiles_) {
+        SchedulingPolicy saved = profile.policy;
+        profile.policy = DefaultsFor(previous);
+        Overlay(profile.policy, saved);
+        int failed = 0;
+        ApplyLocked(root, profile, true, failed);
+        profile.policy = saved;
+    }
+    UpdateBoostLocked();
+    return tracker != nullptr;
+}
+
+SchedulingStats ProcessScheduler::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SchedulingStats stats = stats_;
+    stats.profiles = static_cast<int>(profiles_.size());
+    stats.processes = 0;
+    for (const auto& [root, profile] : profiles_) {
+        stats.processes += static_cast<int>(profile.applied.size());
+    }
+    stats.boostedPid = boosted_;
+    stats.cgroups = !cgroupRoot_.empty();
+    return stats;
+}
+
+SchedulingPolicy ProcessScheduler::EffectiveLocked(int root, const Profile& profile) const {
+    // While a boost is set, what it changes is reset on every other profile
+    SchedulingPolicy policy = DefaultsFor(boost_);
+    if (!profile.grouped && root != boosted_) {
+        // No cgroup or job to reset
+        policy.cpuWeight = kUnset;
+        policy.cpuMaxPercent = kUnset;
+    }
+    Overlay(policy, profile.policy);
+    if (root == boosted_) {
+        Overlay(policy, boost_);
+    }
+    return policy;
+}
+
+int ProcessScheduler::ApplyLocked(int root, Profile& profile, bool all, int& failed) {
+    SchedulingPolicy policy = EffectiveLocked(root, profile);
+    if (all) {
+        profile.applied.clear();
+        profile.grouped = UsesGroup(policy) && PrepareGroupLocked(root, profile, policy);
+    }
+    if (policy.Empty()) {
+        return 0;
+    }
+
+    std::unordered_set<int> applied;
+    int processes = 0;
+    for (int pid : *ProcessTree::Shared().Descendants(root)) {
+        applied.insert(pid);
+        if (profile.applied.count(pid) == 0) {
+            failed += ApplyToProcess(root, profile, policy, pid);
+            processes++;
+        }
+    }
+    profile.applied.swap(applied);
+    return processes;
+}
+
+void ProcessScheduler::UpdateBoostLocked() {
+    int owner = 0;
+    if (!boost_.Empty() && focusPid_ > 0) {
+        for (const auto& [root, profile] : profiles_) {
+            if (ProcessTree::Shared().Contains(root, focusPid_)) {
+                owner = root;
+                break;
+            }
+        }
+    }
+    if (owner == boosted_) {
+        return;
+    }
+
+    int previous = boosted_;
+    boosted_ = owner;
+    int failed = 0;
+    for (int root : {previous, owner}) {
+        auto it = profiles_.find(root);
+        if (it != profiles_.end()) {
+            ApplyLocked(root, it->second, true, failed);
+        }
+    }
+    LOG_DEBUG("Foreground boost moved from " << previous << " to " << owner);
+}
+
+void ProcessScheduler::OnFocus(int pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    focusPid_ = pid;
+    focusChanged_ = true;
+    wake_.notify_one();
+}
+
+void ProcessScheduler::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        wake_.wait_for(lock, ProcessTree::kRefreshInterval, [this] { return !running_ || focusChanged_; });
+        if (!running_) {
+            break;
+        }
+        if (focusChanged_) {
+            focusChanged_ = false;
+            UpdateBoostLocked();
+        }
+        // Processes started since the last pass
+        for (auto& [root, profile] : profiles_) {
+            int failed = 0;
+            ApplyLocked(root, profile, false, failed);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Platform backends
+
+#ifdef __linux__
+
+bool ProcessScheduler::PrepareGroupLocked(int root, Profile&, const SchedulingPolicy& policy) {
+    if (cgroupRoot_.empty()) {
+        return false;
+    }
+    std::string group = cgroupRoot_ + "/profile-" + std::to_string(root);
+    if (mkdir(group.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOG_WARN("Cannot create cgroup " << group << " (errno " << errno << ")");
+        return false;
+    }
+    bool ok = true;
+    if (policy.cpuWeight != kUnset) {
+        ok &= WriteFile(group + "/cpu.weight", std::to_string(std::clamp(policy.cpuWeight, 1, 10000)));
+    }
+    if (policy.cpuMaxPercent != kUnset) {
+        // Quota per 100 ms period
+        std::string max = policy.cpuMaxPercent > 0 ? std::to_string(policy.cpuMaxPercent * 1000) : "max";
+        ok &= WriteFile(group + "/cpu.max", max + " 100000");
+    }
+    return ok;
+}
+
+void ProcessScheduler::ReleaseGroupLocked(Profile&) {
+    // The cgroup stays until its processes are gone; it was reset to the
+    // defaults already
+}
+
+int ProcessScheduler::ApplyToProcess(int root, const Profile& profile, const SchedulingPolicy& policy, int pid) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : policy.cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    // A setting fails for the process when it fails for any of its threads
+    bool threads = false;
+    bool niceOk = true;
+    bool ioOk = true;
+    bool affinityOk = true;
+    ForEachThread(pid, [&](int tid) {
+        threads = true;
+        if (policy.nice != kUnset) {
+            niceOk &= setpriority(PRIO_PROCESS, static_cast<id_t>(tid), std::clamp(policy.nice, -20, 19)) == 0;
+        }
+        if (policy.ioClass != kUnset) {
+            int level = policy.ioClass == 0 ? 0 : std::clamp(policy.ioLevel, 0, 7);
+            ioOk &= syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, (policy.ioClass << kIoprioClassShift) | level) == 0;
+        }
+        if (!policy.cpus.empty()) {
+            affinityOk &= sched_setaffinity(tid, sizeof(cpus), &cpus) == 0;
+        }
+    });
+    if (!threads) {
+        return 0;
+    }
+
+    int applied = 0;
+    int failed = 0;
+    auto count = [&](bool set, bool ok) {
+        if (set) {
+            (ok ? applied : failed)++;
+        }
+    };
+    count(policy.nice != kUnset, niceOk);
+    count(policy.ioClass != kUnset, ioOk);
+    count(!policy.cpus.empty(), affinityOk);
+    if (UsesGroup(policy)) {
+        // Moving a process moves all of its threads, and its children start
+        // in the same cgroup
+        count(true, profile.grouped && WriteFile(cgroupRoot_ + "/profile-" + std::to_string(root) + "/cgroup.procs",
+                                                 std::to_string(pid)));
+    }
+    stats_.applied += applied;
+    stats_.failed += failed;
+    return failed;
+}
+
+#elif _WIN32
+
+bool ProcessScheduler::PrepareGroupLocked(int, Profile& profile, const SchedulingPolicy& policy) {
+    if (!profile.job) {
+        profile.job = CreateJobObjectW(nullptr, nullptr);
+        if (!profile.job) {
+            LOG_WARN("CreateJobObject failed (LastError: " << GetLastError() << ")");
+            return false;
+        }
+    }
+    // A job has either a hard cap or a weight
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = {};
+    if (policy.cpuMaxPercent != kUnset && policy.cpuMaxPercent > 0) {
+        rate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+        rate.CpuRate = static_cast<DWORD>(std::clamp(policy.cpuMaxPercent, 1, 100) * 100);
+    } else if (policy.cpuWeight != kUnset) {
+        rate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED;
+        rate.Weight = JobWeightFor(policy.cpuWeight);
+    }
+    return SetInformationJobObject(profile.job, JobObjectCpuRateControlInformation, &rate, sizeof(rate)) != 0;
+}
+
+void ProcessScheduler::ReleaseGroupLocked(Profile& profile) {
+    // The job lives on with its processes, without rate control
+    if (profile.job) {
+        CloseHandle(profile.job);
+        profile.job = nullptr;
+    }
+}
+
+int ProcessScheduler::ApplyToProcess(int, const Profile& profile, const SchedulingPolicy& policy, int pid) {
+    HANDLE process = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_SET_QUOTA |
+                                     PROCESS_TERMINATE,
+                                 FALSE, static_cast<DWORD>(pid));
+    if (!process) {
+        return 0;
+    }
+
+    int applied = 0;
+    int failed = 0;
+    auto count = [&](bool set, bool ok) {
+        if (set) {
+            (ok ? applied : failed)++;
+        }
+    };
+    if (policy.nice != kUnset) {
+        count(true, SetPriorityClass(process, PriorityClassFor(policy.nice)) != 0);
+    }
+    if (!policy.cpus.empty()) {
+        DWORD_PTR mask = 0;
+        for (int cpu : policy.cpus) {
+            if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+                mask |= static_cast<DWORD_PTR>(1) << cpu;
+            }
+        }
+        count(true, SetProcessAffinityMask(process, mask) != 0);
+    }
+    if (UsesGroup(policy)) {
+        // Children of a process in a job start in the job
+        BOOL inJob = FALSE;
+        bool ok = profile.grouped && ((IsProcessInJob(process, profile.job, &inJob) && inJob) ||
+                                      AssignProcessToJobObject(profile.job, process));
+        count(true, ok);
+    }
+    // I/O priority is Linux only and left alone here
+    CloseHandle(process);
+
+    stats_.applied += applied;
+    stats_.failed += failed;
+    return failed;
+}
+
+#else
+
+bool ProcessScheduler::PrepareGroupLocked(int, Profile&, const SchedulingPolicy&) {
+    return false;
+}
+
+void ProcessScheduler::ReleaseGroupLocked(Profile&) {}
+
+int ProcessScheduler::ApplyToProcess(int, const Profile&, const SchedulingPolicy& policy, int pid) {
+    int applied = 0;
+    int failed = 0;
+    if (policy.nice != kUnset) {
+        (setpriority(PRIO_PROCESS, static_cast<id_t>(pid), std::clamp(policy.nice, -20, 19)) == 0 ? applied
+                                                                                                   : failed)++;
+    }
+    // No affinity, I/O priority or CPU groups here
+    failed += (!policy.cpus.empty()) + (policy.ioClass != kUnset) + UsesGroup(policy);
+    stats_.applied += applied;
+    stats_.failed += failed;
+    return failed;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+class AddonCore;
+
+// How the processes of one profile are scheduled. Unset fields leave that
+// setting alone.
+struct SchedulingPolicy {
+    static constexpr int kUnset = -1000;
+
+    // -20 (highest) to 19. On Windows this picks the priority class (idle,
+    // below normal, normal, above normal or high).
+    int nice = kUnset;
+    // Linux I/O priority: class 0 none (follow nice), 1 realtime, 2 best
+    // effort, 3 idle; level 0-7 for the middle two
+    int ioClass = kUnset;
+    int ioLevel = 4;
+    // CPUs the processes may run on; empty for all
+    std::vector<int> cpus;
+    // Relative CPU share, 1-10000 with 100 the default (cgroup v2 cpu.weight;
+    // on Windows a job object weight, scaled to 1-9)
+    int cpuWeight = kUnset;
+    // Hard cap in percent of one CPU (cgroup v2 cpu.max; on Windows a job
+    // object rate, in percent of the whole machine); 0 removes the cap
+    int cpuMaxPercent = kUnset;
+
+    bool Empty() const {
+        return nice == kUnset && ioClass == kUnset && cpus.empty() && cpuWeight == kUnset &&
+               cpuMaxPercent == kUnset;
+    }
+};
+
+struct SchedulingStats {
+    int profiles = 0;
+    int processes = 0;      // processes the policies were applied to
+    uint64_t applied = 0;   // settings applied, per process
+    uint64_t failed = 0;
+    int boostedPid = 0;     // profile currently boosted, 0 for none
+    bool cgroups = false;   // cpuWeight/cpuMaxPercent are backed by cgroups
+};
+
+// Applies scheduling policies to the whole process tree of a profile (see
+// ProcessTree): niceness and I/O priority, CPU affinity, and CPU weight and
+// caps through cgroup v2 on Linux or a job object per profile on Windows.
+// macOS only has niceness.
+//
+// A background thread applies the policy to processes Chrome starts later,
+// once the process index has seen them. Priorities and affinity are
+// per-thread on Linux, so a new process gets them on every thread it has;
+// threads it creates afterwards inherit them. Processes in a cgroup or job
+// object take their children along by themselves.
+//
+// With a foreground boost set, the profile owning the focused window gets
+// the boost policy on top of its own until focus moves elsewhere. Taking a
+// higher priority back (a lower nice value or I/O level) needs CAP_SYS_NICE
+// or a raised RLIMIT_NICE on Linux, so unprivileged boosts are best built on
+// cgroup weights.
+class ProcessScheduler {
+public:
+    explicit ProcessScheduler(std::shared_ptr<AddonCore> core);
+    ~ProcessScheduler();
+
+    ProcessScheduler(const ProcessScheduler&) = delete;
+    ProcessScheduler& operator=(const ProcessScheduler&) = delete;
+
+    // Delegated cgroup v2 directory (writable by us) under which one child
+    // cgroup per profile is created. Without one, cgroup settings fail.
+    bool SetCgroupRoot(const std::string& path);
+
+    // Apply policy to root's process tree now and to processes started
+    // later. Returns the number of processes it was applied to; failed counts
+    // the settings that could not be applied.
+    int SetPolicy(int root, const SchedulingPolicy& policy, int& failed);
+    // Restore default scheduling for root's processes and stop following it
+    bool ClearPolicy(int root);
+
+    // Policy merged over the focused profile's own; an empty policy turns
+    // the boost off. False when focus changes cannot be followed.
+    bool SetForegroundBoost(const SchedulingPolicy& boost);
+
+    SchedulingStats Stats();
+
+    // Settings applied by default: what ClearPolicy restores
+    static SchedulingPolicy Defaults();
+
+private:
+    struct Profile {
+        SchedulingPolicy policy;
+        // Processes the current policy was applied to
+        std::unordered_set<int> applied;
+        // The profile's cgroup or job object is set up for the policy
+        bool grouped = false;
+#ifdef _WIN32
+        HANDLE job = nullptr;
+#endif
+    };
+
+    // Called with mutex_ held
+    SchedulingPolicy EffectiveLocked(int root, const Profile& profile) const;
+    // Apply the effective policy to the processes of root it was not applied
+    // to yet, or to all of them. Returns the processes it was applied to.
+    int ApplyLocked(int root, Profile& profile, bool all, int& failed);
+    // Returns the settings that failed, 0 when the process is gone
+    int ApplyToProcess(int root, const Profile& profile, const SchedulingPolicy& policy, int pid);
+    // Create or update the cgroup or job object of root
+    bool PrepareGroupLocked(int root, Profile& profile, const SchedulingPolicy& policy);
+    void ReleaseGroupLocked(Profile& profile);
+    // Move the boost to the profile owning focusPid_
+    void UpdateBoostLocked();
+
+    void OnFocus(int pid);
+    void Run();
+
+    std::shared_ptr<AddonCore> core_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::unordered_map<int, Profile> profiles_;
+    SchedulingPolicy boost_;
+    int boosted_ = 0;
+    int focusPid_ = 0;
+    bool focusChanged_ = false;
+    uint64_t focusListener_ = 0;
+    std::string cgroupRoot_;
+    SchedulingStats stats_;
+    bool running_ = false;
+    std::thread thread_;
+};
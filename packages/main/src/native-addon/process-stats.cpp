@@ -0,0 +1,269 @@
+#include "process-stats.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "process-tree.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#include <unordered_map>
+#elif __APPLE__
+#include <libproc.h>
+#include <mach/mach_time.h>
+#include <sys/proc_info.h>
+#elif __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+namespace {
+
+uint64_t FileTimeNs(const FILETIME& time) {
+    // FILETIME counts 100 ns units
+    return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+}
+
+}  // namespace
+
+bool ReadProcessCpuTime(int pid, uint64_t& cpuNs) {
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!process) {
+        return false;
+    }
+    FILETIME creation, exit, kernel, user;
+    bool ok = GetProcessTimes(process, &creation, &exit, &kernel, &user) != 0;
+    CloseHandle(process);
+    if (!ok) {
+        return false;
+    }
+    cpuNs = FileTimeNs(kernel) + FileTimeNs(user);
+    return true;
+}
+
+void ReadProcessUsage(const std::vector<int>& pids, std::vector<ProcessUsage>& usage, bool) {
+    usage.assign(pids.size(), ProcessUsage());
+
+    // Thread counts only come with a process snapshot, one for all pids
+    std::unordered_map<int, uint32_t> threads;
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot != INVALID_HANDLE_VALUE) {
+        PROCESSENTRY32 entry;
+        entry.dwSize = sizeof(entry);
+        for (BOOL more = Process32First(snapshot, &entry); more; more = Process32Next(snapshot, &entry)) {
+            threads.emplace(static_cast<int>(entry.th32ProcessID), entry.cntThreads);
+        }
+        CloseHandle(snapshot);
+    }
+
+    for (size_t i = 0; i < pids.size(); i++) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pids[i]));
+        if (!process) {
+            continue;
+        }
+        ProcessUsage& entry = usage[i];
+        FILETIME creation, exit, kernel, user;
+        if (GetProcessTimes(process, &creation, &exit, &kernel, &user)) {
+            entry.cpuNs = FileTimeNs(kernel) + FileTimeNs(user);
+            entry.ok = true;
+        }
+        PROCESS_MEMORY_COUNTERS_EX memory;
+        if (GetProcessMemoryInfo(process, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory))) {
+            entry.rssBytes = memory.WorkingSetSize;
+            entry.pssBytes = memory.PrivateUsage;
+        }
+        CloseHandle(process);
+        auto it = threads.find(pids[i]);
+        entry.threads = it != threads.end() ? it->second : 0;
+    }
+}
+
+#elif __APPLE__
+
+namespace {
+
+// Mach absolute time units, which are not nanoseconds on Apple silicon
+uint64_t MachTimeNs(uint64_t time) {
+    static mach_timebase_info_data_t timebase = [] {
+        mach_timebase_info_data_t value;
+        mach_timebase_info(&value);
+        return value;
+    }();
+    return time * timebase.numer / timebase.denom;
+}
+
+}  // namespace
+
+bool ReadProcessCpuTime(int pid, uint64_t& cpuNs) {
+    struct proc_taskinfo info;
+    if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) != sizeof(info)) {
+        return false;
+    }
+    cpuNs = MachTimeNs(info.pti_total_user + info.pti_total_system);
+    return true;
+}
+
+void ReadProcessUsage(const std::vector<int>& pids, std::vector<ProcessUsage>& usage, bool withPss) {
+    usage.assign(pids.size(), ProcessUsage());
+    for (size_t i = 0; i < pids.size(); i++) {
+        struct proc_taskinfo info;
+        if (proc_pidinfo(pids[i], PROC_PIDTASKINFO, 0, &info, sizeof(info)) != sizeof(info)) {
+            continue;
+        }
+        ProcessUsage& entry = usage[i];
+        entry.cpuNs = MachTimeNs(info.pti_total_user + info.pti_total_system);
+        entry.rssBytes = info.pti_resident_size;
+        entry.threads = static_cast<uint32_t>(info.pti_threadnum);
+        entry.ok = true;
+        rusage_info_v2 rusage;
+        if (withPss && proc_pid_rusage(pids[i], RUSAGE_INFO_V2, reinterpret_cast<rusage_info_t*>(&rusage)) == 0) {
+            entry.pssBytes = rusage.ri_phys_footprint;
+        }
+    }
+}
+
+#elif __linux__
+
+namespace {
+
+// Read a small /proc file into buffer, NUL terminated. Returns its length,
+// 0 when it cannot be read.
+size_t ReadProcFile(const char* path, char* buffer, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length <= 0) {
+        return 0;
+    }
+    buffer[length] = '\0';
+    return static_cast<size_t>(length);
+}
+
+// /proc/<pid>/stat: utime + stime (fields 14 and 15) in clock ticks, the
+// thread count (field 20) and the resident set (field 24) in pages
+bool ReadStat(int pid, uint64_t& ticks, uint32_t& threads, uint64_t& rssPages) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    char buffer[512];
+    if (ReadProcFile(path, buffer, sizeof(buffer)) == 0) {
+        return false;
+    }
+
+    // Fields resume after the last ')' of the command name, at field 3
+    char* cursor = strrchr(buffer, ')');
+    if (!cursor) {
+        return false;
+    }
+    cursor++;
+    ticks = 0;
+    for (int field = 3; field <= 24; field++) {
+        while (*cursor == ' ') {
+            cursor++;
+        }
+        if (field == 14 || field == 15 || field == 20 || field == 24) {
+            char* end = nullptr;
+            uint64_t value = strtoull(cursor, &end, 10);
+            if (end == cursor) {
+                return false;
+            }
+            if (field == 20) {
+                threads = static_cast<uint32_t>(value);
+            } else if (field == 24) {
+                rssPages = value;
+            } else {
+                ticks += value;
+            }
+        }
+        if (field < 24) {
+            cursor = strchr(cursor, ' ');
+            if (!cursor) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+uint64_t TicksToNs(uint64_t ticks) {
+    static const uint64_t ticksPerSecond = static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+    return ticks * (1000000000ull / ticksPerSecond);
+}
+
+// "Pss:" of /proc/<pid>/smaps_rollup (Linux 4.14+), in bytes
+bool ReadPss(int pid, uint64_t& pssBytes) {
+    char path[40];
+    snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", pid);
+    char buffer[2048];
+    if (ReadProcFile(path, buffer, sizeof(buffer)) == 0) {
+        return false;
+    }
+    const char* line = strstr(buffer, "\nPss:");
+    if (!line) {
+        return false;
+    }
+    pssBytes = strtoull(line + 5, nullptr, 10) * 1024;
+    return true;
+}
+
+}  // namespace
+
+bool ReadProcessCpuTime(int pid, uint64_t& cpuNs) {
+    uint64_t ticks = 0;
+    uint32_t threads = 0;
+    uint64_t rssPages = 0;
+    if (!ReadStat(pid, ticks, threads, rssPages)) {
+        return false;
+    }
+    cpuNs = TicksToNs(ticks);
+    return true;
+}
+
+void ReadProcessUsage(const std::vector<int>& pids, std::vector<ProcessUsage>& usage, bool withPss) {
+    static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    usage.assign(pids.size(), ProcessUsage());
+    for (size_t i = 0; i < pids.size(); i++) {
+        ProcessUsage& entry = usage[i];
+        uint64_t ticks = 0;
+        uint64_t rssPages = 0;
+        if (!ReadStat(pids[i], ticks, entry.threads, rssPages)) {
+            continue;
+        }
+        entry.cpuNs = TicksToNs(ticks);
+        entry.rssBytes = rssPages * pageSize;
+        entry.ok = true;
+        if (withPss) {
+            ReadPss(pids[i], entry.pssBytes);
+        }
+    }
+}
+
+#else
+
+bool ReadProcessCpuTime(int, uint64_t&) {
+    return false;
+}
+
+void ReadProcessUsage(const std::vector<int>& pids, std::vector<ProcessUsage>& usage, bool) {
+    usage.assign(pids.size(), ProcessUsage());
+}
+
+#endif
+
+uint64_t ProcessTreeCpuTime(int root) {
+    uint64_t total = 0;
+    for (int pid : *ProcessTree::Shared().Descendants(root)) {
+        uint64_t cpuNs = 0;
+        if (ReadProcessCpuTime(pid, cpuNs)) {
+            total += cpuNs;
+        }
+    }
+    return total;
+}
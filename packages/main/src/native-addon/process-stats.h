@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Resource use of Chrome processes, read from the OS without sampling
+// threads: /proc/<pid>/stat on Linux, GetProcessTimes on Windows and
+// proc_pidinfo on macOS.
+
+// CPU time (user + system) the process has used so far, in nanoseconds.
+// False when the process is gone or cannot be read.
+bool ReadProcessCpuTime(int pid, uint64_t& cpuNs);
+
+struct ProcessUsage {
+    uint64_t cpuNs = 0;
+    uint64_t rssBytes = 0;
+    // Proportional set size (shared pages split between their users) on
+    // Linux. Elsewhere the nearest per-process figure: private bytes on
+    // Windows, the physical footprint on macOS.
+    uint64_t pssBytes = 0;
+    uint32_t threads = 0;
+    bool ok = false;          // false when the process is gone
+};
+
+// Usage of every pid, in the same order. PSS comes from smaps_rollup, which
+// walks every mapping and costs more than the rest together, so it is only
+// read when withPss is set (pssBytes stays 0 otherwise).
+void ReadProcessUsage(const std::vector<int>& pids, std::vector<ProcessUsage>& usage, bool withPss);
+
+// CPU time of root and every process it started (see ProcessTree), which
+// for a profile covers the browser, renderer and GPU processes
+uint64_t ProcessTreeCpuTime(int root);
@@ -0,0 +1,204 @@
+#include <map>
+#include <thread>
+
+#include "native-tests.h"
+#include "process-tree.h"
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Process = ProcessTree::Process;
+
+// A process table the tests edit between refreshes. Counts scans and how
+// often each pid was read.
+struct Table {
+    std::map<int, Process> processes;
+    int scans = 0;
+    std::map<int, int> reads;
+
+    ProcessTree::Scanner Scanner() {
+        return [this](const std::function<bool(int)>& indexed, std::vector<int>& alive,
+                      std::vector<std::pair<int, Process>>& added) {
+            scans++;
+            for (const auto& entry : processes) {
+                alive.push_back(entry.first);
+                if (!indexed(entry.first)) {
+                    reads[entry.first]++;
+                    added.emplace_back(entry.first, entry.second);
+                }
+            }
+        };
+    }
+};
+
+// init, a launcher wrapper, the Chrome it started and two of Chrome's
+// children, and an unrelated process. Start times follow pid order.
+Table LauncherTable() {
+    Table table;
+    table.processes = {
+        {1, {0, 1}},
+        {100, {1, 10}},
+        {101, {100, 11}},
+        {102, {101, 12}},
+        {103, {101, 13}},
+        {200, {1, 20}},
+    };
+    return table;
+}
+
+bool Is(const ProcessTree::PidSet& pids, std::initializer_list<int> expected) {
+    return pids == ProcessTree::PidSet(expected);
+}
+
+}  // namespace
+
+NATIVE_TEST(ProcessTree, ResolvesLauncherToDescendants) {
+    Table table = LauncherTable();
+    ProcessTree tree(table.Scanner());
+    NATIVE_CHECK(Is(*tree.Descendants(100), {100, 101, 102, 103}));
+    NATIVE_CHECK(Is(*tree.Descendants(101), {101, 102, 103}));
+    NATIVE_CHECK(Is(*tree.Descendants(103), {103}));
+    NATIVE_CHECK(tree.Contains(100, 102));
+    NATIVE_CHECK(!tree.Contains(100, 200));
+    // A pid that is not running is still its own tree
+    NATIVE_CHECK(Is(*tree.Descendants(999), {999}));
+}
+
+// Chrome keeps the wrapper it was first seen under after the wrapper exits
+// and Chrome is re-parented to init
+NATIVE_TEST(ProcessTree, KeepsChildrenOfAnExitedWrapper) {
+    Table table = LauncherTable();
+    ProcessTree tree(table.Scanner());
+    tree.Refresh();
+    table.processes.erase(100);
+    table.processes[101].parent = 1;
+    tree.Refresh();
+    NATIVE_CHECK(Is(*tree.Descendants(100), {100, 101, 102, 103}));
+    NATIVE_CHECK(!tree.Contains(1, 101));
+}
+
+NATIVE_TEST(ProcessTree, IgnoresARecycledParentPid) {
+    Table table = LauncherTable();
+    ProcessTree tree(table.Scanner());
+    tree.Refresh();
+
+    // The wrapper exits and its pid goes to a new process with a child of its own
+    table.processes.erase(100);
+    tree.Refresh();
+    table.processes[100] = {1, 50};
+    table.processes[150] = {100, 51};
+    tree.Refresh();
+    NATIVE_CHECK(Is(*tree.Descendants(100), {100, 150}));
+    NATIVE_CHECK(Is(*tree.Descendants(101), {101, 102, 103}));
+
+    // Parent and child seen in the same scan are told apart the same way
+    Table fresh;
+    fresh.processes = {{1, {0, 1}}, {300, {1, 90}}, {301, {300, 40}}, {302, {300, 91}}};
+    ProcessTree freshTree(fresh.Scanner());
+    NATIVE_CHECK(Is(*freshTree.Descendants(300), {300, 302}));
+}
+
+NATIVE_TEST(ProcessTree, ReadsOnlyNewProcesses) {
+    Table table = LauncherTable();
+    ProcessTree tree(table.Scanner());
+    for (int i = 0; i < 3; i++) {
+        tree.Refresh();
+    }
+    table.processes[104] = {101, 14};
+    tree.Refresh();
+    tree.Refresh();
+    NATIVE_CHECK(table.scans == 5);
+    bool once = true;
+    for (const auto& entry : table.reads) {
+        once = once && entry.second == 1;
+    }
+    NATIVE_CHECK(once);
+    NATIVE_CHECK(table.reads.size() == table.processes.size());
+    NATIVE_CHECK(tree.Contains(100, 104));
+
+    // An exited pid is forgotten, so its next owner is read afresh
+    table.processes.erase(104);
+    tree.Refresh();
+    NATIVE_CHECK(!tree.Contains(100, 104));
+    table.processes[104] = {200, 60};
+    tree.Refresh();
+    NATIVE_CHECK(table.reads[104] == 2);
+    NATIVE_CHECK(tree.Contains(200, 104));
+}
+
+// Lookups between refreshes neither scan nor walk the tree again
+NATIVE_TEST(ProcessTree, AnswersLookupsFromTheIndex) {
+    Table table = LauncherTable();
+    ProcessTree tree(table.Scanner());
+    auto first = tree.Descendants(100);
+    for (int i = 0; i < 1000; i++) {
+        NATIVE_CHECK(tree.Descendants(100) == first);
+        NATIVE_CHECK(tree.Contains(101, 103));
+    }
+    NATIVE_CHECK(table.scans == 1);
+
+    // A root the index has never seen, as right after a launch, rescans
+    // sooner than kRefreshInterval, but not on every lookup
+    table.processes[400] = {1, 30};
+    table.processes[401] = {400, 31};
+    NATIVE_CHECK(Is(*tree.Descendants(400), {400}));
+    NATIVE_CHECK(table.scans == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    NATIVE_CHECK(Is(*tree.Descendants(400), {400, 401}));
+    NATIVE_CHECK(table.scans == 2);
+    // A change rebuilds the cached sets
+    NATIVE_CHECK(tree.Descendants(100) != first);
+    NATIVE_CHECK(Is(*tree.Descendants(100), {100, 101, 102, 103}));
+}
+
+NATIVE_TEST(ProcessTree, OwnerMapPrefersTheEarlierRoot) {
+    Table table = LauncherTable();
+    ProcessTree tree(table.Scanner());
+    std::unordered_map<int, int> owners = tree.OwnerMap({101, 100, 200});
+    NATIVE_CHECK(owners.size() == 5);
+    NATIVE_CHECK(owners[100] == 100);
+    NATIVE_CHECK(owners[101] == 101);
+    NATIVE_CHECK(owners[102] == 101);
+    NATIVE_CHECK(owners[103] == 101);
+    NATIVE_CHECK(owners[200] == 200);
+    NATIVE_CHECK(owners.count(1) == 0);
+}
+
+#ifdef __linux__
+// The /proc scan: a wrapper that forks Chrome and exits, as launch scripts do
+NATIVE_TEST(ProcessTree, FindsTheChildOfARealWrapper) {
+    int fds[2];
+    NATIVE_CHECK(pipe(fds) == 0);
+    pid_t wrapper = fork();
+    if (wrapper == 0) {
+        pid_t child = fork();
+        if (child == 0) {
+            pause();
+            _exit(0);
+        }
+        (void)!write(fds[1], &child, sizeof(child));
+        pause();
+        _exit(0);
+    }
+    pid_t child = 0;
+    NATIVE_CHECK(read(fds[0], &child, sizeof(child)) == sizeof(child));
+    close(fds[0]);
+    close(fds[1]);
+
+    ProcessTree tree;
+    tree.Refresh();
+    NATIVE_CHECK(tree.Contains(wrapper, child));
+    NATIVE_CHECK(tree.Contains(getpid(), child));
+
+    kill(wrapper, SIGKILL);
+    waitpid(wrapper, nullptr, 0);
+    tree.Refresh();
+    NATIVE_CHECK(tree.Contains(wrapper, child));
+    kill(child, SIGKILL);
+}
+#endif
@@ -0,0 +1,291 @@
+#include "process-tree.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "addon-common.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <tlhelp32.h>
+#elif __APPLE__
+#include <libproc.h>
+#include <sys/proc_info.h>
+#elif __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// A lookup for a pid we have never seen (Chrome was just launched) may force
+// a refresh sooner than kRefreshInterval, but not more often than this
+constexpr std::chrono::milliseconds kMissRefreshInterval{100};
+
+#ifdef __linux__
+// Parent pid and start time (clock ticks since boot) from /proc/<pid>/stat
+bool ReadProcStat(int pid, int& parent, uint64_t& startTime) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char buffer[512];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+
+    // The command name may contain spaces and parentheses, fields resume after the last ')'
+    char* fields = strrchr(buffer, ')');
+    if (!fields) {
+        return false;
+    }
+    fields++;
+
+    // Field 4 is the parent pid and field 22 the start time; fields[0] is field 3
+    char* cursor = fields;
+    for (int field = 3; field <= 22; field++) {
+        char* end = nullptr;
+        while (*cursor == ' ') {
+            cursor++;
+        }
+        if (field == 4) {
+            parent = static_cast<int>(strtol(cursor, &end, 10));
+        } else if (field == 22) {
+            startTime = strtoull(cursor, &end, 10);
+            return end != cursor;
+        }
+        cursor = strchr(cursor, ' ');
+        if (!cursor) {
+            return false;
+        }
+    }
+    return false;
+}
+#endif
+
+}  // namespace
+
+ProcessTree& ProcessTree::Shared() {
+    static ProcessTree tree;
+    return tree;
+}
+
+std::shared_ptr<const ProcessTree::PidSet> ProcessTree::Descendants(int root) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RefreshIfStaleLocked(root);
+    return DescendantsLocked(root);
+}
+
+std::unordered_map<int, int> ProcessTree::OwnerMap(const std::vector<int>& roots) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<int, int> owners;
+    for (int root : roots) {
+        RefreshIfStaleLocked(root);
+        for (int pid : *DescendantsLocked(root)) {
+            owners.emplace(pid, root);
+        }
+    }
+    return owners;
+}
+
+void ProcessTree::Refresh() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RefreshLocked();
+}
+
+void ProcessTree::RefreshIfStaleLocked(int root) {
+    auto age = std::chrono::steady_clock::now() - lastRefresh_;
+    if (!initialized_ || age >= kRefreshInterval ||
+        (age >= kMissRefreshInterval && processes_.find(root) == processes_.end())) {
+        RefreshLocked();
+    }
+}
+
+void ProcessTree::RefreshLocked() {
+    std::vector<int> alive;
+    std::vector<std::pair<int, Process>> added;
+    if (scanner_) {
+        scanner_([this](int pid) { return processes_.count(pid) != 0; }, alive, added);
+    } else {
+        Scan(alive, added);
+    }
+    lastRefresh_ = std::chrono::steady_clock::now();
+    initialized_ = true;
+
+    std::sort(alive.begin(), alive.end());
+    bool changed = !added.empty();
+    for (auto it = processes_.begin(); it != processes_.end();) {
+        if (!std::binary_search(alive.begin(), alive.end(), it->first)) {
+            it = processes_.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    for (auto& entry : added) {
+        processes_[entry.first] = entry.second;
+    }
+    if (!changed) {
+        return;
+    }
+
+    children_.clear();
+    cache_.clear();
+    for (const auto& entry : processes_) {
+        const Process& process = entry.second;
+        if (process.parent <= 0 || process.parent == entry.first) {
+            continue;
+        }
+        // A parent pid that was recycled by a newer process is not our parent
+        auto parent = processes_.find(process.parent);
+        if (parent != processes_.end() && parent->second.startTime && process.startTime &&
+            parent->second.startTime > process.startTime) {
+            continue;
+        }
+        children_[process.parent].push_back(entry.first);
+    }
+}
+
+std::shared_ptr<const ProcessTree::PidSet> ProcessTree::DescendantsLocked(int root) {
+    auto cached = cache_.find(root);
+    if (cached != cache_.end()) {
+        return cached->second;
+    }
+
+    auto pids = std::make_shared<PidSet>();
+    pids->insert(root);
+    std::vector<int> pending{root};
+    while (!pending.empty() && root > 0) {
+        int pid = pending.back();
+        pending.pop_back();
+        auto children = children_.find(pid);
+        if (children == children_.end()) {
+            continue;
+        }
+        for (int child : children->second) {
+            if (pids->insert(child).second) {
+                pending.push_back(child);
+            }
+        }
+    }
+
+    cache_[root] = pids;
+    return pids;
+}
+
+#ifdef _WIN32
+
+void ProcessTree::Scan(std::vector<int>& alive, std::vector<std::pair<int, Process>>& added) {
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("CreateToolhelp32Snapshot failed (LastError: " << GetLastError() << ")");
+        // Keep the previous index rather than dropping every process
+        for (const auto& entry : processes_) {
+            alive.push_back(entry.first);
+        }
+        return;
+    }
+
+    PROCESSENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    for (BOOL ok = Process32First(snapshot, &entry); ok; ok = Process32Next(snapshot, &entry)) {
+        int pid = static_cast<int>(entry.th32ProcessID);
+        alive.push_back(pid);
+        if (processes_.count(pid)) {
+            continue;
+        }
+
+        Process process;
+        process.parent = static_cast<int>(entry.th32ParentProcessID);
+        HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, entry.th32ProcessID);
+        if (handle) {
+            FILETIME creation, exit, kernel, user;
+            if (GetProcessTimes(handle, &creation, &exit, &kernel, &user)) {
+                process.startTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+            }
+            CloseHandle(handle);
+        }
+        added.emplace_back(pid, process);
+    }
+    CloseHandle(snapshot);
+}
+
+#elif __APPLE__
+
+void ProcessTree::Scan(std::vector<int>& alive, std::vector<std::pair<int, Process>>& added) {
+    int capacity = proc_listallpids(nullptr, 0);
+    if (capacity <= 0) {
+        for (const auto& entry : processes_) {
+            alive.push_back(entry.first);
+        }
+        return;
+    }
+
+    // Leave headroom for processes started between the two calls
+    std::vector<pid_t> pids(static_cast<size_t>(capacity) + 64);
+    int count = proc_listallpids(pids.data(), static_cast<int>(pids.size() * sizeof(pid_t)));
+    for (int i = 0; i < count; i++) {
+        int pid = pids[i];
+        alive.push_back(pid);
+        if (processes_.count(pid)) {
+            continue;
+        }
+
+        struct proc_bsdinfo info;
+        if (proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, sizeof(info)) != sizeof(info)) {
+            continue;
+        }
+        Process process;
+        process.parent = static_cast<int>(info.pbi_ppid);
+        process.startTime = info.pbi_start_tvsec * 1000000ull + info.pbi_start_tvusec;
+        added.emplace_back(pid, process);
+    }
+}
+
+#elif __linux__
+
+void ProcessTree::Scan(std::vector<int>& alive, std::vector<std::pair<int, Process>>& added) {
+    DIR* proc = opendir("/proc");
+    if (!proc) {
+        LOG_ERROR("Failed to open /proc");
+        for (const auto& entry : processes_) {
+            alive.push_back(entry.first);
+        }
+        return;
+    }
+
+    while (dirent* entry = readdir(proc)) {
+        char* end = nullptr;
+        long pid = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || pid <= 0) {
+            continue;
+        }
+        alive.push_back(static_cast<int>(pid));
+        if (processes_.count(static_cast<int>(pid))) {
+            continue;
+        }
+
+        Process process;
+        if (ReadProcStat(static_cast<int>(pid), process.parent, process.startTime)) {
+            added.emplace_back(static_cast<int>(pid), process);
+        }
+    }
+    closedir(proc);
+}
+
+#else
+
+void ProcessTree::Scan(std::vector<int>& alive, std::vector<std::pair<int, Process>>&) {
+    for (const auto& entry : processes_) {
+        alive.push_back(entry.first);
+    }
+}
+
+#endif
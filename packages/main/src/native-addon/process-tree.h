@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Cached parent/child index of every process on the system.
+//
+// Chrome is not always the process we launched: wrappers and launchers fork
+// it, and the window may belong to a child of the stored pid. Window lookups
+// therefore match against all descendants of the launcher pid.
+//
+// The index is refreshed lazily, at most once per kRefreshInterval, and the
+// refresh is incremental: only processes that were not seen before are read
+// (/proc/<pid>/stat on Linux, proc_pidinfo on macOS; Toolhelp snapshots carry
+// the parent already). Processes keep the parent they were first seen with,
+// so a Chrome whose wrapper has exited is still found under the wrapper pid.
+// Start times guard against a recycled parent pid adopting unrelated processes.
+class ProcessTree {
+public:
+    using PidSet = std::unordered_set<int>;
+
+    struct Process {
+        int parent = 0;
+        uint64_t startTime = 0;
+    };
+
+    // Lists every live pid into alive and reads each pid that is not
+    // indexed yet into added
+    using Scanner = std::function<void(const std::function<bool(int pid)>& indexed, std::vector<int>& alive,
+                                       std::vector<std::pair<int, Process>>& added)>;
+
+    static constexpr std::chrono::milliseconds kRefreshInterval{1000};
+
+    ProcessTree() = default;
+    // Index over scanner rather than the system's process table, for tests
+    explicit ProcessTree(Scanner scanner) : scanner_(std::move(scanner)) {}
+
+    // Shared by every lookup in the process; all methods are thread-safe
+    static ProcessTree& Shared();
+
+    // root and all of its descendants. The set is cached until the index changes.
+    std::shared_ptr<const PidSet> Descendants(int root);
+
+    bool Contains(int root, int pid) { return Descendants(root)->count(pid) != 0; }
+
+    // Map every pid in the trees of roots to the root it belongs to. When the
+    // trees overlap, the earlier root wins.
+    std::unordered_map<int, int> OwnerMap(const std::vector<int>& roots);
+
+    // Re-read the process table now
+    void Refresh();
+
+private:
+    void RefreshLocked();
+    void RefreshIfStaleLocked(int root);
+    std::shared_ptr<const PidSet> DescendantsLocked(int root);
+
+    // Platform scan: every live pid goes to alive, and pids missing from
+    // processes_ are read and returned in added
+    void Scan(std::vector<int>& alive, std::vector<std::pair<int, Process>>& added);
+
+    Scanner scanner_;
+    std::mutex mutex_;
+    std::unordered_map<int, Process> processes_;
+    std::unordered_map<int, std::vector<int>> children_;
+    std::unordered_map<int, std::shared_ptr<const PidSet>> cache_;
+    std::chrono::steady_clock::time_point lastRefresh_;
+    bool initialized_ = false;
+};
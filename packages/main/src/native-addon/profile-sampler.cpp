@@ -0,0 +1,157 @@
+#include "profile-sampler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "process-tree.h"
+
+using Clock = std::chrono::steady_clock;
+
+ProfileSampler::ProfileSampler(const ProfileSamplerOptions& options, size_t slotCount)
+    : options_(options),
+      slotCount_(slotCount),
+      frames_(std::max<size_t>(options.history, 1) + 1),
+      frameSize_(slotCount * kProfileSampleStride),
+      ring_(frames_ * frameSize_, 0.0),
+      previousPid_(slotCount, 0),
+      previousCpuNs_(slotCount, 0),
+      cpuNs_(slotCount, 0) {
+    options_.history = frames_ - 1;
+}
+
+ProfileSampler::~ProfileSampler() {
+    Stop();
+}
+
+void ProfileSampler::SetTargets(const std::vector<int>& pids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    targets_.assign(pids.begin(), pids.begin() + std::min(pids.size(), slotCount_));
+}
+
+void ProfileSampler::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    worker_ = std::thread(&ProfileSampler::Run, this);
+}
+
+void ProfileSampler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        wake_.notify_one();
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+size_t ProfileSampler::Available() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(std::min<uint64_t>(sequence_, options_.history));
+}
+
+size_t ProfileSampler::Read(double* out, size_t frames, uint64_t& sequence) const {
+    // The sampler only writes the frame after the newest one, and cannot
+    // publish it while the lock is held
+    std::lock_guard<std::mutex> lock(mutex_);
+    sequence = sequence_;
+    size_t count = std::min(frames, static_cast<size_t>(std::min<uint64_t>(sequence_, options_.history)));
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out + i * frameSize_, Frame(sequence_ - 1 - i), frameSize_ * sizeof(double));
+    }
+    return count;
+}
+
+double ProfileSampler::LastSampleMs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastSampleMs_;
+}
+
+void ProfileSampler::Run() {
+    const auto interval = std::chrono::milliseconds(std::max(options_.intervalMs, 10));
+    std::vector<int> pids;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            pids = targets_;
+        }
+
+        auto started = Clock::now();
+        // sequence_ only changes on this thread
+        Sample(Frame(sequence_), pids, started);
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        sequence_++;
+        lastSampleMs_ = elapsedMs;
+        wake_.wait_until(lock, started + interval, [this] { return !running_; });
+    }
+}
+
+void ProfileSampler::Sample(double* frame, const std::vector<int>& pids, Clock::time_point now) {
+    std::unordered_map<int, int> slots;
+    std::vector<int> roots;
+    for (size_t slot = 0; slot < pids.size(); slot++) {
+        if (pids[slot] > 0 && slots.emplace(pids[slot], static_cast<int>(slot)).second) {
+            roots.push_back(pids[slot]);
+        }
+    }
+
+    // Every process of every profile, read in one pass
+    processes_.clear();
+    processSlots_.clear();
+    for (const auto& [pid, root] : ProcessTree::Shared().OwnerMap(roots)) {
+        processes_.push_back(pid);
+        processSlots_.push_back(slots[root]);
+    }
+    ReadProcessUsage(processes_, usage_, options_.pss);
+
+    std::fill(frame, frame + frameSize_, 0.0);
+    double timestampMs = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    std::fill(cpuNs_.begin(), cpuNs_.end(), 0);
+    for (size_t i = 0; i < processes_.size(); i++) {
+        const ProcessUsage& usage = usage_[i];
+        if (!usage.ok) {
+            continue;
+        }
+        size_t slot = static_cast<size_t>(processSlots_[i]);
+        double* row = frame + slot * kProfileSampleStride;
+        cpuNs_[slot] += usage.cpuNs;
+        row[kSampleRssBytes] += static_cast<double>(usage.rssBytes);
+        row[kSamplePssBytes] += static_cast<double>(usage.pssBytes);
+        row[kSampleThreads] += usage.threads;
+        row[kSampleProcesses] += 1;
+    }
+
+    double wallNs = std::chrono::duration<double, std::nano>(now - previousSample_).count();
+    bool hasPrevious = previousSample_.time_since_epoch().count() != 0 && wallNs > 0;
+    for (size_t slot = 0; slot < slotCount_; slot++) {
+        int pid = slot < pids.size() ? pids[slot] : 0;
+        double* row = frame + slot * kProfileSampleStride;
+        row[kSamplePid] = pid;
+        if (pid <= 0) {
+            previousPid_[slot] = 0;
+            continue;
+        }
+        uint64_t total = cpuNs_[slot];
+        row[kSampleTimestampMs] = timestampMs;
+        row[kSampleCpuTimeMs] = static_cast<double>(total) / 1e6;
+        // A child that exited takes its CPU time with it: no figure this time
+        if (hasPrevious && previousPid_[slot] == pid && total >= previousCpuNs_[slot]) {
+            row[kSampleCpuPercent] = static_cast<double>(total - previousCpuNs_[slot]) / wallNs * 100.0;
+        }
+        previousPid_[slot] = pid;
+        previousCpuNs_[slot] = total;
+    }
+    previousSample_ = now;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "process-stats.h"
+
+// CPU and memory use of every profile, over its whole process tree (browser,
+// renderers, GPU and utility processes; see ProcessTree).
+//
+// A background thread samples all profiles every interval into a ring of
+// frames allocated up front. Slot i of every frame holds pids[i] as a row of
+// kProfileSampleStride doubles (see ProfileSampleField), so a frame copies
+// straight into a Float64Array and rows join with window data by pid.
+//
+// The ring keeps one frame more than the history it exposes: the sampler
+// always writes the spare frame and publishes it by bumping the sequence, so
+// readers never wait for a sample in progress.
+enum ProfileSampleField : size_t {
+    kSamplePid,
+    kSampleTimestampMs,     // wall clock (ms since the epoch) of the sample
+    kSampleCpuPercent,      // since the previous sample, 100 = one core
+    kSampleCpuTimeMs,       // total so far, of the processes alive now
+    kSampleRssBytes,
+    kSamplePssBytes,        // 0 unless sampled with pss (see ReadProcessUsage)
+    kSampleThreads,
+    kSampleProcesses,       // 0 once the profile has exited
+    kProfileSampleStride,
+};
+
+struct ProfileSamplerOptions {
+    int intervalMs = 1000;
+    // Frames kept for readers
+    size_t history = 60;
+    bool pss = true;
+};
+
+class ProfileSampler {
+public:
+    ProfileSampler(const ProfileSamplerOptions& options, size_t slotCount);
+    ~ProfileSampler();
+
+    ProfileSampler(const ProfileSampler&) = delete;
+    ProfileSampler& operator=(const ProfileSampler&) = delete;
+
+    size_t SlotCount() const { return slotCount_; }
+    size_t History() const { return options_.history; }
+
+    // Slot i samples pids[i]; extra pids beyond the slot count are ignored.
+    // Takes effect from the next sample.
+    void SetTargets(const std::vector<int>& pids);
+
+    // The first sample is taken straight away
+    void Start();
+    void Stop();
+
+    // Frames a Read() can return right now
+    size_t Available() const;
+    // Copy the newest frames (newest first) into out, which has room for
+    // frames * SlotCount() * kProfileSampleStride doubles. Returns the number
+    // copied; sequence is the number of samples taken so far.
+    size_t Read(double* out, size_t frames, uint64_t& sequence) const;
+    // Time the last sample took
+    double LastSampleMs() const;
+
+private:
+    void Run();
+    // Fill frame from the current targets
+    void Sample(double* frame, const std::vector<int>& pids, std::chrono::steady_clock::time_point now);
+    double* Frame(uint64_t index) { return ring_.data() + (index % frames_) * frameSize_; }
+    const double* Frame(uint64_t index) const { return ring_.data() + (index % frames_) * frameSize_; }
+
+    ProfileSamplerOptions options_;
+    size_t slotCount_;
+    size_t frames_;
+    size_t frameSize_;
+    std::vector<double> ring_;
+
+    // Sampler thread only: CPU time of the previous sample, per slot
+    std::vector<int> previousPid_;
+    std::vector<uint64_t> previousCpuNs_;
+    std::vector<uint64_t> cpuNs_;
+    std::chrono::steady_clock::time_point previousSample_;
+    std::vector<int> processes_;
+    std::vector<int> processSlots_;
+    std::vector<ProcessUsage> usage_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<int> targets_;
+    uint64_t sequence_ = 0;
+    double lastSampleMs_ = 0;
+    bool running_ = false;
+    std::thread worker_;
+};
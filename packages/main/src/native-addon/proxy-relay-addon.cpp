@@ -0,0 +1,149 @@
+#include <napi.h>
+#include <memory>
+#include <string>
+
+#include "socks-relay.h"
+
+// proxy-relay.node: the per-profile SOCKS5 relay, built as its own module so
+// the proxy code can load it without the window addon.
+class ProxyRelay : public Napi::ObjectWrap<ProxyRelay> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports) {
+        Napi::Function func = DefineClass(env, "ProxyRelay", {
+            InstanceMethod("addRoute", &ProxyRelay::AddRoute),
+            InstanceMethod("removeRoute", &ProxyRelay::RemoveRoute),
+            InstanceMethod("getStats", &ProxyRelay::GetStats),
+            InstanceMethod("close", &ProxyRelay::Close)
+        });
+
+        exports.Set("ProxyRelay", func);
+        exports.Set("supported", Napi::Boolean::New(env, SocksRelay::Supported()));
+        return exports;
+    }
+
+    ProxyRelay(const Napi::CallbackInfo& info) : Napi::ObjectWrap<ProxyRelay>(info) {
+        if (!relay_.Start()) {
+            Napi::Error::New(info.Env(), "The native proxy relay is not available on this platform")
+                .ThrowAsJavaScriptException();
+        }
+    }
+
+private:
+    static std::string GetStringOption(const Napi::Object& options, const char* name, const std::string& defaultValue) {
+        Napi::Value value = options.Get(name);
+        return value.IsString() ? value.As<Napi::String>().Utf8Value() : defaultValue;
+    }
+
+    static int GetIntOption(const Napi::Object& options, const char* name, int defaultValue) {
+        Napi::Value value = options.Get(name);
+        return value.IsNumber() ? value.As<Napi::Number>().Int32Value() : defaultValue;
+    }
+
+    static Napi::Object StatsToJs(Napi::Env env, int id, const RelayRouteStats& stats) {
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("id", Napi::Number::New(env, id));
+        result.Set("connections", Napi::Number::New(env, static_cast<double>(stats.connections)));
+        result.Set("active", Napi::Number::New(env, static_cast<double>(stats.active)));
+        result.Set("failures", Napi::Number::New(env, static_cast<double>(stats.failures)));
+        result.Set("bytesUp", Napi::Number::New(env, static_cast<double>(stats.bytesUp)));
+        result.Set("bytesDown", Napi::Number::New(env, static_cast<double>(stats.bytesDown)));
+        result.Set("connectSamples", Napi::Number::New(env, static_cast<double>(stats.connectSamples)));
+        result.Set("connectMsAvg", Napi::Number::New(
+            env, stats.connectSamples ? stats.connectMsTotal / static_cast<double>(stats.connectSamples) : 0));
+        result.Set("connectMsMax", Napi::Number::New(env, stats.connectMsMax));
+        return result;
+    }
+
+    // addRoute({listenHost, listenPort, upstream: {type: 'socks5' | 'http', host, port, username, password}})
+    // returns {id, port}; listenPort 0 (the default) picks a free port.
+    Napi::Value AddRoute(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsObject() || !info[0].As<Napi::Object>().Get("upstream").IsObject()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: {listenHost, listenPort, upstream}")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Object options = info[0].As<Napi::Object>();
+        Napi::Object upstreamOptions = options.Get("upstream").As<Napi::Object>();
+
+        RelayUpstream upstream;
+        std::string type = GetStringOption(upstreamOptions, "type", "socks5");
+        if (type == "socks5") {
+            upstream.type = RelayUpstreamType::Socks5;
+        } else if (type == "http") {
+            upstream.type = RelayUpstreamType::Http;
+        } else {
+            Napi::TypeError::New(env, "Upstream type must be 'socks5' or 'http'").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        upstream.host = GetStringOption(upstreamOptions, "host", "");
+        upstream.port = GetIntOption(upstreamOptions, "port", 0);
+        upstream.username = GetStringOption(upstreamOptions, "username", "");
+        upstream.password = GetStringOption(upstreamOptions, "password", "");
+        if (upstream.host.empty() || upstream.port <= 0 || upstream.port > 65535) {
+            Napi::RangeError::New(env, "Upstream host and port are required").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::string listenHost = GetStringOption(options, "listenHost", "127.0.0.1");
+        int listenPort = GetIntOption(options, "listenPort", 0);
+        int boundPort = 0;
+        std::string error;
+        int id = relay_.AddRoute(listenHost, listenPort, upstream, boundPort, error);
+        if (id == 0) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("id", Napi::Number::New(env, id));
+        result.Set("port", Napi::Number::New(env, boundPort));
+        return result;
+    }
+
+    Napi::Value RemoveRoute(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: id").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        return Napi::Boolean::New(env, relay_.RemoveRoute(info[0].As<Napi::Number>().Int32Value()));
+    }
+
+    // getStats(id) for one route (null if unknown), getStats() for all of them
+    Napi::Value GetStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() >= 1 && info[0].IsNumber()) {
+            int id = info[0].As<Napi::Number>().Int32Value();
+            RelayRouteStats stats;
+            if (!relay_.RouteStats(id, stats)) {
+                return env.Null();
+            }
+            return StatsToJs(env, id, stats);
+        }
+
+        auto all = relay_.AllStats();
+        Napi::Array result = Napi::Array::New(env, all.size());
+        for (size_t i = 0; i < all.size(); i++) {
+            result.Set(static_cast<uint32_t>(i), StatsToJs(env, all[i].first, all[i].second));
+        }
+        return result;
+    }
+
+    Napi::Value Close(const Napi::CallbackInfo& info) {
+        relay_.Stop();
+        return info.Env().Undefined();
+    }
+
+    SocksRelay relay_;
+};
+
+Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    return ProxyRelay::Init(env, exports);
+}
+
+NODE_API_MODULE(proxy_relay, Init)
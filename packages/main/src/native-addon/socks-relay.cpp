@@ -0,0 +1,1001 @@
+#include "socks-relay.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+#include "addon-common.h"
+
+namespace {
+
+// Bytes moved per splice() call; a default pipe holds 64KB
+constexpr size_t kSpliceChunk = 64 * 1024;
+// Handshakes that take longer than this are dropped
+constexpr int64_t kHandshakeTimeoutMs = 30000;
+// The longest HTTP CONNECT response header accepted from an upstream
+constexpr size_t kMaxHttpResponse = 8192;
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+std::string Base64(const std::string& input) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const auto* data = reinterpret_cast<const uint8_t*>(input.data());
+    size_t length = input.size();
+    std::string out;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < length) chunk |= static_cast<uint32_t>(data[i + 1]) << 8;
+        if (i + 2 < length) chunk |= data[i + 2];
+        out.push_back(alphabet[(chunk >> 18) & 63]);
+        out.push_back(alphabet[(chunk >> 12) & 63]);
+        out.push_back(i + 1 < length ? alphabet[(chunk >> 6) & 63] : '=');
+        out.push_back(i + 2 < length ? alphabet[chunk & 63] : '=');
+    }
+    return out;
+}
+
+// SOCKS5 reply codes
+enum : uint8_t {
+    kReplySucceeded = 0x00,
+    kReplyGeneralFailure = 0x01,
+    kReplyNotAllowed = 0x02,
+    kReplyHostUnreachable = 0x04,
+    kReplyConnectionRefused = 0x05,
+    kReplyTtlExpired = 0x06,
+    kReplyCommandNotSupported = 0x07,
+    kReplyAddressNotSupported = 0x08,
+};
+
+enum class HandleKind {
+    Wake,
+    Listener,
+    Client,
+    Upstream,
+};
+
+struct Handle {
+    HandleKind kind;
+    void* owner;
+};
+
+enum class SessionState {
+    Greeting,           // client method selection
+    Request,            // client CONNECT request
+    Connecting,         // TCP connect to the upstream
+    UpstreamGreeting,   // SOCKS5 upstream method selection
+    UpstreamAuth,       // SOCKS5 username/password
+    UpstreamReply,      // SOCKS5 upstream CONNECT reply
+    HttpResponse,       // HTTP upstream CONNECT response
+    Relaying,
+    Closed,
+};
+
+// One direction of a tunnel: src -> pipe -> dst
+struct Direction {
+    int pipe[2] = {-1, -1};
+    size_t inPipe = 0;
+    bool eof = false;
+    bool shut = false;
+};
+
+}  // namespace
+
+struct SocksRelay::Route {
+    int id = 0;
+    int listenFd = -1;
+    RelayUpstream upstream;
+    sockaddr_storage upstreamAddress{};
+    socklen_t upstreamAddressLength = 0;
+    Handle handle{HandleKind::Listener, nullptr};
+
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> active{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> bytesUp{0};
+    std::atomic<uint64_t> bytesDown{0};
+    std::atomic<uint64_t> connectSamples{0};
+    std::atomic<uint64_t> connectUsTotal{0};
+    std::atomic<uint64_t> connectUsMax{0};
+
+    ~Route() {
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+    }
+};
+
+namespace {
+
+struct Session {
+    std::shared_ptr<SocksRelay::Route> route;
+    int client = -1;
+    int upstream = -1;
+    Handle clientHandle{HandleKind::Client, nullptr};
+    Handle upstreamHandle{HandleKind::Upstream, nullptr};
+    SessionState state = SessionState::Greeting;
+    int64_t acceptedUs = 0;
+    int64_t requestUs = 0;
+
+    // Destination as the client sent it: ATYP, address, port
+    std::vector<uint8_t> destination;
+    std::string destinationHost;
+    int destinationPort = 0;
+
+    Direction up;    // client -> upstream
+    Direction down;  // upstream -> client
+};
+
+void CloseFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Handshake messages are a few hundred bytes at most and go out on fresh
+// sockets, so a short write means the peer is gone
+bool SendAll(int fd, const void* data, size_t length) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Looks at pending input without consuming it. Returns the bytes available
+// (up to capacity), 0 when none yet, -1 on EOF or error.
+ssize_t Peek(int fd, uint8_t* buffer, size_t capacity) {
+    while (true) {
+        ssize_t received = recv(fd, buffer, capacity, MSG_PEEK);
+        if (received > 0) {
+            return received;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        return -1;
+    }
+}
+
+bool Consume(int fd, size_t length) {
+    uint8_t scratch[512];
+    while (length > 0) {
+        ssize_t received = recv(fd, scratch, std::min(length, sizeof(scratch)), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Length of a SOCKS5 address (ATYP byte included, port excluded), 0 if more
+// bytes are needed to tell, -1 if the type is unknown
+int AddressLength(const uint8_t* data, size_t available) {
+    if (available < 1) {
+        return 0;
+    }
+    switch (data[0]) {
+        case 0x01:
+            return 1 + 4;
+        case 0x04:
+            return 1 + 16;
+        case 0x03:
+            return available < 2 ? 0 : 1 + 1 + data[1];
+        default:
+            return -1;
+    }
+}
+
+}  // namespace
+
+class SocksRelay::Loop {
+public:
+    ~Loop() {
+        for (auto& entry : sessions_) {
+            Release(*entry.second);
+        }
+        CloseFd(wakeFd_);
+        CloseFd(epollFd_);
+    }
+
+    bool Init() {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd_ < 0 || wakeFd_ < 0) {
+            LOG_ERROR("Failed to create the relay event loop: " << strerror(errno));
+            return false;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = &wakeHandle_;
+        return epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event) == 0;
+    }
+
+    void Run() {
+        std::vector<epoll_event> events(256);
+        while (running_.load()) {
+            int timeout = pendingHandshakes_ > 0 ? 1000 : -1;
+            int count = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), timeout);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR("epoll_wait failed: " << strerror(errno));
+                break;
+            }
+
+            for (int i = 0; i < count; i++) {
+                auto* handle = static_cast<Handle*>(events[i].data.ptr);
+                switch (handle->kind) {
+                    case HandleKind::Wake:
+                        DrainCommands();
+                        break;
+                    case HandleKind::Listener:
+                        Accept(static_cast<Route*>(handle->owner));
+                        break;
+                    case HandleKind::Client:
+                    case HandleKind::Upstream: {
+                        auto* session = static_cast<Session*>(handle->owner);
+                        if (session->state != SessionState::Closed) {
+                            OnSessionEvent(*session, handle->kind, events[i].events);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            if (pendingHandshakes_ > 0) {
+                ExpireHandshakes();
+            }
+            // Sessions and routes are freed after the batch since later events may point at them
+            for (Session* session : closed_) {
+                sessions_.erase(session);
+            }
+            closed_.clear();
+            retired_.clear();
+        }
+    }
+
+    void Stop() {
+        running_.store(false);
+        Wake();
+    }
+
+    void AddRoute(std::shared_ptr<Route> route) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            added_.push_back(std::move(route));
+        }
+        Wake();
+    }
+
+    void RemoveRoute(int id) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            removed_.push_back(id);
+        }
+        Wake();
+    }
+
+private:
+    void Wake() {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd_, &one, sizeof(one));
+        (void)written;
+    }
+
+    void DrainCommands() {
+        uint64_t value;
+        while (read(wakeFd_, &value, sizeof(value)) > 0) {
+        }
+
+        std::vector<std::shared_ptr<Route>> added;
+        std::vector<int> removed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            added.swap(added_);
+            removed.swap(removed_);
+        }
+
+        for (auto& route : added) {
+            route->handle.owner = route.get();
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLET;
+            event.data.ptr = &route->handle;
+            if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, route->listenFd, &event) == 0) {
+                routes_[route->id] = route;
+                // Connections may have queued before the listener was registered
+                Accept(route.get());
+            }
+        }
+
+        for (int id : removed) {
+            auto it = routes_.find(id);
+            if (it == routes_.end()) {
+                continue;
+            }
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, it->second->listenFd, nullptr);
+            for (auto& entry : sessions_) {
+                if (entry.second->route == it->second && entry.second->state != SessionState::Closed) {
+                    CloseSession(*entry.second, false);
+                }
+            }
+            retired_.push_back(std::move(it->second));
+            routes_.erase(it);
+        }
+    }
+
+    void Accept(Route* route) {
+        // A listener event may follow the removal of its route in the same batch
+        auto it = routes_.find(route->id);
+        if (it == routes_.end() || it->second.get() != route) {
+            return;
+        }
+        std::shared_ptr<Route> owner = it->second;
+        while (true) {
+            int fd = accept4(route->listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    LOG_ERROR("accept failed: " << strerror(errno));
+                }
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            auto session = std::make_unique<Session>();
+            session->route = owner;
+            session->client = fd;
+            session->clientHandle.owner = session.get();
+            session->upstreamHandle.owner = session.get();
+            session->acceptedUs = NowUs();
+            route->connections++;
+            route->active++;
+            pendingHandshakes_++;
+
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = &session->clientHandle;
+            epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+
+            Session* raw = session.get();
+            sessions_.emplace(raw, std::move(session));
+            // The greeting may already be waiting
+            AdvanceClient(*raw);
+        }
+    }
+
+    void OnSessionEvent(Session& session, HandleKind kind, uint32_t flags) {
+        if (session.state == SessionState::Relaying) {
+            if (!Pump(session.client, session.upstream, session.up, session.route->bytesUp) ||
+                !Pump(session.upstream, session.client, session.down, session.route->bytesDown)) {
+                CloseSession(session, false);
+            } else if (session.up.shut && session.down.shut) {
+                CloseSession(session, false);
+            }
+            return;
+        }
+
+        if (kind == HandleKind::Client) {
+            if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                AdvanceClient(session);
+            }
+            return;
+        }
+
+        if (session.state == SessionState::Connecting) {
+            if (flags & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                FinishConnect(session);
+            }
+            return;
+        }
+        if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+            AdvanceUpstream(session);
+        }
+    }
+
+    // Client side handshake: greeting, then the CONNECT request
+    void AdvanceClient(Session& session) {
+        uint8_t buffer[4 + 256 + 2];
+        while (session.state == SessionState::Greeting || session.state == SessionState::Request) {
+            ssize_t available = Peek(session.client, buffer, sizeof(buffer));
+            if (available < 0) {
+                CloseSession(session, true);
+                return;
+            }
+            if (available == 0) {
+                return;
+            }
+            if (buffer[0] != 0x05) {
+                CloseSession(session, true);
+                return;
+            }
+
+            if (session.state == SessionState::Greeting) {
+                if (available < 2 || available < 2 + buffer[1]) {
+                    return;
+                }
+                size_t length = 2 + buffer[1];
+                bool noAuth = std::find(buffer + 2, buffer + length, 0x00) != buffer + length;
+                uint8_t reply[2] = {0x05, static_cast<uint8_t>(noAuth ? 0x00 : 0xFF)};
+                if (!Consume(session.client, length) || !SendAll(session.client, reply, sizeof(reply)) || !noAuth) {
+                    CloseSession(session, true);
+                    return;
+                }
+                session.state = SessionState::Request;
+                continue;
+            }
+
+            if (available < 5) {
+                return;
+            }
+            int addressLength = AddressLength(buffer + 3, static_cast<size_t>(available) - 3);
+            if (addressLength < 0) {
+                Consume(session.client, static_cast<size_t>(available));
+                ReplyAndClose(session, kReplyAddressNotSupported);
+                return;
+            }
+            size_t length = 3 + static_cast<size_t>(addressLength) + 2;
+            if (addressLength == 0 || static_cast<size_t>(available) < length) {
+                return;
+            }
+            if (!Consume(session.client, length)) {
+                CloseSession(session, true);
+                return;
+            }
+            if (buffer[1] != 0x01) {
+                ReplyAndClose(session, kReplyCommandNotSupported);
+                return;
+            }
+
+            session.destination.assign(buffer + 3, buffer + length);
+            const uint8_t* address = buffer + 4;
+            char text[INET6_ADDRSTRLEN] = {};
+            if (buffer[3] == 0x01) {
+                inet_ntop(AF_INET, address, text, sizeof(text));
+                session.destinationHost = text;
+            } else if (buffer[3] == 0x04) {
+                inet_ntop(AF_INET6, address, text, sizeof(text));
+                session.destinationHost = std::string("[") + text + "]";
+            } else {
+                session.destinationHost.assign(reinterpret_cast<const char*>(address + 1), address[0]);
+            }
+            session.destinationPort = (buffer[length - 2] << 8) | buffer[length - 1];
+            session.requestUs = NowUs();
+            ConnectUpstream(session);
+            return;
+        }
+    }
+
+    void ConnectUpstream(Session& session) {
+        const Route& route = *session.route;
+        int fd = socket(route.upstreamAddress.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            ReplyAndClose(session, kReplyGeneralFailure);
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&route.upstreamAddress), route.upstreamAddressLength) < 0 &&
+            errno != EINPROGRESS) {
+            close(fd);
+            ReplyAndClose(session, kReplyConnectionRefused);
+            return;
+        }
+
+        session.upstream = fd;
+        session.state = SessionState::Connecting;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = &session.upstreamHandle;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void FinishConnect(Session& session) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(session.upstream, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            ReplyAndClose(session, kReplyConnectionRefused);
+            return;
+        }
+
+        const RelayUpstream& upstream = session.route->upstream;
+        bool sent;
+        if (upstream.type == RelayUpstreamType::Socks5) {
+            std::vector<uint8_t> greeting = {0x05, 0x01, 0x00};
+            if (!upstream.username.empty()) {
+                greeting = {0x05, 0x02, 0x00, 0x02};
+            }
+            sent = SendAll(session.upstream, greeting.data(), greeting.size());
+            session.state = SessionState::UpstreamGreeting;
+        } else {
+            std::string target = session.destinationHost + ":" + std::to_string(session.destinationPort);
+            std::string request = "CONNECT " + target + " HTTP/1.1\r\nHost: " + target + "\r\n";
+            if (!upstream.username.empty()) {
+                request += "Proxy-Authorization: Basic " + Base64(upstream.username + ":" + upstream.password) + "\r\n";
+            }
+            request += "\r\n";
+            sent = SendAll(session.upstream, request.data(), request.size());
+            session.state = SessionState::HttpResponse;
+        }
+        if (!sent) {
+            ReplyAndClose(session, kReplyGeneralFailure);
+            return;
+        }
+        // A fast upstream may have answered already
+        AdvanceUpstream(session);
+    }
+
+    // Upstream side handshake, SOCKS5 or HTTP CONNECT
+    void AdvanceUpstream(Session& session) {
+        const RelayUpstream& upstream = session.route->upstream;
+        uint8_t buffer[kMaxHttpResponse];
+        while (true) {
+            ssize_t available = Peek(session.upstream, buffer, sizeof(buffer));
+            if (available < 0) {
+                ReplyAndClose(session, kReplyGeneralFailure);
+                return;
+            }
+            if (available == 0) {
+                return;
+            }
+
+            switch (session.state) {
+                case SessionState::UpstreamGreeting: {
+                    if (available < 2) {
+                        return;
+                    }
+                    Consume(session.upstream, 2);
+                    if (buffer[0] == 0x05 && buffer[1] == 0x02 && !upstream.username.empty()) {
+                        std::vector<uint8_t> auth = {0x01, static_cast<uint8_t>(upstream.username.size())};
+                        auth.insert(auth.end(), upstream.username.begin(), upstream.username.end());
+                        auth.push_back(static_cast<uint8_t>(upstream.password.size()));
+                        auth.insert(auth.end(), upstream.password.begin(), upstream.password.end());
+                        if (!SendAll(session.upstream, auth.data(), auth.size())) {
+                            ReplyAndClose(session, kReplyGeneralFailure);
+                            return;
+                        }
+                        session.state = SessionState::UpstreamAuth;
+                    } else if (buffer[0] == 0x05 && buffer[1] == 0x00) {
+                        if (!SendUpstreamRequest(session)) {
+                            return;
+                        }
+                    } else {
+                        ReplyAndClose(session, kReplyNotAllowed);
+                        return;
+                    }
+                    break;
+                }
+                case SessionState::UpstreamAuth: {
+                    if (available < 2) {
+                        return;
+                    }
+                    Consume(session.upstream, 2);
+                    if (buffer[1] != 0x00) {
+                        ReplyAndClose(session, kReplyNotAllowed);
+                        return;
+                    }
+                    if (!SendUpstreamRequest(session)) {
+                        return;
+                    }
+                    break;
+                }
+                case SessionState::UpstreamReply: {
+                    if (available < 5) {
+                        return;
+                    }
+                    int addressLength = AddressLength(buffer + 3, static_cast<size_t>(available) - 3);
+                    if (addressLength < 0 || buffer[0] != 0x05) {
+                        ReplyAndClose(session, kReplyGeneralFailure);
+                        return;
+                    }
+                    size_t length = 3 + static_cast<size_t>(addressLength) + 2;
+                    if (addressLength == 0 || static_cast<size_t>(available) < length) {
+                        return;
+                    }
+                    Consume(session.upstream, length);
+                    if (buffer[1] != kReplySucceeded) {
+                        uint8_t code = buffer[1] <= kReplyAddressNotSupported ? buffer[1]
+                                                                              : static_cast<uint8_t>(kReplyGeneralFailure);
+                        ReplyAndClose(session, code);
+                        return;
+                    }
+                    Establish(session);
+                    return;
+                }
+                case SessionState::HttpResponse: {
+                    const char* begin = reinterpret_cast<const char*>(buffer);
+                    const char* end = std::search(begin, begin + available, "\r\n\r\n", "\r\n\r\n" + 4);
+                    if (end == begin + available) {
+                        if (static_cast<size_t>(available) >= sizeof(buffer)) {
+                            ReplyAndClose(session, kReplyGeneralFailure);
+                        }
+                        return;
+                    }
+                    size_t length = static_cast<size_t>(end - begin) + 4;
+                    Consume(session.upstream, length);
+                    std::string status(begin, std::min<size_t>(length, 12));
+                    if (status.compare(0, 5, "HTTP/") != 0 || status.size() < 12 || status.compare(9, 3, "200") != 0) {
+                        bool denied = status.size() >= 12 && status.compare(9, 3, "407") == 0;
+                        ReplyAndClose(session, denied ? kReplyNotAllowed : kReplyConnectionRefused);
+                        return;
+                    }
+                    Establish(session);
+                    return;
+                }
+                default:
+                    return;
+            }
+        }
+    }
+
+    bool SendUpstreamRequest(Session& session) {
+        std::vector<uint8_t> request = {0x05, 0x01, 0x00};
+        request.insert(request.end(), session.destination.begin(), session.destination.end());
+        if (!SendAll(session.upstream, request.data(), request.size())) {
+            ReplyAndClose(session, kReplyGeneralFailure);
+            return false;
+        }
+        session.state = SessionState::UpstreamReply;
+        return true;
+    }
+
+    void Establish(Session& session) {
+        uint8_t reply[10] = {0x05, kReplySucceeded, 0x00, 0x01, 0, 0, 0, 0, 0, 0};
+        if (!SendAll(session.client, reply, sizeof(reply)) || pipe2(session.up.pipe, O_NONBLOCK | O_CLOEXEC) < 0 ||
+            pipe2(session.down.pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+            CloseSession(session, true);
+            return;
+        }
+
+        Route& route = *session.route;
+        uint64_t elapsed = static_cast<uint64_t>(std::max<int64_t>(NowUs() - session.requestUs, 0));
+        route.connectSamples++;
+        route.connectUsTotal += elapsed;
+        if (elapsed > route.connectUsMax.load()) {
+            route.connectUsMax.store(elapsed);
+        }
+
+        session.state = SessionState::Relaying;
+        pendingHandshakes_--;
+        // Data that arrived during the handshakes produced no new edge
+        OnSessionEvent(session, HandleKind::Client, 0);
+    }
+
+    // Moves everything currently possible from src to dst. Returns false on
+    // a socket error; a finished direction ends with dst shut for writing.
+    bool Pump(int src, int dst, Direction& direction, std::atomic<uint64_t>& counter) {
+        while (true) {
+            if (direction.inPipe > 0) {
+                ssize_t moved = splice(direction.pipe[0], nullptr, dst, nullptr, direction.inPipe,
+                                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (moved > 0) {
+                    direction.inPipe -= static_cast<size_t>(moved);
+                    counter += static_cast<uint64_t>(moved);
+                    continue;
+                }
+                if (moved < 0 && errno == EINTR) {
+                    continue;
+                }
+                // Wait for dst to become writable
+                return moved < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            }
+
+            if (direction.eof) {
+                if (!direction.shut) {
+                    shutdown(dst, SHUT_WR);
+                    direction.shut = true;
+                }
+                return true;
+            }
+
+            ssize_t moved = splice(src, nullptr, direction.pipe[1], nullptr, kSpliceChunk,
+                                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (moved > 0) {
+                direction.inPipe += static_cast<size_t>(moved);
+                continue;
+            }
+            if (moved == 0) {
+                direction.eof = true;
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    void ReplyAndClose(Session& session, uint8_t code) {
+        uint8_t reply[10] = {0x05, code, 0x00, 0x01, 0, 0, 0, 0, 0, 0};
+        SendAll(session.client, reply, sizeof(reply));
+        CloseSession(session, true);
+    }
+
+    void CloseSession(Session& session, bool failed) {
+        if (session.state == SessionState::Closed) {
+            return;
+        }
+        if (session.state != SessionState::Relaying) {
+            pendingHandshakes_--;
+        }
+        if (failed) {
+            session.route->failures++;
+        }
+        session.route->active--;
+        Release(session);
+        session.state = SessionState::Closed;
+        closed_.push_back(&session);
+    }
+
+    void Release(Session& session) {
+        // Closing the fds removes them from the epoll set
+        CloseFd(session.client);
+        CloseFd(session.upstream);
+        for (Direction* direction : {&session.up, &session.down}) {
+            CloseFd(direction->pipe[0]);
+            CloseFd(direction->pipe[1]);
+        }
+    }
+
+    void ExpireHandshakes() {
+        int64_t deadline = NowUs() - kHandshakeTimeoutMs * 1000;
+        for (auto& entry : sessions_) {
+            Session& session = *entry.second;
+            if (session.state != SessionState::Relaying && session.state != SessionState::Closed &&
+                session.acceptedUs < deadline) {
+                ReplyAndClose(session, kReplyTtlExpired);
+            }
+        }
+    }
+
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+    Handle wakeHandle_{HandleKind::Wake, nullptr};
+    std::atomic<bool> running_{true};
+
+    // Loop thread only
+    std::unordered_map<int, std::shared_ptr<Route>> routes_;
+    std::unordered_map<Session*, std::unique_ptr<Session>> sessions_;
+    std::vector<Session*> closed_;
+    std::vector<std::shared_ptr<Route>> retired_;
+    int pendingHandshakes_ = 0;
+
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Route>> added_;
+    std::vector<int> removed_;
+};
+
+#else
+
+struct SocksRelay::Route {
+    int id = 0;
+};
+
+class SocksRelay::Loop {};
+
+#endif
+
+SocksRelay::SocksRelay() = default;
+
+SocksRelay::~SocksRelay() {
+    Stop();
+}
+
+bool SocksRelay::Supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SocksRelay::Start() {
+#ifdef __linux__
+    if (loop_) {
+        return true;
+    }
+    auto loop = std::make_unique<Loop>();
+    if (!loop->Init()) {
+        return false;
+    }
+    loop_ = std::move(loop);
+    Loop* running = loop_.get();
+    thread_ = std::thread([running] { running->Run(); });
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SocksRelay::Stop() {
+#ifdef __linux__
+    if (loop_) {
+        loop_->Stop();
+    }
+#endif
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    loop_.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    routes_.clear();
+}
+
+int SocksRelay::AddRoute(const std::string& listenHost, int listenPort, const RelayUpstream& upstream,
+                         int& boundPort, std::string& error) {
+#ifdef __linux__
+    if (!loop_) {
+        error = "Relay is not running";
+        return 0;
+    }
+    if (upstream.username.size() > 255 || upstream.password.size() > 255) {
+        error = "Upstream credentials are too long";
+        return 0;
+    }
+
+    auto route = std::make_shared<Route>();
+    route->upstream = upstream;
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    std::string port = std::to_string(upstream.port);
+    int status = getaddrinfo(upstream.host.c_str(), port.c_str(), &hints, &addresses);
+    if (status != 0 || !addresses) {
+        error = "Cannot resolve upstream " + upstream.host + ": " + gai_strerror(status);
+        return 0;
+    }
+    memcpy(&route->upstreamAddress, addresses->ai_addr, addresses->ai_addrlen);
+    route->upstreamAddressLength = addresses->ai_addrlen;
+    freeaddrinfo(addresses);
+
+    hints = addrinfo{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    port = std::to_string(listenPort);
+    status = getaddrinfo(listenHost.c_str(), port.c_str(), &hints, &addresses);
+    if (status != 0 || !addresses) {
+        error = "Cannot resolve listen address " + listenHost + ": " + gai_strerror(status);
+        return 0;
+    }
+
+    int fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (fd < 0 || bind(fd, addresses->ai_addr, addresses->ai_addrlen) < 0 || listen(fd, SOMAXCONN) < 0) {
+        error = "Cannot listen on " + listenHost + ":" + port + ": " + strerror(errno);
+        if (fd >= 0) {
+            close(fd);
+        }
+        freeaddrinfo(addresses);
+        return 0;
+    }
+    freeaddrinfo(addresses);
+    route->listenFd = fd;
+
+    sockaddr_storage bound{};
+    socklen_t boundLength = sizeof(bound);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+    boundPort = ntohs(bound.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port
+                                                  : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        route->id = nextRouteId_++;
+        routes_.push_back(route);
+    }
+    loop_->AddRoute(route);
+    return route->id;
+#else
+    (void)listenHost;
+    (void)listenPort;
+    (void)upstream;
+    boundPort = 0;
+    error = "The native relay is not supported on this platform";
+    return 0;
+#endif
+}
+
+bool SocksRelay::RemoveRoute(int id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(routes_.begin(), routes_.end(), [id](const auto& route) { return route->id == id; });
+        if (it == routes_.end()) {
+            return false;
+        }
+        routes_.erase(it);
+    }
+#ifdef __linux__
+    if (loop_) {
+        loop_->RemoveRoute(id);
+    }
+#endif
+    return true;
+}
+
+namespace {
+
+#ifdef __linux__
+RelayRouteStats SnapshotRoute(const SocksRelay::Route& route) {
+    RelayRouteStats stats;
+    stats.connections = route.connections.load();
+    stats.active = route.active.load();
+    stats.failures = route.failures.load();
+    stats.bytesUp = route.bytesUp.load();
+    stats.bytesDown = route.bytesDown.load();
+    stats.connectSamples = route.connectSamples.load();
+    stats.connectMsTotal = static_cast<double>(route.connectUsTotal.load()) / 1000.0;
+    stats.connectMsMax = static_cast<double>(route.connectUsMax.load()) / 1000.0;
+    return stats;
+}
+#else
+RelayRouteStats SnapshotRoute(const SocksRelay::Route&) {
+    return RelayRouteStats();
+}
+#endif
+
+}  // namespace
+
+bool SocksRelay::RouteStats(int id, RelayRouteStats& stats) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& route : routes_) {
+        if (route->id == id) {
+            stats = SnapshotRoute(*route);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::pair<int, RelayRouteStats>> SocksRelay::AllStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<int, RelayRouteStats>> stats;
+    stats.reserve(routes_.size());
+    for (const auto& route : routes_) {
+        stats.emplace_back(route->id, SnapshotRoute(*route));
+    }
+    return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local SOCKS5 relay for per-profile proxies.
+//
+// Every route is a loopback listener that accepts SOCKS5 CONNECT (no auth,
+// so Chrome can use it directly) and chains each connection through the
+// route's upstream SOCKS5 or HTTP CONNECT proxy, with credentials. All
+// routes share one epoll thread. Once both handshakes are done the payload
+// is moved between the sockets with splice() through a pipe per direction,
+// so it is never copied into user space. Linux only; Start() fails elsewhere.
+enum class RelayUpstreamType {
+    Socks5,
+    Http,
+};
+
+struct RelayUpstream {
+    RelayUpstreamType type = RelayUpstreamType::Socks5;
+    std::string host;
+    int port = 0;
+    std::string username;
+    std::string password;
+};
+
+// Counters of one route; the relay thread updates them, any thread reads
+struct RelayRouteStats {
+    uint64_t connections = 0;      // accepted client connections
+    uint64_t active = 0;           // connections currently open
+    uint64_t failures = 0;         // connections closed before relaying
+    uint64_t bytesUp = 0;          // client -> upstream payload
+    uint64_t bytesDown = 0;        // upstream -> client payload
+    uint64_t connectSamples = 0;   // established tunnels
+    double connectMsTotal = 0;     // client request -> upstream ready
+    double connectMsMax = 0;
+};
+
+class SocksRelay {
+public:
+    SocksRelay();
+    ~SocksRelay();
+
+    SocksRelay(const SocksRelay&) = delete;
+    SocksRelay& operator=(const SocksRelay&) = delete;
+
+    static bool Supported();
+
+    bool Start();
+    void Stop();
+
+    // Binds listenHost:listenPort (port 0 picks a free one) and starts
+    // serving it. Returns the route id, or 0 with error set. The upstream
+    // host is resolved here, on the calling thread.
+    int AddRoute(const std::string& listenHost, int listenPort, const RelayUpstream& upstream, int& boundPort,
+                 std::string& error);
+
+    // Closes the listener and every connection of the route
+    bool RemoveRoute(int id);
+
+    bool RouteStats(int id, RelayRouteStats& stats) const;
+    std::vector<std::pair<int, RelayRouteStats>> AllStats() const;
+
+    // Event loop, defined in socks-relay.cpp
+    class Loop;
+    struct Route;
+
+private:
+    std::unique_ptr<Loop> loop_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Route>> routes_;
+    int nextRouteId_ = 1;
+};
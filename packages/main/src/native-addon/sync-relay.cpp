@@ -0,0 +1,1150 @@
+#include "sync-relay.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "control-protocol.h"
+
+#ifdef __linux__
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#include "addon-common.h"
+#include "window-control.h"
+
+#endif
+
+namespace {
+
+// Message types, the first payload byte
+enum : uint8_t {
+    kRelayBatch = 1,
+    kRelayAck = 2,
+};
+
+bool IsKey(RelayEventType type) {
+    return type == RelayEventType::KeyDown || type == RelayEventType::KeyUp;
+}
+
+// Button and key transitions change what is held on the slaves, so they are
+// never left out under backpressure
+bool IsTransition(RelayEventType type) {
+    return type != RelayEventType::Move && type != RelayEventType::Wheel;
+}
+
+}  // namespace
+
+void EncodeRelayBatch(std::vector<uint8_t>& out, const RelayEvent* events, size_t count, uint64_t sentUs) {
+    count = std::min(count, kMaxRelayBatch);
+    ProtocolWriter writer(out);
+    writer.BeginFrame();
+    writer.U8(kRelayBatch);
+    writer.U64(sentUs);
+    uint32_t sequence = count > 0 ? events[0].sequence : 0;
+    writer.U32(sequence);
+    writer.U16(static_cast<uint16_t>(count));
+    int64_t x = 0;
+    int64_t y = 0;
+    for (size_t i = 0; i < count; i++) {
+        const RelayEvent& event = events[i];
+        writer.Varint(event.sequence - sequence);
+        sequence = event.sequence;
+        writer.U8(static_cast<uint8_t>(event.type));
+        if (IsKey(event.type)) {
+            writer.Varint(static_cast<uint32_t>(event.keyCode));
+            continue;
+        }
+        writer.Signed(event.x - x);
+        writer.Signed(event.y - y);
+        x = event.x;
+        y = event.y;
+        if (event.type == RelayEventType::Wheel) {
+            writer.Signed(event.deltaX);
+            writer.Signed(event.deltaY);
+        }
+    }
+    writer.EndFrame();
+}
+
+bool DecodeRelayBatch(const uint8_t* payload, size_t length, std::vector<RelayEvent>& events, uint64_t& sentUs) {
+    events.clear();
+    ProtocolReader reader(payload, length);
+    if (reader.U8() != kRelayBatch) {
+        return false;
+    }
+    sentUs = reader.U64();
+    uint32_t sequence = reader.U32();
+    uint16_t count = reader.U16();
+    if (!reader.ok() || count > kMaxRelayBatch) {
+        return false;
+    }
+
+    // Positions and deltas outside int range are malformed
+    auto fits = [](int64_t value) { return value >= INT_MIN && value <= INT_MAX; };
+    int64_t x = 0;
+    int64_t y = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        RelayEvent event;
+        uint64_t gap = reader.Varint();
+        if (gap > UINT32_MAX) {
+            return false;
+        }
+        sequence += static_cast<uint32_t>(gap);
+        event.sequence = sequence;
+        uint8_t type = reader.U8();
+        if (type > static_cast<uint8_t>(RelayEventType::KeyUp)) {
+            return false;
+        }
+        event.type = static_cast<RelayEventType>(type);
+        if (IsKey(event.type)) {
+            uint64_t keyCode = reader.Varint();
+            if (keyCode > INT_MAX) {
+                return false;
+            }
+            event.keyCode = static_cast<int>(keyCode);
+        } else {
+            x += reader.Signed();
+            y += reader.Signed();
+            if (!fits(x) || !fits(y)) {
+                return false;
+            }
+            event.x = static_cast<int>(x);
+            event.y = static_cast<int>(y);
+            if (event.type == RelayEventType::Wheel) {
+                int64_t deltaX = reader.Signed();
+                int64_t deltaY = reader.Signed();
+                if (!fits(deltaX) || !fits(deltaY)) {
+                    return false;
+                }
+                event.deltaX = static_cast<int>(deltaX);
+                event.deltaY = static_cast<int>(deltaY);
+            }
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+        events.push_back(event);
+    }
+    return reader.ok() && reader.AtEnd();
+}
+
+#ifdef __linux__
+
+namespace {
+
+// Unsent bytes to an agent that count as congestion
+constexpr size_t kCongestedBytes = 16 * 1024;
+// Unsent bytes at which an agent that stopped reading is disconnected
+constexpr size_t kMaxUnsentBytes = 64 * kCongestedBytes;
+// Wait between connection attempts to an agent
+constexpr int64_t kReconnectUs = 1000 * 1000;
+// Acks an agent holds for a master that stopped reading before it gives up
+constexpr size_t kMaxAckBacklog = 64 * 1024;
+// Bytes read per recv() call
+constexpr size_t kReadChunk = 64 * 1024;
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void CloseFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Append what the socket has to buffer. False on EOF or error.
+bool ReadAvailable(int fd, std::vector<uint8_t>& buffer) {
+    while (true) {
+        size_t used = buffer.size();
+        buffer.resize(used + kReadChunk);
+        ssize_t received = recv(fd, buffer.data() + used, kReadChunk, 0);
+        buffer.resize(used + static_cast<size_t>(std::max<ssize_t>(received, 0)));
+        if (received > 0) {
+            if (static_cast<size_t>(received) < kReadChunk) {
+                return true;
+            }
+            continue;
+        }
+        if (received == 0) {
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+// Write as much of out[offset..] as the socket takes. False when the peer
+// is gone.
+bool WritePending(int fd, std::vector<uint8_t>& out, size_t& offset) {
+    while (offset < out.size()) {
+        ssize_t sent = send(fd, out.data() + offset, out.size() - offset, MSG_NOSIGNAL);
+        if (sent > 0) {
+            offset += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false;
+    }
+    if (offset == out.size()) {
+        out.clear();
+        offset = 0;
+    } else if (offset > out.size() / 2) {
+        out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(offset));
+        offset = 0;
+    }
+    return true;
+}
+
+void Wake(int fd) {
+    uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+}
+
+void DrainWake(int fd) {
+    uint64_t value = 0;
+    ssize_t got = read(fd, &value, sizeof(value));
+    (void)got;
+}
+
+}  // namespace
+
+class SyncRelayMaster::Loop {
+public:
+    struct Link {
+        RelayAgentAddress address;
+        sockaddr_storage sockaddr{};
+        socklen_t sockaddrLength = 0;
+        int fd = -1;
+        bool connecting = false;
+        bool connected = false;
+        int64_t retryUs = 0;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        size_t outOffset = 0;
+        uint32_t lastSent = 0;
+        uint32_t acked = 0;
+
+        // Guarded by Loop::statsMutex_
+        RelayAgentLinkStats stats;
+        double queueTotalUs = 0;
+        double networkTotalUs = 0;
+        double applyTotalUs = 0;
+        double rttTotalUs = 0;
+    };
+
+    Loop(const SyncRelayOptions& options, std::vector<Link> links) : options_(options), links_(std::move(links)) {
+        for (Link& link : links_) {
+            link.stats.host = link.address.host;
+            link.stats.port = link.address.port;
+        }
+    }
+
+    ~Loop() {
+        for (Link& link : links_) {
+            CloseFd(link.fd);
+        }
+        CloseFd(wakeFd_);
+    }
+
+    bool Init(std::string& error) {
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd_ < 0) {
+            error = std::string("Failed to create the relay event loop: ") + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    void Stop() {
+        running_.store(false, std::memory_order_release);
+        Wake(wakeFd_);
+    }
+
+    bool Post(RelayEvent event) {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (queue_.size() >= options_.queueCapacity) {
+                refused_++;
+                return false;
+            }
+            event.sequence = ++sequence_;
+            event.postedUs = NowUs();
+            // The relay thread takes the whole queue, so only the post that
+            // finds it empty has to wake it
+            wake = queue_.empty();
+            queue_.push_back(event);
+            posted_++;
+        }
+        if (wake) {
+            Wake(wakeFd_);
+        }
+        return true;
+    }
+
+    SyncRelayStats Stats() {
+        SyncRelayStats stats;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stats.posted = posted_;
+            stats.refused = refused_;
+        }
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats.batches = batches_;
+        for (const Link& link : links_) {
+            stats.agents.push_back(link.stats);
+        }
+        return stats;
+    }
+
+    void Run() {
+        std::vector<pollfd> fds;
+        while (running_.load(std::memory_order_acquire)) {
+            int64_t now = NowUs();
+            ConnectDue(now);
+
+            fds.clear();
+            fds.push_back({wakeFd_, POLLIN, 0});
+            for (const Link& link : links_) {
+                short events = 0;
+                if (link.connecting) {
+                    events = POLLOUT;
+                } else if (link.connected) {
+                    events = static_cast<short>(POLLIN | (link.outOffset < link.out.size() ? POLLOUT : 0));
+                }
+                // poll() skips negative fds
+                fds.push_back({link.fd, events, 0});
+            }
+
+            // Microsecond timeout: batch intervals are often below a millisecond
+            int64_t waitUs = WaitUs(now);
+            timespec timeout{waitUs / 1000000, static_cast<long>(waitUs % 1000000) * 1000};
+            int count = ppoll(fds.data(), fds.size(), waitUs >= 0 ? &timeout : nullptr, nullptr);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR("Sync relay poll failed: " << strerror(errno));
+                break;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                DrainWake(wakeFd_);
+                TakeQueue();
+            }
+            for (size_t i = 0; i < links_.size(); i++) {
+                if (fds[i + 1].revents != 0) {
+                    Service(links_[i], fds[i + 1].revents);
+                }
+            }
+            if (!batch_.empty() &&
+                (batch_.size() >= kMaxRelayBatch || NowUs() >= batchStartUs_ + options_.batchInterval.count())) {
+                SendBatch();
+            }
+        }
+    }
+
+private:
+    // Time until the batch is due or a reconnect is, -1 for none
+    int64_t WaitUs(int64_t now) const {
+        int64_t wait = -1;
+        auto until = [&wait, now](int64_t due) {
+            int64_t left = std::max<int64_t>(due - now, 0);
+            wait = wait < 0 ? left : std::min(wait, left);
+        };
+        if (!batch_.empty()) {
+            until(batchStartUs_ + options_.batchInterval.count());
+        }
+        for (const Link& link : links_) {
+            if (link.fd < 0) {
+                until(link.retryUs);
+            }
+        }
+        return wait;
+    }
+
+    void TakeQueue() {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (queue_.empty()) {
+            return;
+        }
+        // The batch window opens with the post of its first event
+        if (batch_.empty()) {
+            batchStartUs_ = queue_.front().postedUs;
+        }
+        batch_.insert(batch_.end(), queue_.begin(), queue_.end());
+        queue_.clear();
+    }
+
+    void SendBatch() {
+        int64_t sentUs = NowUs();
+        for (Link& link : links_) {
+            SendTo(link, sentUs);
+        }
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            batches_++;
+        }
+        batch_.clear();
+    }
+
+    void SendTo(Link& link, int64_t sentUs) {
+        if (!link.connected) {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            link.stats.dropped += batch_.size();
+            return;
+        }
+
+        uint32_t inflight = link.lastSent - link.acked;
+        size_t unsent = link.out.size() - link.outOffset;
+        if (unsent >= kMaxUnsentBytes) {
+            // Not even transitions get through. The agent releases what this
+            // connection held, and the next one starts clean.
+            LOG_WARN("Sync relay agent " << link.address.host << ":" << link.address.port << " stopped reading");
+            {
+                std::lock_guard<std::mutex> lock(statsMutex_);
+                link.stats.dropped += batch_.size();
+            }
+            Disconnect(link);
+            return;
+        }
+
+        const std::vector<RelayEvent>* events = &batch_;
+        uint64_t coalesced = 0;
+        uint64_t dropped = 0;
+        if (inflight >= options_.maxInflight || unsent >= kCongestedBytes) {
+            // A move followed by another move is overtaken by it. Far behind,
+            // only transitions go out.
+            bool behind = inflight >= 4 * options_.maxInflight || unsent >= 4 * kCongestedBytes;
+            thinned_.clear();
+            for (size_t i = 0; i < batch_.size(); i++) {
+                RelayEventType type = batch_[i].type;
+                if (behind && !IsTransition(type)) {
+                    dropped++;
+                    continue;
+                }
+                if (type == RelayEventType::Move && i + 1 < batch_.size() &&
+                    batch_[i + 1].type == RelayEventType::Move) {
+                    coalesced++;
+                    continue;
+                }
+                thinned_.push_back(batch_[i]);
+            }
+            events = &thinned_;
+        }
+        if (events->empty()) {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            link.stats.dropped += dropped;
+            return;
+        }
+
+        size_t bytes = link.out.size();
+        uint64_t frames = 0;
+        for (size_t start = 0; start < events->size(); start += kMaxRelayBatch) {
+            size_t count = std::min(kMaxRelayBatch, events->size() - start);
+            EncodeRelayBatch(link.out, events->data() + start, count, static_cast<uint64_t>(sentUs));
+            frames++;
+        }
+        bytes = link.out.size() - bytes;
+        link.lastSent = events->back().sequence;
+        double queueTotalUs = 0;
+        for (const RelayEvent& event : *events) {
+            queueTotalUs += static_cast<double>(sentUs - event.postedUs);
+        }
+        bool written = WritePending(link.fd, link.out, link.outOffset);
+
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            RelayAgentLinkStats& stats = link.stats;
+            stats.batches += frames;
+            stats.events += events->size();
+            stats.bytes += bytes;
+            stats.coalesced += coalesced;
+            stats.dropped += dropped;
+            stats.inflight = link.lastSent - link.acked;
+            link.queueTotalUs += queueTotalUs;
+            stats.avgQueueUs = link.queueTotalUs / static_cast<double>(stats.events);
+        }
+        if (!written) {
+            Disconnect(link);
+        }
+    }
+
+    void Service(Link& link, short revents) {
+        if (link.connecting) {
+            FinishConnect(link);
+            return;
+        }
+        if (!link.connected) {
+            return;
+        }
+        if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (!ReadAvailable(link.fd, link.in) || !ReadAcks(link)) {
+                Disconnect(link);
+                return;
+            }
+        }
+        if ((revents & POLLOUT) && !WritePending(link.fd, link.out, link.outOffset)) {
+            Disconnect(link);
+        }
+    }
+
+    // False on a malformed ack
+    bool ReadAcks(Link& link) {
+        int64_t now = NowUs();
+        size_t consumed = 0;
+        bool ok = true;
+        while (true) {
+            const uint8_t* payload = nullptr;
+            size_t payloadLength = 0;
+            size_t frameLength = 0;
+            FrameState state = PeekControlFrame(link.in.data() + consumed, link.in.size() - consumed, payload,
+                                                payloadLength, frameLength);
+            if (state == FrameState::Incomplete) {
+                break;
+            }
+            if (state == FrameState::Oversized) {
+                ok = false;
+                break;
+            }
+            consumed += frameLength;
+
+            ProtocolReader reader(payload, payloadLength);
+            uint8_t type = reader.U8();
+            uint64_t sentUs = reader.U64();
+            uint32_t sequence = reader.U32();
+            uint32_t applyUs = reader.U32();
+            if (!reader.ok() || !reader.AtEnd() || type != kRelayAck) {
+                ok = false;
+                break;
+            }
+
+            link.acked = sequence;
+            double rttUs = static_cast<double>(now - static_cast<int64_t>(sentUs));
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            RelayAgentLinkStats& stats = link.stats;
+            stats.acks++;
+            stats.acked = sequence;
+            stats.inflight = link.lastSent - link.acked;
+            link.rttTotalUs += rttUs;
+            link.applyTotalUs += applyUs;
+            link.networkTotalUs += std::max(rttUs - applyUs, 0.0);
+            double acks = static_cast<double>(stats.acks);
+            stats.avgRttUs = link.rttTotalUs / acks;
+            stats.avgApplyUs = link.applyTotalUs / acks;
+            stats.avgNetworkUs = link.networkTotalUs / acks;
+            stats.maxRttUs = std::max(stats.maxRttUs, rttUs);
+        }
+        link.in.erase(link.in.begin(), link.in.begin() + static_cast<std::ptrdiff_t>(consumed));
+        return ok;
+    }
+
+    void ConnectDue(int64_t now) {
+        for (Link& link : links_) {
+            if (link.fd >= 0 || now < link.retryUs) {
+                continue;
+            }
+            int fd = socket(link.sockaddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                link.retryUs = now + kReconnectUs;
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connect(fd, reinterpret_cast<const sockaddr*>(&link.sockaddr), link.sockaddrLength) == 0) {
+                link.fd = fd;
+                Connected(link);
+            } else if (errno == EINPROGRESS) {
+                link.fd = fd;
+                link.connecting = true;
+            } else {
+                close(fd);
+                link.retryUs = now + kReconnectUs;
+            }
+        }
+    }
+
+    void FinishConnect(Link& link) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(link.fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            Disconnect(link);
+            return;
+        }
+        Connected(link);
+    }
+
+    void Connected(Link& link) {
+        link.connecting = false;
+        link.connected = true;
+        link.acked = link.lastSent;
+        LOG_INFO("Sync relay connected to " << link.address.host << ":" << link.address.port);
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        link.stats.connected = true;
+        link.stats.connects++;
+        link.stats.inflight = 0;
+    }
+
+    // Events not yet written are lost; the agent sees them as a gap
+    void Disconnect(Link& link) {
+        if (link.connected) {
+            LOG_WARN("Sync relay lost " << link.address.host << ":" << link.address.port);
+        }
+        CloseFd(link.fd);
+        link.connecting = false;
+        link.connected = false;
+        link.retryUs = NowUs() + kReconnectUs;
+        link.in.clear();
+        link.out.clear();
+        link.outOffset = 0;
+        link.acked = link.lastSent;
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        link.stats.connected = false;
+        link.stats.inflight = 0;
+    }
+
+    SyncRelayOptions options_;
+    int wakeFd_ = -1;
+    std::atomic<bool> running_{true};
+
+    // Queue shared with Post()
+    std::mutex queueMutex_;
+    std::vector<RelayEvent> queue_;
+    uint32_t sequence_ = 0;
+    uint64_t posted_ = 0;
+    uint64_t refused_ = 0;
+
+    // Relay thread only, except the stats of links_
+    std::vector<Link> links_;
+    std::vector<RelayEvent> batch_;
+    std::vector<RelayEvent> thinned_;
+    int64_t batchStartUs_ = 0;
+
+    std::mutex statsMutex_;
+    uint64_t batches_ = 0;
+};
+
+class SyncRelayAgent::Loop {
+public:
+    Loop(std::shared_ptr<AddonCore> core, int listenFd, int port, const std::vector<int>& slavePids)
+        : control_(std::move(core)), listenFd_(listenFd), slaves_(slavePids) {
+        stats_.port = port;
+    }
+
+    ~Loop() {
+        for (Connection& connection : connections_) {
+            CloseFd(connection.fd);
+        }
+        CloseFd(listenFd_);
+        CloseFd(wakeFd_);
+    }
+
+    bool Init(std::string& error) {
+        if (!control_.IsOpen()) {
+            error = "Cannot connect to the X server";
+            return false;
+        }
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd_ < 0) {
+            error = std::string("Failed to create the agent event loop: ") + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    void Stop() {
+        running_.store(false, std::memory_order_release);
+        Wake(wakeFd_);
+    }
+
+    void SetSlaves(const std::vector<int>& slavePids) {
+        std::lock_guard<std::mutex> lock(slavesMutex_);
+        pendingSlaves_ = slavePids;
+        slavesChanged_.store(true, std::memory_order_release);
+    }
+
+    SyncRelayAgentStats Stats() {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        return stats_;
+    }
+
+    void Run() {
+        std::vector<pollfd> fds;
+        while (running_.load(std::memory_order_acquire)) {
+            fds.clear();
+            fds.push_back({wakeFd_, POLLIN, 0});
+            fds.push_back({listenFd_, POLLIN, 0});
+            for (const Connection& connection : connections_) {
+                short events = static_cast<short>(
+                    POLLIN | (connection.outOffset < connection.out.size() ? POLLOUT : 0));
+                fds.push_back({connection.fd, events, 0});
+            }
+
+            int count = poll(fds.data(), fds.size(), -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR("Relay agent poll failed: " << strerror(errno));
+                break;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                DrainWake(wakeFd_);
+            }
+            for (size_t i = 0; i < connections_.size(); i++) {
+                if (fds[i + 2].revents != 0) {
+                    Service(connections_[i], fds[i + 2].revents);
+                }
+            }
+            connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                              [](const Connection& connection) { return connection.fd < 0; }),
+                               connections_.end());
+            if (fds[1].revents & POLLIN) {
+                Accept();
+            }
+        }
+    }
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        size_t outOffset = 0;
+        bool sequenced = false;
+        uint32_t lastSequence = 0;
+        // Down on the slaves through this connection, released when it closes
+        bool leftHeld = false;
+        bool rightHeld = false;
+        std::vector<int> heldKeys;
+        RelayEvent lastPointer;
+    };
+
+    struct Ack {
+        uint64_t sentUs;
+        uint32_t sequence;
+    };
+
+    void Accept() {
+        while (true) {
+            int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            // A master that reconnects has given up on its old connection,
+            // which may be half open and never report its close
+            for (Connection& stale : connections_) {
+                ReleaseHeld(stale);
+            }
+            Connection connection;
+            connection.fd = fd;
+            connections_.push_back(std::move(connection));
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.connections++;
+        }
+    }
+
+    void Close(Connection& connection) {
+        ReleaseHeld(connection);
+        CloseFd(connection.fd);
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.connections--;
+    }
+
+    void Service(Connection& connection, short revents) {
+        if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            int64_t readUs = NowUs();
+            if (!ReadAvailable(connection.fd, connection.in)) {
+                Close(connection);
+                return;
+            }
+            if (!Apply(connection, readUs)) {
+                {
+                    std::lock_guard<std::mutex> lock(statsMutex_);
+                    stats_.malformed++;
+                }
+                Close(connection);
+                return;
+            }
+        }
+        if (connection.outOffset < connection.out.size() &&
+            (!WritePending(connection.fd, connection.out, connection.outOffset) ||
+             connection.out.size() - connection.outOffset > kMaxAckBacklog)) {
+            Close(connection);
+        }
+    }
+
+    // Inject every complete frame, flush once and queue the acks. False on
+    // a protocol error.
+    bool Apply(Connection& connection, int64_t readUs) {
+        if (slavesChanged_.exchange(false, std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(slavesMutex_);
+            slaves_ = pendingSlaves_;
+        }
+
+        uint64_t events = 0;
+        uint64_t injected = 0;
+        uint64_t missed = 0;
+        uint64_t gaps = 0;
+        size_t consumed = 0;
+        bool ok = true;
+        acks_.clear();
+        while (true) {
+            const uint8_t* payload = nullptr;
+            size_t payloadLength = 0;
+            size_t frameLength = 0;
+            FrameState state = PeekControlFrame(connection.in.data() + consumed, connection.in.size() - consumed,
+                                                payload, payloadLength, frameLength);
+            if (state == FrameState::Incomplete) {
+                break;
+            }
+            uint64_t sentUs = 0;
+            if (state == FrameState::Oversized || !DecodeRelayBatch(payload, payloadLength, batch_, sentUs)) {
+                ok = false;
+                break;
+            }
+            consumed += frameLength;
+
+            for (const RelayEvent& event : batch_) {
+                int32_t step = static_cast<int32_t>(event.sequence - connection.lastSequence);
+                if (connection.sequenced && step > 1) {
+                    gaps += static_cast<uint64_t>(step - 1);
+                }
+                connection.sequenced = true;
+                connection.lastSequence = event.sequence;
+                Inject(event, injected, missed);
+                Track(connection, event);
+            }
+            events += batch_.size();
+            acks_.push_back({sentUs, connection.lastSequence});
+        }
+        connection.in.erase(connection.in.begin(), connection.in.begin() + static_cast<std::ptrdiff_t>(consumed));
+        if (acks_.empty()) {
+            return ok;
+        }
+
+        control_.Flush();
+        int64_t applyUs = std::max<int64_t>(NowUs() - readUs, 0);
+        ProtocolWriter writer(connection.out);
+        for (const Ack& ack : acks_) {
+            writer.BeginFrame();
+            writer.U8(kRelayAck);
+            writer.U64(ack.sentUs);
+            writer.U32(ack.sequence);
+            writer.U32(static_cast<uint32_t>(std::min<int64_t>(applyUs, UINT32_MAX)));
+            writer.EndFrame();
+        }
+
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.batches += acks_.size();
+        stats_.events += events;
+        stats_.injected += injected;
+        stats_.missed += missed;
+        stats_.gaps += gaps;
+        applyTotalUs_ += static_cast<double>(applyUs);
+        applySamples_++;
+        stats_.avgApplyUs = applyTotalUs_ / static_cast<double>(applySamples_);
+        stats_.maxApplyUs = std::max(stats_.maxApplyUs, static_cast<double>(applyUs));
+        return ok;
+    }
+
+    void Track(Connection& connection, const RelayEvent& event) {
+        switch (event.type) {
+            case RelayEventType::LeftDown:
+            case RelayEventType::LeftUp:
+                connection.leftHeld = event.type == RelayEventType::LeftDown;
+                break;
+            case RelayEventType::RightDown:
+            case RelayEventType::RightUp:
+                connection.rightHeld = event.type == RelayEventType::RightDown;
+                break;
+            case RelayEventType::KeyDown:
+                if (std::find(connection.heldKeys.begin(), connection.heldKeys.end(), event.keyCode) ==
+                    connection.heldKeys.end()) {
+                    connection.heldKeys.push_back(event.keyCode);
+                }
+                return;
+            case RelayEventType::KeyUp:
+                connection.heldKeys.erase(
+                    std::remove(connection.heldKeys.begin(), connection.heldKeys.end(), event.keyCode),
+                    connection.heldKeys.end());
+                return;
+            default:
+                break;
+        }
+        connection.lastPointer = event;
+    }
+
+    // Let go of the buttons and keys the connection left down, where the
+    // pointer last was, so a lost master does not leave them held
+    void ReleaseHeld(Connection& connection) {
+        std::vector<RelayEvent> releases;
+        RelayEvent release = connection.lastPointer;
+        if (connection.leftHeld) {
+            release.type = RelayEventType::LeftUp;
+            releases.push_back(release);
+        }
+        if (connection.rightHeld) {
+            release.type = RelayEventType::RightUp;
+            releases.push_back(release);
+        }
+        for (int keyCode : connection.heldKeys) {
+            RelayEvent key;
+            key.type = RelayEventType::KeyUp;
+            key.keyCode = keyCode;
+            releases.push_back(key);
+        }
+        connection.leftHeld = false;
+        connection.rightHeld = false;
+        connection.heldKeys.clear();
+        if (releases.empty()) {
+            return;
+        }
+
+        uint64_t injected = 0;
+        uint64_t missed = 0;
+        for (const RelayEvent& event : releases) {
+            Inject(event, injected, missed);
+        }
+        control_.Flush();
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.released += releases.size();
+        stats_.injected += injected;
+        stats_.missed += missed;
+    }
+
+    // Same relative position in every slave's main window, whatever its size
+    void Inject(const RelayEvent& event, uint64_t& injected, uint64_t& missed) {
+        for (int pid : slaves_) {
+            const auto& windows = control_.EventWindows(pid);
+            if (windows.empty()) {
+                missed++;
+                continue;
+            }
+            bool sent;
+            if (IsKey(event.type)) {
+                sent = control_.SendKeyEvent(pid, event.keyCode,
+                                             event.type == RelayEventType::KeyDown ? KeyEvent::Down : KeyEvent::Up);
+            } else {
+                const X11WindowInfo& main = windows[0];
+                int x = main.x + static_cast<int>(std::lround(static_cast<double>(event.x) * main.width / kRelayScale));
+                int y = main.y + static_cast<int>(std::lround(static_cast<double>(event.y) * main.height / kRelayScale));
+                sent = event.type == RelayEventType::Wheel
+                           ? control_.SendWheelEvent(pid, event.deltaX, event.deltaY, x, y)
+                           : control_.SendPointerEvent(pid, x, y, static_cast<PointerEvent>(event.type));
+            }
+            sent ? injected++ : missed++;
+        }
+    }
+
+    X11WindowControl control_;
+    int listenFd_ = -1;
+    int wakeFd_ = -1;
+    std::atomic<bool> running_{true};
+
+    // Agent thread only
+    std::vector<int> slaves_;
+    std::vector<Connection> connections_;
+    std::vector<RelayEvent> batch_;
+    std::vector<Ack> acks_;
+
+    std::mutex slavesMutex_;
+    std::vector<int> pendingSlaves_;
+    std::atomic<bool> slavesChanged_{false};
+
+    std::mutex statsMutex_;
+    SyncRelayAgentStats stats_;
+    double applyTotalUs_ = 0;
+    uint64_t applySamples_ = 0;
+};
+
+#else
+
+class SyncRelayMaster::Loop {};
+class SyncRelayAgent::Loop {};
+
+#endif
+
+SyncRelayMaster::SyncRelayMaster(const SyncRelayOptions& options) : options_(options) {}
+
+SyncRelayMaster::~SyncRelayMaster() {
+#ifdef __linux__
+    if (loop_) {
+        loop_->Stop();
+        thread_.join();
+    }
+#endif
+}
+
+bool SyncRelayMaster::Start(const std::vector<RelayAgentAddress>& agents, std::string& error) {
+#ifdef __linux__
+    if (loop_) {
+        error = "Relay is already running";
+        return false;
+    }
+    std::vector<Loop::Link> links(agents.size());
+    for (size_t i = 0; i < agents.size(); i++) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICSERV;
+        addrinfo* addresses = nullptr;
+        std::string port = std::to_string(agents[i].port);
+        int status = getaddrinfo(agents[i].host.c_str(), port.c_str(), &hints, &addresses);
+        if (status != 0 || !addresses) {
+            error = "Cannot resolve agent " + agents[i].host + ": " + gai_strerror(status);
+            return false;
+        }
+        memcpy(&links[i].sockaddr, addresses->ai_addr, addresses->ai_addrlen);
+        links[i].sockaddrLength = addresses->ai_addrlen;
+        links[i].address = agents[i];
+        freeaddrinfo(addresses);
+    }
+
+    auto loop = std::make_unique<Loop>(options_, std::move(links));
+    if (!loop->Init(error)) {
+        return false;
+    }
+    loop_ = std::move(loop);
+    thread_ = std::thread([this] { loop_->Run(); });
+    return true;
+#else
+    (void)agents;
+    error = "The sync relay is not supported on this platform";
+    return false;
+#endif
+}
+
+bool SyncRelayMaster::Post(RelayEvent event) {
+#ifdef __linux__
+    return loop_ && loop_->Post(event);
+#else
+    (void)event;
+    return false;
+#endif
+}
+
+SyncRelayStats SyncRelayMaster::Stats() {
+#ifdef __linux__
+    if (loop_) {
+        return loop_->Stats();
+    }
+#endif
+    return {};
+}
+
+SyncRelayAgent::SyncRelayAgent(std::shared_ptr<AddonCore> core) : core_(std::move(core)) {}
+
+SyncRelayAgent::~SyncRelayAgent() {
+#ifdef __linux__
+    if (loop_) {
+        loop_->Stop();
+        thread_.join();
+    }
+#endif
+}
+
+int SyncRelayAgent::Start(const std::string& host, int port, const std::vector<int>& slavePids, std::string& error) {
+#ifdef __linux__
+    if (loop_) {
+        error = "Agent is already running";
+        return 0;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    int status = getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses);
+    if (status != 0 || !addresses) {
+        error = "Cannot resolve listen address " + host + ": " + gai_strerror(status);
+        return 0;
+    }
+
+    int fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (fd < 0 || bind(fd, addresses->ai_addr, addresses->ai_addrlen) < 0 || listen(fd, SOMAXCONN) < 0) {
+        error = "Cannot listen on " + host + ":" + service + ": " + strerror(errno);
+        if (fd >= 0) {
+            close(fd);
+        }
+        freeaddrinfo(addresses);
+        return 0;
+    }
+    freeaddrinfo(addresses);
+
+    sockaddr_storage bound{};
+    socklen_t boundLength = sizeof(bound);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+    int boundPort = ntohs(bound.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port
+                                                      : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+
+    // The loop owns fd from here on
+    auto loop = std::make_unique<Loop>(core_, fd, boundPort, slavePids);
+    if (!loop->Init(error)) {
+        return 0;
+    }
+    loop_ = std::move(loop);
+    thread_ = std::thread([this] { loop_->Run(); });
+    return boundPort;
+#else
+    (void)host;
+    (void)port;
+    (void)slavePids;
+    error = "The relay agent is not supported on this platform";
+    return 0;
+#endif
+}
+
+void SyncRelayAgent::SetSlaves(const std::vector<int>& slavePids) {
+#ifdef __linux__
+    if (loop_) {
+        loop_->SetSlaves(slavePids);
+    }
+#else
+    (void)slavePids;
+#endif
+}
+
+SyncRelayAgentStats SyncRelayAgent::Stats() {
+#ifdef __linux__
+    if (loop_) {
+        return loop_->Stats();
+    }
+#endif
+    return {};
+}
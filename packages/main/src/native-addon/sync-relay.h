@@ -0,0 +1,195 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AddonCore;
+
+// Sync across hosts. A master streams the input of its master window to
+// relay agents on other machines, and every agent replays it on its own
+// slave windows.
+//
+// The master normalises events before they leave: positions are relative
+// to the master window in 1/kRelayScale units, key codes stay as they are
+// (X keycodes, so master and agents must share a platform), and every event
+// gets a sequence number. The master collects events for batchInterval and
+// then writes each batch to every agent over TCP with TCP_NODELAY.
+// Positions in a batch are encoded as deltas from the event before, so a
+// pointer move usually takes 4 bytes. An agent applies all frames it reads
+// with one window system flush. It acknowledges each frame and echoes the
+// master's send time, so the master measures the round trip to every agent
+// without synchronised clocks.
+//
+// Backpressure is per agent. Once maxInflight events are unacknowledged,
+// or the unsent bytes pile up, consecutive pointer moves to that agent are
+// coalesced into the newest one. At four times that limit, moves and wheel
+// events to the agent are dropped until it catches up. Button and key
+// transitions are always sent; an agent so far behind that even those pile
+// up is disconnected. Agents count the sequence numbers they never saw as
+// gaps, and release the buttons and keys a connection left down when it
+// closes or its master connects again.
+//
+// Wire format: frames as in control-protocol.h (u32 length, then the
+// payload), integers little-endian, varints LEB128 (svarint: zigzag).
+//
+//   Batch  master -> agent  u8 1, u64 sentUs, u32 baseSequence, u16 n, n x event
+//     event: varint sequence gap to the event before (the first: to
+//            baseSequence), u8 type (RelayEventType), then by type
+//       pointer  svarint dx, svarint dy
+//       wheel    svarint dx, svarint dy, svarint deltaX, svarint deltaY
+//       key      varint keyCode
+//     dx, dy: change of position from the pointer event before, or from
+//             0, 0 for the first
+//   Ack    agent -> master  u8 2, u64 sentUs, u32 lastSequence, u32 applyUs
+//
+// The X11 backend is the only one: Start() fails elsewhere.
+
+enum class RelayEventType : uint8_t {
+    // Same values as PointerEventCode
+    Move = 0,
+    LeftDown = 1,
+    LeftUp = 2,
+    RightDown = 3,
+    RightUp = 4,
+    Wheel = 5,
+    KeyDown = 6,
+    KeyUp = 7,
+};
+
+// The master window spans 0..kRelayScale on both axes
+constexpr int kRelayScale = 1 << 16;
+
+struct RelayEvent {
+    RelayEventType type = RelayEventType::Move;
+    int x = 0;
+    int y = 0;
+    int deltaX = 0;
+    int deltaY = 0;
+    int keyCode = 0;
+    uint32_t sequence = 0;
+    int64_t postedUs = 0;           // master clock, not sent
+};
+
+// Events in one Batch frame
+constexpr size_t kMaxRelayBatch = 1024;
+
+// Appends one Batch frame of up to kMaxRelayBatch events
+void EncodeRelayBatch(std::vector<uint8_t>& out, const RelayEvent* events, size_t count, uint64_t sentUs);
+// False for a malformed Batch payload
+bool DecodeRelayBatch(const uint8_t* payload, size_t length, std::vector<RelayEvent>& events, uint64_t& sentUs);
+
+struct SyncRelayOptions {
+    // How long the first event of a batch waits for more; 0 sends at once
+    std::chrono::microseconds batchInterval{1000};
+    // Unacknowledged events per agent before its moves are coalesced
+    uint32_t maxInflight = 256;
+    // Events waiting for the relay thread before posts are refused
+    size_t queueCapacity = 4096;
+};
+
+struct RelayAgentLinkStats {
+    std::string host;
+    int port = 0;
+    bool connected = false;
+    uint64_t connects = 0;
+    uint64_t batches = 0;
+    uint64_t events = 0;            // events written to the agent
+    uint64_t bytes = 0;
+    uint64_t coalesced = 0;         // moves left out under backpressure
+    uint64_t dropped = 0;           // events not sent: disconnected, or moves far behind
+    uint32_t acked = 0;             // last sequence the agent applied
+    uint32_t inflight = 0;
+    uint64_t acks = 0;
+    // Per hop: post to write on the master, write to ack minus the agent's
+    // own time, and read to flush on the agent
+    double avgQueueUs = 0;
+    double avgNetworkUs = 0;
+    double avgApplyUs = 0;
+    double avgRttUs = 0;
+    double maxRttUs = 0;
+};
+
+struct SyncRelayStats {
+    uint64_t posted = 0;
+    uint64_t refused = 0;           // posts refused by a full queue
+    uint64_t batches = 0;
+    std::vector<RelayAgentLinkStats> agents;
+};
+
+struct RelayAgentAddress {
+    std::string host;
+    int port = 0;
+};
+
+class SyncRelayMaster {
+public:
+    explicit SyncRelayMaster(const SyncRelayOptions& options);
+    ~SyncRelayMaster();
+
+    SyncRelayMaster(const SyncRelayMaster&) = delete;
+    SyncRelayMaster& operator=(const SyncRelayMaster&) = delete;
+
+    // Resolve every agent and start the relay thread, which connects to them
+    // and reconnects when a connection drops. False with error set when an
+    // address does not resolve.
+    bool Start(const std::vector<RelayAgentAddress>& agents, std::string& error);
+
+    // Queue an event, normalised, for every agent. Assigns its sequence.
+    // False when the queue is full.
+    bool Post(RelayEvent event);
+
+    SyncRelayStats Stats();
+
+    // Relay thread state, defined in sync-relay.cpp
+    class Loop;
+
+private:
+    SyncRelayOptions options_;
+    std::unique_ptr<Loop> loop_;
+    std::thread thread_;
+};
+
+struct SyncRelayAgentStats {
+    int port = 0;
+    int connections = 0;            // masters connected now
+    uint64_t batches = 0;
+    uint64_t events = 0;
+    uint64_t injected = 0;          // events delivered to a slave window
+    uint64_t missed = 0;            // events for a slave without a window
+    uint64_t gaps = 0;              // sequence numbers never received
+    uint64_t released = 0;          // buttons and keys let go for a lost master
+    uint64_t malformed = 0;         // connections closed on a protocol error
+    double avgApplyUs = 0;
+    double maxApplyUs = 0;
+};
+
+class SyncRelayAgent {
+public:
+    explicit SyncRelayAgent(std::shared_ptr<AddonCore> core);
+    ~SyncRelayAgent();
+
+    SyncRelayAgent(const SyncRelayAgent&) = delete;
+    SyncRelayAgent& operator=(const SyncRelayAgent&) = delete;
+
+    // Listen on host:port (port 0 picks a free one) and replay what masters
+    // send on the main windows of slavePids. Returns the port, or 0 with
+    // error set.
+    int Start(const std::string& host, int port, const std::vector<int>& slavePids, std::string& error);
+
+    void SetSlaves(const std::vector<int>& slavePids);
+
+    SyncRelayAgentStats Stats();
+
+    // Agent thread state, defined in sync-relay.cpp
+    class Loop;
+
+private:
+    std::shared_ptr<AddonCore> core_;
+    std::unique_ptr<Loop> loop_;
+    std::thread thread_;
+};
@@ -0,0 +1,1055 @@
+#include "sync-sessions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "addon-common.h"
+#include "addon-core.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#elif defined(_WIN32)
+#include <windows.h>
+
+#include "process-tree.h"
+#include "window-classifier.h"
+#endif
+
+// X11 and Win32 have a backend; elsewhere Create() returns 0
+#if defined(__linux__) || defined(_WIN32)
+#define SYNC_SESSIONS_BACKEND 1
+#endif
+
+namespace {
+
+// Upper bound on the pool whatever the core count
+constexpr unsigned kMaxWorkers = 16;
+#ifdef _WIN32
+// Ping threads of a worker, each waiting on one slave's answer
+constexpr size_t kMaxPingers = 64;
+#endif
+
+unsigned MaxWorkers() {
+    return std::min(kMaxWorkers, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+}  // namespace
+
+struct SyncSessionPool::Session {
+    struct Bounds {
+        bool valid = false;
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+#ifdef _WIN32
+        // Events are posted to the main window itself
+        HWND window = nullptr;
+#endif
+    };
+
+    // A WatchBarrier() call still waiting
+    struct Waiter {
+        uint64_t from = 0;
+        uint64_t target = 0;
+        std::chrono::steady_clock::time_point deadline;
+        BarrierCallback done;
+    };
+
+    // Waiters taken off the session, called once its mutex is released
+    using Settled = std::vector<std::pair<BarrierCallback, SyncBarrierResult>>;
+
+    uint64_t id = 0;
+    int masterPid = 0;
+    std::vector<int> slavePids;
+    SyncSessionOptions options;
+    Worker* worker = nullptr;
+
+    // Queue and stats, shared by the posting thread and the worker. A
+    // non-empty queue is always scheduled on the worker, so only the post
+    // that finds it empty schedules it. A lockstep session takes one event
+    // at a time; the worker schedules the rest itself once that event is
+    // through its barrier.
+    std::mutex mutex;
+    std::vector<SyncEvent> queue;
+    SyncSessionStats stats;
+    double latencyTotalUs = 0;
+    double barrierTotalUs = 0;
+    // Sequence of the last barrier each slave missed
+    std::vector<uint64_t> missedBarrier;
+    std::vector<Waiter> waiters;
+
+    // Held by the worker while it injects, so Destroy() can wait it out
+    std::mutex dispatching;
+    std::atomic<bool> closed{false};
+
+    // Worker thread only
+    Bounds master;
+    std::vector<Bounds> slaves;
+    std::chrono::steady_clock::time_point boundsRead;
+    uint64_t boundsEpoch = UINT64_MAX;
+    // Waiting for the answers to a barrier
+    bool parked = false;
+
+    // With mutex held
+    SyncBarrierResult BarrierResult(const Waiter& waiter, bool reached) const {
+        SyncBarrierResult result;
+        result.sequence = stats.confirmed;
+        result.reached = reached;
+        for (size_t i = 0; i < slavePids.size(); i++) {
+            if (missedBarrier[i] > waiter.from) {
+                result.stragglers.push_back(slavePids[i]);
+            }
+        }
+        return result;
+    }
+
+    // With mutex held: take the waiters whose events are all confirmed, and
+    // those past their deadline at now
+    void TakeSettled(std::chrono::steady_clock::time_point now, Settled& settled) {
+        auto keep = std::remove_if(waiters.begin(), waiters.end(), [&](Waiter& waiter) {
+            bool reached = stats.confirmed >= waiter.target;
+            if (!reached && now < waiter.deadline) {
+                return false;
+            }
+            settled.emplace_back(std::move(waiter.done), BarrierResult(waiter, reached));
+            return true;
+        });
+        waiters.erase(keep, waiters.end());
+    }
+
+    // The session is going: every waiter gets found = false
+    void Close() {
+        closed.store(true, std::memory_order_release);
+        std::vector<Waiter> gone;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            gone.swap(waiters);
+        }
+        for (Waiter& waiter : gone) {
+            waiter.done(false, SyncBarrierResult());
+        }
+    }
+
+    static void Call(Settled& settled) {
+        for (auto& entry : settled) {
+            entry.first(true, entry.second);
+        }
+        settled.clear();
+    }
+};
+
+class SyncSessionPool::Worker {
+public:
+    Worker(std::shared_ptr<AddonCore> core, const std::atomic<uint64_t>& boundsEpoch, int index)
+        : index_(index),
+          boundsEpoch_(boundsEpoch)
+#ifdef __linux__
+          ,
+          control_(std::move(core))
+#elif defined(_WIN32)
+          ,
+          core_(std::move(core))
+#endif
+    {
+#ifndef SYNC_SESSIONS_BACKEND
+        (void)core;
+#endif
+    }
+
+    ~Worker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        Wake();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+#ifdef _WIN32
+        // Each returns once its ping times out
+        pingReady_.notify_all();
+        for (auto& pinger : pingers_) {
+            pinger.join();
+        }
+#endif
+#ifdef __linux__
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+        }
+#elif defined(_WIN32)
+        if (wakeEvent_) {
+            CloseHandle(wakeEvent_);
+        }
+#endif
+    }
+
+    // False when the worker cannot reach the window system
+    bool Start() {
+#ifdef __linux__
+        if (!control_.IsOpen()) {
+            return false;
+        }
+        wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeFd_ < 0) {
+            return false;
+        }
+        thread_ = std::thread([this] { Run(); });
+        return true;
+#elif defined(_WIN32)
+        wakeEvent_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        if (!wakeEvent_) {
+            return false;
+        }
+        thread_ = std::thread([this] { Run(); });
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Schedule(std::shared_ptr<Session> session) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(std::move(session));
+        }
+        Wake();
+    }
+
+    // The session has a waiter with a deadline to keep
+    void Watch(std::shared_ptr<Session> session) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            watchRequests_.push_back(std::move(session));
+        }
+        Wake();
+    }
+
+    int Index() const { return index_; }
+
+    // Sessions pinned here, guarded by the pool's mutex
+    int sessions = 0;
+
+private:
+    void Wake() {
+#ifdef __linux__
+        if (wakeFd_ >= 0) {
+            eventfd_write(wakeFd_, 1);
+        }
+#elif defined(_WIN32)
+        if (wakeEvent_) {
+            SetEvent(wakeEvent_);
+        }
+#endif
+    }
+
+#ifdef SYNC_SESSIONS_BACKEND
+    // Take the sessions ready to dispatch and the new ones to watch. False
+    // once the worker is stopping.
+    bool TakeRequests(std::deque<std::shared_ptr<Session>>& ready) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return false;
+        }
+        ready.swap(ready_);
+        for (auto& session : watchRequests_) {
+            if (std::find(watching_.begin(), watching_.end(), session) == watching_.end()) {
+                watching_.push_back(std::move(session));
+            }
+        }
+        watchRequests_.clear();
+        return true;
+    }
+
+    // Until the nearest barrier or waiter deadline, -1 for none
+    int NextTimeoutMs() {
+        auto nearest = std::chrono::steady_clock::time_point::max();
+        for (const Barrier& barrier : barriers_) {
+            nearest = std::min(nearest, barrier.deadline);
+        }
+        for (const auto& session : watching_) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            for (const Session::Waiter& waiter : session->waiters) {
+                nearest = std::min(nearest, waiter.deadline);
+            }
+        }
+        if (nearest == std::chrono::steady_clock::time_point::max()) {
+            return -1;
+        }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(nearest - std::chrono::steady_clock::now());
+        return static_cast<int>(std::max<int64_t>(0, wait.count()));
+    }
+#endif
+
+#ifdef __linux__
+    // Dispatches ready sessions as they come, reads the answers to parked
+    // barriers off the connection, and expires barriers and waiters whose
+    // deadlines pass. Sleeps in poll() on the connection and wakeFd_.
+    void Run() {
+        std::deque<std::shared_ptr<Session>> ready;
+        xcb_connection_t* connection = control_.Connection().Get();
+        while (TakeRequests(ready)) {
+            for (auto& session : ready) {
+                Dispatch(session);
+            }
+            ready.clear();
+
+            ReadEvents();
+            auto now = std::chrono::steady_clock::now();
+            ExpireBarriers(now);
+            ExpireWaiters(now);
+
+            int timeoutMs = NextTimeoutMs();
+            if (xcb_connection_has_error(connection)) {
+                // Nothing more to read; barriers run out at their deadlines
+                pollfd fd = {wakeFd_, POLLIN, 0};
+                poll(&fd, 1, timeoutMs);
+            } else {
+                pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {xcb_get_file_descriptor(connection), POLLIN, 0}};
+                poll(fds, 2, timeoutMs);
+            }
+            eventfd_t count;
+            eventfd_read(wakeFd_, &count);
+        }
+    }
+#elif defined(_WIN32)
+    // As on X11, with the answers to barriers coming from the ping threads.
+    // Sleeps on wakeEvent_.
+    void Run() {
+        std::deque<std::shared_ptr<Session>> ready;
+        while (TakeRequests(ready)) {
+            for (auto& session : ready) {
+                Dispatch(session);
+            }
+            ready.clear();
+
+            ReadAnswers();
+            auto now = std::chrono::steady_clock::now();
+            ExpireBarriers(now);
+            ExpireWaiters(now);
+
+            int timeoutMs = NextTimeoutMs();
+            WaitForSingleObject(wakeEvent_, timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+        }
+    }
+#else
+    void Run() {}
+#endif
+
+    void Dispatch(const std::shared_ptr<Session>& sessionPtr) {
+        Session& session = *sessionPtr;
+        std::lock_guard<std::mutex> dispatching(session.dispatching);
+        if (session.closed.load(std::memory_order_acquire) || session.parked) {
+            // A parked session is scheduled again when its barrier ends
+            return;
+        }
+        bool lockstep = session.options.lockstep;
+        {
+            // Copy rather than swap so both buffers keep their capacity
+            std::lock_guard<std::mutex> lock(session.mutex);
+            if (lockstep && !session.queue.empty()) {
+                batch_.assign(session.queue.begin(), session.queue.begin() + 1);
+                session.queue.erase(session.queue.begin());
+            } else {
+                batch_.assign(session.queue.begin(), session.queue.end());
+                session.queue.clear();
+            }
+        }
+        if (batch_.empty()) {
+            return;
+        }
+
+#ifdef SYNC_SESSIONS_BACKEND
+        uint64_t epoch = boundsEpoch_.load(std::memory_order_acquire);
+#ifdef __linux__
+        if (epoch != controlEpoch_) {
+            control_.InvalidateEventWindows();
+            controlEpoch_ = epoch;
+        }
+#endif
+        bool refreshed = false;
+        if (epoch != session.boundsEpoch ||
+            std::chrono::steady_clock::now() - session.boundsRead >= session.options.boundsTtl) {
+            RefreshBounds(session);
+            session.boundsEpoch = epoch;
+            refreshed = true;
+        }
+
+        DispatchTotals totals;
+        for (const SyncEvent& event : batch_) {
+            Inject(session, event, totals);
+        }
+        if (!lockstep) {
+            // Each slave window is addressed directly, so workers need not
+            // hold AddonCore::LockInput; the X server orders each
+            // connection's events, and each window's queue orders posted
+            // messages
+#ifdef __linux__
+            control_.Flush();
+#endif
+            auto done = std::chrono::steady_clock::now();
+            for (const SyncEvent& event : batch_) {
+                totals.AddLatency(std::chrono::duration<double, std::micro>(done - event.posted).count());
+            }
+        }
+
+        Session::Settled settled;
+        {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            SyncSessionStats& stats = session.stats;
+            stats.dispatched += batch_.size();
+            stats.injected += totals.injected;
+            stats.missed += totals.missed;
+            stats.boundsRefreshes += refreshed ? 1 : 0;
+            if (!lockstep) {
+                session.latencyTotalUs += totals.latencyTotalUs;
+                stats.avgLatencyUs = session.latencyTotalUs / static_cast<double>(stats.dispatched);
+                stats.maxLatencyUs = std::max(stats.maxLatencyUs, totals.latencyMaxUs);
+                stats.confirmed = batch_.back().sequence;
+                session.TakeSettled(std::chrono::steady_clock::now(), settled);
+            }
+        }
+        Session::Call(settled);
+        if (lockstep) {
+            // Flushes the event along with the pings
+            StartBarrier(sessionPtr, batch_.front());
+        }
+#endif
+    }
+
+#ifdef SYNC_SESSIONS_BACKEND
+#ifdef __linux__
+    using SlaveWindow = xcb_window_t;
+#else
+    using SlaveWindow = HWND;
+#endif
+
+    struct DispatchTotals {
+        uint64_t injected = 0;
+        uint64_t missed = 0;
+        double latencyTotalUs = 0;
+        double latencyMaxUs = 0;
+
+        void AddLatency(double latencyUs) {
+            latencyTotalUs += latencyUs;
+            latencyMaxUs = std::max(latencyMaxUs, latencyUs);
+        }
+    };
+
+    // A lockstep event waiting for the slaves' answers
+    struct Barrier {
+        std::shared_ptr<Session> session;
+        uint64_t sequence = 0;
+        uint32_t serial = 0;
+        std::chrono::steady_clock::time_point posted;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point deadline;
+        // Slave windows still silent, with their slave index
+        std::vector<std::pair<SlaveWindow, size_t>> pending;
+    };
+
+    // Queue event for every slave, mapped from the master window. sent_
+    // records the slaves it went to.
+    void Inject(const Session& session, const SyncEvent& event, DispatchTotals& totals) {
+        sent_.assign(session.slavePids.size(), false);
+        // Keys go to whatever has the focus in each slave
+        bool positioned = event.kind != SyncEventKind::Key;
+        const Session::Bounds& master = session.master;
+        if (positioned && !master.valid) {
+            totals.missed += session.slavePids.size();
+            return;
+        }
+        // Same relative position in every slave, whatever its size
+        double relativeX = positioned ? static_cast<double>(event.x - master.x) / master.width : 0;
+        double relativeY = positioned ? static_cast<double>(event.y - master.y) / master.height : 0;
+        for (size_t i = 0; i < session.slavePids.size(); i++) {
+            const Session::Bounds& slave = session.slaves[i];
+            int x = -1;
+            int y = -1;
+            if (positioned) {
+                if (!slave.valid) {
+                    totals.missed++;
+                    continue;
+                }
+                x = slave.x + static_cast<int>(std::lround(relativeX * slave.width));
+                y = slave.y + static_cast<int>(std::lround(relativeY * slave.height));
+            }
+            bool sent = Send(session, i, x, y, event);
+            sent ? totals.injected++ : totals.missed++;
+            sent_[i] = sent;
+        }
+    }
+
+#ifdef __linux__
+    bool Send(const Session& session, size_t slave, int x, int y, const SyncEvent& event) {
+        int pid = session.slavePids[slave];
+        switch (event.kind) {
+            case SyncEventKind::Pointer:
+                return control_.SendPointerEvent(pid, x, y, event.pointer);
+            case SyncEventKind::Wheel:
+                return control_.SendWheelEvent(pid, event.deltaX, event.deltaY, x, y);
+            case SyncEventKind::Key:
+                return control_.SendKeyEvent(pid, event.keyCode, event.key);
+        }
+        return false;
+    }
+#else
+    // Posted to the slave's main window, at x, y relative to it
+    bool Send(const Session& session, size_t slave, int x, int y, const SyncEvent& event) {
+        const Session::Bounds& bounds = session.slaves[slave];
+        if (!bounds.window) {
+            return false;
+        }
+        if (event.kind == SyncEventKind::Key) {
+            // Repeat count 1; a release also sets the previous state and transition bits
+            bool down = event.key == KeyEvent::Down;
+            LPARAM flags = down ? 1 : static_cast<LPARAM>(1u | (1u << 30) | (1u << 31));
+            return PostMessage(bounds.window, down ? WM_KEYDOWN : WM_KEYUP, static_cast<WPARAM>(event.keyCode),
+                               flags) != FALSE;
+        }
+        if (event.kind == SyncEventKind::Wheel) {
+            // Wheel messages take screen coordinates; deltas are already in WHEEL_DELTA units
+            LPARAM screen = MAKELPARAM(x, y);
+            bool sent = true;
+            if (event.deltaY != 0) {
+                sent = PostMessage(bounds.window, WM_MOUSEWHEEL, MAKEWPARAM(0, event.deltaY), screen) != FALSE;
+            }
+            if (event.deltaX != 0) {
+                sent = PostMessage(bounds.window, WM_MOUSEHWHEEL, MAKEWPARAM(0, event.deltaX), screen) != FALSE && sent;
+            }
+            return sent;
+        }
+
+        LPARAM position = MAKELPARAM(x - bounds.x, y - bounds.y);
+        switch (event.pointer) {
+            case PointerEvent::Move:
+                return PostMessage(bounds.window, WM_MOUSEMOVE, 0, position) != FALSE;
+            case PointerEvent::LeftDown:
+                return PostMessage(bounds.window, WM_LBUTTONDOWN, MK_LBUTTON, position) != FALSE;
+            case PointerEvent::LeftUp:
+                return PostMessage(bounds.window, WM_LBUTTONUP, 0, position) != FALSE;
+            case PointerEvent::RightDown:
+                return PostMessage(bounds.window, WM_RBUTTONDOWN, MK_RBUTTON, position) != FALSE;
+            case PointerEvent::RightUp:
+                return PostMessage(bounds.window, WM_RBUTTONUP, 0, position) != FALSE;
+        }
+        return false;
+    }
+#endif
+
+#ifdef __linux__
+    // Ping every slave the event went to and park the session until they
+    // answer to the root window, or barrierTimeout passes
+    void StartBarrier(const std::shared_ptr<Session>& session, const SyncEvent& event) {
+        X11Connection& x11 = control_.Connection();
+        if (!rootEvents_) {
+            x11.SelectRootEvents(XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY);
+            protocolsAtom_ = x11.Atom("WM_PROTOCOLS");
+            pingAtom_ = x11.Atom("_NET_WM_PING");
+            rootEvents_ = true;
+        }
+
+        Barrier barrier;
+        barrier.session = session;
+        barrier.sequence = event.sequence;
+        barrier.serial = static_cast<uint32_t>(event.sequence);
+        barrier.posted = event.posted;
+        for (size_t i = 0; i < session->slavePids.size(); i++) {
+            const auto& windows = control_.EventWindows(session->slavePids[i]);
+            if (!sent_[i] || windows.empty()) {
+                continue;
+            }
+            xcb_window_t window = windows[0].window;
+            x11.SendWindowMessage(window, protocolsAtom_, {pingAtom_, barrier.serial, window, 0, 0});
+            barrier.pending.emplace_back(window, i);
+        }
+        x11.Flush();
+        barrier.started = std::chrono::steady_clock::now();
+        barrier.deadline = barrier.started + session->options.barrierTimeout;
+
+        session->parked = true;
+        if (barrier.pending.empty()) {
+            EndBarrier(barrier);
+            return;
+        }
+        barriers_.push_back(std::move(barrier));
+    }
+
+    // Answers to the pings of parked barriers; everything else on the
+    // connection is dropped
+    void ReadEvents() {
+        xcb_connection_t* connection = control_.Connection().Get();
+        while (xcb_generic_event_t* generic = xcb_poll_for_event(connection)) {
+            auto* message = reinterpret_cast<xcb_client_message_event_t*>(generic);
+            if ((generic->response_type & 0x7F) == XCB_CLIENT_MESSAGE && rootEvents_ &&
+                message->type == protocolsAtom_ && message->data.data32[0] == pingAtom_) {
+                Answered(message->data.data32[1], message->data.data32[2]);
+            }
+            free(generic);
+        }
+    }
+
+#else
+    // Ping every slave the event went to from the ping threads and park the
+    // session until they answer, or barrierTimeout passes.
+    // SendMessageTimeout returns once the slave's UI thread has handled the
+    // WM_NULL, and with it every message posted before.
+    void StartBarrier(const std::shared_ptr<Session>& session, const SyncEvent& event) {
+        Barrier barrier;
+        barrier.session = session;
+        barrier.sequence = event.sequence;
+        barrier.serial = static_cast<uint32_t>(event.sequence);
+        barrier.posted = event.posted;
+        auto timeoutMs = static_cast<UINT>(session->options.barrierTimeout.count());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < session->slavePids.size(); i++) {
+                HWND window = session->slaves[i].window;
+                if (!sent_[i] || !window) {
+                    continue;
+                }
+                pings_.push_back({barrier.serial, window, timeoutMs});
+                barrier.pending.emplace_back(window, i);
+            }
+            // A hung slave holds its ping thread until the timeout, so there
+            // is a thread for every ping in the queue
+            while (idlePingers_ < pings_.size() && pingers_.size() < kMaxPingers) {
+                pingers_.emplace_back([this] { Ping(); });
+                idlePingers_++;
+            }
+        }
+        pingReady_.notify_all();
+        barrier.started = std::chrono::steady_clock::now();
+        barrier.deadline = barrier.started + session->options.barrierTimeout;
+
+        session->parked = true;
+        if (barrier.pending.empty()) {
+            EndBarrier(barrier);
+            return;
+        }
+        barriers_.push_back(std::move(barrier));
+    }
+
+    // Ping thread: send queued pings and hand the answers to Run()
+    void Ping() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            pingReady_.wait(lock, [this] { return stopping_ || !pings_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            PendingPing ping = pings_.front();
+            pings_.pop_front();
+            idlePingers_--;
+            lock.unlock();
+            DWORD_PTR result = 0;
+            bool answered = SendMessageTimeout(ping.window, WM_NULL, 0, 0, SMTO_NORMAL | SMTO_ABORTIFHUNG,
+                                               ping.timeoutMs, &result) != 0;
+            lock.lock();
+            idlePingers_++;
+            if (answered) {
+                answers_.emplace_back(ping.serial, ping.window);
+                Wake();
+            }
+        }
+    }
+
+    // Answers the ping threads collected
+    void ReadAnswers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            answered_.swap(answers_);
+        }
+        for (const auto& answer : answered_) {
+            Answered(answer.first, answer.second);
+        }
+        answered_.clear();
+    }
+#endif
+
+    void Answered(uint32_t serial, SlaveWindow window) {
+        for (size_t i = 0; i < barriers_.size(); i++) {
+            Barrier& barrier = barriers_[i];
+            if (barrier.serial != serial) {
+                continue;
+            }
+            auto& pending = barrier.pending;
+            auto answered = std::find_if(pending.begin(), pending.end(),
+                                         [window](const auto& entry) { return entry.first == window; });
+            if (answered == pending.end()) {
+                continue;
+            }
+            pending.erase(answered);
+            if (pending.empty()) {
+                Barrier done = std::move(barrier);
+                barriers_.erase(barriers_.begin() + static_cast<std::ptrdiff_t>(i));
+                EndBarrier(done);
+            }
+            return;
+        }
+    }
+
+    // Barriers past their deadline end with stragglers; those of destroyed
+    // sessions are dropped
+    void ExpireBarriers(std::chrono::steady_clock::time_point now) {
+        for (size_t i = 0; i < barriers_.size();) {
+            Barrier& barrier = barriers_[i];
+            bool closed = barrier.session->closed.load(std::memory_order_acquire);
+            if (!closed && now < barrier.deadline) {
+                i++;
+                continue;
+            }
+            Barrier done = std::move(barrier);
+            barriers_.erase(barriers_.begin() + static_cast<std::ptrdiff_t>(i));
+            if (!closed) {
+                EndBarrier(done);
+            }
+        }
+    }
+
+    // Confirm the barrier's event, then send the session's next one
+    void EndBarrier(Barrier& barrier) {
+        Session& session = *barrier.session;
+        auto done = std::chrono::steady_clock::now();
+        double barrierUs = std::chrono::duration<double, std::micro>(done - barrier.started).count();
+        double latencyUs = std::chrono::duration<double, std::micro>(done - barrier.posted).count();
+        Session::Settled settled;
+        bool more = false;
+        {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            SyncSessionStats& stats = session.stats;
+            for (const auto& entry : barrier.pending) {
+                session.missedBarrier[entry.second] = barrier.sequence;
+            }
+            stats.confirmed = barrier.sequence;
+            stats.barriers++;
+            stats.stragglers += barrier.pending.size();
+            session.barrierTotalUs += barrierUs;
+            stats.avgBarrierUs = session.barrierTotalUs / static_cast<double>(stats.barriers);
+            stats.maxBarrierUs = std::max(stats.maxBarrierUs, barrierUs);
+            session.latencyTotalUs += latencyUs;
+            stats.avgLatencyUs = session.latencyTotalUs / static_cast<double>(stats.dispatched);
+            stats.maxLatencyUs = std::max(stats.maxLatencyUs, latencyUs);
+            session.TakeSettled(done, settled);
+            more = !session.queue.empty();
+        }
+        Session::Call(settled);
+        session.parked = false;
+        if (more) {
+            Schedule(barrier.session);
+        }
+    }
+
+    // Waiters whose timeout passed get reached = false
+    void ExpireWaiters(std::chrono::steady_clock::time_point now) {
+        for (size_t i = 0; i < watching_.size();) {
+            Session& session = *watching_[i];
+            Session::Settled settled;
+            bool empty = false;
+            {
+                std::lock_guard<std::mutex> lock(session.mutex);
+                session.TakeSettled(now, settled);
+                empty = session.waiters.empty();
+            }
+            Session::Call(settled);
+            if (empty || session.closed.load(std::memory_order_acquire)) {
+                watching_.erase(watching_.begin() + static_cast<std::ptrdiff_t>(i));
+            } else {
+                i++;
+            }
+        }
+    }
+
+    // Main window bounds of the master and every slave from one enumeration
+    void RefreshBounds(Session& session) {
+        std::vector<int> pids;
+        pids.reserve(session.slavePids.size() + 1);
+        pids.push_back(session.masterPid);
+        pids.insert(pids.end(), session.slavePids.begin(), session.slavePids.end());
+#ifdef __linux__
+        auto windowsByPid = control_.FindWindowsForPids(pids);
+
+        auto mainBounds = [](const std::vector<X11WindowInfo>& windows) {
+            Session::Bounds bounds;
+            for (const auto& win : windows) {
+                if (!win.isExtension && win.width > 0 && win.height > 0) {
+                    bounds = {true, win.x, win.y, win.width, win.height};
+                    break;
+                }
+            }
+            return bounds;
+        };
+
+        session.master = mainBounds(windowsByPid[0]);
+        session.slaves.resize(session.slavePids.size());
+        for (size_t i = 0; i < session.slavePids.size(); i++) {
+            session.slaves[i] = mainBounds(windowsByPid[i + 1]);
+        }
+#else
+        // The topmost main window of each pid (or any process it started)
+        std::vector<Session::Bounds> found(pids.size());
+        std::unordered_map<int, int> owners = ProcessTree::Shared().OwnerMap(pids);
+        std::unordered_map<int, size_t> slots;
+        for (size_t i = 0; i < pids.size(); i++) {
+            slots.emplace(pids[i], i);
+        }
+        HWND hwnd = nullptr;
+        while ((hwnd = FindWindowEx(nullptr, hwnd, nullptr, nullptr)) != nullptr) {
+            DWORD pid = 0;
+            GetWindowThreadProcessId(hwnd, &pid);
+            auto owner = owners.find(static_cast<int>(pid));
+            if (owner == owners.end() || found[slots[owner->second]].valid || !IsWindowVisible(hwnd) ||
+                IsIconic(hwnd)) {
+                continue;
+            }
+            WindowKind kind = core_->ClassifyWindow(
+                reinterpret_cast<uint64_t>(hwnd), pid,
+                [hwnd](WindowTraits& traits) { ReadWin32WindowTraits(hwnd, traits); },
+                [hwnd](std::string& title) { ReadWin32WindowTitle(hwnd, title); });
+            RECT rect;
+            if (kind != WindowKind::Main || !GetWindowRect(hwnd, &rect) || rect.right <= rect.left ||
+                rect.bottom <= rect.top) {
+                continue;
+            }
+            Session::Bounds& bounds = found[slots[owner->second]];
+            bounds.valid = true;
+            bounds.x = rect.left;
+            bounds.y = rect.top;
+            bounds.width = rect.right - rect.left;
+            bounds.height = rect.bottom - rect.top;
+            bounds.window = hwnd;
+        }
+
+        session.master = found[0];
+        session.slaves.assign(found.begin() + 1, found.end());
+#endif
+        session.boundsRead = std::chrono::steady_clock::now();
+    }
+#endif
+
+    const int index_;
+    const std::atomic<uint64_t>& boundsEpoch_;
+#ifdef __linux__
+    // Worker thread only: the connection's atom cache is not thread-safe
+    X11WindowControl control_;
+    uint64_t controlEpoch_ = 0;
+    // Root window events are selected once a lockstep session needs them
+    bool rootEvents_ = false;
+    xcb_atom_t protocolsAtom_ = XCB_NONE;
+    xcb_atom_t pingAtom_ = XCB_NONE;
+    // Written to wake Run() from poll()
+    int wakeFd_ = -1;
+#elif defined(_WIN32)
+    std::shared_ptr<AddonCore> core_;
+    // Set to wake Run() from its wait
+    HANDLE wakeEvent_ = nullptr;
+
+    struct PendingPing {
+        uint32_t serial;
+        HWND window;
+        UINT timeoutMs;
+    };
+    // Guarded by mutex_: pings for the ping threads and the answers they got
+    std::deque<PendingPing> pings_;
+    std::vector<std::pair<uint32_t, HWND>> answers_;
+    std::condition_variable pingReady_;
+    std::vector<std::thread> pingers_;
+    size_t idlePingers_ = 0;
+    // Run() only
+    std::vector<std::pair<uint32_t, HWND>> answered_;
+#endif
+#ifdef SYNC_SESSIONS_BACKEND
+    std::vector<bool> sent_;
+    std::vector<Barrier> barriers_;
+    // Sessions with waiters, for their deadlines
+    std::vector<std::shared_ptr<Session>> watching_;
+#endif
+
+    std::mutex mutex_;
+    std::deque<std::shared_ptr<Session>> ready_;
+    std::vector<std::shared_ptr<Session>> watchRequests_;
+    bool stopping_ = false;
+    std::vector<SyncEvent> batch_;
+    std::thread thread_;
+};
+
+SyncSessionPool::SyncSessionPool(std::shared_ptr<AddonCore> core) : core_(std::move(core)) {}
+
+SyncSessionPool::~SyncSessionPool() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : sessions_) {
+        entry.second->Close();
+    }
+    // Joins every worker before the sessions go
+    workers_.clear();
+    sessions_.clear();
+}
+
+uint64_t SyncSessionPool::Create(int masterPid, const std::vector<int>& slavePids,
+                                 const SyncSessionOptions& options) {
+#ifndef SYNC_SESSIONS_BACKEND
+    (void)masterPid;
+    (void)slavePids;
+    (void)options;
+    return 0;
+#else
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // A new worker for each session until there is one per core, then the
+    // least busy one
+    Worker* target = nullptr;
+    for (auto& worker : workers_) {
+        if (!target || worker->sessions < target->sessions) {
+            target = worker.get();
+        }
+    }
+    if ((!target || target->sessions > 0) && workers_.size() < MaxWorkers()) {
+        auto worker = std::make_unique<Worker>(core_, boundsEpoch_, static_cast<int>(workers_.size()));
+        if (worker->Start()) {
+            target = worker.get();
+            workers_.push_back(std::move(worker));
+        } else {
+            LOG_WARN("Sync session worker could not open the display");
+        }
+    }
+    if (!target) {
+        return 0;
+    }
+
+    auto session = std::make_shared<Session>();
+    session->id = nextId_++;
+    session->masterPid = masterPid;
+    session->slavePids = slavePids;
+    session->options = options;
+    session->options.queueCapacity = std::max<size_t>(1, options.queueCapacity);
+    session->worker = target;
+    session->queue.reserve(session->options.queueCapacity);
+    session->missedBarrier.assign(slavePids.size(), 0);
+    session->stats.worker = target->Index();
+    session->stats.slaves = static_cast<int>(slavePids.size());
+    target->sessions++;
+
+    sessions_.emplace(session->id, session);
+    return session->id;
+#endif
+}
+
+bool SyncSessionPool::Destroy(uint64_t id) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(id);
+        if (it == sessions_.end()) {
+            return false;
+        }
+        session = std::move(it->second);
+        sessions_.erase(it);
+        session->worker->sessions--;
+    }
+    session->Close();
+    // Wait for a batch in flight; nothing is injected for it afterwards
+    std::lock_guard<std::mutex> dispatching(session->dispatching);
+    return true;
+}
+
+bool SyncSessionPool::Post(uint64_t id, const SyncEvent& event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) {
+        return false;
+    }
+    Session& session = *it->second;
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> queueLock(session.mutex);
+        auto& queue = session.queue;
+        session.stats.posted++;
+        if (event.kind == SyncEventKind::Pointer && event.pointer == PointerEvent::Move && !queue.empty() &&
+            queue.back().kind == SyncEventKind::Pointer && queue.back().pointer == PointerEvent::Move) {
+            // Latency still counts from the move that was replaced
+            auto posted = queue.back().posted;
+            queue.back() = event;
+            queue.back().posted = posted;
+            queue.back().sequence = ++session.stats.sequence;
+            session.stats.coalesced++;
+            return true;
+        }
+        if (queue.size() >= session.options.queueCapacity) {
+            session.stats.dropped++;
+            return false;
+        }
+        schedule = queue.empty();
+        queue.push_back(event);
+        queue.back().sequence = ++session.stats.sequence;
+    }
+    if (schedule) {
+        session.worker->Schedule(it->second);
+    }
+    return true;
+}
+
+bool SyncSessionPool::WatchBarrier(uint64_t id, std::chrono::milliseconds timeout, BarrierCallback done) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(id);
+        if (it == sessions_.end()) {
+            return false;
+        }
+        session = it->second;
+    }
+
+    Session::Waiter waiter;
+    waiter.deadline = std::chrono::steady_clock::now() + timeout;
+    waiter.done = std::move(done);
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        waiter.from = session->stats.confirmed;
+        waiter.target = session->stats.sequence;
+        if (!session->closed.load(std::memory_order_acquire) && session->stats.confirmed < waiter.target &&
+            timeout.count() > 0) {
+            session->waiters.push_back(std::move(waiter));
+            waiter.done = nullptr;
+        }
+    }
+    if (waiter.done) {
+        // Nothing to wait for
+        if (session->closed.load(std::memory_order_acquire)) {
+            waiter.done(false, SyncBarrierResult());
+            return true;
+        }
+        SyncBarrierResult result;
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            result = session->BarrierResult(waiter, session->stats.confirmed >= waiter.target);
+        }
+        waiter.done(true, result);
+        return true;
+    }
+    session->worker->Watch(session);
+    return true;
+}
+
+bool SyncSessionPool::Stats(uint64_t id, SyncSessionStats& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> sessionLock(it->second->mutex);
+    stats = it->second->stats;
+    return true;
+}
+
+int SyncSessionPool::Workers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(workers_.size());
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "window-control.h"
+
+class AddonCore;
+
+// Independent groups of synchronized windows, each a master mirrored into
+// its own slaves.
+//
+// Every session has its own event queue and its own cache of window bounds,
+// and is pinned to one thread of a small worker pool (at most one worker per
+// core), so events of a session stay in order while sessions on different
+// workers never wait on each other. Posting an event only touches the
+// session's queue. A worker drains a session's whole queue at once, maps
+// each event from the master window onto every slave window and injects the
+// batch through its own window system connection with a single flush.
+//
+// Consecutive pointer moves still queued are coalesced into the newest one;
+// other events are dropped once a queue is full and counted in the stats.
+//
+// Every accepted event gets the session's next sequence number. A lockstep
+// session releases each event only once every slave has confirmed the one
+// before: after injecting, the worker sends each slave window a
+// _NET_WM_PING and waits for the answers. A client answers from its event
+// loop, so an answer means the injected events ahead of it were handled.
+// Slaves that do not answer within barrierTimeout are counted as
+// stragglers and the next event goes out anyway. While it waits the session
+// is parked: its worker goes on dispatching other sessions and reads the
+// answers in its poll loop.
+//
+// There are X11 and Win32 backends. On Win32 events are posted to each
+// slave's main window, and a barrier sends each slave a WM_NULL with
+// SendMessageTimeout from a separate ping thread, which returns once the
+// slave handled everything posted before it. On macOS Create() returns 0 and
+// callers keep fanning out events themselves.
+struct SyncSessionOptions {
+    // Events a session holds before it starts dropping
+    size_t queueCapacity = 1024;
+    // Window bounds are re-read after this long, or after InvalidateBounds()
+    std::chrono::milliseconds boundsTtl{500};
+    // Confirm every event on every slave before the next one goes out
+    bool lockstep = false;
+    // Wait at most this long for the slaves' answers to a barrier
+    std::chrono::milliseconds barrierTimeout{500};
+};
+
+struct SyncSessionStats {
+    int worker = -1;
+    int slaves = 0;
+    uint64_t posted = 0;
+    uint64_t coalesced = 0;         // moves replaced by a newer move in the queue
+    uint64_t dropped = 0;           // rejected by a full queue
+    uint64_t dispatched = 0;        // events taken off the queue
+    uint64_t injected = 0;          // events delivered to a slave window
+    uint64_t missed = 0;            // events for a slave without a window
+    uint64_t boundsRefreshes = 0;
+    double avgLatencyUs = 0;        // post to injection (or confirmation), per dispatched event
+    double maxLatencyUs = 0;
+    uint64_t sequence = 0;          // of the last accepted event
+    uint64_t confirmed = 0;         // events up to here are through their barrier
+    uint64_t barriers = 0;
+    uint64_t stragglers = 0;        // slaves that missed a barrier's timeout
+    double avgBarrierUs = 0;        // injection to the last slave's answer
+    double maxBarrierUs = 0;
+};
+
+// Outcome of SyncSessionPool::WatchBarrier
+struct SyncBarrierResult {
+    uint64_t sequence = 0;          // confirmed when the wait ended
+    bool reached = false;           // false when the wait timed out
+    // Slaves that missed a barrier of the events waited for
+    std::vector<int> stragglers;
+};
+
+enum class SyncEventKind : uint8_t {
+    Pointer,
+    Wheel,
+    Key,
+};
+
+// x, y are screen coordinates inside the master window. Keys have no
+// position; keyCode is an X keycode on X11 and a virtual-key code on Win32.
+struct SyncEvent {
+    SyncEventKind kind = SyncEventKind::Pointer;
+    PointerEvent pointer = PointerEvent::Move;
+    KeyEvent key = KeyEvent::Down;
+    int keyCode = 0;
+    int x = 0;
+    int y = 0;
+    int deltaX = 0;
+    int deltaY = 0;
+    uint64_t sequence = 0;          // set by Post()
+    std::chrono::steady_clock::time_point posted;
+};
+
+class SyncSessionPool {
+public:
+    explicit SyncSessionPool(std::shared_ptr<AddonCore> core);
+    ~SyncSessionPool();
+
+    SyncSessionPool(const SyncSessionPool&) = delete;
+    SyncSessionPool& operator=(const SyncSessionPool&) = delete;
+
+    // Start a session on the least busy worker. Returns its id, or 0 when
+    // there is no backend or no display.
+    uint64_t Create(int masterPid, const std::vector<int>& slavePids, const SyncSessionOptions& options);
+    // Stop a session; events still queued are discarded. False for an
+    // unknown id.
+    bool Destroy(uint64_t id);
+
+    // Queue an event for the session's worker. False for an unknown id or
+    // when the queue is full.
+    bool Post(uint64_t id, const SyncEvent& event);
+
+    // found is false for a session destroyed while waiting
+    using BarrierCallback = std::function<void(bool found, const SyncBarrierResult& result)>;
+
+    // Call done once every event posted so far has been confirmed (injected,
+    // for a session that is not lockstep), or after timeout. It runs on the
+    // session's worker, or on the calling thread when nothing is pending or
+    // the session goes away. False, and done is never called, for an unknown
+    // id.
+    bool WatchBarrier(uint64_t id, std::chrono::milliseconds timeout, BarrierCallback done);
+
+    bool Stats(uint64_t id, SyncSessionStats& stats);
+    // Threads started so far
+    int Workers();
+
+    // Windows were moved or resized: every session re-reads its bounds
+    // before the next event
+    void InvalidateBounds() { boundsEpoch_.fetch_add(1, std::memory_order_release); }
+
+    // Defined in sync-sessions.cpp
+    struct Session;
+    class Worker;
+
+private:
+    std::shared_ptr<AddonCore> core_;
+    std::atomic<uint64_t> boundsEpoch_{0};
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unordered_map<uint64_t, std::shared_ptr<Session>> sessions_;
+    uint64_t nextId_ = 1;
+};
@@ -0,0 +1,175 @@
+#include "templated-text.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// Decodes the code point starting at data[0]. Returns its length in bytes,
+// or 0 for an invalid sequence (truncated, overlong, a surrogate or past
+// U+10FFFF).
+size_t DecodeUtf8(const uint8_t* data, size_t size, char32_t& codepoint) {
+    uint8_t lead = data[0];
+    size_t length;
+    char32_t minimum;
+    if (lead < 0x80) {
+        codepoint = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        minimum = 0x80;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        minimum = 0x800;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        minimum = 0x10000;
+        codepoint = lead & 0x07;
+    } else {
+        return 0;
+    }
+    if (size < length) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; i++) {
+        if ((data[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        codepoint = (codepoint << 6) | (data[i] & 0x3F);
+    }
+    if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+}  // namespace
+
+bool SplitTextColumn(const uint8_t* data, size_t size, const uint32_t* offsets, size_t count,
+                     std::vector<std::u32string>& texts, std::string& error) {
+    texts.assign(count, std::u32string());
+    for (size_t i = 0; i < count; i++) {
+        uint32_t begin = offsets[i];
+        uint32_t end = offsets[i + 1];
+        if (end < begin || end > size) {
+            error = "Offsets " + std::to_string(i) + " and " + std::to_string(i + 1) +
+                    " are out of order or past the end of the buffer";
+            return false;
+        }
+
+        std::u32string& text = texts[i];
+        text.reserve(std::min<size_t>(end - begin, kMaxTemplatedTextLength));
+        for (size_t at = begin; at < end;) {
+            char32_t codepoint;
+            size_t length = DecodeUtf8(data + at, end - at, codepoint);
+            if (length == 0) {
+                error = "String " + std::to_string(i) + " is not valid UTF-8 at byte " + std::to_string(at);
+                return false;
+            }
+            if (text.size() == kMaxTemplatedTextLength) {
+                error = "String " + std::to_string(i) + " is longer than " +
+                        std::to_string(kMaxTemplatedTextLength) + " characters";
+                return false;
+            }
+            text.push_back(codepoint);
+            at += length;
+        }
+    }
+    return true;
+}
+
+int ToUtf16(char32_t codepoint, char16_t (&units)[2]) {
+    if (codepoint < 0x10000) {
+        units[0] = static_cast<char16_t>(codepoint);
+        return 1;
+    }
+    codepoint -= 0x10000;
+    units[0] = static_cast<char16_t>(0xD800 + (codepoint >> 10));
+    units[1] = static_cast<char16_t>(0xDC00 + (codepoint & 0x3FF));
+    return 2;
+}
+
+std::vector<int> TypeInterleaved(const std::vector<std::u32string>& texts, std::chrono::microseconds interval,
+                                 const std::function<bool(size_t, char32_t)>& type) {
+    std::vector<int> typed(texts.size(), 0);
+    std::vector<bool> stopped(texts.size(), false);
+    size_t rounds = 0;
+    for (const std::u32string& text : texts) {
+        rounds = std::max(rounds, text.size());
+    }
+
+    for (size_t round = 0; round < rounds; round++) {
+        bool any = false;
+        for (size_t i = 0; i < texts.size(); i++) {
+            if (stopped[i] || round >= texts[i].size()) {
+                continue;
+            }
+            if (type(i, texts[i][round])) {
+                typed[i]++;
+                any = true;
+            } else {
+                stopped[i] = true;
+            }
+        }
+        if (!any) {
+            break;
+        }
+        if (interval.count() > 0 && round + 1 < rounds) {
+            std::this_thread::sleep_for(interval);
+        }
+    }
+    return typed;
+}
+
+TextTyper::~TextTyper() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (Job& job : jobs_) {
+        job.done(std::vector<int>(job.texts.size(), 0), 0);
+    }
+}
+
+void TextTyper::Post(Job job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+    if (!thread_.joinable()) {
+        thread_ = std::thread([this] { Run(); });
+    }
+    wake_.notify_one();
+}
+
+void TextTyper::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+
+        auto started = std::chrono::steady_clock::now();
+        if (job.begin) {
+            job.begin(job.texts);
+        }
+        std::vector<int> typed = TypeInterleaved(job.texts, job.interval, [this, &job](size_t i, char32_t codepoint) {
+            return !stopping_ && job.type(i, codepoint);
+        });
+        if (job.end) {
+            job.end();
+        }
+        job.done(std::move(typed),
+                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+
+        lock.lock();
+    }
+}
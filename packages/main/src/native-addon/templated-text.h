@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Different text for every slave, as taken by broadcastTemplatedText.
+//
+// The strings arrive as one column: a single UTF-8 buffer and count + 1
+// offsets into it, so string i is bytes [offsets[i], offsets[i + 1]). A
+// thousand slaves cost one buffer and one offset array instead of a
+// thousand JS strings.
+
+// Upper bound on the characters typed into one slave per call
+constexpr size_t kMaxTemplatedTextLength = 65536;
+
+// Split the column into one sequence of code points per string. False with
+// error set when the offsets are out of order or past the end of data, a
+// string is too long, or a string is not valid UTF-8.
+bool SplitTextColumn(const uint8_t* data, size_t size, const uint32_t* offsets, size_t count,
+                     std::vector<std::u32string>& texts, std::string& error);
+
+// UTF-16 code units of codepoint, 1 or 2 (a surrogate pair)
+int ToUtf16(char32_t codepoint, char16_t (&units)[2]);
+
+// Type every string at once: each round hands the next character of every
+// string that has one to type(index, codepoint), then waits interval. A
+// string stops at the first character type() refuses. Returns the
+// characters typed per string.
+std::vector<int> TypeInterleaved(const std::vector<std::u32string>& texts, std::chrono::microseconds interval,
+                                 const std::function<bool(size_t, char32_t)>& type);
+
+// Runs typing jobs one after another on a thread of its own, so the delays
+// between characters never hold a libuv pool thread. Every hook of a job
+// runs on that thread.
+class TextTyper {
+public:
+    struct Job {
+        std::vector<std::u32string> texts;
+        std::chrono::microseconds interval{0};
+        // Before the first and after the last character, optional
+        std::function<void(const std::vector<std::u32string>&)> begin;
+        std::function<void()> end;
+        // As for TypeInterleaved
+        std::function<bool(size_t, char32_t)> type;
+        // The characters typed per string and how long it took
+        std::function<void(std::vector<int>, double)> done;
+    };
+
+    TextTyper() = default;
+    // Stops the running job after its current round; jobs not started are
+    // done with nothing typed
+    ~TextTyper();
+
+    TextTyper(const TextTyper&) = delete;
+    TextTyper& operator=(const TextTyper&) = delete;
+
+    void Post(Job job);
+
+private:
+    void Run();
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Job> jobs_;
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
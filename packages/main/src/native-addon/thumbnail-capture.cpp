@@ -0,0 +1,879 @@
+#include "thumbnail-capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#include "addon-common.h"
+#include "image-ops.h"
+#include "process-tree.h"
+#include "window-classifier.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#ifndef PW_RENDERFULLCONTENT
+#define PW_RENDERFULLCONTENT 0x00000002
+#endif
+#elif __APPLE__
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreGraphics/CoreGraphics.h>
+#elif __linux__
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xcb/composite.h>
+#include <xcb/damage.h>
+#include <xcb/shm.h>
+#include "x11-connection.h"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Windows are re-resolved this often so restarted or re-created windows are picked up
+constexpr auto kRebindInterval = std::chrono::seconds(2);
+
+enum class CaptureResult {
+    Captured,
+    Missing,
+    Failed,
+};
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// ThumbnailPool
+
+size_t ThumbnailPool::SlotSizeFor(int width, int height) {
+    size_t size = sizeof(ThumbnailSlotHeader) + static_cast<size_t>(width) * height * 4;
+    return (size + 63) & ~static_cast<size_t>(63);
+}
+
+ThumbnailPool::ThumbnailPool(uint8_t* data, size_t slotCount, int width, int height)
+    : data_(data),
+      slotCount_(slotCount),
+      slotSize_(SlotSizeFor(width, height)),
+      width_(width),
+      height_(height) {
+    memset(data_, 0, slotCount_ * slotSize_);
+}
+
+ThumbnailSlotHeader* ThumbnailPool::Header(size_t slot) {
+    return reinterpret_cast<ThumbnailSlotHeader*>(data_ + slot * slotSize_);
+}
+
+uint8_t* ThumbnailPool::Pixels(size_t slot) {
+    return data_ + slot * slotSize_ + sizeof(ThumbnailSlotHeader);
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "sequence is read as a plain uint32 from JS");
+
+void ThumbnailPool::BeginWrite(size_t slot) {
+    auto* sequence = reinterpret_cast<std::atomic<uint32_t>*>(&Header(slot)->sequence);
+    sequence->store(sequence->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void ThumbnailPool::EndWrite(size_t slot) {
+    auto* sequence = reinterpret_cast<std::atomic<uint32_t>*>(&Header(slot)->sequence);
+    sequence->store(sequence->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+// Platform backends
+//
+// Backend::Bind resolves the main window of every pid, CollectDamage marks the
+// slots whose content changed since their last capture, and Capture downscales
+// one window into its slot.
+
+#ifdef __linux__
+
+// XComposite keeps an off-screen copy of every window (so occluded windows can
+// be captured), XDamage reports which windows changed and MIT-SHM moves the
+// pixels without going through the X socket. Each piece degrades gracefully
+// when the server lacks the extension.
+class ThumbnailCapture::Backend {
+public:
+    explicit Backend(ThumbnailPool& pool) : pool_(pool) {}
+
+    ~Backend() {
+        for (auto& target : targets_) {
+            Release(target);
+        }
+        ReleaseShm();
+        if (x11_.IsOpen()) {
+            xcb_flush(x11_.Get());
+        }
+    }
+
+    bool Initialize() {
+        if (!x11_.IsOpen()) {
+            return false;
+        }
+        xcb_connection_t* c = x11_.Get();
+
+        xcb_prefetch_extension_data(c, &xcb_composite_id);
+        xcb_prefetch_extension_data(c, &xcb_damage_id);
+        xcb_prefetch_extension_data(c, &xcb_shm_id);
+
+        const xcb_query_extension_reply_t* ext = xcb_get_extension_data(c, &xcb_composite_id);
+        if (ext && ext->present) {
+            auto* version = xcb_composite_query_version_reply(c, xcb_composite_query_version(c, 0, 4), nullptr);
+            // NameWindowPixmap needs Composite 0.2
+            composite_ = version && (version->major_version > 0 || version->minor_version >= 2);
+            free(version);
+        }
+
+        ext = xcb_get_extension_data(c, &xcb_damage_id);
+        if (ext && ext->present) {
+            auto* version = xcb_damage_query_version_reply(c, xcb_damage_query_version(c, 1, 1), nullptr);
+            damage_ = version != nullptr;
+            damageEventBase_ = ext->first_event;
+            free(version);
+        }
+
+        ext = xcb_get_extension_data(c, &xcb_shm_id);
+        if (ext && ext->present) {
+            auto* version = xcb_shm_query_version_reply(c, xcb_shm_query_version(c), nullptr);
+            shm_ = version != nullptr;
+            free(version);
+        }
+
+        if (!composite_) {
+            LOG_ERROR("XComposite unavailable, occluded windows will capture what is on screen");
+        }
+        return true;
+    }
+
+    bool TracksDamage() const { return damage_; }
+
+    void Bind(const std::vector<int>& pids) {
+        for (size_t i = pids.size(); i < targets_.size(); i++) {
+            Release(targets_[i]);
+        }
+        targets_.resize(pids.size());
+
+        // Windows owned by any descendant count for the launcher pid
+        std::unordered_map<int, int> owners = ProcessTree::Shared().OwnerMap(pids);
+        std::vector<xcb_window_t> clients = x11_.ClientWindows();
+        std::vector<int> clientPids = x11_.WindowPids(clients);
+
+        std::vector<xcb_window_t> candidates;
+        std::vector<int> candidatePids;
+        for (size_t i = 0; i < clients.size(); i++) {
+            auto owner = owners.find(clientPids[i]);
+            if (owner != owners.end()) {
+                candidates.push_back(clients[i]);
+                candidatePids.push_back(owner->second);
+            }
+        }
+
+        // Pipeline attribute and geometry requests for every candidate, then
+        // keep the largest viewable window of each pid as its main window
+        xcb_connection_t* c = x11_.Get();
+        std::vector<xcb_get_window_attributes_cookie_t> attributeCookies;
+        std::vector<xcb_get_geometry_cookie_t> geometryCookies;
+        for (xcb_window_t window : candidates) {
+            attributeCookies.push_back(xcb_get_window_attributes(c, window));
+            geometryCookies.push_back(xcb_get_geometry(c, window));
+        }
+
+        std::unordered_map<int, std::pair<xcb_window_t, int>> best;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            auto* attributes = xcb_get_window_attributes_reply(c, attributeCookies[i], nullptr);
+            auto* geometry = xcb_get_geometry_reply(c, geometryCookies[i], nullptr);
+            if (attributes && geometry && attributes->map_state == XCB_MAP_STATE_VIEWABLE &&
+                !attributes->override_redirect && IsCapturable(candidates[i], candidatePids[i])) {
+                int area = geometry->width * geometry->height;
+                auto& entry = best[candidatePids[i]];
+                if (area > entry.second) {
+                    entry = {candidates[i], area};
+                }
+            }
+            free(attributes);
+            free(geometry);
+        }
+
+        for (size_t slot = 0; slot < pids.size(); slot++) {
+            Target& target = targets_[slot];
+            auto found = best.find(pids[slot]);
+            xcb_window_t window = found != best.end() ? found->second.first : XCB_NONE;
+            target.pid = pids[slot];
+            if (target.window == window) {
+                continue;
+            }
+            Release(target);
+            target.window = window;
+            Track(target, slot);
+        }
+        xcb_flush(c);
+    }
+
+    void CollectDamage(std::vector<uint8_t>& dirty) {
+        dirty.assign(targets_.size(), 0);
+        xcb_generic_event_t* event;
+        while ((event = xcb_poll_for_event(x11_.Get())) != nullptr) {
+            // Errors from asynchronous requests on vanished windows arrive here and are dropped
+            if (damage_ && (event->response_type & 0x7f) == damageEventBase_ + XCB_DAMAGE_NOTIFY) {
+                auto* notify = reinterpret_cast<xcb_damage_notify_event_t*>(event);
+                auto slot = damageToSlot_.find(notify->damage);
+                if (slot != damageToSlot_.end() && slot->second < targets_.size()) {
+                    targets_[slot->second].dirty = true;
+                }
+            }
+            free(event);
+        }
+
+        for (size_t i = 0; i < targets_.size(); i++) {
+            dirty[i] = !damage_ || targets_[i].dirty;
+        }
+    }
+
+    CaptureResult Capture(size_t slot, uint32_t& sourceWidth, uint32_t& sourceHeight) {
+        Target& target = targets_[slot];
+        if (target.window == XCB_NONE) {
+            return CaptureResult::Missing;
+        }
+        xcb_connection_t* c = x11_.Get();
+
+        auto* geometry = xcb_get_geometry_reply(c, xcb_get_geometry(c, target.window), nullptr);
+        if (!geometry) {
+            Release(target);
+            return CaptureResult::Missing;
+        }
+        int width = geometry->width;
+        int height = geometry->height;
+        free(geometry);
+
+        xcb_drawable_t drawable = target.window;
+        if (composite_) {
+            if (target.pixmap == XCB_NONE || width != target.width || height != target.height) {
+                if (target.pixmap != XCB_NONE) {
+                    xcb_free_pixmap(c, target.pixmap);
+                }
+                target.pixmap = xcb_generate_id(c);
+                xcb_composite_name_window_pixmap(c, target.window, target.pixmap);
+            }
+            drawable = target.pixmap;
+        }
+        target.width = width;
+        target.height = height;
+
+        // Subtract before reading so damage that lands during the read marks the slot again
+        if (target.damage) {
+            xcb_damage_subtract(c, target.damage, XCB_NONE, XCB_NONE);
+        }
+        target.dirty = false;
+
+        const uint8_t* pixels = nullptr;
+        uint8_t depth = 0;
+        xcb_get_image_reply_t* image = nullptr;
+        size_t bytes = static_cast<size_t>(width) * height * 4;
+
+        if (shm_ && EnsureShm(bytes)) {
+            auto* reply = xcb_shm_get_image_reply(
+                c,
+                xcb_shm_get_image(c, drawable, 0, 0, width, height, ~0u, XCB_IMAGE_FORMAT_Z_PIXMAP, shmSeg_, 0),
+                nullptr);
+            if (reply) {
+                depth = reply->depth;
+                pixels = shmData_;
+                free(reply);
+            }
+        } else {
+            image = xcb_get_image_reply(
+                c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable, 0, 0, width, height, ~0u), nullptr);
+            if (image && static_cast<size_t>(xcb_get_image_data_length(image)) >= bytes) {
+                depth = image->depth;
+                pixels = xcb_get_image_data(image);
+            }
+        }
+
+        CaptureResult result = CaptureResult::Failed;
+        // 24 and 32 bit visuals both use 32 bits per pixel in ZPixmap format
+        if (pixels && (depth == 24 || depth == 32)) {
+            DownscaleBGRA(pixels, width, height, width * 4,
+                          pool_.Pixels(slot), pool_.Width(), pool_.Height(), pool_.Width() * 4,
+                          depth != 32);
+            sourceWidth = static_cast<uint32_t>(width);
+            sourceHeight = static_cast<uint32_t>(height);
+            result = CaptureResult::Captured;
+        }
+        free(image);
+        return result;
+    }
+
+private:
+    struct Target {
+        int pid = 0;
+        xcb_window_t window = XCB_NONE;
+        xcb_damage_damage_t damage = 0;
+        xcb_pixmap_t pixmap = XCB_NONE;
+        int width = 0;
+        int height = 0;
+        bool dirty = true;
+    };
+
+    void Track(Target& target, size_t slot) {
+        target.dirty = true;
+        if (target.window == XCB_NONE) {
+            return;
+        }
+        xcb_connection_t* c = x11_.Get();
+        if (composite_) {
+            xcb_composite_redirect_window(c, target.window, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+        }
+        if (damage_) {
+            target.damage = xcb_generate_id(c);
+            xcb_damage_create(c, target.damage, target.window, XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+            damageToSlot_[target.damage] = slot;
+        }
+    }
+
+    void Release(Target& target) {
+        xcb_connection_t* c = x11_.Get();
+        if (target.damage) {
+            xcb_damage_destroy(c, target.damage);
+            damageToSlot_.erase(target.damage);
+            target.damage = 0;
+        }
+        if (target.pixmap != XCB_NONE) {
+            xcb_free_pixmap(c, target.pixmap);
+            target.pixmap = XCB_NONE;
+        }
+        if (composite_ && target.window != XCB_NONE) {
+            xcb_composite_unredirect_window(c, target.window, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+        }
+        target.window = XCB_NONE;
+        target.width = 0;
+        target.height = 0;
+    }
+
+    // One segment is shared by every capture and grown on demand
+    bool EnsureShm(size_t bytes) {
+        if (shmData_ && bytes <= shmSize_) {
+            return true;
+        }
+        ReleaseShm();
+
+        size_t size = (bytes + (4u << 20) - 1) & ~static_cast<size_t>((4u << 20) - 1);
+        int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+        if (id < 0) {
+            LOG_ERROR("shmget failed for thumbnail capture");
+            shm_ = false;
+            return false;
+        }
+        void* data = shmat(id, nullptr, 0);
+        if (data == reinterpret_cast<void*>(-1)) {
+            shmctl(id, IPC_RMID, nullptr);
+            shm_ = false;
+            return false;
+        }
+
+        xcb_connection_t* c = x11_.Get();
+        xcb_shm_seg_t seg = xcb_generate_id(c);
+        xcb_generic_error_t* error = xcb_request_check(c, xcb_shm_attach_checked(c, seg, id, 0));
+        // The segment is freed once both sides detach
+        shmctl(id, IPC_RMID, nullptr);
+        if (error) {
+            free(error);
+            shmdt(data);
+            LOG_ERROR("X server refused the MIT-SHM segment, falling back to GetImage");
+            shm_ = false;
+            return false;
+        }
+
+        shmSeg_ = seg;
+        shmData_ = static_cast<uint8_t*>(data);
+        shmSize_ = size;
+        return true;
+    }
+
+    void ReleaseShm() {
+        if (!shmData_) {
+            return;
+        }
+        xcb_shm_detach(x11_.Get(), shmSeg_);
+        shmdt(shmData_);
+        shmData_ = nullptr;
+        shmSize_ = 0;
+    }
+
+    // DevTools and popups can be larger than the browser window, never pick them
+    bool IsCapturable(xcb_window_t window, int pid) {
+        WindowKind kind = kinds_.Lookup(
+            window, static_cast<uint64_t>(pid),
+            [this, window](WindowTraits& traits) {
+                x11_.WindowClass(window, traits.instance, traits.className, traits.role);
+                traits.flags = kWindowFramed;
+            },
+            [this, window](std::string& title) { title = x11_.WindowTitle(window); });
+        return kind != WindowKind::DevTools && kind != WindowKind::Popup;
+    }
+
+    ThumbnailPool& pool_;
+    X11Connection x11_;
+    WindowClassCache kinds_;
+    bool composite_ = false;
+    bool damage_ = false;
+    bool shm_ = false;
+    uint8_t damageEventBase_ = 0;
+    std::vector<Target> targets_;
+    std::unordered_map<xcb_damage_damage_t, size_t> damageToSlot_;
+
+    xcb_shm_seg_t shmSeg_ = 0;
+    uint8_t* shmData_ = nullptr;
+    size_t shmSize_ = 0;
+};
+
+#elif _WIN32
+
+// PrintWindow with PW_RENDERFULLCONTENT renders Chrome's GPU surface even when
+// the window is covered. Windows has no damage notification for foreign
+// windows, so every bound window is captured each cycle.
+class ThumbnailCapture::Backend {
+public:
+    explicit Backend(ThumbnailPool& pool) : pool_(pool) {}
+
+    ~Backend() {
+        ReleaseSurface();
+        if (memDC_) {
+            DeleteDC(memDC_);
+        }
+    }
+
+    bool Initialize() {
+        memDC_ = CreateCompatibleDC(nullptr);
+        return memDC_ != nullptr;
+    }
+
+    bool TracksDamage() const { return false; }
+
+    void Bind(const std::vector<int>& pids) {
+        struct Search {
+            std::unordered_map<int, int> owners;
+            std::unordered_map<DWORD, std::pair<HWND, LONG>> best;
+            WindowClassCache* kinds;
+        } search;
+        search.kinds = &kinds_;
+        search.owners = ProcessTree::Shared().OwnerMap(pids);
+        for (int pid : pids) {
+            search.best[static_cast<DWORD>(pid)] = {nullptr, 0};
+        }
+
+        EnumWindows([](HWND hwnd, LPARAM lParam) -> BOOL {
+            auto& search = *reinterpret_cast<Search*>(lParam);
+            DWORD pid = 0;
+            GetWindowThreadProcessId(hwnd, &pid);
+            auto owner = search.owners.find(static_cast<int>(pid));
+            if (owner == search.owners.end()) {
+                return TRUE;
+            }
+            auto entry = search.best.find(static_cast<DWORD>(owner->second));
+            if (entry == search.best.end() || !IsWindowVisible(hwnd)) {
+                return TRUE;
+            }
+            // DevTools and popups can be larger than the browser window, never pick them
+            WindowKind kind = search.kinds->Lookup(
+                reinterpret_cast<uint64_t>(hwnd), pid,
+                [hwnd](WindowTraits& traits) { ReadWin32WindowTraits(hwnd, traits); },
+                [hwnd](std::string& title) { ReadWin32WindowTitle(hwnd, title); });
+            if (kind != WindowKind::Main && kind != WindowKind::Extension) {
+                return TRUE;
+            }
+            RECT rect;
+            GetWindowRect(hwnd, &rect);
+            LONG area = (rect.right - rect.left) * (rect.bottom - rect.top);
+            if (area > entry->second.second) {
+                entry->second = {hwnd, area};
+            }
+            return TRUE;
+        }, reinterpret_cast<LPARAM>(&search));
+
+        windows_.resize(pids.size());
+        for (size_t i = 0; i < pids.size(); i++) {
+            windows_[i] = search.best[static_cast<DWORD>(pids[i])].first;
+        }
+    }
+
+    void CollectDamage(std::vector<uint8_t>& dirty) {
+        dirty.assign(windows_.size(), 1);
+    }
+
+    CaptureResult Capture(size_t slot, uint32_t& sourceWidth, uint32_t& sourceHeight) {
+        HWND hwnd = windows_[slot];
+        if (!hwnd || !IsWindow(hwnd) || IsIconic(hwnd)) {
+            return CaptureResult::Missing;
+        }
+
+        RECT rect;
+        if (!GetWindowRect(hwnd, &rect)) {
+            return CaptureResult::Missing;
+        }
+        int width = rect.right - rect.left;
+        int height = rect.bottom - rect.top;
+        if (width <= 0 || height <= 0 || !EnsureSurface(width, height)) {
+            return CaptureResult::Failed;
+        }
+
+        if (!PrintWindow(hwnd, memDC_, PW_RENDERFULLCONTENT)) {
+            return CaptureResult::Failed;
+        }
+        GdiFlush();
+
+        DownscaleBGRA(static_cast<const uint8_t*>(bits_), width, height, surfaceWidth_ * 4,
+                      pool_.Pixels(slot), pool_.Width(), pool_.Height(), pool_.Width() * 4);
+        sourceWidth = static_cast<uint32_t>(width);
+        sourceHeight = static_cast<uint32_t>(height);
+        return CaptureResult::Captured;
+    }
+
+private:
+    // The DIB section only grows, so steady-state capture does not allocate
+    bool EnsureSurface(int width, int height) {
+        if (bitmap_ && width <= surfaceWidth_ && height <= surfaceHeight_) {
+            return true;
+        }
+        ReleaseSurface();
+
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = std::max(width, surfaceWidth_);
+        bmi.bmiHeader.biHeight = -std::max(height, surfaceHeight_);  // top-down rows
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        bitmap_ = CreateDIBSection(memDC_, &bmi, DIB_RGB_COLORS, &bits_, nullptr, 0);
+        if (!bitmap_) {
+            LOG_ERROR("Failed to create capture surface (LastError: " << GetLastError() << ")");
+            return false;
+        }
+        surfaceWidth_ = bmi.bmiHeader.biWidth;
+        surfaceHeight_ = -bmi.bmiHeader.biHeight;
+        previousBitmap_ = SelectObject(memDC_, bitmap_);
+        return true;
+    }
+
+    void ReleaseSurface() {
+        if (!bitmap_) {
+            return;
+        }
+        SelectObject(memDC_, previousBitmap_);
+        DeleteObject(bitmap_);
+        bitmap_ = nullptr;
+        bits_ = nullptr;
+        surfaceWidth_ = 0;
+        surfaceHeight_ = 0;
+    }
+
+    ThumbnailPool& pool_;
+    std::vector<HWND> windows_;
+    WindowClassCache kinds_;
+    HDC memDC_ = nullptr;
+    HBITMAP bitmap_ = nullptr;
+    HGDIOBJ previousBitmap_ = nullptr;
+    void* bits_ = nullptr;
+    int surfaceWidth_ = 0;
+    int surfaceHeight_ = 0;
+};
+
+#elif __APPLE__
+
+// CGWindowListCreateImage returns the window's backing store; CoreGraphics
+// scales it directly into the slot through a bitmap context over pool memory.
+class ThumbnailCapture::Backend {
+public:
+    explicit Backend(ThumbnailPool& pool) : pool_(pool) {}
+
+    ~Backend() {
+        for (CGContextRef context : contexts_) {
+            if (context) {
+                CGContextRelease(context);
+            }
+        }
+        if (colorSpace_) {
+            CGColorSpaceRelease(colorSpace_);
+        }
+    }
+
+    bool Initialize() {
+        colorSpace_ = CGColorSpaceCreateDeviceRGB();
+        contexts_.assign(pool_.SlotCount(), nullptr);
+        return colorSpace_ != nullptr;
+    }
+
+    bool TracksDamage() const { return false; }
+
+    void Bind(const std::vector<int>& pids) {
+        std::unordered_map<int, int> owners = ProcessTree::Shared().OwnerMap(pids);
+        std::unordered_map<int, std::pair<CGWindowID, double>> best;
+        for (int pid : pids) {
+            best[pid] = {kCGNullWindowID, 0};
+        }
+
+        CFArrayRef list = CGWindowListCopyWindowInfo(
+            kCGWindowListOptionAll | kCGWindowListExcludeDesktopElements, kCGNullWindowID);
+        if (list) {
+            CFIndex count = CFArrayGetCount(list);
+            for (CFIndex i = 0; i < count; i++) {
+                auto info = static_cast<CFDictionaryRef>(CFArrayGetValueAtIndex(list, i));
+                int pid = 0;
+                int layer = -1;
+                CGWindowID number = kCGNullWindowID;
+                CGRect bounds = CGRectZero;
+
+                auto pidRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowOwnerPID));
+                auto layerRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowLayer));
+                auto numberRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowNumber));
+                auto boundsRef = static_cast<CFDictionaryRef>(CFDictionaryGetValue(info, kCGWindowBounds));
+                if (!pidRef || !layerRef || !numberRef || !boundsRef) {
+                    continue;
+                }
+                CFNumberGetValue(pidRef, kCFNumberIntType, &pid);
+                CFNumberGetValue(layerRef, kCFNumberIntType, &layer);
+                CFNumberGetValue(numberRef, kCFNumberSInt32Type, &number);
+                CGRectMakeWithDictionaryRepresentation(boundsRef, &bounds);
+
+                auto owner = owners.find(pid);
+                if (owner == owners.end()) {
+                    continue;
+                }
+                auto entry = best.find(owner->second);
+                double area = bounds.size.width * bounds.size.height;
+                if (entry != best.end() && layer == 0 && area > entry->second.second) {
+                    entry->second = {number, area};
+                }
+            }
+            CFRelease(list);
+        }
+
+        windows_.resize(pids.size());
+        for (size_t i = 0; i < pids.size(); i++) {
+            windows_[i] = best[pids[i]].first;
+        }
+    }
+
+    void CollectDamage(std::vector<uint8_t>& dirty) {
+        dirty.assign(windows_.size(), 1);
+    }
+
+    CaptureResult Capture(size_t slot, uint32_t& sourceWidth, uint32_t& sourceHeight) {
+        if (windows_[slot] == kCGNullWindowID) {
+            return CaptureResult::Missing;
+        }
+
+        CGImageRef image = CGWindowListCreateImage(
+            CGRectNull, kCGWindowListOptionIncludingWindow, windows_[slot],
+            kCGWindowImageBoundsIgnoreFraming | kCGWindowImageNominalResolution);
+        if (!image) {
+            return CaptureResult::Missing;
+        }
+
+        if (!contexts_[slot]) {
+            contexts_[slot] = CGBitmapContextCreate(
+                pool_.Pixels(slot), pool_.Width(), pool_.Height(), 8, pool_.Width() * 4, colorSpace_,
+                kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+            if (contexts_[slot]) {
+                CGContextSetInterpolationQuality(contexts_[slot], kCGInterpolationLow);
+            }
+        }
+
+        CaptureResult result = CaptureResult::Failed;
+        if (contexts_[slot]) {
+            CGContextDrawImage(contexts_[slot], CGRectMake(0, 0, pool_.Width(), pool_.Height()), image);
+            sourceWidth = static_cast<uint32_t>(CGImageGetWidth(image));
+            sourceHeight = static_cast<uint32_t>(CGImageGetHeight(image));
+            result = CaptureResult::Captured;
+        }
+        CGImageRelease(image);
+        return result;
+    }
+
+private:
+    ThumbnailPool& pool_;
+    std::vector<CGWindowID> windows_;
+    std::vector<CGContextRef> contexts_;
+    CGColorSpaceRef colorSpace_ = nullptr;
+};
+
+#else
+
+class ThumbnailCapture::Backend {
+public:
+    explicit Backend(ThumbnailPool&) {}
+    bool Initialize() { return false; }
+    bool TracksDamage() const { return false; }
+    void Bind(const std::vector<int>&) {}
+    void CollectDamage(std::vector<uint8_t>& dirty) { dirty.clear(); }
+    CaptureResult Capture(size_t, uint32_t&, uint32_t&) { return CaptureResult::Failed; }
+};
+
+#endif
+
+// ---------------------------------------------------------------------------
+// ThumbnailCapture
+
+ThumbnailCapture::ThumbnailCapture(const ThumbnailOptions& options, uint8_t* poolData, size_t slotCount)
+    : options_(options),
+      pool_(poolData, slotCount, options.width, options.height) {}
+
+ThumbnailCapture::~ThumbnailCapture() {
+    Stop();
+}
+
+void ThumbnailCapture::SetTargets(const std::vector<int>& pids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    targets_.assign(pids.begin(), pids.begin() + std::min(pids.size(), pool_.SlotCount()));
+    targetGeneration_++;
+    wake_.notify_one();
+}
+
+void ThumbnailCapture::Start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            return;
+        }
+    }
+    // A previous worker may have exited on its own after a failed initialisation
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    worker_ = std::thread(&ThumbnailCapture::Run, this);
+}
+
+void ThumbnailCapture::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        wake_.notify_one();
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void ThumbnailCapture::RequestRefresh() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refreshRequested_ = true;
+    wake_.notify_one();
+}
+
+ThumbnailStats ThumbnailCapture::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ThumbnailCapture::Run() {
+    Backend backend(pool_);
+    if (!backend.Initialize()) {
+        LOG_ERROR("Thumbnail capture is not available on this system");
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.damageTracking = backend.TracksDamage();
+    }
+
+    const auto interval = std::chrono::milliseconds(std::max(options_.intervalMs, 16));
+    const auto maxAge = std::chrono::milliseconds(options_.maxAgeMs);
+
+    std::vector<int> pids;
+    std::vector<uint8_t> dirty;
+    std::vector<Clock::time_point> lastCapture;
+    std::vector<size_t> updated;
+    uint64_t boundGeneration = 0;
+    bool bound = false;
+    auto lastBind = Clock::now();
+
+    while (true) {
+        bool rebind = false;
+        bool forceAll = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                break;
+            }
+            if (!bound || targetGeneration_ != boundGeneration) {
+                pids = targets_;
+                boundGeneration = targetGeneration_;
+                rebind = true;
+            }
+            forceAll = refreshRequested_;
+            refreshRequested_ = false;
+        }
+
+        const auto cycleStart = Clock::now();
+        if (rebind || cycleStart - lastBind >= kRebindInterval) {
+            backend.Bind(pids);
+            lastBind = cycleStart;
+            bound = true;
+            lastCapture.resize(pids.size(), Clock::time_point());
+        }
+
+        backend.CollectDamage(dirty);
+
+        uint64_t captured = 0;
+        uint64_t skipped = 0;
+        uint64_t errors = 0;
+        updated.clear();
+        for (size_t slot = 0; slot < pids.size(); slot++) {
+            bool due = forceAll || rebind || (slot < dirty.size() && dirty[slot]) ||
+                       (options_.maxAgeMs > 0 && cycleStart - lastCapture[slot] >= maxAge);
+            if (!due) {
+                skipped++;
+                continue;
+            }
+
+            uint32_t sourceWidth = 0;
+            uint32_t sourceHeight = 0;
+            pool_.BeginWrite(slot);
+            CaptureResult result = backend.Capture(slot, sourceWidth, sourceHeight);
+
+            ThumbnailSlotHeader* header = pool_.Header(slot);
+            header->pid = static_cast<uint32_t>(pids[slot]);
+            header->width = static_cast<uint32_t>(pool_.Width());
+            header->height = static_cast<uint32_t>(pool_.Height());
+            header->stride = static_cast<uint32_t>(pool_.Width() * 4);
+            if (result == CaptureResult::Captured) {
+                header->flags = kThumbnailValid;
+                header->sourceWidth = sourceWidth;
+                header->sourceHeight = sourceHeight;
+                lastCapture[slot] = cycleStart;
+                updated.push_back(slot);
+                captured++;
+            } else if (result == CaptureResult::Missing) {
+                header->flags = (header->flags & kThumbnailValid) | kThumbnailMissing;
+            } else {
+                errors++;
+            }
+            pool_.EndWrite(slot);
+        }
+
+        if (cycleCallback_) {
+            cycleCallback_(pool_, updated);
+        }
+
+        const double cycleMs =
+            std::chrono::duration<double, std::milli>(Clock::now() - cycleStart).count();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        stats_.cycles++;
+        stats_.framesCaptured += captured;
+        stats_.framesSkipped += skipped;
+        stats_.captureErrors += errors;
+        stats_.lastCycleMs = cycleMs;
+
+        wake_.wait_until(lock, cycleStart + interval, [&] {
+            return !running_ || refreshRequested_ || targetGeneration_ != boundGeneration;
+        });
+    }
+}
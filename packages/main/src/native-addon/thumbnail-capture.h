@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Live thumbnail capture for profile windows.
+//
+// A background thread captures the main window of every target pid and
+// downscales it straight into a fixed pool of slots that lives in a JS
+// SharedArrayBuffer, so frames reach the renderer without copies.
+//
+// Slot layout: a 32 byte ThumbnailSlotHeader followed by width * height BGRA
+// pixels, padded to 64 bytes. Writers bump `sequence` to an odd value before
+// touching the pixels and back to even afterwards; readers retry when the
+// value is odd or changed while they were reading.
+struct ThumbnailSlotHeader {
+    uint32_t sequence;
+    uint32_t pid;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t flags;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+};
+
+static_assert(sizeof(ThumbnailSlotHeader) == 32, "slot header layout is shared with JS");
+
+enum ThumbnailSlotFlags : uint32_t {
+    kThumbnailValid = 1u << 0,      // slot holds at least one captured frame
+    kThumbnailMissing = 1u << 1,    // no window found for the pid
+};
+
+struct ThumbnailOptions {
+    int width = 320;
+    int height = 200;
+    int intervalMs = 500;
+    // Windows that report no damage are re-captured at most this often
+    // (0 disables the periodic refresh)
+    int maxAgeMs = 0;
+};
+
+struct ThumbnailStats {
+    uint64_t cycles = 0;
+    uint64_t framesCaptured = 0;
+    uint64_t framesSkipped = 0;
+    uint64_t captureErrors = 0;
+    double lastCycleMs = 0;
+    bool damageTracking = false;
+};
+
+// View over the slot pool. The memory belongs to a JS SharedArrayBuffer
+// (external buffers are rejected when V8 runs with the memory cage, as in
+// Electron, and an ArrayBuffer could be detached by a transfer), and the
+// caller keeps that buffer referenced while the capture thread is alive.
+class ThumbnailPool {
+public:
+    static size_t SlotSizeFor(int width, int height);
+
+    ThumbnailPool(uint8_t* data, size_t slotCount, int width, int height);
+
+    size_t SlotCount() const { return slotCount_; }
+    size_t SlotSize() const { return slotSize_; }
+    int Width() const { return width_; }
+    int Height() const { return height_; }
+
+    ThumbnailSlotHeader* Header(size_t slot);
+    uint8_t* Pixels(size_t slot);
+
+    void BeginWrite(size_t slot);
+    void EndWrite(size_t slot);
+
+private:
+    uint8_t* data_;
+    size_t slotCount_;
+    size_t slotSize_;
+    int width_;
+    int height_;
+};
+
+class ThumbnailCapture {
+public:
+    // poolData must hold slotCount * ThumbnailPool::SlotSizeFor(width, height) bytes
+    ThumbnailCapture(const ThumbnailOptions& options, uint8_t* poolData, size_t slotCount);
+    ~ThumbnailCapture();
+
+    ThumbnailCapture(const ThumbnailCapture&) = delete;
+    ThumbnailCapture& operator=(const ThumbnailCapture&) = delete;
+
+    const ThumbnailPool& Pool() const { return pool_; }
+
+    // Slot i captures pids[i]; extra pids beyond the pool size are ignored
+    void SetTargets(const std::vector<int>& pids);
+
+    void Start();
+    void Stop();
+
+    // Force every slot to be re-captured on the next cycle
+    void RequestRefresh();
+
+    // Invoked on the capture thread after every cycle with the slots written
+    // in that cycle. Must be set before Start().
+    using CycleCallback = std::function<void(ThumbnailPool& pool, const std::vector<size_t>& updated)>;
+    void SetCycleCallback(CycleCallback callback) { cycleCallback_ = std::move(callback); }
+
+    ThumbnailStats Stats() const;
+
+    // Platform capture backend, defined in thumbnail-capture.cpp
+    class Backend;
+
+private:
+    void Run();
+
+    ThumbnailOptions options_;
+    ThumbnailPool pool_;
+    CycleCallback cycleCallback_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<int> targets_;
+    uint64_t targetGeneration_ = 0;
+    bool refreshRequested_ = false;
+    bool running_ = false;
+    std::thread worker_;
+
+    ThumbnailStats stats_;
+};
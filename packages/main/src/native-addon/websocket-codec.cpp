@@ -0,0 +1,265 @@
+#include "websocket-codec.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <random>
+
+namespace {
+
+const char kHandshakeGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// SHA-1 is only needed to check Sec-WebSocket-Accept
+void Sha1(const std::string& input, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::vector<uint8_t> message(input.begin(), input.end());
+    uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+    message.push_back(0x80);
+    while (message.size() % 64 != 56) {
+        message.push_back(0);
+    }
+    for (int i = 7; i >= 0; i--) {
+        message.push_back(static_cast<uint8_t>(bitLength >> (i * 8)));
+    }
+
+    auto rotl = [](uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); };
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* p = &message[chunk + i * 4];
+            w[i] = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                   (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 4; j++) {
+            digest[i * 4 + j] = static_cast<uint8_t>(h[i] >> (24 - j * 8));
+        }
+    }
+}
+
+std::string Base64(const uint8_t* data, size_t length) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((length + 2) / 3 * 4);
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < length) chunk |= static_cast<uint32_t>(data[i + 1]) << 8;
+        if (i + 2 < length) chunk |= data[i + 2];
+        out.push_back(alphabet[(chunk >> 18) & 63]);
+        out.push_back(alphabet[(chunk >> 12) & 63]);
+        out.push_back(i + 1 < length ? alphabet[(chunk >> 6) & 63] : '=');
+        out.push_back(i + 2 < length ? alphabet[chunk & 63] : '=');
+    }
+    return out;
+}
+
+std::string Trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    size_t end = value.find_last_not_of(" \t");
+    return value.substr(start, end - start + 1);
+}
+
+}  // namespace
+
+bool ParseWebSocketUrl(const std::string& url, WebSocketUrl& out) {
+    const std::string scheme = "ws://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+
+    size_t hostStart = scheme.size();
+    size_t pathStart = url.find('/', hostStart);
+    std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos
+                                                                                 : pathStart - hostStart);
+    out.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+    out.port = 80;
+
+    // [v6]:port, host:port or host
+    size_t colon = authority.rfind(':');
+    size_t bracket = authority.rfind(']');
+    if (colon != std::string::npos && (bracket == std::string::npos || colon > bracket)) {
+        std::string port = authority.substr(colon + 1);
+        if (port.empty() || port.size() > 5 ||
+            !std::all_of(port.begin(), port.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+            return false;
+        }
+        out.port = std::stoi(port);
+        authority.resize(colon);
+    }
+    if (authority.size() >= 2 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    out.host = authority;
+    return !out.host.empty() && out.port > 0 && out.port <= 65535;
+}
+
+std::string MakeWebSocketKey() {
+    std::random_device device;
+    uint8_t nonce[16];
+    for (uint8_t& byte : nonce) {
+        byte = static_cast<uint8_t>(device());
+    }
+    return Base64(nonce, sizeof(nonce));
+}
+
+std::string BuildWebSocketHandshake(const WebSocketUrl& url, const std::string& key) {
+    std::string host = url.host.find(':') != std::string::npos ? "[" + url.host + "]" : url.host;
+    std::string request;
+    request += "GET " + url.path + " HTTP/1.1\r\n";
+    request += "Host: " + host + ":" + std::to_string(url.port) + "\r\n";
+    request += "Upgrade: websocket\r\n";
+    request += "Connection: Upgrade\r\n";
+    request += "Sec-WebSocket-Key: " + key + "\r\n";
+    request += "Sec-WebSocket-Version: 13\r\n\r\n";
+    return request;
+}
+
+HandshakeState ParseWebSocketHandshake(const uint8_t* data, size_t length, const std::string& key,
+                                       size_t& headerLength) {
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* end = std::search(begin, begin + length, "\r\n\r\n", "\r\n\r\n" + 4);
+    if (end == begin + length) {
+        // Responses are tiny; anything this large without a blank line is not one
+        return length > 8192 ? HandshakeState::Rejected : HandshakeState::Incomplete;
+    }
+    headerLength = static_cast<size_t>(end - begin) + 4;
+    std::string headers(begin, end);
+
+    size_t lineEnd = headers.find("\r\n");
+    std::string status = headers.substr(0, lineEnd);
+    if (status.compare(0, 9, "HTTP/1.1 ") != 0 || status.compare(9, 3, "101") != 0) {
+        return HandshakeState::Rejected;
+    }
+
+    uint8_t digest[20];
+    Sha1(key + kHandshakeGuid, digest);
+    std::string expected = Base64(digest, sizeof(digest));
+
+    size_t pos = lineEnd;
+    while (pos != std::string::npos && pos < headers.size()) {
+        size_t start = pos + 2;
+        size_t next = headers.find("\r\n", start);
+        std::string line = headers.substr(start, next == std::string::npos ? std::string::npos : next - start);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (name == "sec-websocket-accept") {
+                return Trim(line.substr(colon + 1)) == expected ? HandshakeState::Accepted
+                                                                : HandshakeState::Rejected;
+            }
+        }
+        pos = next;
+    }
+    return HandshakeState::Rejected;
+}
+
+void AppendWebSocketFrame(std::vector<uint8_t>& out, WebSocketOpcode opcode, const uint8_t* payload,
+                          size_t length, uint32_t mask) {
+    out.push_back(static_cast<uint8_t>(0x80 | static_cast<uint8_t>(opcode)));
+    if (length < 126) {
+        out.push_back(static_cast<uint8_t>(0x80 | length));
+    } else if (length <= 0xFFFF) {
+        out.push_back(0x80 | 126);
+        out.push_back(static_cast<uint8_t>(length >> 8));
+        out.push_back(static_cast<uint8_t>(length));
+    } else {
+        out.push_back(0x80 | 127);
+        for (int i = 7; i >= 0; i--) {
+            out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(length) >> (i * 8)));
+        }
+    }
+
+    uint8_t key[4] = {static_cast<uint8_t>(mask >> 24), static_cast<uint8_t>(mask >> 16),
+                      static_cast<uint8_t>(mask >> 8), static_cast<uint8_t>(mask)};
+    out.insert(out.end(), key, key + 4);
+    size_t start = out.size();
+    out.resize(start + length);
+    for (size_t i = 0; i < length; i++) {
+        out[start + i] = payload[i] ^ key[i & 3];
+    }
+}
+
+FrameResult ReadWebSocketFrame(const uint8_t* data, size_t length, size_t maxPayload, WebSocketFrame& frame) {
+    if (length < 2) {
+        return FrameResult::Incomplete;
+    }
+    if (data[0] & 0x70) {
+        return FrameResult::Error;
+    }
+    if (data[1] & 0x80) {
+        // Servers must not mask
+        return FrameResult::Error;
+    }
+
+    size_t header = 2;
+    uint64_t payloadLength = data[1] & 0x7F;
+    if (payloadLength == 126) {
+        if (length < 4) {
+            return FrameResult::Incomplete;
+        }
+        payloadLength = (static_cast<uint64_t>(data[2]) << 8) | data[3];
+        header = 4;
+    } else if (payloadLength == 127) {
+        if (length < 10) {
+            return FrameResult::Incomplete;
+        }
+        payloadLength = 0;
+        for (int i = 0; i < 8; i++) {
+            payloadLength = (payloadLength << 8) | data[2 + i];
+        }
+        header = 10;
+    }
+    if (payloadLength > maxPayload) {
+        return FrameResult::Error;
+    }
+    if (length - header < payloadLength) {
+        return FrameResult::Incomplete;
+    }
+
+    frame.opcode = static_cast<WebSocketOpcode>(data[0] & 0x0F);
+    frame.final = (data[0] & 0x80) != 0;
+    frame.payload = data + header;
+    frame.length = static_cast<size_t>(payloadLength);
+    frame.frameLength = header + frame.length;
+    return FrameResult::Frame;
+}
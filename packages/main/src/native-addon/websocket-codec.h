@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal RFC 6455 client side codec for talking to Chrome's DevTools
+// endpoints: handshake, masked client frames and unmasked server frames.
+// Extensions and subprotocols are never negotiated.
+
+struct WebSocketUrl {
+    std::string host;
+    int port = 80;
+    std::string path = "/";
+};
+
+// Accepts ws://host[:port][/path]; wss is not supported
+bool ParseWebSocketUrl(const std::string& url, WebSocketUrl& out);
+
+// Random base64 Sec-WebSocket-Key
+std::string MakeWebSocketKey();
+
+std::string BuildWebSocketHandshake(const WebSocketUrl& url, const std::string& key);
+
+enum class HandshakeState {
+    Incomplete,
+    Accepted,
+    Rejected,
+};
+
+// Checks the HTTP response at the start of data. On Accepted, headerLength
+// is the number of bytes taken by the response headers.
+HandshakeState ParseWebSocketHandshake(const uint8_t* data, size_t length, const std::string& key,
+                                       size_t& headerLength);
+
+enum class WebSocketOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+};
+
+// Appends one complete, masked client frame to out
+void AppendWebSocketFrame(std::vector<uint8_t>& out, WebSocketOpcode opcode, const uint8_t* payload,
+                          size_t length, uint32_t mask);
+
+enum class FrameResult {
+    Incomplete,
+    Frame,
+    Error,
+};
+
+struct WebSocketFrame {
+    WebSocketOpcode opcode = WebSocketOpcode::Text;
+    bool final = true;
+    const uint8_t* payload = nullptr;
+    size_t length = 0;
+    // Bytes of data used by the frame, header included
+    size_t frameLength = 0;
+};
+
+// Reads one server frame from the start of data. Frames longer than
+// maxPayload, masked server frames and reserved bits are errors.
+FrameResult ReadWebSocketFrame(const uint8_t* data, size_t length, size_t maxPayload, WebSocketFrame& frame);
@@ -1,5 +1,31 @@
 #include <napi.h>
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+
+#include "addon-common.h"
+#include "addon-core.h"
+#include "cdp-sync.h"
+#include "divergence-detector.h"
+#include "drag-synthesis.h"
+#include "fixed-vector.h"
+#include "layout-snapshot.h"
+#include "memory-reclaim.h"
+#include "process-scheduler.h"
+#include "process-tree.h"
+#include "profile-sampler.h"
+#include "sync-relay.h"
+#include "sync-sessions.h"
+#include "templated-text.h"
+#include "thumbnail-capture.h"
+#include "window-classifier.h"
+#include "window-control.h"
+#include "window-parking.h"
+#include "window-watcher.h"
 
 #ifdef __APPLE__
 #import <Foundation/Foundation.h>
@@ -13,11 +39,9 @@
 #include <cstring>
 #endif
 
-// Error logging macro
-#define LOG_ERROR(msg) \
-    do { \
-        std::cerr << "Error: " << msg << " (line: " << __LINE__ << ")" << std::endl; \
-    } while (0)
+#ifdef __linux__
+#include <dlfcn.h>
+#endif
 
 #ifdef _WIN32
     #define CHECK_WINDOW_OPERATION(op, msg) \
@@ -35,6 +59,8 @@ struct WindowInfo {
     bool isExtension;
     int width;
     int height;
+    // Position in the z-order of the windows found with it, 0 is topmost
+    int stackIndex;
 };
 #elif __APPLE__
 struct WindowInfo {
@@ -44,170 +70,660 @@ struct WindowInfo {
     int width;
     int height;
 };
+#elif __linux__
+using WindowInfo = X11WindowInfo;
 #endif
 
-// Monitor info structure (for multi-monitor support)
-#ifdef _WIN32
-struct MonitorInfo {
-    HMONITOR handle;
-    RECT rect;
-    bool isPrimary;
+// Reclaims a profile's memory on the libuv thread pool and settles the
+// promise returned by reclaimMemory
+class ReclaimWorker : public Napi::AsyncWorker {
+public:
+    ReclaimWorker(Napi::Env env, int pid, ReclaimMode mode)
+        : Napi::AsyncWorker(env, "ReclaimMemory"), pid_(pid), mode_(mode), deferred_(env) {}
+
+    Napi::Promise Promise() { return deferred_.Promise(); }
+
+    void Execute() override { result_ = ReclaimProcessTree(pid_, mode_); }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("processes", Napi::Number::New(env, result_.processes));
+        result.Set("failed", Napi::Number::New(env, result_.failed));
+        result.Set("rssBefore", Napi::Number::New(env, static_cast<double>(result_.rssBefore)));
+        result.Set("rssAfter", Napi::Number::New(env, static_cast<double>(result_.rssAfter)));
+        result.Set("reclaimedBytes", Napi::Number::New(env, static_cast<double>(result_.Reclaimed())));
+        result.Set("elapsedMs", Napi::Number::New(env, result_.elapsedMs));
+        deferred_.Resolve(result);
+    }
+
+private:
+    int pid_;
+    ReclaimMode mode_;
+    Napi::Promise::Deferred deferred_;
+    ReclaimResult result_;
 };
-#elif __APPLE__
-struct MonitorInfo {
-    CGDirectDisplayID id;
-    CGRect bounds;
-    bool isPrimary;
+
+// Promises settled from native threads. One thread-safe function per
+// WindowManager carries the results to the JS thread, and its context owns
+// every Deferred still pending, so none outlives the environment unsettled
+// or leaks when a result can no longer be delivered. The event loop is
+// referenced only while a promise is pending.
+class PromiseSettler {
+public:
+    using Result = std::function<void(Napi::Env, Napi::Promise::Deferred&)>;
+
+private:
+    struct Settlement {
+        uint64_t id;
+        Result result;
+    };
+
+    // Owned by the thread-safe function; JS thread only
+    struct Context {
+        Napi::ThreadSafeFunction tsfn;
+        std::unordered_map<uint64_t, Napi::Promise::Deferred> pending;
+        uint64_t nextId = 0;
+
+        void Settle(Napi::Env env, Settlement& settlement) {
+            auto deferred = pending.find(settlement.id);
+            if (deferred == pending.end()) {
+                return;
+            }
+            settlement.result(env, deferred->second);
+            pending.erase(deferred);
+            if (pending.empty()) {
+                tsfn.Unref(env);
+            }
+        }
+    };
+
+public:
+    // Settles one promise from any thread. A ticket dropped unsettled
+    // rejects its promise, so every exit path settles it.
+    class Ticket {
+    public:
+        ~Ticket() {
+            Settle([](Napi::Env env, Napi::Promise::Deferred& deferred) {
+                deferred.Reject(Napi::Error::New(env, "Native operation ended without a result").Value());
+            });
+        }
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        // The first call wins
+        void Settle(Result result) {
+            if (settled_.exchange(true)) {
+                return;
+            }
+            auto* payload = new Settlement{id_, std::move(result)};
+            Context* context = context_;
+            napi_status status =
+                tsfn_.NonBlockingCall(payload, [context](Napi::Env env, Napi::Function, Settlement* data) {
+                    std::unique_ptr<Settlement> owned(data);
+                    if (env != nullptr) {
+                        context->Settle(env, *owned);
+                    }
+                });
+            if (status != napi_ok) {
+                // Closing with the environment; the finalizer frees the Deferred
+                delete payload;
+            }
+            tsfn_.Release();
+        }
+
+    private:
+        friend class PromiseSettler;
+        Ticket(Napi::ThreadSafeFunction tsfn, Context* context, uint64_t id)
+            : tsfn_(tsfn), context_(context), id_(id) {}
+
+        Napi::ThreadSafeFunction tsfn_;
+        Context* context_;
+        uint64_t id_;
+        std::atomic<bool> settled_{false};
+    };
+
+    explicit PromiseSettler(Napi::Env env) : context_(new Context) {
+        tsfn_ = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}),
+                                              "PromiseSettler", 0, 1, context_,
+                                              [](Napi::Env, Context* context) { delete context; });
+        tsfn_.Unref(env);
+        context_->tsfn = tsfn_;
+    }
+
+    // Tickets still pending keep the function, and so the context, alive
+    ~PromiseSettler() { tsfn_.Release(); }
+
+    PromiseSettler(const PromiseSettler&) = delete;
+    PromiseSettler& operator=(const PromiseSettler&) = delete;
+
+    // JS thread. A pending promise, and in ticket what settles it.
+    Napi::Promise Add(Napi::Env env, std::shared_ptr<Ticket>& ticket) {
+        uint64_t id = ++context_->nextId;
+        auto deferred = context_->pending.emplace(id, Napi::Promise::Deferred::New(env)).first;
+        if (context_->pending.size() == 1) {
+            tsfn_.Ref(env);
+        }
+        tsfn_.Acquire();
+        ticket.reset(new Ticket(tsfn_, context_, id));
+        return deferred->second.Promise();
+    }
+
+private:
+    Napi::ThreadSafeFunction tsfn_;
+    Context* context_;
 };
+
+#ifdef _WIN32
+using TextTarget = HWND;
 #else
-// Dummy struct for Linux (not supported but allows compilation)
-struct MonitorInfo {
-    int id;
-    bool isPrimary;
-    int x, y, width, height;
-};
+using TextTarget = int;
+#endif
+
+// Types one character into target: a WM_CHAR per UTF-16 unit on Windows, a
+// key event carrying the character on macOS. Newlines are typed as Return.
+// X11 types through X11WindowControl::TypeCharacter instead.
+static bool PostCharacter(TextTarget target, char32_t codepoint) {
+    char16_t units[2];
+    int count = ToUtf16(codepoint == U'\n' ? U'\r' : codepoint, units);
+#ifdef _WIN32
+    if (!target) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!PostMessageW(target, WM_CHAR, static_cast<WPARAM>(units[i]), 1)) {
+            return false;
+        }
+    }
+    return true;
+#elif __APPLE__
+    // kVK_Return for newlines; any other key code is overridden by the string
+    CGKeyCode keyCode = units[0] == u'\r' ? 36 : 0;
+    for (bool keyDown : {true, false}) {
+        CGEventRef event = CGEventCreateKeyboardEvent(NULL, keyCode, keyDown);
+        if (!event) {
+            return false;
+        }
+        CGEventKeyboardSetUnicodeString(event, count, reinterpret_cast<const UniChar*>(units));
+        CGEventPostToPid(target, event);
+        CFRelease(event);
+    }
+    return true;
+#else
+    (void)target;
+    (void)count;
+    return false;
 #endif
+}
+
+struct AddonData {
+    Napi::FunctionReference constructor;
+    std::shared_ptr<AddonCore> core;
 
-// Forward declaration of GetMonitors function
-std::vector<MonitorInfo> GetMonitors();
+    ~AddonData() {
+        core->DetachEnvironment();
+    }
+};
 
 class WindowManager : public Napi::ObjectWrap<WindowManager> {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports) {
         Napi::Function func = DefineClass(env, "WindowManager", {
             InstanceMethod("arrangeWindows", &WindowManager::ArrangeWindows),
+            InstanceMethod("bulkWindowOp", &WindowManager::BulkWindowOp),
+            InstanceMethod("parkWindows", &WindowManager::ParkWindows),
+            InstanceMethod("unparkWindows", &WindowManager::UnparkWindows),
+            InstanceMethod("getParkingStats", &WindowManager::GetParkingStats),
+            InstanceMethod("saveLayout", &WindowManager::SaveLayout),
+            InstanceMethod("restoreLayout", &WindowManager::RestoreLayout),
             InstanceMethod("sendMouseEvent", &WindowManager::SendMouseEvent),
             InstanceMethod("sendMouseEventWithPopupMatching", &WindowManager::SendMouseEventWithPopupMatching),
             InstanceMethod("sendKeyboardEvent", &WindowManager::SendKeyboardEvent),
             InstanceMethod("sendWheelEvent", &WindowManager::SendWheelEvent),
+            InstanceMethod("broadcastTemplatedText", &WindowManager::BroadcastTemplatedText),
             InstanceMethod("getWindowBounds", &WindowManager::GetWindowBounds),
             InstanceMethod("getAllWindows", &WindowManager::GetAllWindows),
             InstanceMethod("getMonitors", &WindowManager::GetMonitorsJS),
-            InstanceMethod("isProcessWindowActive", &WindowManager::IsProcessWindowActive)
+            InstanceMethod("isProcessWindowActive", &WindowManager::IsProcessWindowActive),
+            InstanceMethod("onFocusChange", &WindowManager::OnFocusChange),
+            InstanceMethod("waitForWindow", &WindowManager::WaitForWindow),
+            InstanceMethod("getProcessTree", &WindowManager::GetProcessTree),
+            InstanceMethod("setProcessPolicy", &WindowManager::SetProcessPolicy),
+            InstanceMethod("clearProcessPolicy", &WindowManager::ClearProcessPolicy),
+            InstanceMethod("setForegroundBoost", &WindowManager::SetForegroundBoost),
+            InstanceMethod("setSchedulingOptions", &WindowManager::SetSchedulingOptions),
+            InstanceMethod("getSchedulingStats", &WindowManager::GetSchedulingStats),
+            InstanceMethod("reclaimMemory", &WindowManager::ReclaimMemory),
+            InstanceMethod("setAutoReclaim", &WindowManager::SetAutoReclaim),
+            InstanceMethod("getReclaimStats", &WindowManager::GetReclaimStats),
+            InstanceMethod("getCoreStats", &WindowManager::GetCoreStats),
+            InstanceMethod("setLogSink", &WindowManager::SetLogSink),
+            InstanceMethod("startThumbnailCapture", &WindowManager::StartThumbnailCapture),
+            InstanceMethod("setThumbnailTargets", &WindowManager::SetThumbnailTargets),
+            InstanceMethod("refreshThumbnails", &WindowManager::RefreshThumbnails),
+            InstanceMethod("stopThumbnailCapture", &WindowManager::StopThumbnailCapture),
+            InstanceMethod("getThumbnailStats", &WindowManager::GetThumbnailStats),
+            InstanceMethod("startProfileSampler", &WindowManager::StartProfileSampler),
+            InstanceMethod("setSampledProfiles", &WindowManager::SetSampledProfiles),
+            InstanceMethod("getProfileSamples", &WindowManager::GetProfileSamples),
+            InstanceMethod("stopProfileSampler", &WindowManager::StopProfileSampler),
+            InstanceMethod("startDivergenceDetection", &WindowManager::StartDivergenceDetection),
+            InstanceMethod("stopDivergenceDetection", &WindowManager::StopDivergenceDetection),
+            InstanceMethod("getDivergence", &WindowManager::GetDivergence),
+            InstanceMethod("startCdpSync", &WindowManager::StartCdpSync),
+            InstanceMethod("cdpScrollTo", &WindowManager::CdpScrollTo),
+            InstanceMethod("cdpDispatchWheel", &WindowManager::CdpDispatchWheel),
+            InstanceMethod("stopCdpSync", &WindowManager::StopCdpSync),
+            InstanceMethod("getCdpSyncStats", &WindowManager::GetCdpSyncStats),
+            InstanceMethod("createSyncSession", &WindowManager::CreateSyncSession),
+            InstanceMethod("postSyncMouseEvent", &WindowManager::PostSyncMouseEvent),
+            InstanceMethod("postSyncWheelEvent", &WindowManager::PostSyncWheelEvent),
+            InstanceMethod("postSyncKeyEvent", &WindowManager::PostSyncKeyEvent),
+            InstanceMethod("waitSyncBarrier", &WindowManager::WaitSyncBarrier),
+            InstanceMethod("destroySyncSession", &WindowManager::DestroySyncSession),
+            InstanceMethod("getSyncSessionStats", &WindowManager::GetSyncSessionStats),
+            InstanceMethod("startSyncRelay", &WindowManager::StartSyncRelay),
+            InstanceMethod("relayMouseEvent", &WindowManager::RelayMouseEvent),
+            InstanceMethod("relayWheelEvent", &WindowManager::RelayWheelEvent),
+            InstanceMethod("relayKeyboardEvent", &WindowManager::RelayKeyboardEvent),
+            InstanceMethod("stopSyncRelay", &WindowManager::StopSyncRelay),
+            InstanceMethod("getSyncRelayStats", &WindowManager::GetSyncRelayStats),
+            InstanceMethod("startRelayAgent", &WindowManager::StartRelayAgent),
+            InstanceMethod("setRelayAgentSlaves", &WindowManager::SetRelayAgentSlaves),
+            InstanceMethod("stopRelayAgent", &WindowManager::StopRelayAgent),
+            InstanceMethod("getRelayAgentStats", &WindowManager::GetRelayAgentStats),
+            InstanceMethod("startDrag", &WindowManager::StartDrag),
+            InstanceMethod("endDrag", &WindowManager::EndDrag),
+            InstanceMethod("getDragStats", &WindowManager::GetDragStats)
         });
 
-        Napi::FunctionReference* constructor = new Napi::FunctionReference();
-        *constructor = Napi::Persistent(func);
-        env.SetInstanceData(constructor);
+        // Every environment (main thread or worker) gets its own constructor and
+        // a reference to the shared core, released when the environment exits
+        AddonData* data = new AddonData();
+        data->constructor = Napi::Persistent(func);
+        data->core = AddonCore::Acquire();
+        data->core->AttachEnvironment();
+        env.SetInstanceData(data);
 
         exports.Set("WindowManager", func);
         return exports;
     }
 
-    WindowManager(const Napi::CallbackInfo& info) : Napi::ObjectWrap<WindowManager>(info) {}
+    WindowManager(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<WindowManager>(info),
+          core_(info.Env().GetInstanceData<AddonData>()->core) {}
+
+    ~WindowManager() {
+        StopDivergenceDetectionInternal();
+        ClearLogSink();
+        ClearFocusListener();
+    }
 
 private:
+    // Settles the promises of work done on native threads
+    PromiseSettler& Promises(Napi::Env env) {
+        if (!promises_) {
+            promises_ = std::make_unique<PromiseSettler>(env);
+        }
+        return *promises_;
+    }
+
+    static std::vector<int> ToPidVector(const Napi::Array& array) {
+        std::vector<int> pids;
+        pids.reserve(array.Length());
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            pids.push_back(array.Get(i).As<Napi::Number>().Int32Value());
+        }
+        return pids;
+    }
+
+    // Event names are short, so they are read into a stack buffer rather
+    // than a std::string. Longer strings are truncated and match no event.
+    static bool ReadEventName(const Napi::Value& value, char (&name)[16]) {
+        size_t length = 0;
+        name[0] = '\0';
+        return value.IsString() &&
+               napi_get_value_string_utf8(value.Env(), value, name, sizeof(name), &length) == napi_ok;
+    }
+
+    static int GetIntOption(const Napi::Object& options, const char* name, int defaultValue) {
+        Napi::Value value = options.Get(name);
+        return value.IsNumber() ? value.As<Napi::Number>().Int32Value() : defaultValue;
+    }
+
+    static LayoutMonitor ToLayoutMonitor(const MonitorInfo& monitor) {
+        LayoutMonitor layout;
+#ifdef _WIN32
+        layout.x = monitor.rect.left;
+        layout.y = monitor.rect.top;
+        layout.width = monitor.rect.right - monitor.rect.left;
+        layout.height = monitor.rect.bottom - monitor.rect.top;
+#elif __APPLE__
+        layout.x = static_cast<int>(monitor.bounds.origin.x);
+        layout.y = static_cast<int>(monitor.bounds.origin.y);
+        layout.width = static_cast<int>(monitor.bounds.size.width);
+        layout.height = static_cast<int>(monitor.bounds.size.height);
+#else
+        layout.x = monitor.x;
+        layout.y = monitor.y;
+        layout.width = monitor.width;
+        layout.height = monitor.height;
+#endif
+        layout.isPrimary = monitor.isPrimary;
+        return layout;
+    }
+
+    std::vector<LayoutMonitor> LayoutMonitors() {
+        std::vector<LayoutMonitor> monitors;
+        for (const auto& monitor : core_->Monitors()) {
+            monitors.push_back(ToLayoutMonitor(monitor));
+        }
+        return monitors;
+    }
+
     #ifdef _WIN32
-    bool ArrangeWindow(HWND hwnd, int x, int y, int width, int height, bool preserveSize = false) {
-        if (!hwnd) return false;
-        
-        if (IsIconic(hwnd)) {
-            ShowWindow(hwnd, SW_RESTORE);
-        }
-        SetForegroundWindow(hwnd);
-        
-        LONG style = GetWindowLong(hwnd, GWL_STYLE);
-        if (style == 0) {
-            LOG_ERROR("Failed to get window style");
-            return false;
+    struct Placement {
+        HWND hwnd;
+        int x;
+        int y;
+        int width;
+        int height;
+        bool preserveSize;
+    };
+
+    // Move the windows that are not already in place as one DeferWindowPos
+    // batch, which also stacks them in plan order. Windows already in place
+    // are not touched at all, so re-arranging a settled grid does nothing.
+    void ApplyPlacements(const std::vector<Placement>& placements, bool force, ArrangeResult& result) {
+        std::vector<const Placement*> changed;
+        for (const auto& placement : placements) {
+            bool restored = false;
+            if (IsIconic(placement.hwnd) || IsZoomed(placement.hwnd)) {
+                // Maximized windows ignore moves; restore without activating
+                ShowWindow(placement.hwnd, SW_SHOWNOACTIVATE);
+                restored = true;
+            }
+
+            RECT rect;
+            bool inPlace = !restored && GetWindowRect(placement.hwnd, &rect) &&
+                           rect.left == placement.x && rect.top == placement.y &&
+                           (placement.preserveSize || (rect.right - rect.left == placement.width &&
+                                                       rect.bottom - rect.top == placement.height));
+            if (inPlace && !force) {
+                result.skipped++;
+            } else {
+                changed.push_back(&placement);
+            }
         }
-        
-        style &= ~(WS_MAXIMIZE | WS_MINIMIZE);
-        if (SetWindowLong(hwnd, GWL_STYLE, style) == 0) {
-            LOG_ERROR("Failed to set window style");
-            return false;
+        if (changed.empty()) {
+            return;
         }
-        
-        UINT flags = SWP_SHOWWINDOW | SWP_FRAMECHANGED;
-        if (preserveSize) {
-            flags |= SWP_NOSIZE;
+        eventWindows_.clear();
+
+        HDWP batch = BeginDeferWindowPos(static_cast<int>(changed.size()));
+        HWND insertAfter = HWND_TOP;
+        for (const Placement* placement : changed) {
+            if (!batch) {
+                break;
+            }
+            UINT flags = SWP_NOACTIVATE | SWP_SHOWWINDOW | (placement->preserveSize ? SWP_NOSIZE : 0);
+            batch = DeferWindowPos(batch, placement->hwnd, insertAfter,
+                                   placement->x, placement->y, placement->width, placement->height, flags);
+            insertAfter = placement->hwnd;
         }
-        
-        if (!SetWindowPos(hwnd, HWND_TOPMOST, x, y, width, height, flags)) {
-            LOG_ERROR("Failed to set window position");
-            return false;
+
+        if (!batch || !EndDeferWindowPos(batch)) {
+            // A failed DeferWindowPos discards the whole batch (e.g. a window
+            // closed meanwhile), so fall back to moving windows one by one
+            LOG_ERROR("Deferred window positioning failed (LastError: " << GetLastError() << ")");
+            insertAfter = HWND_TOP;
+            for (const Placement* placement : changed) {
+                UINT flags = SWP_NOACTIVATE | SWP_SHOWWINDOW | (placement->preserveSize ? SWP_NOSIZE : 0);
+                CHECK_WINDOW_OPERATION(
+                    SetWindowPos(placement->hwnd, insertAfter, placement->x, placement->y,
+                                 placement->width, placement->height, flags),
+                    "Failed to set window position");
+                insertAfter = placement->hwnd;
+            }
         }
-        
-        if (!SetWindowPos(hwnd, HWND_NOTOPMOST, x, y, width, height, flags)) {
-            LOG_ERROR("Failed to reset window z-order");
-            return false;
+        result.moved += static_cast<int>(changed.size());
+
+        // Bring the arrangement forward once instead of activating every window
+        for (const Placement* placement : changed) {
+            if (!placement->preserveSize) {
+                SetForegroundWindow(placement->hwnd);
+                break;
+            }
         }
-        
-        return true;
     }
 
-    bool IsExtensionWindow(const char* title, const char* className) {
-        return title != nullptr &&
-               strlen(title) > 0 &&
-               strstr(title, "Google Chrome") == nullptr;
+    WindowKind ClassifyWindow(HWND hwnd, DWORD pid) {
+        return core_->ClassifyWindow(
+            reinterpret_cast<uint64_t>(hwnd), pid,
+            [hwnd](WindowTraits& traits) { ReadWin32WindowTraits(hwnd, traits); },
+            [hwnd](std::string& title) { ReadWin32WindowTitle(hwnd, title); });
     }
 
-    std::vector<WindowInfo> FindWindowsByPid(DWORD processId) {
-        std::vector<WindowInfo> windows;
-        HWND hwnd = nullptr;
+    // Main and extension windows of every pid (or any process it started),
+    // found with a single pass over the top-level windows
+    std::vector<std::vector<WindowInfo>> FindWindowsForPids(const std::vector<int>& pids,
+                                                            bool includeMinimized = false) {
+        std::vector<std::vector<WindowInfo>> windows(pids.size());
+        std::unordered_map<int, int> owners = ProcessTree::Shared().OwnerMap(pids);
+        std::unordered_map<int, size_t> slots;
+        for (size_t i = 0; i < pids.size(); i++) {
+            slots.emplace(pids[i], i);
+        }
 
+        // FindWindowEx walks the top-level windows from the top of the z-order
+        HWND hwnd = nullptr;
+        int stackIndex = 0;
         while ((hwnd = FindWindowEx(nullptr, hwnd, nullptr, nullptr)) != nullptr) {
             DWORD pid = 0;
             GetWindowThreadProcessId(hwnd, &pid);
+            stackIndex++;
 
-            if (pid == processId && IsWindowVisible(hwnd) && !IsIconic(hwnd)) {
-                char className[256] = {0};
-                GetClassNameA(hwnd, className, sizeof(className));
-
-                char title[256] = {0};
-                GetWindowTextA(hwnd, title, sizeof(title));
+            auto owner = owners.find(static_cast<int>(pid));
+            if (owner == owners.end() || !IsWindowVisible(hwnd) || (IsIconic(hwnd) && !includeMinimized)) {
+                continue;
+            }
 
+            WindowKind kind = ClassifyWindow(hwnd, pid);
+            if (kind == WindowKind::Main || kind == WindowKind::Extension) {
                 RECT rect;
                 GetWindowRect(hwnd, &rect);
 
-                bool isExtension = IsExtensionWindow(title, className);
-                bool isMainWindow = strstr(title, "Google Chrome") != nullptr &&
-                                  (GetWindowLong(hwnd, GWL_STYLE) & WS_OVERLAPPEDWINDOW);
-
-                if (isMainWindow || isExtension) {
-                    WindowInfo info;
-                    info.hwnd = hwnd;
-                    info.isExtension = isExtension;
-                    info.width = rect.right - rect.left;
-                    info.height = rect.bottom - rect.top;
-                    windows.push_back(info);
-                }
+                WindowInfo info;
+                info.hwnd = hwnd;
+                info.isExtension = kind == WindowKind::Extension;
+                info.width = rect.right - rect.left;
+                info.height = rect.bottom - rect.top;
+                info.stackIndex = stackIndex;
+                windows[slots[owner->second]].push_back(info);
             }
         }
         return windows;
     }
 
+    // Windows of processId or any process it started
+    std::vector<WindowInfo> FindWindowsByPid(DWORD processId) {
+        return FindWindowsForPids({static_cast<int>(processId)})[0];
+    }
+
+    // Z-order changes as one DeferWindowPos batch, each window placed after
+    // its insertAfter. Falls back to SetWindowPos if the batch fails.
+    void RestackWindows(const std::vector<std::pair<HWND, HWND>>& moves) {
+        const UINT flags = SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE;
+        HDWP batch = BeginDeferWindowPos(static_cast<int>(moves.size()));
+        for (const auto& move : moves) {
+            if (!batch) {
+                break;
+            }
+            batch = DeferWindowPos(batch, move.first, move.second, 0, 0, 0, 0, flags);
+        }
+
+        if (!batch || !EndDeferWindowPos(batch)) {
+            LOG_ERROR("Deferred window positioning failed (LastError: " << GetLastError() << ")");
+            for (const auto& move : moves) {
+                CHECK_WINDOW_OPERATION(SetWindowPos(move.first, move.second, 0, 0, 0, 0, flags),
+                                       "Failed to set window z-order");
+            }
+        }
+    }
+
+    // ShowWindowAsync and PostMessage only queue the change, so a profile
+    // whose UI thread is busy does not hold up the rest of the batch
+    std::vector<int> ApplyWindowOp(const std::vector<int>& pids, WindowOp op, bool value) {
+        std::vector<int> counts(pids.size(), 0);
+        eventWindows_.clear();
+        bool reopen = op == WindowOp::Restore || op == WindowOp::Show;
+        auto windowsByPid = FindWindowsForPids(pids, reopen);
+
+        // Hidden windows are skipped by the enumeration, add back the ones we hid
+        if (reopen) {
+            for (size_t i = 0; i < pids.size(); i++) {
+                auto hidden = hiddenWindows_.find(pids[i]);
+                if (hidden == hiddenWindows_.end()) {
+                    continue;
+                }
+                auto& windows = windowsByPid[i];
+                for (HWND hwnd : hidden->second) {
+                    bool listed = std::any_of(windows.begin(), windows.end(),
+                                              [hwnd](const WindowInfo& win) { return win.hwnd == hwnd; });
+                    if (!listed && IsWindow(hwnd)) {
+                        WindowInfo info = {};
+                        info.hwnd = hwnd;
+                        windows.push_back(info);
+                    }
+                }
+                hiddenWindows_.erase(hidden);
+            }
+        }
+
+        if (op == WindowOp::BringToFront || op == WindowOp::SetAlwaysOnTop) {
+            // Topmost first: BringToFront chains each window under the
+            // previous one, so the first pid ends on top
+            std::vector<std::pair<HWND, HWND>> moves;
+            HWND insertAfter = op == WindowOp::BringToFront ? HWND_TOP : (value ? HWND_TOPMOST : HWND_NOTOPMOST);
+            HWND focus = nullptr;
+            for (size_t i = 0; i < pids.size(); i++) {
+                for (const auto& win : windowsByPid[i]) {
+                    moves.emplace_back(win.hwnd, insertAfter);
+                    if (op == WindowOp::BringToFront) {
+                        insertAfter = win.hwnd;
+                        if (!focus && !win.isExtension) {
+                            focus = win.hwnd;
+                        }
+                    }
+                    counts[i]++;
+                }
+            }
+            if (op == WindowOp::SetAlwaysOnTop) {
+                std::reverse(moves.begin(), moves.end());
+            }
+            if (!moves.empty()) {
+                RestackWindows(moves);
+            }
+            // Activate the topmost profile once instead of every window
+            if (focus) {
+                SetForegroundWindow(focus);
+            }
+            return counts;
+        }
+
+        for (size_t i = 0; i < pids.size(); i++) {
+            for (const auto& win : windowsByPid[i]) {
+                bool queued = false;
+                switch (op) {
+                    case WindowOp::Minimize:
+                        queued = ShowWindowAsync(win.hwnd, SW_MINIMIZE) != FALSE || IsIconic(win.hwnd);
+                        break;
+                    case WindowOp::Restore:
+                        // Maximized windows need SW_RESTORE, which also activates
+                        queued = ShowWindowAsync(win.hwnd, IsZoomed(win.hwnd) ? SW_RESTORE : SW_SHOWNOACTIVATE) != FALSE;
+                        break;
+                    case WindowOp::Hide:
+                        queued = ShowWindowAsync(win.hwnd, SW_HIDE) != FALSE;
+                        if (queued) {
+                            hiddenWindows_[pids[i]].push_back(win.hwnd);
+                        }
+                        break;
+                    case WindowOp::Show:
+                        queued = ShowWindowAsync(win.hwnd, SW_SHOWNA) != FALSE;
+                        break;
+                    case WindowOp::Close:
+                        queued = PostMessage(win.hwnd, WM_CLOSE, 0, 0) != FALSE;
+                        break;
+                    default:
+                        break;
+                }
+                if (queued) {
+                    counts[i]++;
+                }
+            }
+        }
+        return counts;
+    }
+
+    struct CachedEventWindows {
+        std::chrono::steady_clock::time_point refreshed;
+        FixedVector<WindowInfo, kMaxEventWindows> windows;
+    };
+
+    // Windows of pid for input injection, the main window first, cached for
+    // kEventWindowTtl. Only the handles are cached; callers read positions live.
+    const FixedVector<WindowInfo, kMaxEventWindows>& EventWindows(int pid) {
+        auto now = std::chrono::steady_clock::now();
+        // Only a pid seen for the first time allocates its entry
+        CachedEventWindows& cached = eventWindows_[pid];
+        if (cached.refreshed.time_since_epoch().count() != 0 && now - cached.refreshed < kEventWindowTtl) {
+            return cached.windows;
+        }
+
+        cached.refreshed = now;
+        cached.windows.clear();
+        auto windows = FindWindowsByPid(pid);
+        for (const auto& win : windows) {
+            if (!win.isExtension) {
+                cached.windows.push_back(win);
+                break;
+            }
+        }
+        if (!cached.windows.empty()) {
+            for (const auto& win : windows) {
+                if (win.isExtension && !cached.windows.push_back(win)) {
+                    break;
+                }
+            }
+        }
+        return cached.windows;
+    }
+
+    // Menus and dropdowns change between events, so they are found live
+    static constexpr size_t kMaxPopupWindows = 16;
+    using PopupWindows = FixedVector<HWND, kMaxPopupWindows>;
+
     // Find popup windows (like context menus) belonging to a process
-    std::vector<HWND> FindPopupWindows(DWORD processId) {
-        std::vector<HWND> popups;
+    void FindPopupWindows(DWORD processId, PopupWindows& popups) {
+        popups.clear();
+        auto tree = ProcessTree::Shared().Descendants(static_cast<int>(processId));
         HWND hwnd = nullptr;
 
         while ((hwnd = FindWindowEx(nullptr, hwnd, nullptr, nullptr)) != nullptr) {
             DWORD pid = 0;
             GetWindowThreadProcessId(hwnd, &pid);
 
-            if (pid == processId && IsWindowVisible(hwnd)) {
-                LONG style = GetWindowLong(hwnd, GWL_STYLE);
-
-                // Check if it's a popup window (WS_POPUP)
-                if (style & WS_POPUP) {
-                    char className[256] = {0};
-                    GetClassNameA(hwnd, className, sizeof(className));
-
-                    // Common popup window classes: #32768 (menu), Chrome_WidgetWin_1, etc.
-                    if (strcmp(className, "#32768") == 0 ||
-                        strstr(className, "Chrome_WidgetWin") != nullptr) {
-                        popups.push_back(hwnd);
-                    }
-                }
+            if (tree->count(static_cast<int>(pid)) && IsWindowVisible(hwnd) &&
+                ClassifyWindow(hwnd, pid) == WindowKind::Popup && !popups.push_back(hwnd)) {
+                break;
             }
         }
-        return popups;
     }
 
     // Find best matching popup window based on relative position
     HWND FindMatchingPopup(HWND masterMainWindow, HWND masterPopup,
-                          HWND slaveMainWindow, const std::vector<HWND>& slavePopups) {
+                          HWND slaveMainWindow, const PopupWindows& slavePopups) {
         if (slavePopups.empty()) {
             return nullptr;
         }
@@ -268,43 +784,29 @@ private:
         }
     }
 
-    bool IsExtensionWindow(AXUIElementRef window) {
-        // Check window title
-        CFStringRef titleRef;
-        if (AXUIElementCopyAttributeValue(window, kAXTitleAttribute, (CFTypeRef*)&titleRef) == kAXErrorSuccess) {
-            char buffer[256];
-            CFStringGetCString(titleRef, buffer, sizeof(buffer), kCFStringEncodingUTF8);
-            CFRelease(titleRef);
-            
-            // Extension windows typically don't have "Google Chrome" in their titles
-            // and are usually smaller floating windows
-            if (strstr(buffer, "Google Chrome") == nullptr) {
-                return true;
-            }
-        }
-
-        // Check window role
-        CFStringRef roleRef;
-        if (AXUIElementCopyAttributeValue(window, kAXRoleAttribute, (CFTypeRef*)&roleRef) == kAXErrorSuccess) {
-            char buffer[256];
-            CFStringGetCString(roleRef, buffer, sizeof(buffer), kCFStringEncodingUTF8);
-            CFRelease(roleRef);
-            
-            // Extension windows might have different roles
-            if (strcmp(buffer, "AXWindow") == 0) {
-                // Additional check for window level
-                CFStringRef subroleRef;
-                if (AXUIElementCopyAttributeValue(window, kAXSubroleAttribute, (CFTypeRef*)&subroleRef) == kAXErrorSuccess) {
-                    char subroleBuffer[256];
-                    CFStringGetCString(subroleRef, subroleBuffer, sizeof(subroleBuffer), kCFStringEncodingUTF8);
-                    CFRelease(subroleRef);
-                    
-                    return strcmp(subroleBuffer, "AXStandardWindow") != 0;
-                }
+    static std::string CopyStringAttribute(AXUIElementRef element, CFStringRef attribute) {
+        std::string value;
+        CFStringRef valueRef = nullptr;
+        if (AXUIElementCopyAttributeValue(element, attribute, (CFTypeRef*)&valueRef) == kAXErrorSuccess && valueRef) {
+            char buffer[512];
+            if (CFStringGetCString(valueRef, buffer, sizeof(buffer), kCFStringEncodingUTF8)) {
+                value = buffer;
             }
+            CFRelease(valueRef);
         }
+        return value;
+    }
 
-        return false;
+    // AX elements are recreated on every enumeration, CFHash identifies the
+    // underlying window so the cache still applies
+    WindowKind ClassifyWindow(AXUIElementRef window, pid_t pid) {
+        return core_->ClassifyWindow(
+            static_cast<uint64_t>(CFHash(window)), static_cast<uint64_t>(pid),
+            [window](WindowTraits& traits) {
+                traits.role = CopyStringAttribute(window, kAXSubroleAttribute);
+                traits.flags = traits.role == "AXStandardWindow" ? kWindowFramed : 0;
+            },
+            [window](std::string& title) { title = CopyStringAttribute(window, kAXTitleAttribute); });
     }
 
     void BringWindowToFront(AXUIElementRef window) {
@@ -324,34 +826,76 @@ private:
         AXUIElementPerformAction(window, kAXRaiseAction);
     }
 
-    bool IsMainWindow(AXUIElementRef window) {
-        // Check window title
-        CFStringRef titleRef;
-        if (AXUIElementCopyAttributeValue(window, kAXTitleAttribute, (CFTypeRef*)&titleRef) == kAXErrorSuccess) {
-            char buffer[256];
-            CFStringGetCString(titleRef, buffer, sizeof(buffer), kCFStringEncodingUTF8);
-            CFRelease(titleRef);
-            
-            // Main Chrome window should contain "Google Chrome" in title
-            if (strstr(buffer, "Google Chrome") != nullptr) {
-                // Also check subrole to ensure it's a standard window
-                CFStringRef subroleRef;
-                if (AXUIElementCopyAttributeValue(window, kAXSubroleAttribute, (CFTypeRef*)&subroleRef) == kAXErrorSuccess) {
-                    char subroleBuffer[256];
-                    CFStringGetCString(subroleRef, subroleBuffer, sizeof(subroleBuffer), kCFStringEncodingUTF8);
-                    CFRelease(subroleRef);
-                    
-                    // Main window should have "AXStandardWindow" subrole
-                    return strcmp(subroleBuffer, "AXStandardWindow") == 0;
-                }
+    // The process in pid's tree that owns a normal window, preferring pid itself.
+    // Chrome helpers never own layer 0 windows, so this is the browser process.
+    pid_t ResolveWindowOwner(pid_t pid) {
+        auto tree = ProcessTree::Shared().Descendants(pid);
+        if (tree->size() == 1) {
+            return pid;
+        }
+
+        pid_t owner = pid;
+        CFArrayRef list = CGWindowListCopyWindowInfo(
+            kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements, kCGNullWindowID);
+        if (!list) {
+            return pid;
+        }
+        CFIndex count = CFArrayGetCount(list);
+        for (CFIndex i = 0; i < count; i++) {
+            auto info = static_cast<CFDictionaryRef>(CFArrayGetValueAtIndex(list, i));
+            auto pidRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowOwnerPID));
+            auto layerRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowLayer));
+            int windowPid = 0;
+            int layer = -1;
+            if (!pidRef || !layerRef) {
+                continue;
+            }
+            CFNumberGetValue(pidRef, kCFNumberIntType, &windowPid);
+            CFNumberGetValue(layerRef, kCFNumberIntType, &layer);
+            if (layer != 0 || !tree->count(windowPid)) {
+                continue;
+            }
+            owner = windowPid;
+            if (windowPid == pid) {
+                break;
             }
         }
-        
-        return false;
+        CFRelease(list);
+        return owner;
+    }
+
+    // Front-to-back rank of every process with an on-screen window, from one
+    // CGWindowList snapshot
+    std::unordered_map<pid_t, int> WindowStackRanks() {
+        std::unordered_map<pid_t, int> ranks;
+        CFArrayRef list = CGWindowListCopyWindowInfo(
+            kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements, kCGNullWindowID);
+        if (!list) {
+            return ranks;
+        }
+        CFIndex count = CFArrayGetCount(list);
+        for (CFIndex i = 0; i < count; i++) {
+            auto info = static_cast<CFDictionaryRef>(CFArrayGetValueAtIndex(list, i));
+            auto pidRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowOwnerPID));
+            auto layerRef = static_cast<CFNumberRef>(CFDictionaryGetValue(info, kCGWindowLayer));
+            int windowPid = 0;
+            int layer = -1;
+            if (!pidRef || !layerRef) {
+                continue;
+            }
+            CFNumberGetValue(pidRef, kCFNumberIntType, &windowPid);
+            CFNumberGetValue(layerRef, kCFNumberIntType, &layer);
+            if (layer == 0) {
+                ranks.emplace(windowPid, static_cast<int>(i));
+            }
+        }
+        CFRelease(list);
+        return ranks;
     }
 
-    std::vector<WindowInfo> GetWindowsForPid(pid_t pid) {
+    std::vector<WindowInfo> GetWindowsForPid(pid_t pid, bool includeMinimized = false) {
         std::vector<WindowInfo> windows;
+        pid = ResolveWindowOwner(pid);
         AXUIElementRef app = AXUIElementCreateApplication(pid);
         if (!app) {
             LOG_ERROR("Failed to create AX UI Element for application");
@@ -368,7 +912,7 @@ private:
                 CFBooleanRef isMinimizedRef;
                 bool isVisible = true;
                 if (AXUIElementCopyAttributeValue(window, kAXMinimizedAttribute, (CFTypeRef*)&isMinimizedRef) == kAXErrorSuccess) {
-                    isVisible = !CFBooleanGetValue(isMinimizedRef);
+                    isVisible = includeMinimized || !CFBooleanGetValue(isMinimizedRef);
                     CFRelease(isMinimizedRef);
                 }
 
@@ -379,10 +923,10 @@ private:
                         AXValueGetValue(sizeRef, (AXValueType)kAXValueCGSizeType, &size);
                         CFRelease(sizeRef);
 
-                        bool isExtension = IsExtensionWindow(window);
-                        bool isMain = IsMainWindow(window);
+                        WindowKind kind = ClassifyWindow(window, pid);
+                        bool isExtension = kind == WindowKind::Extension;
 
-                        if (isMain || isExtension) {
+                        if (kind == WindowKind::Main || isExtension) {
                             WindowInfo info;
                             info.window = (AXUIElementRef)CFRetain(window);
                             info.pid = pid;
@@ -400,11 +944,30 @@ private:
         return windows;
     }
 
-    bool ArrangeWindow(pid_t pid, float x, float y, float width, float height, bool preserveSize = false) {
+    static bool ReadWindowFrame(AXUIElementRef window, CGPoint& position, CGSize& size) {
+        AXValueRef positionRef = nullptr;
+        AXValueRef sizeRef = nullptr;
+        bool ok = AXUIElementCopyAttributeValue(window, kAXPositionAttribute, (CFTypeRef*)&positionRef) == kAXErrorSuccess &&
+                  AXUIElementCopyAttributeValue(window, kAXSizeAttribute, (CFTypeRef*)&sizeRef) == kAXErrorSuccess &&
+                  AXValueGetValue(positionRef, (AXValueType)kAXValueCGPointType, &position) &&
+                  AXValueGetValue(sizeRef, (AXValueType)kAXValueCGSizeType, &size);
+        if (positionRef) CFRelease(positionRef);
+        if (sizeRef) CFRelease(sizeRef);
+        return ok;
+    }
+
+    static bool NearlyEqual(CGFloat a, CGFloat b) {
+        return std::abs(a - b) < 1.0;
+    }
+
+    // Place the main window of pid and its extension windows. Nothing is
+    // written (and nothing raised) when they are already in place.
+    void ArrangeWindow(pid_t pid, float x, float y, float width, float height, bool force, ArrangeResult& result) {
         auto windows = GetWindowsForPid(pid);
         if (windows.empty()) {
             LOG_ERROR("No windows found for process");
-            return false;
+            result.missing++;
+            return;
         }
 
         WindowInfo* mainWindow = nullptr;
@@ -420,41 +983,65 @@ private:
 
         if (!mainWindow) {
             LOG_ERROR("Main window not found");
-            return false;
+            result.missing++;
+            for (auto& window : windows) {
+                CFRelease(window.window);
+            }
+            return;
         }
 
-        // Position and size for main window
-        CGPoint position = CGPointMake(x, y);
-        AXValueRef positionRef = AXValueCreate((AXValueType)kAXValueCGPointType, &position);
-        if (positionRef) {
-            AXUIElementSetAttributeValue(mainWindow->window, kAXPositionAttribute, positionRef);
-            CFRelease(positionRef);
+        bool inPlace = !force;
+        CGPoint currentPosition;
+        CGSize currentSize;
+        if (inPlace) {
+            inPlace = ReadWindowFrame(mainWindow->window, currentPosition, currentSize) &&
+                      NearlyEqual(currentPosition.x, x) && NearlyEqual(currentPosition.y, y) &&
+                      NearlyEqual(currentSize.width, width) && NearlyEqual(currentSize.height, height);
+        }
+        for (auto extWindow : extensionWindows) {
+            if (!inPlace) {
+                break;
+            }
+            inPlace = ReadWindowFrame(extWindow->window, currentPosition, currentSize) &&
+                      NearlyEqual(currentPosition.x, x + width - extWindow->width - 10) &&
+                      NearlyEqual(currentPosition.y, y);
         }
 
-        if (!preserveSize) {
+        if (inPlace) {
+            result.skipped++;
+        } else {
+            // Position and size for main window
+            CGPoint position = CGPointMake(x, y);
+            AXValueRef positionRef = AXValueCreate((AXValueType)kAXValueCGPointType, &position);
+            if (positionRef) {
+                AXUIElementSetAttributeValue(mainWindow->window, kAXPositionAttribute, positionRef);
+                CFRelease(positionRef);
+            }
+
             CGSize size = CGSizeMake(width, height);
             AXValueRef sizeRef = AXValueCreate((AXValueType)kAXValueCGSizeType, &size);
             if (sizeRef) {
                 AXUIElementSetAttributeValue(mainWindow->window, kAXSizeAttribute, sizeRef);
                 CFRelease(sizeRef);
             }
-        }
 
-        // Bring main window to front
-        BringWindowToFront(mainWindow->window);
+            // Bring main window to front
+            BringWindowToFront(mainWindow->window);
+
+            // Handle extension windows
+            for (auto extWindow : extensionWindows) {
+                // Position extension windows at the right edge of the main window
+                CGPoint extPosition = CGPointMake(x + width - extWindow->width - 10, y);
+                AXValueRef extPositionRef = AXValueCreate((AXValueType)kAXValueCGPointType, &extPosition);
+                if (extPositionRef) {
+                    AXUIElementSetAttributeValue(extWindow->window, kAXPositionAttribute, extPositionRef);
+                    CFRelease(extPositionRef);
+                }
 
-        // Handle extension windows
-        for (auto extWindow : extensionWindows) {
-            // Position extension windows at the right edge of the main window
-            CGPoint extPosition = CGPointMake(x + width - extWindow->width - 10, y);
-            AXValueRef extPositionRef = AXValueCreate((AXValueType)kAXValueCGPointType, &extPosition);
-            if (extPositionRef) {
-                AXUIElementSetAttributeValue(extWindow->window, kAXPositionAttribute, extPositionRef);
-                CFRelease(extPositionRef);
+                // Bring extension window to front
+                BringWindowToFront(extWindow->window);
             }
-
-            // Bring extension window to front
-            BringWindowToFront(extWindow->window);
+            result.moved++;
         }
 
         // Clean up
@@ -463,67 +1050,112 @@ private:
                 CFRelease(window.window);
             }
         }
+    }
+
+    // Accessibility has no batch API, so every profile is still its own set
+    // of AX calls, but each app is resolved once and activated at most once
+    std::vector<int> ApplyWindowOp(const std::vector<int>& pids, WindowOp op, bool value) {
+        std::vector<int> counts(pids.size(), 0);
+        if (op == WindowOp::SetAlwaysOnTop) {
+            // The window level of another app can't be changed through Accessibility
+            LOG_ERROR("setAlwaysOnTop is not supported on macOS");
+            return counts;
+        }
 
-        return true;
+        bool reopen = op == WindowOp::Restore || op == WindowOp::Show;
+        pid_t focus = 0;
+        // Walk the pids bottom up so for BringToFront the first ends on top
+        for (size_t i = pids.size(); i-- > 0;) {
+            auto windows = GetWindowsForPid(pids[i], reopen);
+            pid_t owner = windows.empty() ? ResolveWindowOwner(pids[i]) : windows[0].pid;
+
+            @autoreleasepool {
+                NSRunningApplication* app = [NSRunningApplication runningApplicationWithProcessIdentifier:owner];
+                if (op == WindowOp::Hide || op == WindowOp::Show || op == WindowOp::Restore) {
+                    // Hiding is per application on macOS
+                    bool changed = app && (op == WindowOp::Hide ? [app hide] : [app unhide]);
+                    if (op != WindowOp::Restore && changed) {
+                        counts[i] = std::max(1, static_cast<int>(windows.size()));
+                    }
+                }
+            }
+
+            for (auto& win : windows) {
+                AXError error = kAXErrorSuccess;
+                switch (op) {
+                    case WindowOp::Minimize:
+                    case WindowOp::Restore:
+                        error = AXUIElementSetAttributeValue(win.window, kAXMinimizedAttribute,
+                                                             op == WindowOp::Minimize ? kCFBooleanTrue : kCFBooleanFalse);
+                        break;
+                    case WindowOp::Close: {
+                        AXUIElementRef closeButton = nullptr;
+                        error = AXUIElementCopyAttributeValue(win.window, kAXCloseButtonAttribute,
+                                                              (CFTypeRef*)&closeButton);
+                        if (error == kAXErrorSuccess) {
+                            error = AXUIElementPerformAction(closeButton, kAXPressAction);
+                            CFRelease(closeButton);
+                        }
+                        break;
+                    }
+                    case WindowOp::BringToFront:
+                        error = AXUIElementPerformAction(win.window, kAXRaiseAction);
+                        if (!win.isExtension) {
+                            focus = win.pid;
+                        }
+                        break;
+                    default:
+                        continue;
+                }
+                if (error == kAXErrorSuccess) {
+                    counts[i]++;
+                }
+            }
+
+            for (auto& win : windows) {
+                CFRelease(win.window);
+            }
+        }
+
+        if (focus) {
+            @autoreleasepool {
+                NSRunningApplication* app = [NSRunningApplication runningApplicationWithProcessIdentifier:focus];
+                [app activateWithOptions:NSApplicationActivateIgnoringOtherApps];
+            }
+        }
+        (void)value;
+        return counts;
     }
-    #endif
+    #elif __linux__
+    using Placement = X11Placement;
 
-    #ifdef _WIN32
-    std::vector<MonitorInfo> GetMonitors() {
-        std::vector<MonitorInfo> monitors;
-        EnumDisplayMonitors(NULL, NULL, [](HMONITOR hMonitor, HDC, LPRECT, LPARAM lParam) -> BOOL {
-            auto& monitors = *reinterpret_cast<std::vector<MonitorInfo>*>(lParam);
-            MONITORINFOEX monitorInfo;
-            monitorInfo.cbSize = sizeof(MONITORINFOEX);
-            
-            if (GetMonitorInfo(hMonitor, &monitorInfo)) {
-                MonitorInfo info;
-                info.handle = hMonitor;
-                info.rect = monitorInfo.rcWork;
-                info.isPrimary = (monitorInfo.dwFlags & MONITORINFOF_PRIMARY) != 0;
-                monitors.push_back(info);
-            }
-            return TRUE;
-        }, reinterpret_cast<LPARAM>(&monitors));
-        
-        // Sort monitors so that non-primary monitors come first
-        std::sort(monitors.begin(), monitors.end(), 
-            [](const MonitorInfo& a, const MonitorInfo& b) {
-                return a.isPrimary < b.isPrimary;
-            });
-        
-        return monitors;
+    X11WindowControl& WindowControl() {
+        // Opened on first use so loading the addon never requires an X server
+        if (!windowControl_) {
+            windowControl_ = std::make_unique<X11WindowControl>(core_);
+        }
+        return *windowControl_;
     }
-    #elif __APPLE__
-    std::vector<MonitorInfo> GetMonitors() {
-        std::vector<MonitorInfo> monitors;
-        uint32_t displayCount;
-        CGDirectDisplayID displays[32];
-        
-        if (CGGetActiveDisplayList(32, displays, &displayCount) == kCGErrorSuccess) {
-            CGDirectDisplayID mainDisplay = CGMainDisplayID();
-            
-            for (uint32_t i = 0; i < displayCount; i++) {
-                MonitorInfo info;
-                info.id = displays[i];
-                info.bounds = CGDisplayBounds(displays[i]);
-                info.isPrimary = (displays[i] == mainDisplay);
-                monitors.push_back(info);
-            }
-            
-            // Sort monitors so that non-primary monitors come first
-            std::sort(monitors.begin(), monitors.end(), 
-                [](const MonitorInfo& a, const MonitorInfo& b) {
-                    return a.isPrimary < b.isPrimary;
-                });
+
+    std::vector<std::vector<WindowInfo>> FindWindowsForPids(const std::vector<int>& pids) {
+        return WindowControl().FindWindowsForPids(pids);
+    }
+
+    void ApplyPlacements(const std::vector<Placement>& placements, bool force, ArrangeResult& result) {
+        WindowControl().ApplyPlacements(placements, force, result);
+        WindowControl().Flush();
+        if (syncSessions_) {
+            syncSessions_->InvalidateBounds();
         }
-        
-        return monitors;
     }
-    #else
-    // Linux implementation (returns empty - not supported)
-    std::vector<MonitorInfo> GetMonitors() {
-        return std::vector<MonitorInfo>();
+
+    std::vector<int> ApplyWindowOp(const std::vector<int>& pids, WindowOp op, bool value) {
+        std::vector<int> counts = WindowControl().ApplyWindowOp(pids, op, value);
+        WindowControl().Flush();
+        if (syncSessions_) {
+            syncSessions_->InvalidateBounds();
+        }
+        return counts;
     }
     #endif
 
@@ -532,7 +1164,7 @@ private:
         Napi::Env env = info.Env();
         Napi::Array result = Napi::Array::New(env);
 
-        auto monitors = GetMonitors();
+        auto monitors = core_->Monitors();
 
         for (size_t i = 0; i < monitors.size(); i++) {
             Napi::Object monitorObj = Napi::Object::New(env);
@@ -591,7 +1223,7 @@ private:
         }
 
         // Get all available monitors
-        auto monitors = GetMonitors();
+        auto monitors = core_->Monitors();
         if (monitors.empty()) {
             Napi::Error::New(env, "No monitors found");
             return env.Null();
@@ -603,91 +1235,59 @@ private:
             return env.Null();
         }
 
+        bool force = false;
+        if (info.Length() >= 7 && info[6].IsObject()) {
+            Napi::Value forceValue = info[6].As<Napi::Object>().Get("force");
+            force = forceValue.IsBoolean() && forceValue.As<Napi::Boolean>().Value();
+        }
+
+        ArrangeResult result;
+
+        std::vector<int> pids;
+        pids.reserve(childPids.size() + 1);
+        pids.push_back(mainPid);
+        pids.insert(pids.end(), childPids.begin(), childPids.end());
+
 #ifdef _WIN32
         // Use the selected monitor
         const auto& monitor = monitors[monitorIndex];
-        int screenWidth = monitor.rect.right - monitor.rect.left;
-        int screenHeight = monitor.rect.bottom - monitor.rect.top;
-        int screenX = monitor.rect.left;
-        int screenY = monitor.rect.top;
-
-        // Calculate total windows and rows
-        int totalWindows = childPids.size() + 1;
-        int rows = (totalWindows + columns - 1) / columns;
-
-        // Calculate effective dimensions with spacing
-        int availableWidth = screenWidth - (spacing * (columns + 1));
-        int availableHeight = screenHeight - (spacing * (rows + 1));
-        int effectiveWidth = width > 0 ? width : availableWidth / columns;
-        int effectiveHeight = height > 0 ? height : availableHeight / rows;
-
-        // Handle main window and its extensions
-        auto mainWindows = FindWindowsByPid(mainPid);
-        WindowInfo* mainWindow = nullptr;
-        std::vector<WindowInfo*> mainExtensions;
-
-        for (auto& win : mainWindows) {
-            if (!win.isExtension) {
-                mainWindow = &win;
-            } else {
-                mainExtensions.push_back(&win);
-            }
-        }
-
-        if (mainWindow) {
-            int row = 0;
-            int col = 0;
-            int x = screenX + col * effectiveWidth + spacing;
-            int y = screenY + row * effectiveHeight + spacing;
-            ArrangeWindow(mainWindow->hwnd, x, y, effectiveWidth - spacing * 2, effectiveHeight - spacing * 2);
-
-            for (auto ext : mainExtensions) {
-                ArrangeWindow(ext->hwnd,
-                            x + effectiveWidth - ext->width - spacing,
-                            y,
-                            ext->width,
-                            ext->height,
-                            true);
-            }
-        }
-
-        // Handle child windows
-        for (size_t i = 0; i < childPids.size(); i++) {
-            auto childWindows = FindWindowsByPid(childPids[i]);
-            WindowInfo* childMain = nullptr;
-            std::vector<WindowInfo*> childExtensions;
-
-            for (auto& win : childWindows) {
+        std::vector<GridCell> cells = ComputeArrangeGrid(
+            monitor.rect.left, monitor.rect.top,
+            monitor.rect.right - monitor.rect.left, monitor.rect.bottom - monitor.rect.top,
+            static_cast<int>(pids.size()), columns, width, height, spacing);
+        auto windowsByPid = FindWindowsForPids(pids);
+
+        // Build the full plan first, then apply it as one batch. Within each
+        // profile the extension windows come first so they stack above it.
+        std::vector<Placement> placements;
+        for (size_t i = 0; i < cells.size(); i++) {
+            WindowInfo* mainWindow = nullptr;
+            std::vector<WindowInfo*> extensions;
+            for (auto& win : windowsByPid[i]) {
                 if (!win.isExtension) {
-                    childMain = &win;
+                    mainWindow = &win;
                 } else {
-                    childExtensions.push_back(&win);
+                    extensions.push_back(&win);
                 }
             }
 
-            if (childMain) {
-                int row = (i + 1) / columns;
-                int col = (i + 1) % columns;
-                int x = screenX + (col * effectiveWidth) + (spacing * (col + 1));
-                int y = screenY + (row * effectiveHeight) + (spacing * (row + 1));
-
-                ArrangeWindow(childMain->hwnd,
-                            x,
-                            y,
-                            effectiveWidth - spacing,
-                            effectiveHeight - spacing);
-
-                // Handle extensions
-                for (auto ext : childExtensions) {
-                    ArrangeWindow(ext->hwnd,
-                                x + effectiveWidth - ext->width - spacing,
-                                y,
-                                ext->width,
-                                ext->height,
-                                true);
-                }
+            if (!mainWindow) {
+                result.missing++;
+                continue;
             }
+
+            const GridCell& cell = cells[i];
+            for (auto ext : extensions) {
+                placements.push_back({ext->hwnd, cell.anchorRight - ext->width, cell.y,
+                                      ext->width, ext->height, true});
+            }
+            placements.push_back({mainWindow->hwnd, cell.x, cell.y, cell.width, cell.height, false});
         }
+
+        ApplyPlacements(placements, force, result);
+#elif __linux__
+        result = WindowControl().Arrange(pids, monitors[monitorIndex], columns, width, height, spacing, force);
+        WindowControl().Flush();
 #elif __APPLE__
         // Use the selected monitor
         const auto& monitor = monitors[monitorIndex];
@@ -707,11 +1307,13 @@ private:
         float effectiveHeight = height > 0 ? height : availableHeight / rows;
 
         // Handle main window
-        ArrangeWindow(mainPid, 
-                     screenX + spacing, 
-                     screenY + spacing, 
-                     effectiveWidth - spacing * 2, 
-                     effectiveHeight - spacing * 2);
+        ArrangeWindow(mainPid,
+                     screenX + spacing,
+                     screenY + spacing,
+                     effectiveWidth - spacing * 2,
+                     effectiveHeight - spacing * 2,
+                     force,
+                     result);
 
         // Handle child windows
         for (size_t i = 0; i < childPids.size(); i++) {
@@ -719,16 +1321,382 @@ private:
             int col = (i + 1) % columns;
             float x = screenX + (col * effectiveWidth) + (spacing * (col + 1));
             float y = screenY + (row * effectiveHeight) + (spacing * (row + 1));
-            
+
             ArrangeWindow(childPids[i],
                          x,
                          y,
                          effectiveWidth - spacing,
-                         effectiveHeight - spacing);
+                         effectiveHeight - spacing,
+                         force,
+                         result);
+        }
+#endif
+
+        Napi::Object counts = Napi::Object::New(env);
+        counts.Set("moved", Napi::Number::New(env, result.moved));
+        counts.Set("skipped", Napi::Number::New(env, result.skipped));
+        counts.Set("missing", Napi::Number::New(env, result.missing));
+        return counts;
+    }
+
+    // bulkWindowOp(pids, op, {value}) applies one operation to the main and
+    // extension windows of many profiles: "minimize", "restore", "hide",
+    // "show", "close", "bringToFront" (pids[0] ends on top) or
+    // "setAlwaysOnTop" (value defaults to true). All windows are found in one
+    // enumeration and changed as one batch. Returns [{pid, windows}] in pids
+    // order, windows being how many were changed (0 when none was found).
+    Napi::Value BulkWindowOp(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsArray() || !info[1].IsString()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids, op").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        WindowOp op;
+        if (!ParseWindowOp(info[1].As<Napi::String>().Utf8Value(), op)) {
+            Napi::TypeError::New(env, "Unknown window operation").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        bool value = true;
+        if (info.Length() >= 3 && info[2].IsObject()) {
+            Napi::Value valueOption = info[2].As<Napi::Object>().Get("value");
+            value = !valueOption.IsBoolean() || valueOption.As<Napi::Boolean>().Value();
+        }
+
+        std::vector<int> pids = ToPidVector(info[0].As<Napi::Array>());
+        std::vector<int> counts(pids.size(), 0);
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__)
+        counts = ApplyWindowOp(pids, op, value);
+#endif
+
+        Napi::Array result = Napi::Array::New(env, pids.size());
+        for (size_t i = 0; i < pids.size(); i++) {
+            Napi::Object entry = Napi::Object::New(env);
+            entry.Set("pid", Napi::Number::New(env, pids[i]));
+            entry.Set("windows", Napi::Number::New(env, counts[i]));
+            result.Set(static_cast<uint32_t>(i), entry);
+        }
+        return result;
+    }
+
+    // Keep activePids on screen and park the rest of pids, minimized (mode
+    // "minimize", the default) or hidden ("hide") so Chrome throttles them.
+    // Only profiles whose state changes are touched, so swapping the active
+    // set is cheap. Returns {parked, unparked, elapsedMs} for this call.
+    Napi::Value ParkWindows(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsArray() || !info[1].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids, activePids, [options]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        WindowOp parkOp = WindowOp::Minimize;
+        if (info.Length() >= 3 && info[2].IsObject()) {
+            Napi::Value mode = info[2].As<Napi::Object>().Get("mode");
+            if (mode.IsString()) {
+                std::string name = mode.As<Napi::String>().Utf8Value();
+                if (name == "hide") {
+                    parkOp = WindowOp::Hide;
+                } else if (name != "minimize") {
+                    Napi::TypeError::New(env, "Unknown parking mode: " + name).ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+            }
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        std::vector<int> unparked;
+        // Profiles parked the other way come back first
+        if (parkOp != parkOp_) {
+            unparked = parking_.Release();
+            UnparkProfiles(unparked);
+            parkOp_ = parkOp;
+        }
+
+        WindowParking::Plan plan =
+            parking_.Update(ToPidVector(info[0].As<Napi::Array>()), ToPidVector(info[1].As<Napi::Array>()));
+        // Show the incoming profiles before the outgoing ones go
+        UnparkProfiles(plan.unpark);
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__)
+        if (!plan.park.empty()) {
+            ApplyWindowOp(plan.park, parkOp_, true);
+        }
+#endif
+        unparked.insert(unparked.end(), plan.unpark.begin(), plan.unpark.end());
+        double elapsedMs =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        if (!plan.park.empty() || !unparked.empty()) {
+            parking_.RecordSwap(elapsedMs);
+        }
+
+        auto toArray = [&env](const std::vector<int>& pids) {
+            Napi::Array array = Napi::Array::New(env, pids.size());
+            for (size_t i = 0; i < pids.size(); i++) {
+                array.Set(static_cast<uint32_t>(i), Napi::Number::New(env, pids[i]));
+            }
+            return array;
+        };
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("parked", toArray(plan.park));
+        result.Set("unparked", toArray(unparked));
+        result.Set("elapsedMs", Napi::Number::New(env, elapsedMs));
+        return result;
+    }
+
+    // Bring every parked profile back and stop managing them. Returns the
+    // number of profiles unparked.
+    Napi::Value UnparkWindows(const Napi::CallbackInfo& info) {
+        std::vector<int> unparked = parking_.Release();
+        UnparkProfiles(unparked);
+        return Napi::Number::New(info.Env(), static_cast<double>(unparked.size()));
+    }
+
+    // Counts, swap timing and the CPU use of active and parked profiles
+    // since the previous call (their whole process trees, 100 = one core)
+    Napi::Value GetParkingStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        WindowParking::Stats stats = parking_.Sample();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("mode", Napi::String::New(env, parkOp_ == WindowOp::Hide ? "hide" : "minimize"));
+        result.Set("active", Napi::Number::New(env, stats.active));
+        result.Set("parked", Napi::Number::New(env, stats.parked));
+        result.Set("swaps", Napi::Number::New(env, static_cast<double>(stats.swaps)));
+        result.Set("lastSwapMs", Napi::Number::New(env, stats.lastSwapMs));
+        result.Set("sampleMs", Napi::Number::New(env, stats.sampleMs));
+        result.Set("activeCpuPercent", Napi::Number::New(env, stats.activeCpuPercent));
+        result.Set("parkedCpuPercent", Napi::Number::New(env, stats.parkedCpuPercent));
+        result.Set("savedCpuPercent", Napi::Number::New(env, stats.savedCpuPercent));
+        return result;
+    }
+
+    void UnparkProfiles(const std::vector<int>& pids) {
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__)
+        if (!pids.empty()) {
+            ApplyWindowOp(pids, parkOp_ == WindowOp::Hide ? WindowOp::Show : WindowOp::Restore, true);
+        }
+#else
+        (void)pids;
+#endif
+    }
+
+    // Snapshot the main window of every profile: saveLayout({[pid]: profileId})
+    // returns a Buffer for restoreLayout. Profiles without a window are left out.
+    Napi::Value SaveLayout(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsObject()) {
+            Napi::TypeError::New(env, "Expected an object mapping pids to profile IDs").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Object profiles = info[0].As<Napi::Object>();
+        Napi::Array keys = profiles.GetPropertyNames();
+        std::vector<int> pids;
+        std::vector<std::string> profileIds;
+        for (uint32_t i = 0; i < keys.Length(); i++) {
+            std::string key = keys.Get(i).ToString().Utf8Value();
+            int pid = std::atoi(key.c_str());
+            if (pid > 0) {
+                pids.push_back(pid);
+                profileIds.push_back(profiles.Get(key).ToString().Utf8Value());
+            }
+        }
+
+        LayoutSnapshot snapshot;
+        snapshot.monitors = LayoutMonitors();
+        if (snapshot.monitors.empty()) {
+            Napi::Error::New(env, "No monitors found").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        // Absolute bounds and stacking rank of each main window found
+        std::vector<std::pair<int, LayoutEntry>> captured;
+#if defined(_WIN32) || defined(__linux__)
+        auto windowsByPid = FindWindowsForPids(pids);
+        for (size_t i = 0; i < pids.size(); i++) {
+            for (const auto& win : windowsByPid[i]) {
+                if (win.isExtension) {
+                    continue;
+                }
+                LayoutEntry entry;
+                entry.profileId = profileIds[i];
+#ifdef _WIN32
+                RECT rect;
+                if (!GetWindowRect(win.hwnd, &rect)) {
+                    break;
+                }
+                entry.x = rect.left;
+                entry.y = rect.top;
+                entry.width = rect.right - rect.left;
+                entry.height = rect.bottom - rect.top;
+#else
+                entry.x = win.x;
+                entry.y = win.y;
+                entry.width = win.width;
+                entry.height = win.height;
+#endif
+                captured.emplace_back(win.stackIndex, entry);
+                break;
+            }
+        }
+#elif __APPLE__
+        auto ranks = WindowStackRanks();
+        for (size_t i = 0; i < pids.size(); i++) {
+            auto windows = GetWindowsForPid(pids[i]);
+            for (auto& win : windows) {
+                CGPoint position;
+                CGSize size;
+                if (!win.isExtension && ReadWindowFrame(win.window, position, size)) {
+                    LayoutEntry entry;
+                    entry.profileId = profileIds[i];
+                    entry.x = static_cast<int>(position.x);
+                    entry.y = static_cast<int>(position.y);
+                    entry.width = static_cast<int>(size.width);
+                    entry.height = static_cast<int>(size.height);
+                    auto rank = ranks.find(win.pid);
+                    captured.emplace_back(rank != ranks.end() ? rank->second : INT_MAX, entry);
+                    break;
+                }
+            }
+            for (auto& win : windows) {
+                CFRelease(win.window);
+            }
+        }
+#endif
+
+        std::stable_sort(captured.begin(), captured.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (auto& item : captured) {
+            LayoutEntry& entry = item.second;
+            entry.monitor = FindLayoutMonitor(snapshot.monitors, entry.x, entry.y, entry.width, entry.height);
+            entry.x -= snapshot.monitors[entry.monitor].x;
+            entry.y -= snapshot.monitors[entry.monitor].y;
+            entry.zOrder = static_cast<int>(snapshot.entries.size());
+            snapshot.entries.push_back(std::move(entry));
+        }
+
+        std::vector<uint8_t> data = EncodeLayout(snapshot);
+        return Napi::Buffer<uint8_t>::Copy(env, data.data(), data.size());
+    }
+
+    // Apply a saveLayout snapshot: restoreLayout(layout, {[profileId]: pid}, {force}).
+    // Every window found is placed in one batched pass; profiles whose window
+    // is not up yet are returned in pending so the call can be repeated.
+    Napi::Value RestoreLayout(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsTypedArray() || !info[1].IsObject()) {
+            Napi::TypeError::New(env, "Expected layout buffer and an object mapping profile IDs to pids")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Uint8Array data = info[0].As<Napi::Uint8Array>();
+        LayoutSnapshot snapshot;
+        if (!DecodeLayout(data.Data(), data.ByteLength(), snapshot)) {
+            Napi::Error::New(env, "Invalid layout data").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        bool force = false;
+        if (info.Length() >= 3 && info[2].IsObject()) {
+            Napi::Value forceValue = info[2].As<Napi::Object>().Get("force");
+            force = forceValue.IsBoolean() && forceValue.As<Napi::Boolean>().Value();
+        }
+
+        std::vector<LayoutMonitor> monitors = LayoutMonitors();
+        if (monitors.empty()) {
+            Napi::Error::New(env, "No monitors found").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        std::vector<int> monitorMap = MatchLayoutMonitors(snapshot.monitors, monitors);
+
+        // Entries of the profiles being restored, topmost first
+        Napi::Object pidMap = info[1].As<Napi::Object>();
+        std::vector<const LayoutEntry*> entries;
+        std::vector<int> pids;
+        for (const auto& entry : snapshot.entries) {
+            Napi::Value pid = pidMap.Get(entry.profileId);
+            if (pid.IsNumber() && pid.As<Napi::Number>().Int32Value() > 0) {
+                entries.push_back(&entry);
+                pids.push_back(pid.As<Napi::Number>().Int32Value());
+            }
+        }
+        std::vector<size_t> order(entries.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&entries](size_t a, size_t b) { return entries[a]->zOrder < entries[b]->zOrder; });
+
+        ArrangeResult result;
+        Napi::Array pending = Napi::Array::New(env);
+        uint32_t pendingCount = 0;
+
+#if defined(_WIN32) || defined(__linux__)
+        auto windowsByPid = FindWindowsForPids(pids);
+        std::vector<Placement> placements;
+        for (size_t i : order) {
+            const LayoutEntry& entry = *entries[i];
+            WindowInfo* mainWindow = nullptr;
+            std::vector<WindowInfo*> extensions;
+            for (auto& win : windowsByPid[i]) {
+                if (!win.isExtension) {
+                    mainWindow = &win;
+                } else {
+                    extensions.push_back(&win);
+                }
+            }
+            if (!mainWindow) {
+                result.missing++;
+                pending[pendingCount++] = Napi::String::New(env, entry.profileId);
+                continue;
+            }
+
+            int x, y, width, height;
+            PlaceLayoutEntry(entry, snapshot.monitors[entry.monitor], monitors[monitorMap[entry.monitor]],
+                             x, y, width, height);
+#ifdef _WIN32
+            for (auto ext : extensions) {
+                placements.push_back({ext->hwnd, x + width - ext->width, y, ext->width, ext->height, true});
+            }
+            placements.push_back({mainWindow->hwnd, x, y, width, height, false});
+#else
+            for (auto ext : extensions) {
+                placements.push_back({ext, x + width - ext->width, y, ext->width, ext->height, true});
+            }
+            placements.push_back({mainWindow, x, y, width, height, false});
+#endif
+        }
+
+        ApplyPlacements(placements, force, result);
+#elif __APPLE__
+        // Moved windows are raised as they are placed, so go bottom up
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            const LayoutEntry& entry = *entries[*it];
+            int x, y, width, height;
+            PlaceLayoutEntry(entry, snapshot.monitors[entry.monitor], monitors[monitorMap[entry.monitor]],
+                             x, y, width, height);
+
+            int missing = result.missing;
+            ArrangeWindow(pids[*it], x, y, width, height, force, result);
+            if (result.missing != missing) {
+                pending[pendingCount++] = Napi::String::New(env, entry.profileId);
+            }
         }
 #endif
 
-        return env.Null();
+        Napi::Object counts = Napi::Object::New(env);
+        counts.Set("moved", Napi::Number::New(env, result.moved));
+        counts.Set("skipped", Napi::Number::New(env, result.skipped));
+        counts.Set("missing", Napi::Number::New(env, result.missing));
+        counts.Set("pending", pending);
+        return counts;
     }
 
     // Get window bounds by PID
@@ -889,6 +1857,7 @@ private:
     // Send mouse event to window
     Napi::Value SendMouseEvent(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
+        auto inputLock = core_->LockInput();
 
         if (info.Length() < 4) {
             Napi::TypeError::New(env, "Wrong number of arguments: pid, x, y, eventType");
@@ -897,31 +1866,24 @@ private:
         int pid = info[0].As<Napi::Number>().Int32Value();
         int x = info[1].As<Napi::Number>().Int32Value();
         int y = info[2].As<Napi::Number>().Int32Value();
-        std::string eventType = info[3].As<Napi::String>().Utf8Value();
-
-#ifdef _WIN32
-        auto windows = FindWindowsByPid(pid);
-        if (windows.empty()) {
+        char eventName[16];
+        PointerEvent pointerEvent;
+        if (!ReadEventName(info[3], eventName) || !ParsePointerEvent(eventName, pointerEvent)) {
             return Napi::Boolean::New(env, false);
         }
 
-        WindowInfo* mainWindow = nullptr;
-        for (auto& win : windows) {
-            if (!win.isExtension) {
-                mainWindow = &win;
-                break;
-            }
-        }
-
-        if (!mainWindow) {
+#ifdef _WIN32
+        const auto& windows = EventWindows(pid);
+        if (windows.empty()) {
             return Napi::Boolean::New(env, false);
         }
+        const WindowInfo& mainWindow = windows[0];
 
         // Check if click position is on an extension window first
         // Extension windows are independent windows (e.g., OKX Wallet popup)
-        HWND targetWindow = mainWindow->hwnd;
+        HWND targetWindow = mainWindow.hwnd;
 
-        for (auto& win : windows) {
+        for (const auto& win : windows) {
             if (win.isExtension) {
                 RECT extRect;
                 GetWindowRect(win.hwnd, &extRect);
@@ -935,8 +1897,9 @@ private:
         }
 
         // If not in extension window, check popup windows (menus, dropdowns, etc.)
-        if (targetWindow == mainWindow->hwnd) {
-            std::vector<HWND> popupWindows = FindPopupWindows(pid);
+        if (targetWindow == mainWindow.hwnd) {
+            PopupWindows popupWindows;
+            FindPopupWindows(pid, popupWindows);
 
             for (HWND popup : popupWindows) {
                 RECT popupRect;
@@ -958,46 +1921,54 @@ private:
         LPARAM lParam = MAKELPARAM(clientX, clientY);
 
         // Send event to target window (either main window or popup)
-        if (eventType == "mousemove") {
-            PostMessage(targetWindow, WM_MOUSEMOVE, 0, lParam);
-        } else if (eventType == "mousedown") {
-            PostMessage(targetWindow, WM_LBUTTONDOWN, MK_LBUTTON, lParam);
-        } else if (eventType == "mouseup") {
-            PostMessage(targetWindow, WM_LBUTTONUP, 0, lParam);
-        } else if (eventType == "rightdown") {
-            PostMessage(targetWindow, WM_RBUTTONDOWN, MK_RBUTTON, lParam);
-        } else if (eventType == "rightup") {
-            PostMessage(targetWindow, WM_RBUTTONUP, 0, lParam);
-        } else {
-            return Napi::Boolean::New(env, false);
+        switch (pointerEvent) {
+            case PointerEvent::Move:
+                PostMessage(targetWindow, WM_MOUSEMOVE, 0, lParam);
+                break;
+            case PointerEvent::LeftDown:
+                PostMessage(targetWindow, WM_LBUTTONDOWN, MK_LBUTTON, lParam);
+                break;
+            case PointerEvent::LeftUp:
+                PostMessage(targetWindow, WM_LBUTTONUP, 0, lParam);
+                break;
+            case PointerEvent::RightDown:
+                PostMessage(targetWindow, WM_RBUTTONDOWN, MK_RBUTTON, lParam);
+                break;
+            case PointerEvent::RightUp:
+                PostMessage(targetWindow, WM_RBUTTONUP, 0, lParam);
+                break;
         }
 
 #elif __APPLE__
         CGPoint point = CGPointMake(x, y);
-        CGEventType cgEventType;
+        CGEventType cgEventType = kCGEventMouseMoved;
         CGMouseButton button = kCGMouseButtonLeft;
 
-        if (eventType == "mousemove") {
-            cgEventType = kCGEventMouseMoved;
-        } else if (eventType == "mousedown") {
-            cgEventType = kCGEventLeftMouseDown;
-        } else if (eventType == "mouseup") {
-            cgEventType = kCGEventLeftMouseUp;
-        } else if (eventType == "rightdown") {
-            cgEventType = kCGEventRightMouseDown;
-            button = kCGMouseButtonRight;
-        } else if (eventType == "rightup") {
-            cgEventType = kCGEventRightMouseUp;
-            button = kCGMouseButtonRight;
-        } else {
-            return Napi::Boolean::New(env, false);
+        switch (pointerEvent) {
+            case PointerEvent::Move:
+                cgEventType = kCGEventMouseMoved;
+                break;
+            case PointerEvent::LeftDown:
+                cgEventType = kCGEventLeftMouseDown;
+                break;
+            case PointerEvent::LeftUp:
+                cgEventType = kCGEventLeftMouseUp;
+                break;
+            case PointerEvent::RightDown:
+                cgEventType = kCGEventRightMouseDown;
+                button = kCGMouseButtonRight;
+                break;
+            case PointerEvent::RightUp:
+                cgEventType = kCGEventRightMouseUp;
+                button = kCGMouseButtonRight;
+                break;
         }
 
         CGEventRef event = CGEventCreateMouseEvent(NULL, cgEventType, point, button);
         if (event) {
             // For click events (down/up), send directly to target process to avoid moving cursor
             // For mousemove, we still use global event tap as CGEventPostToPid doesn't support it well
-            if (eventType == "mousemove") {
+            if (pointerEvent == PointerEvent::Move) {
                 CGEventPost(kCGHIDEventTap, event);
             } else {
                 // Send to specific process - this won't move the global cursor
@@ -1005,6 +1976,11 @@ private:
             }
             CFRelease(event);
         }
+#elif __linux__
+        if (!WindowControl().SendPointerEvent(pid, x, y, pointerEvent)) {
+            return Napi::Boolean::New(env, false);
+        }
+        WindowControl().Flush();
 #endif
 
         return Napi::Boolean::New(env, true);
@@ -1014,6 +1990,7 @@ private:
     // Now supports automatic popup window detection based on mouse position
     Napi::Value SendKeyboardEvent(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
+        auto inputLock = core_->LockInput();
 
         if (info.Length() < 3) {
             Napi::TypeError::New(env, "Wrong number of arguments: pid, keyCode, eventType, [mouseX, mouseY]");
@@ -1021,7 +1998,11 @@ private:
 
         int pid = info[0].As<Napi::Number>().Int32Value();
         int keyCode = info[1].As<Napi::Number>().Int32Value();
-        std::string eventType = info[2].As<Napi::String>().Utf8Value();
+        char eventName[16];
+        KeyEvent keyEvent;
+        if (!ReadEventName(info[2], eventName) || !ParseKeyEvent(eventName, keyEvent)) {
+            return Napi::Boolean::New(env, false);
+        }
 
         // Optional mouse position for popup detection
         int mouseX = -1;
@@ -1032,49 +2013,33 @@ private:
         }
 
 #ifdef _WIN32
-        auto windows = FindWindowsByPid(pid);
+        const auto& windows = EventWindows(pid);
         if (windows.empty()) {
             return Napi::Boolean::New(env, false);
         }
 
-        WindowInfo* mainWindow = nullptr;
-        for (auto& win : windows) {
-            if (!win.isExtension) {
-                mainWindow = &win;
-                break;
-            }
-        }
-
-        if (!mainWindow) {
-            return Napi::Boolean::New(env, false);
-        }
-
         // Detect extension/popup windows if mouse position provided
-        HWND targetWindow = mainWindow->hwnd;
+        HWND targetWindow = windows[0].hwnd;
 
         if (mouseX >= 0 && mouseY >= 0) {
-            char debugMsg[512];
-            sprintf_s(debugMsg, "[Keyboard] PID %d: Mouse at (%d, %d), checking windows",
-                     pid, mouseX, mouseY);
-            OutputDebugStringA(debugMsg);
+            LOG_DEBUG("[Keyboard] PID " << pid << ": Mouse at (" << mouseX << ", " << mouseY
+                      << "), checking windows");
 
             // First check extension windows (independent windows like OKX Wallet)
             bool foundWindow = false;
-            for (auto& win : windows) {
+            for (const auto& win : windows) {
                 if (win.isExtension) {
                     RECT extRect;
                     GetWindowRect(win.hwnd, &extRect);
 
-                    sprintf_s(debugMsg, "[Keyboard]   Checking extension window bounds [%d, %d, %d, %d]",
-                             extRect.left, extRect.top, extRect.right, extRect.bottom);
-                    OutputDebugStringA(debugMsg);
+                    LOG_DEBUG("[Keyboard]   Checking extension window bounds [" << extRect.left << ", "
+                              << extRect.top << ", " << extRect.right << ", " << extRect.bottom << "]");
 
                     if (mouseX >= extRect.left && mouseX <= extRect.right &&
                         mouseY >= extRect.top && mouseY <= extRect.bottom) {
                         targetWindow = win.hwnd;
                         foundWindow = true;
-                        sprintf_s(debugMsg, "[Keyboard]   [OK] Mouse in extension window! Routing to extension");
-                        OutputDebugStringA(debugMsg);
+                        LOG_DEBUG("[Keyboard]   [OK] Mouse in extension window! Routing to extension");
                         break;
                     }
                 }
@@ -1082,32 +2047,29 @@ private:
 
             // If not in extension window, check popup windows (menus, dropdowns, etc.)
             if (!foundWindow) {
-                std::vector<HWND> popupWindows = FindPopupWindows(pid);
-                sprintf_s(debugMsg, "[Keyboard]   Found %zu popup windows", popupWindows.size());
-                OutputDebugStringA(debugMsg);
+                PopupWindows popupWindows;
+                FindPopupWindows(pid, popupWindows);
+                LOG_DEBUG("[Keyboard]   Found " << popupWindows.size() << " popup windows");
 
                 for (HWND popup : popupWindows) {
                     RECT popupRect;
                     GetWindowRect(popup, &popupRect);
 
-                    sprintf_s(debugMsg, "[Keyboard]   Checking popup bounds [%d, %d, %d, %d]",
-                             popupRect.left, popupRect.top, popupRect.right, popupRect.bottom);
-                    OutputDebugStringA(debugMsg);
+                    LOG_DEBUG("[Keyboard]   Checking popup bounds [" << popupRect.left << ", " << popupRect.top
+                              << ", " << popupRect.right << ", " << popupRect.bottom << "]");
 
                     if (mouseX >= popupRect.left && mouseX <= popupRect.right &&
                         mouseY >= popupRect.top && mouseY <= popupRect.bottom) {
                         targetWindow = popup;
                         foundWindow = true;
-                        sprintf_s(debugMsg, "[Keyboard]   [OK] Mouse in popup! Routing to popup window");
-                        OutputDebugStringA(debugMsg);
+                        LOG_DEBUG("[Keyboard]   [OK] Mouse in popup! Routing to popup window");
                         break;
                     }
                 }
             }
 
             if (!foundWindow) {
-                sprintf_s(debugMsg, "[Keyboard]   [X] Mouse not in any extension/popup, using main window");
-                OutputDebugStringA(debugMsg);
+                LOG_DEBUG("[Keyboard]   [X] Mouse not in any extension/popup, using main window");
             }
         }
 
@@ -1126,9 +2088,9 @@ private:
             lParam |= (1 << 24); // Set extended-key flag
         }
 
-        if (eventType == "keydown") {
+        if (keyEvent == KeyEvent::Down) {
             PostMessage(targetWindow, WM_KEYDOWN, keyCode, lParam);
-        } else if (eventType == "keyup") {
+        } else {
             lParam |= (1 << 30); // Previous key state (1 = key was down)
             lParam |= (1 << 31); // Transition state (1 = key is being released)
             PostMessage(targetWindow, WM_KEYUP, keyCode, lParam);
@@ -1136,7 +2098,7 @@ private:
 
 #elif __APPLE__
         CGEventRef event;
-        bool isKeyDown = (eventType == "keydown");
+        bool isKeyDown = (keyEvent == KeyEvent::Down);
 
         event = CGEventCreateKeyboardEvent(NULL, (CGKeyCode)keyCode, isKeyDown);
         if (event) {
@@ -1144,6 +2106,12 @@ private:
             CGEventPostToPid(pid, event);
             CFRelease(event);
         }
+#elif __linux__
+        // keyCode is an X keycode; the mouse position picks an extension window
+        if (!WindowControl().SendKeyEvent(pid, keyCode, keyEvent, mouseX, mouseY)) {
+            return Napi::Boolean::New(env, false);
+        }
+        WindowControl().Flush();
 #endif
 
         return Napi::Boolean::New(env, true);
@@ -1152,6 +2120,7 @@ private:
     // Send keyboard event to extension window by title
     Napi::Value SendKeyboardEventToExtension(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
+        auto inputLock = core_->LockInput();
 
         if (info.Length() < 4) {
             Napi::TypeError::New(env, "Wrong number of arguments: pid, windowTitle, keyCode, eventType");
@@ -1160,7 +2129,11 @@ private:
         int pid = info[0].As<Napi::Number>().Int32Value();
         std::string windowTitle = info[1].As<Napi::String>().Utf8Value();
         int keyCode = info[2].As<Napi::Number>().Int32Value();
-        std::string eventType = info[3].As<Napi::String>().Utf8Value();
+        char eventName[16];
+        KeyEvent keyEvent;
+        if (!ReadEventName(info[3], eventName) || !ParseKeyEvent(eventName, keyEvent)) {
+            return Napi::Boolean::New(env, false);
+        }
 
 #ifdef _WIN32
         auto windows = FindWindowsByPid(pid);
@@ -1199,9 +2172,9 @@ private:
             lParam |= (1 << 24); // Set extended-key flag
         }
 
-        if (eventType == "keydown") {
+        if (keyEvent == KeyEvent::Down) {
             PostMessage(targetWindow->hwnd, WM_KEYDOWN, keyCode, lParam);
-        } else if (eventType == "keyup") {
+        } else {
             lParam |= (1 << 30); // Previous key state (1 = key was down)
             lParam |= (1 << 31); // Transition state (1 = key is being released)
             PostMessage(targetWindow->hwnd, WM_KEYUP, keyCode, lParam);
@@ -1211,7 +2184,7 @@ private:
         // For macOS, we can't easily send keyboard events to specific windows
         // Fall back to global keyboard events
         CGEventRef event;
-        bool isKeyDown = (eventType == "keydown");
+        bool isKeyDown = (keyEvent == KeyEvent::Down);
 
         event = CGEventCreateKeyboardEvent(NULL, (CGKeyCode)keyCode, isKeyDown);
         if (event) {
@@ -1226,6 +2199,7 @@ private:
     // Send wheel event to window
     Napi::Value SendWheelEvent(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
+        auto inputLock = core_->LockInput();
 
         if (info.Length() < 3) {
             Napi::TypeError::New(env, "Wrong number of arguments: pid, deltaX, deltaY, [x, y]");
@@ -1254,23 +2228,11 @@ private:
         }
 
 #ifdef _WIN32
-        auto windows = FindWindowsByPid(pid);
+        const auto& windows = EventWindows(pid);
         if (windows.empty()) {
             return Napi::Boolean::New(env, false);
         }
 
-        WindowInfo* mainWindow = nullptr;
-        for (auto& win : windows) {
-            if (!win.isExtension) {
-                mainWindow = &win;
-                break;
-            }
-        }
-
-        if (!mainWindow) {
-            return Napi::Boolean::New(env, false);
-        }
-
         // Send wheel event
         // Note: deltaY is already multiplied by WHEEL_DELTA (120) in TypeScript
 
@@ -1279,7 +2241,7 @@ private:
         LPARAM lParam = MAKELPARAM(cursorX, cursorY);
 
         // Use SendMessage instead of PostMessage for better reliability
-        SendMessage(mainWindow->hwnd, WM_MOUSEWHEEL, wParam, lParam);
+        SendMessage(windows[0].hwnd, WM_MOUSEWHEEL, wParam, lParam);
 
 #elif __APPLE__
         CGEventRef event = CGEventCreateScrollWheelEvent(NULL, kCGScrollEventUnitPixel, 2, deltaY, deltaX);
@@ -1288,47 +2250,194 @@ private:
             CGEventPostToPid(pid, event);
             CFRelease(event);
         }
+#elif __linux__
+        if (!WindowControl().SendWheelEvent(pid, deltaX, deltaY, cursorX, cursorY)) {
+            return Napi::Boolean::New(env, false);
+        }
+        WindowControl().Flush();
 #endif
 
         return Napi::Boolean::New(env, true);
     }
 
-    // Check if any window from the given process is currently active (foreground)
-    Napi::Value IsProcessWindowActive(const Napi::CallbackInfo& info) {
+    // Type a different string into every slave at once:
+    // broadcastTemplatedText(slavePids, text, offsets, [{charDelayMs}]).
+    // text is a UTF-8 Uint8Array and offsets a Uint32Array (or array) of
+    // slavePids.length + 1 offsets into it; slave i gets bytes
+    // [offsets[i], offsets[i + 1]). Characters go to the focused field of
+    // each slave's main window. Resolves with {typed, characters, elapsedMs},
+    // the characters typed and given per slave.
+    Napi::Value BroadcastTemplatedText(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
 
-        if (info.Length() < 1) {
-            Napi::TypeError::New(env, "Wrong number of arguments: pid");
+        if (info.Length() < 3 || !info[0].IsArray() || !info[1].IsTypedArray() ||
+            info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array ||
+            !(info[2].IsArray() || (info[2].IsTypedArray() &&
+                                    info[2].As<Napi::TypedArray>().TypedArrayType() == napi_uint32_array))) {
+            Napi::TypeError::New(env, "Wrong number of arguments: slavePids, text (Uint8Array), offsets, [options]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
         }
 
-        int pid = info[0].As<Napi::Number>().Int32Value();
-
-#ifdef _WIN32
-        // Get the current foreground window
-        HWND foregroundWindow = GetForegroundWindow();
-        if (!foregroundWindow) {
-            return Napi::Boolean::New(env, false);
+        std::vector<int> pids = ToPidVector(info[0].As<Napi::Array>());
+        std::vector<uint32_t> offsets;
+        if (info[2].IsTypedArray()) {
+            Napi::Uint32Array array = info[2].As<Napi::Uint32Array>();
+            offsets.assign(array.Data(), array.Data() + array.ElementLength());
+        } else {
+            Napi::Array array = info[2].As<Napi::Array>();
+            offsets.reserve(array.Length());
+            for (uint32_t i = 0; i < array.Length(); i++) {
+                offsets.push_back(array.Get(i).As<Napi::Number>().Uint32Value());
+            }
+        }
+        if (offsets.size() != pids.size() + 1) {
+            Napi::RangeError::New(env, "Expected one offset more than there are slaves").ThrowAsJavaScriptException();
+            return env.Null();
         }
 
-        // Get the process ID of the foreground window
-        DWORD foregroundPid = 0;
-        GetWindowThreadProcessId(foregroundWindow, &foregroundPid);
-
-        // Check if it matches our target PID
-        bool isActive = (foregroundPid == static_cast<DWORD>(pid));
+        int charDelayMs = 0;
+        if (info.Length() >= 4 && info[3].IsObject()) {
+            charDelayMs = GetIntOption(info[3].As<Napi::Object>(), "charDelayMs", 0);
+        }
+        if (charDelayMs < 0) {
+            Napi::RangeError::New(env, "charDelayMs must not be negative").ThrowAsJavaScriptException();
+            return env.Null();
+        }
 
-        return Napi::Boolean::New(env, isActive);
+        Napi::Uint8Array text = info[1].As<Napi::Uint8Array>();
+        std::vector<std::u32string> texts;
+        std::string error;
+        if (!SplitTextColumn(text.Data(), text.ByteLength(), offsets.data(), pids.size(), texts, error)) {
+            Napi::RangeError::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
 
-#elif __APPLE__
-        // Get the active application
-        @autoreleasepool {
-            NSRunningApplication* frontApp = [[NSWorkspace sharedWorkspace] frontmostApplication];
-            if (!frontApp) {
-                return Napi::Boolean::New(env, false);
+        TextTyper::Job job;
+        job.interval = std::chrono::milliseconds(charDelayMs);
+        auto core = core_;
+#ifdef __linux__
+        // Typed through a keymap of its own, so on a connection of its own
+        if (!textControl_) {
+            textControl_ = std::make_shared<X11WindowControl>(core_);
+        }
+        auto control = textControl_;
+        job.begin = [control](const std::vector<std::u32string>& strings) { control->PrepareKeymap(strings); };
+        job.end = [control] { control->RestoreKeymap(); };
+        job.type = [core, control, pids](size_t slave, char32_t codepoint) {
+            // Held per character so mirrored events can go in between
+            auto inputLock = core->LockInput();
+            if (!control->TypeCharacter(pids[slave], codepoint)) {
+                return false;
+            }
+            control->Flush();
+            return true;
+        };
+#else
+        // Windows are looked up here, the typer only posts to them
+        std::vector<TextTarget> targets;
+        targets.reserve(pids.size());
+        for (int pid : pids) {
+#ifdef _WIN32
+            const auto& windows = EventWindows(pid);
+            targets.push_back(windows.empty() ? nullptr : windows[0].hwnd);
+#else
+            targets.push_back(pid);
+#endif
+        }
+        job.type = [core, targets](size_t slave, char32_t codepoint) {
+            auto inputLock = core->LockInput();
+            return PostCharacter(targets[slave], codepoint);
+        };
+#endif
+
+        std::vector<double> characters;
+        characters.reserve(texts.size());
+        for (const auto& string : texts) {
+            characters.push_back(static_cast<double>(string.size()));
+        }
+        job.texts = std::move(texts);
+
+        std::shared_ptr<PromiseSettler::Ticket> ticket;
+        Napi::Promise promise = Promises(env).Add(env, ticket);
+        job.done = [ticket, characters](std::vector<int> typedCounts, double elapsedMs) {
+            ticket->Settle([typedCounts, characters, elapsedMs](Napi::Env env, Napi::Promise::Deferred& deferred) {
+                Napi::Array typed = Napi::Array::New(env, typedCounts.size());
+                Napi::Array given = Napi::Array::New(env, characters.size());
+                for (size_t i = 0; i < characters.size(); i++) {
+                    typed.Set(static_cast<uint32_t>(i), Napi::Number::New(env, typedCounts[i]));
+                    given.Set(static_cast<uint32_t>(i), Napi::Number::New(env, characters[i]));
+                }
+                Napi::Object result = Napi::Object::New(env);
+                result.Set("typed", typed);
+                result.Set("characters", given);
+                result.Set("elapsedMs", Napi::Number::New(env, elapsedMs));
+                deferred.Resolve(result);
+            });
+        };
+
+        if (!textTyper_) {
+            textTyper_ = std::make_unique<TextTyper>();
+        }
+        textTyper_->Post(std::move(job));
+        return promise;
+    }
+
+    // Check if any window from the given process is currently active (foreground)
+    Napi::Value IsProcessWindowActive(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pid");
+        }
+
+        int pid = info[0].As<Napi::Number>().Int32Value();
+
+        // Answered from the focus-change watcher where there is one: a
+        // repeated question is two atomic loads until the focus moves
+        if (ForegroundTracker* tracker = core_->Foreground()) {
+            uint64_t generation = tracker->Generation();
+            int activePid = tracker->ActivePid();
+            auto now = std::chrono::steady_clock::now();
+            // A miss is re-checked once the process index may have caught
+            // up with a newly started child
+            bool fresh = activeCache_.generation == generation && activeCache_.root == pid &&
+                         (activeCache_.active || now - activeCache_.checked < ProcessTree::kRefreshInterval);
+            if (!fresh) {
+                activeCache_.root = pid;
+                activeCache_.generation = generation;
+                activeCache_.checked = now;
+                activeCache_.active = activePid != 0 && ProcessTree::Shared().Contains(pid, activePid);
+            }
+            return Napi::Boolean::New(env, activeCache_.active);
+        }
+
+#ifdef _WIN32
+        // Get the current foreground window
+        HWND foregroundWindow = GetForegroundWindow();
+        if (!foregroundWindow) {
+            return Napi::Boolean::New(env, false);
+        }
+
+        // Get the process ID of the foreground window
+        DWORD foregroundPid = 0;
+        GetWindowThreadProcessId(foregroundWindow, &foregroundPid);
+
+        // Check if it belongs to our target process tree
+        bool isActive = ProcessTree::Shared().Contains(pid, static_cast<int>(foregroundPid));
+
+        return Napi::Boolean::New(env, isActive);
+
+#elif __APPLE__
+        // Get the active application
+        @autoreleasepool {
+            NSRunningApplication* frontApp = [[NSWorkspace sharedWorkspace] frontmostApplication];
+            if (!frontApp) {
+                return Napi::Boolean::New(env, false);
             }
 
             pid_t frontPid = [frontApp processIdentifier];
-            bool isActive = (frontPid == pid);
+            bool isActive = ProcessTree::Shared().Contains(pid, frontPid);
 
             return Napi::Boolean::New(env, isActive);
         }
@@ -1337,10 +2446,451 @@ private:
 #endif
     }
 
+    // Call callback({pid, previousPid}) whenever the foreground window moves
+    // to another process (pid 0 when unknown); null unsubscribes. Returns
+    // false where focus changes are not tracked natively.
+    Napi::Value OnFocusChange(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !(info[0].IsFunction() || info[0].IsNull())) {
+            Napi::TypeError::New(env, "Wrong number of arguments: callback").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        ClearFocusListener();
+        ForegroundTracker* tracker = core_->Foreground();
+        if (!tracker) {
+            return Napi::Boolean::New(env, false);
+        }
+        if (info[0].IsNull()) {
+            return Napi::Boolean::New(env, true);
+        }
+
+        focusCallback_ = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "FocusChange", 0, 1);
+        focusCallback_.Unref(env);
+
+        Napi::ThreadSafeFunction tsfn = focusCallback_;
+        focusListener_ = tracker->AddListener([tsfn](int pid, int previousPid) mutable {
+            auto* payload = new std::pair<int, int>(pid, previousPid);
+            napi_status status = tsfn.NonBlockingCall(
+                payload, [](Napi::Env env, Napi::Function callback, std::pair<int, int>* data) {
+                    std::unique_ptr<std::pair<int, int>> owned(data);
+                    if (env != nullptr && callback != nullptr) {
+                        Napi::Object change = Napi::Object::New(env);
+                        change.Set("pid", Napi::Number::New(env, owned->first));
+                        change.Set("previousPid", Napi::Number::New(env, owned->second));
+                        callback.Call({change});
+                    }
+                });
+            if (status != napi_ok) {
+                delete payload;
+            }
+        });
+
+        return Napi::Boolean::New(env, true);
+    }
+
+    void ClearFocusListener() {
+        if (focusCallback_) {
+            // Once removed the watcher no longer calls into the function
+            core_->Foreground()->RemoveListener(focusListener_);
+            focusCallback_.Release();
+            focusCallback_ = Napi::ThreadSafeFunction();
+        }
+    }
+
+    // Resolve with the first window of pid (or any process it started) of the
+    // given kind ('main', 'extension' or 'any') as soon as it is shown, or
+    // with null after timeoutMs. Driven by window creation notifications;
+    // where there are none (macOS) the promise resolves null straight away.
+    Napi::Value WaitForWindow(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pid, [options]").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        int pid = info[0].As<Napi::Number>().Int32Value();
+        WindowKind kind = WindowKind::Main;
+        int timeoutMs = 30000;
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Object options = info[1].As<Napi::Object>();
+            timeoutMs = std::max(0, GetIntOption(options, "timeoutMs", timeoutMs));
+            Napi::Value kindValue = options.Get("kind");
+            if (kindValue.IsString()) {
+                std::string name = kindValue.As<Napi::String>().Utf8Value();
+                if (name == "extension") {
+                    kind = WindowKind::Extension;
+                } else if (name == "any") {
+                    kind = WindowKind::Unknown;
+                } else if (name != "main") {
+                    Napi::TypeError::New(env, "Unknown window kind: " + name).ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+            }
+        }
+
+        if (!windowWatcher_) {
+            // Started once; a watcher that cannot run fails every wait at once
+            windowWatcher_ = std::make_unique<WindowWatcher>(core_);
+            windowWatcher_->Start();
+        }
+
+        // A pending wait keeps the event loop alive like a timer. The settler
+        // owns the Deferred, so it is settled or freed whatever happens.
+        std::shared_ptr<PromiseSettler::Ticket> ticket;
+        Napi::Promise promise = Promises(env).Add(env, ticket);
+        windowWatcher_->Wait(pid, kind, std::chrono::milliseconds(timeoutMs),
+                             [ticket](bool found, const WindowWatcher::Window& window) {
+            ticket->Settle([found, window](Napi::Env env, Napi::Promise::Deferred& deferred) {
+                if (!found) {
+                    deferred.Resolve(env.Null());
+                    return;
+                }
+                Napi::Object result = Napi::Object::New(env);
+                result.Set("handle", Napi::Number::New(env, static_cast<double>(window.handle)));
+                result.Set("isExtension", Napi::Boolean::New(env, window.isExtension));
+                result.Set("x", Napi::Number::New(env, window.x));
+                result.Set("y", Napi::Number::New(env, window.y));
+                result.Set("width", Napi::Number::New(env, window.width));
+                result.Set("height", Napi::Number::New(env, window.height));
+                deferred.Resolve(result);
+            });
+        });
+        return promise;
+    }
+
+    // pid and every process it started, as used by all window lookups.
+    // Pass refresh: true to re-read the process table instead of using the cache.
+    Napi::Value GetProcessTree(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pid, [refresh]").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        int pid = info[0].As<Napi::Number>().Int32Value();
+        if (info.Length() >= 2 && info[1].ToBoolean().Value()) {
+            ProcessTree::Shared().Refresh();
+        }
+
+        auto tree = ProcessTree::Shared().Descendants(pid);
+        std::vector<int> pids(tree->begin(), tree->end());
+        std::sort(pids.begin(), pids.end());
+
+        Napi::Array result = Napi::Array::New(env, pids.size());
+        for (size_t i = 0; i < pids.size(); i++) {
+            result.Set(static_cast<uint32_t>(i), Napi::Number::New(env, pids[i]));
+        }
+        return result;
+    }
+
+    // {nice, ioClass: 'none'|'realtime'|'best-effort'|'idle', ioLevel, cpus,
+    // cpuWeight, cpuMaxPercent}; absent fields stay unset. False (with a
+    // pending TypeError) for an unknown I/O class.
+    static bool ReadSchedulingPolicy(Napi::Env env, const Napi::Object& options, SchedulingPolicy& policy) {
+        policy.nice = GetIntOption(options, "nice", policy.nice);
+        policy.cpuWeight = GetIntOption(options, "cpuWeight", policy.cpuWeight);
+        policy.cpuMaxPercent = GetIntOption(options, "cpuMaxPercent", policy.cpuMaxPercent);
+        policy.ioLevel = GetIntOption(options, "ioLevel", policy.ioLevel);
+
+        Napi::Value ioClass = options.Get("ioClass");
+        if (ioClass.IsString()) {
+            static const char* const kIoClasses[] = {"none", "realtime", "best-effort", "idle"};
+            std::string name = ioClass.As<Napi::String>().Utf8Value();
+            for (int i = 0; i < 4; i++) {
+                if (name == kIoClasses[i]) {
+                    policy.ioClass = i;
+                }
+            }
+            if (policy.ioClass == SchedulingPolicy::kUnset) {
+                Napi::TypeError::New(env, "Unknown I/O class: " + name).ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+
+        Napi::Value cpus = options.Get("cpus");
+        if (cpus.IsArray()) {
+            policy.cpus = ToPidVector(cpus.As<Napi::Array>());
+        }
+        return true;
+    }
+
+    ProcessScheduler& Scheduler() {
+        if (!scheduler_) {
+            scheduler_ = std::make_unique<ProcessScheduler>(core_);
+        }
+        return *scheduler_;
+    }
+
+    // Schedule pid and every process it starts by the given policy. Returns
+    // {processes, failed}: processes it was applied to, settings that failed.
+    Napi::Value SetProcessPolicy(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsObject()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pid, policy").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        SchedulingPolicy policy;
+        if (!ReadSchedulingPolicy(env, info[1].As<Napi::Object>(), policy)) {
+            return env.Null();
+        }
+
+        int failed = 0;
+        int processes = Scheduler().SetPolicy(info[0].As<Napi::Number>().Int32Value(), policy, failed);
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("processes", Napi::Number::New(env, processes));
+        result.Set("failed", Napi::Number::New(env, failed));
+        return result;
+    }
+
+    // Put the processes of pid back to default scheduling
+    Napi::Value ClearProcessPolicy(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pid").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        bool cleared = scheduler_ && scheduler_->ClearPolicy(info[0].As<Napi::Number>().Int32Value());
+        return Napi::Boolean::New(env, cleared);
+    }
+
+    // Policy laid over the scheduled profile owning the focused window, or
+    // null to stop boosting. False where focus changes are not tracked.
+    Napi::Value SetForegroundBoost(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !(info[0].IsObject() || info[0].IsNull())) {
+            Napi::TypeError::New(env, "Wrong number of arguments: policy").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        SchedulingPolicy boost;
+        if (info[0].IsObject() && !ReadSchedulingPolicy(env, info[0].As<Napi::Object>(), boost)) {
+            return env.Null();
+        }
+        return Napi::Boolean::New(env, Scheduler().SetForegroundBoost(boost));
+    }
+
+    // {cgroupRoot}: a delegated cgroup v2 directory for cpuWeight and
+    // cpuMaxPercent on Linux. Returns false when it cannot be used.
+    Napi::Value SetSchedulingOptions(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsObject()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: options").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        Napi::Value cgroupRoot = info[0].As<Napi::Object>().Get("cgroupRoot");
+        if (cgroupRoot.IsString()) {
+            return Napi::Boolean::New(env, Scheduler().SetCgroupRoot(cgroupRoot.As<Napi::String>().Utf8Value()));
+        }
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value GetSchedulingStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        SchedulingStats stats = scheduler_ ? scheduler_->Stats() : SchedulingStats();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("profiles", Napi::Number::New(env, stats.profiles));
+        result.Set("processes", Napi::Number::New(env, stats.processes));
+        result.Set("applied", Napi::Number::New(env, static_cast<double>(stats.applied)));
+        result.Set("failed", Napi::Number::New(env, static_cast<double>(stats.failed)));
+        result.Set("boostedPid", Napi::Number::New(env, stats.boostedPid));
+        result.Set("cgroups", Napi::Boolean::New(env, stats.cgroups));
+        return result;
+    }
+
+    // 'pageout' (the default) or 'cold'; false with a pending TypeError for
+    // anything else
+    static bool ReadReclaimMode(Napi::Env env, const Napi::Value& options, ReclaimMode& mode) {
+        mode = ReclaimMode::Pageout;
+        if (!options.IsObject()) {
+            return true;
+        }
+        Napi::Value value = options.As<Napi::Object>().Get("mode");
+        if (!value.IsString()) {
+            return true;
+        }
+        std::string name = value.As<Napi::String>().Utf8Value();
+        if (name == "cold") {
+            mode = ReclaimMode::Cold;
+        } else if (name != "pageout") {
+            Napi::TypeError::New(env, "Unknown reclaim mode: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+        return true;
+    }
+
+    // Page out the memory of pid and every process it started. Resolves with
+    // {processes, failed, rssBefore, rssAfter, reclaimedBytes, elapsedMs}.
+    Napi::Value ReclaimMemory(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pid, [options]").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        ReclaimMode mode;
+        if (!ReadReclaimMode(env, info.Length() >= 2 ? info[1] : env.Undefined(), mode)) {
+            return env.Null();
+        }
+
+        auto* worker = new ReclaimWorker(env, info[0].As<Napi::Number>().Int32Value(), mode);
+        Napi::Promise promise = worker->Promise();
+        worker->Queue();
+        return promise;
+    }
+
+    // Reclaim each of pids once it has gone idleMs without the focused
+    // window: setAutoReclaim(pids, {idleMs, mode}). An empty list stops it.
+    Napi::Value SetAutoReclaim(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsArray() || !info[1].IsObject()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids, {idleMs, [mode]}")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        int idleMs = GetIntOption(info[1].As<Napi::Object>(), "idleMs", 0);
+        if (idleMs <= 0) {
+            Napi::RangeError::New(env, "idleMs must be positive").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        ReclaimMode mode;
+        if (!ReadReclaimMode(env, info[1], mode)) {
+            return env.Null();
+        }
+
+        if (!reclaimer_) {
+            reclaimer_ = std::make_unique<MemoryReclaimer>(core_);
+        }
+        reclaimer_->SetProfiles(ToPidVector(info[0].As<Napi::Array>()), std::chrono::milliseconds(idleMs), mode);
+        return env.Undefined();
+    }
+
+    Napi::Value GetReclaimStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        ReclaimStats stats = reclaimer_ ? reclaimer_->Stats() : ReclaimStats();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("profiles", Napi::Number::New(env, stats.profiles));
+        result.Set("reclaims", Napi::Number::New(env, static_cast<double>(stats.reclaims)));
+        result.Set("reclaimedBytes", Napi::Number::New(env, static_cast<double>(stats.reclaimedBytes)));
+        result.Set("failed", Napi::Number::New(env, static_cast<double>(stats.failed)));
+        result.Set("lastReclaimMs", Napi::Number::New(env, stats.lastReclaimMs));
+        return result;
+    }
+
+    // State of the process-wide core shared with other workers
+    Napi::Value GetCoreStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+#ifdef __linux__
+        // Heap allocations made so far by this thread, when the process runs
+        // with the alloc-counter.so preload (see alloc-counter.cpp). Read
+        // before building the result so that is not counted.
+        using ThreadAllocations = uint64_t (*)();
+        static auto threadAllocations =
+            reinterpret_cast<ThreadAllocations>(dlsym(RTLD_DEFAULT, "cp_thread_allocations"));
+        uint64_t allocations = threadAllocations ? threadAllocations() : 0;
+#endif
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("environments", Napi::Number::New(env, core_->Environments()));
+        result.Set("references", Napi::Number::New(env, static_cast<double>(core_.use_count())));
+#ifdef __linux__
+        if (threadAllocations) {
+            result.Set("threadAllocations", Napi::Number::New(env, static_cast<double>(allocations)));
+        }
+#endif
+        return result;
+    }
+
+    static Napi::Array LogRecordsToJs(Napi::Env env, const std::vector<LogRecord>& records) {
+        Napi::Array result = Napi::Array::New(env, records.size());
+        for (size_t i = 0; i < records.size(); i++) {
+            const LogRecord& record = records[i];
+            Napi::Object item = Napi::Object::New(env);
+            item.Set("level", Napi::String::New(env, LogLevelName(record.level)));
+            item.Set("message", Napi::String::New(env, record.message));
+            item.Set("file", Napi::String::New(env, record.file));
+            item.Set("line", Napi::Number::New(env, record.line));
+            item.Set("time", Napi::Number::New(env, static_cast<double>(record.timeMs)));
+            item.Set("suppressed", Napi::Number::New(env, record.suppressed));
+            result.Set(static_cast<uint32_t>(i), item);
+        }
+        return result;
+    }
+
+    // Send native log lines to callback(records) instead of stderr. Records
+    // are {level, message, file, line, time, suppressed}, batched by the log
+    // flush thread. The logger is process-wide, so the last sink set wins;
+    // pass null to go back to stderr. options.level is the lowest level
+    // reported ('debug' only exists in builds with CP_LOG_MIN_LEVEL=0).
+    Napi::Value SetLogSink(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !(info[0].IsFunction() || info[0].IsNull())) {
+            Napi::TypeError::New(env, "Wrong number of arguments: callback, [options]").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Value level = info[1].As<Napi::Object>().Get("level");
+            if (level.IsString()) {
+                LogLevel parsed;
+                if (!ParseLogLevel(level.As<Napi::String>().Utf8Value(), parsed)) {
+                    Napi::TypeError::New(env, "Unknown log level").ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+                NativeLog::SetLevel(parsed);
+            }
+        }
+
+        ClearLogSink();
+        if (info[0].IsNull()) {
+            return env.Undefined();
+        }
+
+        logSink_ = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "NativeLogSink", 0, 1);
+        // Do not keep the event loop alive just for logging
+        logSink_.Unref(env);
+
+        Napi::ThreadSafeFunction tsfn = logSink_;
+        logSinkId_ = NativeLog::SetSink([tsfn](std::vector<LogRecord> records) mutable {
+            auto* payload = new std::vector<LogRecord>(std::move(records));
+            napi_status status = tsfn.NonBlockingCall(
+                payload, [](Napi::Env env, Napi::Function callback, std::vector<LogRecord>* data) {
+                    std::unique_ptr<std::vector<LogRecord>> owned(data);
+                    if (env != nullptr && callback != nullptr) {
+                        callback.Call({LogRecordsToJs(env, *owned)});
+                    }
+                });
+            if (status != napi_ok) {
+                delete payload;
+            }
+        });
+
+        return env.Undefined();
+    }
+
+    void ClearLogSink() {
+        if (logSink_) {
+            // Once cleared the flush thread no longer calls into the function
+            NativeLog::ClearSink(logSinkId_);
+            logSink_.Release();
+            logSink_ = Napi::ThreadSafeFunction();
+        }
+    }
+
     // Send mouse event with popup window matching
     // This finds and matches popup windows between master and slave processes
     Napi::Value SendMouseEventWithPopupMatching(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
+        auto inputLock = core_->LockInput();
 
         if (info.Length() < 5) {
             Napi::TypeError::New(env, "Wrong number of arguments: masterPid, slavePid, x, y, eventType");
@@ -1350,47 +2900,33 @@ private:
         int slavePid = info[1].As<Napi::Number>().Int32Value();
         int x = info[2].As<Napi::Number>().Int32Value();
         int y = info[3].As<Napi::Number>().Int32Value();
-        std::string eventType = info[4].As<Napi::String>().Utf8Value();
+        char eventName[16];
+        PointerEvent pointerEvent;
+        if (!ReadEventName(info[4], eventName) || !ParsePointerEvent(eventName, pointerEvent)) {
+            return Napi::Boolean::New(env, false);
+        }
 
 #ifdef _WIN32
         // Find main windows
-        auto masterWindows = FindWindowsByPid(masterPid);
-        auto slaveWindows = FindWindowsByPid(slavePid);
+        const auto& masterWindows = EventWindows(masterPid);
+        const auto& slaveWindows = EventWindows(slavePid);
 
         if (masterWindows.empty() || slaveWindows.empty()) {
             return Napi::Boolean::New(env, false);
         }
 
-        WindowInfo* masterMainWindow = nullptr;
-        WindowInfo* slaveMainWindow = nullptr;
-
-        for (auto& win : masterWindows) {
-            if (!win.isExtension) {
-                masterMainWindow = &win;
-                break;
-            }
-        }
-
-        for (auto& win : slaveWindows) {
-            if (!win.isExtension) {
-                slaveMainWindow = &win;
-                break;
-            }
-        }
-
-        if (!masterMainWindow || !slaveMainWindow) {
-            return Napi::Boolean::New(env, false);
-        }
+        const WindowInfo* masterMainWindow = &masterWindows[0];
+        const WindowInfo* slaveMainWindow = &slaveWindows[0];
 
         // Find popup windows
-        std::vector<HWND> masterPopups = FindPopupWindows(masterPid);
-        std::vector<HWND> slavePopups = FindPopupWindows(slavePid);
+        PopupWindows masterPopups;
+        PopupWindows slavePopups;
+        FindPopupWindows(masterPid, masterPopups);
+        FindPopupWindows(slavePid, slavePopups);
 
         // Debug: Log popup window counts
-        char debugMsg[256];
-        sprintf_s(debugMsg, "[C++] Found %zu master popups, %zu slave popups for event '%s'",
-                 masterPopups.size(), slavePopups.size(), eventType.c_str());
-        OutputDebugStringA(debugMsg);
+        LOG_DEBUG("Found " << masterPopups.size() << " master popups, " << slavePopups.size()
+                  << " slave popups for event '" << eventName << "'");
 
         // Check if click is on a master popup window
         HWND masterClickedPopup = nullptr;
@@ -1401,8 +2937,7 @@ private:
             if (x >= popupRect.left && x <= popupRect.right &&
                 y >= popupRect.top && y <= popupRect.bottom) {
                 masterClickedPopup = popup;
-                sprintf_s(debugMsg, "[C++] Click on master popup at (%d, %d)", x, y);
-                OutputDebugStringA(debugMsg);
+                LOG_DEBUG("Click on master popup at (" << x << ", " << y << ")");
                 break;
             }
         }
@@ -1464,7 +2999,7 @@ private:
         // - Wait for Chrome to process and call GetCursorPos()
         // - Restore cursor to original position
         // This is called separately for each slave window
-        bool isRightClick = (eventType == "rightdown" || eventType == "rightup");
+        bool isRightClick = (pointerEvent == PointerEvent::RightDown || pointerEvent == PointerEvent::RightUp);
 
         POINT originalCursorPos;
         if (isRightClick) {
@@ -1478,19 +3013,18 @@ private:
             // Chrome calls GetCursorPos() when handling right-click events
             Sleep(15);
 
-            sprintf_s(debugMsg, "[C++] Moved cursor from (%ld, %ld) to (%d, %d) for %s",
-                     originalCursorPos.x, originalCursorPos.y, targetX, targetY, eventType.c_str());
-            OutputDebugStringA(debugMsg);
+            LOG_DEBUG("Moved cursor from (" << originalCursorPos.x << ", " << originalCursorPos.y << ") to ("
+                      << targetX << ", " << targetY << ") for " << eventName);
         }
 
         // Send event - use SendMessage (synchronous) for right-click to ensure processing
-        if (eventType == "mousemove") {
+        if (pointerEvent == PointerEvent::Move) {
             PostMessage(targetWindow, WM_MOUSEMOVE, 0, lParam);
-        } else if (eventType == "mousedown") {
+        } else if (pointerEvent == PointerEvent::LeftDown) {
             PostMessage(targetWindow, WM_LBUTTONDOWN, MK_LBUTTON, lParam);
-        } else if (eventType == "mouseup") {
+        } else if (pointerEvent == PointerEvent::LeftUp) {
             PostMessage(targetWindow, WM_LBUTTONUP, 0, lParam);
-        } else if (eventType == "rightdown") {
+        } else if (pointerEvent == PointerEvent::RightDown) {
             // Use SendMessage (sync) to ensure message is processed before continuing
             SendMessage(targetWindow, WM_RBUTTONDOWN, MK_RBUTTON, lParam);
 
@@ -1498,10 +3032,9 @@ private:
             Sleep(10);
             SetCursorPos(originalCursorPos.x, originalCursorPos.y);
 
-            sprintf_s(debugMsg, "[C++] Sent WM_RBUTTONDOWN, restored cursor to (%ld, %ld)",
-                     originalCursorPos.x, originalCursorPos.y);
-            OutputDebugStringA(debugMsg);
-        } else if (eventType == "rightup") {
+            LOG_DEBUG("Sent WM_RBUTTONDOWN, restored cursor to (" << originalCursorPos.x << ", "
+                      << originalCursorPos.y << ")");
+        } else {
             // Use SendMessage (sync) to ensure message is processed
             SendMessage(targetWindow, WM_RBUTTONUP, 0, lParam);
 
@@ -1512,11 +3045,8 @@ private:
 
             SetCursorPos(originalCursorPos.x, originalCursorPos.y);
 
-            sprintf_s(debugMsg, "[C++] Restored cursor to (%ld, %ld) after rightup + 50ms delay",
-                     originalCursorPos.x, originalCursorPos.y);
-            OutputDebugStringA(debugMsg);
-        } else {
-            return Napi::Boolean::New(env, false);
+            LOG_DEBUG("Restored cursor to (" << originalCursorPos.x << ", " << originalCursorPos.y
+                      << ") after rightup + 50ms delay");
         }
 
 #elif __APPLE__
@@ -1526,6 +3056,1058 @@ private:
 
         return Napi::Boolean::New(env, true);
     }
+
+    // Start capturing thumbnails of the main window of every pid.
+    // Frames are written into a pool owned by the returned SharedArrayBuffer:
+    // slot i (at i * slotSize) holds pids[i], see ThumbnailSlotHeader for the layout.
+    Napi::Value StartThumbnailCapture(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids, [options]").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::vector<int> pids = ToPidVector(info[0].As<Napi::Array>());
+        ThumbnailOptions options;
+        size_t slotCount = pids.size();
+
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Object opts = info[1].As<Napi::Object>();
+            options.width = GetIntOption(opts, "width", options.width);
+            options.height = GetIntOption(opts, "height", options.height);
+            options.intervalMs = GetIntOption(opts, "intervalMs", options.intervalMs);
+            options.maxAgeMs = GetIntOption(opts, "maxAgeMs", options.maxAgeMs);
+            // Reserve extra slots so targets can be added later without reallocating
+            slotCount = std::max(slotCount, static_cast<size_t>(std::max(GetIntOption(opts, "slots", 0), 0)));
+        }
+
+        if (options.width <= 0 || options.height <= 0 || options.width > 2048 || options.height > 2048) {
+            Napi::RangeError::New(env, "Thumbnail size must be between 1 and 2048").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (slotCount == 0) {
+            Napi::RangeError::New(env, "No pids or slots given").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        StopThumbnailCaptureInternal();
+
+        // A SharedArrayBuffer cannot be detached: transferring it throws and
+        // posting it to a worker shares the memory the capture thread writes
+        // into, where an ArrayBuffer would move it out from under the thread.
+        // N-API has no constructor for one, so it comes from the global.
+        size_t slotSize = ThumbnailPool::SlotSizeFor(options.width, options.height);
+        Napi::Value sharedCtor = env.Global().Get("SharedArrayBuffer");
+        if (!sharedCtor.IsFunction()) {
+            Napi::Error::New(env, "SharedArrayBuffer is not available").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        Napi::Object buffer =
+            sharedCtor.As<Napi::Function>().New({Napi::Number::New(env, static_cast<double>(slotCount * slotSize))});
+        if (env.IsExceptionPending()) {
+            return env.Null();
+        }
+        // The pointer is read through a view, napi_get_arraybuffer_info only
+        // takes ArrayBuffers
+        Napi::Value view = env.Global().Get("Uint8Array").As<Napi::Function>().New({buffer});
+        if (env.IsExceptionPending() || !view.IsTypedArray()) {
+            return env.Null();
+        }
+        Napi::Uint8Array bytes = view.As<Napi::Uint8Array>();
+        thumbnailBuffer_ = Napi::Persistent(bytes);
+        thumbnailCapture_ = std::make_unique<ThumbnailCapture>(options, bytes.Data(), slotCount);
+        thumbnailCapture_->SetTargets(pids);
+        thumbnailCapture_->Start();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("buffer", buffer);
+        result.Set("slotCount", Napi::Number::New(env, static_cast<double>(slotCount)));
+        result.Set("slotSize", Napi::Number::New(env, static_cast<double>(slotSize)));
+        result.Set("headerSize", Napi::Number::New(env, sizeof(ThumbnailSlotHeader)));
+        result.Set("width", Napi::Number::New(env, options.width));
+        result.Set("height", Napi::Number::New(env, options.height));
+        return result;
+    }
+
+    // Replace the captured pids without reallocating the pool
+    Napi::Value SetThumbnailTargets(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!thumbnailCapture_) {
+            return Napi::Boolean::New(env, false);
+        }
+
+        std::vector<int> pids = ToPidVector(info[0].As<Napi::Array>());
+        thumbnailCapture_->SetTargets(pids);
+        return Napi::Boolean::New(env, pids.size() <= thumbnailCapture_->Pool().SlotCount());
+    }
+
+    Napi::Value RefreshThumbnails(const Napi::CallbackInfo& info) {
+        if (thumbnailCapture_) {
+            thumbnailCapture_->RequestRefresh();
+        }
+        return info.Env().Undefined();
+    }
+
+    Napi::Value StopThumbnailCapture(const Napi::CallbackInfo& info) {
+        StopThumbnailCaptureInternal();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value GetThumbnailStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object result = Napi::Object::New(env);
+        ThumbnailStats stats = thumbnailCapture_ ? thumbnailCapture_->Stats() : ThumbnailStats();
+
+        result.Set("running", Napi::Boolean::New(env, thumbnailCapture_ != nullptr));
+        result.Set("cycles", Napi::Number::New(env, static_cast<double>(stats.cycles)));
+        result.Set("framesCaptured", Napi::Number::New(env, static_cast<double>(stats.framesCaptured)));
+        result.Set("framesSkipped", Napi::Number::New(env, static_cast<double>(stats.framesSkipped)));
+        result.Set("captureErrors", Napi::Number::New(env, static_cast<double>(stats.captureErrors)));
+        result.Set("lastCycleMs", Napi::Number::New(env, stats.lastCycleMs));
+        result.Set("damageTracking", Napi::Boolean::New(env, stats.damageTracking));
+        return result;
+    }
+
+    void StopThumbnailCaptureInternal() {
+        // Join the capture thread before releasing the buffer it writes into
+        thumbnailCapture_.reset();
+        thumbnailBuffer_.Reset();
+    }
+
+    // Sample CPU and memory of every profile's process tree in the
+    // background. Slot i holds pids[i]; returns {slotCount, history, stride,
+    // fields}, fields naming the columns of a row.
+    Napi::Value StartProfileSampler(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids, [options]").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::vector<int> pids = ToPidVector(info[0].As<Napi::Array>());
+        ProfileSamplerOptions options;
+        size_t slotCount = pids.size();
+        int history = static_cast<int>(options.history);
+
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Object opts = info[1].As<Napi::Object>();
+            options.intervalMs = GetIntOption(opts, "intervalMs", options.intervalMs);
+            history = GetIntOption(opts, "history", history);
+            Napi::Value pss = opts.Get("pss");
+            options.pss = !pss.IsBoolean() || pss.As<Napi::Boolean>().Value();
+            // Reserve extra slots so profiles can be added later without reallocating
+            slotCount = std::max(slotCount, static_cast<size_t>(std::max(GetIntOption(opts, "slots", 0), 0)));
+        }
+
+        if (options.intervalMs < 10) {
+            Napi::RangeError::New(env, "Sampling interval must be at least 10 ms").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (history < 1 || history > 3600) {
+            Napi::RangeError::New(env, "History must be between 1 and 3600 samples").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (slotCount == 0) {
+            Napi::RangeError::New(env, "No pids or slots given").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        options.history = static_cast<size_t>(history);
+
+        profileSampler_.reset();
+        profileSampler_ = std::make_unique<ProfileSampler>(options, slotCount);
+        profileSampler_->SetTargets(pids);
+        profileSampler_->Start();
+
+        static const char* const kFields[kProfileSampleStride] = {
+            "pid", "timestampMs", "cpuPercent", "cpuTimeMs", "rssBytes", "pssBytes", "threads", "processes",
+        };
+        Napi::Array fields = Napi::Array::New(env, kProfileSampleStride);
+        for (size_t i = 0; i < kProfileSampleStride; i++) {
+            fields.Set(static_cast<uint32_t>(i), Napi::String::New(env, kFields[i]));
+        }
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("slotCount", Napi::Number::New(env, static_cast<double>(slotCount)));
+        result.Set("history", Napi::Number::New(env, static_cast<double>(options.history)));
+        result.Set("stride", Napi::Number::New(env, kProfileSampleStride));
+        result.Set("fields", fields);
+        return result;
+    }
+
+    // Replace the sampled pids without reallocating the ring
+    Napi::Value SetSampledProfiles(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: pids").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!profileSampler_) {
+            return Napi::Boolean::New(env, false);
+        }
+
+        std::vector<int> pids = ToPidVector(info[0].As<Napi::Array>());
+        profileSampler_->SetTargets(pids);
+        return Napi::Boolean::New(env, pids.size() <= profileSampler_->SlotCount());
+    }
+
+    // getProfileSamples([frames = 1]): the newest samples, newest first, as
+    // {sequence, frames, slotCount, stride, sampleMs, values}. values is a
+    // Float64Array of frames * slotCount rows; null before the first sample.
+    Napi::Value GetProfileSamples(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (!profileSampler_) {
+            return env.Null();
+        }
+        size_t frames = 1;
+        if (info.Length() >= 1 && info[0].IsNumber()) {
+            frames = static_cast<size_t>(std::max(info[0].As<Napi::Number>().Int32Value(), 1));
+        }
+        frames = std::min(frames, profileSampler_->Available());
+        if (frames == 0) {
+            return env.Null();
+        }
+
+        size_t rowsPerFrame = profileSampler_->SlotCount();
+        Napi::Float64Array values = Napi::Float64Array::New(env, frames * rowsPerFrame * kProfileSampleStride);
+        uint64_t sequence = 0;
+        frames = profileSampler_->Read(values.Data(), frames, sequence);
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("sequence", Napi::Number::New(env, static_cast<double>(sequence)));
+        result.Set("frames", Napi::Number::New(env, static_cast<double>(frames)));
+        result.Set("slotCount", Napi::Number::New(env, static_cast<double>(rowsPerFrame)));
+        result.Set("stride", Napi::Number::New(env, kProfileSampleStride));
+        result.Set("sampleMs", Napi::Number::New(env, profileSampler_->LastSampleMs()));
+        result.Set("values", values);
+        return result;
+    }
+
+    Napi::Value StopProfileSampler(const Napi::CallbackInfo& info) {
+        profileSampler_.reset();
+        return info.Env().Undefined();
+    }
+
+    static Napi::Array DivergenceReportsToJs(Napi::Env env, const std::vector<DivergenceReport>& reports) {
+        Napi::Array result = Napi::Array::New(env, reports.size());
+        for (size_t i = 0; i < reports.size(); i++) {
+            const DivergenceReport& report = reports[i];
+            Napi::Object item = Napi::Object::New(env);
+            item.Set("pid", Napi::Number::New(env, report.pid));
+            item.Set("score", Napi::Number::New(env, report.score));
+            item.Set("diverged", Napi::Boolean::New(env, report.diverged));
+            item.Set("missing", Napi::Boolean::New(env, report.missing));
+            Napi::Array cells = Napi::Array::New(env, report.cells.size());
+            for (size_t c = 0; c < report.cells.size(); c++) {
+                cells.Set(static_cast<uint32_t>(c), Napi::Number::New(env, report.cells[c]));
+            }
+            item.Set("cells", cells);
+            result.Set(static_cast<uint32_t>(i), item);
+        }
+        return result;
+    }
+
+    // Compare the master window against every slave in the background.
+    // callback(reports) fires whenever a slave is diverged or recovers; each
+    // report is {pid, score, diverged, missing, cells} where cells are
+    // row-major indices into the options.columns x options.rows grid.
+    Napi::Value StartDivergenceDetection(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsArray() || !info[2].IsObject() ||
+            !info[3].IsFunction()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: masterPid, slavePids, options, callback")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        int masterPid = info[0].As<Napi::Number>().Int32Value();
+        std::vector<int> slavePids = ToPidVector(info[1].As<Napi::Array>());
+        Napi::Object opts = info[2].As<Napi::Object>();
+
+        DivergenceOptions options;
+        options.columns = GetIntOption(opts, "columns", options.columns);
+        options.rows = GetIntOption(opts, "rows", options.rows);
+        options.intervalMs = GetIntOption(opts, "intervalMs", options.intervalMs);
+        options.cellThreshold = GetIntOption(opts, "cellThreshold", options.cellThreshold);
+        if (opts.Has("scoreThreshold") && opts.Get("scoreThreshold").IsNumber()) {
+            options.scoreThreshold = opts.Get("scoreThreshold").As<Napi::Number>().DoubleValue();
+        }
+
+        if (options.columns <= 0 || options.rows <= 0 || options.columns > 64 || options.rows > 64) {
+            Napi::RangeError::New(env, "Grid size must be between 1 and 64").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (slavePids.empty()) {
+            Napi::RangeError::New(env, "No slave pids given").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        StopDivergenceDetectionInternal();
+
+        divergenceCallback_ = Napi::ThreadSafeFunction::New(
+            env, info[3].As<Napi::Function>(), "DivergenceCallback", 0, 1);
+        // Do not keep the event loop alive just for the detector
+        divergenceCallback_.Unref(env);
+
+        Napi::ThreadSafeFunction tsfn = divergenceCallback_;
+        divergenceDetector_ = std::make_unique<DivergenceDetector>(
+            options, masterPid, slavePids, [tsfn](std::vector<DivergenceReport> reports) mutable {
+                auto* payload = new std::vector<DivergenceReport>(std::move(reports));
+                napi_status status = tsfn.NonBlockingCall(
+                    payload, [](Napi::Env env, Napi::Function callback, std::vector<DivergenceReport>* data) {
+                        std::unique_ptr<std::vector<DivergenceReport>> owned(data);
+                        if (env != nullptr && callback != nullptr) {
+                            callback.Call({DivergenceReportsToJs(env, *owned)});
+                        }
+                    });
+                if (status != napi_ok) {
+                    delete payload;
+                }
+            });
+        divergenceDetector_->Start();
+
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value StopDivergenceDetection(const Napi::CallbackInfo& info) {
+        StopDivergenceDetectionInternal();
+        return info.Env().Undefined();
+    }
+
+    // Latest reports without waiting for the callback
+    Napi::Value GetDivergence(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (!divergenceDetector_) {
+            return Napi::Array::New(env, 0);
+        }
+        return DivergenceReportsToJs(env, divergenceDetector_->Reports());
+    }
+
+    void StopDivergenceDetectionInternal() {
+        // Join the capture thread first so nothing calls into the released function
+        divergenceDetector_.reset();
+        if (divergenceCallback_) {
+            divergenceCallback_.Release();
+            divergenceCallback_ = Napi::ThreadSafeFunction();
+        }
+    }
+
+    // Mirror the master page's scroll position into every slave over CDP.
+    // Takes the page WebSocket URLs (webSocketDebuggerUrl from /json/list);
+    // returns false when the sync loop cannot be started.
+    Napi::Value StartCdpSync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsString() || !info[1].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: masterUrl, slaveUrls").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::string masterUrl = info[0].As<Napi::String>().Utf8Value();
+        Napi::Array slaves = info[1].As<Napi::Array>();
+        std::vector<std::string> slaveUrls;
+        for (uint32_t i = 0; i < slaves.Length(); i++) {
+            Napi::Value url = slaves.Get(i);
+            if (!url.IsString()) {
+                Napi::TypeError::New(env, "Slave URLs must be strings").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            slaveUrls.push_back(url.As<Napi::String>().Utf8Value());
+        }
+
+        cdpSync_.reset();
+        auto sync = std::make_unique<CdpSync>(masterUrl, slaveUrls);
+        if (!sync->Start()) {
+            return Napi::Boolean::New(env, false);
+        }
+        cdpSync_ = std::move(sync);
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value CdpScrollTo(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: x, y").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!cdpSync_) {
+            return Napi::Boolean::New(env, false);
+        }
+        cdpSync_->ScrollTo(info[0].As<Napi::Number>().Int32Value(), info[1].As<Napi::Number>().Int32Value());
+        return Napi::Boolean::New(env, true);
+    }
+
+    // Input.dispatchMouseEvent wheel at page coordinates (x, y) in every slave
+    Napi::Value CdpDispatchWheel(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber() ||
+            !info[3].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: x, y, deltaX, deltaY").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!cdpSync_) {
+            return Napi::Boolean::New(env, false);
+        }
+        cdpSync_->DispatchWheel(info[0].As<Napi::Number>().Int32Value(), info[1].As<Napi::Number>().Int32Value(),
+                                info[2].As<Napi::Number>().Int32Value(), info[3].As<Napi::Number>().Int32Value());
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value StopCdpSync(const Napi::CallbackInfo& info) {
+        cdpSync_.reset();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value GetCdpSyncStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object result = Napi::Object::New(env);
+        CdpSyncStats stats = cdpSync_ ? cdpSync_->Stats() : CdpSyncStats();
+
+        result.Set("running", Napi::Boolean::New(env, cdpSync_ != nullptr));
+        result.Set("endpoints", Napi::Number::New(env, stats.endpoints));
+        result.Set("connected", Napi::Number::New(env, stats.connected));
+        result.Set("scrollEvents", Napi::Number::New(env, static_cast<double>(stats.scrollEvents)));
+        result.Set("scrollsForwarded", Napi::Number::New(env, static_cast<double>(stats.scrollsForwarded)));
+        result.Set("commandsSent", Napi::Number::New(env, static_cast<double>(stats.commandsSent)));
+        result.Set("commandErrors", Napi::Number::New(env, static_cast<double>(stats.commandErrors)));
+        result.Set("commandsDropped", Napi::Number::New(env, static_cast<double>(stats.commandsDropped)));
+        result.Set("reconnects", Napi::Number::New(env, static_cast<double>(stats.reconnects)));
+        return result;
+    }
+
+    // Mirror a master window into its own slaves on a native worker thread.
+    // Any number of sessions run side by side, spread over one worker per
+    // core. Returns the session id, or null where there is no native backend
+    // (macOS, or no X display).
+    Napi::Value CreateSyncSession(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: masterPid, slavePids, [options]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        int masterPid = info[0].As<Napi::Number>().Int32Value();
+        std::vector<int> slavePids = ToPidVector(info[1].As<Napi::Array>());
+
+        // Optional 3rd argument: {queueCapacity, boundsTtlMs, lockstep, barrierTimeoutMs}
+        SyncSessionOptions options;
+        if (info.Length() >= 3 && info[2].IsObject()) {
+            Napi::Object optionsObj = info[2].As<Napi::Object>();
+            Napi::Value capacity = optionsObj.Get("queueCapacity");
+            if (capacity.IsNumber()) {
+                options.queueCapacity = static_cast<size_t>(std::max(1, capacity.As<Napi::Number>().Int32Value()));
+            }
+            Napi::Value ttl = optionsObj.Get("boundsTtlMs");
+            if (ttl.IsNumber()) {
+                options.boundsTtl = std::chrono::milliseconds(std::max(0, ttl.As<Napi::Number>().Int32Value()));
+            }
+            Napi::Value lockstep = optionsObj.Get("lockstep");
+            options.lockstep = lockstep.IsBoolean() && lockstep.As<Napi::Boolean>().Value();
+            int barrierTimeoutMs = GetIntOption(optionsObj, "barrierTimeoutMs",
+                                                static_cast<int>(options.barrierTimeout.count()));
+            if (barrierTimeoutMs <= 0) {
+                Napi::RangeError::New(env, "barrierTimeoutMs must be positive").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            options.barrierTimeout = std::chrono::milliseconds(barrierTimeoutMs);
+        }
+
+        if (!syncSessions_) {
+            syncSessions_ = std::make_unique<SyncSessionPool>(core_);
+        }
+        uint64_t id = syncSessions_->Create(masterPid, slavePids, options);
+        if (id == 0) {
+            return env.Null();
+        }
+        return Napi::Number::New(env, static_cast<double>(id));
+    }
+
+    // Screen position inside the master window, mapped onto every slave
+    Napi::Value PostSyncMouseEvent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: sessionId, x, y, eventType")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        SyncEvent event;
+        char eventName[16];
+        if (!ReadEventName(info[3], eventName) || !ParsePointerEvent(eventName, event.pointer)) {
+            return Napi::Boolean::New(env, false);
+        }
+        event.kind = SyncEventKind::Pointer;
+        event.x = info[1].As<Napi::Number>().Int32Value();
+        event.y = info[2].As<Napi::Number>().Int32Value();
+        event.posted = std::chrono::steady_clock::now();
+        return Napi::Boolean::New(env, PostSyncEvent(info[0], event));
+    }
+
+    Napi::Value PostSyncWheelEvent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 5 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber() ||
+            !info[3].IsNumber() || !info[4].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: sessionId, deltaX, deltaY, x, y")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        SyncEvent event;
+        event.kind = SyncEventKind::Wheel;
+        event.deltaX = info[1].As<Napi::Number>().Int32Value();
+        event.deltaY = info[2].As<Napi::Number>().Int32Value();
+        event.x = info[3].As<Napi::Number>().Int32Value();
+        event.y = info[4].As<Napi::Number>().Int32Value();
+        event.posted = std::chrono::steady_clock::now();
+        return Napi::Boolean::New(env, PostSyncEvent(info[0], event));
+    }
+
+    // Native key code, as sendKeyboardEvent takes it, to the focused element
+    // of every slave: postSyncKeyEvent(sessionId, keyCode, 'keydown' | 'keyup')
+    Napi::Value PostSyncKeyEvent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: sessionId, keyCode, eventType")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        SyncEvent event;
+        char eventName[16];
+        event.keyCode = info[1].As<Napi::Number>().Int32Value();
+        if (event.keyCode < 0 || !ReadEventName(info[2], eventName) || !ParseKeyEvent(eventName, event.key)) {
+            return Napi::Boolean::New(env, false);
+        }
+        event.kind = SyncEventKind::Key;
+        event.posted = std::chrono::steady_clock::now();
+        return Napi::Boolean::New(env, PostSyncEvent(info[0], event));
+    }
+
+    bool PostSyncEvent(const Napi::Value& id, const SyncEvent& event) {
+        if (!syncSessions_) {
+            return false;
+        }
+        return syncSessions_->Post(static_cast<uint64_t>(id.As<Napi::Number>().Int64Value()), event);
+    }
+
+    // Resolves once every event posted to the session so far is through its
+    // barrier: waitSyncBarrier(sessionId, [timeoutMs]) gives
+    // {sequence, reached, stragglers}, stragglers being the slave pids that
+    // missed a barrier on the way, or null for an unknown session.
+    Napi::Value WaitSyncBarrier(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: sessionId, [timeoutMs]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        int timeoutMs = 5000;
+        if (info.Length() >= 2 && info[1].IsNumber()) {
+            timeoutMs = info[1].As<Napi::Number>().Int32Value();
+        }
+        if (timeoutMs < 0) {
+            Napi::RangeError::New(env, "timeoutMs must not be negative").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!syncSessions_) {
+            auto deferred = Napi::Promise::Deferred::New(env);
+            deferred.Resolve(env.Null());
+            return deferred.Promise();
+        }
+
+        // Settled from the session's worker once it confirms, nothing blocks
+        std::shared_ptr<PromiseSettler::Ticket> ticket;
+        Napi::Promise promise = Promises(env).Add(env, ticket);
+        auto settle = [ticket](bool found, const SyncBarrierResult& barrier) {
+            ticket->Settle([found, barrier](Napi::Env env, Napi::Promise::Deferred& deferred) {
+                if (!found) {
+                    deferred.Resolve(env.Null());
+                    return;
+                }
+                Napi::Array stragglers = Napi::Array::New(env, barrier.stragglers.size());
+                for (size_t i = 0; i < barrier.stragglers.size(); i++) {
+                    stragglers.Set(static_cast<uint32_t>(i), Napi::Number::New(env, barrier.stragglers[i]));
+                }
+                Napi::Object result = Napi::Object::New(env);
+                result.Set("sequence", Napi::Number::New(env, static_cast<double>(barrier.sequence)));
+                result.Set("reached", Napi::Boolean::New(env, barrier.reached));
+                result.Set("stragglers", stragglers);
+                deferred.Resolve(result);
+            });
+        };
+        if (!syncSessions_->WatchBarrier(static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value()),
+                                         std::chrono::milliseconds(timeoutMs), settle)) {
+            settle(false, SyncBarrierResult());
+        }
+        return promise;
+    }
+
+    Napi::Value DestroySyncSession(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: sessionId").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        bool destroyed = syncSessions_ &&
+                         syncSessions_->Destroy(static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value()));
+        return Napi::Boolean::New(env, destroyed);
+    }
+
+    Napi::Value GetSyncSessionStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: sessionId").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        SyncSessionStats stats;
+        if (!syncSessions_ ||
+            !syncSessions_->Stats(static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value()), stats)) {
+            return env.Null();
+        }
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("worker", Napi::Number::New(env, stats.worker));
+        result.Set("workers", Napi::Number::New(env, syncSessions_->Workers()));
+        result.Set("slaves", Napi::Number::New(env, stats.slaves));
+        result.Set("posted", Napi::Number::New(env, static_cast<double>(stats.posted)));
+        result.Set("coalesced", Napi::Number::New(env, static_cast<double>(stats.coalesced)));
+        result.Set("dropped", Napi::Number::New(env, static_cast<double>(stats.dropped)));
+        result.Set("dispatched", Napi::Number::New(env, static_cast<double>(stats.dispatched)));
+        result.Set("injected", Napi::Number::New(env, static_cast<double>(stats.injected)));
+        result.Set("missed", Napi::Number::New(env, static_cast<double>(stats.missed)));
+        result.Set("boundsRefreshes", Napi::Number::New(env, static_cast<double>(stats.boundsRefreshes)));
+        result.Set("avgLatencyUs", Napi::Number::New(env, stats.avgLatencyUs));
+        result.Set("maxLatencyUs", Napi::Number::New(env, stats.maxLatencyUs));
+        result.Set("sequence", Napi::Number::New(env, static_cast<double>(stats.sequence)));
+        result.Set("confirmed", Napi::Number::New(env, static_cast<double>(stats.confirmed)));
+        result.Set("barriers", Napi::Number::New(env, static_cast<double>(stats.barriers)));
+        result.Set("stragglers", Napi::Number::New(env, static_cast<double>(stats.stragglers)));
+        result.Set("avgBarrierUs", Napi::Number::New(env, stats.avgBarrierUs));
+        result.Set("maxBarrierUs", Napi::Number::New(env, stats.maxBarrierUs));
+        return result;
+    }
+
+    // Stream the master window's input to relay agents on other hosts:
+    // startSyncRelay(masterPid, [{host, port}], [{batchUs, maxInflight,
+    // queueCapacity}]). Connections are made and remade in the background;
+    // throws when an agent address does not resolve or there is no backend.
+    Napi::Value StartSyncRelay(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: masterPid, agents, [options]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Array agentList = info[1].As<Napi::Array>();
+        std::vector<RelayAgentAddress> agents;
+        for (uint32_t i = 0; i < agentList.Length(); i++) {
+            Napi::Value agent = agentList.Get(i);
+            if (!agent.IsObject()) {
+                Napi::TypeError::New(env, "Agents must be {host, port} objects").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            Napi::Value host = agent.As<Napi::Object>().Get("host");
+            RelayAgentAddress address;
+            address.host = host.IsString() ? host.As<Napi::String>().Utf8Value() : "";
+            address.port = GetIntOption(agent.As<Napi::Object>(), "port", 0);
+            if (address.host.empty() || address.port <= 0 || address.port > 65535) {
+                Napi::RangeError::New(env, "Agent host and port are required").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            agents.push_back(address);
+        }
+
+        SyncRelayOptions options;
+        if (info.Length() >= 3 && info[2].IsObject()) {
+            Napi::Object optionsObj = info[2].As<Napi::Object>();
+            int batchUs = GetIntOption(optionsObj, "batchUs", static_cast<int>(options.batchInterval.count()));
+            int maxInflight = GetIntOption(optionsObj, "maxInflight", static_cast<int>(options.maxInflight));
+            int capacity = GetIntOption(optionsObj, "queueCapacity", static_cast<int>(options.queueCapacity));
+            if (batchUs < 0 || maxInflight <= 0 || capacity <= 0) {
+                Napi::RangeError::New(env, "batchUs must not be negative, maxInflight and queueCapacity positive")
+                    .ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            options.batchInterval = std::chrono::microseconds(batchUs);
+            options.maxInflight = static_cast<uint32_t>(maxInflight);
+            options.queueCapacity = static_cast<size_t>(capacity);
+        }
+
+        syncRelay_.reset();
+        auto relay = std::make_unique<SyncRelayMaster>(options);
+        std::string error;
+        if (!relay->Start(agents, error)) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        syncRelay_ = std::move(relay);
+        relayMasterPid_ = info[0].As<Napi::Number>().Int32Value();
+        return Napi::Boolean::New(env, true);
+    }
+
+    // Screen position inside the master window, sent to every agent relative
+    // to the window
+    Napi::Value RelayMouseEvent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: x, y, eventType").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        char eventName[16];
+        PointerEvent pointer;
+        if (!ReadEventName(info[2], eventName) || !ParsePointerEvent(eventName, pointer)) {
+            return Napi::Boolean::New(env, false);
+        }
+        RelayEvent event;
+        event.type = static_cast<RelayEventType>(pointer);
+        if (!syncRelay_ || !ToRelayPosition(info[0].As<Napi::Number>().Int32Value(),
+                                            info[1].As<Napi::Number>().Int32Value(), event)) {
+            return Napi::Boolean::New(env, false);
+        }
+        return Napi::Boolean::New(env, syncRelay_->Post(event));
+    }
+
+    Napi::Value RelayWheelEvent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber() ||
+            !info[3].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: deltaX, deltaY, x, y").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        RelayEvent event;
+        event.type = RelayEventType::Wheel;
+        event.deltaX = info[0].As<Napi::Number>().Int32Value();
+        event.deltaY = info[1].As<Napi::Number>().Int32Value();
+        if (!syncRelay_ || !ToRelayPosition(info[2].As<Napi::Number>().Int32Value(),
+                                            info[3].As<Napi::Number>().Int32Value(), event)) {
+            return Napi::Boolean::New(env, false);
+        }
+        return Napi::Boolean::New(env, syncRelay_->Post(event));
+    }
+
+    // X keycode, replayed as is on the agents
+    Napi::Value RelayKeyboardEvent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: keyCode, eventType").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        char eventName[16];
+        KeyEvent keyEvent;
+        int keyCode = info[0].As<Napi::Number>().Int32Value();
+        if (!syncRelay_ || keyCode < 0 || !ReadEventName(info[1], eventName) || !ParseKeyEvent(eventName, keyEvent)) {
+            return Napi::Boolean::New(env, false);
+        }
+        RelayEvent event;
+        event.type = keyEvent == KeyEvent::Down ? RelayEventType::KeyDown : RelayEventType::KeyUp;
+        event.keyCode = keyCode;
+        return Napi::Boolean::New(env, syncRelay_->Post(event));
+    }
+
+    // Screen position to 1/kRelayScale of the master window. False when the
+    // master has no window.
+    bool ToRelayPosition(int x, int y, RelayEvent& event) {
+#ifdef __linux__
+        const auto& windows = WindowControl().EventWindows(relayMasterPid_);
+        if (windows.empty() || windows[0].width <= 0 || windows[0].height <= 0) {
+            return false;
+        }
+        const X11WindowInfo& master = windows[0];
+        event.x = static_cast<int>(std::lround(static_cast<double>(x - master.x) * kRelayScale / master.width));
+        event.y = static_cast<int>(std::lround(static_cast<double>(y - master.y) * kRelayScale / master.height));
+        return true;
+#else
+        (void)x;
+        (void)y;
+        (void)event;
+        return false;
+#endif
+    }
+
+    Napi::Value StopSyncRelay(const Napi::CallbackInfo& info) {
+        syncRelay_.reset();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value GetSyncRelayStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        SyncRelayStats stats = syncRelay_ ? syncRelay_->Stats() : SyncRelayStats();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("running", Napi::Boolean::New(env, syncRelay_ != nullptr));
+        result.Set("posted", Napi::Number::New(env, static_cast<double>(stats.posted)));
+        result.Set("refused", Napi::Number::New(env, static_cast<double>(stats.refused)));
+        result.Set("batches", Napi::Number::New(env, static_cast<double>(stats.batches)));
+        Napi::Array agents = Napi::Array::New(env, stats.agents.size());
+        for (size_t i = 0; i < stats.agents.size(); i++) {
+            const RelayAgentLinkStats& link = stats.agents[i];
+            Napi::Object agent = Napi::Object::New(env);
+            agent.Set("host", Napi::String::New(env, link.host));
+            agent.Set("port", Napi::Number::New(env, link.port));
+            agent.Set("connected", Napi::Boolean::New(env, link.connected));
+            agent.Set("connects", Napi::Number::New(env, static_cast<double>(link.connects)));
+            agent.Set("batches", Napi::Number::New(env, static_cast<double>(link.batches)));
+            agent.Set("events", Napi::Number::New(env, static_cast<double>(link.events)));
+            agent.Set("bytes", Napi::Number::New(env, static_cast<double>(link.bytes)));
+            agent.Set("coalesced", Napi::Number::New(env, static_cast<double>(link.coalesced)));
+            agent.Set("dropped", Napi::Number::New(env, static_cast<double>(link.dropped)));
+            agent.Set("acked", Napi::Number::New(env, link.acked));
+            agent.Set("inflight", Napi::Number::New(env, link.inflight));
+            agent.Set("acks", Napi::Number::New(env, static_cast<double>(link.acks)));
+            agent.Set("avgQueueUs", Napi::Number::New(env, link.avgQueueUs));
+            agent.Set("avgNetworkUs", Napi::Number::New(env, link.avgNetworkUs));
+            agent.Set("avgApplyUs", Napi::Number::New(env, link.avgApplyUs));
+            agent.Set("avgRttUs", Napi::Number::New(env, link.avgRttUs));
+            agent.Set("maxRttUs", Napi::Number::New(env, link.maxRttUs));
+            agents.Set(static_cast<uint32_t>(i), agent);
+        }
+        result.Set("agents", agents);
+        return result;
+    }
+
+    // Replay what relay masters send on local slave windows:
+    // startRelayAgent(slavePids, [{host, port}]) listens on host (default
+    // 0.0.0.0) and port (default 0, a free one) and returns the bound port.
+    // Throws when it cannot listen or there is no backend.
+    Napi::Value StartRelayAgent(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: slavePids, [{host, port}]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::string host = "0.0.0.0";
+        int port = 0;
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Object optionsObj = info[1].As<Napi::Object>();
+            Napi::Value hostValue = optionsObj.Get("host");
+            if (hostValue.IsString()) {
+                host = hostValue.As<Napi::String>().Utf8Value();
+            }
+            port = GetIntOption(optionsObj, "port", 0);
+            if (port < 0 || port > 65535) {
+                Napi::RangeError::New(env, "port must be between 0 and 65535").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+
+        relayAgent_.reset();
+        auto agent = std::make_unique<SyncRelayAgent>(core_);
+        std::string error;
+        int boundPort = agent->Start(host, port, ToPidVector(info[0].As<Napi::Array>()), error);
+        if (boundPort == 0) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        relayAgent_ = std::move(agent);
+        return Napi::Number::New(env, boundPort);
+    }
+
+    Napi::Value SetRelayAgentSlaves(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: slavePids").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!relayAgent_) {
+            return Napi::Boolean::New(env, false);
+        }
+        relayAgent_->SetSlaves(ToPidVector(info[0].As<Napi::Array>()));
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value StopRelayAgent(const Napi::CallbackInfo& info) {
+        relayAgent_.reset();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value GetRelayAgentStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        SyncRelayAgentStats stats = relayAgent_ ? relayAgent_->Stats() : SyncRelayAgentStats();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("running", Napi::Boolean::New(env, relayAgent_ != nullptr));
+        result.Set("port", Napi::Number::New(env, stats.port));
+        result.Set("connections", Napi::Number::New(env, stats.connections));
+        result.Set("batches", Napi::Number::New(env, static_cast<double>(stats.batches)));
+        result.Set("events", Napi::Number::New(env, static_cast<double>(stats.events)));
+        result.Set("injected", Napi::Number::New(env, static_cast<double>(stats.injected)));
+        result.Set("missed", Napi::Number::New(env, static_cast<double>(stats.missed)));
+        result.Set("gaps", Napi::Number::New(env, static_cast<double>(stats.gaps)));
+        result.Set("released", Napi::Number::New(env, static_cast<double>(stats.released)));
+        result.Set("malformed", Napi::Number::New(env, static_cast<double>(stats.malformed)));
+        result.Set("avgApplyUs", Napi::Number::New(env, stats.avgApplyUs));
+        result.Set("maxApplyUs", Napi::Number::New(env, stats.maxApplyUs));
+        return result;
+    }
+
+    // Mirror a drag from the master window: press at x, y on every slave,
+    // then replay the pointer's path from a native timer thread until
+    // endDrag. startDrag(masterPid, slavePids, x, y, [{button: 'left' |
+    // 'right', rateHz, sampleHz, delayUs, pressed, maxDurationMs}]) returns
+    // without waiting on the windows, or false where there is no native
+    // backend, so callers forward the moves themselves. pressed skips the
+    // press for a button the caller already forwarded.
+    Napi::Value StartDrag(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsArray() || !info[2].IsNumber() ||
+            !info[3].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: masterPid, slavePids, x, y, [options]")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        DragOptions options;
+        if (info.Length() >= 5 && info[4].IsObject()) {
+            Napi::Object optionsObj = info[4].As<Napi::Object>();
+            Napi::Value button = optionsObj.Get("button");
+            if (button.IsString()) {
+                std::string name = button.As<Napi::String>().Utf8Value();
+                if (name != "left" && name != "right") {
+                    Napi::RangeError::New(env, "button must be 'left' or 'right'").ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+                options.button = name == "right" ? PointerEvent::RightDown : PointerEvent::LeftDown;
+            }
+            options.rateHz = GetIntOption(optionsObj, "rateHz", options.rateHz);
+            options.sampleHz = GetIntOption(optionsObj, "sampleHz", options.sampleHz);
+            int delayUs = GetIntOption(optionsObj, "delayUs", 0);
+            int maxDurationMs = GetIntOption(optionsObj, "maxDurationMs",
+                                             static_cast<int>(options.maxDuration.count()));
+            if (options.rateHz < 1 || options.rateHz > 2000 || options.sampleHz < 1 || options.sampleHz > 4000 ||
+                delayUs < 0 || maxDurationMs < 1) {
+                Napi::RangeError::New(env,
+                                      "rateHz must be 1-2000, sampleHz 1-4000, delayUs not negative and "
+                                      "maxDurationMs positive")
+                    .ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            options.delay = std::chrono::microseconds(delayUs);
+            options.maxDuration = std::chrono::milliseconds(maxDurationMs);
+            Napi::Value pressed = optionsObj.Get("pressed");
+            options.pressed = pressed.IsBoolean() && pressed.As<Napi::Boolean>().Value();
+        }
+
+        if (!dragSynthesizer_) {
+            dragSynthesizer_ = std::make_unique<DragSynthesizer>(core_);
+        }
+        bool started = dragSynthesizer_->Begin(info[0].As<Napi::Number>().Int32Value(),
+                                               ToPidVector(info[1].As<Napi::Array>()),
+                                               info[2].As<Napi::Number>().Int32Value(),
+                                               info[3].As<Napi::Number>().Int32Value(), options);
+        return Napi::Boolean::New(env, started);
+    }
+
+    // The button came up at x, y: the slaves follow the path there and
+    // release. False when no drag is running.
+    Napi::Value EndDrag(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+            Napi::TypeError::New(env, "Wrong number of arguments: x, y").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        bool ended = dragSynthesizer_ &&
+                     dragSynthesizer_->End(info[0].As<Napi::Number>().Int32Value(),
+                                           info[1].As<Napi::Number>().Int32Value());
+        return Napi::Boolean::New(env, ended);
+    }
+
+    Napi::Value GetDragStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        DragStats stats = dragSynthesizer_ ? dragSynthesizer_->Stats() : DragStats();
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("active", Napi::Boolean::New(env, stats.active));
+        result.Set("drags", Napi::Number::New(env, static_cast<double>(stats.drags)));
+        result.Set("dropped", Napi::Number::New(env, static_cast<double>(stats.dropped)));
+        result.Set("timedOut", Napi::Number::New(env, static_cast<double>(stats.timedOut)));
+        result.Set("samples", Napi::Number::New(env, static_cast<double>(stats.samples)));
+        result.Set("ticks", Napi::Number::New(env, static_cast<double>(stats.ticks)));
+        result.Set("moves", Napi::Number::New(env, static_cast<double>(stats.moves)));
+        result.Set("injected", Napi::Number::New(env, static_cast<double>(stats.injected)));
+        result.Set("missed", Napi::Number::New(env, static_cast<double>(stats.missed)));
+        result.Set("avgJitterUs", Napi::Number::New(env, stats.avgJitterUs));
+        result.Set("maxJitterUs", Napi::Number::New(env, stats.maxJitterUs));
+        return result;
+    }
+
+    std::shared_ptr<AddonCore> core_;
+    // Last isProcessWindowActive answer, valid for one focus generation
+    struct {
+        int root = 0;
+        uint64_t generation = UINT64_MAX;
+        std::chrono::steady_clock::time_point checked;
+        bool active = false;
+    } activeCache_;
+    Napi::ThreadSafeFunction focusCallback_;
+    uint64_t focusListener_ = 0;
+    std::unique_ptr<WindowWatcher> windowWatcher_;
+    std::unique_ptr<ProcessScheduler> scheduler_;
+    std::unique_ptr<MemoryReclaimer> reclaimer_;
+    WindowParking parking_;
+    WindowOp parkOp_ = WindowOp::Minimize;
+#ifdef __linux__
+    // Window lookups and injection made on the JS thread
+    std::unique_ptr<X11WindowControl> windowControl_;
+#endif
+#ifdef _WIN32
+    // Windows hidden by bulkWindowOp, which the enumeration no longer finds
+    std::unordered_map<int, std::vector<HWND>> hiddenWindows_;
+    // Per-pid windows targeted by the input paths, see EventWindows
+    std::unordered_map<int, CachedEventWindows> eventWindows_;
+#endif
+
+    // View of the SharedArrayBuffer the capture thread writes into
+    Napi::Reference<Napi::Uint8Array> thumbnailBuffer_;
+    std::unique_ptr<ThumbnailCapture> thumbnailCapture_;
+    std::unique_ptr<ProfileSampler> profileSampler_;
+    std::unique_ptr<DivergenceDetector> divergenceDetector_;
+    Napi::ThreadSafeFunction divergenceCallback_;
+    Napi::ThreadSafeFunction logSink_;
+    uint64_t logSinkId_ = 0;
+    std::unique_ptr<CdpSync> cdpSync_;
+    std::unique_ptr<SyncSessionPool> syncSessions_;
+    std::unique_ptr<SyncRelayMaster> syncRelay_;
+    int relayMasterPid_ = 0;
+    std::unique_ptr<SyncRelayAgent> relayAgent_;
+    std::unique_ptr<DragSynthesizer> dragSynthesizer_;
+    std::unique_ptr<TextTyper> textTyper_;
+#ifdef __linux__
+    // Used on the typer thread only
+    std::shared_ptr<X11WindowControl> textControl_;
+#endif
+    std::unique_ptr<PromiseSettler> promises_;
 };
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
@@ -0,0 +1,198 @@
+#include "native-tests.h"
+#include "window-classifier.h"
+
+namespace {
+
+using Rule = WindowClassifier::Rule;
+using Match = WindowClassifier::Match;
+
+// Kind of a window whose only trait is text in field, and whether the title
+// was read on the way
+struct Outcome {
+    WindowKind kind;
+    bool titleRead;
+    bool titleDependent;
+};
+
+Outcome ClassifyField(const WindowClassifier& classifier, WindowClassifier::Field field, const std::string& text,
+                      uint32_t flags = 0) {
+    WindowTraits traits;
+    traits.flags = flags;
+    std::string title;
+    switch (field) {
+        case WindowClassifier::kClass:
+            traits.className = text;
+            break;
+        case WindowClassifier::kInstance:
+            traits.instance = text;
+            break;
+        case WindowClassifier::kRole:
+            traits.role = text;
+            break;
+        default:
+            title = text;
+            break;
+    }
+    bool titleRead = false;
+    WindowClassifier::Result result = classifier.Classify(traits, [&]() -> const std::string& {
+        titleRead = true;
+        return title;
+    });
+    return {result.kind, titleRead, result.titleDependent};
+}
+
+WindowKind KindOf(const WindowClassifier& classifier, WindowClassifier::Field field, const std::string& text) {
+    return ClassifyField(classifier, field, text).kind;
+}
+
+}  // namespace
+
+NATIVE_TEST(WindowClassifier, Exact) {
+    WindowClassifier classifier({{WindowKind::Main, WindowClassifier::kRole, Match::Exact, "browser"}});
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "browser") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "browsers") == WindowKind::Unknown);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "a browser") == WindowKind::Unknown);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "brows") == WindowKind::Unknown);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "") == WindowKind::Unknown);
+}
+
+NATIVE_TEST(WindowClassifier, Prefix) {
+    WindowClassifier classifier({{WindowKind::Extension, WindowClassifier::kInstance, Match::Prefix, "crx_"}});
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kInstance, "crx_") == WindowKind::Extension);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kInstance, "crx_abcdef") == WindowKind::Extension);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kInstance, "xcrx_abcdef") == WindowKind::Unknown);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kInstance, "crx") == WindowKind::Unknown);
+}
+
+NATIVE_TEST(WindowClassifier, Contains) {
+    WindowClassifier classifier({{WindowKind::Main, WindowClassifier::kTitle, Match::Contains, "Chromium"}});
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "Chromium") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "New Tab - Chromium") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "Chromium is here") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "Chromiu") == WindowKind::Unknown);
+}
+
+NATIVE_TEST(WindowClassifier, NonEmpty) {
+    WindowClassifier classifier({{WindowKind::Extension, WindowClassifier::kTitle, Match::NonEmpty, ""}});
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "x") == WindowKind::Extension);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "") == WindowKind::Unknown);
+}
+
+NATIVE_TEST(WindowClassifier, FoldsAsciiCase) {
+    WindowClassifier classifier({
+        {WindowKind::Main, WindowClassifier::kRole, Match::Exact, "Browser"},
+        {WindowKind::DevTools, WindowClassifier::kTitle, Match::Prefix, "devtools"},
+    });
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "BROWSER") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "browser") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "DevTools - example.com") == WindowKind::DevTools);
+    // Bytes outside ASCII are compared as they are
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "br\xc3\x96wser") == WindowKind::Unknown);
+}
+
+// Patterns that overlap inside one text, which only failure links find
+NATIVE_TEST(WindowClassifier, OverlappingPatterns) {
+    WindowClassifier classifier({
+        {WindowKind::Popup, WindowClassifier::kTitle, Match::Contains, "hers"},
+        {WindowKind::Extension, WindowClassifier::kTitle, Match::Contains, "she"},
+        {WindowKind::Main, WindowClassifier::kTitle, Match::Contains, "he"},
+    });
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "ushers") == WindowKind::Popup);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "ushe") == WindowKind::Extension);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "the") == WindowKind::Main);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kTitle, "hhhhers") == WindowKind::Popup);
+}
+
+NATIVE_TEST(WindowClassifier, FirstMatchingRuleWins) {
+    WindowClassifier classifier({
+        {WindowKind::Popup, WindowClassifier::kClass, Match::Prefix, "Chrome_", kWindowPopupStyle},
+        {WindowKind::DevTools, WindowClassifier::kClass, Match::Exact, "Chrome_WidgetWin_1", 0, kWindowFramed},
+        {WindowKind::Main, WindowClassifier::kClass, Match::Contains, "Widget"},
+    });
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kClass, "Chrome_WidgetWin_1", kWindowPopupStyle).kind ==
+                 WindowKind::Popup);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kClass, "Chrome_WidgetWin_1").kind ==
+                 WindowKind::DevTools);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kClass, "Chrome_WidgetWin_1", kWindowFramed).kind ==
+                 WindowKind::Main);
+}
+
+NATIVE_TEST(WindowClassifier, ReadsTitleOnlyWhenItCanDecide) {
+    WindowClassifier classifier({
+        {WindowKind::Main, WindowClassifier::kRole, Match::Exact, "browser"},
+        {WindowKind::Extension, WindowClassifier::kTitle, Match::NonEmpty, ""},
+    });
+    Outcome decided = ClassifyField(classifier, WindowClassifier::kRole, "browser");
+    NATIVE_CHECK(decided.kind == WindowKind::Main);
+    NATIVE_CHECK(!decided.titleRead);
+    NATIVE_CHECK(!decided.titleDependent);
+
+    Outcome fallback = ClassifyField(classifier, WindowClassifier::kRole, "bubble");
+    NATIVE_CHECK(fallback.titleRead);
+    NATIVE_CHECK(fallback.titleDependent);
+}
+
+NATIVE_TEST(WindowClassifier, DefaultRules) {
+    const WindowClassifier& classifier = WindowClassifier::Default();
+
+    // Win32 browser frames never need their title
+    Outcome frame = ClassifyField(classifier, WindowClassifier::kClass, "Chrome_WidgetWin_1", kWindowFramed);
+    NATIVE_CHECK(frame.kind == WindowKind::Main);
+    NATIVE_CHECK(!frame.titleRead);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kClass, "Chrome_WidgetWin_1", kWindowPopupStyle).kind ==
+                 WindowKind::Popup);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kClass, "#32768", kWindowPopupStyle).kind ==
+                 WindowKind::Popup);
+
+    Outcome role = ClassifyField(classifier, WindowClassifier::kRole, "browser", kWindowFramed);
+    NATIVE_CHECK(role.kind == WindowKind::Main);
+    NATIVE_CHECK(!role.titleRead);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kInstance, "crx_abcdef") == WindowKind::Extension);
+    NATIVE_CHECK(KindOf(classifier, WindowClassifier::kRole, "AXDialog") == WindowKind::Extension);
+
+    // Title fallback, e.g. an AXStandardWindow
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kTitle, "DevTools - example.com", kWindowFramed).kind ==
+                 WindowKind::DevTools);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kTitle, "New Tab - Google Chrome", kWindowFramed).kind ==
+                 WindowKind::Main);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kTitle, "New Tab - Google Chrome").kind ==
+                 WindowKind::Extension);
+    NATIVE_CHECK(ClassifyField(classifier, WindowClassifier::kTitle, "").kind == WindowKind::Unknown);
+}
+
+NATIVE_TEST(WindowClassCache, ReadsTitleOnlyForTitleDependentEntries) {
+    WindowClassCache cache;
+    int traitReads = 0;
+    int titleReads = 0;
+    std::string title = "New Tab - Google Chrome";
+    auto lookup = [&](uint64_t handle, uint64_t identity, const char* className) {
+        return cache.Lookup(
+            handle, identity,
+            [&](WindowTraits& traits) {
+                traitReads++;
+                traits.className = className;
+                traits.flags = kWindowFramed;
+            },
+            [&](std::string& out) {
+                titleReads++;
+                out = title;
+            });
+    };
+
+    for (int i = 0; i < 3; i++) {
+        NATIVE_CHECK(lookup(1, 100, "Chrome_WidgetWin_1") == WindowKind::Main);
+    }
+    NATIVE_CHECK(traitReads == 1);
+    NATIVE_CHECK(titleReads == 0);
+
+    // Classified by its title, which is checked on every lookup
+    NATIVE_CHECK(lookup(2, 100, "Other") == WindowKind::Main);
+    title = "DevTools - example.com";
+    NATIVE_CHECK(lookup(2, 100, "Other") == WindowKind::DevTools);
+    NATIVE_CHECK(traitReads == 2);
+    NATIVE_CHECK(titleReads == 2);
+
+    // A handle reused by another process is read again
+    NATIVE_CHECK(lookup(1, 200, "#32768") == WindowKind::Popup);
+    NATIVE_CHECK(traitReads == 3);
+}
@@ -0,0 +1,225 @@
+#include "window-classifier.h"
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+
+namespace {
+
+uint8_t Lower(char c) {
+    return static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+}  // namespace
+
+void WindowClassifier::Automaton::Add(const Rule& rule, size_t index) {
+    if (rule.match == Match::NonEmpty) {
+        nonEmpty_.push_back(index);
+        return;
+    }
+    if (rule.pattern.empty()) {
+        return;
+    }
+
+    int state = 0;
+    for (char c : rule.pattern) {
+        uint8_t byte = Lower(c);
+        if (!alphabet_[byte]) {
+            alphabet_[byte] = static_cast<uint8_t>(alphabetSize_++);
+        }
+        int next = -1;
+        for (const auto& edge : trie_[state]) {
+            if (edge.first == alphabet_[byte]) {
+                next = edge.second;
+                break;
+            }
+        }
+        if (next < 0) {
+            next = static_cast<int>(trie_.size());
+            trie_[state].emplace_back(alphabet_[byte], next);
+            trie_.emplace_back();
+            outputs_.emplace_back();
+        }
+        state = next;
+    }
+    outputs_[state].push_back({index, rule.pattern.size()});
+}
+
+void WindowClassifier::Automaton::Compile() {
+    // Expand the trie into a full transition table, following failure links
+    // for missing edges and inheriting the outputs of the failure state
+    next_.assign(trie_.size() * alphabetSize_, 0);
+    std::vector<int> fail(trie_.size(), 0);
+    std::deque<int> queue;
+
+    for (const auto& edge : trie_[0]) {
+        next_[edge.first] = edge.second;
+        queue.push_back(edge.second);
+    }
+    while (!queue.empty()) {
+        int state = queue.front();
+        queue.pop_front();
+        for (size_t symbol = 0; symbol < alphabetSize_; symbol++) {
+            next_[state * alphabetSize_ + symbol] = next_[fail[state] * alphabetSize_ + symbol];
+        }
+        for (const auto& edge : trie_[state]) {
+            fail[edge.second] = next_[fail[state] * alphabetSize_ + edge.first];
+            next_[state * alphabetSize_ + edge.first] = edge.second;
+            const auto& inherited = outputs_[fail[edge.second]];
+            outputs_[edge.second].insert(outputs_[edge.second].end(), inherited.begin(), inherited.end());
+            queue.push_back(edge.second);
+        }
+    }
+    trie_.clear();
+}
+
+void WindowClassifier::Automaton::Run(const std::string& text, const std::vector<Rule>& rules,
+                                      RuleSet& matched) const {
+    if (!text.empty()) {
+        for (size_t rule : nonEmpty_) {
+            matched.set(rule);
+        }
+    }
+
+    int state = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        state = next_[state * alphabetSize_ + alphabet_[Lower(text[i])]];
+        for (const Output& output : outputs_[state]) {
+            size_t start = i + 1 - output.length;
+            switch (rules[output.rule].match) {
+                case Match::Exact:
+                    if (start == 0 && i + 1 == text.size()) matched.set(output.rule);
+                    break;
+                case Match::Prefix:
+                    if (start == 0) matched.set(output.rule);
+                    break;
+                default:
+                    matched.set(output.rule);
+                    break;
+            }
+        }
+    }
+}
+
+WindowClassifier::WindowClassifier(const std::vector<Rule>& rules)
+    : rules_(rules.begin(), rules.begin() + std::min(rules.size(), kMaxRules)) {
+    for (size_t i = 0; i < rules_.size(); i++) {
+        const Rule& rule = rules_[i];
+        automata_[rule.field].Add(rule, i);
+        if (rule.field == kTitle) {
+            titleRules_.set(i);
+        }
+    }
+    for (Automaton& automaton : automata_) {
+        automaton.Compile();
+    }
+}
+
+const WindowClassifier& WindowClassifier::Default() {
+    static const WindowClassifier classifier({
+        // Win32 menus
+        {WindowKind::Popup, kClass, Match::Exact, "#32768"},
+        // Chromium widgets without a frame: menus, bubbles, the omnibox dropdown
+        {WindowKind::Popup, kClass, Match::Prefix, "Chrome_WidgetWin", kWindowPopupStyle, kWindowFramed},
+
+        // WM_WINDOW_ROLE set by Chromium on X11
+        {WindowKind::Main, kRole, Match::Exact, "browser"},
+        {WindowKind::Extension, kRole, Match::Exact, "pop-up"},
+        {WindowKind::Extension, kRole, Match::Exact, "app"},
+        {WindowKind::Popup, kRole, Match::Exact, "bubble"},
+        // App and extension windows get their own WM_CLASS instance
+        {WindowKind::Extension, kInstance, Match::Prefix, "crx_"},
+
+        // AX subroles on macOS
+        {WindowKind::Extension, kRole, Match::Exact, "AXDialog"},
+        {WindowKind::Extension, kRole, Match::Exact, "AXSystemDialog"},
+        {WindowKind::Extension, kRole, Match::Exact, "AXFloatingWindow"},
+
+        // Framed Chromium frames on Win32. Decided before any title rule, so
+        // enumerations never read their titles.
+        {WindowKind::Main, kClass, Match::Exact, "Chrome_WidgetWin_1", kWindowFramed},
+
+        // Fallback where nothing above applies. Undocked DevTools report the
+        // same traits as browser windows; the "DevTools" title prefix is not
+        // translated. Framed windows titled with a Chromium brand are browser
+        // windows, any other titled window belongs to an extension.
+        {WindowKind::DevTools, kTitle, Match::Prefix, "DevTools", kWindowFramed},
+        {WindowKind::Main, kTitle, Match::Contains, "Google Chrome", kWindowFramed},
+        {WindowKind::Main, kTitle, Match::Contains, "Chromium", kWindowFramed},
+        {WindowKind::Extension, kTitle, Match::NonEmpty, ""},
+    });
+    return classifier;
+}
+
+WindowClassifier::Result WindowClassifier::Classify(const WindowTraits& traits,
+                                                    const std::function<const std::string&()>& readTitle) const {
+    RuleSet matched;
+    automata_[kClass].Run(traits.className, rules_, matched);
+    automata_[kInstance].Run(traits.instance, rules_, matched);
+    automata_[kRole].Run(traits.role, rules_, matched);
+
+    Result result;
+    bool titleMatched = false;
+    for (size_t i = 0; i < rules_.size(); i++) {
+        const Rule& rule = rules_[i];
+        if ((traits.flags & rule.requiredFlags) != rule.requiredFlags || (traits.flags & rule.excludedFlags)) {
+            continue;
+        }
+        if (titleRules_.test(i) && !titleMatched) {
+            // Only read the title once a title rule could decide the result
+            automata_[kTitle].Run(readTitle(), rules_, matched);
+            titleMatched = true;
+            result.titleDependent = true;
+        }
+        if (matched.test(i)) {
+            result.kind = rule.kind;
+            return result;
+        }
+    }
+    return result;
+}
+
+void WindowClassCache::Classify(Entry& entry, const std::function<const std::string&()>& readTitle) {
+    const std::string* title = nullptr;
+    WindowClassifier::Result result = classifier_.Classify(entry.traits, [&]() -> const std::string& {
+        if (!title) {
+            title = &readTitle();
+        }
+        return *title;
+    });
+    entry.kind = result.kind;
+    entry.titleDependent = result.titleDependent;
+    entry.titleHash = title ? std::hash<std::string>()(*title) : 0;
+}
+
+#ifdef _WIN32
+
+void ReadWin32WindowTraits(HWND hwnd, WindowTraits& traits) {
+    char className[256] = {0};
+    int length = GetClassNameA(hwnd, className, sizeof(className));
+    traits.className.assign(className, length > 0 ? length : 0);
+
+    LONG style = GetWindowLong(hwnd, GWL_STYLE);
+    traits.flags = 0;
+    // WS_CAPTION is two bits, WS_BORDER | WS_DLGFRAME; only both make a caption
+    if ((style & WS_CAPTION) == WS_CAPTION) {
+        traits.flags |= kWindowFramed;
+    }
+    if (style & WS_POPUP) {
+        traits.flags |= kWindowPopupStyle;
+    }
+}
+
+void ReadWin32WindowTitle(HWND hwnd, std::string& title) {
+    wchar_t buffer[512];
+    int length = GetWindowTextW(hwnd, buffer, static_cast<int>(sizeof(buffer) / sizeof(buffer[0])));
+    title.clear();
+    if (length <= 0) {
+        return;
+    }
+    int bytes = WideCharToMultiByte(CP_UTF8, 0, buffer, length, nullptr, 0, nullptr, nullptr);
+    title.resize(bytes);
+    WideCharToMultiByte(CP_UTF8, 0, buffer, length, &title[0], bytes, nullptr, nullptr);
+}
+
+#endif
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Rule based classification of top-level browser windows.
+//
+// Windows are described by their class name (Win32 class, or the WM_CLASS
+// class on X11), WM_CLASS instance, role (WM_WINDOW_ROLE on X11, AX subrole
+// on macOS) and a few style traits. Those are stable for the lifetime of a
+// window and do not depend on the UI language, so rules on them come first;
+// title patterns are only a fallback for platforms that expose nothing better.
+//
+// All patterns of a field are compiled into one Aho-Corasick automaton, so a
+// window is matched against every rule with a single pass over each string.
+// Matching is ASCII case-insensitive.
+
+enum class WindowKind {
+    Unknown,
+    Main,
+    Extension,
+    Popup,
+    DevTools,
+};
+
+enum WindowTraitFlags : uint32_t {
+    kWindowFramed = 1u << 0,      // has a caption/frame (WS_CAPTION, AXStandardWindow)
+    kWindowPopupStyle = 1u << 1,  // WS_POPUP
+};
+
+struct WindowTraits {
+    std::string className;
+    std::string instance;
+    std::string role;
+    uint32_t flags = 0;
+};
+
+class WindowClassifier {
+public:
+    enum Field { kClass, kInstance, kRole, kTitle, kFieldCount };
+    enum class Match { Exact, Prefix, Contains, NonEmpty };
+
+    struct Rule {
+        WindowKind kind;
+        Field field;
+        Match match;
+        std::string pattern;
+        uint32_t requiredFlags = 0;
+        uint32_t excludedFlags = 0;
+    };
+
+    struct Result {
+        WindowKind kind = WindowKind::Unknown;
+        // The title decided the result, so it must be re-checked when the title changes
+        bool titleDependent = false;
+    };
+
+    static constexpr size_t kMaxRules = 128;
+
+    // Rules are tried in order, the first one that matches wins
+    explicit WindowClassifier(const std::vector<Rule>& rules);
+
+    // Chromium rules for Windows, X11 and macOS
+    static const WindowClassifier& Default();
+
+    // readTitle is only called when a title rule can still change the result
+    Result Classify(const WindowTraits& traits, const std::function<const std::string&()>& readTitle) const;
+
+private:
+    using RuleSet = std::bitset<kMaxRules>;
+
+    // Multi-pattern matcher over one field
+    class Automaton {
+    public:
+        void Add(const Rule& rule, size_t index);
+        void Compile();
+        // Set the bit of every rule whose pattern matches text under its Match mode
+        void Run(const std::string& text, const std::vector<Rule>& rules, RuleSet& matched) const;
+
+    private:
+        struct Output {
+            size_t rule;
+            size_t length;
+        };
+        std::array<uint8_t, 256> alphabet_{};
+        size_t alphabetSize_ = 1;
+        std::vector<std::vector<std::pair<uint8_t, int>>> trie_{1};
+        std::vector<int> next_;
+        std::vector<std::vector<Output>> outputs_{1};
+        std::vector<size_t> nonEmpty_;
+    };
+
+    std::vector<Rule> rules_;
+    std::array<Automaton, kFieldCount> automata_;
+    RuleSet titleRules_;
+};
+
+// Per-handle cache of classifications. Title-independent results are kept
+// until the handle is reused by another process; title-dependent ones are
+// re-checked against the current title, which is far cheaper than reading
+// every attribute again. Not thread-safe: each thread owns its own cache.
+class WindowClassCache {
+public:
+    explicit WindowClassCache(const WindowClassifier& classifier = WindowClassifier::Default())
+        : classifier_(classifier) {}
+
+    // identity distinguishes a recycled handle (use the owning pid).
+    // readTraits(WindowTraits&) runs once per new handle, readTitle(std::string&)
+    // only when the title matters.
+    template <typename ReadTraits, typename ReadTitle>
+    WindowKind Lookup(uint64_t handle, uint64_t identity, ReadTraits&& readTraits, ReadTitle&& readTitle) {
+        auto found = entries_.find(handle);
+        if (found != entries_.end() && found->second.identity == identity) {
+            Entry& entry = found->second;
+            if (!entry.titleDependent) {
+                return entry.kind;
+            }
+            readTitle(title_);
+            size_t titleHash = std::hash<std::string>()(title_);
+            if (titleHash != entry.titleHash) {
+                Classify(entry, [this]() -> const std::string& { return title_; });
+            }
+            return entry.kind;
+        }
+
+        if (entries_.size() >= kMaxEntries) {
+            entries_.clear();
+        }
+        Entry& entry = entries_[handle];
+        entry = Entry();
+        entry.identity = identity;
+        readTraits(entry.traits);
+        Classify(entry, [this, &readTitle]() -> const std::string& {
+            readTitle(title_);
+            return title_;
+        });
+        return entry.kind;
+    }
+
+    void Clear() { entries_.clear(); }
+
+private:
+    static constexpr size_t kMaxEntries = 4096;
+
+    struct Entry {
+        uint64_t identity = 0;
+        WindowTraits traits;
+        WindowKind kind = WindowKind::Unknown;
+        bool titleDependent = false;
+        size_t titleHash = 0;
+    };
+
+    void Classify(Entry& entry, const std::function<const std::string&()>& readTitle);
+
+    const WindowClassifier& classifier_;
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::string title_;
+};
+
+#ifdef _WIN32
+// Class name and style flags of a Win32 window
+void ReadWin32WindowTraits(HWND hwnd, WindowTraits& traits);
+// Window title as UTF-8
+void ReadWin32WindowTitle(HWND hwnd, std::string& title);
+#endif
@@ -0,0 +1,642 @@
+#include "window-control.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "process-tree.h"
+
+std::vector<GridCell> ComputeArrangeGrid(int screenX, int screenY, int screenWidth, int screenHeight,
+                                         int count, int columns, int width, int height, int spacing) {
+    std::vector<GridCell> cells;
+    if (count <= 0 || columns <= 0) {
+        return cells;
+    }
+
+    // Calculate total windows and rows
+    int rows = (count + columns - 1) / columns;
+
+    // Calculate effective dimensions with spacing
+    int availableWidth = screenWidth - (spacing * (columns + 1));
+    int availableHeight = screenHeight - (spacing * (rows + 1));
+    int effectiveWidth = width > 0 ? width : availableWidth / columns;
+    int effectiveHeight = height > 0 ? height : availableHeight / rows;
+
+    cells.reserve(count);
+    for (int i = 0; i < count; i++) {
+        GridCell cell;
+        if (i == 0) {
+            cell.x = screenX + spacing;
+            cell.y = screenY + spacing;
+            cell.width = effectiveWidth - spacing * 2;
+            cell.height = effectiveHeight - spacing * 2;
+        } else {
+            int row = i / columns;
+            int col = i % columns;
+            cell.x = screenX + (col * effectiveWidth) + (spacing * (col + 1));
+            cell.y = screenY + (row * effectiveHeight) + (spacing * (row + 1));
+            cell.width = effectiveWidth - spacing;
+            cell.height = effectiveHeight - spacing;
+        }
+        cell.anchorRight = cell.x + effectiveWidth - spacing;
+        cells.push_back(cell);
+    }
+    return cells;
+}
+
+bool ParseWindowOp(const std::string& name, WindowOp& op) {
+    static const std::pair<const char*, WindowOp> kOps[] = {
+        {"minimize", WindowOp::Minimize},
+        {"restore", WindowOp::Restore},
+        {"hide", WindowOp::Hide},
+        {"show", WindowOp::Show},
+        {"close", WindowOp::Close},
+        {"bringToFront", WindowOp::BringToFront},
+        {"setAlwaysOnTop", WindowOp::SetAlwaysOnTop},
+    };
+    for (const auto& entry : kOps) {
+        if (name == entry.first) {
+            op = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParsePointerEvent(const char* name, PointerEvent& event) {
+    static const std::pair<const char*, PointerEvent> kEvents[] = {
+        {"mousemove", PointerEvent::Move},
+        {"mousedown", PointerEvent::LeftDown},
+        {"mouseup", PointerEvent::LeftUp},
+        {"rightdown", PointerEvent::RightDown},
+        {"rightup", PointerEvent::RightUp},
+    };
+    for (const auto& entry : kEvents) {
+        if (std::strcmp(name, entry.first) == 0) {
+            event = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseKeyEvent(const char* name, KeyEvent& event) {
+    if (std::strcmp(name, "keydown") == 0) {
+        event = KeyEvent::Down;
+        return true;
+    }
+    if (std::strcmp(name, "keyup") == 0) {
+        event = KeyEvent::Up;
+        return true;
+    }
+    return false;
+}
+
+#ifdef __linux__
+
+X11WindowControl::X11WindowControl(std::shared_ptr<AddonCore> core) : core_(std::move(core)) {}
+
+std::vector<std::vector<X11WindowInfo>> X11WindowControl::FindWindowsForPids(const std::vector<int>& pids,
+                                                                             bool includeMinimized) {
+    std::vector<std::vector<X11WindowInfo>> windows(pids.size());
+    if (!x11_.IsOpen()) {
+        return windows;
+    }
+
+    std::unordered_map<int, int> owners = ProcessTree::Shared().OwnerMap(pids);
+    std::unordered_map<int, size_t> slots;
+    for (size_t i = 0; i < pids.size(); i++) {
+        slots.emplace(pids[i], i);
+    }
+
+    std::vector<xcb_window_t> clients = x11_.ClientWindows();
+    std::vector<int> clientPids = x11_.WindowPids(clients);
+    std::vector<xcb_window_t> candidates;
+    std::vector<int> candidatePids;
+    std::vector<int> candidateStack;
+    for (size_t i = 0; i < clients.size(); i++) {
+        if (owners.count(clientPids[i])) {
+            candidates.push_back(clients[i]);
+            candidatePids.push_back(clientPids[i]);
+            // Clients are listed bottom first
+            candidateStack.push_back(static_cast<int>(clients.size() - 1 - i));
+        }
+    }
+
+    // Without a window manager the candidates are all children of the root,
+    // including windows Chrome never maps, so only managed lists are trusted
+    if (includeMinimized && !x11_.HasWindowManager()) {
+        includeMinimized = false;
+    }
+
+    std::vector<WindowGeometry> geometries = x11_.WindowGeometries(candidates);
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (!geometries[i].valid || (!geometries[i].viewable && !includeMinimized)) {
+            continue;
+        }
+
+        xcb_window_t window = candidates[i];
+        X11Connection& x11 = x11_;
+        WindowKind kind = core_->ClassifyWindow(
+            window, static_cast<uint64_t>(candidatePids[i]),
+            [&x11, window](WindowTraits& traits) {
+                x11.WindowClass(window, traits.instance, traits.className, traits.role);
+                traits.flags = kWindowFramed;
+            },
+            [&x11, window](std::string& title) { title = x11.WindowTitle(window); });
+        if (kind != WindowKind::Main && kind != WindowKind::Extension) {
+            continue;
+        }
+
+        X11WindowInfo info;
+        info.window = window;
+        info.isExtension = kind == WindowKind::Extension;
+        info.x = geometries[i].x;
+        info.y = geometries[i].y;
+        info.width = geometries[i].width;
+        info.height = geometries[i].height;
+        info.stackIndex = candidateStack[i];
+        windows[slots[owners[candidatePids[i]]]].push_back(info);
+    }
+    return windows;
+}
+
+std::vector<X11WindowInfo> X11WindowControl::FindWindowsByPid(int pid) {
+    return FindWindowsForPids({pid})[0];
+}
+
+void X11WindowControl::ApplyPlacements(const std::vector<X11Placement>& placements, bool force,
+                                       ArrangeResult& result) {
+    std::vector<const X11Placement*> changed;
+    for (const auto& placement : placements) {
+        const X11WindowInfo& current = *placement.window;
+        bool inPlace = current.x == placement.x && current.y == placement.y &&
+                       (placement.preserveSize ||
+                        (current.width == placement.width && current.height == placement.height));
+        if (inPlace && !force) {
+            result.skipped++;
+        } else {
+            changed.push_back(&placement);
+        }
+    }
+    if (changed.empty()) {
+        return;
+    }
+    InvalidateEventWindows();
+
+    xcb_connection_t* c = x11_.Get();
+    bool managed = x11_.HasWindowManager();
+    xcb_atom_t wmState = x11_.Atom("_NET_WM_STATE");
+    xcb_atom_t maximizedVert = x11_.Atom("_NET_WM_STATE_MAXIMIZED_VERT");
+    xcb_atom_t maximizedHorz = x11_.Atom("_NET_WM_STATE_MAXIMIZED_HORZ");
+    xcb_atom_t moveResize = x11_.Atom("_NET_MOVERESIZE_WINDOW");
+
+    for (const X11Placement* placement : changed) {
+        xcb_window_t window = placement->window->window;
+        if (managed) {
+            // Unmaximize (action 0 = remove), then move through the window
+            // manager with StaticGravity so x/y address the client area
+            x11_.SendRootMessage(window, wmState, {0, maximizedVert, maximizedHorz, 2, 0});
+            uint32_t flags = 10 | (1u << 8) | (1u << 9) | (2u << 12);
+            if (!placement->preserveSize) {
+                flags |= (1u << 10) | (1u << 11);
+            }
+            x11_.SendRootMessage(window, moveResize,
+                                 {flags, static_cast<uint32_t>(placement->x), static_cast<uint32_t>(placement->y),
+                                  static_cast<uint32_t>(placement->width), static_cast<uint32_t>(placement->height)});
+        } else {
+            uint32_t values[] = {static_cast<uint32_t>(placement->x), static_cast<uint32_t>(placement->y),
+                                 static_cast<uint32_t>(placement->width), static_cast<uint32_t>(placement->height)};
+            uint16_t mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y;
+            if (!placement->preserveSize) {
+                mask |= XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
+            }
+            xcb_configure_window(c, window, mask, values);
+        }
+    }
+
+    // Raise from the bottom of the plan up so the first window ends on top
+    for (auto it = changed.rbegin(); it != changed.rend(); ++it) {
+        uint32_t stackMode = XCB_STACK_MODE_ABOVE;
+        xcb_configure_window(c, (*it)->window->window, XCB_CONFIG_WINDOW_STACK_MODE, &stackMode);
+    }
+
+    result.moved += static_cast<int>(changed.size());
+}
+
+ArrangeResult X11WindowControl::Arrange(const std::vector<int>& pids, const MonitorInfo& monitor, int columns,
+                                        int width, int height, int spacing, bool force) {
+    ArrangeResult result;
+    std::vector<GridCell> cells = ComputeArrangeGrid(monitor.x, monitor.y, monitor.width, monitor.height,
+                                                     static_cast<int>(pids.size()), columns, width, height, spacing);
+    auto windowsByPid = FindWindowsForPids(pids);
+
+    // Build the full plan first, then apply it as one batch. Within each
+    // profile the extension windows come first so they stack above it.
+    std::vector<X11Placement> placements;
+    for (size_t i = 0; i < cells.size(); i++) {
+        const X11WindowInfo* mainWindow = nullptr;
+        std::vector<const X11WindowInfo*> extensions;
+        for (const auto& win : windowsByPid[i]) {
+            if (!win.isExtension) {
+                mainWindow = &win;
+            } else {
+                extensions.push_back(&win);
+            }
+        }
+
+        if (!mainWindow) {
+            result.missing++;
+            continue;
+        }
+
+        const GridCell& cell = cells[i];
+        for (auto ext : extensions) {
+            placements.push_back({ext, cell.anchorRight - ext->width, cell.y, ext->width, ext->height, true});
+        }
+        placements.push_back({mainWindow, cell.x, cell.y, cell.width, cell.height, false});
+    }
+
+    ApplyPlacements(placements, force, result);
+    return result;
+}
+
+std::vector<int> X11WindowControl::ApplyWindowOp(const std::vector<int>& pids, WindowOp op, bool value) {
+    std::vector<int> counts(pids.size(), 0);
+    if (!x11_.IsOpen()) {
+        return counts;
+    }
+
+    InvalidateEventWindows();
+    bool reopen = op == WindowOp::Restore || op == WindowOp::Show;
+    auto windowsByPid = FindWindowsForPids(pids, reopen);
+    bool managed = x11_.HasWindowManager();
+
+    // Withdrawn windows are in no client list, add back the ones we withdrew
+    if (reopen) {
+        for (size_t i = 0; i < pids.size(); i++) {
+            auto withdrawn = withdrawn_.find(pids[i]);
+            if (withdrawn == withdrawn_.end()) {
+                continue;
+            }
+            for (xcb_window_t window : withdrawn->second) {
+                auto& windows = windowsByPid[i];
+                bool listed = std::any_of(windows.begin(), windows.end(),
+                                          [window](const X11WindowInfo& win) { return win.window == window; });
+                if (!listed) {
+                    X11WindowInfo info = {};
+                    info.window = window;
+                    windows.push_back(info);
+                }
+            }
+            withdrawn_.erase(withdrawn);
+        }
+    }
+
+    xcb_connection_t* c = x11_.Get();
+    xcb_atom_t wmState = x11_.Atom("_NET_WM_STATE");
+    uint32_t raise = XCB_STACK_MODE_ABOVE;
+
+    // Walk the pids bottom up so for BringToFront the first ends on top
+    const X11WindowInfo* focus = nullptr;
+    for (size_t i = pids.size(); i-- > 0;) {
+        for (const auto& win : windowsByPid[i]) {
+            xcb_window_t window = win.window;
+            switch (op) {
+                case WindowOp::Minimize:
+                    if (managed) {
+                        // ICCCM WM_CHANGE_STATE to IconicState (3)
+                        x11_.SendRootMessage(window, x11_.Atom("WM_CHANGE_STATE"), {3, 0, 0, 0, 0});
+                    } else {
+                        // Nothing can iconify without a window manager
+                        xcb_unmap_window(c, window);
+                        withdrawn_[pids[i]].push_back(window);
+                    }
+                    break;
+                case WindowOp::Restore:
+                    x11_.SendRootMessage(window, wmState, {0, x11_.Atom("_NET_WM_STATE_MAXIMIZED_VERT"),
+                                                           x11_.Atom("_NET_WM_STATE_MAXIMIZED_HORZ"), 2, 0});
+                    xcb_map_window(c, window);
+                    break;
+                case WindowOp::Hide:
+                    if (managed) {
+                        x11_.WithdrawWindow(window);
+                    } else {
+                        xcb_unmap_window(c, window);
+                    }
+                    withdrawn_[pids[i]].push_back(window);
+                    break;
+                case WindowOp::Show:
+                    xcb_map_window(c, window);
+                    break;
+                case WindowOp::Close:
+                    x11_.SendWindowMessage(window, x11_.Atom("WM_PROTOCOLS"),
+                                           {x11_.Atom("WM_DELETE_WINDOW"), XCB_CURRENT_TIME, 0, 0, 0});
+                    break;
+                case WindowOp::BringToFront:
+                    xcb_configure_window(c, window, XCB_CONFIG_WINDOW_STACK_MODE, &raise);
+                    if (!win.isExtension) {
+                        focus = &win;
+                    }
+                    break;
+                case WindowOp::SetAlwaysOnTop:
+                    if (managed) {
+                        x11_.SendRootMessage(window, wmState,
+                                             {value ? 1u : 0u, x11_.Atom("_NET_WM_STATE_ABOVE"), 0, 2, 0});
+                    } else if (value) {
+                        xcb_configure_window(c, window, XCB_CONFIG_WINDOW_STACK_MODE, &raise);
+                    }
+                    break;
+            }
+            counts[i]++;
+        }
+    }
+
+    // Focus only the topmost profile instead of activating every window
+    if (focus) {
+        if (managed) {
+            x11_.SendRootMessage(focus->window, x11_.Atom("_NET_ACTIVE_WINDOW"), {2, XCB_CURRENT_TIME, 0, 0, 0});
+        } else {
+            xcb_set_input_focus(c, XCB_INPUT_FOCUS_POINTER_ROOT, focus->window, XCB_CURRENT_TIME);
+        }
+    }
+    return counts;
+}
+
+const FixedVector<X11WindowInfo, kMaxEventWindows>& X11WindowControl::EventWindows(int pid) {
+    auto now = std::chrono::steady_clock::now();
+    // Only a pid seen for the first time allocates its entry
+    CachedEventWindows& cached = eventWindows_[pid];
+    if (cached.refreshed.time_since_epoch().count() != 0 && now - cached.refreshed < kEventWindowTtl) {
+        return cached.windows;
+    }
+
+    cached.refreshed = now;
+    cached.windows.clear();
+    auto windows = FindWindowsByPid(pid);
+    for (const auto& win : windows) {
+        if (!win.isExtension) {
+            cached.windows.push_back(win);
+            break;
+        }
+    }
+    if (!cached.windows.empty()) {
+        for (const auto& win : windows) {
+            if (win.isExtension && !cached.windows.push_back(win)) {
+                break;
+            }
+        }
+    }
+    return cached.windows;
+}
+
+bool X11WindowControl::SendPointerEvent(int pid, int x, int y, PointerEvent event, uint16_t heldButtons) {
+    const auto& windows = EventWindows(pid);
+    if (windows.empty()) {
+        return false;
+    }
+
+    // Extension windows are separate top-level windows on X11 as well
+    const X11WindowInfo* target = &windows[0];
+    for (const auto& win : windows) {
+        if (win.isExtension && x >= win.x && x < win.x + win.width && y >= win.y && y < win.y + win.height) {
+            target = &win;
+            break;
+        }
+    }
+
+    uint8_t type = XCB_MOTION_NOTIFY;
+    uint8_t button = 0;
+    uint16_t state = 0;
+    switch (event) {
+        case PointerEvent::Move:
+            state = heldButtons;
+            break;
+        case PointerEvent::LeftDown:
+            type = XCB_BUTTON_PRESS;
+            button = 1;
+            break;
+        case PointerEvent::LeftUp:
+            type = XCB_BUTTON_RELEASE;
+            button = 1;
+            state = XCB_BUTTON_MASK_1;
+            break;
+        case PointerEvent::RightDown:
+            type = XCB_BUTTON_PRESS;
+            button = 3;
+            break;
+        case PointerEvent::RightUp:
+            type = XCB_BUTTON_RELEASE;
+            button = 3;
+            state = XCB_BUTTON_MASK_3;
+            break;
+    }
+
+    x11_.SendPointerEvent(target->window, type, button, x, y, x - target->x, y - target->y, state);
+    return true;
+}
+
+bool X11WindowControl::SendWheelEvent(int pid, int deltaX, int deltaY, int x, int y) {
+    const auto& windows = EventWindows(pid);
+    if (windows.empty()) {
+        return false;
+    }
+    const X11WindowInfo* mainWindow = &windows[0];
+
+    // X11 wheels are buttons: 4/5 scroll up/down, 6/7 left/right
+    int windowX = x - mainWindow->x;
+    int windowY = y - mainWindow->y;
+    SendWheelClicks(mainWindow->window, deltaY, 4, 5, x, y, windowX, windowY);
+    SendWheelClicks(mainWindow->window, deltaX, 7, 6, x, y, windowX, windowY);
+    return true;
+}
+
+bool X11WindowControl::SendKeyEvent(int pid, int keyCode, KeyEvent event, int x, int y) {
+    const auto& windows = EventWindows(pid);
+    // X keycodes are 8 to 255
+    if (windows.empty() || keyCode < 8 || keyCode > 255) {
+        return false;
+    }
+
+    const X11WindowInfo* target = &windows[0];
+    for (const auto& win : windows) {
+        if (win.isExtension && x >= win.x && x < win.x + win.width && y >= win.y && y < win.y + win.height) {
+            target = &win;
+            break;
+        }
+    }
+    x11_.SendKeyEvent(target->window, event == KeyEvent::Down ? XCB_KEY_PRESS : XCB_KEY_RELEASE,
+                      static_cast<uint8_t>(keyCode));
+    return true;
+}
+
+namespace {
+
+// Clients read a changed keymap when its MappingNotify arrives; keys that
+// depend on the change wait this long for them
+constexpr std::chrono::milliseconds kKeymapSettle{20};
+
+// X keysym of a character: Latin-1 keysyms equal the code point, the rest
+// of Unicode is 0x01000000 plus it. Line breaks and tabs are their keys;
+// other control characters have none (0).
+xcb_keysym_t CharacterKeysym(char32_t codepoint) {
+    switch (codepoint) {
+        case U'\n':
+        case U'\r':
+            return 0xff0d;  // Return
+        case U'\t':
+            return 0xff09;  // Tab
+        case U'\b':
+            return 0xff08;  // BackSpace
+        default:
+            break;
+    }
+    if ((codepoint >= 0x20 && codepoint <= 0x7e) || (codepoint >= 0xa0 && codepoint <= 0xff)) {
+        return codepoint;
+    }
+    if (codepoint < 0x100) {
+        return 0;
+    }
+    return 0x01000000 | codepoint;
+}
+
+}  // namespace
+
+void X11WindowControl::PrepareKeymap(const std::vector<std::u32string>& texts) {
+    textKeys_.clear();
+    spareKeycodes_.clear();
+    spareBindings_.clear();
+    bindings_ = 0;
+
+    uint8_t firstKeycode = 0;
+    std::vector<xcb_keysym_t> keysyms;
+    if (!x11_.KeyboardMapping(firstKeycode, keysymsPerKeycode_, keysyms)) {
+        return;
+    }
+    size_t keycodes = keysyms.size() / keysymsPerKeycode_;
+    for (size_t i = 0; i < keycodes; i++) {
+        const xcb_keysym_t* row = &keysyms[i * keysymsPerKeycode_];
+        uint8_t keycode = static_cast<uint8_t>(firstKeycode + i);
+        bool spare = true;
+        for (int column = 0; column < keysymsPerKeycode_; column++) {
+            if (row[column] == 0) {
+                continue;
+            }
+            spare = false;
+            // The first two columns are the plain and the shifted keysym;
+            // a plain key beats a shifted one elsewhere
+            if (column < 2) {
+                TextKey key{keycode, static_cast<uint16_t>(column == 1 ? XCB_MOD_MASK_SHIFT : 0)};
+                auto inserted = textKeys_.emplace(row[column], key);
+                if (!inserted.second && inserted.first->second.state != 0 && key.state == 0) {
+                    inserted.first->second = key;
+                }
+            }
+        }
+        if (spare) {
+            spareKeycodes_.push_back(keycode);
+        }
+    }
+    spareBindings_.assign(spareKeycodes_.size(), 0);
+
+    // Bind what fits up front, so typing needs no keymap changes
+    for (const std::u32string& text : texts) {
+        for (char32_t codepoint : text) {
+            xcb_keysym_t keysym = CharacterKeysym(codepoint);
+            if (keysym == 0 || textKeys_.count(keysym)) {
+                continue;
+            }
+            if (bindings_ == spareKeycodes_.size()) {
+                break;
+            }
+            BindSpareKeycode(keysym);
+        }
+    }
+    if (bindings_ > 0) {
+        SettleKeymap();
+    }
+}
+
+bool X11WindowControl::TypeCharacter(int pid, char32_t codepoint) {
+    const auto& windows = EventWindows(pid);
+    xcb_keysym_t keysym = CharacterKeysym(codepoint);
+    if (windows.empty() || keysym == 0) {
+        return false;
+    }
+
+    auto key = textKeys_.find(keysym);
+    if (key == textKeys_.end()) {
+        // More characters than spare keycodes: take over the oldest binding
+        if (!BindSpareKeycode(keysym)) {
+            return false;
+        }
+        SettleKeymap();
+        key = textKeys_.find(keysym);
+    }
+    xcb_window_t window = windows[0].window;
+    x11_.SendKeyEvent(window, XCB_KEY_PRESS, key->second.keycode, key->second.state);
+    x11_.SendKeyEvent(window, XCB_KEY_RELEASE, key->second.keycode, key->second.state);
+    return true;
+}
+
+void X11WindowControl::RestoreKeymap() {
+    if (bindings_ == 0) {
+        return;
+    }
+    // Let clients translate the last keys before their keycodes go
+    SettleKeymap();
+    std::vector<xcb_keysym_t> none(keysymsPerKeycode_, 0);
+    for (size_t slot = 0; slot < std::min(bindings_, spareKeycodes_.size()); slot++) {
+        x11_.ChangeKeyboardMapping(spareKeycodes_[slot], keysymsPerKeycode_, none.data());
+    }
+    x11_.Flush();
+    textKeys_.clear();
+    spareKeycodes_.clear();
+    spareBindings_.clear();
+    bindings_ = 0;
+}
+
+bool X11WindowControl::BindSpareKeycode(xcb_keysym_t keysym) {
+    if (spareKeycodes_.empty()) {
+        return false;
+    }
+    size_t slot = bindings_++ % spareKeycodes_.size();
+    if (spareBindings_[slot] != 0) {
+        textKeys_.erase(spareBindings_[slot]);
+    }
+    spareBindings_[slot] = keysym;
+
+    // Plain and shifted alike, so the modifier state does not matter
+    std::vector<xcb_keysym_t> row(keysymsPerKeycode_, 0);
+    row[0] = keysym;
+    if (row.size() > 1) {
+        row[1] = keysym;
+    }
+    x11_.ChangeKeyboardMapping(spareKeycodes_[slot], keysymsPerKeycode_, row.data());
+    textKeys_[keysym] = TextKey{spareKeycodes_[slot], 0};
+    return true;
+}
+
+void X11WindowControl::SettleKeymap() {
+    x11_.Sync();
+    std::this_thread::sleep_for(kKeymapSettle);
+}
+
+void X11WindowControl::SendWheelClicks(xcb_window_t window, int delta, uint8_t positiveButton,
+                                       uint8_t negativeButton, int rootX, int rootY, int windowX, int windowY) {
+    if (delta == 0) {
+        return;
+    }
+    // Queue press and release of the button once per notch
+    uint8_t button = delta > 0 ? positiveButton : negativeButton;
+    int clicks = std::max(1, std::abs(delta) / 120);
+    for (int i = 0; i < clicks; i++) {
+        x11_.SendPointerEvent(window, XCB_BUTTON_PRESS, button, rootX, rootY, windowX, windowY, 0);
+        x11_.SendPointerEvent(window, XCB_BUTTON_RELEASE, button, rootX, rootY, windowX, windowY, 0);
+    }
+}
+
+#endif
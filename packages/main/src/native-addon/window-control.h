@@ -0,0 +1,197 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "addon-core.h"
+#include "fixed-vector.h"
+
+#ifdef __linux__
+#include "x11-connection.h"
+#endif
+
+// Window arrangement and input injection that does not depend on N-API, so
+// the addon and the window-daemon sidecar run the same code.
+
+// Outcome of an arrangement, returned by arrangeWindows and restoreLayout
+struct ArrangeResult {
+    int moved = 0;
+    int skipped = 0;
+    int missing = 0;
+};
+
+// Cell of one profile in the arrangeWindows grid, in screen coordinates
+struct GridCell {
+    int x;
+    int y;
+    int width;
+    int height;
+    // Extension windows are right-aligned to this edge
+    int anchorRight;
+};
+
+// Cells for count windows tiled columns wide on the given screen area. The
+// first (main) window gets a cell inset by spacing on every side. width and
+// height of 0 divide the screen evenly.
+std::vector<GridCell> ComputeArrangeGrid(int screenX, int screenY, int screenWidth, int screenHeight,
+                                         int count, int columns, int width, int height, int spacing);
+
+// Operations of bulkWindowOp, applied to every main and extension window of
+// a profile
+enum class WindowOp {
+    Minimize,
+    Restore,
+    Hide,
+    Show,
+    Close,
+    // Stack the profiles in the order given, the first on top and focused
+    BringToFront,
+    SetAlwaysOnTop,
+};
+
+// Parses the name bulkWindowOp takes ("minimize", "bringToFront", ...)
+bool ParseWindowOp(const std::string& name, WindowOp& op);
+
+enum class PointerEvent {
+    Move,
+    LeftDown,
+    LeftUp,
+    RightDown,
+    RightUp,
+};
+
+enum class KeyEvent {
+    Down,
+    Up,
+};
+
+// Event names of the input methods ("mousemove", "rightdown", "keyup", ...).
+// They take a C string so the hot path never builds a std::string.
+bool ParsePointerEvent(const char* name, PointerEvent& event);
+bool ParseKeyEvent(const char* name, KeyEvent& event);
+
+// Input injection resolves a pid to its windows at most this often. Within
+// the interval every event reuses the cached windows, so a burst of events
+// needs no enumeration, no window system round trips and no heap memory.
+// Arranging or changing windows through the addon invalidates the cache.
+constexpr std::chrono::milliseconds kEventWindowTtl{250};
+// Main window plus extension windows kept per pid for input injection
+constexpr size_t kMaxEventWindows = 8;
+
+#ifdef __linux__
+struct X11WindowInfo {
+    xcb_window_t window;
+    bool isExtension;
+    int x;
+    int y;
+    int width;
+    int height;
+    // Position in the z-order of the windows found with it, 0 is topmost
+    int stackIndex;
+};
+
+struct X11Placement {
+    const X11WindowInfo* window;
+    int x;
+    int y;
+    int width;
+    int height;
+    bool preserveSize;
+};
+
+// Chrome windows on an X11 display. Requests are queued on the connection
+// and only sent by Flush(), so callers can batch several operations. Not
+// thread-safe: use one instance per thread.
+class X11WindowControl {
+public:
+    explicit X11WindowControl(std::shared_ptr<AddonCore> core);
+
+    bool IsOpen() const { return x11_.IsOpen(); }
+    X11Connection& Connection() { return x11_; }
+
+    // Main and extension windows of every pid (or any process it started).
+    // Property, attribute and geometry requests are pipelined for all windows.
+    // includeMinimized also returns the unmapped (iconic) windows a window
+    // manager still lists.
+    std::vector<std::vector<X11WindowInfo>> FindWindowsForPids(const std::vector<int>& pids,
+                                                               bool includeMinimized = false);
+    std::vector<X11WindowInfo> FindWindowsByPid(int pid);
+
+    // Move the windows that are not already in place and stack them in plan
+    // order, the first placement on top
+    void ApplyPlacements(const std::vector<X11Placement>& placements, bool force, ArrangeResult& result);
+
+    // Tile pids[0] (the main profile) and the rest on monitor like arrangeWindows
+    ArrangeResult Arrange(const std::vector<int>& pids, const MonitorInfo& monitor, int columns,
+                          int width, int height, int spacing, bool force);
+
+    // Apply op to the windows of every pid from one enumeration, queued as a
+    // single batch. value is the setAlwaysOnTop state. Returns the number of
+    // windows changed per pid. Windows withdrawn by Hide are remembered so
+    // Show and Restore can find them again.
+    std::vector<int> ApplyWindowOp(const std::vector<int>& pids, WindowOp op, bool value);
+
+    // Windows of pid for input injection, the main window first. Cached for
+    // kEventWindowTtl; empty when pid has no main window.
+    const FixedVector<X11WindowInfo, kMaxEventWindows>& EventWindows(int pid);
+    void InvalidateEventWindows() { eventWindows_.clear(); }
+
+    // Synthetic pointer event at screen position x, y, delivered to the
+    // extension window under it or else the main window of pid. False when
+    // pid has no main window. heldButtons is the button state of a move,
+    // e.g. XCB_BUTTON_MASK_1 while dragging.
+    bool SendPointerEvent(int pid, int x, int y, PointerEvent event, uint16_t heldButtons = 0);
+    // Wheel notches of 120 units at screen position x, y
+    bool SendWheelEvent(int pid, int deltaX, int deltaY, int x, int y);
+    // Key of X keycode to the extension window under screen position x, y
+    // or else the main window of pid, whose focused element takes it. False
+    // when pid has no main window or keyCode is no X keycode.
+    bool SendKeyEvent(int pid, int keyCode, KeyEvent event, int x = -1, int y = -1);
+
+    // Text input. A character is typed as the key the keymap has for it,
+    // with Shift where the keysym needs it. Characters the keymap lacks are
+    // bound to spare keycodes first, as xdotool does, and RestoreKeymap()
+    // unbinds them again.
+    //
+    // Read the keymap and bind the characters of texts it lacks
+    void PrepareKeymap(const std::vector<std::u32string>& texts);
+    // Press and release the key of codepoint in the main window of pid. False
+    // when pid has no main window or codepoint has no key.
+    bool TypeCharacter(int pid, char32_t codepoint);
+    void RestoreKeymap();
+
+    void Flush() { x11_.Flush(); }
+
+private:
+    void SendWheelClicks(xcb_window_t window, int delta, uint8_t positiveButton, uint8_t negativeButton,
+                         int rootX, int rootY, int windowX, int windowY);
+    bool BindSpareKeycode(xcb_keysym_t keysym);
+    void SettleKeymap();
+
+    std::shared_ptr<AddonCore> core_;
+    X11Connection x11_;
+    // Windows withdrawn by ApplyWindowOp, which no window manager lists
+    std::unordered_map<int, std::vector<xcb_window_t>> withdrawn_;
+
+    struct CachedEventWindows {
+        std::chrono::steady_clock::time_point refreshed;
+        FixedVector<X11WindowInfo, kMaxEventWindows> windows;
+    };
+    std::unordered_map<int, CachedEventWindows> eventWindows_;
+
+    struct TextKey {
+        uint8_t keycode;
+        uint16_t state;
+    };
+    int keysymsPerKeycode_ = 0;
+    std::unordered_map<xcb_keysym_t, TextKey> textKeys_;
+    // Keycodes without keysyms, the keysym bound to each by text input, and
+    // how many bindings were made (they cycle once all are used)
+    std::vector<uint8_t> spareKeycodes_;
+    std::vector<xcb_keysym_t> spareBindings_;
+    size_t bindings_ = 0;
+};
+#endif
@@ -0,0 +1,519 @@
+// window-daemon: window enumeration, arrangement and input injection served
+// over a Unix domain socket, so automation clients can drive Chrome windows
+// without going through the Electron main process. Linux (X11) only.
+//
+//   window-daemon [--socket <path>]
+//
+// The wire format is described in control-protocol.h. One epoll loop serves
+// every client; all requests that arrive together are answered with a single
+// X11 flush, so pipelined injection costs one round of syscalls per batch.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "addon-common.h"
+#include "addon-core.h"
+#include "control-protocol.h"
+#include "window-control.h"
+
+namespace {
+
+// Stop reading from a client while this much output is still unsent
+constexpr size_t kMaxPendingOutput = 4 << 20;
+constexpr int kMaxEvents = 64;
+
+struct Client {
+    int fd;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    size_t outputOffset = 0;
+    bool closing = false;
+};
+
+std::string DefaultSocketPath() {
+    const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && *runtimeDir) {
+        return std::string(runtimeDir) + "/chrome-power-window.sock";
+    }
+    return "/tmp/chrome-power-window-" + std::to_string(getuid()) + ".sock";
+}
+
+class WindowDaemon {
+public:
+    WindowDaemon(std::shared_ptr<AddonCore> core, X11WindowControl& control)
+        : core_(std::move(core)), control_(control) {}
+
+    ~WindowDaemon() {
+        for (auto& entry : clients_) {
+            close(entry.first);
+        }
+        if (listenFd_ >= 0) {
+            close(listenFd_);
+            unlink(socketPath_.c_str());
+        }
+        if (signalFd_ >= 0) {
+            close(signalFd_);
+        }
+        if (epollFd_ >= 0) {
+            close(epollFd_);
+        }
+    }
+
+    bool Listen(const std::string& path);
+    int Run();
+
+private:
+    void Watch(int fd, uint32_t events, int op = EPOLL_CTL_ADD) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epollFd_, op, fd, &event);
+    }
+
+    void Accept();
+    void Read(Client& client);
+    void Write(Client& client);
+    void UpdateInterest(Client& client);
+    void Close(int fd);
+    void Handle(const uint8_t* payload, size_t length, std::vector<uint8_t>& out);
+
+    std::shared_ptr<AddonCore> core_;
+    X11WindowControl& control_;
+    std::string socketPath_;
+    int listenFd_ = -1;
+    int signalFd_ = -1;
+    int epollFd_ = -1;
+    int x11Fd_ = -1;
+    std::unordered_map<int, Client> clients_;
+};
+
+bool WindowDaemon::Listen(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        LOG_ERROR("Socket path too long: " << path);
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        LOG_ERROR("socket failed: " << strerror(errno));
+        return false;
+    }
+
+    // A socket file left by a daemon that did not shut down cleanly
+    unlink(path.c_str());
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        LOG_ERROR("bind " << path << " failed: " << strerror(errno));
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    socketPath_ = path;
+    // The socket can inject input into any window, keep it private to the user
+    chmod(path.c_str(), 0600);
+    if (listen(listenFd_, SOMAXCONN) < 0) {
+        LOG_ERROR("listen failed: " << strerror(errno));
+        return false;
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    signalFd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ < 0 || signalFd_ < 0) {
+        LOG_ERROR("epoll setup failed: " << strerror(errno));
+        return false;
+    }
+    Watch(listenFd_, EPOLLIN);
+    Watch(signalFd_, EPOLLIN);
+
+    // Replies to our requests never arrive unasked, but X errors for windows
+    // that closed meanwhile do and must be drained
+    x11Fd_ = xcb_get_file_descriptor(control_.Connection().Get());
+    Watch(x11Fd_, EPOLLIN);
+    return true;
+}
+
+int WindowDaemon::Run() {
+    epoll_event events[kMaxEvents];
+    std::vector<int> touched;
+
+    while (true) {
+        int count = epoll_wait(epollFd_, events, kMaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("epoll_wait failed: " << strerror(errno));
+            return 1;
+        }
+
+        touched.clear();
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+
+            if (fd == signalFd_) {
+                return 0;
+            }
+            if (fd == listenFd_) {
+                Accept();
+                continue;
+            }
+            if (fd == x11Fd_) {
+                xcb_connection_t* connection = control_.Connection().Get();
+                while (xcb_generic_event_t* event = xcb_poll_for_event(connection)) {
+                    free(event);
+                }
+                if (xcb_connection_has_error(connection)) {
+                    LOG_ERROR("Lost the X11 connection");
+                    return 1;
+                }
+                continue;
+            }
+
+            auto it = clients_.find(fd);
+            if (it == clients_.end()) {
+                continue;
+            }
+            if (flags & (EPOLLIN | EPOLLRDHUP)) {
+                Read(it->second);
+            }
+            if (flags & (EPOLLERR | EPOLLHUP)) {
+                it->second.closing = true;
+            }
+            touched.push_back(fd);
+        }
+
+        // Everything queued by this batch of requests goes to the X server at once
+        control_.Flush();
+
+        for (int fd : touched) {
+            auto it = clients_.find(fd);
+            if (it == clients_.end()) {
+                continue;
+            }
+            Write(it->second);
+            if (it->second.closing && it->second.outputOffset == it->second.output.size()) {
+                Close(fd);
+            } else {
+                UpdateInterest(it->second);
+            }
+        }
+    }
+}
+
+void WindowDaemon::Accept() {
+    while (true) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_ERROR("accept failed: " << strerror(errno));
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        clients_.emplace(fd, Client{fd, {}, {}, 0, false});
+        Watch(fd, EPOLLIN | EPOLLRDHUP);
+    }
+}
+
+void WindowDaemon::Read(Client& client) {
+    uint8_t buffer[16384];
+    while (client.output.size() - client.outputOffset < kMaxPendingOutput) {
+        ssize_t received = read(client.fd, buffer, sizeof(buffer));
+        if (received > 0) {
+            client.input.insert(client.input.end(), buffer, buffer + received);
+            if (static_cast<size_t>(received) < sizeof(buffer)) {
+                break;
+            }
+            continue;
+        }
+        if (received == 0) {
+            client.closing = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            client.closing = true;
+        }
+        break;
+    }
+
+    // Answer every complete frame; a partial one waits for more data
+    size_t consumed = 0;
+    while (true) {
+        const uint8_t* payload;
+        size_t payloadLength, frameLength;
+        FrameState state = PeekControlFrame(client.input.data() + consumed, client.input.size() - consumed,
+                                            payload, payloadLength, frameLength);
+        if (state == FrameState::Incomplete) {
+            break;
+        }
+        if (state == FrameState::Oversized) {
+            LOG_ERROR("Oversized frame, closing client");
+            client.closing = true;
+            consumed = client.input.size();
+            break;
+        }
+        Handle(payload, payloadLength, client.output);
+        consumed += frameLength;
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + consumed);
+}
+
+void WindowDaemon::Write(Client& client) {
+    while (client.outputOffset < client.output.size()) {
+        ssize_t sent = send(client.fd, client.output.data() + client.outputOffset,
+                            client.output.size() - client.outputOffset, MSG_NOSIGNAL);
+        if (sent > 0) {
+            client.outputOffset += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            client.closing = true;
+            client.output.clear();
+            client.outputOffset = 0;
+        }
+        return;
+    }
+    client.output.clear();
+    client.outputOffset = 0;
+}
+
+void WindowDaemon::UpdateInterest(Client& client) {
+    bool pending = client.outputOffset < client.output.size();
+    uint32_t events = EPOLLRDHUP;
+    if (pending) {
+        events |= EPOLLOUT;
+    }
+    // Backpressure: a client that does not read its responses is not read either
+    if (!pending || client.output.size() - client.outputOffset < kMaxPendingOutput) {
+        events |= EPOLLIN;
+    }
+    Watch(client.fd, events, EPOLL_CTL_MOD);
+}
+
+void WindowDaemon::Close(int fd) {
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients_.erase(fd);
+}
+
+void WindowDaemon::Handle(const uint8_t* payload, size_t length, std::vector<uint8_t>& out) {
+    ProtocolReader request(payload, length);
+    uint32_t id = request.U32();
+    auto opcode = static_cast<ControlOpcode>(request.U8());
+
+    ProtocolWriter response(out);
+    response.BeginFrame();
+    response.U32(id);
+    size_t statusOffset = out.size();
+    response.U8(static_cast<uint8_t>(ControlStatus::Ok));
+
+    auto fail = [&](ControlStatus status) {
+        out.resize(statusOffset);
+        response.U8(static_cast<uint8_t>(status));
+    };
+
+    switch (opcode) {
+        case ControlOpcode::Ping:
+            break;
+
+        case ControlOpcode::ListWindows: {
+            uint16_t count = request.U16();
+            std::vector<int> pids;
+            for (uint16_t i = 0; i < count && request.ok(); i++) {
+                pids.push_back(request.I32());
+            }
+            if (!request.ok()) {
+                fail(ControlStatus::Malformed);
+                break;
+            }
+            for (const auto& windows : control_.FindWindowsForPids(pids)) {
+                response.U16(static_cast<uint16_t>(windows.size()));
+                for (const auto& win : windows) {
+                    response.U32(win.window);
+                    response.U8(win.isExtension ? 1 : 0);
+                    response.I32(win.x);
+                    response.I32(win.y);
+                    response.I32(win.width);
+                    response.I32(win.height);
+                }
+            }
+            break;
+        }
+
+        case ControlOpcode::GetMonitors: {
+            auto monitors = core_->Monitors();
+            response.U8(static_cast<uint8_t>(monitors.size()));
+            for (const auto& monitor : monitors) {
+                response.I32(monitor.x);
+                response.I32(monitor.y);
+                response.I32(monitor.width);
+                response.I32(monitor.height);
+                response.U8(monitor.isPrimary ? 1 : 0);
+            }
+            break;
+        }
+
+        case ControlOpcode::Arrange: {
+            std::vector<int> pids{request.I32()};
+            uint16_t childCount = request.U16();
+            for (uint16_t i = 0; i < childCount && request.ok(); i++) {
+                pids.push_back(request.I32());
+            }
+            int columns = request.U16();
+            int width = request.I32();
+            int height = request.I32();
+            int spacing = request.I32();
+            int monitorIndex = request.U8();
+            bool force = request.U8() != 0;
+            if (!request.ok() || columns <= 0) {
+                fail(ControlStatus::Malformed);
+                break;
+            }
+            auto monitors = core_->Monitors();
+            if (monitorIndex >= static_cast<int>(monitors.size())) {
+                fail(ControlStatus::Failed);
+                break;
+            }
+            ArrangeResult result =
+                control_.Arrange(pids, monitors[monitorIndex], columns, width, height, spacing, force);
+            response.U32(static_cast<uint32_t>(result.moved));
+            response.U32(static_cast<uint32_t>(result.skipped));
+            response.U32(static_cast<uint32_t>(result.missing));
+            break;
+        }
+
+        case ControlOpcode::PointerEvent: {
+            int pid = request.I32();
+            int x = request.I32();
+            int y = request.I32();
+            uint8_t code = request.U8();
+            if (!request.ok() || code > static_cast<uint8_t>(PointerEventCode::RightUp)) {
+                fail(ControlStatus::Malformed);
+                break;
+            }
+            static const PointerEvent kEvents[] = {
+                PointerEvent::Move, PointerEvent::LeftDown, PointerEvent::LeftUp,
+                PointerEvent::RightDown, PointerEvent::RightUp,
+            };
+            response.U8(control_.SendPointerEvent(pid, x, y, kEvents[code]) ? 1 : 0);
+            break;
+        }
+
+        case ControlOpcode::WheelEvent: {
+            int pid = request.I32();
+            int deltaX = request.I32();
+            int deltaY = request.I32();
+            int x = request.I32();
+            int y = request.I32();
+            if (!request.ok()) {
+                fail(ControlStatus::Malformed);
+                break;
+            }
+            response.U8(control_.SendWheelEvent(pid, deltaX, deltaY, x, y) ? 1 : 0);
+            break;
+        }
+
+        case ControlOpcode::WindowOp: {
+            uint8_t code = request.U8();
+            bool value = request.U8() != 0;
+            uint16_t count = request.U16();
+            std::vector<int> pids;
+            for (uint16_t i = 0; i < count && request.ok(); i++) {
+                pids.push_back(request.I32());
+            }
+            if (!request.ok() || code > static_cast<uint8_t>(WindowOpCode::SetAlwaysOnTop)) {
+                fail(ControlStatus::Malformed);
+                break;
+            }
+            static const WindowOp kOps[] = {
+                WindowOp::Minimize, WindowOp::Restore, WindowOp::Hide, WindowOp::Show,
+                WindowOp::Close, WindowOp::BringToFront, WindowOp::SetAlwaysOnTop,
+            };
+            for (int windows : control_.ApplyWindowOp(pids, kOps[code], value)) {
+                response.U16(static_cast<uint16_t>(windows));
+            }
+            break;
+        }
+
+        case ControlOpcode::KeyEvent: {
+            int pid = request.I32();
+            uint8_t keyCode = request.U8();
+            uint8_t code = request.U8();
+            int x = request.I32();
+            int y = request.I32();
+            if (!request.ok() || code > static_cast<uint8_t>(KeyEventCode::Up)) {
+                fail(ControlStatus::Malformed);
+                break;
+            }
+            KeyEvent event = code == static_cast<uint8_t>(KeyEventCode::Down) ? KeyEvent::Down : KeyEvent::Up;
+            response.U8(control_.SendKeyEvent(pid, keyCode, event, x, y) ? 1 : 0);
+            break;
+        }
+
+        default:
+            fail(ControlStatus::UnknownOpcode);
+            break;
+    }
+
+    response.EndFrame();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string socketPath = DefaultSocketPath();
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--socket <path>]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::shared_ptr<AddonCore> core = AddonCore::Acquire();
+    X11WindowControl control(core);
+    if (!control.IsOpen()) {
+        LOG_ERROR("Cannot open the X11 display (is DISPLAY set?)");
+        return 1;
+    }
+
+    WindowDaemon daemon(core, control);
+    if (!daemon.Listen(socketPath)) {
+        return 1;
+    }
+    // Supervisors wait for this line before connecting
+    std::cout << "Listening on " << socketPath << std::endl;
+    return daemon.Run();
+}
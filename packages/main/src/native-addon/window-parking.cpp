@@ -0,0 +1,105 @@
+#include "window-parking.h"
+
+#include <algorithm>
+
+#include "process-stats.h"
+
+WindowParking::Plan WindowParking::Update(const std::vector<int>& pids, const std::vector<int>& active) {
+    Plan plan;
+    std::unordered_set<int> keep(active.begin(), active.end());
+    std::unordered_set<int> managed(pids.begin(), pids.end());
+    // Active profiles are managed even when left out of pids
+    managed.insert(active.begin(), active.end());
+
+    for (int pid : managed) {
+        bool park = keep.count(pid) == 0;
+        bool parked = parked_.count(pid) != 0;
+        if (park && !parked) {
+            plan.park.push_back(pid);
+            parked_.insert(pid);
+        } else if (!park && parked) {
+            plan.unpark.push_back(pid);
+            parked_.erase(pid);
+        }
+    }
+    for (auto it = parked_.begin(); it != parked_.end();) {
+        if (managed.count(*it) == 0) {
+            plan.unpark.push_back(*it);
+            it = parked_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = cpuNs_.begin(); it != cpuNs_.end();) {
+        it = managed.count(it->first) ? std::next(it) : cpuNs_.erase(it);
+    }
+    managed_ = std::move(managed);
+
+    // Stable order for the window operations
+    std::sort(plan.park.begin(), plan.park.end());
+    std::sort(plan.unpark.begin(), plan.unpark.end());
+    return plan;
+}
+
+std::vector<int> WindowParking::Release() {
+    std::vector<int> unpark(parked_.begin(), parked_.end());
+    std::sort(unpark.begin(), unpark.end());
+    managed_.clear();
+    parked_.clear();
+    cpuNs_.clear();
+    return unpark;
+}
+
+void WindowParking::RecordSwap(double elapsedMs) {
+    swaps_++;
+    lastSwapMs_ = elapsedMs;
+}
+
+WindowParking::Stats WindowParking::Sample() {
+    Stats stats;
+    stats.parked = static_cast<int>(parked_.size());
+    stats.active = static_cast<int>(managed_.size() - parked_.size());
+    stats.swaps = swaps_;
+    stats.lastSwapMs = lastSwapMs_;
+
+    auto now = std::chrono::steady_clock::now();
+    bool baseline = sampled_.time_since_epoch().count() != 0;
+    double wallNs = std::chrono::duration<double, std::nano>(now - sampled_).count();
+    sampled_ = now;
+
+    double activeTotal = 0;
+    double parkedTotal = 0;
+    int activeSampled = 0;
+    int parkedSampled = 0;
+    for (int pid : managed_) {
+        uint64_t cpuNs = ProcessTreeCpuTime(pid);
+        auto previous = cpuNs_.find(pid);
+        if (baseline && previous != cpuNs_.end() && wallNs > 0) {
+            // A process that exited takes its CPU time with it
+            double percent = cpuNs > previous->second ? (cpuNs - previous->second) * 100.0 / wallNs : 0;
+            if (parked_.count(pid)) {
+                parkedTotal += percent;
+                parkedSampled++;
+            } else {
+                activeTotal += percent;
+                activeSampled++;
+            }
+        }
+        cpuNs_[pid] = cpuNs;
+    }
+
+    if (baseline) {
+        stats.sampleMs = wallNs / 1e6;
+    }
+    if (activeSampled > 0) {
+        stats.activeCpuPercent = activeTotal / activeSampled;
+    }
+    if (parkedSampled > 0) {
+        stats.parkedCpuPercent = parkedTotal / parkedSampled;
+    }
+    if (activeSampled > 0 && parkedSampled > 0) {
+        stats.savedCpuPercent =
+            std::max(0.0, stats.activeCpuPercent - stats.parkedCpuPercent) * static_cast<double>(stats.parked);
+    }
+    return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Parking of idle profiles: of all the profiles managed, only an active set
+// stays on screen and the rest are minimized or hidden, which Chrome treats
+// as occluded and throttles (no painting, timers clamped). Each update only
+// moves the profiles whose state changes, so swapping a few windows in and
+// out of a large set is two small batches.
+//
+// The CPU time of every managed profile (its whole process tree) is sampled
+// on demand, to measure what parking saves.
+class WindowParking {
+public:
+    struct Plan {
+        std::vector<int> park;
+        std::vector<int> unpark;
+    };
+
+    struct Stats {
+        int active = 0;
+        int parked = 0;
+        uint64_t swaps = 0;        // updates that changed anything
+        double lastSwapMs = 0;     // time the last one took to apply
+        double sampleMs = 0;       // wall time covered by the CPU figures, 0 on the first sample
+        double activeCpuPercent = 0;   // average per active profile, 100 = one core
+        double parkedCpuPercent = 0;   // average per parked profile
+        // (active - parked average) for every parked profile: the CPU the
+        // parked set would use on screen
+        double savedCpuPercent = 0;
+    };
+
+    // pids are all the profiles managed, active the ones to keep on screen.
+    // Profiles no longer managed are unparked.
+    Plan Update(const std::vector<int>& pids, const std::vector<int>& active);
+    // Stop managing; returns the profiles to unpark
+    std::vector<int> Release();
+    bool Empty() const { return managed_.empty(); }
+
+    void RecordSwap(double elapsedMs);
+
+    // CPU use since the previous call
+    Stats Sample();
+
+private:
+    std::unordered_set<int> managed_;
+    std::unordered_set<int> parked_;
+    uint64_t swaps_ = 0;
+    double lastSwapMs_ = 0;
+
+    std::unordered_map<int, uint64_t> cpuNs_;
+    std::chrono::steady_clock::time_point sampled_;
+};
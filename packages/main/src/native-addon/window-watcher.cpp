@@ -0,0 +1,402 @@
+#include "window-watcher.h"
+
+#include <algorithm>
+#include <future>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include "window-control.h"
+#endif
+
+#include "addon-common.h"
+#include "addon-core.h"
+#include "process-tree.h"
+
+WindowWatcher::WindowWatcher(std::shared_ptr<AddonCore> core) : core_(std::move(core)) {}
+
+WindowWatcher::~WindowWatcher() {
+    Stop();
+}
+
+void WindowWatcher::Wait(int pid, WindowKind kind, std::chrono::milliseconds timeout, Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            added_.push_back({pid, kind, std::chrono::steady_clock::now() + timeout, std::move(callback)});
+            callback = nullptr;
+        }
+    }
+    if (callback) {
+        callback(false, Window());
+        return;
+    }
+#ifdef _WIN32
+    PostThreadMessage(threadId_, WM_APP, 0, 0);
+#elif __linux__
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd_, &one, sizeof(one));
+    (void)written;
+#endif
+}
+
+bool WindowWatcher::TakeAdded(bool& added) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    added = !added_.empty();
+    for (auto& waiter : added_) {
+        waiters_.push_back(std::move(waiter));
+    }
+    added_.clear();
+    return running_;
+}
+
+void WindowWatcher::CheckWaiters(std::chrono::steady_clock::time_point now, bool windowsShown) {
+    recheck_ = false;
+    if (waiters_.empty()) {
+        return;
+    }
+
+    std::vector<int> pids;
+    for (const auto& waiter : waiters_) {
+        if (std::find(pids.begin(), pids.end(), waiter.pid) == pids.end()) {
+            pids.push_back(waiter.pid);
+        }
+    }
+    auto windowsByPid = FindWindows(pids);
+
+    std::vector<Waiter> pending;
+    for (auto& waiter : waiters_) {
+        size_t slot = std::find(pids.begin(), pids.end(), waiter.pid) - pids.begin();
+        const Window* match = nullptr;
+        for (const auto& window : windowsByPid[slot]) {
+            bool extension = waiter.kind == WindowKind::Extension;
+            if (waiter.kind == WindowKind::Unknown || window.isExtension == extension) {
+                match = &window;
+                break;
+            }
+        }
+        if (match) {
+            waiter.callback(true, *match);
+        } else {
+            pending.push_back(std::move(waiter));
+        }
+    }
+    waiters_ = std::move(pending);
+
+    // The window may belong to a child the process index reads on its next
+    // refresh. Look once more then rather than polling.
+    if (windowsShown && !waiters_.empty()) {
+        recheck_ = true;
+        recheckAt_ = now + ProcessTree::kRefreshInterval;
+    }
+}
+
+void WindowWatcher::ExpireWaiters(std::chrono::steady_clock::time_point now) {
+    std::vector<Waiter> pending;
+    for (auto& waiter : waiters_) {
+        if (now >= waiter.deadline) {
+            waiter.callback(false, Window());
+        } else {
+            pending.push_back(std::move(waiter));
+        }
+    }
+    waiters_ = std::move(pending);
+}
+
+void WindowWatcher::FailAll() {
+    bool added = false;
+    TakeAdded(added);
+    for (auto& waiter : waiters_) {
+        waiter.callback(false, Window());
+    }
+    waiters_.clear();
+    recheck_ = false;
+}
+
+int WindowWatcher::NextTimeoutMs(std::chrono::steady_clock::time_point now) const {
+    bool any = recheck_;
+    auto next = recheckAt_;
+    for (const auto& waiter : waiters_) {
+        if (!any || waiter.deadline < next) {
+            next = waiter.deadline;
+            any = true;
+        }
+    }
+    if (!any) {
+        return -1;
+    }
+    if (next <= now) {
+        return 0;
+    }
+    // Round up so the wake-up is never early
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(next - now).count());
+}
+
+#ifdef _WIN32
+
+namespace {
+// The hook has no user data; it only fires on the thread that installed it
+thread_local WindowWatcher* hookOwner = nullptr;
+}  // namespace
+
+void CALLBACK WindowWatcher::OnWindowShown(HWINEVENTHOOK, DWORD, HWND hwnd, LONG objectId, LONG childId, DWORD,
+                                           DWORD) {
+    // Only top-level windows themselves, not their controls
+    if (hookOwner && hwnd && objectId == OBJID_WINDOW && childId == CHILDID_SELF &&
+        GetAncestor(hwnd, GA_PARENT) == GetDesktopWindow()) {
+        hookOwner->shown_ = true;
+    }
+}
+
+std::vector<std::vector<WindowWatcher::Window>> WindowWatcher::FindWindows(const std::vector<int>& pids) {
+    std::vector<std::vector<Window>> windows(pids.size());
+    std::unordered_map<int, int> owners = ProcessTree::Shared().OwnerMap(pids);
+    std::unordered_map<int, size_t> slots;
+    for (size_t i = 0; i < pids.size(); i++) {
+        slots.emplace(pids[i], i);
+    }
+
+    HWND hwnd = nullptr;
+    while ((hwnd = FindWindowEx(nullptr, hwnd, nullptr, nullptr)) != nullptr) {
+        DWORD pid = 0;
+        GetWindowThreadProcessId(hwnd, &pid);
+        auto owner = owners.find(static_cast<int>(pid));
+        if (owner == owners.end() || !IsWindowVisible(hwnd)) {
+            continue;
+        }
+
+        WindowKind kind = core_->ClassifyWindow(
+            reinterpret_cast<uint64_t>(hwnd), pid,
+            [hwnd](WindowTraits& traits) { ReadWin32WindowTraits(hwnd, traits); },
+            [hwnd](std::string& title) { ReadWin32WindowTitle(hwnd, title); });
+        if (kind == WindowKind::Main || kind == WindowKind::Extension) {
+            RECT rect;
+            GetWindowRect(hwnd, &rect);
+            Window window;
+            window.handle = reinterpret_cast<uint64_t>(hwnd);
+            window.isExtension = kind == WindowKind::Extension;
+            window.x = rect.left;
+            window.y = rect.top;
+            window.width = rect.right - rect.left;
+            window.height = rect.bottom - rect.top;
+            windows[slots[owner->second]].push_back(window);
+        }
+    }
+    return windows;
+}
+
+bool WindowWatcher::Start() {
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    std::promise<bool> started;
+    std::future<bool> ready = started.get_future();
+    thread_ = std::thread([this, &started] {
+        MSG msg;
+        // Create the message queue before Wait() or Stop() can post to it
+        PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+        threadId_ = GetCurrentThreadId();
+        hookOwner = this;
+
+        HWINEVENTHOOK hook = SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_SHOW, NULL,
+                                             &WindowWatcher::OnWindowShown, 0, 0, WINEVENT_OUTOFCONTEXT);
+        if (!hook) {
+            LOG_ERROR("SetWinEventHook failed (LastError: " << GetLastError() << ")");
+            started.set_value(false);
+            return;
+        }
+        started.set_value(true);
+        Run();
+        UnhookWinEvent(hook);
+        hookOwner = nullptr;
+    });
+
+    if (!ready.get()) {
+        thread_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        return false;
+    }
+    return true;
+}
+
+void WindowWatcher::Run() {
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        int timeout = NextTimeoutMs(now);
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, timeout < 0 ? INFINITE : static_cast<DWORD>(timeout),
+                                  QS_ALLINPUT);
+
+        // The hook is called from here, while messages are dispatched
+        MSG msg;
+        bool quit = false;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                quit = true;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        bool added = false;
+        if (quit || !TakeAdded(added)) {
+            break;
+        }
+
+        now = std::chrono::steady_clock::now();
+        bool shown = shown_;
+        shown_ = false;
+        if (shown || added || (recheck_ && now >= recheckAt_)) {
+            CheckWaiters(now, shown);
+        }
+        ExpireWaiters(now);
+    }
+    FailAll();
+}
+
+void WindowWatcher::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    PostThreadMessage(threadId_, WM_QUIT, 0, 0);
+    thread_.join();
+}
+
+#elif __linux__
+
+std::vector<std::vector<WindowWatcher::Window>> WindowWatcher::FindWindows(const std::vector<int>& pids) {
+    std::vector<std::vector<Window>> windows(pids.size());
+    auto windowsByPid = control_->FindWindowsForPids(pids);
+    for (size_t i = 0; i < pids.size(); i++) {
+        for (const auto& win : windowsByPid[i]) {
+            Window window;
+            window.handle = win.window;
+            window.isExtension = win.isExtension;
+            window.x = win.x;
+            window.y = win.y;
+            window.width = win.width;
+            window.height = win.height;
+            windows[i].push_back(window);
+        }
+    }
+    return windows;
+}
+
+bool WindowWatcher::Start() {
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    // The watcher owns its connection: the atom cache is not thread-safe
+    control_ = std::make_unique<X11WindowControl>(core_);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!control_->IsOpen() || wakeFd_ < 0) {
+        control_.reset();
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+            wakeFd_ = -1;
+        }
+        return false;
+    }
+
+    // MapNotify for windows mapped without a window manager, _NET_CLIENT_LIST
+    // for the ones a window manager adopts
+    control_->Connection().SelectRootEvents(XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    thread_ = std::thread([this] { Run(); });
+    return true;
+}
+
+void WindowWatcher::Run() {
+    xcb_connection_t* connection = control_->Connection().Get();
+    xcb_atom_t clientList = control_->Connection().Atom("_NET_CLIENT_LIST");
+
+    pollfd fds[2] = {{xcb_get_file_descriptor(connection), POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    while (true) {
+        bool shown = false;
+        while (xcb_generic_event_t* event = xcb_poll_for_event(connection)) {
+            uint8_t type = event->response_type & 0x7f;
+            if (type == XCB_MAP_NOTIFY ||
+                (type == XCB_PROPERTY_NOTIFY &&
+                 reinterpret_cast<xcb_property_notify_event_t*>(event)->atom == clientList)) {
+                shown = true;
+            }
+            free(event);
+        }
+        if (xcb_connection_has_error(connection)) {
+            LOG_ERROR("Lost the X11 connection, window waits stopped");
+            break;
+        }
+
+        uint64_t wakeups = 0;
+        ssize_t drained = read(wakeFd_, &wakeups, sizeof(wakeups));
+        (void)drained;
+        bool added = false;
+        if (!TakeAdded(added)) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (shown || added || (recheck_ && now >= recheckAt_)) {
+            CheckWaiters(now, shown);
+            // Events that arrive during the lookup's round trips stay queued
+            // inside xcb, so drain again before polling the socket
+            continue;
+        }
+        ExpireWaiters(now);
+
+        if (poll(fds, 2, NextTimeoutMs(now)) < 0 && errno != EINTR) {
+            break;
+        }
+    }
+    FailAll();
+}
+
+void WindowWatcher::Stop() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd_, &one, sizeof(one));
+        (void)written;
+        thread_.join();
+    }
+    control_.reset();
+    if (wakeFd_ >= 0) {
+        close(wakeFd_);
+        wakeFd_ = -1;
+    }
+}
+
+#else
+
+std::vector<std::vector<WindowWatcher::Window>> WindowWatcher::FindWindows(const std::vector<int>& pids) {
+    return std::vector<std::vector<Window>>(pids.size());
+}
+
+bool WindowWatcher::Start() {
+    return false;
+}
+
+void WindowWatcher::Stop() {}
+
+void WindowWatcher::Run() {}
+
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "window-classifier.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+class AddonCore;
+#ifdef __linux__
+class X11WindowControl;
+#endif
+
+// Waits for the browser window of a process (or any process it started) to
+// appear, on a background thread woken by the window system's window
+// creation notifications: EVENT_OBJECT_SHOW from SetWinEventHook on Windows,
+// MapNotify and _NET_CLIENT_LIST changes on the X11 root window. Pending
+// waits are only checked when a window was shown, so a hundred profiles
+// launching at once cost no polling. A window whose process the process
+// index has not seen yet is checked again once the index may have caught up.
+//
+// macOS has no such notification off the main run loop, so Start() fails
+// there and callers keep their own fallback.
+class WindowWatcher {
+public:
+    struct Window {
+        uint64_t handle = 0;
+        bool isExtension = false;
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Runs on the watcher thread, exactly once per wait (on the caller's
+    // thread when the watcher is not running). found is false when the wait
+    // timed out or the watcher stopped.
+    using Callback = std::function<void(bool found, const Window& window)>;
+
+    explicit WindowWatcher(std::shared_ptr<AddonCore> core);
+    ~WindowWatcher();
+
+    WindowWatcher(const WindowWatcher&) = delete;
+    WindowWatcher& operator=(const WindowWatcher&) = delete;
+
+    // False when window creation cannot be followed (no X display, or macOS)
+    bool Start();
+    // Pending waits complete with found = false
+    void Stop();
+
+    // kind is Main or Extension; Unknown accepts either. A window that is
+    // already there completes the wait straight away.
+    void Wait(int pid, WindowKind kind, std::chrono::milliseconds timeout, Callback callback);
+
+private:
+    struct Waiter {
+        int pid;
+        WindowKind kind;
+        std::chrono::steady_clock::time_point deadline;
+        Callback callback;
+    };
+
+    // Watcher thread only
+    void Run();
+    // Move new waits over; false once Stop() was called
+    bool TakeAdded(bool& added);
+    // Look up the window of every waiter. windowsShown says a window just
+    // appeared, so a miss is worth one more look later.
+    void CheckWaiters(std::chrono::steady_clock::time_point now, bool windowsShown);
+    void ExpireWaiters(std::chrono::steady_clock::time_point now);
+    void FailAll();
+    // Milliseconds until the next deadline or re-check, -1 for none
+    int NextTimeoutMs(std::chrono::steady_clock::time_point now) const;
+    // Main and extension windows of every pid (or any process it started)
+    std::vector<std::vector<Window>> FindWindows(const std::vector<int>& pids);
+
+    std::shared_ptr<AddonCore> core_;
+
+    // Waits added since the watcher thread last looked
+    std::mutex mutex_;
+    std::vector<Waiter> added_;
+    bool running_ = false;
+
+    // Watcher thread only
+    std::vector<Waiter> waiters_;
+    // Set after a lookup missed while windows were appearing
+    std::chrono::steady_clock::time_point recheckAt_;
+    bool recheck_ = false;
+
+    std::thread thread_;
+#ifdef _WIN32
+    static void CALLBACK OnWindowShown(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG objectId, LONG childId,
+                                       DWORD threadId, DWORD time);
+    DWORD threadId_ = 0;
+    bool shown_ = false;
+#elif __linux__
+    std::unique_ptr<X11WindowControl> control_;
+    int wakeFd_ = -1;
+#endif
+};
@@ -0,0 +1,474 @@
+#include "x11-connection.h"
+
+#ifdef __linux__
+
+#include <cstdlib>
+#include <cstring>
+
+#include "addon-common.h"
+
+X11Connection::X11Connection() {
+    int screenIndex = 0;
+    xcb_connection_t* connection = xcb_connect(nullptr, &screenIndex);
+    if (!connection || xcb_connection_has_error(connection)) {
+        LOG_ERROR("Failed to connect to X server");
+        if (connection) {
+            xcb_disconnect(connection);
+        }
+        return;
+    }
+
+    xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(connection));
+    for (int i = 0; i < screenIndex && it.rem; i++) {
+        xcb_screen_next(&it);
+    }
+    if (!it.rem) {
+        LOG_ERROR("X server reported no screens");
+        xcb_disconnect(connection);
+        return;
+    }
+
+    connection_ = connection;
+    screen_ = it.data;
+}
+
+X11Connection::~X11Connection() {
+    if (connection_) {
+        xcb_disconnect(connection_);
+    }
+}
+
+xcb_atom_t X11Connection::Atom(const char* name) {
+    auto cached = atoms_.find(name);
+    if (cached != atoms_.end()) {
+        return cached->second;
+    }
+
+    xcb_atom_t atom = XCB_ATOM_NONE;
+    xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(
+        connection_, xcb_intern_atom(connection_, 0, static_cast<uint16_t>(strlen(name)), name), nullptr);
+    if (reply) {
+        atom = reply->atom;
+        free(reply);
+    }
+    atoms_.emplace(name, atom);
+    return atom;
+}
+
+std::vector<xcb_window_t> X11Connection::ClientWindows() {
+    std::vector<xcb_window_t> windows;
+    if (!connection_) {
+        return windows;
+    }
+
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(
+        connection_,
+        xcb_get_property(connection_, 0, Root(), Atom("_NET_CLIENT_LIST_STACKING"), XCB_ATOM_WINDOW, 0, 4096),
+        nullptr);
+    if (reply) {
+        int count = xcb_get_property_value_length(reply) / static_cast<int>(sizeof(xcb_window_t));
+        auto* data = static_cast<xcb_window_t*>(xcb_get_property_value(reply));
+        windows.assign(data, data + count);
+        free(reply);
+    }
+
+    if (!windows.empty()) {
+        return windows;
+    }
+
+    xcb_query_tree_reply_t* tree = xcb_query_tree_reply(connection_, xcb_query_tree(connection_, Root()), nullptr);
+    if (tree) {
+        xcb_window_t* children = xcb_query_tree_children(tree);
+        windows.assign(children, children + xcb_query_tree_children_length(tree));
+        free(tree);
+    }
+    return windows;
+}
+
+std::vector<int> X11Connection::WindowPids(const std::vector<xcb_window_t>& windows) {
+    std::vector<int> pids(windows.size(), 0);
+    if (!connection_) {
+        return pids;
+    }
+
+    xcb_atom_t pidAtom = Atom("_NET_WM_PID");
+    std::vector<xcb_get_property_cookie_t> cookies;
+    cookies.reserve(windows.size());
+    for (xcb_window_t window : windows) {
+        cookies.push_back(xcb_get_property(connection_, 0, window, pidAtom, XCB_ATOM_CARDINAL, 0, 1));
+    }
+
+    for (size_t i = 0; i < cookies.size(); i++) {
+        xcb_get_property_reply_t* reply = xcb_get_property_reply(connection_, cookies[i], nullptr);
+        if (!reply) {
+            continue;
+        }
+        if (xcb_get_property_value_length(reply) >= 4) {
+            pids[i] = static_cast<int>(*static_cast<uint32_t*>(xcb_get_property_value(reply)));
+        }
+        free(reply);
+    }
+    return pids;
+}
+
+int X11Connection::WindowPid(xcb_window_t window) {
+    return WindowPids({window})[0];
+}
+
+bool X11Connection::WindowRootGeometry(xcb_window_t window, int& x, int& y, int& width, int& height) {
+    if (!connection_) {
+        return false;
+    }
+
+    xcb_get_geometry_cookie_t geometryCookie = xcb_get_geometry(connection_, window);
+    xcb_translate_coordinates_cookie_t translateCookie =
+        xcb_translate_coordinates(connection_, window, Root(), 0, 0);
+
+    xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(connection_, geometryCookie, nullptr);
+    xcb_translate_coordinates_reply_t* translated =
+        xcb_translate_coordinates_reply(connection_, translateCookie, nullptr);
+
+    bool ok = geometry && translated;
+    if (ok) {
+        x = translated->dst_x;
+        y = translated->dst_y;
+        width = geometry->width;
+        height = geometry->height;
+    }
+    free(geometry);
+    free(translated);
+    return ok;
+}
+
+bool X11Connection::IsViewable(xcb_window_t window) {
+    if (!connection_) {
+        return false;
+    }
+
+    xcb_get_window_attributes_reply_t* attributes = xcb_get_window_attributes_reply(
+        connection_, xcb_get_window_attributes(connection_, window), nullptr);
+    if (!attributes) {
+        return false;
+    }
+    bool viewable = attributes->map_state == XCB_MAP_STATE_VIEWABLE;
+    free(attributes);
+    return viewable;
+}
+
+std::string X11Connection::WindowTitle(xcb_window_t window) {
+    std::string title;
+    if (!connection_) {
+        return title;
+    }
+
+    xcb_get_property_cookie_t netName = xcb_get_property(
+        connection_, 0, window, Atom("_NET_WM_NAME"), Atom("UTF8_STRING"), 0, 1024);
+    xcb_get_property_cookie_t wmName = xcb_get_property(
+        connection_, 0, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 1024);
+
+    for (xcb_get_property_cookie_t cookie : {netName, wmName}) {
+        xcb_get_property_reply_t* reply = xcb_get_property_reply(connection_, cookie, nullptr);
+        if (!reply) {
+            continue;
+        }
+        int length = xcb_get_property_value_length(reply);
+        if (title.empty() && length > 0) {
+            title.assign(static_cast<const char*>(xcb_get_property_value(reply)), length);
+        }
+        free(reply);
+    }
+    return title;
+}
+
+std::vector<WindowGeometry> X11Connection::WindowGeometries(const std::vector<xcb_window_t>& windows) {
+    std::vector<WindowGeometry> geometries(windows.size());
+    if (!connection_) {
+        return geometries;
+    }
+
+    std::vector<xcb_get_window_attributes_cookie_t> attributeCookies;
+    std::vector<xcb_get_geometry_cookie_t> geometryCookies;
+    std::vector<xcb_translate_coordinates_cookie_t> translateCookies;
+    attributeCookies.reserve(windows.size());
+    geometryCookies.reserve(windows.size());
+    translateCookies.reserve(windows.size());
+    for (xcb_window_t window : windows) {
+        attributeCookies.push_back(xcb_get_window_attributes(connection_, window));
+        geometryCookies.push_back(xcb_get_geometry(connection_, window));
+        translateCookies.push_back(xcb_translate_coordinates(connection_, window, Root(), 0, 0));
+    }
+
+    for (size_t i = 0; i < windows.size(); i++) {
+        auto* attributes = xcb_get_window_attributes_reply(connection_, attributeCookies[i], nullptr);
+        auto* geometry = xcb_get_geometry_reply(connection_, geometryCookies[i], nullptr);
+        auto* translated = xcb_translate_coordinates_reply(connection_, translateCookies[i], nullptr);
+        if (attributes && geometry && translated) {
+            WindowGeometry& result = geometries[i];
+            result.x = translated->dst_x;
+            result.y = translated->dst_y;
+            result.width = geometry->width;
+            result.height = geometry->height;
+            result.viewable = attributes->map_state == XCB_MAP_STATE_VIEWABLE;
+            result.valid = true;
+        }
+        free(attributes);
+        free(geometry);
+        free(translated);
+    }
+    return geometries;
+}
+
+void X11Connection::WindowClass(xcb_window_t window, std::string& instance, std::string& className,
+                                std::string& role) {
+    instance.clear();
+    className.clear();
+    role.clear();
+    if (!connection_) {
+        return;
+    }
+
+    xcb_get_property_cookie_t classCookie = xcb_get_property(
+        connection_, 0, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256);
+    xcb_get_property_cookie_t roleCookie = xcb_get_property(
+        connection_, 0, window, Atom("WM_WINDOW_ROLE"), XCB_ATOM_STRING, 0, 256);
+
+    // WM_CLASS holds two NUL-terminated strings: instance then class
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(connection_, classCookie, nullptr);
+    if (reply) {
+        const char* value = static_cast<const char*>(xcb_get_property_value(reply));
+        int length = xcb_get_property_value_length(reply);
+        int split = static_cast<int>(strnlen(value, length));
+        instance.assign(value, split);
+        if (split + 1 < length) {
+            className.assign(value + split + 1, strnlen(value + split + 1, length - split - 1));
+        }
+        free(reply);
+    }
+
+    reply = xcb_get_property_reply(connection_, roleCookie, nullptr);
+    if (reply) {
+        role.assign(static_cast<const char*>(xcb_get_property_value(reply)), xcb_get_property_value_length(reply));
+        free(reply);
+    }
+}
+
+bool X11Connection::HasWindowManager() {
+    if (!connection_) {
+        return false;
+    }
+
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(
+        connection_,
+        xcb_get_property(connection_, 0, Root(), Atom("_NET_SUPPORTING_WM_CHECK"), XCB_ATOM_WINDOW, 0, 1),
+        nullptr);
+    bool present = reply && xcb_get_property_value_length(reply) >= 4;
+    free(reply);
+    return present;
+}
+
+bool X11Connection::WorkArea(int& x, int& y, int& width, int& height) {
+    if (!connection_) {
+        return false;
+    }
+
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(
+        connection_,
+        xcb_get_property(connection_, 0, Root(), Atom("_NET_WORKAREA"), XCB_ATOM_CARDINAL, 0, 4),
+        nullptr);
+    bool ok = reply && xcb_get_property_value_length(reply) >= 16;
+    if (ok) {
+        auto* values = static_cast<uint32_t*>(xcb_get_property_value(reply));
+        x = static_cast<int>(values[0]);
+        y = static_cast<int>(values[1]);
+        width = static_cast<int>(values[2]);
+        height = static_cast<int>(values[3]);
+    }
+    free(reply);
+    return ok;
+}
+
+xcb_window_t X11Connection::ActiveWindow() {
+    if (!connection_) {
+        return XCB_NONE;
+    }
+
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(
+        connection_,
+        xcb_get_property(connection_, 0, Root(), Atom("_NET_ACTIVE_WINDOW"), XCB_ATOM_WINDOW, 0, 1),
+        nullptr);
+    xcb_window_t window = XCB_NONE;
+    if (reply && xcb_get_property_value_length(reply) >= 4) {
+        window = *static_cast<xcb_window_t*>(xcb_get_property_value(reply));
+    }
+    free(reply);
+    return window;
+}
+
+bool X11Connection::PointerPosition(int& x, int& y) {
+    if (!connection_) {
+        return false;
+    }
+
+    xcb_query_pointer_reply_t* reply =
+        xcb_query_pointer_reply(connection_, xcb_query_pointer(connection_, Root()), nullptr);
+    if (!reply) {
+        return false;
+    }
+    x = reply->root_x;
+    y = reply->root_y;
+    free(reply);
+    return true;
+}
+
+void X11Connection::SelectRootEvents(uint32_t mask) {
+    if (!connection_) {
+        return;
+    }
+    xcb_change_window_attributes(connection_, Root(), XCB_CW_EVENT_MASK, &mask);
+    xcb_flush(connection_);
+}
+
+static xcb_client_message_event_t ClientMessage(xcb_window_t window, xcb_atom_t type,
+                                                const std::array<uint32_t, 5>& data) {
+    xcb_client_message_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.format = 32;
+    event.window = window;
+    event.type = type;
+    for (size_t i = 0; i < data.size(); i++) {
+        event.data.data32[i] = data[i];
+    }
+    return event;
+}
+
+void X11Connection::SendRootMessage(xcb_window_t window, xcb_atom_t type, const std::array<uint32_t, 5>& data) {
+    if (!connection_) {
+        return;
+    }
+
+    xcb_client_message_event_t event = ClientMessage(window, type, data);
+    xcb_send_event(connection_, 0, Root(),
+                   XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY,
+                   reinterpret_cast<const char*>(&event));
+}
+
+void X11Connection::SendWindowMessage(xcb_window_t window, xcb_atom_t type, const std::array<uint32_t, 5>& data) {
+    if (!connection_) {
+        return;
+    }
+
+    xcb_client_message_event_t event = ClientMessage(window, type, data);
+    xcb_send_event(connection_, 0, window, XCB_EVENT_MASK_NO_EVENT, reinterpret_cast<const char*>(&event));
+}
+
+void X11Connection::WithdrawWindow(xcb_window_t window) {
+    if (!connection_) {
+        return;
+    }
+
+    xcb_unmap_window(connection_, window);
+
+    xcb_unmap_notify_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.response_type = XCB_UNMAP_NOTIFY;
+    event.event = Root();
+    event.window = window;
+    xcb_send_event(connection_, 0, Root(),
+                   XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY,
+                   reinterpret_cast<const char*>(&event));
+}
+
+void X11Connection::SendPointerEvent(xcb_window_t window, uint8_t type, uint8_t button, int rootX, int rootY,
+                                     int windowX, int windowY, uint16_t state) {
+    if (!connection_) {
+        return;
+    }
+
+    // MotionNotify shares the ButtonPress layout, with detail unused
+    xcb_button_press_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.response_type = type;
+    event.detail = button;
+    event.time = XCB_CURRENT_TIME;
+    event.root = Root();
+    event.event = window;
+    event.child = XCB_NONE;
+    event.root_x = static_cast<int16_t>(rootX);
+    event.root_y = static_cast<int16_t>(rootY);
+    event.event_x = static_cast<int16_t>(windowX);
+    event.event_y = static_cast<int16_t>(windowY);
+    event.state = state;
+    event.same_screen = 1;
+
+    uint32_t mask = XCB_EVENT_MASK_POINTER_MOTION;
+    if (type == XCB_BUTTON_PRESS) {
+        mask = XCB_EVENT_MASK_BUTTON_PRESS;
+    } else if (type == XCB_BUTTON_RELEASE) {
+        mask = XCB_EVENT_MASK_BUTTON_RELEASE;
+    }
+    xcb_send_event(connection_, 0, window, mask, reinterpret_cast<const char*>(&event));
+}
+
+void X11Connection::SendKeyEvent(xcb_window_t window, uint8_t type, uint8_t keycode, uint16_t state) {
+    if (!connection_) {
+        return;
+    }
+
+    xcb_key_press_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.response_type = type;
+    event.detail = keycode;
+    event.time = XCB_CURRENT_TIME;
+    event.root = Root();
+    event.event = window;
+    event.child = XCB_NONE;
+    event.state = state;
+    event.same_screen = 1;
+
+    uint32_t mask = type == XCB_KEY_PRESS ? XCB_EVENT_MASK_KEY_PRESS : XCB_EVENT_MASK_KEY_RELEASE;
+    xcb_send_event(connection_, 0, window, mask, reinterpret_cast<const char*>(&event));
+}
+
+bool X11Connection::KeyboardMapping(uint8_t& firstKeycode, int& keysymsPerKeycode,
+                                    std::vector<xcb_keysym_t>& keysyms) {
+    if (!connection_) {
+        return false;
+    }
+
+    const xcb_setup_t* setup = xcb_get_setup(connection_);
+    firstKeycode = setup->min_keycode;
+    uint8_t count = static_cast<uint8_t>(setup->max_keycode - setup->min_keycode + 1);
+    xcb_get_keyboard_mapping_reply_t* reply = xcb_get_keyboard_mapping_reply(
+        connection_, xcb_get_keyboard_mapping(connection_, firstKeycode, count), nullptr);
+    if (!reply) {
+        return false;
+    }
+    keysymsPerKeycode = reply->keysyms_per_keycode;
+    const xcb_keysym_t* data = xcb_get_keyboard_mapping_keysyms(reply);
+    keysyms.assign(data, data + xcb_get_keyboard_mapping_keysyms_length(reply));
+    free(reply);
+    return keysymsPerKeycode > 0;
+}
+
+void X11Connection::ChangeKeyboardMapping(uint8_t keycode, int keysymsPerKeycode, const xcb_keysym_t* keysyms) {
+    if (!connection_) {
+        return;
+    }
+    xcb_change_keyboard_mapping(connection_, 1, keycode, static_cast<uint8_t>(keysymsPerKeycode), keysyms);
+}
+
+void X11Connection::Flush() {
+    if (connection_) {
+        xcb_flush(connection_);
+    }
+}
+
+void X11Connection::Sync() {
+    if (connection_) {
+        // GetInputFocus is the cheapest request with a reply
+        free(xcb_get_input_focus_reply(connection_, xcb_get_input_focus(connection_), nullptr));
+    }
+}
+
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <xcb/xcb.h>
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct WindowGeometry {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    bool viewable = false;
+    bool valid = false;
+};
+
+// Thin wrapper over an XCB connection plus the EWMH helpers the addon needs.
+// The connection itself is thread-safe, but the atom cache is not, so every
+// engine that runs on its own thread opens its own X11Connection.
+class X11Connection {
+public:
+    X11Connection();
+    ~X11Connection();
+
+    X11Connection(const X11Connection&) = delete;
+    X11Connection& operator=(const X11Connection&) = delete;
+
+    bool IsOpen() const { return connection_ != nullptr; }
+    xcb_connection_t* Get() const { return connection_; }
+    xcb_screen_t* Screen() const { return screen_; }
+    xcb_window_t Root() const { return screen_ ? screen_->root : XCB_NONE; }
+
+    // Interned atom, cached per connection
+    xcb_atom_t Atom(const char* name);
+
+    // Top-level client windows in stacking order, bottom first, from
+    // _NET_CLIENT_LIST_STACKING. Falls back to the root's children when no
+    // EWMH window manager is running (e.g. bare Xvfb).
+    std::vector<xcb_window_t> ClientWindows();
+
+    // _NET_WM_PID of each window (0 when unset). Requests are pipelined.
+    std::vector<int> WindowPids(const std::vector<xcb_window_t>& windows);
+    int WindowPid(xcb_window_t window);
+
+    // Window rectangle in root coordinates
+    bool WindowRootGeometry(xcb_window_t window, int& x, int& y, int& width, int& height);
+    bool IsViewable(xcb_window_t window);
+    std::string WindowTitle(xcb_window_t window);
+    // Root-relative geometry and map state of every window, pipelined
+    std::vector<WindowGeometry> WindowGeometries(const std::vector<xcb_window_t>& windows);
+    // WM_CLASS instance and class names, and WM_WINDOW_ROLE
+    void WindowClass(xcb_window_t window, std::string& instance, std::string& className, std::string& role);
+
+    // An EWMH window manager is running (_NET_SUPPORTING_WM_CHECK is set)
+    bool HasWindowManager();
+    // _NET_WORKAREA of the current desktop
+    bool WorkArea(int& x, int& y, int& width, int& height);
+    // _NET_ACTIVE_WINDOW, XCB_NONE when unset (no EWMH window manager)
+    xcb_window_t ActiveWindow();
+    // Where the pointer is, in root coordinates. One round trip.
+    bool PointerPosition(int& x, int& y);
+    // Receive the events in mask (e.g. XCB_EVENT_MASK_PROPERTY_CHANGE) for the
+    // root window on this connection
+    void SelectRootEvents(uint32_t mask);
+
+    // Queue an EWMH client message about window to the root window.
+    // Nothing is flushed, so callers can batch several requests.
+    void SendRootMessage(xcb_window_t window, xcb_atom_t type, const std::array<uint32_t, 5>& data);
+    // Queue a client message straight to window, e.g. WM_PROTOCOLS
+    void SendWindowMessage(xcb_window_t window, xcb_atom_t type, const std::array<uint32_t, 5>& data);
+    // Queue an ICCCM withdraw: unmap plus the synthetic UnmapNotify that
+    // tells a window manager to stop managing the window
+    void WithdrawWindow(xcb_window_t window);
+    // Queue a synthetic MotionNotify, ButtonPress or ButtonRelease for window.
+    // It goes straight to the window, the real pointer does not move.
+    void SendPointerEvent(xcb_window_t window, uint8_t type, uint8_t button, int rootX, int rootY,
+                          int windowX, int windowY, uint16_t state);
+    // Queue a synthetic KeyPress or KeyRelease of an X keycode for window,
+    // with modifier state (e.g. XCB_MOD_MASK_SHIFT)
+    void SendKeyEvent(xcb_window_t window, uint8_t type, uint8_t keycode, uint16_t state = 0);
+
+    // Keysyms of every keycode from firstKeycode on, keysymsPerKeycode per
+    // keycode. One round trip.
+    bool KeyboardMapping(uint8_t& firstKeycode, int& keysymsPerKeycode, std::vector<xcb_keysym_t>& keysyms);
+    // Queue a new mapping of keysymsPerKeycode keysyms for one keycode. Every
+    // client gets a MappingNotify.
+    void ChangeKeyboardMapping(uint8_t keycode, int keysymsPerKeycode, const xcb_keysym_t* keysyms);
+
+    void Flush();
+    // Flush and wait until the server has processed every request
+    void Sync();
+
+private:
+    xcb_connection_t* connection_ = nullptr;
+    xcb_screen_t* screen_ = nullptr;
+    std::unordered_map<std::string, xcb_atom_t> atoms_;
+};
+
+#endif
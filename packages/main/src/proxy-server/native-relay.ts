@@ -0,0 +1,103 @@
+import {app} from 'electron';
+import path from 'path';
+import {createLogger} from '../../../shared/utils/logger';
+import {PROXY_LOGGER_LABEL} from '../constants';
+
+const logger = createLogger(PROXY_LOGGER_LABEL);
+
+export interface NativeRelayUpstream {
+  type: 'socks5' | 'http';
+  host: string;
+  port: number;
+  username?: string;
+  password?: string;
+}
+
+export interface NativeRelayStats {
+  id: number;
+  connections: number;
+  active: number;
+  failures: number;
+  bytesUp: number;
+  bytesDown: number;
+  connectSamples: number;
+  connectMsAvg: number;
+  connectMsMax: number;
+}
+
+interface ProxyRelayInstance {
+  addRoute(options: {listenHost?: string; listenPort?: number; upstream: NativeRelayUpstream}): {
+    id: number;
+    port: number;
+  };
+  removeRoute(id: number): boolean;
+  getStats(): NativeRelayStats[];
+  getStats(id: number): NativeRelayStats | null;
+  close(): void;
+}
+
+export interface NativeRelayRoute {
+  id: number;
+  proxyUrl: string;
+  stats(): NativeRelayStats | null;
+  close(callback?: () => void): void;
+}
+
+let relay: ProxyRelayInstance | null | undefined;
+
+// 代理中继只在 Linux 上编译（epoll/splice），其他平台继续使用 socks-server
+function getRelay(): ProxyRelayInstance | null {
+  if (relay !== undefined) {
+    return relay;
+  }
+  relay = null;
+  if (process.platform !== 'linux') {
+    return relay;
+  }
+
+  const addonPath = app.isPackaged
+    ? path.join(process.resourcesPath, 'app.asar.unpacked/node_modules/window-addon/', 'proxy-relay.node')
+    : path.join(__dirname, '../src/native-addon/build/Release/', 'proxy-relay.node');
+  try {
+    const addon = require(addonPath);
+    if (addon.supported) {
+      relay = new addon.ProxyRelay() as ProxyRelayInstance;
+    }
+  } catch (error) {
+    logger.warn('Native proxy relay not available, using the JS proxy server:', error);
+  }
+  return relay;
+}
+
+/**
+ * Opens a loopback SOCKS5 listener that chains through the given upstream.
+ * Returns null when the native relay is not available on this platform.
+ */
+export function createNativeRelayRoute(upstream: NativeRelayUpstream): NativeRelayRoute | null {
+  const instance = getRelay();
+  if (!instance) {
+    return null;
+  }
+
+  let route: {id: number; port: number};
+  try {
+    route = instance.addRoute({listenHost: '127.0.0.1', listenPort: 0, upstream});
+  } catch (error) {
+    logger.error('Failed to add native relay route:', error);
+    return null;
+  }
+
+  return {
+    id: route.id,
+    proxyUrl: `socks5://127.0.0.1:${route.port}`,
+    stats: () => instance.getStats(route.id),
+    close: callback => {
+      instance.removeRoute(route.id);
+      callback?.();
+    },
+  };
+}
+
+export function getNativeRelayStats(): NativeRelayStats[] {
+  return getRelay()?.getStats() ?? [];
+}
@@ -5,6 +5,7 @@ import {createLogger} from '../../../shared/utils/logger';
 import {SERVICE_LOGGER_LABEL} from '../constants';
 import {WindowDB} from '../db/window';
 import puppeteer, {type Browser} from 'puppeteer';
+import api from '../../../shared/api/api';
 
 const logger = createLogger(SERVICE_LOGGER_LABEL);
 
@@ -74,7 +75,7 @@ interface SyncOptions {
   enableWheelSync?: boolean;
   enableCdpSync?: boolean; // Enable CDP-based synchronization
   wheelThrottleMs?: number;
-  cdpSyncIntervalMs?: number; // Interval for CDP sync polling
+  cdpSyncIntervalMs?: number; // Interval for CDP sync polling (puppeteer fallback only)
 }
 
 // Load native addon
@@ -132,7 +133,16 @@ class MultiWindowSyncService {
     cdpSyncIntervalMs: 100,
   };
 
-  // CDP connections
+  // A drag the addon is replaying to the slaves, see startNativeDrag
+  private nativeDragActive: boolean = false;
+  // A press already forwarded to the slaves. It becomes a native drag once
+  // the pointer moves dragThresholdPx away with the button held, so plain
+  // clicks never start one.
+  private pendingDrag: {x: number; y: number; eventType: string} | null = null;
+  private readonly dragThresholdPx = 4;
+
+  // CDP connections (puppeteer fallback when the native CDP sync is unavailable)
+  private nativeCdpSync: boolean = false;
   private cdpBrowsers: Map<number, Browser> = new Map();
   private cdpSyncInterval: NodeJS.Timeout | null = null;
   private lastScrollPosition: {x: number; y: number} = {x: 0, y: 0};
@@ -236,6 +246,13 @@ class MultiWindowSyncService {
       }
       this.accumulatedWheelRotation = 0;
 
+      // Release a drag still held on the slaves
+      this.pendingDrag = null;
+      if (this.nativeDragActive) {
+        this.nativeDragActive = false;
+        this.windowManager?.endDrag(this.lastMouseX, this.lastMouseY);
+      }
+
       this.isCapturing = false;
       this.masterWindowPid = null;
       this.slaveWindowPids.clear();
@@ -299,6 +316,9 @@ class MultiWindowSyncService {
     uIOhook.on('mousemove', this.handleMouseMove.bind(this));
     logger.debug('✓ mousemove listener registered (focus tracking only, no sync)');
 
+    uIOhook.on('mousedrag', this.handleMouseDrag.bind(this));
+    logger.debug('✓ mousedrag listener registered');
+
     uIOhook.on('mousedown', this.handleMouseDown.bind(this));
     logger.debug('✓ mousedown listener registered');
 
@@ -332,6 +352,7 @@ class MultiWindowSyncService {
     if (!uIOhook) return;
 
     uIOhook.removeAllListeners('mousemove');
+    uIOhook.removeAllListeners('mousedrag');
     uIOhook.removeAllListeners('mousedown');
     uIOhook.removeAllListeners('mouseup');
     uIOhook.removeAllListeners('mousewheel');
@@ -424,16 +445,45 @@ class MultiWindowSyncService {
     }
   }
 
+  /**
+   * Handle moves with a button held: a press forwarded to the slaves turns
+   * into a native drag once the pointer has moved far enough from it
+   */
+  private handleMouseDrag(event: MouseEventData): void {
+    try {
+      if (!this.isCapturing || !this.masterWindowBounds) return;
+
+      const {x, y} = event;
+      this.lastMouseX = x;
+      this.lastMouseY = y;
+
+      const press = this.pendingDrag;
+      if (!press || Math.hypot(x - press.x, y - press.y) < this.dragThresholdPx) return;
+      this.pendingDrag = null;
+      this.startNativeDrag(press.x, press.y, press.eventType);
+    } catch (error) {
+      logger.error('Error in handleMouseDrag:', error);
+    }
+  }
+
   /**
    * Handle mouse down events
    */
   private handleMouseDown(event: MouseEventData): void {
     try {
       if (!this.isCapturing || !this.masterWindowBounds) return;
-      if (!this.syncOptions.enableMouseSync) return;
 
       const {x, y, button} = event;
 
+      // A new press means the last button came up, even if its mouseup was lost
+      this.pendingDrag = null;
+      if (this.nativeDragActive) {
+        this.nativeDragActive = false;
+        this.windowManager.endDrag(x, y);
+      }
+
+      if (!this.syncOptions.enableMouseSync) return;
+
       // Check if master window is active (foreground)
       if (!this.windowManager.isProcessWindowActive(this.masterWindowPid)) {
         devLogger.debug('Master window not active - skipping mouse event');
@@ -522,22 +572,63 @@ class MultiWindowSyncService {
             logger.error(`Failed to send mouse down event to slave ${slavePid}:`, error);
           }
         }
+
+        // The addon replays the path if this press turns into a drag
+        if (typeof this.windowManager.startDrag === 'function') {
+          this.pendingDrag = {x, y, eventType};
+        }
       }
     } catch (error) {
       logger.error('Error in handleMouseDown:', error);
     }
   }
 
+  /**
+   * Start a native drag from the press at x, y, which the slaves already
+   * hold: the addon samples the pointer and replays its path to them from a
+   * timer thread until mouseup, so drags do not depend on the throttled
+   * mousemove stream. False where the addon has no drag backend (only X11
+   * has one); the slaves then only get the release.
+   */
+  private startNativeDrag(x: number, y: number, eventType: string): boolean {
+    try {
+      this.nativeDragActive = this.windowManager.startDrag(
+        this.masterWindowPid,
+        Array.from(this.slaveWindowBounds.keys()),
+        x,
+        y,
+        {button: eventType === 'rightdown' ? 'right' : 'left', pressed: true},
+      );
+    } catch (error) {
+      logger.error('Failed to start native drag:', error);
+      this.nativeDragActive = false;
+    }
+    if (this.nativeDragActive) {
+      devLogger.debug(`🖱️ Native drag from (${x}, ${y}) to ${this.slaveWindowBounds.size} slaves`);
+    }
+    return this.nativeDragActive;
+  }
+
   /**
    * Handle mouse up events
    */
   private handleMouseUp(event: MouseEventData): void {
     try {
       if (!this.isCapturing || !this.masterWindowBounds) return;
-      if (!this.syncOptions.enableMouseSync) return;
 
       const {x, y, button} = event;
 
+      // A native drag ends wherever the button comes up, even outside the
+      // master window. The addon drops a drag whose master window it could
+      // not find, and then the release is forwarded below like any other.
+      this.pendingDrag = null;
+      if (this.nativeDragActive) {
+        this.nativeDragActive = false;
+        if (this.windowManager.endDrag(x, y)) return;
+      }
+
+      if (!this.syncOptions.enableMouseSync) return;
+
       // Check if master window is active (foreground)
       if (!this.windowManager.isProcessWindowActive(this.masterWindowPid)) {
         devLogger.debug('Master window not active - skipping mouse event');
@@ -1131,6 +1222,10 @@ class MultiWindowSyncService {
       // Get CDP endpoints for all windows
       if (!this.masterWindowPid) return;
 
+      if (await this.startNativeCdpSync()) {
+        return;
+      }
+
       const masterWindow = await WindowDB.getByPid(this.masterWindowPid);
       if (masterWindow && masterWindow.debug_port) {
         try {
@@ -1173,10 +1268,64 @@ class MultiWindowSyncService {
     }
   }
 
+  /**
+   * Page-level DevTools WebSocket URL of the first tab behind a debugging port
+   */
+  private async getPageDebuggerUrl(port: number): Promise<string | null> {
+    try {
+      const {data} = await api.get(`http://127.0.0.1:${port}/json/list`, {timeout: 1000});
+      const page = (data as SafeAny[]).find(target => target.type === 'page' && target.webSocketDebuggerUrl);
+      return page ? page.webSocketDebuggerUrl : null;
+    } catch (error) {
+      logger.error(`Failed to list CDP targets on port ${port}:`, error);
+      return null;
+    }
+  }
+
+  /**
+   * Scroll sync in the native addon: the master page pushes scroll changes
+   * and they are fanned out to the slaves without polling
+   */
+  private async startNativeCdpSync(): Promise<boolean> {
+    if (!this.masterWindowPid || typeof this.windowManager?.startCdpSync !== 'function') {
+      return false;
+    }
+
+    const masterWindow = await WindowDB.getByPid(this.masterWindowPid);
+    if (!masterWindow?.debug_port) {
+      return false;
+    }
+    const masterUrl = await this.getPageDebuggerUrl(masterWindow.debug_port);
+    if (!masterUrl) {
+      return false;
+    }
+
+    const slaveUrls: string[] = [];
+    for (const slavePid of this.slaveWindowPids) {
+      const slaveWindow = await WindowDB.getByPid(slavePid);
+      if (!slaveWindow?.debug_port) continue;
+      const slaveUrl = await this.getPageDebuggerUrl(slaveWindow.debug_port);
+      if (slaveUrl) {
+        slaveUrls.push(slaveUrl);
+      }
+    }
+
+    this.nativeCdpSync = this.windowManager.startCdpSync(masterUrl, slaveUrls) === true;
+    if (this.nativeCdpSync) {
+      logger.info('Native CDP sync started', {slaves: slaveUrls.length});
+    }
+    return this.nativeCdpSync;
+  }
+
   /**
    * Stop CDP synchronization
    */
   private async stopCdpSync(): Promise<void> {
+    if (this.nativeCdpSync) {
+      this.windowManager.stopCdpSync();
+      this.nativeCdpSync = false;
+    }
+
     // Stop interval
     if (this.cdpSyncInterval) {
       clearInterval(this.cdpSyncInterval);
@@ -1,8 +1,9 @@
 import {app, ipcMain, systemPreferences, shell} from 'electron';
+import type {ChildProcess} from 'child_process';
 import path from 'path';
 import type {SafeAny} from '../../../shared/types/db';
-import { createLogger } from '../../../shared/utils/logger';
-import { MAIN_LOGGER_LABEL } from '../constants';
+import { createLogger, forwardNativeLogs } from '../../../shared/utils/logger';
+import { MAIN_LOGGER_LABEL, NATIVE_LOGGER_LABEL } from '../constants';
 import { dialog } from 'electron';
 const logger = createLogger(MAIN_LOGGER_LABEL);
 let addon: unknown;
@@ -28,6 +29,39 @@ if (!app.isPackaged) {
   }
 }
 
+// Shared with callers outside the IPC handlers, set by initSyncService
+let sharedWindowManager: SafeAny = null;
+
+/**
+ * Whether waitForWindow can watch for new windows: not on macOS, nor when the
+ * addon failed to load.
+ */
+export const canWaitForWindow = () => typeof sharedWindowManager?.waitForWindow === 'function';
+
+/**
+ * Wait until the browser window of a freshly launched profile is shown.
+ * Resolves false on timeout, as soon as the process exits, or at once where
+ * the addon cannot watch for new windows.
+ */
+export const waitForWindow = async (child: ChildProcess, timeoutMs = 2_000): Promise<boolean> => {
+  if (!canWaitForWindow() || !child.pid || child.exitCode !== null) {
+    return false;
+  }
+  let onExit = () => {};
+  const exited = new Promise<boolean>(resolve => {
+    onExit = () => resolve(false);
+    child.once('exit', onExit);
+  });
+  const shown = sharedWindowManager
+    .waitForWindow(child.pid, {kind: 'main', timeoutMs})
+    .then((window: unknown) => window !== null);
+  try {
+    return await Promise.race([shown, exited]);
+  } finally {
+    child.off('exit', onExit);
+  }
+};
+
 export const initSyncService = () => {
   if (!addon) {
     logger.error('Window addon not loaded properly', process.resourcesPath);
@@ -58,6 +92,8 @@ export const initSyncService = () => {
   }
   
   const windowManager = new (addon as SafeAny).WindowManager();
+  sharedWindowManager = windowManager;
+  forwardNativeLogs(windowManager, NATIVE_LOGGER_LABEL);
 
   logger.info('WindowManager initialized');
 
@@ -70,19 +106,21 @@ export const initSyncService = () => {
         throw new Error('WindowManager not initialized');
       }
       logger.info('arrangeWindows', windowManager.arrangeWindows.toString());
+      let result: {moved: number; skipped: number; missing: number};
       try {
         // Pass monitorIndex if provided, otherwise let native addon use default (0)
         if (monitorIndex !== undefined) {
-          windowManager.arrangeWindows(mainPid, childPids, columns, size, spacing, monitorIndex);
+          result = windowManager.arrangeWindows(mainPid, childPids, columns, size, spacing, monitorIndex);
         } else {
-          windowManager.arrangeWindows(mainPid, childPids, columns, size, spacing);
+          result = windowManager.arrangeWindows(mainPid, childPids, columns, size, spacing);
         }
       } catch (e) {
         logger.error('Native function execution error:', e);
         throw e;
       }
 
-      return {success: true};
+      logger.info('Windows arranged', result);
+      return {success: true, ...result};
     } catch (error) {
       logger.error('Window arrangement failed:', error);
       return {
@@ -92,6 +130,296 @@ export const initSyncService = () => {
     }
   });
 
+  ipcMain.handle('window-save-layout', async (_, args) => {
+    const {profiles} = args as {profiles: Record<number, string>};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const layout: Uint8Array = windowManager.saveLayout(profiles);
+      logger.info('Saved window layout', {profiles: Object.keys(profiles).length, bytes: layout.length});
+      return {success: true, layout};
+    } catch (error) {
+      logger.error('Failed to save window layout:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('window-restore-layout', async (_, args) => {
+    const {layout, pidMap, force} = args as {
+      layout: Uint8Array;
+      pidMap: Record<string, number>;
+      force?: boolean;
+    };
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const result = windowManager.restoreLayout(layout, pidMap, {force: !!force});
+      logger.info('Restored window layout', result);
+      return {success: true, ...result};
+    } catch (error) {
+      logger.error('Failed to restore window layout:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('window-bulk-op', async (_, args) => {
+    const {pids, op, value} = args as {pids: number[]; op: string; value?: boolean};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const results: {pid: number; windows: number}[] = windowManager.bulkWindowOp(pids, op, {
+        value: value ?? true,
+      });
+      logger.info('Bulk window operation', {op, profiles: pids.length});
+      return {success: true, results};
+    } catch (error) {
+      logger.error('Bulk window operation failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('window-park', async (_, args) => {
+    const {pids, activePids, mode} = args as {pids: number[]; activePids: number[]; mode?: string};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const result: {parked: number[]; unparked: number[]; elapsedMs: number} = windowManager.parkWindows(
+        pids,
+        activePids,
+        {mode: mode ?? 'minimize'},
+      );
+      logger.info('Parked windows', {parked: result.parked.length, unparked: result.unparked.length});
+      return {success: true, ...result};
+    } catch (error) {
+      logger.error('Parking windows failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('window-unpark', async () => {
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      return {success: true, unparked: windowManager.unparkWindows() as number};
+    } catch (error) {
+      logger.error('Unparking windows failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('window-parking-stats', async () => {
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      return {success: true, stats: windowManager.getParkingStats()};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('profile-usage-start', async (_, args) => {
+    const {pids, options} = args as {
+      pids: number[];
+      options?: {intervalMs?: number; history?: number; slots?: number; pss?: boolean};
+    };
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const sampler = windowManager.startProfileSampler(pids, options ?? {});
+      logger.info('Profile usage sampler started', {profiles: pids.length, slots: sampler.slotCount});
+      return {success: true, ...sampler};
+    } catch (error) {
+      logger.error('Starting the profile usage sampler failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('profile-usage-set-profiles', async (_, args) => {
+    const {pids} = args as {pids: number[]};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      return {success: windowManager.setSampledProfiles(pids) as boolean};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('profile-usage-samples', async (_, args) => {
+    const {frames} = (args ?? {}) as {frames?: number};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      return {success: true, samples: windowManager.getProfileSamples(frames ?? 1)};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('profile-usage-stop', async () => {
+    windowManager?.stopProfileSampler();
+    return {success: true};
+  });
+
+  ipcMain.handle('process-set-policy', async (_, args) => {
+    const {pid, policy} = args as {pid: number; policy: Record<string, unknown>};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const result: {processes: number; failed: number} = windowManager.setProcessPolicy(pid, policy);
+      logger.info('Scheduling policy applied', {pid, ...result});
+      return {success: true, ...result};
+    } catch (error) {
+      logger.error('Applying scheduling policy failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('process-clear-policy', async (_, args) => {
+    const {pid} = args as {pid: number};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      return {success: windowManager.clearProcessPolicy(pid) as boolean};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('process-foreground-boost', async (_, args) => {
+    const {policy, cgroupRoot} = args as {policy: Record<string, unknown> | null; cgroupRoot?: string};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      if (cgroupRoot && !windowManager.setSchedulingOptions({cgroupRoot})) {
+        logger.warn('cgroup root not usable, CPU weights will not apply', {cgroupRoot});
+      }
+      return {success: windowManager.setForegroundBoost(policy) as boolean};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('process-reclaim-memory', async (_, args) => {
+    const {pid, mode} = args as {pid: number; mode?: 'pageout' | 'cold'};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      const result: {processes: number; failed: number; reclaimedBytes: number; elapsedMs: number} =
+        await windowManager.reclaimMemory(pid, {mode});
+      logger.info('Memory reclaimed', {pid, ...result});
+      return {success: true, ...result};
+    } catch (error) {
+      logger.error('Memory reclaim failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('process-auto-reclaim', async (_, args) => {
+    const {pids, idleMs, mode} = args as {pids: number[]; idleMs: number; mode?: 'pageout' | 'cold'};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      windowManager.setAutoReclaim(pids, {idleMs, mode});
+      return {success: true};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('process-reclaim-stats', async () => {
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      return {success: true, stats: windowManager.getReclaimStats()};
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
+  ipcMain.handle('window-type-templated', async (_, args) => {
+    const {slavePids, values, charDelayMs} = args as {slavePids: number[]; values: string[]; charDelayMs?: number};
+    try {
+      if (!windowManager) {
+        throw new Error('WindowManager not initialized');
+      }
+      // One UTF-8 buffer for all slaves, offsets[i]..offsets[i + 1] per slave
+      const encoded = values.map(value => Buffer.from(value, 'utf8'));
+      const offsets = new Uint32Array(encoded.length + 1);
+      encoded.forEach((bytes, i) => (offsets[i + 1] = offsets[i] + bytes.length));
+      const result: {typed: number[]; characters: number[]; elapsedMs: number} =
+        await windowManager.broadcastTemplatedText(slavePids, Buffer.concat(encoded), offsets, {charDelayMs});
+      logger.info('Templated text typed', {slaves: slavePids.length, elapsedMs: result.elapsedMs});
+      return {success: true, ...result};
+    } catch (error) {
+      logger.error('Typing templated text failed:', error);
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown error',
+      };
+    }
+  });
+
   ipcMain.handle('window-get-monitors', async () => {
     logger.info('Getting available monitors');
     try {
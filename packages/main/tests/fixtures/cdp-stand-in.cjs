@@ -0,0 +1,146 @@
+'use strict';
+
+// Stand-in for a Chrome page DevTools endpoint.
+//
+// Accepts WebSocket connections on 127.0.0.1, records every CDP command it
+// receives and answers each with an empty result (or an error for methods
+// listed in failMethods). emit() pushes an event to the connected clients,
+// e.g. the Runtime.bindingCalled notifications a real page would send.
+
+const crypto = require('node:crypto');
+const http = require('node:http');
+
+const GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11';
+
+function encodeFrame(opcode, payload) {
+  const length = payload.length;
+  let header;
+  if (length < 126) {
+    header = Buffer.from([0x80 | opcode, length]);
+  } else if (length <= 0xffff) {
+    header = Buffer.alloc(4);
+    header[0] = 0x80 | opcode;
+    header[1] = 126;
+    header.writeUInt16BE(length, 2);
+  } else {
+    header = Buffer.alloc(10);
+    header[0] = 0x80 | opcode;
+    header[1] = 127;
+    header.writeBigUInt64BE(BigInt(length), 2);
+  }
+  return Buffer.concat([header, payload]);
+}
+
+// Client frames are always masked
+function decodeFrames(buffer, onFrame) {
+  let offset = 0;
+  while (buffer.length - offset >= 2) {
+    const opcode = buffer[offset] & 0x0f;
+    let length = buffer[offset + 1] & 0x7f;
+    let header = 2;
+    if (length === 126) {
+      if (buffer.length - offset < 4) break;
+      length = buffer.readUInt16BE(offset + 2);
+      header = 4;
+    } else if (length === 127) {
+      if (buffer.length - offset < 10) break;
+      length = Number(buffer.readBigUInt64BE(offset + 2));
+      header = 10;
+    }
+    if (buffer.length - offset < header + 4 + length) break;
+    const mask = buffer.subarray(offset + header, offset + header + 4);
+    const payload = Buffer.alloc(length);
+    for (let i = 0; i < length; i++) {
+      payload[i] = buffer[offset + header + 4 + i] ^ mask[i & 3];
+    }
+    onFrame(opcode, payload);
+    offset += header + 4 + length;
+  }
+  return buffer.subarray(offset);
+}
+
+/**
+ * @param {{failMethods?: string[]}} [options]
+ */
+function startCdpStandIn(options = {}) {
+  const failMethods = new Set(options.failMethods || []);
+  const sockets = new Set();
+  const commands = [];
+  let connections = 0;
+
+  const server = http.createServer((req, res) => {
+    res.writeHead(404);
+    res.end();
+  });
+
+  server.on('upgrade', (req, socket) => {
+    const accept = crypto
+      .createHash('sha1')
+      .update(req.headers['sec-websocket-key'] + GUID)
+      .digest('base64');
+    socket.write(
+      'HTTP/1.1 101 Switching Protocols\r\n' +
+        'Upgrade: websocket\r\n' +
+        'Connection: Upgrade\r\n' +
+        `Sec-WebSocket-Accept: ${accept}\r\n\r\n`,
+    );
+    socket.setNoDelay(true);
+    connections++;
+    sockets.add(socket);
+
+    let pending = Buffer.alloc(0);
+    socket.on('data', chunk => {
+      pending = decodeFrames(Buffer.concat([pending, chunk]), (opcode, payload) => {
+        if (opcode === 0x8) {
+          socket.end(encodeFrame(0x8, Buffer.alloc(0)));
+          return;
+        }
+        if (opcode !== 0x1) {
+          return;
+        }
+        const command = JSON.parse(payload.toString('utf8'));
+        commands.push(command);
+        const reply = failMethods.has(command.method)
+          ? {id: command.id, error: {code: -32000, message: 'stand-in failure'}}
+          : {id: command.id, result: {}};
+        socket.write(encodeFrame(0x1, Buffer.from(JSON.stringify(reply))));
+      });
+    });
+    socket.on('close', () => sockets.delete(socket));
+    socket.on('error', () => sockets.delete(socket));
+  });
+
+  return new Promise(resolve => {
+    server.listen(0, '127.0.0.1', () => {
+      const {port} = server.address();
+      resolve({
+        url: `ws://127.0.0.1:${port}/devtools/page/STAND-IN`,
+        commands,
+        get connections() {
+          return connections;
+        },
+        emit(method, params) {
+          const frame = encodeFrame(0x1, Buffer.from(JSON.stringify({method, params})));
+          for (const socket of sockets) {
+            socket.write(frame);
+          }
+        },
+        // Drop every open connection, as a closing tab would
+        disconnect() {
+          for (const socket of sockets) {
+            socket.destroy();
+          }
+          sockets.clear();
+        },
+        close() {
+          for (const socket of sockets) {
+            socket.destroy();
+          }
+          return new Promise(done => server.close(() => done()));
+        },
+      });
+    });
+  });
+}
+
+module.exports = {startCdpStandIn};
@@ -0,0 +1,71 @@
+/**
+ * Counts heap allocations made by the addon's input paths. Runs in its own
+ * node process started with LD_PRELOAD=alloc-counter.so, so getCoreStats()
+ * reports threadAllocations for the JS thread.
+ *
+ * Started with [JSON.stringify({addonPath, pids, x, y, keyCode, warmup, iterations, ttlMs})].
+ * After warmup rounds it sends `iterations` rounds of mouse, wheel and
+ * keyboard events to every pid, and also runs the same number of rounds that
+ * only read the counter, so allocations made by V8 around the calls can be
+ * told apart from the addon's. The addon refreshes its window lookups every
+ * ttlMs, so the measured rounds start right after a refresh and must finish
+ * within ttlMs. Prints one JSON line:
+ * {baseline, events, sent, keys, strayKey, elapsedMs}, where sent counts the
+ * pointer and wheel events delivered, keys the key events delivered and
+ * strayKey is what a key event for a pid without windows returned.
+ */
+const {addonPath, pids, x, y, keyCode, warmup, iterations, ttlMs} = JSON.parse(process.argv[2]);
+
+const addon = require(addonPath);
+const manager = new addon.WindowManager();
+
+const allocations = () => manager.getCoreStats().threadAllocations;
+
+const sleepSync = ms => Atomics.wait(new Int32Array(new SharedArrayBuffer(4)), 0, 0, ms);
+
+// Adds the events delivered to counts
+function round(counts) {
+  for (const pid of pids) {
+    counts.sent += manager.sendMouseEvent(pid, x, y, 'mousemove') ? 1 : 0;
+    counts.sent += manager.sendMouseEvent(pid, x, y, 'mousedown') ? 1 : 0;
+    counts.sent += manager.sendMouseEvent(pid, x, y, 'mouseup') ? 1 : 0;
+    counts.sent += manager.sendWheelEvent(pid, 0, -120, x, y) ? 1 : 0;
+    counts.keys += manager.sendKeyboardEvent(pid, keyCode, 'keydown') ? 1 : 0;
+    counts.keys += manager.sendKeyboardEvent(pid, keyCode, 'keyup') ? 1 : 0;
+  }
+}
+
+if (allocations() === undefined) {
+  console.log(JSON.stringify({error: 'alloc-counter.so is not preloaded'}));
+  process.exit(1);
+}
+
+const unmeasured = {sent: 0, keys: 0};
+for (let i = 0; i < warmup; i++) {
+  round(unmeasured);
+}
+
+let baseline = 0;
+for (let i = 0; i < iterations; i++) {
+  const before = allocations();
+  baseline += allocations() - before;
+}
+
+// Let the cached lookups expire and refresh them outside the measurement
+sleepSync(ttlMs + 50);
+round(unmeasured);
+
+let events = 0;
+const counts = {sent: 0, keys: 0};
+const started = process.hrtime.bigint();
+for (let i = 0; i < iterations; i++) {
+  const before = allocations();
+  round(counts);
+  events += allocations() - before;
+}
+const elapsedMs = Number(process.hrtime.bigint() - started) / 1e6;
+
+// This process has no windows
+const strayKey = manager.sendKeyboardEvent(process.pid, keyCode, 'keydown');
+
+console.log(JSON.stringify({baseline, events, ...counts, strayKey, elapsedMs}));
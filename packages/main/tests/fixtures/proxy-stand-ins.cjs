@@ -0,0 +1,259 @@
+'use strict';
+
+// Loopback stand-ins for the proxy relay tests: an echo target, upstream
+// SOCKS5 and HTTP CONNECT proxies (optionally requiring credentials) and a
+// minimal SOCKS5 client, the way Chrome talks to the relay, and a minimal
+// HTTP CONNECT client, the way Chrome talks to the JS fallback.
+
+const net = require('node:net');
+
+function listen(server) {
+  return new Promise(resolve => {
+    server.listen(0, '127.0.0.1', () => {
+      resolve({
+        port: server.address().port,
+        close: () => new Promise(done => server.close(() => done())),
+      });
+    });
+  });
+}
+
+// Reads exactly `length` bytes from a socket that is in paused mode
+function readBytes(socket, length) {
+  return new Promise((resolve, reject) => {
+    const tryRead = () => {
+      const chunk = socket.read(length);
+      if (chunk) {
+        socket.off('readable', tryRead);
+        socket.off('end', onEnd);
+        resolve(chunk);
+      }
+    };
+    const onEnd = () => reject(new Error('socket ended'));
+    socket.on('readable', tryRead);
+    socket.once('end', onEnd);
+    tryRead();
+  });
+}
+
+function startEchoServer() {
+  const sockets = new Set();
+  const server = net.createServer(socket => {
+    sockets.add(socket);
+    socket.on('close', () => sockets.delete(socket));
+    socket.on('error', () => {});
+    socket.pipe(socket);
+  });
+  return listen(server).then(handle => ({
+    ...handle,
+    close() {
+      sockets.forEach(socket => socket.destroy());
+      return handle.close();
+    },
+  }));
+}
+
+async function connectTarget(host, port) {
+  const target = net.connect(port, host);
+  await new Promise((resolve, reject) => {
+    target.once('connect', resolve);
+    target.once('error', reject);
+  });
+  return target;
+}
+
+/**
+ * @param {{username?: string, password?: string}} [options]
+ */
+function startSocksUpstream(options = {}) {
+  const stats = {connections: 0, authFailures: 0, destinations: []};
+  const sockets = new Set();
+  const server = net.createServer({pauseOnConnect: true}, async socket => {
+    sockets.add(socket);
+    socket.on('close', () => sockets.delete(socket));
+    socket.on('error', () => {});
+    try {
+      const [version, count] = await readBytes(socket, 2);
+      const methods = await readBytes(socket, count);
+      const wantAuth = Boolean(options.username);
+      if (version !== 5 || !methods.includes(wantAuth ? 2 : 0)) {
+        socket.end(Buffer.from([5, 0xff]));
+        return;
+      }
+      socket.write(Buffer.from([5, wantAuth ? 2 : 0]));
+      if (wantAuth) {
+        const [, userLength] = await readBytes(socket, 2);
+        const username = (await readBytes(socket, userLength)).toString();
+        const [passLength] = await readBytes(socket, 1);
+        const password = (await readBytes(socket, passLength)).toString();
+        if (username !== options.username || password !== options.password) {
+          stats.authFailures++;
+          socket.end(Buffer.from([1, 1]));
+          return;
+        }
+        socket.write(Buffer.from([1, 0]));
+      }
+
+      const [, , , type] = await readBytes(socket, 4);
+      let host;
+      if (type === 1) {
+        host = Array.from(await readBytes(socket, 4)).join('.');
+      } else if (type === 3) {
+        const [length] = await readBytes(socket, 1);
+        host = (await readBytes(socket, length)).toString();
+      } else {
+        socket.end(Buffer.from([5, 8, 0, 1, 0, 0, 0, 0, 0, 0]));
+        return;
+      }
+      const port = (await readBytes(socket, 2)).readUInt16BE(0);
+      stats.destinations.push(`${host}:${port}`);
+
+      const target = await connectTarget(host === 'localhost' ? '127.0.0.1' : host, port).catch(() => null);
+      if (!target) {
+        socket.end(Buffer.from([5, 5, 0, 1, 0, 0, 0, 0, 0, 0]));
+        return;
+      }
+      stats.connections++;
+      socket.write(Buffer.from([5, 0, 0, 1, 127, 0, 0, 1, 0, 0]));
+      target.on('error', () => socket.destroy());
+      socket.pipe(target).pipe(socket);
+      socket.resume();
+    } catch {
+      socket.destroy();
+    }
+  });
+  return listen(server).then(handle => ({
+    ...handle,
+    stats,
+    close() {
+      sockets.forEach(socket => socket.destroy());
+      return handle.close();
+    },
+  }));
+}
+
+/**
+ * @param {{username?: string, password?: string}} [options]
+ */
+function startHttpUpstream(options = {}) {
+  const stats = {connections: 0, authFailures: 0, destinations: []};
+  const sockets = new Set();
+  const expected = options.username
+    ? 'Basic ' + Buffer.from(`${options.username}:${options.password}`).toString('base64')
+    : null;
+
+  const server = net.createServer(socket => {
+    sockets.add(socket);
+    socket.on('close', () => sockets.delete(socket));
+    socket.on('error', () => {});
+    let head = Buffer.alloc(0);
+    const onData = async chunk => {
+      head = Buffer.concat([head, chunk]);
+      const end = head.indexOf('\r\n\r\n');
+      if (end < 0) {
+        return;
+      }
+      socket.off('data', onData);
+      socket.pause();
+      const lines = head.subarray(0, end).toString().split('\r\n');
+      const rest = head.subarray(end + 4);
+      const [method, target] = lines[0].split(' ');
+      const auth = lines.find(line => line.toLowerCase().startsWith('proxy-authorization:'));
+      if (method !== 'CONNECT') {
+        socket.end('HTTP/1.1 405 Method Not Allowed\r\n\r\n');
+        return;
+      }
+      if (expected && (!auth || auth.slice(auth.indexOf(':') + 1).trim() !== expected)) {
+        stats.authFailures++;
+        socket.end('HTTP/1.1 407 Proxy Authentication Required\r\n\r\n');
+        return;
+      }
+      stats.destinations.push(target);
+      const separator = target.lastIndexOf(':');
+      const host = target.slice(0, separator);
+      const port = Number(target.slice(separator + 1));
+      const upstream = await connectTarget(host === 'localhost' ? '127.0.0.1' : host, port).catch(() => null);
+      if (!upstream) {
+        socket.end('HTTP/1.1 502 Bad Gateway\r\n\r\n');
+        return;
+      }
+      stats.connections++;
+      socket.write('HTTP/1.1 200 Connection established\r\nProxy-Agent: stand-in\r\n\r\n');
+      upstream.on('error', () => socket.destroy());
+      if (rest.length > 0) {
+        upstream.write(rest);
+      }
+      socket.pipe(upstream).pipe(socket);
+      socket.resume();
+    };
+    socket.on('data', onData);
+  });
+  return listen(server).then(handle => ({
+    ...handle,
+    stats,
+    close() {
+      sockets.forEach(socket => socket.destroy());
+      return handle.close();
+    },
+  }));
+}
+
+/**
+ * SOCKS5 CONNECT through a local proxy without credentials. Resolves with
+ * the tunnelled socket, or rejects with the reply code.
+ */
+async function socks5Connect(proxyPort, host, port) {
+  const socket = net.connect(proxyPort, '127.0.0.1');
+  socket.setNoDelay(true);
+  await new Promise((resolve, reject) => {
+    socket.once('connect', resolve);
+    socket.once('error', reject);
+  });
+  socket.pause();
+  socket.write(Buffer.from([5, 1, 0]));
+  const [version, method] = await readBytes(socket, 2);
+  if (version !== 5 || method !== 0) {
+    socket.destroy();
+    throw new Error('method rejected');
+  }
+  const name = Buffer.from(host);
+  const request = Buffer.concat([Buffer.from([5, 1, 0, 3, name.length]), name, Buffer.from([port >> 8, port & 0xff])]);
+  socket.write(request);
+  const reply = await readBytes(socket, 10);
+  if (reply[1] !== 0) {
+    socket.destroy();
+    const error = new Error(`SOCKS5 reply ${reply[1]}`);
+    error.code = reply[1];
+    throw error;
+  }
+  return socket;
+}
+
+/**
+ * HTTP CONNECT through a local proxy without credentials. Resolves with the
+ * tunnelled socket, or rejects with the status code.
+ */
+async function httpConnect(proxyPort, host, port) {
+  const socket = net.connect(proxyPort, '127.0.0.1');
+  socket.setNoDelay(true);
+  await new Promise((resolve, reject) => {
+    socket.once('connect', resolve);
+    socket.once('error', reject);
+  });
+  socket.pause();
+  socket.write(`CONNECT ${host}:${port} HTTP/1.1\r\nHost: ${host}:${port}\r\n\r\n`);
+  let head = Buffer.alloc(0);
+  while (head.indexOf('\r\n\r\n') < 0) {
+    head = Buffer.concat([head, await readBytes(socket, 1)]);
+  }
+  const status = Number(head.toString().split(' ')[1]);
+  if (status !== 200) {
+    socket.destroy();
+    const error = new Error(`HTTP status ${status}`);
+    error.code = status;
+    throw error;
+  }
+  return socket;
+}
+
+module.exports = {startEchoServer, startSocksUpstream, startHttpUpstream, socks5Connect, httpConnect, readBytes};
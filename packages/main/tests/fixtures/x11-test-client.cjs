@@ -0,0 +1,470 @@
+/**
+ * Minimal X11 client used by the input latency harness. It speaks the core
+ * protocol directly over the display socket, so it needs no native modules.
+ *
+ * Started with fork(path, [JSON.stringify({display, windows})]), where each
+ * window is {pid, x, y, width, height}. For every window it creates a
+ * top-level window that looks like a Chrome browser window to the addon
+ * (_NET_WM_PID, WM_CLASS, WM_WINDOW_ROLE "browser"), then reports
+ * {type: 'ready'} and streams
+ * {type: 'events', events: [[window, code, eventX, eventY, receivedUs]]}
+ * where receivedUs is process.hrtime in microseconds. ClientMessage events
+ * (code 33) carry their first data word in place of eventX. Send
+ * {type: 'activate', index} to point the root's _NET_ACTIVE_WINDOW at a
+ * window (index -1 clears it), as a window manager would on a focus change,
+ * and {type: 'stop'} to close the connection.
+ *
+ * Windows answer _NET_WM_PING like Chrome does, by sending the message back
+ * to the root window. {type: 'pingDelay', index, ms} holds a window's
+ * answers for ms (a negative ms drops them).
+ *
+ * {type: 'warp', x, y} moves the real pointer to root position x, y.
+ *
+ * Key presses are also read as text through the current keymap, which is
+ * fetched again on every MappingNotify, so keycodes a client binds to new
+ * keysyms on the fly read right. {type: 'text'} answers with
+ * {type: 'text', texts} once every event sent before it has arrived, where
+ * texts[i] is what window i has been typed. Return reads as a newline and
+ * BackSpace deletes the last character.
+ *
+ * {type: 'stripes', index, width} paints black vertical stripes width pixels
+ * wide, width pixels apart, across window index (width 0 paints it white
+ * again) and answers {type: 'drawn', index} once the server has done so.
+ *
+ * {type: 'move', index, x, y} moves a window as a user dragging it would.
+ * {type: 'layout'} answers {type: 'layout', bounds, stack}: [x, y, width,
+ * height] of every window, and the window indices from bottom to top.
+ */
+const net = require('node:net');
+
+const {display, windows} = JSON.parse(process.argv[2]);
+
+const EVENT_MASK =
+  0x00000001 | // KeyPress
+  0x00000002 | // KeyRelease
+  0x00000004 | // ButtonPress
+  0x00000008 | // ButtonRelease
+  0x00000040; // PointerMotion
+
+const ATOM_ATOM = 4;
+const ATOM_STRING = 31;
+const ATOM_CARDINAL = 6;
+const ATOM_WINDOW = 33;
+const ATOM_WM_NAME = 39;
+const ATOM_WM_CLASS = 67;
+
+const pad = length => (4 - (length % 4)) % 4;
+
+const socket = net.createConnection(`/tmp/.X11-unix/X${display}`);
+let buffer = Buffer.alloc(0);
+let setup = null;
+const pendingReplies = [];
+const windowIndex = new Map();
+let batch = [];
+const ids = [];
+let activeAtom = 0;
+let protocolsAtom = 0;
+let pingAtom = 0;
+const pingDelays = new Map();
+let keymap = null;
+let keymapFetches = 0;
+const queuedKeys = [];
+const texts = windows.map(() => '');
+
+function request(bytes, expectsReply) {
+  socket.write(bytes);
+  if (expectsReply) {
+    return new Promise(resolve => pendingReplies.push(resolve));
+  }
+  return Promise.resolve(null);
+}
+
+function internAtom(name) {
+  const nameBytes = Buffer.from(name, 'latin1');
+  const bytes = Buffer.alloc(8 + nameBytes.length + pad(nameBytes.length));
+  bytes.writeUInt8(16, 0);
+  bytes.writeUInt16LE(bytes.length / 4, 2);
+  bytes.writeUInt16LE(nameBytes.length, 4);
+  nameBytes.copy(bytes, 8);
+  return request(bytes, true).then(reply => reply.readUInt32LE(8));
+}
+
+function createWindow(id, x, y, width, height) {
+  const bytes = Buffer.alloc(40);
+  bytes.writeUInt8(1, 0);
+  bytes.writeUInt8(0, 1); // depth: CopyFromParent
+  bytes.writeUInt16LE(10, 2);
+  bytes.writeUInt32LE(id, 4);
+  bytes.writeUInt32LE(setup.root, 8);
+  bytes.writeInt16LE(x, 12);
+  bytes.writeInt16LE(y, 14);
+  bytes.writeUInt16LE(width, 16);
+  bytes.writeUInt16LE(height, 18);
+  bytes.writeUInt16LE(0, 20); // border
+  bytes.writeUInt16LE(1, 22); // InputOutput
+  bytes.writeUInt32LE(0, 24); // visual: CopyFromParent
+  bytes.writeUInt32LE(0x00000002 | 0x00000800, 28); // background pixel, event mask
+  bytes.writeUInt32LE(setup.whitePixel, 32);
+  bytes.writeUInt32LE(EVENT_MASK, 36);
+  return request(bytes, false);
+}
+
+function changeProperty(window, property, type, format, data) {
+  const bytes = Buffer.alloc(24 + data.length + pad(data.length));
+  bytes.writeUInt8(18, 0);
+  bytes.writeUInt8(0, 1); // Replace
+  bytes.writeUInt16LE(bytes.length / 4, 2);
+  bytes.writeUInt32LE(window, 4);
+  bytes.writeUInt32LE(property, 8);
+  bytes.writeUInt32LE(type, 12);
+  bytes.writeUInt8(format, 16);
+  bytes.writeUInt32LE(data.length / (format / 8), 20);
+  data.copy(bytes, 24);
+  return request(bytes, false);
+}
+
+function mapWindow(window) {
+  const bytes = Buffer.alloc(8);
+  bytes.writeUInt8(8, 0);
+  bytes.writeUInt16LE(2, 2);
+  bytes.writeUInt32LE(window, 4);
+  return request(bytes, false);
+}
+
+// ChangeWindowAttributes of the background pixel
+function setBackground(window, pixel) {
+  const bytes = Buffer.alloc(16);
+  bytes.writeUInt8(2, 0);
+  bytes.writeUInt16LE(4, 2);
+  bytes.writeUInt32LE(window, 4);
+  bytes.writeUInt32LE(0x00000002, 8); // background pixel
+  bytes.writeUInt32LE(pixel, 12);
+  return request(bytes, false);
+}
+
+// ClearArea without exposures; a width or height of 0 reaches the edge
+function clearArea(window, x, y, width, height) {
+  const bytes = Buffer.alloc(16);
+  bytes.writeUInt8(61, 0);
+  bytes.writeUInt8(0, 1);
+  bytes.writeUInt16LE(4, 2);
+  bytes.writeUInt32LE(window, 4);
+  bytes.writeInt16LE(x, 8);
+  bytes.writeInt16LE(y, 10);
+  bytes.writeUInt16LE(width, 12);
+  bytes.writeUInt16LE(height, 14);
+  return request(bytes, false);
+}
+
+// ConfigureWindow of the position
+function moveWindow(window, x, y) {
+  const bytes = Buffer.alloc(20);
+  bytes.writeUInt8(12, 0);
+  bytes.writeUInt16LE(5, 2);
+  bytes.writeUInt32LE(window, 4);
+  bytes.writeUInt16LE(0x0001 | 0x0002, 8); // x, y
+  bytes.writeInt32LE(x, 12);
+  bytes.writeInt32LE(y, 16);
+  return request(bytes, false);
+}
+
+// Geometry and stacking of every window, read in one round of requests
+async function readLayout() {
+  const bounds = await Promise.all(
+    ids.map(id => {
+      const bytes = Buffer.alloc(8);
+      bytes.writeUInt8(14, 0); // GetGeometry
+      bytes.writeUInt16LE(2, 2);
+      bytes.writeUInt32LE(id, 4);
+      return request(bytes, true).then(reply => [
+        reply.readInt16LE(12),
+        reply.readInt16LE(14),
+        reply.readUInt16LE(16),
+        reply.readUInt16LE(18),
+      ]);
+    }),
+  );
+  const bytes = Buffer.alloc(8);
+  bytes.writeUInt8(15, 0); // QueryTree, children bottom to top
+  bytes.writeUInt16LE(2, 2);
+  bytes.writeUInt32LE(setup.root, 4);
+  const tree = await request(bytes, true);
+  const stack = [];
+  for (let i = 0; i < tree.readUInt16LE(16); i++) {
+    const index = windowIndex.get(tree.readUInt32LE(32 + i * 4));
+    if (index !== undefined) {
+      stack.push(index);
+    }
+  }
+  return {bounds, stack};
+}
+
+// Black stripes over a white window, or plain white for a width of 0
+function paintStripes(index, width) {
+  const window = ids[index];
+  clearArea(window, 0, 0, 0, 0);
+  if (width > 0) {
+    setBackground(window, setup.blackPixel);
+    for (let x = 0; x < windows[index].width; x += 2 * width) {
+      clearArea(window, x, 0, width, 0);
+    }
+    setBackground(window, setup.whitePixel);
+  }
+}
+
+// SendEvent of a 32 byte event to destination
+function sendEvent(destination, mask, event) {
+  const bytes = Buffer.alloc(44);
+  bytes.writeUInt8(25, 0);
+  bytes.writeUInt8(0, 1); // propagate: false
+  bytes.writeUInt16LE(11, 2);
+  bytes.writeUInt32LE(destination, 4);
+  bytes.writeUInt32LE(mask, 8);
+  event.copy(bytes, 12);
+  return request(bytes, false);
+}
+
+// The ping comes back to the root window, as the EWMH spec has it
+function answerPing(index, event) {
+  const delay = pingDelays.get(index) ?? 0;
+  if (delay < 0) {
+    return;
+  }
+  const reply = Buffer.from(event);
+  reply.writeUInt8(33, 0); // clear the synthetic bit
+  reply.writeUInt32LE(setup.root, 4);
+  const send = () => sendEvent(setup.root, 0x00080000 | 0x00100000, reply); // SubstructureNotify | SubstructureRedirect
+  delay > 0 ? setTimeout(send, delay) : send();
+}
+
+// WarpPointer to a root position, as a user moving the mouse would
+function warpPointer(x, y) {
+  const bytes = Buffer.alloc(24);
+  bytes.writeUInt8(41, 0);
+  bytes.writeUInt16LE(6, 2);
+  bytes.writeUInt32LE(0, 4); // source: None
+  bytes.writeUInt32LE(setup.root, 8);
+  bytes.writeInt16LE(x, 20);
+  bytes.writeInt16LE(y, 22);
+  return request(bytes, false);
+}
+
+// GetKeyboardMapping of every keycode
+function fetchKeymap() {
+  const bytes = Buffer.alloc(8);
+  bytes.writeUInt8(101, 0);
+  bytes.writeUInt16LE(2, 2);
+  bytes.writeUInt8(setup.minKeycode, 4);
+  bytes.writeUInt8(setup.maxKeycode - setup.minKeycode + 1, 5);
+  keymapFetches++;
+  return request(bytes, true).then(reply => {
+    const perKeycode = reply.readUInt8(1);
+    const keysyms = [];
+    for (let offset = 32; offset < reply.length; offset += 4) {
+      keysyms.push(reply.readUInt32LE(offset));
+    }
+    keymap = {perKeycode, keysyms};
+    if (--keymapFetches === 0) {
+      queuedKeys.splice(0).forEach(([index, keycode, state]) => typeKey(index, keycode, state));
+    }
+  });
+}
+
+function keysymText(keysym) {
+  if ((keysym >= 0x20 && keysym <= 0x7e) || (keysym >= 0xa0 && keysym <= 0xff)) {
+    return String.fromCodePoint(keysym);
+  }
+  if (keysym >= 0x01000100 && keysym <= 0x0110ffff) {
+    return String.fromCodePoint(keysym - 0x01000000);
+  }
+  return {0xff0d: '\n', 0xff09: '\t', 0xff8d: '\n'}[keysym] ?? '';
+}
+
+// A key press as an editor would take it: shift picks the second keysym
+function typeKey(index, keycode, state) {
+  const row = (keycode - setup.minKeycode) * keymap.perKeycode;
+  const plain = keymap.keysyms[row] ?? 0;
+  const shifted = keymap.perKeycode > 1 ? keymap.keysyms[row + 1] : 0;
+  const keysym = state & 1 && shifted ? shifted : plain;
+  if (keysym === 0xff08) {
+    texts[index] = [...texts[index]].slice(0, -1).join('');
+  } else {
+    texts[index] += keysymText(keysym);
+  }
+}
+
+// GetInputFocus, used as a round trip so every earlier request is processed
+function sync() {
+  const bytes = Buffer.alloc(4);
+  bytes.writeUInt8(43, 0);
+  bytes.writeUInt16LE(1, 2);
+  return request(bytes, true);
+}
+
+function parseSetup() {
+  if (buffer.length < 8) {
+    return false;
+  }
+  const length = 8 + buffer.readUInt16LE(6) * 4;
+  if (buffer.length < length) {
+    return false;
+  }
+  if (buffer.readUInt8(0) !== 1) {
+    throw new Error(`X server refused the connection: ${buffer.toString('latin1', 8, length)}`);
+  }
+  const vendorLength = buffer.readUInt16LE(24);
+  const formats = buffer.readUInt8(29);
+  const screen = 40 + vendorLength + pad(vendorLength) + formats * 8;
+  setup = {
+    idBase: buffer.readUInt32LE(12),
+    idMask: buffer.readUInt32LE(16),
+    minKeycode: buffer.readUInt8(34),
+    maxKeycode: buffer.readUInt8(35),
+    root: buffer.readUInt32LE(screen),
+    whitePixel: buffer.readUInt32LE(screen + 8),
+    blackPixel: buffer.readUInt32LE(screen + 12),
+  };
+  buffer = buffer.subarray(length);
+  return true;
+}
+
+function parsePackets(receivedUs) {
+  while (buffer.length >= 32) {
+    const code = buffer.readUInt8(0) & 0x7f;
+    if (code === 1) {
+      const length = 32 + buffer.readUInt32LE(4) * 4;
+      if (buffer.length < length) {
+        return;
+      }
+      pendingReplies.shift()(buffer.subarray(0, length));
+      buffer = buffer.subarray(length);
+      continue;
+    }
+
+    if (code === 0) {
+      process.send({type: 'error', code: buffer.readUInt8(1), opcode: buffer.readUInt8(10)});
+    } else if (code >= 2 && code <= 6) {
+      // Key, button and motion events share one layout
+      const index = windowIndex.get(buffer.readUInt32LE(12));
+      if (index !== undefined) {
+        batch.push([index, code, buffer.readInt16LE(24), buffer.readInt16LE(26), receivedUs]);
+        if (code === 2) {
+          // Read with the keymap in force when the key was sent
+          const key = [index, buffer.readUInt8(1), buffer.readUInt16LE(28)];
+          keymapFetches > 0 ? queuedKeys.push(key) : typeKey(...key);
+        }
+      }
+    } else if (code === 34) {
+      if (buffer.readUInt8(4) === 1) {
+        fetchKeymap();
+      }
+    } else if (code === 33) {
+      const index = windowIndex.get(buffer.readUInt32LE(4));
+      if (index !== undefined) {
+        batch.push([index, code, buffer.readUInt32LE(12), 0, receivedUs]);
+        if (buffer.readUInt32LE(8) === protocolsAtom && buffer.readUInt32LE(12) === pingAtom) {
+          answerPing(index, buffer.subarray(0, 32));
+        }
+      }
+    }
+    buffer = buffer.subarray(32);
+  }
+}
+
+socket.on('data', chunk => {
+  const receivedUs = Number(process.hrtime.bigint() / 1000n);
+  buffer = Buffer.concat([buffer, chunk]);
+  if (!setup && !parseSetup()) {
+    return;
+  }
+  parsePackets(receivedUs);
+  if (batch.length > 0) {
+    process.send({type: 'events', events: batch});
+    batch = [];
+  }
+});
+
+socket.on('error', error => {
+  process.send({type: 'error', message: error.message});
+  process.exit(1);
+});
+
+process.on('message', message => {
+  if (message.type === 'stop') {
+    socket.end();
+    process.exit(0);
+  } else if (message.type === 'activate') {
+    const window = Buffer.alloc(4);
+    window.writeUInt32LE(message.index >= 0 ? ids[message.index] : 0, 0);
+    changeProperty(setup.root, activeAtom, ATOM_WINDOW, 32, window);
+  } else if (message.type === 'pingDelay') {
+    pingDelays.set(message.index, message.ms);
+  } else if (message.type === 'warp') {
+    warpPointer(message.x, message.y);
+  } else if (message.type === 'stripes') {
+    paintStripes(message.index, message.width);
+    sync().then(() => process.send({type: 'drawn', index: message.index}));
+  } else if (message.type === 'move') {
+    moveWindow(ids[message.index], message.x, message.y);
+  } else if (message.type === 'layout') {
+    readLayout().then(layout => process.send({type: 'layout', ...layout}));
+  } else if (message.type === 'text') {
+    sync().then(async () => {
+      while (keymapFetches > 0) {
+        await new Promise(resolve => setImmediate(resolve));
+      }
+      process.send({type: 'text', texts});
+    });
+  }
+});
+
+async function main() {
+  // Connection setup: little endian, protocol 11.0, no authorization
+  const hello = Buffer.alloc(12);
+  hello.writeUInt8(0x6c, 0);
+  hello.writeUInt16LE(11, 2);
+  socket.write(hello);
+  await new Promise(resolve => {
+    const wait = () => (setup ? resolve() : setImmediate(wait));
+    wait();
+  });
+
+  const pidAtom = await internAtom('_NET_WM_PID');
+  const roleAtom = await internAtom('WM_WINDOW_ROLE');
+  activeAtom = await internAtom('_NET_ACTIVE_WINDOW');
+  protocolsAtom = await internAtom('WM_PROTOCOLS');
+  pingAtom = await internAtom('_NET_WM_PING');
+  const protocols = Buffer.alloc(4);
+  protocols.writeUInt32LE(pingAtom, 0);
+  const wmClass = Buffer.from('google-chrome\0Google-chrome\0', 'latin1');
+  const role = Buffer.from('browser', 'latin1');
+  const title = Buffer.from('Google Chrome', 'latin1');
+
+  await fetchKeymap();
+
+  const step = setup.idMask & -setup.idMask;
+  for (let i = 0; i < windows.length; i++) {
+    const {pid, x, y, width, height} = windows[i];
+    const id = setup.idBase | (step * (i + 1));
+    const pidData = Buffer.alloc(4);
+    pidData.writeUInt32LE(pid, 0);
+
+    createWindow(id, x, y, width, height);
+    changeProperty(id, pidAtom, ATOM_CARDINAL, 32, pidData);
+    changeProperty(id, ATOM_WM_CLASS, ATOM_STRING, 8, wmClass);
+    changeProperty(id, roleAtom, ATOM_STRING, 8, role);
+    changeProperty(id, ATOM_WM_NAME, ATOM_STRING, 8, title);
+    changeProperty(id, protocolsAtom, ATOM_ATOM, 32, protocols);
+    mapWindow(id);
+    windowIndex.set(id, i);
+    ids.push(id);
+  }
+
+  await sync();
+  process.send({type: 'ready', windows: ids});
+}
+
+main().catch(error => {
+  process.send({type: 'error', message: String(error)});
+  process.exit(1);
+});
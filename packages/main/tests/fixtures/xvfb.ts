@@ -0,0 +1,164 @@
+import type {ChildProcess} from 'node:child_process';
+import {fork, spawn, spawnSync} from 'node:child_process';
+import {createConnection} from 'node:net';
+import {join} from 'node:path';
+import type {Readable} from 'node:stream';
+
+/**
+ * Xvfb for the native addon specs.
+ *
+ * startXvfb() lets the server pick a free display itself (-displayfd), so
+ * parallel vitest workers never share one, and resolves only after an X11
+ * connection setup to that display has succeeded. startStandIns() then maps
+ * the stand-in windows of x11-test-client.cjs on it.
+ */
+
+const CLIENT_PATH = join(__dirname, 'x11-test-client.cjs');
+
+export function hasCommand(command: string): boolean {
+  return spawnSync('sh', ['-c', `command -v ${command}`]).status === 0;
+}
+
+export const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+export async function waitFor(condition: () => boolean, timeoutMs: number): Promise<boolean> {
+  const deadline = Date.now() + timeoutMs;
+  while (!condition()) {
+    if (Date.now() > deadline) {
+      return false;
+    }
+    await sleep(10);
+  }
+  return true;
+}
+
+export interface XvfbServer {
+  display: number;
+  stop(): void;
+}
+
+// The display number Xvfb writes to fd 3 once it listens
+function readDisplay(server: ChildProcess, timeoutMs: number): Promise<number> {
+  return new Promise((resolve, reject) => {
+    let output = '';
+    const timer = setTimeout(() => reject(new Error('Xvfb did not report a display')), timeoutMs);
+    const fail = (code: number | null) => {
+      clearTimeout(timer);
+      reject(new Error(`Xvfb exited with ${code}`));
+    };
+    server.once('exit', fail);
+    (server.stdio[3] as Readable).on('data', (chunk: Buffer) => {
+      output += chunk.toString('latin1');
+      if (output.includes('\n')) {
+        clearTimeout(timer);
+        server.off('exit', fail);
+        resolve(Number(output.trim()));
+      }
+    });
+  });
+}
+
+// True once the server accepts an X11 connection setup on display
+function connects(display: number): Promise<boolean> {
+  return new Promise(resolve => {
+    const socket = createConnection(`/tmp/.X11-unix/X${display}`);
+    let reply = Buffer.alloc(0);
+    const done = (accepted: boolean) => {
+      socket.destroy();
+      resolve(accepted);
+    };
+    socket.on('connect', () => {
+      // Little endian, protocol 11.0, no authorization
+      const hello = Buffer.alloc(12);
+      hello.writeUInt8(0x6c, 0);
+      hello.writeUInt16LE(11, 2);
+      socket.write(hello);
+    });
+    socket.on('data', chunk => {
+      reply = Buffer.concat([reply, chunk]);
+      if (reply.length >= 8) {
+        done(reply.readUInt8(0) === 1);
+      }
+    });
+    socket.on('error', () => done(false));
+    socket.on('close', () => done(false));
+  });
+}
+
+export async function startXvfb(width = 1920, height = 1080, timeoutMs = 10_000): Promise<XvfbServer> {
+  const server = spawn(
+    'Xvfb',
+    ['-displayfd', '3', '-screen', '0', `${width}x${height}x24`, '-ac', '-nolisten', 'tcp'],
+    {stdio: ['ignore', 'ignore', 'ignore', 'pipe']},
+  );
+  const stop = () => {
+    server.kill();
+  };
+  try {
+    const display = await readDisplay(server, timeoutMs);
+    const deadline = Date.now() + timeoutMs;
+    while (!(await connects(display))) {
+      if (server.exitCode !== null || Date.now() > deadline) {
+        throw new Error(`Xvfb on :${display} does not accept connections`);
+      }
+      await sleep(10);
+    }
+    return {display, stop};
+  } catch (error) {
+    stop();
+    throw error;
+  }
+}
+
+export interface StandInWindow {
+  pid: number;
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+// [window index, event code, eventX, eventY, receivedUs]
+export type ClientEvent = [number, number, number, number, number];
+
+// A message from the stand-ins; input they receive comes in batches of type 'events'
+export interface ClientMessage {
+  type: string;
+  events?: ClientEvent[];
+}
+
+// Processes for stand-in windows to belong to, since the addon finds windows by pid
+export function spawnOwners(count: number): ChildProcess[] {
+  return Array.from({length: count}, () => spawn('sleep', ['600'], {stdio: 'ignore'}));
+}
+
+// Maps windows on display without waiting; onMessage gets all the client sends
+export function forkStandIns<M extends {type: string}>(
+  display: number,
+  windows: StandInWindow[],
+  onMessage?: (message: M) => void,
+): ChildProcess {
+  const client = fork(CLIENT_PATH, [JSON.stringify({display, windows})], {stdio: 'ignore'});
+  if (onMessage) {
+    client.on('message', onMessage);
+  }
+  return client;
+}
+
+// As forkStandIns, resolving once every window is mapped
+export async function startStandIns<M extends {type: string}>(
+  display: number,
+  windows: StandInWindow[],
+  onMessage?: (message: M) => void,
+): Promise<ChildProcess> {
+  let ready = false;
+  const client = forkStandIns<M>(display, windows, message => {
+    ready ||= message.type === 'ready';
+    onMessage?.(message);
+  });
+  if (!(await waitFor(() => ready || client.exitCode !== null, 20_000)) || !ready) {
+    client.kill();
+    throw new Error(`The stand-in windows on :${display} did not come up`);
+  }
+  return client;
+}
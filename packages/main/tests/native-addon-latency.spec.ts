@@ -0,0 +1,202 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync, writeFileSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientMessage, XvfbServer} from './fixtures/xvfb';
+import {forkStandIns, hasCommand, sleep, spawnOwners, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Capture-to-delivery latency of synthetic input under Xvfb.
+ *
+ * Stand-in "Chrome" windows are created by lightweight X11 clients
+ * (fixtures/x11-test-client.cjs), each owned by a sleeping child process so
+ * the addon resolves them through its normal pid lookup. Every event is
+ * injected into all slaves the way the sync service does it, and the clients
+ * timestamp each delivery.
+ *
+ * Budgets can be tuned with LATENCY_BASE_BUDGET_MS and LATENCY_SLAVE_BUDGET_MS
+ * (p99 must stay under base + slave * N). LATENCY_SLAVE_COUNTS overrides the
+ * slave counts and LATENCY_REPORT writes the results to a JSON file.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const SLAVE_COUNTS = (process.env.LATENCY_SLAVE_COUNTS || '1,10,50,200').split(',').map(Number);
+const EVENTS = 200;
+const MAX_CLIENTS = 8;
+const EVENT_INTERVAL_MS = 2;
+const BASE_BUDGET_MS = Number(process.env.LATENCY_BASE_BUDGET_MS || 25);
+const SLAVE_BUDGET_MS = Number(process.env.LATENCY_SLAVE_BUDGET_MS || 1);
+
+const SCREEN_WIDTH = 3840;
+const SCREEN_HEIGHT = 2160;
+const GRID_COLUMNS = 20;
+const WINDOW_WIDTH = 160;
+const WINDOW_HEIGHT = 120;
+// Event k is sent to window offset (ORIGIN + k % 100, ORIGIN + k / 100)
+const ORIGIN = 10;
+
+const MOTION_NOTIFY = 6;
+
+interface LatencyResult {
+  slaves: number;
+  p50Ms: number;
+  p99Ms: number;
+  maxMs: number;
+  skewP50Ms: number;
+  skewMaxMs: number;
+  lost: number;
+}
+
+const nowUs = () => Number(process.hrtime.bigint() / 1000n);
+
+function percentile(sorted: number[], fraction: number): number {
+  if (sorted.length === 0) {
+    return NaN;
+  }
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * fraction))];
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('input injection latency under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let manager: {sendMouseEvent(pid: number, x: number, y: number, type: string): boolean};
+  const owners: ChildProcess[] = [];
+  const results: LatencyResult[] = [];
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(SCREEN_WIDTH, SCREEN_HEIGHT);
+    display = xvfb.display;
+
+    // The addon connects to DISPLAY the first time it needs X11
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(Math.max(...SLAVE_COUNTS)));
+  });
+
+  afterAll(() => {
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+    if (results.length > 0) {
+      console.table(results);
+      if (process.env.LATENCY_REPORT) {
+        writeFileSync(process.env.LATENCY_REPORT, JSON.stringify(results, null, 2));
+      }
+    }
+  });
+
+  test.each(SLAVE_COUNTS)(
+    'delivers to %i slaves within budget',
+    async slaves => {
+      const pids = owners.slice(0, slaves).map(owner => owner.pid as number);
+      const windows = pids.map((pid, i) => ({
+        pid,
+        x: (i % GRID_COLUMNS) * (SCREEN_WIDTH / GRID_COLUMNS),
+        y: Math.floor(i / GRID_COLUMNS) * (SCREEN_HEIGHT / 10),
+        width: WINDOW_WIDTH,
+        height: WINDOW_HEIGHT,
+      }));
+
+      // received[slave][k] = delivery time of event k in microseconds
+      const received = pids.map(() => new Array<number>(EVENTS).fill(-1));
+      const clientCount = Math.min(slaves, MAX_CLIENTS);
+      const perClient = Math.ceil(slaves / clientCount);
+      const clients: ChildProcess[] = [];
+      let ready = 0;
+      let errors = 0;
+
+      for (let c = 0; c < clientCount; c++) {
+        const first = c * perClient;
+        const shard = windows.slice(first, first + perClient);
+        const client = forkStandIns(display, shard, (message: ClientMessage) => {
+          if (message.type === 'ready') {
+            ready++;
+          } else if (message.type === 'error') {
+            errors++;
+          } else if (message.type === 'events' && message.events) {
+            for (const [index, code, eventX, eventY, receivedUs] of message.events) {
+              const k = (eventY - ORIGIN) * 100 + (eventX - ORIGIN);
+              if (code === MOTION_NOTIFY && k >= 0 && k < EVENTS) {
+                received[first + index][k] = receivedUs;
+              }
+            }
+          }
+        });
+        clients.push(client);
+      }
+
+      try {
+        expect(await waitFor(() => ready === clientCount, 10_000)).toBe(true);
+
+        // Let the addon's window lookups settle before measuring
+        for (const window of windows) {
+          manager.sendMouseEvent(window.pid, window.x + 1, window.y + 1, 'mousemove');
+        }
+        await sleep(200);
+
+        const sentUs = new Array<number>(EVENTS);
+        for (let k = 0; k < EVENTS; k++) {
+          sentUs[k] = nowUs();
+          for (const window of windows) {
+            const x = window.x + ORIGIN + (k % 100);
+            const y = window.y + ORIGIN + Math.floor(k / 100);
+            manager.sendMouseEvent(window.pid, x, y, 'mousemove');
+          }
+          await sleep(EVENT_INTERVAL_MS);
+        }
+
+        await waitFor(() => received.every(slave => slave.every(t => t >= 0)), 10_000);
+
+        const latencies: number[] = [];
+        const skews: number[] = [];
+        let lost = 0;
+        for (let k = 0; k < EVENTS; k++) {
+          let first = Infinity;
+          let last = -Infinity;
+          for (const slave of received) {
+            if (slave[k] < 0) {
+              lost++;
+              continue;
+            }
+            latencies.push((slave[k] - sentUs[k]) / 1000);
+            first = Math.min(first, slave[k]);
+            last = Math.max(last, slave[k]);
+          }
+          if (last >= first) {
+            skews.push((last - first) / 1000);
+          }
+        }
+        latencies.sort((a, b) => a - b);
+        skews.sort((a, b) => a - b);
+
+        const result: LatencyResult = {
+          slaves,
+          p50Ms: percentile(latencies, 0.5),
+          p99Ms: percentile(latencies, 0.99),
+          maxMs: latencies[latencies.length - 1],
+          skewP50Ms: percentile(skews, 0.5),
+          skewMaxMs: skews[skews.length - 1],
+          lost,
+        };
+        results.push(result);
+
+        expect(errors).toBe(0);
+        expect(lost).toBe(0);
+        expect(result.p99Ms).toBeLessThan(BASE_BUDGET_MS + SLAVE_BUDGET_MS * slaves);
+      } finally {
+        for (const client of clients) {
+          client.send({type: 'stop'});
+        }
+        await waitFor(() => clients.every(client => client.exitCode !== null), 5_000);
+      }
+    },
+    120_000,
+  );
+});
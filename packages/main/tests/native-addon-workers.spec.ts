@@ -0,0 +1,86 @@
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {Worker} from 'node:worker_threads';
+import {describe, expect, test} from 'vitest';
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+const WORKERS = 4;
+const ITERATIONS = 200;
+
+/**
+ * Each worker loads its own copy of the addon, creates and drops WindowManager
+ * instances and calls everything that goes through the shared native core.
+ */
+const WORKER_SOURCE = `
+const {parentPort, workerData} = require('node:worker_threads');
+const addon = require(workerData.addonPath);
+
+let maxEnvironments = 0;
+for (let i = 0; i < workerData.iterations; i++) {
+  const manager = new addon.WindowManager();
+  manager.getMonitors();
+  manager.getProcessTree(process.pid, i % 50 === 0);
+  manager.getAllWindows(process.pid);
+  manager.isProcessWindowActive(process.pid);
+  maxEnvironments = Math.max(maxEnvironments, manager.getCoreStats().environments);
+}
+parentPort.postMessage({maxEnvironments});
+`;
+
+function runWorker(): Promise<{maxEnvironments: number}> {
+  return new Promise((resolve, reject) => {
+    const worker = new Worker(WORKER_SOURCE, {
+      eval: true,
+      workerData: {addonPath: ADDON_PATH, iterations: ITERATIONS},
+    });
+    let result: {maxEnvironments: number} | undefined;
+    worker.on('message', message => (result = message));
+    worker.on('error', reject);
+    worker.on('exit', code => {
+      if (code === 0 && result) {
+        resolve(result);
+      } else {
+        reject(new Error(`Worker exited with code ${code}`));
+      }
+    });
+  });
+}
+
+describe.skipIf(!existsSync(ADDON_PATH))('window-addon in worker_threads', () => {
+  test('shares one native core across concurrent workers', async () => {
+    const addon = createRequire(__filename)(ADDON_PATH);
+    const manager = new addon.WindowManager();
+    const baseline = manager.getCoreStats().environments;
+
+    const results = await Promise.all(Array.from({length: WORKERS}, () => runWorker()));
+
+    // Every worker saw at least itself and this environment attached
+    for (const {maxEnvironments} of results) {
+      expect(maxEnvironments).toBeGreaterThanOrEqual(baseline + 1);
+    }
+
+    // Worker environments release their reference when they are torn down
+    for (let i = 0; i < 50 && manager.getCoreStats().environments !== baseline; i++) {
+      await new Promise(resolve => setTimeout(resolve, 20));
+    }
+    expect(manager.getCoreStats().environments).toBe(baseline);
+    expect(manager.getProcessTree(process.pid)).toContain(process.pid);
+  });
+
+  test('survives workers that are terminated mid-call', async () => {
+    const workers = Array.from(
+      {length: WORKERS},
+      () =>
+        new Worker(WORKER_SOURCE, {
+          eval: true,
+          workerData: {addonPath: ADDON_PATH, iterations: ITERATIONS * 10},
+        }),
+    );
+    await new Promise(resolve => setTimeout(resolve, 50));
+    await Promise.all(workers.map(worker => worker.terminate()));
+
+    const result = await runWorker();
+    expect(result.maxEnvironments).toBeGreaterThanOrEqual(1);
+  });
+});
@@ -0,0 +1,152 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Incremental arrangeWindows under Xvfb, with no window manager, against
+ * fixtures/x11-test-client.cjs windows: only windows out of place are moved
+ * and raised, and the counts say how many were moved, skipped and missing.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const SMALL = 4;
+const LARGE = 150;
+
+interface ArrangeCounts {
+  moved: number;
+  skipped: number;
+  missing: number;
+}
+
+interface ArrangingManager {
+  arrangeWindows(
+    mainPid: number,
+    childPids: number[],
+    columns: number,
+    size: {width: number; height: number},
+    spacing: number,
+    monitorIndex?: number,
+    options?: {force?: boolean},
+  ): ArrangeCounts;
+}
+
+interface Layout {
+  bounds: [number, number, number, number][];
+  stack: number[];
+}
+
+// Cells of a 2 x 2 grid with spacing 10 on the 1280 x 720 screen, see
+// ComputeArrangeGrid: the main window is inset on every side
+const GRID = [
+  [10, 10, 605, 325],
+  [645, 10, 615, 335],
+  [10, 365, 615, 335],
+  [645, 365, 615, 335],
+];
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('arrangeWindows under Xvfb', () => {
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: ArrangingManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  let absentPid = 0;
+  const layouts: Layout[] = [];
+
+  // Windows of the small group, bounds and stacking as the X server has them
+  async function smallLayout(): Promise<Layout> {
+    const count = layouts.length;
+    client.send({type: 'layout'});
+    expect(await waitFor(() => layouts.length > count, 5_000)).toBe(true);
+    const {bounds, stack} = layouts[count];
+    return {bounds: bounds.slice(0, SMALL), stack: stack.filter(index => index < SMALL)};
+  }
+
+  // The addon's requests reach the server on its own connection
+  async function settledLayout(expected: (layout: Layout) => boolean): Promise<Layout> {
+    let layout = await smallLayout();
+    for (let i = 0; i < 20 && !expected(layout); i++) {
+      layout = await smallLayout();
+    }
+    return layout;
+  }
+
+  const inGrid = (layout: Layout) => GRID.every((cell, i) => layout.bounds[i].every((v, j) => v === cell[j]));
+  const arrangeSmall = (options?: {force?: boolean}) =>
+    manager.arrangeWindows(pids[0], [...pids.slice(1, SMALL), absentPid], 2, {width: 0, height: 0}, 10, 0, options);
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1280, 720);
+    const display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(SMALL + LARGE + 1));
+    pids = owners.slice(0, SMALL + LARGE).map(owner => owner.pid as number);
+    absentPid = owners[SMALL + LARGE].pid as number;
+    const windows = pids.map((pid, i) => ({pid, x: 0, y: 0, width: 200 + i, height: 150}));
+
+    client = await startStandIns(display, windows, (message: {type: string} & Layout) => {
+      if (message.type === 'layout') {
+        layouts.push({bounds: message.bounds, stack: message.stack});
+      }
+    });
+  }, 30_000);
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('moves and stacks every window out of place, then leaves them be', async () => {
+    expect(arrangeSmall()).toEqual(expect.objectContaining({moved: SMALL, skipped: 0, missing: 1}));
+    const arranged = await settledLayout(inGrid);
+    expect(inGrid(arranged)).toBe(true);
+    // The first profile on top
+    expect(arranged.stack).toEqual([3, 2, 1, 0]);
+
+    expect(arrangeSmall()).toEqual(expect.objectContaining({moved: 0, skipped: SMALL, missing: 1}));
+    expect(await smallLayout()).toEqual(arranged);
+  });
+
+  test('moves and raises only the window that left its cell', async () => {
+    arrangeSmall();
+    await settledLayout(inGrid);
+
+    client.send({type: 'move', index: 2, x: 300, y: 200});
+    await settledLayout(layout => layout.bounds[2][0] === 300);
+
+    expect(arrangeSmall()).toEqual(expect.objectContaining({moved: 1, skipped: SMALL - 1, missing: 1}));
+    const layout = await settledLayout(inGrid);
+    expect(inGrid(layout)).toBe(true);
+    // The others keep their order below it
+    expect(layout.stack).toEqual([3, 1, 0, 2]);
+
+    expect(arrangeSmall({force: true})).toEqual(expect.objectContaining({moved: SMALL, skipped: 0}));
+    expect((await settledLayout(next => next.stack.at(-1) === 0)).stack).toEqual([3, 2, 1, 0]);
+  });
+
+  test('re-arranges 150 windows that are in place without touching them', () => {
+    const arrange = () => manager.arrangeWindows(pids[SMALL], pids.slice(SMALL + 1), 15, {width: 0, height: 0}, 4);
+    expect(arrange()).toEqual(expect.objectContaining({moved: LARGE, skipped: 0, missing: 0}));
+
+    const start = process.hrtime.bigint();
+    const again = arrange();
+    const elapsedMs = Number(process.hrtime.bigint() - start) / 1e6;
+    expect(again).toEqual(expect.objectContaining({moved: 0, skipped: LARGE, missing: 0}));
+    // One enumeration for the whole plan, no requests per window
+    expect(elapsedMs).toBeLessThan(250);
+  });
+});
@@ -0,0 +1,138 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientMessage, XvfbServer} from './fixtures/xvfb';
+import {forkStandIns, hasCommand, spawnOwners, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * bulkWindowOp on a few hundred stand-in windows under Xvfb (no window
+ * manager), created by fixtures/x11-test-client.cjs. Every call must cover all
+ * profiles within BULK_OP_BUDGET_MS.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const PROFILES = 300;
+const CLIENTS = 4;
+const COLUMNS = 30;
+const BUDGET_MS = Number(process.env.BULK_OP_BUDGET_MS || 250);
+
+const CLIENT_MESSAGE = 33;
+
+interface BulkResult {
+  pid: number;
+  windows: number;
+}
+
+interface BulkManager {
+  bulkWindowOp(pids: number[], op: string, options?: {value?: boolean}): BulkResult[];
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('bulk window operations under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let manager: BulkManager;
+  const owners: ChildProcess[] = [];
+  const clients: ChildProcess[] = [];
+  let pids: number[] = [];
+  // Per profile, the first data word of each ClientMessage it received
+  const messages: number[][] = [];
+
+  function timed(op: string, options?: {value?: boolean}) {
+    const started = process.hrtime.bigint();
+    const results = manager.bulkWindowOp(pids, op, options);
+    const elapsedMs = Number(process.hrtime.bigint() - started) / 1e6;
+    return {results, elapsedMs};
+  }
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(3840, 2160);
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(PROFILES));
+    messages.push(...owners.map(() => []));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.map((pid, i) => ({
+      pid,
+      x: (i % COLUMNS) * 128,
+      y: Math.floor(i / COLUMNS) * 200,
+      width: 100,
+      height: 60,
+    }));
+
+    const perClient = PROFILES / CLIENTS;
+    let ready = 0;
+    for (let c = 0; c < CLIENTS; c++) {
+      const first = c * perClient;
+      const shard = windows.slice(first, first + perClient);
+      const client = forkStandIns(display, shard, (message: ClientMessage) => {
+        if (message.type === 'ready') {
+          ready++;
+        } else if (message.type === 'events' && message.events) {
+          for (const [index, code, data] of message.events) {
+            if (code === CLIENT_MESSAGE) {
+              messages[first + index].push(data);
+            }
+          }
+        }
+      });
+      clients.push(client);
+    }
+    expect(await waitFor(() => ready === CLIENTS, 10_000)).toBe(true);
+  });
+
+  afterAll(() => {
+    for (const client of clients) {
+      client.send({type: 'stop'});
+    }
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('rejects unknown operations', () => {
+    expect(() => manager.bulkWindowOp(pids, 'maximise')).toThrow(TypeError);
+  });
+
+  test('hides and shows every profile in one call each', () => {
+    const hidden = timed('hide');
+    expect(hidden.results.map(result => result.pid)).toEqual(pids);
+    expect(hidden.results.every(result => result.windows === 1)).toBe(true);
+    expect(hidden.elapsedMs).toBeLessThan(BUDGET_MS);
+
+    // Unmapped windows are no longer found by visible-window operations
+    expect(manager.bulkWindowOp(pids, 'bringToFront').every(result => result.windows === 0)).toBe(true);
+
+    const shown = timed('show');
+    expect(shown.results.every(result => result.windows === 1)).toBe(true);
+    expect(shown.elapsedMs).toBeLessThan(BUDGET_MS);
+    expect(manager.bulkWindowOp(pids, 'bringToFront').every(result => result.windows === 1)).toBe(true);
+  });
+
+  test('reports profiles without windows', () => {
+    const results = manager.bulkWindowOp([pids[0], 999_999], 'setAlwaysOnTop', {value: false});
+    expect(results).toEqual([
+      {pid: pids[0], windows: 1},
+      {pid: 999_999, windows: 0},
+    ]);
+  });
+
+  test('asks every window to close', async () => {
+    const closed = timed('close');
+    expect(closed.results.every(result => result.windows === 1)).toBe(true);
+    expect(closed.elapsedMs).toBeLessThan(BUDGET_MS);
+
+    // WM_PROTOCOLS carrying WM_DELETE_WINDOW, exactly once per window
+    expect(await waitFor(() => messages.every(received => received.length === 1), 5_000)).toBe(true);
+    expect(new Set(messages.map(received => received[0])).size).toBe(1);
+  });
+});
@@ -0,0 +1,151 @@
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterEach, describe, expect, test} from 'vitest';
+import {sleep, waitFor} from './fixtures/xvfb';
+
+/**
+ * Native CDP scroll sync against local WebSocket stand-ins for the master and
+ * slave pages (fixtures/cdp-stand-in.cjs), so no browser is needed.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface CdpCommand {
+  id: number;
+  method: string;
+  params: {expression?: string; [key: string]: unknown};
+}
+
+interface CdpStandIn {
+  url: string;
+  commands: CdpCommand[];
+  readonly connections: number;
+  emit(method: string, params: unknown): void;
+  disconnect(): void;
+  close(): Promise<void>;
+}
+
+interface CdpSyncManager {
+  startCdpSync(masterUrl: string, slaveUrls: string[]): boolean;
+  cdpScrollTo(x: number, y: number): boolean;
+  cdpDispatchWheel(x: number, y: number, deltaX: number, deltaY: number): boolean;
+  stopCdpSync(): void;
+  getCdpSyncStats(): Record<string, number | boolean>;
+}
+
+const localRequire = createRequire(__filename);
+const {startCdpStandIn} = localRequire('./fixtures/cdp-stand-in.cjs') as {
+  startCdpStandIn(options?: {failMethods?: string[]}): Promise<CdpStandIn>;
+};
+
+function scrollTargets(standIn: CdpStandIn): string[] {
+  return standIn.commands
+    .filter(command => command.method === 'Runtime.evaluate')
+    .map(command => command.params.expression as string);
+}
+
+function reportScroll(master: CdpStandIn, x: number, y: number) {
+  master.emit('Runtime.bindingCalled', {name: '__cpScroll', payload: `${x},${y}`, executionContextId: 1});
+}
+
+const enabled = existsSync(ADDON_PATH);
+
+describe.skipIf(!enabled)('native CDP scroll sync', () => {
+  const SLAVES = 5;
+  let manager: CdpSyncManager;
+  let standIns: CdpStandIn[] = [];
+
+  async function start(options: {failMethods?: string[]} = {}) {
+    const addon = localRequire(ADDON_PATH);
+    manager = new addon.WindowManager();
+    const master = await startCdpStandIn();
+    const slaves: CdpStandIn[] = [];
+    for (let i = 0; i < SLAVES; i++) {
+      slaves.push(await startCdpStandIn(options));
+    }
+    standIns = [master, ...slaves];
+
+    expect(manager.startCdpSync(master.url, slaves.map(slave => slave.url))).toBe(true);
+    expect(await waitFor(() => manager.getCdpSyncStats().connected === SLAVES + 1, 5_000)).toBe(true);
+    // The scroll binding is installed once the master connection opens
+    expect(await waitFor(() => master.commands.some(c => c.method === 'Runtime.addBinding'), 5_000)).toBe(true);
+    return {master, slaves};
+  }
+
+  afterEach(async () => {
+    manager?.stopCdpSync();
+    for (const standIn of standIns) {
+      await standIn.close();
+    }
+    standIns = [];
+  });
+
+  test('subscribes to master scroll changes instead of polling', async () => {
+    const {master} = await start();
+    const binding = master.commands.find(c => c.method === 'Runtime.addBinding');
+    expect(binding?.params).toEqual({name: '__cpScroll'});
+    expect(master.commands.some(c => c.method === 'Page.addScriptToEvaluateOnNewDocument')).toBe(true);
+
+    // Nothing further is sent to the master while it is idle
+    const sent = master.commands.length;
+    await sleep(300);
+    expect(master.commands.length).toBe(sent);
+  });
+
+  test('fans the latest master position out to every slave', async () => {
+    const {master, slaves} = await start();
+
+    for (let y = 0; y <= 500; y += 50) {
+      reportScroll(master, 0, y);
+    }
+    expect(
+      await waitFor(() => slaves.every(slave => scrollTargets(slave).includes('window.scrollTo(0,500)')), 5_000),
+    ).toBe(true);
+
+    // Bursts are coalesced, never reordered
+    for (const slave of slaves) {
+      const positions = scrollTargets(slave).map(expression => Number(/,(\d+)\)/.exec(expression)?.[1]));
+      expect(positions).toEqual([...positions].sort((a, b) => a - b));
+      expect(positions.length).toBeLessThanOrEqual(11);
+    }
+
+    // A repeated position is not sent again
+    const before = slaves.map(slave => slave.commands.length);
+    reportScroll(master, 0, 500);
+    await sleep(200);
+    expect(slaves.map(slave => slave.commands.length)).toEqual(before);
+    expect(manager.getCdpSyncStats().scrollEvents).toBe(12);
+  });
+
+  test('dispatches commands from JS and counts failed replies', async () => {
+    const {slaves} = await start({failMethods: ['Input.dispatchMouseEvent']});
+
+    expect(manager.cdpScrollTo(10, 20)).toBe(true);
+    expect(manager.cdpDispatchWheel(100, 200, 0, 120)).toBe(true);
+    expect(
+      await waitFor(() => slaves.every(slave => slave.commands.some(c => c.method === 'Input.dispatchMouseEvent')), 5_000),
+    ).toBe(true);
+
+    for (const slave of slaves) {
+      expect(scrollTargets(slave)).toEqual(['window.scrollTo(10,20)']);
+      const wheel = slave.commands.find(c => c.method === 'Input.dispatchMouseEvent');
+      expect(wheel?.params).toEqual({type: 'mouseWheel', x: 100, y: 200, deltaX: 0, deltaY: 120});
+    }
+    expect(await waitFor(() => manager.getCdpSyncStats().commandErrors === SLAVES, 5_000)).toBe(true);
+  });
+
+  test('reconnects a dropped slave and restores its position', async () => {
+    const {master, slaves} = await start();
+
+    reportScroll(master, 0, 300);
+    expect(await waitFor(() => scrollTargets(slaves[0]).includes('window.scrollTo(0,300)'), 5_000)).toBe(true);
+
+    slaves[0].disconnect();
+    expect(await waitFor(() => slaves[0].connections === 2, 5_000)).toBe(true);
+    expect(
+      await waitFor(() => scrollTargets(slaves[0]).filter(e => e === 'window.scrollTo(0,300)').length === 2, 5_000),
+    ).toBe(true);
+    expect(manager.getCdpSyncStats().reconnects).toBe(1);
+  });
+});
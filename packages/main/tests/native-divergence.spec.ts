@@ -0,0 +1,162 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, afterEach, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, sleep, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Divergence detection under Xvfb: a master and 100 slaves made of
+ * fixtures/x11-test-client.cjs windows, one of which is striped to drift
+ * from the rest. The hashing itself is covered by image-ops-test.cpp.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+// Master and 99 slaves with windows, plus one slave without
+const WINDOW_COUNT = 100;
+const COLUMNS = 8;
+const ROWS = 6;
+
+interface DivergenceReport {
+  pid: number;
+  score: number;
+  diverged: boolean;
+  missing: boolean;
+  cells: number[];
+}
+
+interface DetectingManager {
+  startDivergenceDetection(
+    masterPid: number,
+    slavePids: number[],
+    options: {columns?: number; rows?: number; intervalMs?: number; cellThreshold?: number; scoreThreshold?: number},
+    callback: (reports: DivergenceReport[]) => void,
+  ): boolean;
+  stopDivergenceDetection(): void;
+  getDivergence(): DivergenceReport[];
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('divergence detection under Xvfb', () => {
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: DetectingManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  const drawn: number[] = [];
+
+  // Paint window index with stripes (0 for plain white) and wait until it is on screen
+  async function paint(index: number, width: number) {
+    const count = drawn.filter(i => i === index).length;
+    client.send({type: 'stripes', index, width});
+    expect(await waitFor(() => drawn.filter(i => i === index).length > count, 5_000)).toBe(true);
+  }
+
+  function start(callback: (reports: DivergenceReport[]) => void = () => {}) {
+    manager.startDivergenceDetection(pids[0], pids.slice(1), {columns: COLUMNS, rows: ROWS, intervalMs: 50}, callback);
+  }
+
+  const settled = () => manager.getDivergence().every((report, i) => report.missing === (i === WINDOW_COUNT - 1));
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1920, 1080);
+    const display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(WINDOW_COUNT + 1));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.slice(0, WINDOW_COUNT).map((pid, i) => ({
+      pid,
+      x: (i % 10) * 80,
+      y: Math.floor(i / 10) * 40,
+      width: 1024,
+      height: 640,
+    }));
+
+    client = await startStandIns(display, windows, (message: {type: string; index?: number}) => {
+      if (message.type === 'drawn') {
+        drawn.push(message.index as number);
+      }
+    });
+  }, 30_000);
+
+  afterEach(() => {
+    manager?.stopDivergenceDetection();
+  });
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('reports a slave that drifts and again when it recovers', async () => {
+    const calls: DivergenceReport[][] = [];
+    start(reports => calls.push(reports));
+    expect(await waitFor(settled, 10_000)).toBe(true);
+
+    // Identical windows raise nothing
+    await sleep(200);
+    expect(calls).toEqual([]);
+    const initial = manager.getDivergence();
+    expect(initial).toHaveLength(WINDOW_COUNT);
+    expect(initial.map(report => report.pid)).toEqual(pids.slice(1));
+    expect(initial.slice(0, -1).every(report => report.score === 0 && !report.diverged)).toBe(true);
+    expect(initial.at(-1)).toMatchObject({missing: true, diverged: false});
+
+    const slave = 5;
+    const diverged = (reports: DivergenceReport[] | undefined) => reports?.[slave - 1].diverged === true;
+    await paint(slave, 28);
+    expect(await waitFor(() => diverged(calls.at(-1)), 5_000)).toBe(true);
+    const report = calls.at(-1)![slave - 1];
+    expect(report.pid).toBe(pids[slave]);
+    expect(report.score).toBeGreaterThanOrEqual(0.08);
+    // The stripes cover every cell
+    expect(report.cells).toEqual(Array.from({length: COLUMNS * ROWS}, (_, cell) => cell));
+    expect(calls.at(-1)!.filter(other => other.diverged)).toHaveLength(1);
+
+    // Back to white: one report of the recovery, then quiet again
+    await paint(slave, 0);
+    expect(await waitFor(() => calls.at(-1)?.[slave - 1].diverged === false, 5_000)).toBe(true);
+    const count = calls.length;
+    await sleep(300);
+    expect(calls).toHaveLength(count);
+    expect(manager.getDivergence()[slave - 1]).toMatchObject({score: 0, diverged: false, cells: []});
+  });
+
+  test('compares every slave against a changed master', async () => {
+    start();
+    expect(await waitFor(settled, 10_000)).toBe(true);
+
+    await paint(0, 28);
+    try {
+      const drifted = () => manager.getDivergence().slice(0, -1).every(report => report.diverged);
+      expect(await waitFor(drifted, 5_000)).toBe(true);
+    } finally {
+      await paint(0, 0);
+    }
+  });
+
+  // Left running for the whole of a sync session: with nothing redrawn, a
+  // cycle over 100 windows only collects damage
+  test('costs little while the windows stay the same', async () => {
+    start();
+    expect(await waitFor(settled, 10_000)).toBe(true);
+    await sleep(200);
+
+    const cpuBefore = process.cpuUsage();
+    const wallBefore = process.hrtime.bigint();
+    await sleep(2_000);
+    const cpu = process.cpuUsage(cpuBefore);
+    const wallUs = Number(process.hrtime.bigint() - wallBefore) / 1000;
+    expect((cpu.user + cpu.system) / wallUs).toBeLessThan(0.1);
+  });
+});
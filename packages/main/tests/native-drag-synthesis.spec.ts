@@ -0,0 +1,214 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientEvent, ClientMessage, StandInWindow, XvfbServer} from './fixtures/xvfb';
+import {hasCommand, sleep, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Native drag synthesis under Xvfb. The test moves the real pointer across
+ * the master window in coarse jumps while the button is "held", and the
+ * slave, twice the master's size, has to see an even, gap-free stream of
+ * moves between press and release. Windows are stand-ins created by
+ * fixtures/x11-test-client.cjs.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const MASTER_WIDTH = 200;
+const MASTER_HEIGHT = 100;
+const SCALE = 2;
+
+const BUTTON_PRESS = 4;
+const BUTTON_RELEASE = 5;
+const MOTION_NOTIFY = 6;
+
+interface DragStats {
+  active: boolean;
+  drags: number;
+  dropped: number;
+  timedOut: number;
+  samples: number;
+  ticks: number;
+  moves: number;
+  injected: number;
+  missed: number;
+  avgJitterUs: number;
+  maxJitterUs: number;
+}
+
+interface DragManager {
+  startDrag(
+    masterPid: number,
+    slavePids: number[],
+    x: number,
+    y: number,
+    options?: {
+      button?: 'left' | 'right';
+      rateHz?: number;
+      sampleHz?: number;
+      delayUs?: number;
+      pressed?: boolean;
+      maxDurationMs?: number;
+    },
+  ): boolean;
+  endDrag(x: number, y: number): boolean;
+  getDragStats(): DragStats;
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('drag synthesis under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: DragManager;
+  const owners: ChildProcess[] = [];
+  // [master, slave]
+  const windows: StandInWindow[] = [];
+  const events: ClientEvent[] = [];
+
+  const received = (index: number, code: number) => events.filter(event => event[0] === index && event[1] === code);
+
+  beforeAll(async () => {
+    xvfb = await startXvfb();
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    const scales = [1, SCALE];
+    owners.push(...spawnOwners(scales.length));
+    for (const [i, scale] of scales.entries()) {
+      windows.push({
+        pid: owners[i].pid as number,
+        x: i * 450,
+        y: 0,
+        width: MASTER_WIDTH * scale,
+        height: MASTER_HEIGHT * scale,
+      });
+    }
+
+    client = await startStandIns(display, windows, (message: ClientMessage) => {
+      if (message.type === 'events' && message.events) {
+        events.push(...message.events);
+      }
+    });
+  });
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('fills coarse pointer jumps with an even stream of moves', async () => {
+    const [master, slave] = windows;
+    const y = master.y + 50;
+    client.send({type: 'warp', x: master.x + 20, y});
+    await sleep(50);
+
+    // Warps are instant, so the pointer is sampled about once per warp and
+    // every jump has to be spread over the moves in between
+    expect(manager.startDrag(master.pid, [slave.pid], master.x + 20, y, {rateHz: 250, sampleHz: 40})).toBe(true);
+    // Jumps of 20px every 25ms, much coarser than the moves expected
+    for (let x = 40; x <= 180; x += 20) {
+      await sleep(25);
+      client.send({type: 'warp', x: master.x + x, y});
+    }
+    await sleep(25);
+    expect(manager.endDrag(master.x + 180, y)).toBe(true);
+    expect(await waitFor(() => received(1, BUTTON_RELEASE).length === 1, 5_000)).toBe(true);
+
+    const presses = received(1, BUTTON_PRESS);
+    expect(presses).toHaveLength(1);
+    expect(presses[0].slice(2, 4)).toEqual([20 * SCALE, 50 * SCALE]);
+    expect(received(1, BUTTON_RELEASE)[0].slice(2, 4)).toEqual([180 * SCALE, 50 * SCALE]);
+
+    // Moves between press and release, in the order the slave got them
+    const pressed = events.indexOf(presses[0]);
+    const moves = events.filter((event, i) => i > pressed && event[0] === 1 && event[1] === MOTION_NOTIFY);
+    // About 60 ticks over the drag, most of them moves
+    expect(moves.length).toBeGreaterThanOrEqual(20);
+    let previous = 20 * SCALE;
+    for (const move of moves) {
+      expect(move[2]).toBeGreaterThanOrEqual(previous);
+      // Well under one jump of 20 * SCALE
+      expect(move[2] - previous).toBeLessThanOrEqual(20);
+      expect(move[3]).toBe(50 * SCALE);
+      previous = move[2];
+    }
+    expect(previous).toBe(180 * SCALE);
+
+    const stats = manager.getDragStats();
+    expect(stats).toMatchObject({active: false, drags: 1, missed: 0});
+    expect(stats.samples).toBeGreaterThan(0);
+    expect(stats.moves).toBe(moves.length);
+    expect(manager.endDrag(master.x + 180, y)).toBe(false);
+  });
+
+  // Windows are looked up on the drag thread, so startDrag only learns of a
+  // missing master afterwards
+  test('drops a drag for a master without a window', async () => {
+    const before = events.length;
+    expect(manager.startDrag(999_999, [windows[1].pid], 10, 10)).toBe(true);
+    expect(await waitFor(() => manager.getDragStats().dropped === 1, 5_000)).toBe(true);
+    expect(manager.getDragStats()).toMatchObject({active: false, drags: 1});
+    expect(manager.endDrag(10, 10)).toBe(false);
+    await sleep(50);
+    expect(events.slice(before).filter(event => event[0] === 1 && event[1] === BUTTON_PRESS)).toEqual([]);
+  });
+
+  test('replays a drag whose press the caller forwarded', async () => {
+    const [master, slave] = windows;
+    const y = master.y + 50;
+    const before = events.length;
+    client.send({type: 'warp', x: master.x + 100, y});
+    await sleep(50);
+
+    expect(manager.startDrag(master.pid, [slave.pid], master.x + 60, y, {pressed: true})).toBe(true);
+    await sleep(50);
+    expect(manager.endDrag(master.x + 100, y)).toBe(true);
+    const since = () => events.slice(before).filter(event => event[0] === 1);
+    expect(await waitFor(() => since().some(event => event[1] === BUTTON_RELEASE), 5_000)).toBe(true);
+
+    expect(since().filter(event => event[1] === BUTTON_PRESS)).toEqual([]);
+    const moves = since().filter(event => event[1] === MOTION_NOTIFY);
+    expect(moves.length).toBeGreaterThan(0);
+    expect(moves.at(-1)!.slice(2, 4)).toEqual([100 * SCALE, 50 * SCALE]);
+  });
+
+  // A click: endDrag before the drag thread has even pressed
+  test('presses and releases when the drag ends straight away', async () => {
+    const [master, slave] = windows;
+    const before = events.length;
+    const since = (code: number) => events.slice(before).filter(event => event[0] === 1 && event[1] === code);
+
+    expect(manager.startDrag(master.pid, [slave.pid], master.x + 30, master.y + 40)).toBe(true);
+    expect(manager.endDrag(master.x + 30, master.y + 40)).toBe(true);
+    expect(await waitFor(() => since(BUTTON_RELEASE).length === 1, 5_000)).toBe(true);
+    expect(since(BUTTON_PRESS).map(event => event.slice(2, 4))).toEqual([[30 * SCALE, 40 * SCALE]]);
+    expect(events.indexOf(since(BUTTON_PRESS)[0])).toBeLessThan(events.indexOf(since(BUTTON_RELEASE)[0]));
+  });
+
+  test('releases a drag whose mouseup never comes', async () => {
+    const [master, slave] = windows;
+    const before = events.length;
+    const {drags, timedOut} = manager.getDragStats();
+
+    expect(manager.startDrag(master.pid, [slave.pid], master.x + 30, master.y + 40, {maxDurationMs: 200})).toBe(true);
+    const released = () => events.slice(before).some(event => event[0] === 1 && event[1] === BUTTON_RELEASE);
+    expect(await waitFor(released, 5_000)).toBe(true);
+    expect(manager.getDragStats()).toMatchObject({active: false, timedOut: timedOut + 1});
+    expect(manager.endDrag(master.x + 30, master.y + 40)).toBe(false);
+    // The next drag starts as usual
+    expect(manager.startDrag(master.pid, [slave.pid], master.x + 30, master.y + 40)).toBe(true);
+    expect(manager.endDrag(master.x + 30, master.y + 40)).toBe(true);
+    const finished = () => manager.getDragStats().drags === drags + 2 && !manager.getDragStats().active;
+    expect(await waitFor(finished, 5_000)).toBe(true);
+  });
+});
@@ -0,0 +1,115 @@
+import type {ChildProcess} from 'node:child_process';
+import {spawnSync} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientEvent, ClientMessage, XvfbServer} from './fixtures/xvfb';
+import {hasCommand, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * The input paths must not touch the heap once their window lookups are
+ * cached. Runs fixtures/event-allocations.cjs under Xvfb in a node process
+ * with alloc-counter.so preloaded, against stand-in windows created by
+ * fixtures/x11-test-client.cjs.
+ */
+
+const NATIVE_DIR = join(__dirname, '../src/native-addon/build/Release');
+const ADDON_PATH = join(NATIVE_DIR, 'window-addon.node');
+const COUNTER_PATH = join(NATIVE_DIR, 'alloc-counter.so');
+const PROBE_PATH = join(__dirname, 'fixtures/event-allocations.cjs');
+
+const PROFILES = 8;
+// Matches kEventWindowTtl in window-control.h
+const EVENT_WINDOW_TTL_MS = 250;
+const WARMUP = 20;
+const ITERATIONS = 20;
+// X keycode of 'a' under the default keymap
+const KEY_CODE = 38;
+
+const KEY_PRESS = 2;
+const KEY_RELEASE = 3;
+
+interface ProbeResult {
+  baseline: number;
+  events: number;
+  sent: number;
+  keys: number;
+  strayKey: boolean;
+  elapsedMs: number;
+  error?: string;
+}
+
+const enabled =
+  process.platform === 'linux' && existsSync(ADDON_PATH) && existsSync(COUNTER_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('event injection allocations under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  const events: ClientEvent[] = [];
+
+  const received = (index: number, code: number) => events.filter(event => event[0] === index && event[1] === code);
+
+  function probe(iterations: number): ProbeResult {
+    const args = {
+      addonPath: ADDON_PATH,
+      pids,
+      x: 50,
+      y: 30,
+      keyCode: KEY_CODE,
+      warmup: WARMUP,
+      iterations,
+      ttlMs: EVENT_WINDOW_TTL_MS,
+    };
+    const result = spawnSync(process.execPath, [PROBE_PATH, JSON.stringify(args)], {
+      env: {...process.env, DISPLAY: `:${display}`, LD_PRELOAD: COUNTER_PATH},
+      encoding: 'utf8',
+      timeout: 30_000,
+    });
+    return JSON.parse(result.stdout.trim().split('\n').pop() as string);
+  }
+
+  beforeAll(async () => {
+    xvfb = await startXvfb();
+    display = xvfb.display;
+
+    owners.push(...spawnOwners(PROFILES));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.map((pid, i) => ({pid, x: i * 200, y: 0, width: 180, height: 120}));
+
+    client = await startStandIns(display, windows, (message: ClientMessage) => {
+      if (message.type === 'events' && message.events) {
+        events.push(...message.events);
+      }
+    });
+  });
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('mouse, wheel and keyboard events make no heap allocations in steady state', async () => {
+    const result = probe(ITERATIONS);
+    expect(result.error).toBeUndefined();
+
+    // Every event found its window
+    expect(result.sent).toBe(ITERATIONS * PROFILES * 4);
+    expect(result.keys).toBe(ITERATIONS * PROFILES * 2);
+    expect(result.strayKey).toBe(false);
+    // and the key events reached every window, one of each per round
+    const rounds = WARMUP + 1 + ITERATIONS;
+    const delivered = () =>
+      pids.every((_, i) => received(i, KEY_PRESS).length === rounds && received(i, KEY_RELEASE).length === rounds);
+    expect(await waitFor(delivered, 5_000)).toBe(true);
+    // All rounds ran on one generation of cached lookups
+    expect(result.elapsedMs).toBeLessThan(EVENT_WINDOW_TTL_MS);
+    // Anything beyond what reading the counter costs came from the addon
+    expect(result.events - result.baseline).toBeLessThanOrEqual(0);
+  });
+});
@@ -0,0 +1,95 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Foreground tracking under Xvfb. fixtures/x11-test-client.cjs plays the
+ * window manager's part by setting _NET_ACTIVE_WINDOW on the root window.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface FocusChange {
+  pid: number;
+  previousPid: number;
+}
+
+interface FocusManager {
+  isProcessWindowActive(pid: number): boolean;
+  onFocusChange(callback: ((change: FocusChange) => void) | null): boolean;
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('foreground tracking under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: FocusManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  const changes: FocusChange[] = [];
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1280, 720);
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(2));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.map((pid, i) => ({pid, x: i * 400, y: 0, width: 300, height: 200}));
+
+    client = await startStandIns(display, windows);
+  });
+
+  afterAll(() => {
+    manager?.onFocusChange(null);
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('follows _NET_ACTIVE_WINDOW and reports each change', async () => {
+    expect(manager.onFocusChange(change => changes.push(change))).toBe(true);
+    expect(manager.isProcessWindowActive(pids[0])).toBe(false);
+
+    client.send({type: 'activate', index: 0});
+    expect(await waitFor(() => manager.isProcessWindowActive(pids[0]), 2_000)).toBe(true);
+    expect(manager.isProcessWindowActive(pids[1])).toBe(false);
+
+    client.send({type: 'activate', index: 1});
+    expect(await waitFor(() => manager.isProcessWindowActive(pids[1]), 2_000)).toBe(true);
+    expect(manager.isProcessWindowActive(pids[0])).toBe(false);
+
+    client.send({type: 'activate', index: -1});
+    expect(await waitFor(() => !manager.isProcessWindowActive(pids[1]), 2_000)).toBe(true);
+
+    expect(await waitFor(() => changes.length === 3, 2_000)).toBe(true);
+    expect(changes).toEqual([
+      {pid: pids[0], previousPid: 0},
+      {pid: pids[1], previousPid: pids[0]},
+      {pid: 0, previousPid: pids[1]},
+    ]);
+  });
+
+  test('answers repeated checks without a window-system round trip', () => {
+    client.send({type: 'activate', index: 0});
+    const iterations = 100_000;
+    const started = process.hrtime.bigint();
+    for (let i = 0; i < iterations; i++) {
+      manager.isProcessWindowActive(pids[0]);
+    }
+    const perCallUs = Number(process.hrtime.bigint() - started) / 1e3 / iterations;
+    // An X11 round trip alone costs tens of microseconds
+    expect(perCallUs).toBeLessThan(5);
+  });
+});
@@ -0,0 +1,181 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * saveLayout and restoreLayout under Xvfb, with no window manager, against
+ * fixtures/x11-test-client.cjs windows: a saved layout brings back the
+ * bounds and stacking of every window it has. The encoding and monitor
+ * matching are covered by layout-snapshot-test.cpp.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const PROFILES = ['default', 'Profile 1', 'Profile 2', 'Profile 3'];
+const BOUNDS = [
+  [40, 30, 500, 300],
+  [600, 50, 400, 350],
+  [100, 380, 620, 300],
+  [760, 420, 480, 260],
+];
+
+interface RestoreCounts {
+  moved: number;
+  skipped: number;
+  missing: number;
+  pending: string[];
+}
+
+interface LayoutManager {
+  saveLayout(profiles: Record<number, string>): Buffer;
+  restoreLayout(layout: Uint8Array, pids: Record<string, number>, options?: {force?: boolean}): RestoreCounts;
+  arrangeWindows(
+    mainPid: number,
+    childPids: number[],
+    columns: number,
+    size: {width: number; height: number},
+    spacing: number,
+    monitorIndex?: number,
+  ): unknown;
+}
+
+interface Layout {
+  bounds: [number, number, number, number][];
+  stack: number[];
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('saveLayout and restoreLayout under Xvfb', () => {
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: LayoutManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  let absentPid = 0;
+  const layouts: Layout[] = [];
+
+  async function layout(): Promise<Layout> {
+    const count = layouts.length;
+    client.send({type: 'layout'});
+    expect(await waitFor(() => layouts.length > count, 5_000)).toBe(true);
+    return layouts[count];
+  }
+
+  // The addon's requests reach the server on its own connection
+  async function settledLayout(expected: (next: Layout) => boolean): Promise<Layout> {
+    let next = await layout();
+    for (let i = 0; i < 20 && !expected(next); i++) {
+      next = await layout();
+    }
+    return next;
+  }
+
+  const same = (a: Layout, b: Layout) => JSON.stringify(a) === JSON.stringify(b);
+  const profilesByPid = () => Object.fromEntries(pids.map((pid, i) => [pid, PROFILES[i]]));
+  const pidsByProfile = () => Object.fromEntries(PROFILES.map((profile, i) => [profile, pids[i]]));
+
+  // Grid the windows, which moves, resizes and restacks every one of them
+  async function scramble(from: Layout) {
+    manager.arrangeWindows(pids[0], pids.slice(1), 2, {width: 0, height: 0}, 10, 0);
+    const scrambled = await settledLayout(next => !same(next, from));
+    expect(scrambled.bounds).not.toEqual(from.bounds);
+    expect(scrambled.stack).not.toEqual(from.stack);
+  }
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1280, 720);
+    const display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(PROFILES.length + 1));
+    pids = owners.slice(0, PROFILES.length).map(owner => owner.pid as number);
+    absentPid = owners[PROFILES.length].pid as number;
+    const windows = pids.map((pid, i) => {
+      const [x, y, width, height] = BOUNDS[i];
+      return {pid, x, y, width, height};
+    });
+
+    client = await startStandIns(display, windows, (message: {type: string} & Layout) => {
+      if (message.type === 'layout') {
+        layouts.push({bounds: message.bounds, stack: message.stack});
+      }
+    });
+  }, 30_000);
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('restores the bounds and stacking of every saved window', async () => {
+    const saved = await layout();
+    expect(saved.bounds).toEqual(BOUNDS);
+    // A profile without a window is left out
+    const blob = manager.saveLayout({...profilesByPid(), [absentPid]: 'Profile 4'});
+    expect(blob.subarray(0, 3).toString()).toBe('CPL');
+    expect(blob.includes('Profile 4')).toBe(false);
+
+    await scramble(saved);
+
+    // As kept in the settings store
+    const stored = Buffer.from(blob.toString('base64'), 'base64');
+    expect(manager.restoreLayout(stored, pidsByProfile())).toEqual({
+      moved: PROFILES.length,
+      skipped: 0,
+      missing: 0,
+      pending: [],
+    });
+    const restored = await settledLayout(next => same(next, saved));
+    expect(restored).toEqual(saved);
+
+    // Nothing is out of place the second time
+    expect(manager.restoreLayout(stored, pidsByProfile())).toEqual({
+      moved: 0,
+      skipped: PROFILES.length,
+      missing: 0,
+      pending: [],
+    });
+    expect(await layout()).toEqual(saved);
+  });
+
+  test('restores the windows that are up and returns the rest as pending', async () => {
+    const saved = await layout();
+    const blob = manager.saveLayout(profilesByPid());
+    await scramble(saved);
+
+    // Profile 2 has not opened its window yet, Profile 3 is not being restored
+    const partial = {...pidsByProfile(), 'Profile 2': absentPid};
+    delete partial['Profile 3'];
+    expect(manager.restoreLayout(blob, partial)).toEqual({moved: 2, skipped: 0, missing: 1, pending: ['Profile 2']});
+    const restored = await settledLayout(next => next.bounds[1].every((v, j) => v === saved.bounds[1][j]));
+    expect(restored.bounds.slice(0, 2)).toEqual(saved.bounds.slice(0, 2));
+    expect(restored.bounds[2]).not.toEqual(saved.bounds[2]);
+
+    // Repeated once the window is up
+    expect(manager.restoreLayout(blob, pidsByProfile())).toEqual(
+      expect.objectContaining({moved: 2, skipped: 2, missing: 0, pending: []}),
+    );
+    // The two placed now are raised over the others, so only the bounds match
+    const sameBounds = (next: Layout) => JSON.stringify(next.bounds) === JSON.stringify(saved.bounds);
+    expect((await settledLayout(sameBounds)).bounds).toEqual(saved.bounds);
+  });
+
+  test('refuses data that is not a saved layout', () => {
+    const blob = manager.saveLayout(profilesByPid());
+    expect(() => manager.restoreLayout(blob.subarray(0, blob.length - 1), pidsByProfile())).toThrow(
+      'Invalid layout data',
+    );
+    expect(() => manager.restoreLayout(Buffer.from('not a layout'), pidsByProfile())).toThrow('Invalid layout data');
+  });
+});
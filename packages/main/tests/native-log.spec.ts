@@ -0,0 +1,94 @@
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterEach, describe, expect, test} from 'vitest';
+import {sleep, waitFor} from './fixtures/xvfb';
+
+/**
+ * Native log sink: lines written by the addon reach the JS callback in
+ * batches, and a call site logging in a loop is rate limited. An invalid
+ * DevTools URL passed to startCdpSync is used to make the addon log.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface NativeLogRecord {
+  level: 'debug' | 'info' | 'warn' | 'error';
+  message: string;
+  file: string;
+  line: number;
+  time: number;
+  suppressed: number;
+}
+
+interface LoggingManager {
+  setLogSink(callback: ((records: NativeLogRecord[]) => void) | null, options?: {level?: string}): void;
+  startCdpSync(masterUrl: string, slaveUrls: string[]): boolean;
+}
+
+// Lines per call site per second, LogSite::kBurst
+const BURST = 10;
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH);
+
+describe.skipIf(!enabled)('native logger', () => {
+  let manager: LoggingManager;
+
+  function capture() {
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+    const records: NativeLogRecord[] = [];
+    manager.setLogSink(batch => records.push(...batch));
+    return records;
+  }
+
+  afterEach(() => {
+    manager?.setLogSink(null);
+  });
+
+  test('delivers native lines to the sink', async () => {
+    const records = capture();
+    const started = Date.now();
+
+    expect(manager.startCdpSync('not-a-devtools-url', [])).toBe(false);
+
+    expect(await waitFor(() => records.length === 1, 2_000)).toBe(true);
+    expect(records[0]).toMatchObject({
+      level: 'error',
+      message: 'Invalid DevTools URL: not-a-devtools-url',
+      file: 'cdp-sync.cpp',
+      suppressed: 0,
+    });
+    expect(records[0].line).toBeGreaterThan(0);
+    expect(records[0].time).toBeGreaterThanOrEqual(started - 1_000);
+  });
+
+  test('rate limits a call site and reports what it dropped', async () => {
+    const records = capture();
+    // Start on a fresh second of the call site's window
+    await sleep(1_100);
+
+    for (let i = 0; i < BURST + 15; i++) {
+      manager.startCdpSync(`bad-url-${i}`, []);
+    }
+    // The burst may straddle a second boundary, which admits another burst
+    expect(await waitFor(() => records.length >= BURST, 2_000)).toBe(true);
+    // Lines can arrive over more than one flush
+    await sleep(300);
+    const admitted = records.length;
+    expect(admitted).toBeLessThanOrEqual(BURST * 2);
+
+    await sleep(1_100);
+    manager.startCdpSync('bad-url-last', []);
+    expect(await waitFor(() => records.length === admitted + 1, 2_000)).toBe(true);
+    expect(records[admitted].message).toBe('Invalid DevTools URL: bad-url-last');
+    // Every dropped line is accounted for by a later line from the same site
+    const suppressed = records.reduce((total, record) => total + record.suppressed, 0);
+    expect(suppressed).toBe(BURST + 15 - admitted);
+  });
+
+  test('rejects unknown levels', () => {
+    capture();
+    expect(() => manager.setLogSink(() => {}, {level: 'verbose'})).toThrow(TypeError);
+  });
+});
@@ -0,0 +1,121 @@
+import type {ChildProcess} from 'node:child_process';
+import {spawn} from 'node:child_process';
+import {existsSync, mkdtempSync, rmSync, writeFileSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {tmpdir} from 'node:os';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+
+/**
+ * Memory reclaim on synthetic profiles: python processes that map a file and
+ * touch every page of it, so the pages count in their RSS and can be dropped
+ * without swap. process_madvise() on another process needs CAP_SYS_NICE,
+ * which in practice means running as root.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const MAPPED_BYTES = 64 * 1024 * 1024;
+
+const TOUCH_SCRIPT = `
+import mmap, sys, time
+import {hasCommand, sleep, waitFor} from './fixtures/xvfb';
+f = open(sys.argv[1], 'rb')
+m = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+total = sum(m[i] for i in range(0, len(m), 4096))
+print('ready', flush=True)
+time.sleep(600)
+`;
+
+interface ReclaimResult {
+  processes: number;
+  failed: number;
+  rssBefore: number;
+  rssAfter: number;
+  reclaimedBytes: number;
+  elapsedMs: number;
+}
+
+interface ReclaimStats {
+  profiles: number;
+  reclaims: number;
+  reclaimedBytes: number;
+  failed: number;
+  lastReclaimMs: number;
+}
+
+interface ReclaimManager {
+  reclaimMemory(pid: number, options?: {mode?: string}): Promise<ReclaimResult>;
+  setAutoReclaim(pids: number[], options: {idleMs: number; mode?: string}): void;
+  getReclaimStats(): ReclaimStats;
+}
+
+const enabled =
+  process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('python3') && process.getuid?.() === 0;
+
+describe.skipIf(!enabled)('memory reclaim', () => {
+  let manager: ReclaimManager;
+  let directory: string;
+  const profiles: ChildProcess[] = [];
+
+  async function startProfile(): Promise<number> {
+    const profile = spawn('python3', ['-c', TOUCH_SCRIPT, join(directory, 'mapped')], {
+      stdio: ['ignore', 'pipe', 'ignore'],
+    });
+    profiles.push(profile);
+    let ready = false;
+    profile.stdout?.on('data', (data: Buffer) => {
+      ready ||= data.toString().includes('ready');
+    });
+    expect(await waitFor(() => ready, 10_000)).toBe(true);
+    return profile.pid as number;
+  }
+
+  beforeAll(() => {
+    directory = mkdtempSync(join(tmpdir(), 'reclaim-'));
+    writeFileSync(join(directory, 'mapped'), Buffer.alloc(MAPPED_BYTES, 1));
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+  });
+
+  afterAll(() => {
+    manager?.setAutoReclaim([], {idleMs: 1});
+    for (const profile of profiles) {
+      profile.kill();
+    }
+    rmSync(directory, {recursive: true, force: true});
+  });
+
+  test('rejects bad options', () => {
+    expect(() => manager.reclaimMemory(1, {mode: 'swap'})).toThrow(TypeError);
+    expect(() => manager.setAutoReclaim([1], {idleMs: 0})).toThrow(RangeError);
+  });
+
+  test('pages out the mapped memory of a profile', async () => {
+    const pid = await startProfile();
+    const result = await manager.reclaimMemory(pid);
+    expect(result).toMatchObject({processes: 1, failed: 0});
+    expect(result.rssBefore).toBeGreaterThan(MAPPED_BYTES);
+    expect(result.reclaimedBytes).toBeGreaterThan(MAPPED_BYTES / 2);
+    expect(result.rssAfter).toBe(result.rssBefore - result.reclaimedBytes);
+  });
+
+  test('a process that is gone counts as none', async () => {
+    expect(await manager.reclaimMemory(999_999)).toMatchObject({processes: 0, failed: 0, reclaimedBytes: 0});
+  });
+
+  test('reclaims idle profiles once', async () => {
+    const pid = await startProfile();
+    manager.setAutoReclaim([pid], {idleMs: 200});
+    expect(manager.getReclaimStats()).toMatchObject({profiles: 1, reclaims: 0});
+
+    expect(await waitFor(() => manager.getReclaimStats().reclaims === 1, 5_000)).toBe(true);
+    const stats = manager.getReclaimStats();
+    expect(stats.reclaimedBytes).toBeGreaterThan(MAPPED_BYTES / 2);
+    expect(stats.failed).toBe(0);
+
+    // Not again without focus in between
+    await sleep(500);
+    expect(manager.getReclaimStats().reclaims).toBe(1);
+  });
+});
@@ -0,0 +1,126 @@
+import type {ChildProcess} from 'node:child_process';
+import {spawn} from 'node:child_process';
+import {existsSync, readFileSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {cpus} from 'node:os';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import {waitFor} from './fixtures/xvfb';
+
+/**
+ * Scheduling policies on a stand-in profile: a node process that starts a
+ * child of its own a little later, like Chrome starting renderers. Only
+ * lowering priority is checked, which needs no privileges.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface SchedulingPolicy {
+  nice?: number;
+  ioClass?: string;
+  ioLevel?: number;
+  cpus?: number[];
+  cpuWeight?: number;
+  cpuMaxPercent?: number;
+}
+
+interface SchedulingStats {
+  profiles: number;
+  processes: number;
+  applied: number;
+  failed: number;
+  boostedPid: number;
+  cgroups: boolean;
+}
+
+interface SchedulingManager {
+  setProcessPolicy(pid: number, policy: SchedulingPolicy): {processes: number; failed: number};
+  clearProcessPolicy(pid: number): boolean;
+  setForegroundBoost(policy: SchedulingPolicy | null): boolean;
+  getSchedulingStats(): SchedulingStats;
+  getProcessTree(pid: number, refresh?: boolean): number[];
+}
+
+// Field 19 of /proc/<pid>/stat, counted after the command name
+function niceOf(pid: number): number {
+  const stat = readFileSync(`/proc/${pid}/stat`, 'utf8');
+  return Number(stat.slice(stat.lastIndexOf(')') + 2).split(' ')[16]);
+}
+
+function cpusOf(pid: number): string {
+  const status = readFileSync(`/proc/${pid}/status`, 'utf8');
+  return /^Cpus_allowed_list:\s*(\S+)/m.exec(status)?.[1] ?? '';
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH);
+
+describe.skipIf(!enabled)('process scheduling', () => {
+  let manager: SchedulingManager;
+  let profile: ChildProcess;
+  let root: number;
+
+  beforeAll(() => {
+    profile = spawn(
+      process.execPath,
+      [
+        '-e',
+        "setTimeout(() => require('child_process').spawn('sleep', ['600'], {stdio: 'ignore'}), 1000); setInterval(() => {}, 1000);",
+      ],
+      {stdio: 'ignore', detached: true},
+    );
+    root = profile.pid as number;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+  });
+
+  afterAll(() => {
+    manager?.setForegroundBoost(null);
+    manager?.clearProcessPolicy(root);
+    if (profile?.pid) {
+      process.kill(-profile.pid, 'SIGKILL');
+    }
+  });
+
+  test('rejects unknown I/O classes', () => {
+    expect(() => manager.setProcessPolicy(root, {ioClass: 'background'})).toThrow(TypeError);
+  });
+
+  test('applies to the whole tree and follows new processes', async () => {
+    const result = manager.setProcessPolicy(root, {nice: 10, ioClass: 'idle', cpus: [0]});
+    expect(result).toEqual({processes: 1, failed: 0});
+    expect(niceOf(root)).toBe(10);
+    expect(cpusOf(root)).toBe('0');
+
+    // The child shows up in the process index within its refresh interval,
+    // and the scheduler's next pass counts it
+    expect(await waitFor(() => manager.getProcessTree(root, true).length === 2, 5_000)).toBe(true);
+    expect(await waitFor(() => manager.getSchedulingStats().processes === 2, 3_000)).toBe(true);
+    const [, child] = manager.getProcessTree(root);
+    expect(niceOf(child)).toBe(10);
+    expect(cpusOf(child)).toBe('0');
+    expect(manager.getSchedulingStats()).toMatchObject({profiles: 1, failed: 0});
+  });
+
+  test('lowers priority further on a new policy', () => {
+    expect(manager.setProcessPolicy(root, {nice: 15})).toMatchObject({processes: 2, failed: 0});
+    for (const pid of manager.getProcessTree(root)) {
+      expect(niceOf(pid)).toBe(15);
+    }
+  });
+
+  test('boost follows focus only where it is tracked', () => {
+    // Without a display there is no focus to follow
+    const tracked = manager.setForegroundBoost({cpuWeight: 1000});
+    expect(typeof tracked).toBe('boolean');
+    expect(manager.getSchedulingStats().boostedPid).toBe(0);
+    manager.setForegroundBoost(null);
+  });
+
+  test('stops following a cleared profile', () => {
+    expect(manager.clearProcessPolicy(root)).toBe(true);
+    expect(manager.clearProcessPolicy(root)).toBe(false);
+    expect(manager.getSchedulingStats()).toMatchObject({profiles: 0, processes: 0});
+    // Any CPU again
+    expect(cpusOf(root)).toBe(cpus().length > 1 ? `0-${cpus().length - 1}` : '0');
+  });
+});
@@ -0,0 +1,109 @@
+import type {ChildProcess} from 'node:child_process';
+import {spawn} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {forkStandIns, hasCommand, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Window lookups by launcher pid: Chrome started through a wrapper owns its
+ * windows under a child pid. The index itself (recycled pids, incremental
+ * refresh, caching) is covered by process-tree-test.cpp.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface TreeManager {
+  getProcessTree(pid: number, refresh?: boolean): number[];
+  waitForWindow(pid: number, options?: {timeoutMs?: number}): Promise<{x: number; y: number} | null>;
+}
+
+interface Wrapper {
+  wrapper: ChildProcess;
+  pid: number;
+  child: number;
+}
+
+// A shell that starts sleep in the background and waits on it, as launch
+// scripts start Chrome
+async function startWrapper(): Promise<Wrapper> {
+  const wrapper = spawn('sh', ['-c', 'sleep 600 & echo $!; wait'], {stdio: ['ignore', 'pipe', 'ignore']});
+  let output = '';
+  wrapper.stdout?.on('data', (chunk: Buffer) => (output += chunk.toString()));
+  expect(await waitFor(() => output.includes('\n'), 5_000)).toBe(true);
+  return {wrapper, pid: wrapper.pid as number, child: Number.parseInt(output, 10)};
+}
+
+function stopWrapper({wrapper, child}: Wrapper) {
+  wrapper.kill('SIGKILL');
+  try {
+    process.kill(child, 'SIGKILL');
+  } catch {
+    // Already gone
+  }
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH);
+
+describe.skipIf(!enabled)('process tree', () => {
+  let addon: {WindowManager: new () => TreeManager};
+  let manager: TreeManager;
+  const wrappers: Wrapper[] = [];
+
+  beforeAll(() => {
+    addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+  });
+
+  afterAll(() => {
+    wrappers.forEach(stopWrapper);
+  });
+
+  test('resolves a wrapper pid to the process it started', async () => {
+    const wrapper = await startWrapper();
+    wrappers.push(wrapper);
+    expect(manager.getProcessTree(wrapper.pid, true)).toEqual([wrapper.pid, wrapper.child]);
+    expect(manager.getProcessTree(process.pid, true)).toEqual(expect.arrayContaining([wrapper.pid, wrapper.child]));
+  });
+
+  test('keeps the child under the wrapper after the wrapper exits', async () => {
+    const wrapper = await startWrapper();
+    wrappers.push(wrapper);
+    manager.getProcessTree(wrapper.pid, true);
+
+    const exited = new Promise(resolve => wrapper.wrapper.once('exit', resolve));
+    wrapper.wrapper.kill('SIGKILL');
+    await exited;
+    expect(manager.getProcessTree(wrapper.pid, true)).toEqual([wrapper.pid, wrapper.child]);
+  });
+
+  describe.skipIf(!hasCommand('Xvfb'))('under Xvfb', () => {
+    let xvfb: XvfbServer;
+    let client: ChildProcess | undefined;
+    let x11Manager: TreeManager;
+
+    beforeAll(async () => {
+      xvfb = await startXvfb(1280, 720);
+      // The X connection is opened with the manager
+      process.env.DISPLAY = `:${xvfb.display}`;
+      x11Manager = new addon.WindowManager();
+    });
+
+    afterAll(() => {
+      client?.send({type: 'stop'});
+      xvfb?.stop();
+    });
+
+    test('finds the window of a wrapped Chrome by the wrapper pid', async () => {
+      const wrapper = await startWrapper();
+      wrappers.push(wrapper);
+      const windows = [{pid: wrapper.child, x: 40, y: 30, width: 300, height: 200}];
+      client = forkStandIns(xvfb.display, windows);
+
+      const found = await x11Manager.waitForWindow(wrapper.pid, {timeoutMs: 10_000});
+      expect(found).toMatchObject({x: 40, y: 30});
+    });
+  });
+});
@@ -0,0 +1,150 @@
+import type {ChildProcess} from 'node:child_process';
+import {spawn} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import {waitFor} from './fixtures/xvfb';
+
+/**
+ * Profile sampler on stand-in profiles: a busy node process that started a
+ * child of its own, and an idle one. Rows are read back by their field names.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const INTERVAL_MS = 100;
+const HISTORY = 5;
+
+interface SamplerInfo {
+  slotCount: number;
+  history: number;
+  stride: number;
+  fields: string[];
+}
+
+interface ProfileSamples {
+  sequence: number;
+  frames: number;
+  slotCount: number;
+  stride: number;
+  sampleMs: number;
+  values: Float64Array;
+}
+
+interface SamplingManager {
+  startProfileSampler(
+    pids: number[],
+    options?: {intervalMs?: number; history?: number; slots?: number; pss?: boolean},
+  ): SamplerInfo;
+  setSampledProfiles(pids: number[]): boolean;
+  getProfileSamples(frames?: number): ProfileSamples | null;
+  stopProfileSampler(): void;
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH);
+
+describe.skipIf(!enabled)('profile sampler', () => {
+  let manager: SamplingManager;
+  let info: SamplerInfo;
+  let busy: ChildProcess;
+  let idle: ChildProcess;
+
+  // Row of pid in frame (0 = newest), keyed by field name
+  function row(samples: ProfileSamples, pid: number, frame = 0): Record<string, number> | undefined {
+    for (let slot = 0; slot < samples.slotCount; slot++) {
+      const offset = (frame * samples.slotCount + slot) * samples.stride;
+      if (samples.values[offset] === pid) {
+        return Object.fromEntries(info.fields.map((field, i) => [field, samples.values[offset + i]]));
+      }
+    }
+    return undefined;
+  }
+
+  beforeAll(() => {
+    busy = spawn(
+      process.execPath,
+      ['-e', "require('child_process').spawn('sleep', ['600'], {stdio: 'ignore'}); for (;;) {}"],
+      {stdio: 'ignore', detached: true},
+    );
+    idle = spawn('sleep', ['600'], {stdio: 'ignore'});
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+  });
+
+  afterAll(() => {
+    manager?.stopProfileSampler();
+    // The busy profile's own child goes with its process group
+    if (busy?.pid) {
+      process.kill(-busy.pid, 'SIGKILL');
+    }
+    idle?.kill();
+  });
+
+  test('rejects bad options', () => {
+    expect(() => manager.startProfileSampler([idle.pid as number], {intervalMs: 1})).toThrow(RangeError);
+    expect(() => manager.startProfileSampler([idle.pid as number], {history: 0})).toThrow(RangeError);
+    expect(() => manager.startProfileSampler([])).toThrow(RangeError);
+    expect(manager.getProfileSamples()).toBeNull();
+  });
+
+  test('aggregates each profile over its process tree', async () => {
+    const pids = [busy.pid as number, idle.pid as number, 999_999];
+    info = manager.startProfileSampler(pids, {intervalMs: INTERVAL_MS, history: HISTORY, slots: 4});
+    expect(info).toMatchObject({slotCount: 4, history: HISTORY, stride: info.fields.length});
+    expect(info.fields.slice(0, 3)).toEqual(['pid', 'timestampMs', 'cpuPercent']);
+
+    // Give the busy profile time to start its child and burn CPU
+    expect(await waitFor(() => (manager.getProfileSamples()?.sequence ?? 0) >= 6, 5_000)).toBe(true);
+    const samples = manager.getProfileSamples() as ProfileSamples;
+    expect(samples.values).toBeInstanceOf(Float64Array);
+    expect(samples.values.length).toBe(4 * info.stride);
+    expect(samples.sampleMs).toBeLessThan(INTERVAL_MS);
+
+    const hot = row(samples, busy.pid as number);
+    expect(hot).toMatchObject({processes: 2});
+    expect(hot?.cpuPercent).toBeGreaterThan(50);
+    expect(hot?.cpuTimeMs).toBeGreaterThan(0);
+    expect(hot?.rssBytes).toBeGreaterThan(0);
+    expect(hot?.pssBytes).toBeGreaterThan(0);
+    expect(hot?.threads).toBeGreaterThan(1);
+    expect(hot?.timestampMs).toBeGreaterThan(Date.now() - 5_000);
+
+    const cold = row(samples, idle.pid as number);
+    expect(cold).toMatchObject({processes: 1, threads: 1});
+    expect(cold?.cpuPercent).toBeLessThan(5);
+
+    // Gone (or never there): the row stays, with nothing in it
+    expect(row(samples, 999_999)).toMatchObject({processes: 0, rssBytes: 0, cpuPercent: 0});
+    // The spare slot is empty
+    expect(samples.values[3 * info.stride]).toBe(0);
+  });
+
+  test('keeps a bounded history, newest first', () => {
+    const samples = manager.getProfileSamples(100) as ProfileSamples;
+    expect(samples.frames).toBe(HISTORY);
+    expect(samples.values.length).toBe(HISTORY * 4 * info.stride);
+
+    const timestamps = Array.from({length: HISTORY}, (_, frame) => row(samples, idle.pid as number, frame)?.timestampMs);
+    for (let frame = 1; frame < HISTORY; frame++) {
+      expect(timestamps[frame - 1]).toBeGreaterThan(timestamps[frame] as number);
+    }
+  });
+
+  test('switches profiles without restarting', async () => {
+    expect(manager.setSampledProfiles([idle.pid as number])).toBe(true);
+    const sequence = (manager.getProfileSamples() as ProfileSamples).sequence;
+    expect(await waitFor(() => (manager.getProfileSamples()?.sequence ?? 0) > sequence + 1, 2_000)).toBe(true);
+
+    const samples = manager.getProfileSamples() as ProfileSamples;
+    expect(samples.values[0]).toBe(idle.pid);
+    expect(row(samples, busy.pid as number)).toBeUndefined();
+    expect(manager.setSampledProfiles([1, 2, 3, 4, 5])).toBe(false);
+  });
+
+  test('stops', () => {
+    manager.stopProfileSampler();
+    expect(manager.getProfileSamples()).toBeNull();
+    expect(manager.setSampledProfiles([idle.pid as number])).toBe(false);
+  });
+});
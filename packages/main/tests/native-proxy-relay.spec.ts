@@ -0,0 +1,211 @@
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import type {AddressInfo, Socket} from 'node:net';
+import {join} from 'node:path';
+import {afterEach, describe, expect, test, vi} from 'vitest';
+import {waitFor} from './fixtures/xvfb';
+
+/**
+ * Native SOCKS5 relay against loopback stand-ins for the target and the
+ * upstream proxies (fixtures/proxy-stand-ins.cjs). Set RELAY_BENCH=1 to also
+ * run the throughput benchmark against the JS fallback, proxy-server/socks-server.ts.
+ */
+
+// The JS fallback logs through winston into the Electron user data folder
+vi.mock('../../shared/utils/logger', () => ({
+  createLogger: () => ({debug() {}, info() {}, warn() {}, error() {}}),
+}));
+
+const RELAY_PATH = join(__dirname, '../src/native-addon/build/Release/proxy-relay.node');
+
+interface StandIn {
+  port: number;
+  stats: {connections: number; authFailures: number; destinations: string[]};
+  close(): Promise<void>;
+}
+
+interface RelayStats {
+  id: number;
+  connections: number;
+  active: number;
+  failures: number;
+  bytesUp: number;
+  bytesDown: number;
+  connectSamples: number;
+  connectMsAvg: number;
+  connectMsMax: number;
+}
+
+interface ProxyRelay {
+  addRoute(options: {
+    listenHost?: string;
+    listenPort?: number;
+    upstream: {type: 'socks5' | 'http'; host: string; port: number; username?: string; password?: string};
+  }): {id: number; port: number};
+  removeRoute(id: number): boolean;
+  getStats(id: number): RelayStats | null;
+  close(): void;
+}
+
+const localRequire = createRequire(__filename);
+const {startEchoServer, startSocksUpstream, startHttpUpstream, socks5Connect, httpConnect, readBytes} = localRequire(
+  './fixtures/proxy-stand-ins.cjs',
+) as {
+  startEchoServer(): Promise<Omit<StandIn, 'stats'>>;
+  startSocksUpstream(options?: {username?: string; password?: string}): Promise<StandIn>;
+  startHttpUpstream(options?: {username?: string; password?: string}): Promise<StandIn>;
+  socks5Connect(proxyPort: number, host: string, port: number): Promise<Socket>;
+  httpConnect(proxyPort: number, host: string, port: number): Promise<Socket>;
+  readBytes(socket: Socket, length: number): Promise<Buffer>;
+};
+
+// Writes payload through the tunnel and reads the echo back
+async function roundTrip(socket: Socket, payload: Buffer): Promise<Buffer> {
+  const received = readBytes(socket, payload.length);
+  socket.write(payload);
+  return received;
+}
+
+type Connect = (proxyPort: number, host: string, port: number) => Promise<Socket>;
+
+// Echoes a 64 MiB payload through one tunnel, then opens 200 more, timing
+// each from the client's connect to the tunnel being up
+async function bench(connect: Connect, proxyPort: number, echoPort: number) {
+  const payload = Buffer.alloc(64 * 1024 * 1024, 7);
+  const socket = await connect(proxyPort, 'localhost', echoPort);
+  const started = process.hrtime.bigint();
+  await roundTrip(socket, payload);
+  const seconds = Number(process.hrtime.bigint() - started) / 1e9;
+  socket.destroy();
+
+  const connectMs: number[] = [];
+  for (let i = 0; i < 200; i++) {
+    const opened = process.hrtime.bigint();
+    (await connect(proxyPort, 'localhost', echoPort)).destroy();
+    connectMs.push(Number(process.hrtime.bigint() - opened) / 1e6);
+  }
+  return {
+    mibPerSecond: (payload.length * 2) / seconds / 1024 / 1024,
+    connectMsAvg: connectMs.reduce((sum, ms) => sum + ms, 0) / connectMs.length,
+    connectMsMax: Math.max(...connectMs),
+  };
+}
+
+const describeBench = (name: string, result: Awaited<ReturnType<typeof bench>>) =>
+  `${name}: ${result.mibPerSecond.toFixed(0)} MiB/s echoed, ` +
+  `connect avg ${result.connectMsAvg.toFixed(2)} ms, max ${result.connectMsMax.toFixed(2)} ms`;
+
+const enabled = process.platform === 'linux' && existsSync(RELAY_PATH);
+
+describe.skipIf(!enabled)('native SOCKS5 relay', () => {
+  const CREDENTIALS = {username: 'profile-7', password: 's3cret'};
+  let relay: ProxyRelay;
+  let cleanup: Array<() => Promise<void> | void> = [];
+
+  async function setup(type: 'socks5' | 'http', credentials = CREDENTIALS) {
+    const addon = localRequire(RELAY_PATH);
+    relay = new addon.ProxyRelay();
+    const echo = await startEchoServer();
+    const upstream = type === 'socks5' ? await startSocksUpstream(CREDENTIALS) : await startHttpUpstream(CREDENTIALS);
+    cleanup.push(() => relay.close(), () => echo.close(), () => upstream.close());
+
+    const route = relay.addRoute({upstream: {type, host: '127.0.0.1', port: upstream.port, ...credentials}});
+    expect(route.port).toBeGreaterThan(0);
+    return {echo, upstream, route};
+  }
+
+  afterEach(async () => {
+    for (const step of cleanup.reverse()) {
+      await step();
+    }
+    cleanup = [];
+  });
+
+  test.each(['socks5', 'http'] as const)('tunnels through an authenticated %s upstream', async type => {
+    const {echo, upstream, route} = await setup(type);
+
+    const socket = await socks5Connect(route.port, 'localhost', echo.port);
+    const payload = Buffer.alloc(4 * 1024 * 1024, 0).map((_, i) => i * 31);
+    expect((await roundTrip(socket, payload)).equals(payload)).toBe(true);
+    socket.destroy();
+
+    expect(upstream.stats.destinations).toEqual([`localhost:${echo.port}`]);
+    expect(await waitFor(() => relay.getStats(route.id)?.active === 0, 5_000)).toBe(true);
+    const stats = relay.getStats(route.id)!;
+    expect(stats.connections).toBe(1);
+    expect(stats.connectSamples).toBe(1);
+    expect(stats.failures).toBe(0);
+    expect(stats.bytesUp).toBe(payload.length);
+    expect(stats.bytesDown).toBe(payload.length);
+  });
+
+  test.each(['socks5', 'http'] as const)('reports rejected %s credentials to the client', async type => {
+    const {echo, upstream, route} = await setup(type, {username: 'profile-7', password: 'wrong'});
+
+    await expect(socks5Connect(route.port, 'localhost', echo.port)).rejects.toMatchObject({code: 2});
+    expect(upstream.stats.authFailures).toBe(1);
+    expect(await waitFor(() => relay.getStats(route.id)?.failures === 1, 5_000)).toBe(true);
+  });
+
+  test('reports an unreachable target as connection refused', async () => {
+    const {echo, route} = await setup('socks5');
+    const port = echo.port;
+    await echo.close();
+
+    await expect(socks5Connect(route.port, '127.0.0.1', port)).rejects.toMatchObject({code: 5});
+  });
+
+  test('keeps concurrent tunnels independent', async () => {
+    const {echo, route} = await setup('socks5');
+
+    const sockets = await Promise.all(
+      Array.from({length: 32}, () => socks5Connect(route.port, 'localhost', echo.port)),
+    );
+    const results = await Promise.all(
+      sockets.map((socket, i) => roundTrip(socket, Buffer.alloc(64 * 1024, i))),
+    );
+    results.forEach((result, i) => expect(result.equals(Buffer.alloc(64 * 1024, i))).toBe(true));
+    expect(relay.getStats(route.id)?.active).toBe(32);
+    sockets.forEach(socket => socket.destroy());
+  });
+
+  test('removing a route closes its listener and tunnels', async () => {
+    const {echo, route} = await setup('socks5');
+    const socket = await socks5Connect(route.port, 'localhost', echo.port);
+    const closed = new Promise(resolve => socket.once('close', resolve));
+
+    expect(relay.removeRoute(route.id)).toBe(true);
+    expect(relay.removeRoute(route.id)).toBe(false);
+    expect(relay.getStats(route.id)).toBeNull();
+    socket.resume();
+    await closed;
+    await expect(socks5Connect(route.port, 'localhost', echo.port)).rejects.toMatchObject({code: 'ECONNREFUSED'});
+  });
+
+  test.skipIf(!process.env.RELAY_BENCH)('benchmark: native relay against the JS fallback', async () => {
+    const {echo, upstream, route} = await setup('socks5');
+    const native = await bench(socks5Connect, route.port, echo.port);
+    expect(relay.getStats(route.id)!.connectSamples).toBe(201);
+
+    const {default: SocksServer} = await import('../src/proxy-server/socks-server');
+    const server = SocksServer({
+      listenHost: '127.0.0.1',
+      listenPort: 0,
+      socksHost: '127.0.0.1',
+      socksPort: upstream.port,
+      socksUsername: CREDENTIALS.username,
+      socksPassword: CREDENTIALS.password,
+    });
+    cleanup.push(
+      () =>
+        new Promise<void>(resolve => {
+          server.closeAllConnections();
+          server.close(() => resolve());
+        }),
+    );
+    await new Promise(resolve => server.once('listening', resolve));
+    const js = await bench(httpConnect, (server.address() as AddressInfo).port, echo.port);
+
+    console.log(`${describeBench('native relay', native)}\n${describeBench('JS socks-server', js)}`);
+  }, 120_000);
+});
@@ -0,0 +1,273 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientEvent, ClientMessage, StandInWindow, XvfbServer} from './fixtures/xvfb';
+import {hasCommand, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * The networked sync relay under Xvfb, with master and agent on localhost.
+ * The master streams its window's input over TCP and the agent, a second
+ * WindowManager, replays it on slave windows of other sizes. All windows are
+ * stand-ins created by fixtures/x11-test-client.cjs.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const MASTER_WIDTH = 200;
+const MASTER_HEIGHT = 100;
+// Slave sizes relative to the master
+const SCALES = [1, 2];
+
+const KEY_PRESS = 2;
+const KEY_RELEASE = 3;
+const BUTTON_PRESS = 4;
+const BUTTON_RELEASE = 5;
+const MOTION_NOTIFY = 6;
+
+interface RelayAgentLinkStats {
+  host: string;
+  port: number;
+  connected: boolean;
+  connects: number;
+  batches: number;
+  events: number;
+  bytes: number;
+  coalesced: number;
+  dropped: number;
+  acked: number;
+  inflight: number;
+  acks: number;
+  avgQueueUs: number;
+  avgNetworkUs: number;
+  avgApplyUs: number;
+  avgRttUs: number;
+  maxRttUs: number;
+}
+
+interface SyncRelayStats {
+  running: boolean;
+  posted: number;
+  refused: number;
+  batches: number;
+  agents: RelayAgentLinkStats[];
+}
+
+interface RelayAgentStats {
+  running: boolean;
+  port: number;
+  connections: number;
+  batches: number;
+  events: number;
+  injected: number;
+  missed: number;
+  gaps: number;
+  released: number;
+  malformed: number;
+  avgApplyUs: number;
+  maxApplyUs: number;
+}
+
+interface RelayManager {
+  startSyncRelay(
+    masterPid: number,
+    agents: {host: string; port: number}[],
+    options?: {batchUs?: number; maxInflight?: number; queueCapacity?: number},
+  ): boolean;
+  relayMouseEvent(x: number, y: number, type: string): boolean;
+  relayKeyboardEvent(keyCode: number, type: string): boolean;
+  stopSyncRelay(): void;
+  getSyncRelayStats(): SyncRelayStats;
+  startRelayAgent(slavePids: number[], options?: {host?: string; port?: number}): number;
+  stopRelayAgent(): void;
+  getRelayAgentStats(): RelayAgentStats;
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('sync relay under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let master: RelayManager;
+  let agent: RelayManager;
+  const owners: ChildProcess[] = [];
+  // [master, ...slaves]
+  const windows: StandInWindow[] = [];
+  const events: ClientEvent[] = [];
+
+  const received = (index: number, code: number) => events.filter(event => event[0] === index && event[1] === code);
+  const link = () => master.getSyncRelayStats().agents[0];
+  let agentPort = 0;
+
+  async function restartRelay(options: {maxInflight?: number; queueCapacity?: number} = {}) {
+    master.stopSyncRelay();
+    const port = agentPort;
+    expect(master.startSyncRelay(windows[0].pid, [{host: '127.0.0.1', port}], {batchUs: 500, ...options})).toBe(true);
+    expect(await waitFor(() => link().connected, 5_000)).toBe(true);
+  }
+
+  beforeAll(async () => {
+    xvfb = await startXvfb();
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    // Two managers stand in for two hosts
+    master = new addon.WindowManager();
+    agent = new addon.WindowManager();
+
+    const scales = [1, ...SCALES];
+    owners.push(...spawnOwners(scales.length));
+    for (const [i, scale] of scales.entries()) {
+      windows.push({
+        pid: owners[i].pid as number,
+        x: i * 450,
+        y: 0,
+        width: MASTER_WIDTH * scale,
+        height: MASTER_HEIGHT * scale,
+      });
+    }
+
+    client = await startStandIns(display, windows, (message: ClientMessage) => {
+      if (message.type === 'events' && message.events) {
+        events.push(...message.events);
+      }
+    });
+
+    agentPort = agent.startRelayAgent(
+      windows.slice(1).map(window => window.pid),
+      {host: '127.0.0.1'},
+    );
+    expect(agentPort).toBeGreaterThan(0);
+    await restartRelay();
+  });
+
+  afterAll(() => {
+    master?.stopSyncRelay();
+    agent?.stopRelayAgent();
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('replays clicks and keys at the same relative spot on every slave', async () => {
+    const [origin] = windows;
+    expect(master.relayMouseEvent(origin.x + 50, origin.y + 40, 'mousedown')).toBe(true);
+    expect(master.relayMouseEvent(origin.x + 50, origin.y + 40, 'mouseup')).toBe(true);
+    // X keycode 38 is 'a' under the default keymap
+    expect(master.relayKeyboardEvent(38, 'keydown')).toBe(true);
+    expect(master.relayKeyboardEvent(38, 'keyup')).toBe(true);
+
+    const delivered = () => SCALES.every((_, s) => received(s + 1, KEY_RELEASE).length === 1);
+    expect(await waitFor(delivered, 5_000)).toBe(true);
+
+    expect(received(0, BUTTON_PRESS)).toHaveLength(0);
+    SCALES.forEach((scale, s) => {
+      const presses = received(s + 1, BUTTON_PRESS);
+      expect(presses).toHaveLength(1);
+      expect(presses[0].slice(2, 4)).toEqual([50 * scale, 40 * scale]);
+      expect(received(s + 1, BUTTON_RELEASE)).toHaveLength(1);
+      expect(received(s + 1, KEY_PRESS)).toHaveLength(1);
+    });
+
+    const acked = () => link().acked === master.getSyncRelayStats().posted;
+    expect(await waitFor(acked, 5_000)).toBe(true);
+    const stats = link();
+    expect(stats).toMatchObject({events: 4, coalesced: 0, dropped: 0, inflight: 0});
+    expect(stats.avgRttUs).toBeGreaterThan(0);
+    expect(stats.avgRttUs).toBeGreaterThanOrEqual(stats.avgApplyUs);
+
+    const agentStats = agent.getRelayAgentStats();
+    expect(agentStats).toMatchObject({connections: 1, events: 4, injected: 4 * SCALES.length, missed: 0, gaps: 0});
+    expect(agentStats.malformed).toBe(0);
+  });
+
+  test('accounts for every move under backpressure and ends at the last one', async () => {
+    const [origin] = windows;
+    const before = link();
+    const postedBefore = master.getSyncRelayStats().posted;
+    const moves = 5_000;
+    for (let i = 0; i < moves; i++) {
+      master.relayMouseEvent(origin.x + (i % MASTER_WIDTH), origin.y + 50, 'mousemove');
+    }
+    const posted = master.getSyncRelayStats().posted - postedBefore;
+    expect(posted).toBeGreaterThan(0);
+
+    // Every move is sent, coalesced or dropped, and the agent has what was sent
+    const handled = (stats: RelayAgentLinkStats) =>
+      stats.events - before.events + stats.coalesced - before.coalesced + stats.dropped - before.dropped;
+    const settled = () => handled(link()) === posted && agent.getRelayAgentStats().events === link().events;
+    expect(await waitFor(settled, 10_000)).toBe(true);
+    const stats = link();
+    expect(stats.connects).toBe(1);
+    // Moves left out under backpressure are the agent's gaps
+    expect(agent.getRelayAgentStats().gaps).toBe(stats.coalesced + stats.dropped);
+
+    // The last move of a batch always goes out, so the slaves end up there
+    // unless the final batch was dropped outright
+    if (stats.dropped === before.dropped) {
+      const lastX = (moves - 1) % MASTER_WIDTH;
+      // Relative positions are rounded once each way
+      const atLast = () =>
+        SCALES.every((scale, s) => {
+          const last = received(s + 1, MOTION_NOTIFY).at(-1);
+          return last !== undefined && Math.abs(last[2] - lastX * scale) <= 1;
+        });
+      expect(await waitFor(atLast, 5_000)).toBe(true);
+    }
+  });
+
+  test('always delivers button and key transitions under backpressure', async () => {
+    const [origin] = windows;
+    await restartRelay({maxInflight: 2, queueCapacity: 1 << 16});
+    const codes = [BUTTON_PRESS, BUTTON_RELEASE, KEY_PRESS, KEY_RELEASE];
+    const counts = () => SCALES.map((_, s) => codes.map(code => received(s + 1, code).length));
+    const before = counts();
+
+    const rounds = 20;
+    const sweep = () => {
+      for (let i = 0; i < 300; i++) {
+        master.relayMouseEvent(origin.x + (i % MASTER_WIDTH), origin.y + 50, 'mousemove');
+      }
+    };
+    for (let round = 0; round < rounds; round++) {
+      sweep();
+      expect(master.relayMouseEvent(origin.x + 10, origin.y + 20, 'mousedown')).toBe(true);
+      sweep();
+      expect(master.relayMouseEvent(origin.x + 10, origin.y + 20, 'mouseup')).toBe(true);
+      expect(master.relayKeyboardEvent(38, 'keydown')).toBe(true);
+      expect(master.relayKeyboardEvent(38, 'keyup')).toBe(true);
+    }
+
+    const expected = before.map(slave => slave.map(count => count + rounds));
+    expect(await waitFor(() => JSON.stringify(counts()) === JSON.stringify(expected), 10_000)).toBe(true);
+    // Only moves give way, and never by dropping the link
+    expect(link().connects).toBe(1);
+  });
+
+  test('releases what a lost master left held', async () => {
+    const [origin] = windows;
+    await restartRelay();
+    const {released: releasedBefore, events: eventsBefore} = agent.getRelayAgentStats();
+    const count = (s: number, code: number) => received(s + 1, code).length;
+    const before = SCALES.map((_, s) => [count(s, BUTTON_RELEASE), count(s, KEY_RELEASE)]);
+
+    master.relayMouseEvent(origin.x + 30, origin.y + 30, 'mousedown');
+    master.relayKeyboardEvent(38, 'keydown');
+    expect(await waitFor(() => agent.getRelayAgentStats().events === eventsBefore + 2, 5_000)).toBe(true);
+    master.stopSyncRelay();
+
+    const released = () =>
+      SCALES.every((_, s) => count(s, BUTTON_RELEASE) > before[s][0] && count(s, KEY_RELEASE) > before[s][1]);
+    expect(await waitFor(released, 5_000)).toBe(true);
+    expect(agent.getRelayAgentStats().released - releasedBefore).toBe(2);
+    SCALES.forEach((scale, s) => {
+      expect(received(s + 1, BUTTON_RELEASE).at(-1)!.slice(2, 4)).toEqual([30 * scale, 30 * scale]);
+    });
+    await restartRelay();
+  });
+});
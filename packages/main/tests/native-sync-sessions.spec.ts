@@ -0,0 +1,329 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {cpus} from 'node:os';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientEvent, ClientMessage, StandInWindow, XvfbServer} from './fixtures/xvfb';
+import {hasCommand, sleep, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Concurrent sync sessions under Xvfb. Every group is a master window with
+ * slaves twice its size, all stand-ins created by fixtures/x11-test-client.cjs,
+ * and each group runs in its own native session.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const GROUPS = 4;
+const SLAVES = 3;
+const MASTER_WIDTH = 200;
+const MASTER_HEIGHT = 100;
+
+const KEY_PRESS = 2;
+const KEY_RELEASE = 3;
+const BUTTON_PRESS = 4;
+const BUTTON_RELEASE = 5;
+const MOTION_NOTIFY = 6;
+const CLIENT_MESSAGE = 33;
+
+interface SyncSessionStats {
+  worker: number;
+  workers: number;
+  slaves: number;
+  posted: number;
+  coalesced: number;
+  dropped: number;
+  dispatched: number;
+  injected: number;
+  missed: number;
+  boundsRefreshes: number;
+  avgLatencyUs: number;
+  maxLatencyUs: number;
+  sequence: number;
+  confirmed: number;
+  barriers: number;
+  stragglers: number;
+  avgBarrierUs: number;
+  maxBarrierUs: number;
+}
+
+interface SyncBarrierResult {
+  sequence: number;
+  reached: boolean;
+  stragglers: number[];
+}
+
+interface SessionManager {
+  createSyncSession(
+    masterPid: number,
+    slavePids: number[],
+    options?: {queueCapacity?: number; lockstep?: boolean; barrierTimeoutMs?: number},
+  ): number | null;
+  postSyncMouseEvent(id: number, x: number, y: number, type: string): boolean;
+  postSyncKeyEvent(id: number, keyCode: number, type: string): boolean;
+  waitSyncBarrier(id: number, timeoutMs?: number): Promise<SyncBarrierResult | null>;
+  destroySyncSession(id: number): boolean;
+  getSyncSessionStats(id: number): SyncSessionStats | null;
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('sync sessions under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: SessionManager;
+  const owners: ChildProcess[] = [];
+  // groups[g] = [master, ...slaves]
+  const groups: StandInWindow[][] = [];
+  const events: ClientEvent[] = [];
+  const sessions: number[] = [];
+
+  const windowIndex = (group: number, member: number) => group * (SLAVES + 1) + member;
+  const received = (group: number, member: number, code: number) =>
+    events.filter(event => event[0] === windowIndex(group, member) && event[1] === code);
+
+  beforeAll(async () => {
+    xvfb = await startXvfb();
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(GROUPS * (SLAVES + 1)));
+    for (let g = 0; g < GROUPS; g++) {
+      const group: StandInWindow[] = [];
+      for (let m = 0; m <= SLAVES; m++) {
+        const owner = owners[g * (SLAVES + 1) + m];
+        const scale = m === 0 ? 1 : 2;
+        group.push({
+          pid: owner.pid as number,
+          x: g * 450,
+          y: m === 0 ? 0 : 120 + (m - 1) * 220,
+          width: MASTER_WIDTH * scale,
+          height: MASTER_HEIGHT * scale,
+        });
+      }
+      groups.push(group);
+    }
+
+    client = await startStandIns(display, groups.flat(), (message: ClientMessage) => {
+      if (message.type === 'events' && message.events) {
+        events.push(...message.events);
+      }
+    });
+  });
+
+  afterAll(() => {
+    for (const id of sessions) {
+      manager?.destroySyncSession(id);
+    }
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('maps each master onto the slaves of its own session', async () => {
+    for (const [master, ...slaves] of groups) {
+      const id = manager.createSyncSession(master.pid, slaves.map(slave => slave.pid));
+      expect(id).toBeGreaterThan(0);
+      sessions.push(id as number);
+    }
+
+    // A different spot per group, so a crossed session would show
+    groups.forEach(([master], g) => {
+      const x = master.x + 20 + g * 10;
+      const y = master.y + 30;
+      expect(manager.postSyncMouseEvent(sessions[g], x, y, 'mousedown')).toBe(true);
+      expect(manager.postSyncMouseEvent(sessions[g], x, y, 'mouseup')).toBe(true);
+    });
+
+    const delivered = () =>
+      groups.every((_, g) =>
+        Array.from({length: SLAVES}, (__, s) => received(g, s + 1, BUTTON_RELEASE).length).every(n => n === 1),
+      );
+    expect(await waitFor(delivered, 5_000)).toBe(true);
+
+    for (let g = 0; g < GROUPS; g++) {
+      expect(received(g, 0, BUTTON_PRESS)).toHaveLength(0);
+      for (let s = 1; s <= SLAVES; s++) {
+        const presses = received(g, s, BUTTON_PRESS);
+        expect(presses).toHaveLength(1);
+        // Slaves are twice the master's size
+        expect(presses[0].slice(2, 4)).toEqual([(20 + g * 10) * 2, 60]);
+      }
+
+      const stats = manager.getSyncSessionStats(sessions[g]) as SyncSessionStats;
+      expect(stats).toMatchObject({slaves: SLAVES, posted: 2, dispatched: 2, injected: 2 * SLAVES, missed: 0});
+      expect(stats.maxLatencyUs).toBeGreaterThan(0);
+    }
+
+    // One worker per session while there are cores for it
+    const workers = new Set(sessions.map(id => manager.getSyncSessionStats(id)?.worker));
+    expect(workers.size).toBe(Math.min(GROUPS, cpus().length));
+  });
+
+  test('replays keys on the slaves of its own session', async () => {
+    const id = sessions[1];
+    // X keycode 38 is 'a' under the default keymap
+    expect(manager.postSyncKeyEvent(id, 38, 'keydown')).toBe(true);
+    expect(manager.postSyncKeyEvent(id, 38, 'keyup')).toBe(true);
+    expect(manager.postSyncKeyEvent(id, 38, 'keypress')).toBe(false);
+    expect(manager.postSyncKeyEvent(id, -1, 'keydown')).toBe(false);
+
+    const delivered = () =>
+      Array.from({length: SLAVES}, (_, s) => received(1, s + 1, KEY_RELEASE).length).every(n => n === 1);
+    expect(await waitFor(delivered, 5_000)).toBe(true);
+    for (let s = 1; s <= SLAVES; s++) {
+      expect(received(1, s, KEY_PRESS)).toHaveLength(1);
+    }
+    // Only the session's own slaves
+    expect(received(1, 0, KEY_PRESS)).toHaveLength(0);
+    expect(received(0, 1, KEY_PRESS)).toHaveLength(0);
+    expect(manager.getSyncSessionStats(id)).toMatchObject({posted: 4, dispatched: 4, missed: 0});
+  });
+
+  test('coalesces moves that queue up behind the worker', async () => {
+    const [master] = groups[0];
+    const moves = 2_000;
+    for (let i = 0; i < moves; i++) {
+      manager.postSyncMouseEvent(sessions[0], master.x + (i % MASTER_WIDTH), master.y + 50, 'mousemove');
+    }
+
+    const settled = () => {
+      const stats = manager.getSyncSessionStats(sessions[0]) as SyncSessionStats;
+      return stats.dispatched + stats.coalesced === stats.posted;
+    };
+    expect(await waitFor(settled, 5_000)).toBe(true);
+    const stats = manager.getSyncSessionStats(sessions[0]) as SyncSessionStats;
+    expect(stats.dropped).toBe(0);
+    expect(stats.posted).toBe(2 + moves);
+
+    // Every slave ends up at the last position
+    const lastX = ((moves - 1) % MASTER_WIDTH) * 2;
+    const atLast = () =>
+      [1, 2, 3].every(s => {
+        const motions = received(0, s, MOTION_NOTIFY);
+        return motions.length > 0 && motions[motions.length - 1][2] === lastX;
+      });
+    expect(await waitFor(atLast, 5_000)).toBe(true);
+  });
+
+  test('drops events past the queue capacity', async () => {
+    const [master, ...slaves] = groups[1];
+    const id = manager.createSyncSession(master.pid, slaves.map(slave => slave.pid), {queueCapacity: 4}) as number;
+    sessions.push(id);
+
+    let accepted = 0;
+    for (let i = 0; i < 200; i++) {
+      const type = i % 2 ? 'mouseup' : 'mousedown';
+      accepted += manager.postSyncMouseEvent(id, master.x + 10, master.y + 10, type) ? 1 : 0;
+    }
+    const stats = () => manager.getSyncSessionStats(id) as SyncSessionStats;
+    expect(await waitFor(() => stats().dispatched === accepted, 5_000)).toBe(true);
+    expect(stats().dropped).toBe(200 - accepted);
+    expect(accepted).toBeGreaterThanOrEqual(4);
+  });
+
+  test('stops delivery once a session is destroyed', async () => {
+    const id = sessions[2];
+    expect(manager.destroySyncSession(id)).toBe(true);
+    expect(manager.destroySyncSession(id)).toBe(false);
+    expect(manager.getSyncSessionStats(id)).toBeNull();
+
+    const [master] = groups[2];
+    const before = received(2, 1, BUTTON_PRESS).length;
+    expect(manager.postSyncMouseEvent(id, master.x + 10, master.y + 10, 'mousedown')).toBe(false);
+    await sleep(200);
+    expect(received(2, 1, BUTTON_PRESS)).toHaveLength(before);
+
+    // The other sessions carry on
+    const [otherMaster] = groups[3];
+    expect(manager.postSyncMouseEvent(sessions[3], otherMaster.x + 5, otherMaster.y + 5, 'mousedown')).toBe(true);
+    expect(await waitFor(() => received(3, 1, BUTTON_PRESS).length === 2, 2_000)).toBe(true);
+  });
+
+  test('lockstep releases each event once every slave answered the last', async () => {
+    const [master, ...slaves] = groups[3];
+    const id = manager.createSyncSession(master.pid, slaves.map(slave => slave.pid), {lockstep: true}) as number;
+    sessions.push(id);
+    const start = events.length;
+
+    expect(manager.postSyncMouseEvent(id, master.x + 10, master.y + 10, 'mousedown')).toBe(true);
+    expect(manager.postSyncMouseEvent(id, master.x + 10, master.y + 10, 'mouseup')).toBe(true);
+    expect(await manager.waitSyncBarrier(id)).toEqual({sequence: 2, reached: true, stragglers: []});
+
+    // Every slave saw each event followed by its ping before the next event
+    await sleep(100);
+    for (let s = 1; s <= SLAVES; s++) {
+      const codes = events
+        .slice(start)
+        .filter(event => event[0] === windowIndex(3, s))
+        .map(event => event[1]);
+      expect(codes).toEqual([BUTTON_PRESS, CLIENT_MESSAGE, BUTTON_RELEASE, CLIENT_MESSAGE]);
+    }
+    expect(manager.getSyncSessionStats(id)).toMatchObject({sequence: 2, confirmed: 2, barriers: 2, stragglers: 0});
+  });
+
+  test('lockstep moves on without slaves that do not answer', async () => {
+    const [master, ...slaves] = groups[3];
+    const id = manager.createSyncSession(master.pid, slaves.map(slave => slave.pid), {
+      lockstep: true,
+      barrierTimeoutMs: 100,
+    }) as number;
+    sessions.push(id);
+    client.send({type: 'pingDelay', index: windowIndex(3, 2), ms: -1});
+
+    manager.postSyncMouseEvent(id, master.x + 10, master.y + 10, 'mousedown');
+    manager.postSyncMouseEvent(id, master.x + 10, master.y + 10, 'mouseup');
+    const result = await manager.waitSyncBarrier(id);
+    client.send({type: 'pingDelay', index: windowIndex(3, 2), ms: 0});
+
+    expect(result).toEqual({sequence: 2, reached: true, stragglers: [slaves[1].pid]});
+    const stats = manager.getSyncSessionStats(id) as SyncSessionStats;
+    expect(stats).toMatchObject({barriers: 2, stragglers: 2, injected: 2 * SLAVES});
+    expect(stats.maxBarrierUs).toBeGreaterThanOrEqual(100_000);
+    expect(await manager.waitSyncBarrier(12345)).toBeNull();
+  });
+
+  test('a lockstep session waiting for answers does not hold up its worker', async () => {
+    const [master, ...slaves] = groups[0];
+    const lockstep = manager.createSyncSession(master.pid, slaves.map(slave => slave.pid), {
+      lockstep: true,
+      barrierTimeoutMs: 2_000,
+    }) as number;
+    sessions.push(lockstep);
+    const worker = manager.getSyncSessionStats(lockstep)?.worker;
+
+    // Another session on the same worker
+    const [otherMaster, ...otherSlaves] = groups[1];
+    let other = 0;
+    for (let i = 0; i <= cpus().length && !other; i++) {
+      const id = manager.createSyncSession(otherMaster.pid, otherSlaves.map(slave => slave.pid)) as number;
+      sessions.push(id);
+      if (manager.getSyncSessionStats(id)?.worker === worker) {
+        other = id;
+      }
+    }
+    expect(other).toBeGreaterThan(0);
+
+    client.send({type: 'pingDelay', index: windowIndex(0, 1), ms: 500});
+    const presses = received(1, 1, BUTTON_PRESS).length;
+    expect(manager.postSyncMouseEvent(lockstep, master.x + 10, master.y + 10, 'mousedown')).toBe(true);
+    const barrier = manager.waitSyncBarrier(lockstep);
+    await sleep(50);
+    expect(manager.postSyncMouseEvent(other, otherMaster.x + 10, otherMaster.y + 10, 'mousedown')).toBe(true);
+
+    // Delivered while the lockstep event still waits for its slowest slave
+    expect(await waitFor(() => received(1, 1, BUTTON_PRESS).length === presses + 1, 300)).toBe(true);
+    expect(manager.getSyncSessionStats(lockstep)?.confirmed).toBe(0);
+
+    expect(await barrier).toEqual({sequence: 1, reached: true, stragglers: []});
+    client.send({type: 'pingDelay', index: windowIndex(0, 1), ms: 0});
+    expect(manager.getSyncSessionStats(lockstep)?.maxBarrierUs).toBeGreaterThanOrEqual(450_000);
+  });
+});
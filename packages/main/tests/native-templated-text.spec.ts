@@ -0,0 +1,150 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * broadcastTemplatedText: the split of the column everywhere, and under
+ * Xvfb the text each stand-in window from fixtures/x11-test-client.cjs
+ * reads from the key events it was sent.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface TemplatedTextResult {
+  typed: number[];
+  characters: number[];
+  elapsedMs: number;
+}
+
+interface TemplatedTextManager {
+  broadcastTemplatedText(
+    slavePids: number[],
+    text: Uint8Array,
+    offsets: Uint32Array | number[],
+    options?: {charDelayMs?: number},
+  ): Promise<TemplatedTextResult>;
+}
+
+// One UTF-8 buffer and the offsets of each string in it
+function toColumn(strings: string[]): {text: Uint8Array; offsets: Uint32Array} {
+  const encoder = new TextEncoder();
+  const encoded = strings.map(value => encoder.encode(value));
+  const offsets = new Uint32Array(strings.length + 1);
+  encoded.forEach((bytes, i) => (offsets[i + 1] = offsets[i] + bytes.length));
+  const text = new Uint8Array(offsets[strings.length]);
+  encoded.forEach((bytes, i) => text.set(bytes, offsets[i]));
+  return {text, offsets};
+}
+
+const enabled = existsSync(ADDON_PATH);
+const xvfbEnabled = process.platform === 'linux' && enabled && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('templated text', () => {
+  let manager: TemplatedTextManager;
+
+  beforeAll(() => {
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+  });
+
+  test('rejects malformed columns', () => {
+    const {text, offsets} = toColumn(['a', 'b']);
+    expect(() => manager.broadcastTemplatedText([1, 2], 'ab' as never, offsets)).toThrow(TypeError);
+    expect(() => manager.broadcastTemplatedText([1, 2], text, new Int32Array(3) as never)).toThrow(TypeError);
+    expect(() => manager.broadcastTemplatedText([1], text, offsets)).toThrow(RangeError);
+    expect(() => manager.broadcastTemplatedText([1, 2], text, [0, 2, 1])).toThrow(RangeError);
+    expect(() => manager.broadcastTemplatedText([1, 2], text, [0, 1, 3])).toThrow(RangeError);
+    expect(() => manager.broadcastTemplatedText([1], new Uint8Array([0xc3]), [0, 1])).toThrow(/UTF-8/);
+    expect(() => manager.broadcastTemplatedText([1, 2], text, offsets, {charDelayMs: -1})).toThrow(RangeError);
+  });
+
+  test('gives every slave its own string', async () => {
+    const strings = ['alice@example.com', '東京都', '', 'emoji 😀', 'line\nbreak'];
+    const {text, offsets} = toColumn(strings);
+    const result = await manager.broadcastTemplatedText([999_991, 999_992, 999_993, 999_994, 999_995], text, offsets);
+    expect(result.characters).toEqual(strings.map(value => [...value].length));
+    // None of these pids has a window. macOS posts to a pid without
+    // knowing whether anything receives it.
+    if (process.platform !== 'darwin') {
+      expect(result.typed).toEqual([0, 0, 0, 0, 0]);
+    }
+  });
+
+  test('takes offsets as a plain array', async () => {
+    const {text} = toColumn(['ab', 'cde']);
+    const result = await manager.broadcastTemplatedText([999_991, 999_992], text, [0, 2, 5]);
+    expect(result.characters).toEqual([2, 3]);
+  });
+});
+
+describe.skipIf(!xvfbEnabled)('templated text under Xvfb', () => {
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: TemplatedTextManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  let texts: string[] | null = null;
+
+  // Characters on the default keymap, shifted ones, and some bound on the fly
+  const strings = ['alice@example.com', 'Bob Smith', 'é東京', '', 'line\nbreak', 'emoji 😀!'];
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1280, 720);
+    const display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(strings.length));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.map((pid, i) => ({
+      pid,
+      x: (i % 3) * 400,
+      y: Math.floor(i / 3) * 300,
+      width: 300,
+      height: 200,
+    }));
+
+    client = await startStandIns(display, windows, (message: {type: string; texts?: string[]}) => {
+      if (message.type === 'text') {
+        texts = message.texts ?? null;
+      }
+    });
+  });
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('types its own string into every window', async () => {
+    const {text, offsets} = toColumn(strings);
+    const result = await manager.broadcastTemplatedText(pids, text, offsets, {charDelayMs: 5});
+    const lengths = strings.map(value => [...value].length);
+    expect(result.characters).toEqual(lengths);
+    expect(result.typed).toEqual(lengths);
+
+    client.send({type: 'text'});
+    expect(await waitFor(() => texts !== null, 5_000)).toBe(true);
+    expect(texts).toEqual(strings);
+  });
+
+  test('does not wait for typing on the JS thread', async () => {
+    const {text, offsets} = toColumn(pids.map(() => 'abc'));
+    let ticks = 0;
+    const timer = setInterval(() => ticks++, 5);
+    const result = await manager.broadcastTemplatedText(pids, text, offsets, {charDelayMs: 50});
+    clearInterval(timer);
+    expect(result.typed).toEqual(pids.map(() => 3));
+    expect(result.elapsedMs).toBeGreaterThanOrEqual(100);
+    expect(ticks).toBeGreaterThan(5);
+  });
+});
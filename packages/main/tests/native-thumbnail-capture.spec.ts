@@ -0,0 +1,233 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {Worker} from 'node:worker_threads';
+import {afterAll, afterEach, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, sleep, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * Thumbnail capture under Xvfb (XComposite, MIT-SHM and XDamage), against
+ * the white stand-in windows of fixtures/x11-test-client.cjs. The pixel
+ * maths of the downscale is covered by image-ops-test.cpp.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const WINDOW_COUNT = 100;
+const WINDOW_WIDTH = 1024;
+const WINDOW_HEIGHT = 640;
+
+// ThumbnailSlotFlags in thumbnail-capture.h
+const VALID = 1;
+const MISSING = 2;
+
+interface ThumbnailPool {
+  buffer: SharedArrayBuffer;
+  slotCount: number;
+  slotSize: number;
+  headerSize: number;
+  width: number;
+  height: number;
+}
+
+interface ThumbnailStats {
+  running: boolean;
+  cycles: number;
+  framesCaptured: number;
+  framesSkipped: number;
+  captureErrors: number;
+  lastCycleMs: number;
+  damageTracking: boolean;
+}
+
+interface CapturingManager {
+  startThumbnailCapture(
+    pids: number[],
+    options?: {width?: number; height?: number; intervalMs?: number; maxAgeMs?: number; slots?: number},
+  ): ThumbnailPool;
+  refreshThumbnails(): void;
+  stopThumbnailCapture(): void;
+  getThumbnailStats(): ThumbnailStats;
+}
+
+interface Slot {
+  sequence: number;
+  pid: number;
+  width: number;
+  height: number;
+  stride: number;
+  flags: number;
+  sourceWidth: number;
+  sourceHeight: number;
+  pixels: Uint32Array;
+}
+
+// Consistent copy of a slot, retried while the capture thread writes it
+function readSlot(pool: ThumbnailPool, index: number): Slot {
+  const header = new Uint32Array(pool.buffer, index * pool.slotSize, 8);
+  for (;;) {
+    const sequence = header[0];
+    if (sequence % 2 === 1) {
+      continue;
+    }
+    const start = index * pool.slotSize + pool.headerSize;
+    const pixels = new Uint32Array(pool.buffer.slice(start, start + pool.width * pool.height * 4));
+    const [, pid, width, height, stride, flags, sourceWidth, sourceHeight] = header;
+    if (header[0] === sequence) {
+      return {sequence, pid, width, height, stride, flags, sourceWidth, sourceHeight, pixels};
+    }
+  }
+}
+
+// Waits until slot 0 has been written again and answers with its pid
+const WORKER_SOURCE = `
+const {parentPort} = require('node:worker_threads');
+parentPort.once('message', buffer => {
+  const header = new Uint32Array(buffer, 0, 8);
+  const first = header[0];
+  parentPort.postMessage('started');
+  const poll = () => {
+    if (header[0] !== first && header[0] % 2 === 0) {
+      parentPort.postMessage(header[1]);
+    } else {
+      setTimeout(poll, 5);
+    }
+  };
+  poll();
+});
+`;
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('thumbnail capture under Xvfb', () => {
+  let xvfb: XvfbServer;
+  let client: ChildProcess | undefined;
+  let manager: CapturingManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1920, 1080);
+    const display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(WINDOW_COUNT + 1));
+    pids = owners.map(owner => owner.pid as number);
+    // The last owner gets no window
+    const windows = pids.slice(0, WINDOW_COUNT).map((pid, i) => ({
+      pid,
+      x: (i % 10) * 80,
+      y: Math.floor(i / 10) * 40,
+      width: WINDOW_WIDTH,
+      height: WINDOW_HEIGHT,
+    }));
+
+    client = await startStandIns(display, windows);
+  }, 30_000);
+
+  afterEach(() => {
+    manager?.stopThumbnailCapture();
+  });
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('writes a downscaled frame of each window into its slot', async () => {
+    const pool = manager.startThumbnailCapture(pids, {width: 160, height: 100, intervalMs: 50});
+    expect(pool.slotCount).toBe(pids.length);
+    expect(pool.buffer.byteLength).toBe(pool.slotCount * pool.slotSize);
+
+    const settled = () =>
+      pids.every((_, i) => (readSlot(pool, i).flags & (i < WINDOW_COUNT ? VALID : MISSING)) !== 0);
+    expect(await waitFor(settled, 10_000)).toBe(true);
+
+    for (let i = 0; i < WINDOW_COUNT; i++) {
+      const slot = readSlot(pool, i);
+      expect(slot).toMatchObject({pid: pids[i], width: 160, height: 100, stride: 640, flags: VALID});
+      expect([slot.sourceWidth, slot.sourceHeight]).toEqual([WINDOW_WIDTH, WINDOW_HEIGHT]);
+      // White, opaque
+      expect(slot.pixels.every(pixel => pixel === 0xffffffff)).toBe(true);
+    }
+    expect(readSlot(pool, WINDOW_COUNT)).toMatchObject({pid: pids[WINDOW_COUNT], flags: MISSING});
+    expect(manager.getThumbnailStats().captureErrors).toBe(0);
+  });
+
+  // The capture thread keeps writing into the pool whatever JS does with it
+  test('shares the pool with workers rather than letting it be detached', async () => {
+    const pool = manager.startThumbnailCapture(pids.slice(0, 1), {width: 160, height: 100, intervalMs: 20});
+    expect(await waitFor(() => (readSlot(pool, 0).flags & VALID) !== 0, 10_000)).toBe(true);
+    expect(() => structuredClone(pool.buffer, {transfer: [pool.buffer as unknown as ArrayBuffer]})).toThrow();
+    expect(pool.buffer.byteLength).toBe(pool.slotSize);
+
+    const worker = new Worker(WORKER_SOURCE, {eval: true});
+    try {
+      const messages: unknown[] = [];
+      worker.on('message', message => messages.push(message));
+      worker.postMessage(pool.buffer);
+      expect(await waitFor(() => messages.length === 1, 5_000)).toBe(true);
+      manager.refreshThumbnails();
+      expect(await waitFor(() => messages.length === 2, 5_000)).toBe(true);
+      expect(messages[1]).toBe(pids[0]);
+    } finally {
+      await worker.terminate();
+    }
+    expect(readSlot(pool, 0).flags & VALID).toBe(VALID);
+  });
+
+  test('captures only damaged windows until a refresh is asked for', async () => {
+    const targets = pids.slice(0, WINDOW_COUNT);
+    manager.startThumbnailCapture(targets, {width: 160, height: 100, intervalMs: 20});
+    expect(await waitFor(() => manager.getThumbnailStats().framesCaptured >= WINDOW_COUNT, 10_000)).toBe(true);
+    expect(manager.getThumbnailStats().damageTracking).toBe(true);
+
+    // Nothing is drawn into the windows once the damage of their first
+    // capture has been collected
+    await sleep(200);
+    const before = manager.getThumbnailStats();
+    await sleep(300);
+    const idle = manager.getThumbnailStats();
+    expect(idle.cycles).toBeGreaterThan(before.cycles + 5);
+    expect(idle.framesCaptured).toBe(before.framesCaptured);
+    expect(idle.framesSkipped).toBeGreaterThanOrEqual(before.framesSkipped + 5 * WINDOW_COUNT);
+
+    manager.refreshThumbnails();
+    expect(
+      await waitFor(() => manager.getThumbnailStats().framesCaptured >= idle.framesCaptured + WINDOW_COUNT, 5_000),
+    ).toBe(true);
+  });
+
+  // The target the capture engine was built for: every one of 100 windows
+  // re-captured each cycle at the default interval, within one core
+  test('keeps up with 100 windows on less than one core', async () => {
+    const intervalMs = 500;
+    const targets = pids.slice(0, WINDOW_COUNT);
+    // A maxAgeMs below the interval re-captures every window on every cycle
+    manager.startThumbnailCapture(targets, {width: 320, height: 200, intervalMs, maxAgeMs: 1});
+    expect(await waitFor(() => manager.getThumbnailStats().cycles >= 2, 10_000)).toBe(true);
+
+    const before = manager.getThumbnailStats();
+    const cpuBefore = process.cpuUsage();
+    const wallBefore = process.hrtime.bigint();
+    await sleep(4 * intervalMs);
+    const cpu = process.cpuUsage(cpuBefore);
+    const wallUs = Number(process.hrtime.bigint() - wallBefore) / 1000;
+    const after = manager.getThumbnailStats();
+
+    const cycles = after.cycles - before.cycles;
+    expect(cycles).toBeGreaterThanOrEqual(3);
+    expect(after.framesCaptured - before.framesCaptured).toBeGreaterThanOrEqual(cycles * WINDOW_COUNT);
+    expect(after.captureErrors).toBe(0);
+    expect(after.lastCycleMs).toBeLessThan(intervalMs);
+    expect((cpu.user + cpu.system) / wallUs).toBeLessThan(1);
+  }, 20_000);
+});
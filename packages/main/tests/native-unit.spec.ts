@@ -0,0 +1,45 @@
+import {spawnSync} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {join} from 'node:path';
+import {describe, expect, test} from 'vitest';
+
+/**
+ * The native unit tests (src/native-addon/*-test.cpp), run through the
+ * native-tests executable. Each case prints "ok <name>" or
+ * "fail <name>: <file>:<line>: <condition>".
+ */
+
+const TESTS_PATH = join(__dirname, '../src/native-addon/build/Release/native-tests');
+
+const enabled = process.platform === 'linux' && existsSync(TESTS_PATH);
+
+function run(): Map<string, string[]> {
+  const results = new Map<string, string[]>();
+  if (!enabled) {
+    return results;
+  }
+  const {stdout} = spawnSync(TESTS_PATH, [], {encoding: 'utf8', timeout: 60_000});
+  for (const line of stdout.split('\n')) {
+    const match = /^(ok|fail) ([^:\s]+)(?:: (.*))?$/.exec(line);
+    if (match) {
+      const failures = results.get(match[2]) ?? [];
+      if (match[1] === 'fail') {
+        failures.push(match[3]);
+      }
+      results.set(match[2], failures);
+    }
+  }
+  return results;
+}
+
+const results = run();
+
+describe.skipIf(!enabled)('native unit tests', () => {
+  test('runs every case', () => {
+    expect(results.size).toBeGreaterThan(0);
+  });
+
+  test.each([...results.keys()])('%s', name => {
+    expect(results.get(name)).toEqual([]);
+  });
+});
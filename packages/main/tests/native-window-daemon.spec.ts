@@ -0,0 +1,298 @@
+import type {ChildProcess} from 'node:child_process';
+import {spawn} from 'node:child_process';
+import {existsSync, mkdtempSync, rmSync} from 'node:fs';
+import {createConnection} from 'node:net';
+import type {Socket} from 'node:net';
+import {tmpdir} from 'node:os';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {ClientEvent, ClientMessage, XvfbServer} from './fixtures/xvfb';
+import {hasCommand, sleep, spawnOwners, startStandIns, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * The window-daemon control socket under Xvfb, against stand-in windows
+ * created by fixtures/x11-test-client.cjs. Frames are built by hand here so
+ * split, pipelined, malformed and oversized input can be sent as is; the
+ * wire format is described in src/native-addon/control-protocol.h.
+ */
+
+const DAEMON_PATH = join(__dirname, '../src/native-addon/build/Release/window-daemon');
+
+const enum Opcode {
+  Ping = 0,
+  ListWindows = 1,
+  PointerEvent = 4,
+  KeyEvent = 7,
+}
+
+const enum Status {
+  Ok = 0,
+  UnknownOpcode = 1,
+  Malformed = 2,
+}
+
+// Matches kMaxControlFrame in control-protocol.h
+const MAX_FRAME = 1 << 20;
+// X keycode of 'a' under the default keymap
+const KEY_CODE = 38;
+
+const KEY_PRESS = 2;
+const KEY_RELEASE = 3;
+const BUTTON_PRESS = 4;
+
+interface Response {
+  id: number;
+  status: number;
+  body: Buffer;
+}
+
+function frame(id: number, opcode: number, body: Buffer = Buffer.alloc(0)): Buffer {
+  const bytes = Buffer.alloc(9 + body.length);
+  bytes.writeUInt32LE(5 + body.length, 0);
+  bytes.writeUInt32LE(id, 4);
+  bytes.writeUInt8(opcode, 8);
+  body.copy(bytes, 9);
+  return bytes;
+}
+
+function i32s(...values: number[]): Buffer {
+  const bytes = Buffer.alloc(values.length * 4);
+  values.forEach((value, i) => bytes.writeInt32LE(value, i * 4));
+  return bytes;
+}
+
+function pointerBody(pid: number, x: number, y: number, event: number): Buffer {
+  return Buffer.concat([i32s(pid, x, y), Buffer.from([event])]);
+}
+
+function keyBody(pid: number, keyCode: number, event: number, x = -1, y = -1): Buffer {
+  return Buffer.concat([i32s(pid), Buffer.from([keyCode, event]), i32s(x, y)]);
+}
+
+// A connection that collects every response frame
+class Connection {
+  readonly responses: Response[] = [];
+  closed = false;
+  private buffer = Buffer.alloc(0);
+
+  constructor(readonly socket: Socket) {
+    socket.on('data', chunk => {
+      this.buffer = Buffer.concat([this.buffer, chunk]);
+      while (this.buffer.length >= 4) {
+        const length = this.buffer.readUInt32LE(0);
+        if (this.buffer.length < 4 + length) {
+          break;
+        }
+        const payload = this.buffer.subarray(4, 4 + length);
+        this.responses.push({id: payload.readUInt32LE(0), status: payload.readUInt8(4), body: payload.subarray(5)});
+        this.buffer = this.buffer.subarray(4 + length);
+      }
+    });
+    socket.on('close', () => (this.closed = true));
+    socket.on('error', () => (this.closed = true));
+  }
+
+  static open(path: string): Promise<Connection> {
+    return new Promise((resolve, reject) => {
+      const socket = createConnection(path);
+      socket.once('connect', () => resolve(new Connection(socket)));
+      socket.once('error', reject);
+    });
+  }
+
+  async receive(count: number, timeoutMs = 5_000): Promise<Response[]> {
+    expect(await waitFor(() => this.responses.length >= count, timeoutMs)).toBe(true);
+    return this.responses.splice(0, count);
+  }
+}
+
+const enabled = process.platform === 'linux' && existsSync(DAEMON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('window-daemon under Xvfb', () => {
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let daemon: ChildProcess;
+  let socketDir: string;
+  let socketPath: string;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+  const events: ClientEvent[] = [];
+  const connections: Connection[] = [];
+
+  const received = (index: number, code: number) => events.filter(event => event[0] === index && event[1] === code);
+
+  async function connect(): Promise<Connection> {
+    const connection = await Connection.open(socketPath);
+    connections.push(connection);
+    return connection;
+  }
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1280, 720);
+    const display = xvfb.display;
+
+    owners.push(...spawnOwners(2));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.map((pid, i) => ({pid, x: i * 400, y: 0, width: 300, height: 200}));
+
+    client = await startStandIns(display, windows, (message: ClientMessage) => {
+      if (message.type === 'events' && message.events) {
+        events.push(...message.events);
+      }
+    });
+
+    socketDir = mkdtempSync(join(tmpdir(), 'window-daemon-'));
+    socketPath = join(socketDir, 'control.sock');
+    daemon = spawn(DAEMON_PATH, ['--socket', socketPath], {
+      env: {...process.env, DISPLAY: `:${display}`},
+      stdio: ['ignore', 'pipe', 'ignore'],
+    });
+    let output = '';
+    daemon.stdout?.on('data', (chunk: Buffer) => (output += chunk.toString()));
+    expect(await waitFor(() => output.includes('Listening on'), 10_000)).toBe(true);
+  });
+
+  afterAll(() => {
+    for (const connection of connections) {
+      connection.socket.destroy();
+    }
+    daemon?.kill();
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+    if (socketDir) {
+      rmSync(socketDir, {recursive: true, force: true});
+    }
+  });
+
+  test('answers pipelined requests in order, whatever the framing', async () => {
+    const connection = await connect();
+    const listBody = Buffer.concat([Buffer.from([2, 0]), i32s(pids[0], pids[1])]);
+    const requests = Buffer.concat([
+      frame(1, Opcode.Ping),
+      frame(2, Opcode.ListWindows, listBody),
+      frame(3, Opcode.Ping),
+      frame(0xfffffffe, Opcode.Ping),
+    ]);
+
+    // All at once, then a byte at a time
+    connection.socket.write(requests);
+    const together = await connection.receive(4);
+    for (const byte of requests) {
+      connection.socket.write(Buffer.from([byte]));
+      await sleep(1);
+    }
+    const split = await connection.receive(4);
+
+    for (const responses of [together, split]) {
+      expect(responses.map(response => response.id)).toEqual([1, 2, 3, 0xfffffffe]);
+      expect(responses.every(response => response.status === Status.Ok)).toBe(true);
+      const list = responses[1].body;
+      // One window per pid: u16 count, then window, isExtension and bounds
+      expect(list.readUInt16LE(0)).toBe(1);
+      expect(list.readInt32LE(2 + 4 + 1)).toBe(0);
+      expect(list.readUInt16LE(2 + 21)).toBe(1);
+      expect(list.readInt32LE(2 + 21 + 2 + 4 + 1)).toBe(400);
+    }
+  });
+
+  test('injects pointer and key events into the window of each pid', async () => {
+    const connection = await connect();
+    const presses = [0, 1].map(i => received(i, BUTTON_PRESS).length);
+    const keys = [0, 1].map(i => received(i, KEY_PRESS).length);
+
+    connection.socket.write(
+      Buffer.concat([
+        frame(10, Opcode.PointerEvent, pointerBody(pids[0], 50, 60, 1)),
+        frame(11, Opcode.KeyEvent, keyBody(pids[1], KEY_CODE, 0)),
+        frame(12, Opcode.KeyEvent, keyBody(pids[1], KEY_CODE, 1, 450, 50)),
+        // No window for this pid
+        frame(13, Opcode.KeyEvent, keyBody(999_999, KEY_CODE, 0)),
+      ]),
+    );
+    const responses = await connection.receive(4);
+    expect(responses.map(response => [response.id, response.status, response.body.readUInt8(0)])).toEqual([
+      [10, Status.Ok, 1],
+      [11, Status.Ok, 1],
+      [12, Status.Ok, 1],
+      [13, Status.Ok, 0],
+    ]);
+
+    expect(await waitFor(() => received(1, KEY_RELEASE).length > 0, 2_000)).toBe(true);
+    expect(received(0, BUTTON_PRESS)).toHaveLength(presses[0] + 1);
+    expect(received(0, BUTTON_PRESS).at(-1)?.slice(2, 4)).toEqual([50, 60]);
+    expect(received(1, KEY_PRESS)).toHaveLength(keys[1] + 1);
+    expect(received(0, KEY_PRESS)).toHaveLength(keys[0]);
+    expect(received(1, BUTTON_PRESS)).toHaveLength(presses[1]);
+  });
+
+  test('reports malformed requests and unknown opcodes and carries on', async () => {
+    const connection = await connect();
+    connection.socket.write(
+      Buffer.concat([
+        // Body cut short
+        frame(20, Opcode.PointerEvent, i32s(pids[0], 10)),
+        // No such pointer or key event
+        frame(21, Opcode.PointerEvent, pointerBody(pids[0], 10, 10, 9)),
+        frame(22, Opcode.KeyEvent, keyBody(pids[0], KEY_CODE, 2)),
+        // Fewer pids than announced
+        frame(23, Opcode.ListWindows, Buffer.concat([Buffer.from([3, 0]), i32s(pids[0])])),
+        frame(24, 200),
+        frame(25, Opcode.Ping),
+      ]),
+    );
+    const responses = await connection.receive(6);
+    expect(responses.map(response => [response.id, response.status])).toEqual([
+      [20, Status.Malformed],
+      [21, Status.Malformed],
+      [22, Status.Malformed],
+      [23, Status.Malformed],
+      [24, Status.UnknownOpcode],
+      [25, Status.Ok],
+    ]);
+    expect(connection.closed).toBe(false);
+  });
+
+  test('closes a connection that announces an oversized frame', async () => {
+    const bystander = await connect();
+    const connection = await connect();
+    const header = Buffer.alloc(4);
+    header.writeUInt32LE(MAX_FRAME + 1, 0);
+    connection.socket.write(Buffer.concat([frame(30, Opcode.Ping), header]));
+
+    expect(await waitFor(() => connection.closed, 2_000)).toBe(true);
+    expect(connection.responses.map(response => response.id)).toEqual([30]);
+
+    bystander.socket.write(frame(31, Opcode.Ping));
+    expect((await bystander.receive(1))[0]).toMatchObject({id: 31, status: Status.Ok});
+  });
+
+  test('stops reading from a client that does not read its responses', async () => {
+    const connection = await connect();
+    connection.socket.pause();
+    // 9 byte requests with 9 byte responses: far past the daemon's 4 MiB of
+    // pending output per client
+    const count = 1_000_000;
+    const requests = Buffer.alloc(count * 9);
+    for (let i = 0; i < count; i++) {
+      requests.writeUInt32LE(5, i * 9);
+      requests.writeUInt32LE(i, i * 9 + 4);
+      requests.writeUInt8(Opcode.Ping, i * 9 + 8);
+    }
+    connection.socket.write(requests);
+    await sleep(500);
+    // The daemon left the rest of the requests unread
+    expect(connection.socket.writableLength).toBeGreaterThan(0);
+
+    // Other clients are still served meanwhile
+    const other = await connect();
+    other.socket.write(frame(40, Opcode.Ping));
+    expect((await other.receive(1))[0]).toMatchObject({id: 40, status: Status.Ok});
+
+    connection.socket.resume();
+    const responses = await connection.receive(count, 20_000);
+    expect(responses.every((response, i) => response.id === i && response.status === Status.Ok)).toBe(true);
+  });
+});
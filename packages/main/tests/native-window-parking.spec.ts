@@ -0,0 +1,138 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {hasCommand, sleep, spawnOwners, startStandIns, startXvfb} from './fixtures/xvfb';
+
+/**
+ * Parking mode under Xvfb (no window manager) on stand-in windows created by
+ * fixtures/x11-test-client.cjs. Hidden windows are unmapped, so whether a
+ * profile is parked shows in bulkWindowOp's visible-window count.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+const PROFILES = 12;
+const ACTIVE = 4;
+
+interface ParkResult {
+  parked: number[];
+  unparked: number[];
+  elapsedMs: number;
+}
+
+interface ParkingStats {
+  mode: string;
+  active: number;
+  parked: number;
+  swaps: number;
+  lastSwapMs: number;
+  sampleMs: number;
+  activeCpuPercent: number;
+  parkedCpuPercent: number;
+  savedCpuPercent: number;
+}
+
+interface ParkingManager {
+  parkWindows(pids: number[], activePids: number[], options?: {mode?: string}): ParkResult;
+  unparkWindows(): number;
+  getParkingStats(): ParkingStats;
+  bulkWindowOp(pids: number[], op: string): {pid: number; windows: number}[];
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('window parking under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess;
+  let manager: ParkingManager;
+  const owners: ChildProcess[] = [];
+  let pids: number[] = [];
+
+  // Profiles among pids whose window is mapped
+  const visible = () =>
+    manager
+      .bulkWindowOp(pids, 'bringToFront')
+      .filter(result => result.windows === 1)
+      .map(result => result.pid);
+
+  beforeAll(async () => {
+    xvfb = await startXvfb();
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(PROFILES));
+    pids = owners.map(owner => owner.pid as number);
+    const windows = pids.map((pid, i) => ({pid, x: (i % 6) * 300, y: Math.floor(i / 6) * 300, width: 280, height: 200}));
+
+    client = await startStandIns(display, windows);
+  });
+
+  afterAll(() => {
+    manager?.unparkWindows();
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('rejects unknown modes', () => {
+    expect(() => manager.parkWindows(pids, [], {mode: 'occlude'})).toThrow(TypeError);
+  });
+
+  test('parks everything outside the active set', () => {
+    const active = pids.slice(0, ACTIVE);
+    const result = manager.parkWindows(pids, active, {mode: 'hide'});
+    expect(result.parked).toEqual(pids.slice(ACTIVE).sort((a, b) => a - b));
+    expect(result.unparked).toEqual([]);
+    expect(visible()).toEqual(active);
+
+    // Nothing changed, nothing touched
+    expect(manager.parkWindows(pids, active, {mode: 'hide'})).toMatchObject({parked: [], unparked: []});
+  });
+
+  test('swaps only the profiles that change', () => {
+    const active = pids.slice(2, 2 + ACTIVE);
+    const result = manager.parkWindows(pids, active, {mode: 'hide'});
+    expect(result.parked).toEqual(pids.slice(0, 2).sort((a, b) => a - b));
+    expect(result.unparked).toEqual(pids.slice(ACTIVE, ACTIVE + 2).sort((a, b) => a - b));
+    expect(visible()).toEqual(active);
+  });
+
+  test('reports counts and CPU use since the previous sample', async () => {
+    manager.getParkingStats();
+    await sleep(100);
+    const stats = manager.getParkingStats();
+    expect(stats).toMatchObject({mode: 'hide', active: ACTIVE, parked: PROFILES - ACTIVE, swaps: 2});
+    expect(stats.sampleMs).toBeGreaterThan(0);
+    expect(stats.lastSwapMs).toBeGreaterThanOrEqual(0);
+    expect(stats.activeCpuPercent).toBeGreaterThanOrEqual(0);
+    expect(stats.parkedCpuPercent).toBeGreaterThanOrEqual(0);
+  });
+
+  test('switching modes brings hidden profiles back first', () => {
+    const active = pids.slice(0, ACTIVE);
+    const result = manager.parkWindows(pids, active, {mode: 'minimize'});
+    // Everything hidden was shown again, then parked the new way
+    expect(result.unparked).toHaveLength(PROFILES - ACTIVE);
+    expect(result.parked).toHaveLength(PROFILES - ACTIVE);
+    // Without a window manager a minimize request leaves the window mapped
+    expect(visible()).toEqual(pids);
+    expect(manager.getParkingStats().mode).toBe('minimize');
+  });
+
+  test('unparks every profile', () => {
+    manager.parkWindows(pids, [], {mode: 'hide'});
+    expect(visible()).toEqual([]);
+    expect(manager.unparkWindows()).toBe(PROFILES);
+    expect(visible()).toEqual(pids);
+    expect(manager.getParkingStats()).toMatchObject({active: 0, parked: 0});
+  });
+});
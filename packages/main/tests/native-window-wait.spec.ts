@@ -0,0 +1,130 @@
+import type {ChildProcess} from 'node:child_process';
+import {existsSync} from 'node:fs';
+import {createRequire} from 'node:module';
+import {join} from 'node:path';
+import {Worker} from 'node:worker_threads';
+import {afterAll, beforeAll, describe, expect, test} from 'vitest';
+import type {XvfbServer} from './fixtures/xvfb';
+import {forkStandIns, hasCommand, sleep, spawnOwners, startXvfb, waitFor} from './fixtures/xvfb';
+
+/**
+ * waitForWindow under Xvfb: waits are registered before
+ * fixtures/x11-test-client.cjs maps the stand-in windows, and must resolve
+ * from the map notifications rather than after a fixed delay.
+ */
+
+const ADDON_PATH = join(__dirname, '../src/native-addon/build/Release/window-addon.node');
+
+interface WaitedWindow {
+  handle: number;
+  isExtension: boolean;
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+interface WaitingManager {
+  waitForWindow(pid: number, options?: {kind?: string; timeoutMs?: number}): Promise<WaitedWindow | null>;
+}
+
+const enabled = process.platform === 'linux' && existsSync(ADDON_PATH) && hasCommand('Xvfb');
+
+describe.skipIf(!enabled)('waitForWindow under Xvfb', () => {
+  let display: number;
+  let xvfb: XvfbServer;
+  let client: ChildProcess | undefined;
+  let manager: WaitingManager;
+  const owners: ChildProcess[] = [];
+
+  beforeAll(async () => {
+    xvfb = await startXvfb(1280, 720);
+    display = xvfb.display;
+
+    process.env.DISPLAY = `:${display}`;
+    const addon = createRequire(__filename)(ADDON_PATH);
+    manager = new addon.WindowManager();
+
+    owners.push(...spawnOwners(3));
+  });
+
+  afterAll(() => {
+    client?.send({type: 'stop'});
+    for (const owner of owners) {
+      owner.kill();
+    }
+    xvfb?.stop();
+  });
+
+  test('resolves as soon as the window is mapped', async () => {
+    const pids = owners.slice(0, 2).map(owner => owner.pid as number);
+    const waits = pids.map(pid => manager.waitForWindow(pid, {timeoutMs: 10_000}));
+    await sleep(200);
+
+    const windows = pids.map((pid, i) => ({pid, x: i * 400, y: 20, width: 300, height: 200}));
+    let readyAt = 0;
+    client = forkStandIns(display, windows, (message: {type: string}) => {
+      if (message.type === 'ready') {
+        readyAt = Date.now();
+      }
+    });
+
+    const results = await Promise.all(waits);
+    const resolvedAt = Date.now();
+    expect(results).toEqual([
+      expect.objectContaining({isExtension: false, x: 0, y: 20, width: 300, height: 200}),
+      expect.objectContaining({isExtension: false, x: 400, y: 20, width: 300, height: 200}),
+    ]);
+    expect(await waitFor(() => readyAt > 0, 5_000)).toBe(true);
+    // Well inside the process index refresh interval, so not a re-check
+    expect(resolvedAt - readyAt).toBeLessThan(500);
+  });
+
+  test('resolves at once for a window that is already there', async () => {
+    const started = Date.now();
+    const result = await manager.waitForWindow(owners[0].pid as number);
+    expect(result).toMatchObject({x: 0, y: 20});
+    expect(Date.now() - started).toBeLessThan(500);
+  });
+
+  test('resolves null when no window shows up in time', async () => {
+    const started = Date.now();
+    expect(await manager.waitForWindow(owners[2].pid as number, {timeoutMs: 300})).toBeNull();
+    expect(Date.now() - started).toBeGreaterThanOrEqual(290);
+    expect(await manager.waitForWindow(owners[0].pid as number, {kind: 'extension', timeoutMs: 100})).toBeNull();
+  });
+
+  test('settles every one of many concurrent waits', async () => {
+    const pid = owners[2].pid as number;
+    const waits = Array.from({length: 500}, (_, i) => manager.waitForWindow(pid, {timeoutMs: 50 + (i % 5) * 10}));
+    const found = manager.waitForWindow(owners[1].pid as number);
+    expect(await Promise.all(waits)).toEqual(waits.map(() => null));
+    expect(await found).toMatchObject({x: 400, y: 20});
+  });
+
+  test('an environment torn down with waits pending exits cleanly', async () => {
+    const source = `
+      const {parentPort, workerData} = require('node:worker_threads');
+      const addon = require(workerData.addonPath);
+      const manager = new addon.WindowManager();
+      for (let i = 0; i < 50; i++) {
+        manager.waitForWindow(workerData.pid, {timeoutMs: 60_000});
+      }
+      parentPort.postMessage('waiting');
+    `;
+    const worker = new Worker(source, {
+      eval: true,
+      env: {...process.env},
+      workerData: {addonPath: ADDON_PATH, pid: owners[2].pid},
+    });
+    await new Promise(resolve => worker.once('message', resolve));
+    const started = Date.now();
+    expect(await worker.terminate()).toBe(1);
+    // Pending waits must not hold the worker's loop open
+    expect(Date.now() - started).toBeLessThan(5_000);
+  });
+
+  test('rejects unknown kinds', () => {
+    expect(() => manager.waitForWindow(owners[0].pid as number, {kind: 'popup'})).toThrow(TypeError);
+  });
+});
@@ -33,6 +33,181 @@ export const SyncBridge = {
     return ipcRenderer.invoke('window-arrange', args);
   },
 
+  // Snapshot window positions keyed by profile ID ({[pid]: profileId})
+  saveLayout: (args: {
+    profiles: Record<number, string>;
+  }): Promise<{success: boolean; layout?: Uint8Array; error?: string}> => {
+    return ipcRenderer.invoke('window-save-layout', args);
+  },
+
+  // Re-apply a saved layout; profiles in `pending` had no window yet
+  restoreLayout: (args: {
+    layout: Uint8Array;
+    pidMap: Record<string, number>;
+    force?: boolean;
+  }): Promise<{
+    success: boolean;
+    moved?: number;
+    skipped?: number;
+    missing?: number;
+    pending?: string[];
+    error?: string;
+  }> => {
+    return ipcRenderer.invoke('window-restore-layout', args);
+  },
+
+  // One operation on the windows of many profiles, applied as a single batch
+  bulkWindowOp: (args: {
+    pids: number[];
+    op: 'minimize' | 'restore' | 'hide' | 'show' | 'close' | 'bringToFront' | 'setAlwaysOnTop';
+    value?: boolean;
+  }): Promise<{success: boolean; results?: {pid: number; windows: number}[]; error?: string}> => {
+    return ipcRenderer.invoke('window-bulk-op', args);
+  },
+
+  // Keep activePids on screen and park the rest of pids, minimized or hidden
+  parkWindows: (args: {
+    pids: number[];
+    activePids: number[];
+    mode?: 'minimize' | 'hide';
+  }): Promise<{success: boolean; parked?: number[]; unparked?: number[]; elapsedMs?: number; error?: string}> => {
+    return ipcRenderer.invoke('window-park', args);
+  },
+
+  unparkWindows: (): Promise<{success: boolean; unparked?: number; error?: string}> => {
+    return ipcRenderer.invoke('window-unpark');
+  },
+
+  // CPU use of active and parked profiles since the previous call
+  getParkingStats: (): Promise<{
+    success: boolean;
+    stats?: {
+      mode: 'minimize' | 'hide';
+      active: number;
+      parked: number;
+      swaps: number;
+      lastSwapMs: number;
+      sampleMs: number;
+      activeCpuPercent: number;
+      parkedCpuPercent: number;
+      savedCpuPercent: number;
+    };
+    error?: string;
+  }> => {
+    return ipcRenderer.invoke('window-parking-stats');
+  },
+
+  // Sample CPU and memory of every profile's process tree in the background.
+  // Each row of `values` is `stride` numbers named by `fields`, starting with the pid.
+  startProfileUsage: (args: {
+    pids: number[];
+    options?: {intervalMs?: number; history?: number; slots?: number; pss?: boolean};
+  }): Promise<{
+    success: boolean;
+    slotCount?: number;
+    history?: number;
+    stride?: number;
+    fields?: string[];
+    error?: string;
+  }> => {
+    return ipcRenderer.invoke('profile-usage-start', args);
+  },
+
+  setProfileUsagePids: (args: {pids: number[]}): Promise<{success: boolean; error?: string}> => {
+    return ipcRenderer.invoke('profile-usage-set-profiles', args);
+  },
+
+  // The newest `frames` samples, newest first; samples is null before the first one
+  getProfileUsage: (args?: {
+    frames?: number;
+  }): Promise<{
+    success: boolean;
+    samples?: {
+      sequence: number;
+      frames: number;
+      slotCount: number;
+      stride: number;
+      sampleMs: number;
+      values: Float64Array;
+    } | null;
+    error?: string;
+  }> => {
+    return ipcRenderer.invoke('profile-usage-samples', args);
+  },
+
+  stopProfileUsage: (): Promise<{success: boolean}> => {
+    return ipcRenderer.invoke('profile-usage-stop');
+  },
+
+  // Scheduling of a profile's whole process tree; unset fields are left alone
+  setProcessPolicy: (args: {
+    pid: number;
+    policy: {
+      nice?: number;
+      ioClass?: 'none' | 'realtime' | 'best-effort' | 'idle';
+      ioLevel?: number;
+      cpus?: number[];
+      cpuWeight?: number;
+      cpuMaxPercent?: number;
+    };
+  }): Promise<{success: boolean; processes?: number; failed?: number; error?: string}> => {
+    return ipcRenderer.invoke('process-set-policy', args);
+  },
+
+  clearProcessPolicy: (args: {pid: number}): Promise<{success: boolean; error?: string}> => {
+    return ipcRenderer.invoke('process-clear-policy', args);
+  },
+
+  // Policy laid over the profile owning the focused window; null turns it off.
+  // cgroupRoot is a delegated cgroup v2 directory for cpuWeight/cpuMaxPercent on Linux.
+  setForegroundBoost: (args: {
+    policy: {nice?: number; cpuWeight?: number; cpuMaxPercent?: number; cpus?: number[]} | null;
+    cgroupRoot?: string;
+  }): Promise<{success: boolean; error?: string}> => {
+    return ipcRenderer.invoke('process-foreground-boost', args);
+  },
+
+  // Page out the memory of a profile's whole process tree
+  reclaimMemory: (args: {
+    pid: number;
+    mode?: 'pageout' | 'cold';
+  }): Promise<{
+    success: boolean;
+    processes?: number;
+    failed?: number;
+    reclaimedBytes?: number;
+    elapsedMs?: number;
+    error?: string;
+  }> => {
+    return ipcRenderer.invoke('process-reclaim-memory', args);
+  },
+
+  // Reclaim profiles that have not had focus for idleMs; an empty list turns it off
+  setAutoReclaim: (args: {
+    pids: number[];
+    idleMs: number;
+    mode?: 'pageout' | 'cold';
+  }): Promise<{success: boolean; error?: string}> => {
+    return ipcRenderer.invoke('process-auto-reclaim', args);
+  },
+
+  getReclaimStats: (): Promise<{
+    success: boolean;
+    stats?: {profiles: number; reclaims: number; reclaimedBytes: number; failed: number; lastReclaimMs: number};
+    error?: string;
+  }> => {
+    return ipcRenderer.invoke('process-reclaim-stats');
+  },
+
+  // Type values[i] into the focused field of slavePids[i], all slaves at once
+  typeTemplatedText: (args: {
+    slavePids: number[];
+    values: string[];
+    charDelayMs?: number;
+  }): Promise<{success: boolean; typed?: number[]; characters?: number[]; elapsedMs?: number; error?: string}> => {
+    return ipcRenderer.invoke('window-type-templated', args);
+  },
+
   // Get available monitors
   getMonitors: (): Promise<{success: boolean; monitors: MonitorInfo[]; error?: string}> => {
     return ipcRenderer.invoke('window-get-monitors');
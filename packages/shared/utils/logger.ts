@@ -57,3 +57,34 @@ export function createLogger(label: string) {
   }
   return winston.loggers.get(label);
 }
+
+export interface NativeLogRecord {
+  level: 'debug' | 'info' | 'warn' | 'error';
+  message: string;
+  file: string;
+  line: number;
+  time: number;
+  suppressed: number;
+}
+
+interface NativeLogSource {
+  setLogSink(
+    callback: ((records: NativeLogRecord[]) => void) | null,
+    options?: {level?: NativeLogRecord['level']},
+  ): void;
+}
+
+// 将原生模块的日志（批量、已限流）转发到 winston
+export function forwardNativeLogs(source: NativeLogSource, label: string) {
+  const logger = createLogger(label);
+  const isDevelopment = process.env.NODE_ENV !== 'production';
+  source.setLogSink(
+    records => {
+      for (const {level, message, file, line, suppressed} of records) {
+        const note = suppressed > 0 ? ` (${suppressed} similar suppressed)` : '';
+        logger.log(level, `${file}:${line} ${message}${note}`);
+      }
+    },
+    {level: isDevelopment ? 'debug' : 'info'},
+  );
+}
@@ -95,6 +95,12 @@ try {
     execSync(`cp "${sourcePath}" "${targetDir}/window-addon.node"`, { stdio: 'inherit' });
   }
 
+  // 代理中继模块（仅 Linux 构建），存在时一并复制
+  const relaySourcePath = path.join(releaseDir, 'proxy-relay.node');
+  if (fs.existsSync(relaySourcePath)) {
+    fs.copyFileSync(relaySourcePath, path.join(targetDir, 'proxy-relay.node'));
+  }
+
   // 验证文件已复制
   console.log('验证文件已复制...');
   if (platform === 'win32') {